@@ -7,17 +7,47 @@
 
 #include "CodeGenerator.h"
 #include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <forward_list>
+#include <type_traits>
 #include <vector>
 #include "ClangCompat.h"
 #include "DPrint.h"
 #include "Insights.h"
+#include "InsightsAbi.h"
+#include "InsightsAllocations.h"
+#include "InsightsAtomics.h"
 #include "InsightsBase.h"
+#include "InsightsCoroutineFrame.h"
+#include "InsightsDefaultedComparison.h"
+#include "InsightsExceptionCost.h"
+#include "InsightsFindings.h"
 #include "InsightsHelpers.h"
+#include "InsightsLockScope.h"
+#include "InsightsLoopUnroll.h"
 #include "InsightsMatchers.h"
+#include "InsightsMemcpy.h"
+#include "InsightsMoveAudit.h"
+#include "InsightsNodeProfile.h"
+#include "InsightsOpenMP.h"
 #include "InsightsOnce.h"
+#include "InsightsParameterCost.h"
+#include "InsightsRangesPipeline.h"
+#include "InsightsRecordLayout.h"
+#include "InsightsRtti.h"
+#include "InsightsSoaPreview.h"
+#include "InsightsSpecialMembers.h"
+#include "InsightsStackFrame.h"
 #include "InsightsStrCat.h"
+#include "InsightsVariantVisit.h"
+#include "InsightsZeroInit.h"
 #include "NumberIterator.h"
+#include "clang/AST/DeclVisitor.h"  // for the complete types of all DeclNodes.inc entries
+#include "clang/AST/RecordLayout.h"
+#include "clang/AST/StmtVisitor.h"  // for the complete types of all StmtNodes.inc entries
 #include "clang/Frontend/CompilerInstance.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/Path.h"
 //-----------------------------------------------------------------------------
 
@@ -28,6 +58,274 @@
 
 namespace clang::insights {
 
+/// \brief The boolean options of the TU in progress, see \ref CodeGenerator::ResetTranslationUnitState.
+///
+/// The \c InsertArg overloads of frequent nodes like implicit casts test a bit of this instead of looking up the
+/// options of the current context for each node.
+static thread_local uint64_t gOptionBits{};
+//-----------------------------------------------------------------------------
+
+static bool IsOptionEnabled(const InsightsOptionBit bit)
+{
+    return 0 != (gOptionBits & (uint64_t{1} << static_cast<unsigned>(bit)));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief What \ref FunctionSummaryScope counts for the function in progress.
+struct FunctionCounts
+{
+    uint64_t nonTrivialCopies{};         //!< For \c --show-copies.
+    uint64_t virtualCalls{};             //!< The calls through the vtable, for \c --show-virtual-calls.
+    uint64_t allocations{};              //!< The places which allocate or may allocate, for \c --show-allocations.
+    uint64_t refCountIncrements{};       //!< The atomic increments of a \c std::shared_ptr, for \c --show-refcounts.
+    uint64_t refCountDecrements{};       //!< The atomic decrements of a \c std::shared_ptr, for \c --show-refcounts.
+    uint64_t defaultArgConstructions{};  //!< The objects default arguments construct, for \c --show-default-args.
+};
+
+static thread_local FunctionCounts gFunctionCounts{};
+
+/// \brief The number of loops around the statement in progress, see \c --show-casts.
+static thread_local unsigned gLoopDepth{};
+
+/// \brief Counts a loop for as long as it is generated.
+struct LoopScope
+{
+    LoopScope() { ++gLoopDepth; }
+    ~LoopScope() { --gLoopDepth; }
+};
+
+/// \brief The loop hints like <tt>#pragma clang loop vectorize(enable)</tt> of the next loop. A range-based for loop
+/// becomes a block around a for loop, the pragmas have to go in front of the loop itself.
+static thread_local llvm::SmallVector<std::string, 2> gLoopHints{};
+
+static void InsertLoopHints(OutputFormatHelper& outputFormatHelper)
+{
+    for(const auto& hint : gLoopHints) {
+        outputFormatHelper.AppendNewLine(hint);
+    }
+
+    gLoopHints.clear();
+}
+
+/// \brief The statements synthesized for the lowering of the loops, keyed by the loop they stand for.
+///
+/// Nodes allocated in the \c ASTContext stay until it is destroyed. A loop can be generated more than once, for example
+/// as part of a lambda or a cached declaration, each time only the first lowering allocates.
+static thread_local llvm::DenseMap<const Stmt*, const CompoundStmt*> gLoweredStmts{};
+
+/// \brief The trip counts of the loops over the iterators the range-based for loops are lowered to, taken from the
+/// size of the range, see \c --alt-syntax-unroll.
+static thread_local llvm::DenseMap<const Stmt*, uint64_t> gRangeForTripCounts{};
+
+/// \brief The functions with allocations in the order they were generated, see \ref CodeGenerator::GetAllocationTable.
+static thread_local std::vector<std::pair<std::string, uint64_t>> gAllocationTable{};
+
+/// \brief A variable for which something runs at program start, see \ref CodeGenerator::GetGlobalInitTable.
+struct GlobalInit
+{
+    std::string name;
+    bool        dynamic;     //!< Whether the initializer runs at program start.
+    bool        registered;  //!< Whether the destructor is registered with \c __cxa_atexit.
+};
+
+static thread_local std::vector<GlobalInit> gGlobalInits{};
+//-----------------------------------------------------------------------------
+
+/// \brief The counter a copy of \p type changes, if it is a \c std::shared_ptr or a \c std::weak_ptr, otherwise \c
+/// nullptr.
+static const char* GetRefCountName(const QualType& type)
+{
+    const auto* record = type.isNull() ? nullptr : type->getAsCXXRecordDecl();
+
+    if(not record or not record->isInStdNamespace() or not record->getIdentifier()) {
+        return nullptr;
+    }
+
+    if("shared_ptr" == record->getName()) {
+        return "refcount";
+    } else if("weak_ptr" == record->getName()) {
+        return "weak count";
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p stmt contains a <tt>std::move(param)</tt>.
+static bool IsMovedFrom(const Stmt* stmt, const ParmVarDecl& param)
+{
+    if(nullptr == stmt) {
+        return false;
+    }
+
+    if(const auto* call = dyn_cast<CallExpr>(stmt); call and (1 == call->getNumArgs())) {
+        if(const auto* callee = call->getDirectCallee();
+           callee and callee->isInStdNamespace() and callee->getIdentifier() and ("move" == callee->getName())) {
+            if(const auto* declRef = dyn_cast<DeclRefExpr>(call->getArg(0)->IgnoreParenImpCasts());
+               declRef and (declRef->getDecl() == &param)) {
+                return true;
+            }
+        }
+    }
+
+    return llvm::any_of(stmt->children(), [&](const Stmt* child) { return IsMovedFrom(child, param); });
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Counts the non-trivial copies, virtual calls, allocations, refcount changes and constructions for default
+/// arguments in a function for \c --show-copies, \c --show-virtual-calls, \c --show-allocations, \c --show-refcounts
+/// and \c --show-default-args.
+///
+/// A function defined inside, like the call operator of a lambda, counts on its own and does not add to the
+/// surrounding one.
+class FunctionSummaryScope
+{
+public:
+    FunctionSummaryScope()
+    : mOuterCounts{std::exchange(gFunctionCounts, {})}
+    {
+    }
+
+    ~FunctionSummaryScope() { gFunctionCounts = mOuterCounts; }
+
+    /// \brief Insert the numbers after \p function, if there is anything.
+    void InsertSummary(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function) const
+    {
+        if(const auto copies = gFunctionCounts.nonTrivialCopies;
+           (0 != copies) and IsOptionEnabled(InsightsOptionBit::ShowCopies)) {
+            outputFormatHelper.AppendNewLine(
+                "/* ", copies, (1 == copies) ? " non-trivial copy */" : " non-trivial copies */");
+        }
+
+        if(const auto calls = gFunctionCounts.virtualCalls;
+           (0 != calls) and IsOptionEnabled(InsightsOptionBit::ShowVirtualCalls)) {
+            outputFormatHelper.AppendNewLine("/* ", calls, (1 == calls) ? " virtual call */" : " virtual calls */");
+        }
+
+        if(const auto allocations = gFunctionCounts.allocations;
+           (0 != allocations) and IsOptionEnabled(InsightsOptionBit::ShowAllocations)) {
+            outputFormatHelper.AppendNewLine(
+                "/* ", allocations, (1 == allocations) ? " allocation point */" : " allocation points */");
+
+            gAllocationTable.emplace_back(function.getQualifiedNameAsString(), allocations);
+        }
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowRefCounts)) {
+            InsertRefCountSummary(outputFormatHelper, function);
+        }
+
+        if(const auto constructions = gFunctionCounts.defaultArgConstructions;
+           (0 != constructions) and IsOptionEnabled(InsightsOptionBit::ShowDefaultArgs)) {
+            outputFormatHelper.AppendNewLine("/* ",
+                                             constructions,
+                                             (1 == constructions) ? " construction" : " constructions",
+                                             " for default arguments */");
+        }
+    }
+
+private:
+    static void InsertRefCountSummary(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function)
+    {
+        if(const auto increments = gFunctionCounts.refCountIncrements, decrements = gFunctionCounts.refCountDecrements;
+           (0 != increments) or (0 != decrements)) {
+            outputFormatHelper.AppendNewLine(
+                "/* atomic refcount operations: ", increments, " increments, ", decrements, " decrements */");
+        }
+
+        // The caller copies into a by-value parameter and destroys it after the call. Unless the function moves from
+        // it, a const reference does the same without the pair.
+        for(const auto* param : function.parameters()) {
+            if(GetRefCountName(param->getType()) and not IsMovedFrom(function.getBody(), *param)) {
+                outputFormatHelper.AppendNewLine("/* ",
+                                                 GetName(*param),
+                                                 ": taking const ",
+                                                 GetName(param->getType().getUnqualifiedType()),
+                                                 " & or moving from it saves an atomic increment and decrement per "
+                                                 "call */");
+            }
+        }
+    }
+
+    const FunctionCounts mOuterCounts;
+};
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::ResetTranslationUnitState()
+{
+    mHaveLocalStatic = false;
+    gOptionBits      = GetOptionBits(GetInsightsOptions());
+
+    ResetParameterCostTranslationUnit();
+    gAllocationTable.clear();
+    gGlobalInits.clear();
+    gLoopHints.clear();
+    gLoweredStmts.clear();
+    gRangeForTripCounts.clear();
+}
+//-----------------------------------------------------------------------------
+
+std::string CodeGenerator::GetAllocationTable()
+{
+    if(gAllocationTable.empty()) {
+        return {};
+    }
+
+    OutputFormatHelper outputFormatHelper{};
+    outputFormatHelper.AppendNewLine("/* allocation points per function");
+
+    for(const auto& [name, allocations] : gAllocationTable) {
+        outputFormatHelper.AppendNewLine("   ", name, ": ", allocations);
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+
+    return outputFormatHelper.GetString();
+}
+//-----------------------------------------------------------------------------
+
+std::string CodeGenerator::GetGlobalInitTable()
+{
+    if(gGlobalInits.empty()) {
+        return {};
+    }
+
+    const auto dynamic    = llvm::count_if(gGlobalInits, [](const GlobalInit& init) { return init.dynamic; });
+    const auto registered = llvm::count_if(gGlobalInits, [](const GlobalInit& init) { return init.registered; });
+
+    OutputFormatHelper outputFormatHelper{};
+    outputFormatHelper.AppendNewLine("/* at program start: ",
+                                     dynamic,
+                                     (1 == dynamic) ? " dynamic initialization, " : " dynamic initializations, ",
+                                     registered,
+                                     (1 == registered) ? " destructor registration" : " destructor registrations");
+
+    for(const auto& init : gGlobalInits) {
+        outputFormatHelper.AppendNewLine("   ",
+                                         init.name,
+                                         ": ",
+                                         init.dynamic ? "initializer" : "",
+                                         (init.dynamic and init.registered) ? ", " : "",
+                                         init.registered ? "__cxa_atexit" : "");
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+
+    return outputFormatHelper.GetString();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Insert \p note as a comment in front of an allocation at \p loc and count it for the function in progress.
+static void InsertAllocationNote(OutputFormatHelper& outputFormatHelper, const std::string& note, SourceLocation loc)
+{
+    if(not note.empty()) {
+        outputFormatHelper.Append("/* ", note, " */ ");
+        ++gFunctionCounts.allocations;
+
+        RecordFinding(loc, FindingCategory::Allocation, FindingSeverity::Warning, 1, note);
+    }
+}
+//-----------------------------------------------------------------------------
+
 static const char* AccessToString(const AccessSpecifier& access)
 {
     switch(access) {
@@ -191,6 +489,15 @@ CodeGenerator::LambdaScopeHandler::LambdaScopeHandler(LambdaStackType&       sta
 : mStack{stack}
 , mHelper{lambdaCallerType, GetBuffer(outputFormatHelper)}
 {
+    // Each entry knows the outermost placement up to itself, GetBuffer looks only at the last entry. A scan of the
+    // stack from the front would be quadratic in the nesting depth of lambdas.
+    auto* placement = mStack.empty() ? nullptr : mStack.back().placement();
+
+    if(not placement and IsLambdaPlacement(lambdaCallerType)) {
+        placement = &mHelper;
+    }
+
+    mHelper.setPlacement(placement);
     mStack.push(mHelper);
 }
 //-----------------------------------------------------------------------------
@@ -203,30 +510,30 @@ CodeGenerator::LambdaScopeHandler::~LambdaScopeHandler()
 }
 //-----------------------------------------------------------------------------
 
+bool CodeGenerator::LambdaScopeHandler::IsLambdaPlacement(const LambdaCallerType lambdaCallerType)
+{
+    switch(lambdaCallerType) {
+        case LambdaCallerType::CallExpr:
+        case LambdaCallerType::VarDecl:
+        case LambdaCallerType::ReturnStmt:
+        case LambdaCallerType::OperatorCallExpr:
+        case LambdaCallerType::MemberCallExpr:
+        case LambdaCallerType::BinaryOperator:
+        case LambdaCallerType::CXXMethodDecl: return true;
+        default: return false;
+    }
+}
+//-----------------------------------------------------------------------------
+
 OutputFormatHelper& CodeGenerator::LambdaScopeHandler::GetBuffer(OutputFormatHelper& outputFormatHelper) const
 {
     // Find the most outer element to place the lambda class definition. For example, if we have this:
     // Test( [&]() {} );
     // The lambda's class definition needs to be placed _before_ the CallExpr to Test.
-    auto* element = [&]() -> LambdaHelper* {
-        for(auto& l : mStack) {
-            switch(l.callerType()) {
-                case LambdaCallerType::CallExpr:
-                case LambdaCallerType::VarDecl:
-                case LambdaCallerType::ReturnStmt:
-                case LambdaCallerType::OperatorCallExpr:
-                case LambdaCallerType::MemberCallExpr:
-                case LambdaCallerType::BinaryOperator:
-                case LambdaCallerType::CXXMethodDecl: return &l;
-                default: break;
-            }
+    if(not mStack.empty()) {
+        if(auto* element = mStack.back().placement()) {
+            return element->buffer();
         }
-
-        return nullptr;
-    }();
-
-    if(element) {
-        return element->buffer();
     }
 
     return outputFormatHelper;
@@ -262,6 +569,19 @@ static void AddStmt(std::vector<Stmt*>& v, const T& stmt)
 }
 //-----------------------------------------------------------------------------
 
+static const CompoundStmt* GetLoweredStmt(const Stmt* stmt, llvm::function_ref<const CompoundStmt*()> lower)
+{
+    if(const auto* lowered = gLoweredStmts.lookup(stmt)) {
+        return lowered;
+    }
+
+    const auto* lowered = lower();
+    gLoweredStmts[stmt] = lowered;
+
+    return lowered;
+}
+//-----------------------------------------------------------------------------
+
 static void AddBodyStmts(std::vector<Stmt*>& v, Stmt* body)
 {
     if(auto* b = dyn_cast_or_null<CompoundStmt>(body)) {
@@ -274,7 +594,8 @@ static void AddBodyStmts(std::vector<Stmt*>& v, Stmt* body)
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CXXForRangeStmt* rangeForStmt)
+/// \brief Build the loop \p rangeForStmt stands for in the \c ASTContext, see \ref GetLoweredStmt.
+static const CompoundStmt* LowerRangeForStmt(const CXXForRangeStmt* rangeForStmt)
 {
     auto&      langOpts{GetLangOpts(*rangeForStmt->getLoopVariable())};
     const bool onlyCpp11{not langOpts.CPlusPlus14};
@@ -335,10 +656,29 @@ void CodeGenerator::InsertArg(const CXXForRangeStmt* rangeForStmt)
     AddStmt(outerScopeStmts, forStmt);
 
     ArrayRef<Stmt*> outerScopeStmtsRef{outerScopeStmts};
-    auto*           outerScope =
-        CompoundStmt::Create(ctx, outerScopeStmtsRef, rangeForStmt->getBeginLoc(), rangeForStmt->getEndLoc());
 
-    InsertArg(outerScope);
+    return CompoundStmt::Create(ctx, outerScopeStmtsRef, rangeForStmt->getBeginLoc(), rangeForStmt->getEndLoc());
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CXXForRangeStmt* rangeForStmt)
+{
+    LoopScope loopScope{};
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowSoa)) {
+        InsertSoaPreview(mOutputFormatHelper, *rangeForStmt);
+    }
+
+    const auto* lowered = GetLoweredStmt(rangeForStmt, [&] { return LowerRangeForStmt(rangeForStmt); });
+
+    // The loop over the iterators is the last statement of the lowered one, it runs once for each element.
+    if((0 != GetInsightsOptions().unrollFactor) and not lowered->body_empty()) {
+        if(const auto tripCount = GetUnrollTripCount(*rangeForStmt)) {
+            gRangeForTripCounts[lowered->body_back()] = *tripCount;
+        }
+    }
+
+    InsertArg(lowered);
 
     mOutputFormatHelper.AppendNewLine();
 }
@@ -419,15 +759,78 @@ void CodeGenerator::InsertArg(const ConditionalOperator* stmt)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief The statement the attributes, like \c [[likely]], in front of \p stmt apply to.
+static const Stmt* IgnoreAttributes(const Stmt* stmt)
+{
+    while(const auto* attributed = dyn_cast_or_null<AttributedStmt>(stmt)) {
+        stmt = attributed->getSubStmt();
+    }
+
+    return stmt;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The attribute \p attr as it is written, like \c [[likely]] or \c alignas(64).
+static std::string GetAttributeAsWritten(const Attr& attr)
+{
+    StringStream stream{};
+    attr.printPretty(stream, GetGlobalAST().getPrintingPolicy());
+
+    return StringRef{stream.str()}.trim().str();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The attributes of \p decl which change the generated code, each followed by a space. The ones a
+/// redeclaration inherits are already written at the first declaration.
+static std::string GetCodeGenAttributes(const Decl& decl)
+{
+    std::string attributes{};
+
+    for(const auto* attr : decl.attrs()) {
+        if(attr->isImplicit() or attr->isInherited()) {
+            continue;
+        }
+
+        if(isa<AlignedAttr>(attr) or isa<NoUniqueAddressAttr>(attr) or isa<AlwaysInlineAttr>(attr) or
+           isa<NoInlineAttr>(attr) or isa<FlattenAttr>(attr) or isa<HotAttr>(attr) or isa<ColdAttr>(attr) or
+           isa<NoReturnAttr>(attr) or isa<CXX11NoReturnAttr>(attr)) {
+            attributes += StrCat(GetAttributeAsWritten(*attr), " ");
+        }
+    }
+
+    return attributes;
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const AttributedStmt* stmt)
+{
+    for(const auto* attr : stmt->getAttrs()) {
+        if(isa<LoopHintAttr>(attr)) {
+            gLoopHints.push_back(GetAttributeAsWritten(*attr));
+        } else {
+            mOutputFormatHelper.Append(GetAttributeAsWritten(*attr), " ");
+        }
+    }
+
+    // The null statement of [[fallthrough]]; gets its semicolon from the surrounding compound statement.
+    if(const auto* subStmt = stmt->getSubStmt(); not isa<NullStmt>(subStmt)) {
+        InsertArg(subStmt);
+    }
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const DoStmt* stmt)
 {
+    LoopScope loopScope{};
+
+    InsertLoopHints(mOutputFormatHelper);
     mOutputFormatHelper.Append("do ");
     const auto* body = stmt->getBody();
     InsertArg(body);
 
-    if(isa<CompoundStmt>(body)) {
+    if(isa<CompoundStmt>(IgnoreAttributes(body))) {
         mOutputFormatHelper.Append(' ');
-    } else if(!isa<NullStmt>(body)) {
+    } else if(!isa<NullStmt>(IgnoreAttributes(body))) {
         mOutputFormatHelper.Append("; ");
     }
 
@@ -517,23 +920,26 @@ void CodeGenerator::InsertArg(const SwitchStmt* stmt)
 
 void CodeGenerator::InsertArg(const WhileStmt* stmt)
 {
+    LoopScope loopScope{};
+
     {
         // We need to handle the case that a lambda is used in the init-statement of the for-loop.
         LAMBDA_SCOPE_HELPER(VarDecl);
 
+        InsertLoopHints(mOutputFormatHelper);
         mOutputFormatHelper.Append("while");
         WrapInParens([&]() { InsertArg(stmt->getCond()); }, AddSpaceAtTheEnd::Yes);
     }
 
     const auto* body = stmt->getBody();
-    const bool  hasCompoundStmt{isa<CompoundStmt>(body)};
+    const bool  hasCompoundStmt{isa<CompoundStmt>(IgnoreAttributes(body))};
 
     InsertArg(body);
 
     if(hasCompoundStmt) {
         mOutputFormatHelper.AppendNewLine();
     } else {
-        const bool isBodyBraced = isa<CompoundStmt>(body);
+        const bool isBodyBraced = isa<CompoundStmt>(IgnoreAttributes(body));
         if(!isBodyBraced) {
             mOutputFormatHelper.AppendSemiNewLine();
         }
@@ -659,6 +1065,10 @@ void CodeGenerator::InsertArg(const FloatingLiteral* stmt)
 
 void CodeGenerator::InsertArg(const CXXTypeidExpr* stmt)
 {
+    if(IsOptionEnabled(InsightsOptionBit::ShowRtti)) {
+        mOutputFormatHelper.Append("/* ", GetTypeidNote(*stmt), " */ ");
+    }
+
     mOutputFormatHelper.Append("typeid");
     WrapInParens([&]() {
         if(stmt->isTypeOperand()) {
@@ -670,17 +1080,69 @@ void CodeGenerator::InsertArg(const CXXTypeidExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief Insert the lanes of a vector operation of type \p type, see \c --show-vector-lanes.
+static void InsertVectorLanesNote(OutputFormatHelper& outputFormatHelper, const QualType& type)
+{
+    if(not IsOptionEnabled(InsightsOptionBit::ShowVectorLanes)) {
+        return;
+    }
+
+    if(const auto lanes = GetVectorLanes(type); not lanes.empty()) {
+        outputFormatHelper.Append("/* ", lanes, " */ ");
+    }
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const BinaryOperator* stmt)
 {
     LAMBDA_SCOPE_HELPER(BinaryOperator);
 
-    const bool needLHSParens{isa<BinaryOperator>(stmt->getLHS()->IgnoreImpCasts())};
-    WrapInParensIfNeeded(needLHSParens, [&] { InsertArg(stmt->getLHS()); });
+    auto insertVectorLanesNote = [&](const BinaryOperator* binOp) {
+        // A plain assignment copies the vector, it is no lane-wise operation.
+        if(BO_Assign != binOp->getOpcode()) {
+            InsertVectorLanesNote(mOutputFormatHelper, binOp->getType());
+        }
+    };
+
+    insertVectorLanesNote(stmt);
+
+    // A left-associative chain like a + b + c nests on the LHS. Recursing into it takes a few stack frames per operand,
+    // which overflows the stack for long, often generated, chains. Walk down the LHS instead. Only a BinaryOperator
+    // which is directly the LHS is part of the chain, everything else, like a cast, goes through InsertArg.
+    llvm::SmallVector<const BinaryOperator*, 8> chain{stmt};
+
+    for(const auto* lhs = dyn_cast<BinaryOperator>(stmt->getLHS());
+        lhs and (Stmt::BinaryOperatorClass == lhs->getStmtClass());
+        lhs = dyn_cast<BinaryOperator>(lhs->getLHS())) {
+        chain.push_back(lhs);
+    }
+
+    // The lambda scopes of the nested operators are opened and closed in the same order as with the recursion. A
+    // std::forward_list keeps their address while they are on the lambda stack.
+    std::forward_list<LambdaScopeHandler> lambdaScopes{};
+
+    // A BinaryOperator as LHS always gets parens.
+    for(size_t i = 1; i < chain.size(); ++i) {
+        mOutputFormatHelper.Append('(');
+        lambdaScopes.emplace_front(mLambdaStack, mOutputFormatHelper, LambdaCallerType::BinaryOperator);
+        insertVectorLanesNote(chain[i]);
+    }
+
+    const auto* innermost = chain.back();
+    const bool  needLHSParens{isa<BinaryOperator>(innermost->getLHS()->IgnoreImpCasts())};
+    WrapInParensIfNeeded(needLHSParens, [&] { InsertArg(innermost->getLHS()); });
+
+    for(const auto* binOp : llvm::reverse(chain)) {
+        mOutputFormatHelper.Append(" ", binOp->getOpcodeStr(), " ");
 
-    mOutputFormatHelper.Append(" ", stmt->getOpcodeStr(), " ");
+        const bool needRHSParens{isa<BinaryOperator>(binOp->getRHS()->IgnoreImpCasts())};
+        WrapInParensIfNeeded(needRHSParens, [&] { InsertArg(binOp->getRHS()); });
 
-    const bool needRHSParens{isa<BinaryOperator>(stmt->getRHS()->IgnoreImpCasts())};
-    WrapInParensIfNeeded(needRHSParens, [&] { InsertArg(stmt->getRHS()); });
+        if(binOp != stmt) {
+            lambdaScopes.pop_front();
+            mOutputFormatHelper.Append(')');
+        }
+    }
 }
 //-----------------------------------------------------------------------------
 
@@ -716,6 +1178,13 @@ static std::string GetQualifiers(const VarDecl& vd)
 
     qualifiers += GetStorageClassAsStringWithSpace(vd.getStorageClass());
 
+    switch(vd.getTSCSpec()) {
+        case TSCS_thread_local: qualifiers += "thread_local "; break;
+        case TSCS__Thread_local: qualifiers += "_Thread_local "; break;
+        case TSCS___thread: qualifiers += "__thread "; break;
+        default: break;
+    }
+
     if(vd.isConstexpr()) {
         qualifiers += "constexpr ";
     }
@@ -741,59 +1210,397 @@ static std::string FormatVarTemplateSpecializationDecl(const Decl* decl, std::st
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const VarDecl* stmt)
+/// \brief The note for the loop variable of a range-based for-loop whose initialization constructs an object in each
+/// iteration, see \c --show-range-for-copies.
+///
+/// A loop variable by value gets a note if it is copied or converted from the element. A reference gets one if it
+/// binds to a temporary the element is converted to. Moves and trivial copies are cheap and get none.
+static std::string GetRangeForCopyNote(const VarDecl& loopVar)
 {
-    LAMBDA_SCOPE_HELPER(VarDecl);
-    UpdateCurrentPos();
+    const auto* init = loopVar.getInit();
 
-    if(InsertComma()) {
-        mOutputFormatHelper.Append(',');
+    if(not loopVar.isCXXForRangeDecl() or not init or loopVar.getType()->isDependentType()) {
+        return {};
     }
 
-    if(isa<VarTemplateSpecializationDecl>(stmt)) {
-        InsertTemplateSpecializationHeader();
-    }
+    const bool  isReference{loopVar.getType()->isReferenceType()};
+    const auto* construct = [&]() -> const CXXConstructExpr* {
+        if(not isReference) {
+            return dyn_cast_or_null<CXXConstructExpr>(init->IgnoreImplicit());
+        }
 
-    if(IsTrivialStaticClassVarDecl(*stmt)) {
-        HandleLocalStaticNonTrivialClass(stmt);
+        // Skip the cleanups of the temporary, the materialization shows that the element gets converted.
+        if(const auto* cleanups = dyn_cast_or_null<ExprWithCleanups>(init)) {
+            init = cleanups->getSubExpr();
+        }
 
-    } else {
-        if(InsertVarDecl()) {
-            mOutputFormatHelper.Append(GetQualifiers(*stmt));
+        if(const auto* temporary = dyn_cast_or_null<MaterializeTemporaryExpr>(init->IgnoreParenImpCasts())) {
+            return dyn_cast_or_null<CXXConstructExpr>(temporary->GetTemporaryExpr()->IgnoreImplicit());
+        }
 
-            if(const auto type = GetDesugarType(stmt->getType());
-               type->isFunctionPointerType() || isa<MemberPointerType>(type.getTypePtrOrNull())) {
-                const auto        lineNo = GetSM(*stmt).getSpellingLineNumber(stmt->getSourceRange().getBegin());
-                const std::string funcPtrName{StrCat("FuncPtr_", lineNo, " ")};
+        return nullptr;
+    }();
 
-                mOutputFormatHelper.AppendNewLine("using ", funcPtrName, "= ", GetName(type), ";");
-                mOutputFormatHelper.Append(funcPtrName, GetName(*stmt));
+    if(not construct or construct->isElidable() or construct->getConstructor()->isTrivial() or
+       construct->getConstructor()->isMoveConstructor()) {
+        return {};
+    }
 
-            } else {
-                const auto varName = FormatVarTemplateSpecializationDecl(stmt, GetName(*stmt));
+    const auto&    ctx = loopVar.getASTContext();
+    const uint64_t size{static_cast<uint64_t>(ctx.getTypeSizeInChars(construct->getType()).getQuantity())};
+    const char*    kind{isReference                                          ? "conversion to a temporary"
+                        : construct->getConstructor()->isCopyConstructor() ? "copy"
+                                                                           : "conversion"};
 
-                // TODO: to keep the special handling for lambdas, do this only for template specializations
-                if(stmt->getType()->getAs<TemplateSpecializationType>()) {
-                    mOutputFormatHelper.Append(GetNameAsWritten(stmt->getType()), " ", varName);
+    return StrCat(kind, " per iteration: ", size, (1 == size) ? " byte" : " bytes", ", non-trivial");
+}
+//-----------------------------------------------------------------------------
 
-                } else {
-                    mOutputFormatHelper.Append(GetTypeNameAsParameter(stmt->getType(), varName));
-                }
-            }
-        } else {
-            const std::string pointer = [&]() {
-                if(stmt->getType()->isAnyPointerType()) {
-                    return " *";
-                }
-                return " ";
-            }();
+/// \brief The note for a variable declared with \c auto whose initialization copies an lvalue, see \c
+/// --show-auto-copies.
+///
+/// \c auto never deduces a reference, so <tt>auto v = obj.getVectorRef();</tt> copies what the function returns a
+/// reference to. Only copies of types which are not trivially copyable get a note, naming the constructor selected.
+static std::string GetAutoCopyNote(const VarDecl& varDecl)
+{
+    const auto* init = varDecl.getInit();
 
-            mOutputFormatHelper.Append(pointer, GetName(*stmt));
-        }
+    // A reference or a pointer to auto is no AutoType, the other notes cover loop variables and structured bindings.
+    if(not init or not varDecl.getType()->getAs<AutoType>() or varDecl.getType()->isDependentType() or
+       varDecl.isCXXForRangeDecl() or isa<DecompositionDecl>(varDecl)) {
+        return {};
+    }
+
+    const auto& ctx = varDecl.getASTContext();
+
+    if(varDecl.getType().isTriviallyCopyableType(ctx)) {
+        return {};
+    }
+
+    const auto* construct = dyn_cast_or_null<CXXConstructExpr>(init->IgnoreImplicit());
+
+    if(not construct or construct->isElidable() or not construct->getConstructor()->isCopyConstructor() or
+       (1 > construct->getNumArgs()) or not construct->getArg(0)->isLValue()) {
+        return {};
+    }
+
+    const auto* ctor = construct->getConstructor();
+    std::string signature{StrCat(GetName(*ctor->getParent()), "(")};
+
+    OnceFalse needsComma{};
+    for(const auto* param : ctor->parameters()) {
+        if(needsComma) {
+            signature.append(", ");
+        }
+
+        signature.append(GetName(param->getType()));
+    }
+
+    signature.append(")");
+
+    const uint64_t size{static_cast<uint64_t>(ctx.getTypeSizeInChars(construct->getType()).getQuantity())};
+
+    return StrCat("auto copies an lvalue: ",
+                  size,
+                  (1 == size) ? " byte" : " bytes",
+                  ", ",
+                  signature,
+                  ctor->isUserProvided() ? "" : " (implicit)",
+                  gLoopDepth ? ", inside a loop" : "");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the hidden object of \p decomposition copies the source or refers to it, see \c
+/// --show-binding-storage.
+static std::string GetBindingStorageNote(const DecompositionDecl& decomposition)
+{
+    const auto type = decomposition.getType();
+
+    if(type->isReferenceType()) {
+        return "reference to the source, no copy";
+    }
+
+    if(type->isDependentType() or type->isIncompleteType() or not decomposition.hasInit()) {
+        return {};
+    }
+
+    const auto* init = decomposition.getInit()->IgnoreImplicit();
+    const auto* ctor = [&]() -> const CXXConstructorDecl* {
+        if(const auto* construct = dyn_cast_or_null<CXXConstructExpr>(init)) {
+            return construct->getConstructor();
+        }
+
+        return nullptr;
+    }();
+
+    const bool isCopy{isa<ArrayInitLoopExpr>(init) or (ctor and ctor->isCopyConstructor())};
+    const bool isMove{ctor and ctor->isMoveConstructor()};
+
+    if(not isCopy and not isMove) {
+        return "the source itself, no copy";
+    }
+
+    const auto&    ctx = decomposition.getASTContext();
+    const uint64_t size{static_cast<uint64_t>(ctx.getTypeSizeInChars(type).getQuantity())};
+
+    return StrCat(isCopy ? "copy" : "move",
+                  " of the source",
+                  decomposition.isCXXForRangeDecl() ? " per iteration" : "",
+                  ": ",
+                  size,
+                  " bytes",
+                  type.isTriviallyCopyableType(ctx) ? "" : ", non-trivial");
+}
+//-----------------------------------------------------------------------------
+
+static bool IsThreadSafeStatic(const VarDecl& decl)
+{
+    auto& langOpts{GetLangOpts(decl)};
+
+    return langOpts.ThreadsafeStatics && langOpts.CPlusPlus11 && (decl.isLocalVarDecl() /*|| NonTemplateInline*/) &&
+           !decl.getTLSKind();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The note for a local static which tells whether its initialization is guarded and what each pass through
+/// its declaration costs, see \c --show-static-init.
+static std::string GetStaticInitNote(const VarDecl& decl, const bool guarded)
+{
+    if(IsConstantInitialized(decl)) {
+        if(guarded) {
+            return "constant initialization: the guard only registers the destructor, each pass still checks it";
+        }
+
+        const bool enforced{decl.isConstexpr() or decl.hasAttr<ConstInitAttr>()};
+
+        return StrCat("constant initialization: no guard and no check on each pass",
+                      enforced ? "" : ", constinit keeps it so");
+    }
+
+    if(IsThreadSafeStatic(decl)) {
+        return "dynamic initialization: each pass checks the guard with an acquire load, the first one calls "
+               "__cxa_guard_acquire";
+    }
+
+    return "dynamic initialization: each pass checks the guard";
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p decl is a namespace-scope or static member variable with an initializer, see \c
+/// --show-global-init.
+static bool IsGlobalWithInit(const VarDecl& decl)
+{
+    // A thread_local is initialized on first use in each thread, not at program start.
+    return decl.hasGlobalStorage() and not decl.isStaticLocal() and not decl.getTLSKind() and decl.hasInit() and
+           decl.isThisDeclarationADefinition() and not decl.getDeclContext()->isDependentContext() and
+           not decl.getInit()->isValueDependent();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The class whose destructor is registered with \c __cxa_atexit for \p decl, if there is one.
+static const CXXRecordDecl* GetRegisteredDestructorClass(const VarDecl& decl)
+{
+    if(const auto* record = decl.getType()->getBaseElementTypeUnsafe()->getAsCXXRecordDecl();
+       record and record->hasDefinition() and record->hasNonTrivialDestructor()) {
+        return record;
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The note for a global which tells what runs for it at program start, see \c --show-global-init.
+static std::string GetGlobalInitNote(const VarDecl& decl)
+{
+    if(not IsConstantInitialized(decl)) {
+        return "dynamic initialization at program start";
+    }
+
+    const bool enforced{decl.isConstexpr() or decl.hasAttr<ConstInitAttr>()};
+
+    return StrCat("constant initialization",
+                  GetRegisteredDestructorClass(decl) ? ", only the destructor is registered at program start"
+                                                     : ", nothing runs at program start",
+                  enforced ? "" : ", constinit keeps it so");
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertGlobalInitFunction(const VarDecl& decl)
+{
+    const bool  dynamic{not IsConstantInitialized(decl)};
+    const auto* record = GetRegisteredDestructorClass(decl);
+
+    if(not dynamic and not record) {
+        return;
+    }
+
+    // Like clang, the first one has no number.
+    const auto        name = decl.getQualifiedNameAsString();
+    const std::string functionName{StrCat(
+        "__cxx_global_var_init", gGlobalInits.empty() ? std::string{} : StrCat("_", gGlobalInits.size()))};
+
+    gGlobalInits.push_back({name, dynamic, nullptr != record});
+
+    mOutputFormatHelper.AppendNewLine("/* at program start:");
+    mOutputFormatHelper.AppendNewLine("void ", functionName, "()");
+    mOutputFormatHelper.OpenScope();
+
+    if(dynamic) {
+        if(decl.getType()->isRecordType()) {
+            mOutputFormatHelper.Append("new (&", name, ") ");
+        } else {
+            mOutputFormatHelper.Append(name, " = ");
+        }
+
+        InsertArg(decl.getInit());
+        mOutputFormatHelper.AppendSemiNewLine();
+    }
+
+    if(record) {
+        mOutputFormatHelper.AppendNewLine("__cxa_atexit(",
+                                          GetName(QualType(record->getTypeForDecl(), 0)),
+                                          "::~",
+                                          record->getName(),
+                                          ", &",
+                                          name,
+                                          ", &__dso_handle);");
+    }
+
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+    mOutputFormatHelper.AppendNewLine();
+    mOutputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The note of \c --show-zero-init for the initialization of an object of \p type with \p init at \p loc.
+///
+/// A zero-fill is also a finding, a warning if it is large and inside a loop.
+static std::string GetZeroInitNoteAndRecord(const QualType& type, const Expr* init, const SourceLocation loc)
+{
+    const auto& ctx = GetGlobalAST();
+    const bool  inLoop{0 != gLoopDepth};
+    const auto  cost = GetZeroInitCost(ctx, init);
+    auto        note = GetZeroInitNote(ctx, type, init, cost, inLoop);
+    const bool  isLarge{inLoop and (LARGE_ZERO_FILL <= cost.zeroBytes)};
+
+    if(cost.zeroBytes and not note.empty()) {
+        RecordFinding(loc,
+                      FindingCategory::ZeroInit,
+                      isLarge ? FindingSeverity::Warning : FindingSeverity::Note,
+                      cost.zeroBytes,
+                      note);
+    }
+
+    return note;
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const VarDecl* stmt)
+{
+    LAMBDA_SCOPE_HELPER(VarDecl);
+    UpdateCurrentPos();
+
+    if(InsertComma()) {
+        mOutputFormatHelper.Append(',');
+    }
+
+    if(isa<VarTemplateSpecializationDecl>(stmt)) {
+        InsertTemplateSpecializationHeader();
+    }
+
+    if(IsTrivialStaticClassVarDecl(*stmt)) {
+        HandleLocalStaticNonTrivialClass(stmt);
+
+    } else if(IsThreadLocalWithWrapper(*stmt) and (VarDecl::Definition == stmt->isThisDeclarationADefinition())) {
+        HandleThreadLocalWithWrapper(stmt);
+
+    } else {
+        // Scalars with a constant initializer are the common case, they are not worth a note.
+        if(IsOptionEnabled(InsightsOptionBit::ShowStaticInit) and stmt->isStaticLocal() and stmt->hasInit() and
+           (stmt->getType()->isRecordType() or not IsConstantInitialized(*stmt))) {
+            mOutputFormatHelper.AppendNewLine("/* ", GetStaticInitNote(*stmt, false), " */");
+        }
+
+        const bool showGlobalInit{IsOptionEnabled(InsightsOptionBit::ShowGlobalInit) and IsGlobalWithInit(*stmt) and
+                                  (stmt->getType()->isRecordType() or not IsConstantInitialized(*stmt))};
+
+        if(showGlobalInit) {
+            mOutputFormatHelper.AppendNewLine("/* ", GetGlobalInitNote(*stmt), " */");
+        }
+
+        // Objects with static storage are zero-initialized for free, they live in .bss.
+        if(IsOptionEnabled(InsightsOptionBit::ShowZeroInit) and stmt->hasLocalStorage() and
+           not isa<ParmVarDecl>(stmt) and InsertSemi()) {
+            if(const auto note = GetZeroInitNoteAndRecord(stmt->getType(), stmt->getInit(), stmt->getLocation());
+               not note.empty()) {
+                mOutputFormatHelper.AppendNewLine("/* ", note, " */");
+            }
+        }
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowRangesPipeline)) {
+            const auto lines = GetRangesPipelineNote(*stmt);
+
+            for(size_t i = 0; i < lines.size(); ++i) {
+                mOutputFormatHelper.AppendNewLine(
+                    (0 == i) ? "/* " : "   ", lines[i], (lines.size() == i + 1) ? " */" : "");
+            }
+        }
+
+        if(InsertVarDecl()) {
+            mOutputFormatHelper.Append(GetCodeGenAttributes(*stmt), GetQualifiers(*stmt));
+
+            if(const auto type = GetDesugarType(stmt->getType());
+               type->isFunctionPointerType() || isa<MemberPointerType>(type.getTypePtrOrNull())) {
+                const auto        lineNo = GetSpellingLineColumn(GetSM(*stmt), stmt->getSourceRange().getBegin()).line;
+                const std::string funcPtrName{StrCat("FuncPtr_", lineNo, " ")};
+
+                mOutputFormatHelper.AppendNewLine("using ", funcPtrName, "= ", GetName(type), ";");
+                mOutputFormatHelper.Append(funcPtrName, GetName(*stmt));
+
+            } else {
+                const auto varName = FormatVarTemplateSpecializationDecl(stmt, GetName(*stmt));
+
+                // TODO: to keep the special handling for lambdas, do this only for template specializations
+                if(stmt->getType()->getAs<TemplateSpecializationType>()) {
+                    mOutputFormatHelper.Append(GetNameAsWritten(stmt->getType()), " ", varName);
+
+                } else {
+                    mOutputFormatHelper.Append(GetTypeNameAsParameter(stmt->getType(), varName));
+                }
+            }
+        } else {
+            const std::string pointer = [&]() {
+                if(stmt->getType()->isAnyPointerType()) {
+                    return " *";
+                }
+                return " ";
+            }();
+
+            mOutputFormatHelper.Append(pointer, GetName(*stmt));
+        }
 
         if(stmt->hasInit()) {
             mOutputFormatHelper.Append(" = ");
 
+            if(IsOptionEnabled(InsightsOptionBit::ShowRangeForCopies)) {
+                if(const auto note = GetRangeForCopyNote(*stmt); not note.empty()) {
+                    mOutputFormatHelper.Append("/* ", note, " */ ");
+                }
+            }
+
+            if(IsOptionEnabled(InsightsOptionBit::ShowAutoCopies)) {
+                if(const auto note = GetAutoCopyNote(*stmt); not note.empty()) {
+                    mOutputFormatHelper.Append("/* ", note, " */ ");
+                }
+            }
+
+            if(const auto* decompDecl = dyn_cast_or_null<DecompositionDecl>(stmt);
+               decompDecl and IsOptionEnabled(InsightsOptionBit::ShowBindingStorage)) {
+                if(const auto note = GetBindingStorageNote(*decompDecl); not note.empty()) {
+                    mOutputFormatHelper.Append("/* ", note, " */ ");
+                }
+            }
+
             InsertArg(stmt->getInit());
         };
 
@@ -801,8 +1608,24 @@ void CodeGenerator::InsertArg(const VarDecl* stmt)
             mOutputFormatHelper.Append(" /* NRVO variable */");
         }
 
+        if(IsOptionEnabled(InsightsOptionBit::ShowRefCounts) and stmt->hasLocalStorage() and
+           not isa<ParmVarDecl>(stmt)) {
+            if(const auto* counter = GetRefCountName(stmt->getType())) {
+                mOutputFormatHelper.Append(" /* atomic ", counter, " decrement at the end of the scope */");
+                ++gFunctionCounts.refCountDecrements;
+            }
+        }
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowLockScope) and IsLockVariable(*stmt)) {
+            mOutputFormatHelper.Append(" /* lock acquired */");
+        }
+
         if(InsertSemi()) {
             mOutputFormatHelper.AppendSemiNewLine();
+
+            if(showGlobalInit) {
+                InsertGlobalInitFunction(*stmt);
+            }
         }
 
         // Insert the bindings of a DecompositionDecl if this VarDecl is a DecompositionDecl.
@@ -847,7 +1670,7 @@ bool CodeGenerator::InsertLambdaStaticInvoker(const CXXMethodDecl* cxxMethodDecl
 static void
 InsertInstantiationPoint(OutputFormatHelper& outputFormatHelper, const SourceManager& sm, const SourceLocation& instLoc)
 {
-    const auto  lineNo = sm.getSpellingLineNumber(instLoc);
+    const auto  lineNo = GetSpellingLineColumn(sm, instLoc).line;
     const auto& fileId = sm.getFileID(instLoc);
     const auto* file   = sm.getFileEntryForID(fileId);
     if(file) {
@@ -876,6 +1699,40 @@ void CodeGenerator::InsertTemplateGuardEnd(const FunctionDecl* stmt)
 }
 //-----------------------------------------------------------------------------
 
+static void InsertCoroutineFrameIfEnabled(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function)
+{
+    if(IsOptionEnabled(InsightsOptionBit::ShowCoroutineFrame)) {
+        if(const auto* body = dyn_cast_or_null<CoroutineBodyStmt>(function.getBody())) {
+            InsertCoroutineFrame(outputFormatHelper, function, *body);
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+static void InsertAbiPassingIfEnabled(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function)
+{
+    if(IsOptionEnabled(InsightsOptionBit::ShowAbiPassing)) {
+        InsertAbiPassing(outputFormatHelper, function);
+    }
+}
+//-----------------------------------------------------------------------------
+
+static void InsertStackFrameIfEnabled(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function)
+{
+    if(IsOptionEnabled(InsightsOptionBit::ShowStackFrame)) {
+        InsertStackFrame(outputFormatHelper, function);
+    }
+}
+//-----------------------------------------------------------------------------
+
+static void InsertNoexceptCandidateIfEnabled(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function)
+{
+    if(IsOptionEnabled(InsightsOptionBit::ShowExceptionCost) and CouldBeNoexcept(function)) {
+        outputFormatHelper.AppendNewLine("/* could be noexcept: no throw and all callees are noexcept */");
+    }
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const CoroutineBodyStmt* stmt)
 {
     InsertArg(stmt->getBody());
@@ -933,9 +1790,21 @@ void CodeGenerator::InsertArg(const FunctionDecl* stmt)
 
         if(not InsertLambdaStaticInvoker(dyn_cast_or_null<CXXMethodDecl>(stmt))) {
             if(stmt->doesThisDeclarationHaveABody()) {
+                FunctionSummaryScope functionSummary{};
+
                 mOutputFormatHelper.AppendNewLine();
                 InsertArg(stmt->getBody());
                 mOutputFormatHelper.AppendNewLine();
+
+                functionSummary.InsertSummary(mOutputFormatHelper, *stmt);
+                InsertCoroutineFrameIfEnabled(mOutputFormatHelper, *stmt);
+                InsertNoexceptCandidateIfEnabled(mOutputFormatHelper, *stmt);
+                InsertAbiPassingIfEnabled(mOutputFormatHelper, *stmt);
+                InsertStackFrameIfEnabled(mOutputFormatHelper, *stmt);
+
+                if(IsExpandedDefaultedComparison(*stmt)) {
+                    InsertDefaultedComparisonCost(mOutputFormatHelper, *stmt);
+                }
             } else {
                 mOutputFormatHelper.AppendSemiNewLine();
             }
@@ -1033,20 +1902,30 @@ void CodeGenerator::InsertArg(const ParenListExpr* stmt)
 /// Fill the values of a constant array.
 ///
 /// This is either called by \c InitListExpr (which may contain an offset, as the user already provided certain
-/// values) or by \c GetValueOfValueInit.
+/// values) or by \c GetValueOfValueInit. More than \c --max-array-elements values are written as a single run, like
+/// \c {/* 1000 x */ 0}. The comment never contains \p value, which allows nesting runs for multi-dimensional arrays.
 std::string
 CodeGenerator::FillConstantArray(const ConstantArrayType* ct, const std::string& value, const uint64_t startAt)
 {
     OutputFormatHelper ret{};
 
     if(ct) {
-        const auto size{std::clamp(ct->getSize().getZExtValue(), uint64_t{0}, MAX_FILL_VALUES_FOR_ARRAYS)};
+        const auto size{ct->getSize().getZExtValue()};
+        const auto count{(startAt < size) ? (size - startAt) : uint64_t{0}};
 
         OnceFalse needsComma{uint64_t{0} != startAt};
-        for_each(startAt, size, [&](auto) {
+
+        if(const auto maxElements = GetInsightsOptions().maxArrayElements;
+           (0 != maxElements) and (count > maxElements)) {
             ret.AppendComma(needsComma);
-            ret.Append(value);
-        });
+            ret.Append("/* ", count, " x */ ", value);
+
+        } else {
+            for_each(startAt, size, [&](auto) {
+                ret.AppendComma(needsComma);
+                ret.Append(value);
+            });
+        }
     }
 
     return ret.GetString();
@@ -1100,8 +1979,78 @@ void CodeGenerator::InsertArg(const CXXDeleteExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief Insert whether the construction \p stmt of a \c std::shared_ptr or \c std::weak_ptr from another one changes
+/// the counter, see \c --show-refcounts.
+static void InsertRefCountNote(OutputFormatHelper& outputFormatHelper, const CXXConstructExpr& stmt)
+{
+    const auto* counter = GetRefCountName(stmt.getType());
+    const auto* ctor    = stmt.getConstructor();
+
+    if(not counter or stmt.isElidable() or (0 == ctor->getNumParams())) {
+        return;
+    }
+
+    // This covers the converting constructors and the one of a std::weak_ptr from a std::shared_ptr as well.
+    if(const auto paramType = ctor->getParamDecl(0)->getType(); GetRefCountName(paramType.getNonReferenceType())) {
+        if(paramType->isRValueReferenceType()) {
+            outputFormatHelper.Append("/* move, no ", counter, " change */ ");
+
+        } else if(paramType->isLValueReferenceType()) {
+            outputFormatHelper.Append("/* atomic ", counter, " increment */ ");
+            ++gFunctionCounts.refCountIncrements;
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const CXXConstructExpr* stmt)
 {
+    // An elidable copy is no copy at runtime, skip it for --show-copies.
+    if(const auto* ctor = stmt->getConstructor(); IsOptionEnabled(InsightsOptionBit::ShowCopies) and
+                                                  ctor->isCopyOrMoveConstructor() and not stmt->isElidable()) {
+        const auto bytes = static_cast<uint64_t>(GetGlobalAST().getTypeSizeInChars(stmt->getType()).getQuantity());
+
+        if(ctor->isTrivial()) {
+            mOutputFormatHelper.Append("/* trivial copy */ ");
+            RecordFinding(stmt->getBeginLoc(), FindingCategory::Copy, FindingSeverity::Note, bytes, "trivial copy");
+
+        } else if(ctor->isMoveConstructor()) {
+            mOutputFormatHelper.Append("/* move */ ");
+            RecordFinding(stmt->getBeginLoc(), FindingCategory::Copy, FindingSeverity::Note, bytes, "move");
+
+        } else {
+            mOutputFormatHelper.Append("/* copy */ ");
+            ++gFunctionCounts.nonTrivialCopies;
+            RecordFinding(stmt->getBeginLoc(), FindingCategory::Copy, FindingSeverity::Warning, bytes, "copy");
+        }
+    }
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowMemcpy) and not stmt->isElidable()) {
+        if(const auto bytes = GetMemcpyBytes(*stmt->getConstructor())) {
+            mOutputFormatHelper.Append("/* __builtin_memcpy, ", bytes, (1 == bytes) ? " byte */ " : " bytes */ ");
+        }
+    }
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowAllocations)) {
+        InsertAllocationNote(mOutputFormatHelper, GetAllocationNote(*stmt), stmt->getBeginLoc());
+    }
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowFunctionErasure)) {
+        if(const auto note = GetFunctionErasureNote(*stmt); not note.empty()) {
+            mOutputFormatHelper.Append("/* ", note, " */ ");
+        }
+    }
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowPessimizingMoves)) {
+        if(const auto note = GetIneffectiveMoveNote(*stmt); not note.empty()) {
+            mOutputFormatHelper.Append("/* ", note, " */ ");
+        }
+    }
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowRefCounts)) {
+        InsertRefCountNote(mOutputFormatHelper, *stmt);
+    }
+
     mOutputFormatHelper.Append(GetName(GetDesugarType(stmt->getType()), Unqualified::Yes));
 
     const BraceKind braceKind = [&]() {
@@ -1211,19 +2160,286 @@ void CodeGenerator::InsertArg(const CXXInheritedCtorInitExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CXXMemberCallExpr* stmt)
+/// \brief Whether the subexpressions of a \c ConstantExpr are generated, they are evaluated with it, see \c
+/// --show-constant-evaluation.
+static thread_local bool gInConstantExpr{};
+//-----------------------------------------------------------------------------
+
+/// \brief Evaluate \p expr at compile time.
+///
+/// \returns Nothing, if \p expr is not a constant. Otherwise its value, if it is an integer or floating point value,
+/// or an empty string.
+static llvm::Optional<std::string> EvaluateConstant(const Expr& expr)
 {
-    LAMBDA_SCOPE_HELPER(MemberCallExpr);
+    if(expr.isValueDependent() or expr.isTypeDependent()) {
+        return {};
+    }
 
-    InsertArg(stmt->getCallee());
+    const auto&      ctx = GetGlobalAST();
+    Expr::EvalResult result{};
 
-    WrapInParens([&]() { ForEachArg(stmt->arguments(), [&](const auto& arg) { InsertArg(arg); }); });
-}
-//-----------------------------------------------------------------------------
+    if(not expr.EvaluateAsRValue(result, ctx) or result.HasSideEffects) {
+        return {};
+    }
 
-void CodeGenerator::InsertArg(const ParenExpr* stmt)
-{
-    WrapInParens([&]() { InsertArg(stmt->getSubExpr()); });
+    if(not result.Val.isInt() and not result.Val.isFloat()) {
+        return std::string{};
+    }
+
+#if IS_CLANG_NEWER_THAN(9)
+    return result.Val.getAsString(ctx, expr.getType());
+#else
+    return result.Val.getAsString(const_cast<ASTContext&>(ctx), expr.getType());
+#endif
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Insert whether the call of a \c constexpr function in \p call is folded or runs at runtime, see \c
+/// --show-constant-evaluation. Calls inside a \c ConstantExpr are covered by its note.
+static void InsertConstantEvaluationNote(OutputFormatHelper& outputFormatHelper, const CallExpr& call)
+{
+    if(not IsOptionEnabled(InsightsOptionBit::ShowConstantEvaluation) or gInConstantExpr) {
+        return;
+    }
+
+    const auto* callee = call.getDirectCallee();
+
+    if(not callee or not callee->isConstexpr()) {
+        return;
+    }
+
+    if(const auto value = EvaluateConstant(call)) {
+        outputFormatHelper.Append("/* constexpr, foldable", value->empty() ? "" : ": ", *value, " */ ");
+        return;
+    }
+
+    // The object of a member operator is the first argument.
+    const unsigned offset{(isa<CXXOperatorCallExpr>(call) and isa<CXXMethodDecl>(callee)) ? 1u : 0u};
+
+    for(unsigned i = offset; i < call.getNumArgs(); ++i) {
+        if(const auto* arg = call.getArg(i); not arg->isValueDependent() and not arg->isEvaluatable(GetGlobalAST())) {
+            outputFormatHelper.Append(
+                "/* constexpr, at runtime: argument ", (i - offset + 1), " is not a constant */ ");
+            return;
+        }
+    }
+
+    outputFormatHelper.Append("/* constexpr, at runtime */ ");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief How a call of \p method on \p object is dispatched, see \c --show-virtual-calls. Empty for a non-virtual
+/// method.
+///
+/// \returns The annotation and whether the call goes through the vtable.
+static std::pair<std::string, bool>
+GetVirtualCallNote(const CXXMethodDecl* method, const Expr* object, const bool isQualified)
+{
+    if(not method or not method->isVirtual() or not object) {
+        return {};
+    }
+
+    if(isQualified) {
+        return {"virtual, qualified: direct call", false};
+
+    } else if(method->hasAttr<FinalAttr>() or method->getParent()->hasAttr<FinalAttr>()) {
+        return {"virtual, final: direct call", false};
+    }
+
+    // A variable of class type or a temporary, not a reference or something reached through a pointer, has a known
+    // dynamic type.
+    const auto* base = object->IgnoreParenImpCasts();
+    if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(base);
+       (declRef and isa<VarDecl>(declRef->getDecl()) and declRef->getDecl()->getType()->isRecordType()) or
+       isa<MaterializeTemporaryExpr>(base)) {
+        return {"virtual, dynamic type known: direct call", false};
+
+    } else if(method->getDevirtualizedMethod(object, false)) {
+        return {"virtual, devirtualizable: direct call", false};
+    }
+
+    return {"virtual: indirect call through the vtable", true};
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertVirtualCallNote(const CXXMethodDecl* method, const Expr* object, const bool isQualified)
+{
+    if(not IsOptionEnabled(InsightsOptionBit::ShowVirtualCalls)) {
+        return;
+    }
+
+    if(const auto [note, isIndirect] = GetVirtualCallNote(method, object, isQualified); not note.empty()) {
+        mOutputFormatHelper.Append("/* ", note, " */ ");
+
+        if(isIndirect) {
+            ++gFunctionCounts.virtualCalls;
+
+            if(object) {
+                RecordFinding(object->getExprLoc(), FindingCategory::VirtualCall, FindingSeverity::Note, 1, note);
+            }
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+bool CodeGenerator::InsertAtomicOperation(const CallExpr& call)
+{
+    const auto op = GetAtomicOperation(call);
+
+    if(not op) {
+        return false;
+    }
+
+    const bool  inLoop{0 != gLoopDepth};
+    const bool  lockFree{IsAtomicLockFree(op->valueType)};
+    std::string note{};
+
+    if(nullptr == op->order) {
+        note = inLoop ? "seq_cst by default inside a loop" : "seq_cst by default";
+    }
+
+    if(not lockFree) {
+        note = StrCat(note, note.empty() ? "" : ", ", "not lock-free");
+    }
+
+    if(not note.empty()) {
+        mOutputFormatHelper.Append("/* ", note, " */ ");
+
+        const bool isWarning{(inLoop and (nullptr == op->order)) or not lockFree};
+        RecordFinding(call.getExprLoc(),
+                      FindingCategory::Atomic,
+                      isWarning ? FindingSeverity::Warning : FindingSeverity::Note,
+                      1,
+                      note);
+    }
+
+    // A memory order which is only known at runtime stays as written, as does a type which has no builtin of its own.
+    const auto order        = GetAtomicMemoryOrder(op->order);
+    const auto failureOrder = op->failureOrder ? GetAtomicMemoryOrder(op->failureOrder) : GetAtomicFailureOrder(order);
+
+    if(not HasAtomicBuiltin(*op) or order.empty() or failureOrder.empty()) {
+        return false;
+    }
+
+    // The builtins work on the T inside the std::atomic, which is the only member of it.
+    const auto& ctx        = GetGlobalAST();
+    const auto  objectType = op->isArrow ? op->object->getType()->getPointeeType() : op->object->getType();
+    const auto  valuePointer =
+        ctx.getPointerType(ctx.getQualifiedType(op->valueType, objectType.getLocalQualifiers()));
+
+    mOutputFormatHelper.Append(op->builtin, "(reinterpret_cast<", GetName(valuePointer), ">(", op->isArrow ? "" : "&");
+    InsertArg(op->object);
+    mOutputFormatHelper.Append(")");
+
+    if(op->expected) {
+        mOutputFormatHelper.Append(", &");
+        InsertArg(op->expected);
+    }
+
+    // The arithmetic of the builtins on pointers is in bytes.
+    const auto pointee = op->valueType->getPointeeType();
+    const bool isArithmetic{StringRef{op->builtin}.contains("add") or StringRef{op->builtin}.contains("sub")};
+
+    if(op->operand) {
+        mOutputFormatHelper.Append(", ");
+
+        if(isArithmetic and not pointee.isNull()) {
+            WrapInParens([&]() { InsertArg(op->operand); });
+            mOutputFormatHelper.Append(" * sizeof(", GetName(pointee), ")");
+
+        } else {
+            InsertArg(op->operand);
+        }
+
+    } else if(isArithmetic) {
+        // The ++ and -- operators.
+        if(pointee.isNull()) {
+            mOutputFormatHelper.Append(", 1");
+        } else {
+            mOutputFormatHelper.Append(", sizeof(", GetName(pointee), ")");
+        }
+    }
+
+    if(op->expected) {
+        mOutputFormatHelper.Append(", ", op->weak ? "true" : "false", ", ", order, ", ", failureOrder, ")");
+    } else {
+        mOutputFormatHelper.Append(", ", order, ")");
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+bool CodeGenerator::InsertMemcpy(const CXXOperatorCallExpr& call)
+{
+    const auto* method = dyn_cast_or_null<CXXMethodDecl>(call.getCalleeDecl());
+
+    if(not method or (OO_Equal != call.getOperator()) or (2 != call.getNumArgs())) {
+        return false;
+    }
+
+    const auto  bytes = GetMemcpyBytes(*method);
+    const auto* dst   = call.getArg(0);
+    const auto* src   = GetMemcpySource(*call.getArg(1));
+
+    if((0 == bytes) or not src or dst->getType().isVolatileQualified() or src->getType().isVolatileQualified()) {
+        return false;
+    }
+
+    const auto insertAddress = [&](const Expr* object) {
+        if(const auto* plain = object->IgnoreImpCasts();
+           isa<DeclRefExpr>(plain) or isa<MemberExpr>(plain) or isa<ArraySubscriptExpr>(plain)) {
+            mOutputFormatHelper.Append("&");
+            InsertArg(object);
+
+        } else {
+            mOutputFormatHelper.Append("&(");
+            InsertArg(object);
+            mOutputFormatHelper.Append(")");
+        }
+    };
+
+    // __builtin_memcpy returns the destination, dereferenced it is the result of the assignment.
+    const auto typeName = GetName(dst->getType(), Unqualified::Yes);
+
+    mOutputFormatHelper.Append("/* ",
+                               bytes,
+                               (1 == bytes) ? " byte" : " bytes",
+                               " */ *static_cast<",
+                               typeName,
+                               " *>(__builtin_memcpy(");
+    insertAddress(dst);
+    mOutputFormatHelper.Append(", ");
+    insertAddress(src);
+    mOutputFormatHelper.Append(", sizeof(", typeName, ")))");
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CXXMemberCallExpr* stmt)
+{
+    LAMBDA_SCOPE_HELPER(MemberCallExpr);
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowAtomics) and InsertAtomicOperation(*stmt)) {
+        return;
+    }
+
+    InsertConstantEvaluationNote(mOutputFormatHelper, *stmt);
+
+    if(const auto* memberExpr = dyn_cast_or_null<MemberExpr>(stmt->getCallee()->IgnoreParens())) {
+        InsertVirtualCallNote(stmt->getMethodDecl(), stmt->getImplicitObjectArgument(), memberExpr->hasQualifier());
+    }
+
+    InsertArg(stmt->getCallee());
+
+    InsertCallArgs(*stmt);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const ParenExpr* stmt)
+{
+    WrapInParens([&]() { InsertArg(stmt->getSubExpr()); });
 }
 //-----------------------------------------------------------------------------
 
@@ -1232,11 +2448,18 @@ void CodeGenerator::InsertArg(const UnaryOperator* stmt)
     const StringRef opCodeName = UnaryOperator::getOpcodeStr(stmt->getOpcode());
     const bool      insertBefore{!stmt->isPostfix()};
 
+    if((UO_AddrOf != stmt->getOpcode()) and (UO_Deref != stmt->getOpcode())) {
+        InsertVectorLanesNote(mOutputFormatHelper, stmt->getType());
+    }
+
     if(insertBefore) {
         mOutputFormatHelper.Append(opCodeName);
     }
 
-    InsertArg(stmt->getSubExpr());
+    // Written code has the parens of an operand like `!(a == b)` as a ParenExpr, a synthesized body like the one of a
+    // defaulted comparison does not.
+    WrapInParensIfNeeded(isa<BinaryOperator>(stmt->getSubExpr()->IgnoreImpCasts()),
+                         [&] { InsertArg(stmt->getSubExpr()); });
 
     if(!insertBefore) {
         mOutputFormatHelper.Append(opCodeName);
@@ -1244,12 +2467,116 @@ void CodeGenerator::InsertArg(const UnaryOperator* stmt)
 }
 //-------------	----------------------------------------------------------------
 
+/// \brief Eight copies of the byte \p c.
+static constexpr uint64_t BroadcastByte(const unsigned char c)
+{
+    return 0x0101010101010101ull * c;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether one of the eight bytes of \p word is zero.
+static constexpr bool HasZeroByte(const uint64_t word)
+{
+    return 0 != ((word - BroadcastByte(0x01)) & ~word & BroadcastByte(0x80));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \ref StringLiteral::outputString escapes \p c: a quote, a backslash or not printable.
+static constexpr bool NeedsEscape(const unsigned char c)
+{
+    return (0x20 > c) or (0x7e < c) or ('"' == c) or ('\\' == c);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Same as \ref NeedsEscape for all eight bytes of \p word at once.
+///
+/// A byte below 0x20 borrows in the subtraction, one above 0x7e has the high bit set after the addition. The
+/// carries can only produce false positives next to a byte which matches anyway.
+static constexpr bool HasEscapeByte(const uint64_t word)
+{
+    constexpr uint64_t highBits{BroadcastByte(0x80)};
+
+    const bool control{0 != ((word - BroadcastByte(0x20)) & ~word & highBits)};
+    const bool notAscii{0 != (((word + BroadcastByte(0x01)) | word) & highBits)};
+
+    return control or notAscii or HasZeroByte(word ^ BroadcastByte('"')) or HasZeroByte(word ^ BroadcastByte('\\'));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The offset of the first byte of \p str which needs an escape, the size of \p str if there is none.
+///
+/// Looks at eight bytes at a time, large embedded tables or base64 data contain long runs without one.
+static size_t FindEscapeByte(StringRef str)
+{
+    size_t offset{};
+
+    for(; (offset + sizeof(uint64_t)) <= str.size(); offset += sizeof(uint64_t)) {
+        uint64_t word{};
+        std::memcpy(&word, str.data() + offset, sizeof(word));
+
+        if(HasEscapeByte(word)) {
+            break;
+        }
+    }
+
+    while((offset < str.size()) and not NeedsEscape(str[offset])) {
+        ++offset;
+    }
+
+    return offset;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Append \p c escaped the way \ref StringLiteral::outputString does.
+static void AppendEscapedByte(OutputFormatHelper& outputFormatHelper, const unsigned char c)
+{
+    switch(c) {
+        case '\\': outputFormatHelper.Append("\\\\"); break;
+        case '"': outputFormatHelper.Append("\\\""); break;
+        case '\a': outputFormatHelper.Append("\\a"); break;
+        case '\b': outputFormatHelper.Append("\\b"); break;
+        case '\f': outputFormatHelper.Append("\\f"); break;
+        case '\n': outputFormatHelper.Append("\\n"); break;
+        case '\r': outputFormatHelper.Append("\\r"); break;
+        case '\t': outputFormatHelper.Append("\\t"); break;
+        case '\v': outputFormatHelper.Append("\\v"); break;
+        default:
+            outputFormatHelper.Append('\\',
+                                      static_cast<char>('0' + ((c >> 6) & 7)),
+                                      static_cast<char>('0' + ((c >> 3) & 7)),
+                                      static_cast<char>('0' + (c & 7)));
+    }
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const StringLiteral* stmt)
 {
-    StringStream stream{};
-    stmt->outputString(stream);
+    // Wide, UTF-16 and UTF-32 literals are left to clang.
+    if(1 != stmt->getCharByteWidth()) {
+        StringStream stream{};
+        stmt->outputString(stream);
+
+        mOutputFormatHelper.Append(stream.str());
+        return;
+    }
+
+    // The same output as StringLiteral::outputString, but the runs without an escape go straight into the buffer
+    // instead of byte by byte through a stream.
+    mOutputFormatHelper.Append(stmt->isUTF8() ? "u8\"" : "\"");
+
+    for(StringRef str{stmt->getString()}; not str.empty();) {
+        const size_t run{FindEscapeByte(str)};
+
+        mOutputFormatHelper.Append(str.take_front(run));
+
+        if(run < str.size()) {
+            AppendEscapedByte(mOutputFormatHelper, str[run]);
+        }
+
+        str = str.drop_front(std::min(run + 1, str.size()));
+    }
 
-    mOutputFormatHelper.Append(stream.str());
+    mOutputFormatHelper.Append('"');
 }
 //-----------------------------------------------------------------------------
 
@@ -1261,7 +2588,7 @@ void CodeGenerator::InsertArg(const ArrayInitIndexExpr* stmt)
 
 void CodeGenerator::InsertArg(const ArraySubscriptExpr* stmt)
 {
-    if((not GetInsightsOptions().UseAltArraySubscriptionSyntax) || stmt->getLHS()->isLValue()) {
+    if((not IsOptionEnabled(InsightsOptionBit::UseAltArraySubscriptionSyntax)) || stmt->getLHS()->isLValue()) {
         InsertArg(stmt->getLHS());
 
         mOutputFormatHelper.Append('[');
@@ -1279,15 +2606,80 @@ void CodeGenerator::InsertArg(const ArraySubscriptExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
+void CodeGenerator::InsertArg(const ExtVectorElementExpr* stmt)
+{
+    InsertVectorLanesNote(mOutputFormatHelper, stmt->getType());
+
+    InsertArg(stmt->getBase());
+
+    mOutputFormatHelper.Append(stmt->isArrow() ? "->" : ".", stmt->getAccessor().getName());
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const ShuffleVectorExpr* stmt)
+{
+    InsertVectorLanesNote(mOutputFormatHelper, stmt->getType());
+
+    mOutputFormatHelper.Append("__builtin_shufflevector");
+
+    WrapInParens([&]() {
+        ForEachArg(NumberIterator(stmt->getNumSubExprs()), [&](const auto& i) { InsertArg(stmt->getExpr(i)); });
+    });
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const ConvertVectorExpr* stmt)
+{
+    InsertVectorLanesNote(mOutputFormatHelper, stmt->getType());
+
+    mOutputFormatHelper.Append("__builtin_convertvector");
+
+    WrapInParens([&]() {
+        InsertArg(stmt->getSrcExpr());
+        mOutputFormatHelper.Append(", ", GetName(stmt->getTypeSourceInfo()->getType()));
+    });
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const ArrayInitLoopExpr* stmt)
 {
     WrapInCurlys([&]() {
         const uint64_t size = stmt->getArraySize().getZExtValue();
 
-        ForEachArg(NumberIterator(size), [&](const auto& i) {
-            ArrayInitCodeGenerator codeGenerator{mOutputFormatHelper, i};
+        auto insertElement = [&](const uint64_t i, OutputFormatHelper& outputFormatHelper) {
+            ArrayInitCodeGenerator codeGenerator{outputFormatHelper, i};
             codeGenerator.InsertArg(stmt->getSubExpr());
-        });
+        };
+
+        // The elements differ only in the index, a run cannot describe them. Above the limit show the first two of
+        // them and the range of the others in a comment. That way each element keeps its index.
+        if(const auto maxElements = GetInsightsOptions().maxArrayElements;
+           (0 != maxElements) and (size > maxElements) and (2 < size)) {
+            insertElement(0, mOutputFormatHelper);
+            mOutputFormatHelper.Append(", ");
+            insertElement(1, mOutputFormatHelper);
+
+            OutputFormatHelper first{};
+            OutputFormatHelper last{};
+            insertElement(2, first);
+            insertElement(size - 1, last);
+
+            // An element with a comment of its own cannot go into the comment, the indices have to do then.
+            const auto& firstStr = first.GetString();
+            const auto& lastStr  = last.GetString();
+            const bool  hasComment{(std::string::npos != firstStr.find("/*")) or
+                                   (std::string::npos != lastStr.find("/*"))};
+
+            if(hasComment) {
+                mOutputFormatHelper.Append(" /* , [2] .. [", size - 1, "] */");
+            } else {
+                mOutputFormatHelper.Append(" /* , ", firstStr, " .. ", lastStr, " */");
+            }
+
+            return;
+        }
+
+        ForEachArg(NumberIterator(size), [&](const auto& i) { insertElement(i, mOutputFormatHelper); });
     });
 }
 //-----------------------------------------------------------------------------
@@ -1303,6 +2695,21 @@ void CodeGenerator::InsertArg(const CallExpr* stmt)
     LAMBDA_SCOPE_HELPER(CallExpr);
     UpdateCurrentPos();
 
+    if(IsOptionEnabled(InsightsOptionBit::ShowAllocations)) {
+        InsertAllocationNote(mOutputFormatHelper, GetAllocationNote(*stmt), stmt->getBeginLoc());
+    }
+
+    InsertConstantEvaluationNote(mOutputFormatHelper, *stmt);
+
+    // A SIMD intrinsic returns a vector.
+    InsertVectorLanesNote(mOutputFormatHelper, stmt->getType());
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowVariantVisit)) {
+        if(const auto note = GetVariantVisitNote(*stmt); not note.empty()) {
+            mOutputFormatHelper.Append("/* ", note, " */ ");
+        }
+    }
+
     InsertArg(stmt->getCallee());
 
     if(isa<UserDefinedLiteral>(stmt)) {
@@ -1313,43 +2720,369 @@ void CodeGenerator::InsertArg(const CallExpr* stmt)
         }
     }
 
-    WrapInParens([&]() { ForEachArg(stmt->arguments(), [&](const auto& arg) { InsertArg(arg); }); });
+    InsertCallArgs(*stmt);
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CXXNamedCastExpr* stmt)
+void CodeGenerator::InsertCallArgs(const CallExpr& call)
 {
-    const QualType castDestType = stmt->getTypeAsWritten();
-    const Expr*    subExpr      = stmt->getSubExpr();
+    const auto* callee = call.getDirectCallee();
+    unsigned    index{};
 
-    FormatCast(stmt->getCastName(), castDestType, subExpr, stmt->getCastKind());
+    WrapInParens([&]() {
+        ForEachArg(call.arguments(), [&](const auto& arg) {
+            if(IsOptionEnabled(InsightsOptionBit::ShowPessimizingMoves) and callee and
+               (index < callee->getNumParams())) {
+                if(const auto note = GetIneffectiveMoveArgNote(*arg, *callee->getParamDecl(index)); not note.empty()) {
+                    mOutputFormatHelper.Append("/* ", note, " */ ");
+                }
+            }
+
+            ++index;
+            InsertArg(arg);
+        });
+    });
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const ImplicitCastExpr* stmt)
+/// \brief The number of statements and expressions in the body of a function \c --show-inlining previews at most.
+static constexpr unsigned MAX_INLINE_NODES{24};
+//-----------------------------------------------------------------------------
+
+/// \brief Whether a preview of \c --show-inlining is generated. The calls in it get no preview of their own.
+static thread_local bool gInInlinePreview{};
+//-----------------------------------------------------------------------------
+
+/// \brief The number of nodes of \p stmt, counting stops above \ref MAX_INLINE_NODES.
+///
+/// A lambda counts as too large, its class would be generated inside the preview.
+static unsigned CountInlineNodes(const Stmt* stmt)
 {
-    const Expr* subExpr  = stmt->getSubExpr();
-    const auto  castKind = stmt->getCastKind();
-    const bool  hideImplicitCasts{not GetInsightsOptions().ShowAllImplicitCasts};
+    if(not stmt) {
+        return 0;
+    }
 
-    auto isMatchingCast = [](const CastKind kind, const bool hideImplicitCasts) {
-        switch(kind) {
-            case CastKind::CK_Dependent: [[fallthrough]];
-            case CastKind::CK_IntegralCast: [[fallthrough]];
-            case CastKind::CK_IntegralToBoolean: [[fallthrough]];
-            case CastKind::CK_IntegralToPointer: [[fallthrough]];
-            case CastKind::CK_PointerToIntegral: [[fallthrough]];
-            case CastKind::CK_BitCast: [[fallthrough]];
-            case CastKind::CK_UncheckedDerivedToBase: [[fallthrough]];
-            case CastKind::CK_ToUnion: [[fallthrough]];
-            case CastKind::CK_UserDefinedConversion: [[fallthrough]];
-            case CastKind::CK_AtomicToNonAtomic: [[fallthrough]];
-            case CastKind::CK_DerivedToBase: [[fallthrough]];
-            case CastKind::CK_FloatingCast: [[fallthrough]];
-            case CastKind::CK_IntegralToFloating: [[fallthrough]];
-            case CastKind::CK_FloatingToIntegral: [[fallthrough]];
-            /* these are implicit conversions. We get them right, but they may end up in a compiler internal type,
-             * which leads to compiler errors */
+    if(isa<LambdaExpr>(stmt)) {
+        return MAX_INLINE_NODES + 1;
+    }
+
+    unsigned count{1};
+
+    for(const auto* child : stmt->children()) {
+        count += CountInlineNodes(child);
+
+        if(MAX_INLINE_NODES < count) {
+            break;
+        }
+    }
+
+    return count;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The definition of the function \p call calls, if it is a small \c inline or \c constexpr function of the
+/// main file, otherwise null.
+///
+/// Small is a body of a single return statement or expression of at most \ref MAX_INLINE_NODES nodes. A virtual
+/// function is left out, the call may go to an override.
+static const FunctionDecl* GetInlineCandidate(const CallExpr& call)
+{
+    const auto*         callee = call.getDirectCallee();
+    const FunctionDecl* definition{};
+
+    if(not callee or callee->isVariadic() or not callee->hasBody(definition) or definition->isDependentContext() or
+       not(definition->isInlined() or definition->isConstexpr())) {
+        return nullptr;
+    }
+
+    if(const auto* method = dyn_cast<CXXMethodDecl>(definition); method and method->isVirtual()) {
+        return nullptr;
+    }
+
+    const auto* body = dyn_cast_or_null<CompoundStmt>(definition->getBody());
+
+    if(not body or (1 != body->size()) or not(isa<ReturnStmt>(body->body_front()) or isa<Expr>(body->body_front())) or
+       not GetGlobalAST().getSourceManager().isInMainFile(definition->getLocation()) or
+       (MAX_INLINE_NODES < CountInlineNodes(body))) {
+        return nullptr;
+    }
+
+    return definition;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Join the lines of \p text and turn the comments of other options in it into parens, as the preview is a
+/// comment itself.
+static std::string FlattenInlinePreview(StringRef text)
+{
+    llvm::SmallVector<StringRef, 4> lines{};
+    text.split(lines, '\n', -1, false);
+
+    std::string joined{};
+
+    for(const auto& line : lines) {
+        joined.append(StrCat(joined.empty() ? "" : " ", line.trim()));
+    }
+
+    std::string preview{};
+
+    for(size_t i = 0; i < joined.size(); ++i) {
+        if(const auto pair = StringRef{joined}.substr(i, 2); (pair == "/*") or (pair == "*/")) {
+            preview.push_back((pair == "/*") ? '(' : ')');
+            ++i;
+            continue;
+        }
+
+        preview.push_back(joined[i]);
+    }
+
+    return preview;
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertInlinePreview(const CallExpr& call)
+{
+    const auto* function = gInInlinePreview ? nullptr : GetInlineCandidate(call);
+
+    if(not function) {
+        return;
+    }
+
+    // The object of a member operator is its first argument.
+    const auto*    method = dyn_cast<CXXMethodDecl>(function);
+    const bool     isMemberOperator{isa<CXXOperatorCallExpr>(call) and method};
+    const unsigned firstArg{isMemberOperator ? 1u : 0u};
+    const auto*    object = [&]() -> const Expr* {
+        if(const auto* memberCall = dyn_cast<CXXMemberCallExpr>(&call)) {
+            return memberCall->getImplicitObjectArgument();
+        }
+
+        return isMemberOperator ? call.getArg(0) : nullptr;
+    }();
+
+    if(call.getNumArgs() != (firstArg + function->getNumParams())) {
+        return;
+    }
+
+    // The preview generates the body once more, it does not count for the summary of the function.
+    const auto outerCounts = gFunctionCounts;
+    gInInlinePreview       = true;
+
+    OutputFormatHelper ofm{};
+    CodeGenerator      codeGenerator{ofm, mLambdaStack};
+
+    ofm.Append("{ ");
+
+    if(object and method->isInstance()) {
+        ofm.Append("this = ", object->getType()->isPointerType() ? "" : "&");
+        codeGenerator.InsertArg(object);
+        ofm.Append("; ");
+    }
+
+    for(unsigned i = 0; i < function->getNumParams(); ++i) {
+        const auto* param = function->getParamDecl(i);
+
+        ofm.Append(GetTypeNameAsParameter(param->getType(), GetName(*param)), " = ");
+        codeGenerator.InsertArg(call.getArg(firstArg + i));
+        ofm.Append("; ");
+    }
+
+    codeGenerator.InsertArg(cast<CompoundStmt>(function->getBody())->body_front());
+    ofm.Append("; }");
+
+    gInInlinePreview = false;
+    gFunctionCounts  = outerCounts;
+
+    mOutputFormatHelper.Append(" /* inlined: ", FlattenInlinePreview(ofm.GetString()), " */");
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CXXNamedCastExpr* stmt)
+{
+    if(const auto* dynamicCast = dyn_cast<CXXDynamicCastExpr>(stmt);
+       dynamicCast and IsOptionEnabled(InsightsOptionBit::ShowRtti) and InsertDynamicCast(*dynamicCast)) {
+        return;
+    }
+
+    const QualType castDestType = stmt->getTypeAsWritten();
+    const Expr*    subExpr      = stmt->getSubExpr();
+
+    FormatCast(stmt->getCastName(), castDestType, subExpr, stmt->getCastKind());
+}
+//-----------------------------------------------------------------------------
+
+bool CodeGenerator::InsertDynamicCast(const CXXDynamicCastExpr& cast)
+{
+    const auto dynamicCast = GetDynamicCast(cast);
+
+    if(not dynamicCast) {
+        mOutputFormatHelper.Append((CK_Dynamic == cast.getCastKind()) ? "/* offset to the top from the vtable */ "
+                                                                       : "/* no runtime check */ ");
+        return false;
+    }
+
+    const bool inLoop{0 != gLoopDepth};
+    auto       note = StrCat("__dynamic_cast walks the type_info of the hierarchy", inLoop ? " inside a loop" : "");
+
+    if(const auto alternative = GetStaticCastAlternative(cast, *dynamicCast); not alternative.empty()) {
+        note = StrCat(note, ", ", alternative);
+    }
+
+    if(dynamicCast->isReference) {
+        note = StrCat(note, ", throws std::bad_cast if it fails");
+    }
+
+    mOutputFormatHelper.Append("/* ", note, " */ ");
+    RecordFinding(cast.getExprLoc(),
+                  FindingCategory::Rtti,
+                  inLoop ? FindingSeverity::Warning : FindingSeverity::Note,
+                  1,
+                  note);
+
+    // The runtime works on pointers, a reference is taken by its address and the result dereferenced.
+    const auto& ctx = GetGlobalAST();
+    const auto  resultType{dynamicCast->isReference ? ctx.getPointerType(cast.getType()) : cast.getType()};
+
+    mOutputFormatHelper.Append(dynamicCast->isReference ? "*" : "",
+                               "static_cast<",
+                               GetName(resultType),
+                               ">(__dynamic_cast(",
+                               dynamicCast->isReference ? "&" : "");
+    InsertArg(cast.getSubExpr());
+    mOutputFormatHelper.Append(", &typeid(",
+                               GetName(*dynamicCast->source),
+                               "), &typeid(",
+                               GetName(*dynamicCast->destination),
+                               "), ",
+                               dynamicCast->hint,
+                               "))");
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The cost class of a derived-to-base conversion along \p cast. A conversion to a base at offset zero is free.
+static CastCost GetDerivedToBaseCost(const CastExpr& cast)
+{
+    const auto& ctx  = GetGlobalAST();
+    QualType    type = cast.getSubExpr()->getType();
+
+    if(const auto* pointer = type->getAs<PointerType>()) {
+        type = pointer->getPointeeType();
+    }
+
+    const auto* derived = type->getAsCXXRecordDecl();
+
+    for(const auto* base : cast.path()) {
+        const auto* baseRecord = base->getType()->getAsCXXRecordDecl();
+
+        if(base->isVirtual() or not derived or not baseRecord or not derived->hasDefinition() or
+           not ctx.getASTRecordLayout(derived).getBaseClassOffset(baseRecord).isZero()) {
+            return CastCost::Adjustment;
+        }
+
+        derived = baseRecord;
+    }
+
+    return CastCost::Free;
+}
+//-----------------------------------------------------------------------------
+
+static CastCost GetCastCost(const ImplicitCastExpr& cast)
+{
+    switch(cast.getCastKind()) {
+        case CastKind::CK_UserDefinedConversion: [[fallthrough]];
+        case CastKind::CK_ConstructorConversion: return CastCost::Expensive;
+
+        case CastKind::CK_DerivedToBase: [[fallthrough]];
+        case CastKind::CK_UncheckedDerivedToBase: return GetDerivedToBaseCost(cast);
+
+        case CastKind::CK_IntegralToFloating: [[fallthrough]];
+        case CastKind::CK_FloatingToIntegral: [[fallthrough]];
+        case CastKind::CK_IntegralComplexToFloatingComplex: [[fallthrough]];
+        case CastKind::CK_FloatingComplexToIntegralComplex: return CastCost::IntFloat;
+
+        case CastKind::CK_NoOp: [[fallthrough]];
+        case CastKind::CK_LValueToRValue: [[fallthrough]];
+        case CastKind::CK_ArrayToPointerDecay: [[fallthrough]];
+        case CastKind::CK_FunctionToPointerDecay: [[fallthrough]];
+        case CastKind::CK_NullToPointer: [[fallthrough]];
+        case CastKind::CK_NullToMemberPointer: [[fallthrough]];
+        case CastKind::CK_BitCast: [[fallthrough]];
+        case CastKind::CK_ToVoid: return CastCost::Free;
+
+        default: return CastCost::Cheap;
+    }
+}
+//-----------------------------------------------------------------------------
+
+static const char* GetCastCostName(const CastCost cost)
+{
+    switch(cost) {
+        case CastCost::None: break;
+        case CastCost::Free: return "free";
+        case CastCost::Cheap: return "cheap";
+        case CastCost::IntFloat: return "int-float";
+        case CastCost::Adjustment: return "adjust";
+        case CastCost::Expensive: return "expensive";
+    }
+
+    return "";
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Insert the cost class of \p cast, if \c --show-casts selects it. With \c expensive only the ones inside of
+/// loops are of interest, they run with every iteration.
+static void InsertCastCostNote(OutputFormatHelper& outputFormatHelper, const ImplicitCastExpr& cast)
+{
+    const auto threshold = GetInsightsOptions().showCasts;
+
+    if(CastCost::None == threshold) {
+        return;
+    }
+
+    const auto cost = GetCastCost(cast);
+
+    if((cost < threshold) or ((CastCost::Expensive == threshold) and (0 == gLoopDepth))) {
+        return;
+    }
+
+    outputFormatHelper.Append("/* ", GetCastCostName(cost), ": ", cast.getCastKindName(), " */ ");
+
+    RecordFinding(cast.getExprLoc(),
+                  FindingCategory::Conversion,
+                  (CastCost::Expensive == cost) ? FindingSeverity::Warning : FindingSeverity::Note,
+                  static_cast<uint64_t>(cost),
+                  StrCat(GetCastCostName(cost), ": ", cast.getCastKindName()));
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const ImplicitCastExpr* stmt)
+{
+    const Expr* subExpr  = stmt->getSubExpr();
+    const auto  castKind = stmt->getCastKind();
+    const bool  hideImplicitCasts{not IsOptionEnabled(InsightsOptionBit::ShowAllImplicitCasts)};
+
+    InsertCastCostNote(mOutputFormatHelper, *stmt);
+
+    auto isMatchingCast = [](const CastKind kind, const bool hideImplicitCasts) {
+        switch(kind) {
+            case CastKind::CK_Dependent: [[fallthrough]];
+            case CastKind::CK_IntegralCast: [[fallthrough]];
+            case CastKind::CK_IntegralToBoolean: [[fallthrough]];
+            case CastKind::CK_IntegralToPointer: [[fallthrough]];
+            case CastKind::CK_PointerToIntegral: [[fallthrough]];
+            case CastKind::CK_BitCast: [[fallthrough]];
+            case CastKind::CK_UncheckedDerivedToBase: [[fallthrough]];
+            case CastKind::CK_ToUnion: [[fallthrough]];
+            case CastKind::CK_UserDefinedConversion: [[fallthrough]];
+            case CastKind::CK_AtomicToNonAtomic: [[fallthrough]];
+            case CastKind::CK_DerivedToBase: [[fallthrough]];
+            case CastKind::CK_FloatingCast: [[fallthrough]];
+            case CastKind::CK_IntegralToFloating: [[fallthrough]];
+            case CastKind::CK_FloatingToIntegral: [[fallthrough]];
+            /* these are implicit conversions. We get them right, but they may end up in a compiler internal type,
+             * which leads to compiler errors */
             // case CastKind::CK_NoOp:
             case CastKind::CK_NonAtomicToAtomic: return true;
             default:
@@ -1396,7 +3129,14 @@ void CodeGenerator::InsertArg(const DeclRefExpr* stmt)
 
         codeGenerator.ParseDeclContext(ctx);
 
-        mOutputFormatHelper.Append(ScopeHandler::RemoveCurrentScope(ofm.GetString()), GetPlainName(*stmt));
+        std::string plainName{GetPlainName(*stmt)};
+
+        // Each access of a thread_local with dynamic initialization calls its wrapper.
+        if(const auto* var = dyn_cast_or_null<VarDecl>(stmt->getDecl()); var and IsThreadLocalWithWrapper(*var)) {
+            plainName = StrCat(BuildThreadLocalWrapperName(plainName), "()");
+        }
+
+        mOutputFormatHelper.Append(ScopeHandler::RemoveCurrentScope(ofm.GetString()), plainName);
 
     } else {
         mOutputFormatHelper.Append(GetName(*stmt));
@@ -1416,178 +3156,906 @@ void CodeGenerator::InsertArg(const CompoundStmt* stmt)
 }
 //-----------------------------------------------------------------------------
 
-template<typename... Args>
-static bool IsStmtRequieringSemi(const Stmt* stmt)
+template<typename... Args>
+static bool IsStmtRequieringSemi(const Stmt* stmt)
+{
+    return (... && !isa<Args>(stmt));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Check whether a part of \p stmt is evaluated only under a condition, like the operands of \c && or \c ?:.
+///
+/// A lambda counts as well, its body is not part of the statement.
+static bool HasConditionalEvaluation(const Stmt* stmt)
+{
+    if(not stmt) {
+        return false;
+    }
+
+    if(isa<AbstractConditionalOperator>(stmt) or isa<LambdaExpr>(stmt)) {
+        return true;
+
+    } else if(const auto* binOp = dyn_cast_or_null<BinaryOperator>(stmt); binOp and binOp->isLogicalOp()) {
+        return true;
+    }
+
+    return std::any_of(stmt->child_begin(), stmt->child_end(), HasConditionalEvaluation);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the temporaries of \p stmt can be declared before it and destroyed right after it.
+///
+/// That is the case for a plain expression or declaration statement. The temporaries of the condition of an \c if
+/// or a loop die before the body runs, the initializer of a \c static runs only once and after a \c return no code
+/// is executed.
+static bool CanShowTemporaries(const Stmt* stmt)
+{
+    if(const auto* declStmt = dyn_cast_or_null<DeclStmt>(stmt)) {
+        for(const auto* decl : declStmt->decls()) {
+            if(const auto* varDecl = dyn_cast_or_null<VarDecl>(decl); varDecl and not varDecl->hasLocalStorage()) {
+                return false;
+            }
+        }
+
+    } else if(not isa<Expr>(stmt)) {
+        return false;
+    }
+
+    return not HasConditionalEvaluation(stmt);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::HandleCompoundStmt(const CompoundStmt* stmt)
+{
+    auto* const outerTemporaries = mTemporaries;
+
+    for(const auto* item : stmt->body()) {
+        llvm::Optional<StatementTemporaries> temporaries{};
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowTemporaries) and CanShowTemporaries(item)) {
+            temporaries.emplace(StatementTemporaries{mOutputFormatHelper, mOutputFormatHelper.ReserveAnchor()});
+        }
+
+        mTemporaries = temporaries ? temporaries.getPointer() : nullptr;
+
+        InsertArg(item);
+
+        if(IsStmtRequieringSemi<IfStmt, ForStmt, DeclStmt, WhileStmt, DoStmt, CXXForRangeStmt, SwitchStmt>(
+               IgnoreAttributes(item))) {
+            mOutputFormatHelper.AppendSemiNewLine();
+        }
+
+        mTemporaries = outerTemporaries;
+
+        if(temporaries) {
+            // The end of the full-expression, the temporaries are destroyed in the reverse order of their construction.
+            for(const auto& destructor : llvm::reverse(temporaries->destructors)) {
+                mOutputFormatHelper.AppendNewLine(destructor);
+            }
+        }
+    }
+
+    if(not IsOptionEnabled(InsightsOptionBit::ShowLockScope)) {
+        return;
+    }
+
+    // The end of the scope, the locks are released in the reverse order of their declaration.
+    llvm::SmallVector<const VarDecl*, 2> locks{};
+
+    for(const auto* item : stmt->body()) {
+        if(const auto* declStmt = dyn_cast<DeclStmt>(item)) {
+            for(const auto* decl : declStmt->decls()) {
+                if(const auto* var = dyn_cast<VarDecl>(decl); var and IsLockVariable(*var)) {
+                    locks.push_back(var);
+                }
+            }
+        }
+    }
+
+    for(const auto* lock : llvm::reverse(locks)) {
+        mOutputFormatHelper.AppendNewLine("/* ", GetLockReleaseNote(*lock, *stmt), " */");
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const IfStmt* stmt)
+{
+    const std::string cexpr{stmt->isConstexpr() ? kwSpaceConstExpr : ""};
+    const bool        hasInit{stmt->getInit() || stmt->getConditionVariable()};
+
+    if(hasInit) {
+        mOutputFormatHelper.OpenScope();
+
+        if(const auto* conditionVar = stmt->getConditionVariable()) {
+            InsertArg(conditionVar);
+        }
+
+        if(const auto* init = stmt->getInit()) {
+            InsertArg(init);
+        }
+    }
+
+    mOutputFormatHelper.Append("if", cexpr);
+
+    WrapInParens([&]() { InsertArg(stmt->getCond()); }, AddSpaceAtTheEnd::Yes);
+
+    const auto* body = stmt->getThen();
+
+    InsertArg(body);
+
+    const bool isBodyBraced = isa<CompoundStmt>(IgnoreAttributes(body));
+
+    if(!isBodyBraced && !isa<NullStmt>(IgnoreAttributes(body))) {
+        mOutputFormatHelper.AppendSemiNewLine();
+    }
+
+    // else
+    if(const auto* elsePart = stmt->getElse()) {
+        const std::string cexprElse{stmt->isConstexpr() ? StrCat("/* ", kwConstExprSpace, "*/ ") : ""};
+
+        if(isBodyBraced) {
+            mOutputFormatHelper.Append(' ');
+        }
+
+        mOutputFormatHelper.Append("else ", cexprElse);
+
+        const bool needScope = isa<IfStmt>(elsePart);
+        if(needScope) {
+            mOutputFormatHelper.OpenScope();
+        }
+
+        InsertArg(elsePart);
+
+        // an else with just a single statement seems not to carry a semi-colon at the end
+        if(!needScope && !isa<CompoundStmt>(IgnoreAttributes(elsePart))) {
+            mOutputFormatHelper.AppendSemiNewLine();
+        }
+
+        if(needScope) {
+            mOutputFormatHelper.CloseScope();
+        }
+    }
+
+    mOutputFormatHelper.AppendNewLine();
+
+    if(hasInit) {
+        mOutputFormatHelper.CloseScope();
+        mOutputFormatHelper.AppendNewLine();
+    }
+
+    // one blank line after statement
+    mOutputFormatHelper.AppendNewLine();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Build the while loop for \p stmt in the \c ASTContext, see \c --alt-syntax-for and \ref GetLoweredStmt.
+static const CompoundStmt* LowerForStmt(const ForStmt* stmt)
+{
+    auto* rwStmt = const_cast<ForStmt*>(stmt);
+
+    const auto&        ctx = GetGlobalAST();
+    std::vector<Stmt*> bodyStmts{};
+
+    AddBodyStmts(bodyStmts, rwStmt->getBody());
+    AddStmt(bodyStmts, rwStmt->getInc());
+
+    auto* condition = [&]() -> Expr* {
+        if(rwStmt->getCond()) {
+            return rwStmt->getCond();
+        }
+
+        return new(ctx) CXXBoolLiteralExpr(true, {}, stmt->getBeginLoc());
+    }();
+
+    ArrayRef<Stmt*> bodyStmtsRef{bodyStmts};
+    auto*           outerBody = CompoundStmt::Create(ctx, bodyStmtsRef, stmt->getBeginLoc(), stmt->getEndLoc());
+    auto*           whileStmt = WhileStmt::Create(ctx, nullptr, condition, outerBody, stmt->getBeginLoc());
+
+    std::vector<Stmt*> outerScopeStmts{};
+    AddStmt(outerScopeStmts, rwStmt->getInit());
+    AddStmt(outerScopeStmts, whileStmt);
+
+    ArrayRef<Stmt*> outerScopeStmtsRef{outerScopeStmts};
+
+    return CompoundStmt::Create(ctx, outerScopeStmtsRef, stmt->getBeginLoc(), stmt->getEndLoc());
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Build \p stmt unrolled by \p factor in the \c ASTContext, see \c --alt-syntax-unroll and \ref GetLoweredStmt.
+///
+/// A loop of at most \p factor iterations becomes a sequence of copies of its body. Otherwise the iterations which do
+/// not make up a multiple of \p factor are peeled off in front, followed by a while loop over \p factor copies. Each
+/// copy of a compound body is a scope of its own, so that the declarations of the copies do not clash.
+static const CompoundStmt* UnrollForStmt(const ForStmt* stmt, const uint64_t tripCount, const uint64_t factor)
+{
+    auto* rwStmt = const_cast<ForStmt*>(stmt);
+
+    const auto& ctx  = GetGlobalAST();
+    Stmt*       body = rwStmt->getBody();
+
+    if(isa<DeclStmt>(body)) {
+        ArrayRef<Stmt*> bodyRef{body};
+        body = CompoundStmt::Create(ctx, bodyRef, stmt->getBeginLoc(), stmt->getEndLoc());
+    }
+
+    const auto addIteration = [&](std::vector<Stmt*>& stmts, const bool withInc) {
+        if(not isa<NullStmt>(body)) {
+            AddStmt(stmts, body);
+        }
+
+        if(withInc) {
+            AddStmt(stmts, rwStmt->getInc());
+        }
+    };
+
+    const uint64_t     peeled{(tripCount <= factor) ? tripCount : (tripCount % factor)};
+    std::vector<Stmt*> outerScopeStmts{};
+
+    AddStmt(outerScopeStmts, rwStmt->getInit());
+
+    // After the last copy of a fully unrolled loop the variable goes out of scope, it needs no increment.
+    for(uint64_t i = 0; i < peeled; ++i) {
+        addIteration(outerScopeStmts, (i + 1) < tripCount);
+    }
+
+    if(tripCount > factor) {
+        std::vector<Stmt*> bodyStmts{};
+
+        for(uint64_t i = 0; i < factor; ++i) {
+            addIteration(bodyStmts, true);
+        }
+
+        ArrayRef<Stmt*> bodyStmtsRef{bodyStmts};
+        auto* unrolledBody = CompoundStmt::Create(ctx, bodyStmtsRef, stmt->getBeginLoc(), stmt->getEndLoc());
+
+        AddStmt(outerScopeStmts,
+                WhileStmt::Create(ctx, nullptr, rwStmt->getCond(), unrolledBody, stmt->getBeginLoc()));
+    }
+
+    ArrayRef<Stmt*> outerScopeStmtsRef{outerScopeStmts};
+
+    return CompoundStmt::Create(ctx, outerScopeStmtsRef, stmt->getBeginLoc(), stmt->getEndLoc());
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The trip count of \p stmt, if \c --alt-syntax-unroll is on and can unroll it.
+static llvm::Optional<uint64_t> GetTripCountForUnroll(const ForStmt* stmt)
+{
+    if(0 == GetInsightsOptions().unrollFactor) {
+        return {};
+    }
+
+    if(const auto it = gRangeForTripCounts.find(stmt); gRangeForTripCounts.end() != it) {
+        return it->second;
+    }
+
+    return GetUnrollTripCount(*stmt);
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const ForStmt* stmt)
+{
+    LoopScope loopScope{};
+
+    // https://github.com/vtjnash/clang-ast-builder/blob/master/AstBuilder.cpp
+    // http://clang-developers.42468.n3.nabble.com/Adding-nodes-to-Clang-s-AST-td4054800.html
+    // https://stackoverflow.com/questions/30451485/how-to-clone-or-create-an-ast-stmt-node-of-clang/38899615
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowMemcpy)) {
+        if(const auto note = GetElementwiseCopyNote(*stmt); not note.empty()) {
+            mOutputFormatHelper.AppendNewLine("/* ", note, " */");
+        }
+    }
+
+    if(const auto tripCount = GetTripCountForUnroll(stmt)) {
+        const auto factor = GetInsightsOptions().unrollFactor;
+
+        mOutputFormatHelper.AppendNewLine("/* ", GetUnrollNote(*tripCount, factor), " */");
+        InsertArg(GetLoweredStmt(stmt, [&] { return UnrollForStmt(stmt, *tripCount, factor); }));
+        mOutputFormatHelper.AppendNewLine();
+
+    } else if(IsOptionEnabled(InsightsOptionBit::UseAltForSyntax)) {
+        InsertArg(GetLoweredStmt(stmt, [&] { return LowerForStmt(stmt); }));
+        mOutputFormatHelper.AppendNewLine();
+
+    } else {
+
+        {
+            // We need to handle the case that a lambda is used in the init-statement of the for-loop.
+            LAMBDA_SCOPE_HELPER(VarDecl);
+
+            InsertLoopHints(mOutputFormatHelper);
+            mOutputFormatHelper.Append("for");
+
+            WrapInParens(
+                [&]() {
+                    if(const auto* init = stmt->getInit()) {
+                        MultiStmtDeclCodeGenerator codeGenerator{mOutputFormatHelper, mLambdaStack};
+                        codeGenerator.InsertArg(init);
+
+                    } else {
+                        mOutputFormatHelper.Append("; ");
+                    }
+
+                    InsertArg(stmt->getCond());
+                    mOutputFormatHelper.Append("; ");
+
+                    InsertArg(stmt->getInc());
+                },
+                AddSpaceAtTheEnd::Yes);
+        }
+
+        const auto* body = stmt->getBody();
+        const bool  hasCompoundStmt{isa<CompoundStmt>(IgnoreAttributes(body))};
+
+        if(hasCompoundStmt) {
+            mOutputFormatHelper.AppendNewLine();
+        }
+
+        InsertArg(body);
+
+        // Note: an empty for-loop carries a simi-colon at the end
+        if(hasCompoundStmt) {
+            mOutputFormatHelper.AppendNewLine();
+        } else {
+            if(!isa<CompoundStmt>(IgnoreAttributes(body)) && !isa<NullStmt>(IgnoreAttributes(body))) {
+                mOutputFormatHelper.AppendSemiNewLine();
+            }
+        }
+    }
+
+    mOutputFormatHelper.AppendNewLine();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The expression of the id of the current thread in the OpenMP region in progress, empty outside of one, see
+/// \c --show-openmp.
+static thread_local std::string gOMPThreadId{};
+//-----------------------------------------------------------------------------
+
+/// \brief The id of the current thread for the runtime calls of a directive. Outside of a parallel region it is
+/// declared from \p loc first.
+static std::string InsertOMPThreadId(OutputFormatHelper& outputFormatHelper, const std::string& loc)
+{
+    if(not gOMPThreadId.empty()) {
+        return gOMPThreadId;
+    }
+
+    outputFormatHelper.AppendNewLine("int __omp_gtid = __kmpc_global_thread_num(&", loc, ");");
+
+    return "__omp_gtid";
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The code of the expression \p expr of a clause or a loop bound, see \c --show-openmp.
+static std::string GetOMPExprAsString(const Expr* expr, CodeGenerator::LambdaStackType& lambdaStack)
+{
+    OutputFormatHelper ofm{};
+    CodeGenerator      codeGenerator{ofm, lambdaStack};
+    codeGenerator.InsertArg(IgnoreOMPCapturedExpr(expr));
+
+    return ofm.GetString();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief \p code in parentheses, unless it is a single name or number.
+static std::string ParenthesizeIfNeeded(const std::string& code)
+{
+    if(std::all_of(code.begin(), code.end(), [](const unsigned char c) { return isalnum(c) or ('_' == c); })) {
+        return code;
+    }
+
+    return StrCat("(", code, ")");
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertOMPBody(const Stmt* stmt)
+{
+    if(const auto* compoundStmt = dyn_cast_or_null<CompoundStmt>(stmt)) {
+        HandleCompoundStmt(compoundStmt);
+
+    } else if(stmt) {
+        InsertArg(stmt);
+
+        if(IsStmtRequieringSemi<IfStmt, ForStmt, DeclStmt, WhileStmt, DoStmt, CXXForRangeStmt, SwitchStmt>(stmt)) {
+            mOutputFormatHelper.AppendSemiNewLine();
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertOMPPrivates(const OMPExecutableDirective& stmt, const bool declareShared)
+{
+    const auto& ctx = GetGlobalAST();
+
+    for(const auto* var : GetOMPClauseVars<OMPPrivateClause>(stmt)) {
+        mOutputFormatHelper.AppendNewLine(GetTypeNameAsParameter(var->getType(), GetName(*var)), ";");
+    }
+
+    auto insertCopy = [&](const VarDecl& var, const std::string& init) {
+        const auto name = GetName(var);
+
+        if(declareShared) {
+            mOutputFormatHelper.AppendNewLine(
+                GetTypeNameAsParameter(ctx.getLValueReferenceType(var.getType()), StrCat("__omp_shared_", name)),
+                " = ",
+                name,
+                ";");
+        }
+
+        mOutputFormatHelper.AppendNewLine(
+            GetTypeNameAsParameter(var.getType(), name), init.empty() ? "" : " = ", init, ";");
+    };
+
+    // The outlined function of a parallel region gets the firstprivate variables by value already.
+    if(declareShared) {
+        for(const auto* var : GetOMPClauseVars<OMPFirstprivateClause>(stmt)) {
+            insertCopy(*var, StrCat("__omp_shared_", GetName(*var)));
+        }
+    }
+
+    for(const auto* var : GetOMPClauseVars<OMPLastprivateClause>(stmt)) {
+        insertCopy(*var, {});
+    }
+
+    for(const auto& reduction : GetOMPReductions(stmt)) {
+        const auto identity = GetOMPReductionIdentity(reduction.op, reduction.var->getType());
+
+        // A user-defined reduction starts with its initializer, which is not shown.
+        insertCopy(*reduction.var, identity.empty() ? StrCat("__omp_shared_", GetName(*reduction.var)) : identity);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertOMPReductions(const OMPExecutableDirective& stmt,
+                                       const std::string&            loc,
+                                       const std::string&            threadId,
+                                       const bool                    nowait)
+{
+    const auto reductions = GetOMPReductions(stmt);
+
+    if(reductions.empty()) {
+        return;
+    }
+
+    const char* reduce{nowait ? "__kmpc_reduce_nowait" : "__kmpc_reduce"};
+    const char* endReduce{nowait ? "__kmpc_end_reduce_nowait" : "__kmpc_end_reduce"};
+
+    auto insertCombiners = [&](const char* prefix) {
+        for(const auto& [var, op] : reductions) {
+            const auto name     = GetName(*var);
+            const auto combiner = GetOMPReductionCombiner(op, StrCat("__omp_shared_", name), name);
+
+            if(combiner.empty()) {
+                mOutputFormatHelper.AppendNewLine("// the combiner of the user-defined reduction ", op, " of ", name);
+            } else {
+                mOutputFormatHelper.AppendNewLine(prefix, combiner);
+            }
+        }
+    };
+
+    mOutputFormatHelper.AppendNewLine("static kmp_critical_name __omp_reduction_lock{};");
+    mOutputFormatHelper.Append("void * __omp_reduction_list[", reductions.size(), "] = {");
+
+    ForEachArg(reductions, [&](const auto& reduction) { mOutputFormatHelper.Append("&", GetName(*reduction.var)); });
+
+    mOutputFormatHelper.AppendNewLine("};");
+    mOutputFormatHelper.AppendNewLine(
+        "// 1: this thread combines the copies under the lock, 2: it combines them atomically, 0: the runtime "
+        "combined them in a tree with __omp_reduction_func");
+    mOutputFormatHelper.Append("switch(",
+                               reduce,
+                               "(&",
+                               loc,
+                               ", ",
+                               threadId,
+                               ", ",
+                               reductions.size(),
+                               ", sizeof(__omp_reduction_list), __omp_reduction_list, __omp_reduction_func, "
+                               "&__omp_reduction_lock)) ");
+    mOutputFormatHelper.OpenScope();
+
+    mOutputFormatHelper.Append("case 1:");
+    mOutputFormatHelper.IncreaseIndent();
+    mOutputFormatHelper.AppendNewLine();
+    insertCombiners("");
+    mOutputFormatHelper.AppendNewLine(endReduce, "(&", loc, ", ", threadId, ", &__omp_reduction_lock);");
+    mOutputFormatHelper.Append("break;");
+    mOutputFormatHelper.DecreaseIndent();
+    mOutputFormatHelper.AppendNewLine();
+
+    mOutputFormatHelper.Append("case 2:");
+    mOutputFormatHelper.IncreaseIndent();
+    mOutputFormatHelper.AppendNewLine();
+    insertCombiners("/* atomic */ ");
+
+    if(not nowait) {
+        mOutputFormatHelper.AppendNewLine(endReduce, "(&", loc, ", ", threadId, ", &__omp_reduction_lock);");
+    }
+
+    mOutputFormatHelper.Append("break;");
+    mOutputFormatHelper.DecreaseIndent();
+    mOutputFormatHelper.AppendNewLine();
+
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+    mOutputFormatHelper.AppendNewLine();
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertOMPLoop(const OMPLoopDirective& stmt, const std::string& loc, const std::string& threadId)
+{
+    const auto* forStmt   = dyn_cast_or_null<ForStmt>(GetOMPAssociatedStmt(stmt));
+    const auto  canonical = forStmt ? GetOMPCanonicalLoop(*forStmt) : llvm::Optional<OMPCanonicalLoop>{};
+
+    if(not canonical or stmt.getSingleClause<OMPCollapseClause>()) {
+        mOutputFormatHelper.AppendNewLine("// the runtime distributes the iterations of this loop among the threads");
+        InsertOMPBody(GetOMPAssociatedStmt(stmt));
+        return;
+    }
+
+    const auto&       ctx = GetGlobalAST();
+    const auto&       var = *canonical->var;
+    const auto        type{var.getType().getUnqualifiedType()};
+    const std::string typeName{GetName(type)};
+    const std::string suffix{GetOMPLoopFunctionSuffix(ctx, type)};
+    const auto        schedule = GetOMPSchedule(stmt);
+    const bool        ordered{nullptr != stmt.getSingleClause<OMPOrderedClause>()};
+
+    const std::string start{GetOMPExprAsString(canonical->start, mLambdaStack)};
+    const std::string end{GetOMPExprAsString(canonical->end, mLambdaStack)};
+    const std::string step{canonical->step ? ParenthesizeIfNeeded(GetOMPExprAsString(canonical->step, mLambdaStack))
+                                           : "1"};
+    const std::string chunk{schedule.chunk ? GetOMPExprAsString(schedule.chunk, mLambdaStack) : "1"};
+
+    const std::string distance{canonical->increments
+                                   ? StrCat(ParenthesizeIfNeeded(end), " - ", ParenthesizeIfNeeded(start))
+                                   : StrCat(ParenthesizeIfNeeded(start), " - ", ParenthesizeIfNeeded(end))};
+    std::string       tripCount{};
+
+    if("1" == step) {
+        tripCount = canonical->inclusive ? StrCat(distance, " + 1") : distance;
+    } else if(canonical->inclusive) {
+        tripCount = StrCat("(", distance, ") / ", step, " + 1");
+    } else {
+        tripCount = StrCat("(", distance, " + ", step, " - 1) / ", step);
+    }
+
+    const char* cmp{canonical->increments ? (canonical->inclusive ? " <= " : " < ")
+                                          : (canonical->inclusive ? " >= " : " > ")};
+
+    auto clampUpperBound = [&] {
+        mOutputFormatHelper.Append("if(__omp_ub > __omp_trip_count - 1) ");
+        mOutputFormatHelper.OpenScope();
+        mOutputFormatHelper.AppendNewLine("__omp_ub = __omp_trip_count - 1;");
+        mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+        mOutputFormatHelper.AppendNewLine();
+    };
+
+    // The iterations from __omp_lb to __omp_ub of the ones numbered from 0 to __omp_trip_count - 1.
+    auto insertIterations = [&] {
+        mOutputFormatHelper.Append("for(", typeName, " __omp_iv = __omp_lb; __omp_iv <= __omp_ub; ++__omp_iv) ");
+        mOutputFormatHelper.OpenScope();
+        mOutputFormatHelper.AppendNewLine(GetTypeNameAsParameter(var.getType(), GetName(var)),
+                                          " = ",
+                                          start,
+                                          canonical->increments ? " + " : " - ",
+                                          ("1" == step) ? "__omp_iv" : StrCat("__omp_iv * ", step),
+                                          ";");
+
+        InsertOMPBody(forStmt->getBody());
+
+        if(ordered) {
+            mOutputFormatHelper.AppendNewLine("__kmpc_dispatch_fini_", suffix, "(&", loc, ", ", threadId, ");");
+        }
+
+        mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+        mOutputFormatHelper.AppendNewLine();
+    };
+
+    mOutputFormatHelper.Append("if(", start, cmp, end, ") ");
+    mOutputFormatHelper.OpenScope();
+    mOutputFormatHelper.AppendNewLine("const ", typeName, " __omp_trip_count = ", tripCount, ";");
+    mOutputFormatHelper.AppendNewLine(typeName, " __omp_lb = 0;");
+    mOutputFormatHelper.AppendNewLine(typeName, " __omp_ub = __omp_trip_count - 1;");
+    mOutputFormatHelper.AppendNewLine(typeName, " __omp_stride = 1;");
+    mOutputFormatHelper.AppendNewLine("int __omp_last = 0;");
+
+    if(schedule.isStatic) {
+        if(schedule.chunk) {
+            mOutputFormatHelper.AppendNewLine("// thread t of T threads gets the blocks t, t + T, t + 2T, ... of ",
+                                              chunk,
+                                              " iterations, __omp_stride is T * ",
+                                              ParenthesizeIfNeeded(chunk));
+        } else {
+            mOutputFormatHelper.AppendNewLine("// each of the T threads gets one block of __omp_trip_count / T "
+                                              "iterations, the first __omp_trip_count % T threads one more");
+        }
+
+        mOutputFormatHelper.AppendNewLine("__kmpc_for_static_init_",
+                                          suffix,
+                                          "(&",
+                                          loc,
+                                          ", ",
+                                          threadId,
+                                          ", ",
+                                          schedule.type,
+                                          ", &__omp_last, &__omp_lb, &__omp_ub, &__omp_stride, 1, ",
+                                          chunk,
+                                          ");");
+
+        if(schedule.chunk) {
+            mOutputFormatHelper.Append(
+                "for(; __omp_lb < __omp_trip_count; __omp_lb += __omp_stride, __omp_ub += __omp_stride) ");
+            mOutputFormatHelper.OpenScope();
+            clampUpperBound();
+            insertIterations();
+            mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+            mOutputFormatHelper.AppendNewLine();
+
+        } else {
+            clampUpperBound();
+            insertIterations();
+        }
+
+        mOutputFormatHelper.AppendNewLine("__kmpc_for_static_fini(&", loc, ", ", threadId, ");");
+
+    } else {
+        mOutputFormatHelper.AppendNewLine(
+            "// each thread asks the runtime for its next block of iterations until none is left",
+            ordered ? ", the blocks are passed in order" : "");
+        mOutputFormatHelper.AppendNewLine("__kmpc_dispatch_init_",
+                                          suffix,
+                                          "(&",
+                                          loc,
+                                          ", ",
+                                          threadId,
+                                          ", ",
+                                          schedule.type,
+                                          ", 0, __omp_trip_count - 1, 1, ",
+                                          chunk,
+                                          ");");
+        mOutputFormatHelper.Append("while(__kmpc_dispatch_next_",
+                                   suffix,
+                                   "(&",
+                                   loc,
+                                   ", ",
+                                   threadId,
+                                   ", &__omp_last, &__omp_lb, &__omp_ub, &__omp_stride)) ");
+        mOutputFormatHelper.OpenScope();
+        insertIterations();
+        mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+        mOutputFormatHelper.AppendNewLine();
+    }
+
+    // The thread which ran the last iteration updates the originals of the lastprivate variables.
+    for(const auto* lastprivate : GetOMPClauseVars<OMPLastprivateClause>(stmt)) {
+        const auto name = GetName(*lastprivate);
+
+        mOutputFormatHelper.Append("if(__omp_last) ");
+        mOutputFormatHelper.OpenScope();
+        mOutputFormatHelper.AppendNewLine("__omp_shared_", name, " = ", name, ";");
+        mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+        mOutputFormatHelper.AppendNewLine();
+    }
+
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+    mOutputFormatHelper.AppendNewLine();
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertOMPParallel(const OMPExecutableDirective& stmt)
 {
-    return (... && !isa<Args>(stmt));
-}
-//-----------------------------------------------------------------------------
+    const auto& ctx = GetGlobalAST();
+    const auto [line, column] = GetSpellingLineColumn(ctx.getSourceManager(), stmt.getBeginLoc());
+    const std::string loc{BuildInternalVarName(StrCat("omp_loc", line, "_", column))};
+    const std::string outlined{BuildInternalVarName(StrCat("omp_outlined", line, "_", column))};
 
-void CodeGenerator::HandleCompoundStmt(const CompoundStmt* stmt)
-{
-    for(const auto* item : stmt->body()) {
-        InsertArg(item);
+    // The outlined function gets the shared variables by reference and the firstprivate ones by value. The reduction
+    // and lastprivate variables are the originals, which the private copies update at the end.
+    const auto privates      = GetOMPClauseVars<OMPPrivateClause>(stmt);
+    const auto firstprivates = GetOMPClauseVars<OMPFirstprivateClause>(stmt);
+    auto       updated       = GetOMPClauseVars<OMPLastprivateClause>(stmt);
 
-        if(IsStmtRequieringSemi<IfStmt, ForStmt, DeclStmt, WhileStmt, DoStmt, CXXForRangeStmt, SwitchStmt>(item)) {
-            mOutputFormatHelper.AppendSemiNewLine();
-        }
+    for(const auto& reduction : GetOMPReductions(stmt)) {
+        updated.push_back(reduction.var);
     }
-}
-//-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const IfStmt* stmt)
-{
-    const std::string cexpr{stmt->isConstexpr() ? kwSpaceConstExpr : ""};
-    const bool        hasInit{stmt->getInit() || stmt->getConditionVariable()};
+    llvm::SmallVector<std::string, 8> params{"int * __global_tid", "int * __bound_tid"};
+    llvm::SmallVector<std::string, 8> forkArgs{};
+    llvm::SmallVector<std::string, 8> callArgs{};
+    bool                              capturesThis{};
 
-    if(hasInit) {
-        mOutputFormatHelper.OpenScope();
+    for(const auto& capture : stmt.getInnermostCapturedStmt()->captures()) {
+        if(capture.capturesThis()) {
+            capturesThis = true;
+            continue;
 
-        if(const auto* conditionVar = stmt->getConditionVariable()) {
-            InsertArg(conditionVar);
+        } else if(not capture.capturesVariable() and not capture.capturesVariableByCopy()) {
+            continue;
         }
 
-        if(const auto* init = stmt->getInit()) {
-            InsertArg(init);
+        const auto* var = capture.getCapturedVar();
+
+        // The variables clang introduces for the expressions of clauses and loop bounds are not part of the code.
+        if(isa<OMPCapturedExprDecl>(var) or llvm::is_contained(privates, var)) {
+            continue;
         }
-    }
 
-    mOutputFormatHelper.Append("if", cexpr);
+        const auto name = GetName(*var);
 
-    WrapInParens([&]() { InsertArg(stmt->getCond()); }, AddSpaceAtTheEnd::Yes);
+        if(llvm::is_contained(firstprivates, var)) {
+            params.push_back(GetTypeNameAsParameter(var->getType(), name));
+            forkArgs.push_back(name);
 
-    const auto* body = stmt->getThen();
+        } else {
+            params.push_back(
+                GetTypeNameAsParameter(ctx.getLValueReferenceType(var->getType()),
+                                       llvm::is_contained(updated, var) ? StrCat("__omp_shared_", name) : name));
+            forkArgs.push_back(StrCat("&", name));
+        }
 
-    InsertArg(body);
+        callArgs.push_back(name);
+    }
 
-    const bool isBodyBraced = isa<CompoundStmt>(body);
+    mOutputFormatHelper.AppendNewLine("/* ", GetOMPPragma(stmt), " */");
+    mOutputFormatHelper.OpenScope();
+    mOutputFormatHelper.AppendNewLine(GetOMPLocation(stmt, loc, OMPIdentKmpc));
 
-    if(!isBodyBraced && !isa<NullStmt>(body)) {
-        mOutputFormatHelper.AppendSemiNewLine();
-    }
+    mOutputFormatHelper.Append("auto ", outlined, " = [", capturesThis ? "this" : "", "](");
+    ForEachArg(params, [&](const auto& param) { mOutputFormatHelper.Append(param); });
+    mOutputFormatHelper.Append(") ");
+    mOutputFormatHelper.OpenScope();
 
-    // else
-    if(const auto* elsePart = stmt->getElse()) {
-        const std::string cexprElse{stmt->isConstexpr() ? StrCat("/* ", kwConstExprSpace, "*/ ") : ""};
+    {
+        const std::string threadId{"*__global_tid"};
+        const auto        outerThreadId = std::exchange(gOMPThreadId, threadId);
 
-        if(isBodyBraced) {
-            mOutputFormatHelper.Append(' ');
+        InsertOMPPrivates(stmt, false);
+
+        if(const auto* loop = dyn_cast<OMPLoopDirective>(&stmt)) {
+            InsertOMPLoop(*loop, loc, threadId);
+        } else {
+            InsertOMPBody(GetOMPAssociatedStmt(stmt));
         }
 
-        mOutputFormatHelper.Append("else ", cexprElse);
+        // The join barrier at the end of the parallel region follows, the reduction does not need one of its own.
+        InsertOMPReductions(stmt, loc, threadId, true);
 
-        const bool needScope = isa<IfStmt>(elsePart);
-        if(needScope) {
-            mOutputFormatHelper.OpenScope();
-        }
+        gOMPThreadId = outerThreadId;
+    }
 
-        InsertArg(elsePart);
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+    mOutputFormatHelper.AppendSemiNewLine();
 
-        // an else with just a single statement seems not to carry a semi-colon at the end
-        if(!needScope && !isa<CompoundStmt>(elsePart)) {
-            mOutputFormatHelper.AppendSemiNewLine();
+    auto insertArgs = [&](const auto& args) {
+        for(const auto& arg : args) {
+            mOutputFormatHelper.Append(", ", arg);
         }
+    };
 
-        if(needScope) {
-            mOutputFormatHelper.CloseScope();
-        }
+    auto insertForkCall = [&] {
+        mOutputFormatHelper.Append(
+            "__kmpc_fork_call(&", loc, ", ", forkArgs.size(), ", reinterpret_cast<kmpc_micro>(+", outlined, ")");
+        insertArgs(forkArgs);
+        mOutputFormatHelper.AppendNewLine(");");
+    };
+
+    if(const auto* numThreads = stmt.getSingleClause<OMPNumThreadsClause>()) {
+        mOutputFormatHelper.AppendNewLine("__kmpc_push_num_threads(&",
+                                          loc,
+                                          ", __kmpc_global_thread_num(&",
+                                          loc,
+                                          "), ",
+                                          GetOMPExprAsString(numThreads->getNumThreads(), mLambdaStack),
+                                          ");");
     }
 
-    mOutputFormatHelper.AppendNewLine();
+    if(const auto* ifClause = stmt.getSingleClause<OMPIfClause>()) {
+        mOutputFormatHelper.Append("if(", GetOMPExprAsString(ifClause->getCondition(), mLambdaStack), ") ");
+        mOutputFormatHelper.OpenScope();
+        insertForkCall();
+        mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+        mOutputFormatHelper.Append(" else ");
+        mOutputFormatHelper.OpenScope();
 
-    if(hasInit) {
-        mOutputFormatHelper.CloseScope();
+        // Without a team the encountering thread runs the outlined function itself.
+        mOutputFormatHelper.AppendNewLine("int __omp_gtid = __kmpc_global_thread_num(&", loc, ");");
+        mOutputFormatHelper.AppendNewLine("int __omp_bound_tid = 0;");
+        mOutputFormatHelper.AppendNewLine("__kmpc_serialized_parallel(&", loc, ", __omp_gtid);");
+        mOutputFormatHelper.Append(outlined, "(&__omp_gtid, &__omp_bound_tid");
+        insertArgs(callArgs);
+        mOutputFormatHelper.AppendNewLine(");");
+        mOutputFormatHelper.AppendNewLine("__kmpc_end_serialized_parallel(&", loc, ", __omp_gtid);");
+        mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
         mOutputFormatHelper.AppendNewLine();
+
+    } else {
+        insertForkCall();
     }
 
-    // one blank line after statement
-    mOutputFormatHelper.AppendNewLine();
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const ForStmt* stmt)
+void CodeGenerator::InsertArg(const OMPParallelDirective* stmt)
 {
-    // https://github.com/vtjnash/clang-ast-builder/blob/master/AstBuilder.cpp
-    // http://clang-developers.42468.n3.nabble.com/Adding-nodes-to-Clang-s-AST-td4054800.html
-    // https://stackoverflow.com/questions/30451485/how-to-clone-or-create-an-ast-stmt-node-of-clang/38899615
-
-    if(GetInsightsOptions().UseAltForSyntax) {
-        auto* rwStmt = const_cast<ForStmt*>(stmt);
-
-        const auto&        ctx = GetGlobalAST();
-        std::vector<Stmt*> bodyStmts{};
-
-        AddBodyStmts(bodyStmts, rwStmt->getBody());
-        AddStmt(bodyStmts, rwStmt->getInc());
-
-        auto* condition = [&]() -> Expr* {
-            if(rwStmt->getCond()) {
-                return rwStmt->getCond();
-            }
+    if(not IsOptionEnabled(InsightsOptionBit::ShowOpenMP)) {
+        TODO(stmt, mOutputFormatHelper);
+        return;
+    }
 
-            return new(ctx) CXXBoolLiteralExpr(true, {}, stmt->getBeginLoc());
-        }();
+    InsertOMPParallel(*stmt);
+}
+//-----------------------------------------------------------------------------
 
-        ArrayRef<Stmt*> bodyStmtsRef{bodyStmts};
-        auto*           outerBody = CompoundStmt::Create(ctx, bodyStmtsRef, stmt->getBeginLoc(), stmt->getEndLoc());
-        auto*           whileStmt = WhileStmt::Create(ctx, nullptr, condition, outerBody, stmt->getBeginLoc());
+void CodeGenerator::InsertArg(const OMPParallelForDirective* stmt)
+{
+    if(IsOptionEnabled(InsightsOptionBit::ShowOpenMP)) {
+        InsertOMPParallel(*stmt);
+    }
+}
+//-----------------------------------------------------------------------------
 
-        std::vector<Stmt*> outerScopeStmts{};
-        AddStmt(outerScopeStmts, rwStmt->getInit());
-        AddStmt(outerScopeStmts, whileStmt);
+void CodeGenerator::InsertArg(const OMPForDirective* stmt)
+{
+    if(not IsOptionEnabled(InsightsOptionBit::ShowOpenMP)) {
+        TODO(stmt, mOutputFormatHelper);
+        return;
+    }
 
-        ArrayRef<Stmt*> outerScopeStmtsRef{outerScopeStmts};
-        auto* outerScopeBody = CompoundStmt::Create(ctx, outerScopeStmtsRef, stmt->getBeginLoc(), stmt->getEndLoc());
+    const auto [line, column] = GetSpellingLineColumn(GetGlobalAST().getSourceManager(), stmt->getBeginLoc());
+    const std::string loc{BuildInternalVarName(StrCat("omp_loc", line, "_", column))};
+    const bool        nowait{nullptr != stmt->getSingleClause<OMPNowaitClause>()};
 
-        InsertArg(outerScopeBody);
-        mOutputFormatHelper.AppendNewLine();
+    mOutputFormatHelper.AppendNewLine("/* ", GetOMPPragma(*stmt), " */");
+    mOutputFormatHelper.OpenScope();
+    mOutputFormatHelper.AppendNewLine(GetOMPLocation(*stmt, loc, OMPIdentKmpc | OMPIdentWorkLoop));
 
-    } else {
+    const auto threadId      = InsertOMPThreadId(mOutputFormatHelper, loc);
+    const auto outerThreadId = std::exchange(gOMPThreadId, threadId);
 
-        {
-            // We need to handle the case that a lambda is used in the init-statement of the for-loop.
-            LAMBDA_SCOPE_HELPER(VarDecl);
+    InsertOMPPrivates(*stmt, true);
+    InsertOMPLoop(*stmt, loc, threadId);
+    InsertOMPReductions(*stmt, loc, threadId, nowait);
 
-            mOutputFormatHelper.Append("for");
+    if(not nowait) {
+        mOutputFormatHelper.AppendNewLine("__kmpc_barrier(&", loc, ", ", threadId, ");");
+    }
 
-            WrapInParens(
-                [&]() {
-                    if(const auto* init = stmt->getInit()) {
-                        MultiStmtDeclCodeGenerator codeGenerator{mOutputFormatHelper, mLambdaStack};
-                        codeGenerator.InsertArg(init);
+    gOMPThreadId = outerThreadId;
 
-                    } else {
-                        mOutputFormatHelper.Append("; ");
-                    }
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+}
+//-----------------------------------------------------------------------------
 
-                    InsertArg(stmt->getCond());
-                    mOutputFormatHelper.Append("; ");
+void CodeGenerator::InsertArg(const OMPOrderedDirective* stmt)
+{
+    if(not IsOptionEnabled(InsightsOptionBit::ShowOpenMP)) {
+        return;
+    }
 
-                    InsertArg(stmt->getInc());
-                },
-                AddSpaceAtTheEnd::Yes);
-        }
+    const auto [line, column] = GetSpellingLineColumn(GetGlobalAST().getSourceManager(), stmt->getBeginLoc());
+    const std::string loc{BuildInternalVarName(StrCat("omp_loc", line, "_", column))};
 
-        const auto* body = stmt->getBody();
-        const bool  hasCompoundStmt{isa<CompoundStmt>(body)};
+    mOutputFormatHelper.AppendNewLine("/* ", GetOMPPragma(*stmt), " */");
+    mOutputFormatHelper.OpenScope();
+    mOutputFormatHelper.AppendNewLine(GetOMPLocation(*stmt, loc, OMPIdentKmpc));
 
-        if(hasCompoundStmt) {
-            mOutputFormatHelper.AppendNewLine();
-        }
+    const auto threadId = InsertOMPThreadId(mOutputFormatHelper, loc);
 
-        InsertArg(body);
+    if(const auto* body = GetOMPAssociatedStmt(*stmt)) {
+        // The threads enter the region one after another in the order of the iterations of the loop.
+        mOutputFormatHelper.AppendNewLine("__kmpc_ordered(&", loc, ", ", threadId, ");");
+        InsertOMPBody(body);
+        mOutputFormatHelper.AppendNewLine("__kmpc_end_ordered(&", loc, ", ", threadId, ");");
 
-        // Note: an empty for-loop carries a simi-colon at the end
-        if(hasCompoundStmt) {
-            mOutputFormatHelper.AppendNewLine();
-        } else {
-            if(!isa<CompoundStmt>(body) && !isa<NullStmt>(body)) {
-                mOutputFormatHelper.AppendSemiNewLine();
-            }
-        }
+    } else {
+        mOutputFormatHelper.AppendNewLine(
+            "// waits for the iterations of the depend clauses with __kmpc_doacross_wait or signals them with "
+            "__kmpc_doacross_post");
     }
 
-    mOutputFormatHelper.AppendNewLine();
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
 }
 //-----------------------------------------------------------------------------
 
@@ -1603,6 +4071,19 @@ void CodeGenerator::InsertArg(const CStyleCastExpr* stmt)
 
 void CodeGenerator::InsertArg(const CXXNewExpr* stmt)
 {
+    if(IsOptionEnabled(InsightsOptionBit::ShowAllocations)) {
+        InsertAllocationNote(mOutputFormatHelper, GetAllocationNote(*stmt), stmt->getBeginLoc());
+    }
+
+    // The initializer of an array new is the one of each element, of which there can be any number.
+    if(IsOptionEnabled(InsightsOptionBit::ShowZeroInit) and not stmt->isArray()) {
+        if(const auto note =
+               GetZeroInitNoteAndRecord(stmt->getAllocatedType(), stmt->getInitializer(), stmt->getBeginLoc());
+           not note.empty()) {
+            mOutputFormatHelper.Append("/* ", note, " */ ");
+        }
+    }
+
     mOutputFormatHelper.Append("new ");
 
     if(stmt->getNumPlacementArgs()) {
@@ -1653,54 +4134,117 @@ void CodeGenerator::InsertArg(const CXXNewExpr* stmt)
 
 void CodeGenerator::InsertArg(const MaterializeTemporaryExpr* stmt)
 {
+    if(IsOptionEnabled(InsightsOptionBit::ShowStringTemporaries)) {
+        // Without an extending declaration the temporary is bound to a parameter or lives in an expression.
+        if(const auto note = GetStringTemporaryNote(*stmt->getTemporary(), not stmt->getExtendingDecl());
+           not note.empty()) {
+            mOutputFormatHelper.Append("/* ", note, " */ ");
+        }
+    }
+
+    // A temporary bound to a reference lives as long as the reference, not only to the end of the full-expression.
+    if(mTemporaries and stmt->getExtendingDecl()) {
+        auto* temporaries = std::exchange(mTemporaries, nullptr);
+
+        InsertArg(stmt->getTemporary());
+
+        mTemporaries = temporaries;
+        return;
+    }
+
     InsertArg(stmt->getTemporary());
 }
 //-----------------------------------------------------------------------------
 
+/// \brief Get the callee of \p stmt, if it is a plain \c DeclRefExpr.
+static const DeclRefExpr* GetOperatorCallee(const CXXOperatorCallExpr& stmt)
+{
+    return dyn_cast_or_null<DeclRefExpr>(stmt.getCallee()->IgnoreImpCasts());
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Check whether \p stmt is a binary operator call where both operands are plain \c DeclRefExpr's.
+static bool IsOperatorCallOfDeclRefs(const CXXOperatorCallExpr& stmt)
+{
+    return (2 == stmt.getNumArgs()) and GetOperatorCallee(stmt) and
+           isa<DeclRefExpr>(stmt.getArg(0)->IgnoreImpCasts()) and isa<DeclRefExpr>(stmt.getArg(1)->IgnoreImpCasts());
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const CXXOperatorCallExpr* stmt)
 {
     LAMBDA_SCOPE_HELPER(OperatorCallExpr);
 
-    const auto* callee = dyn_cast_or_null<DeclRefExpr>(stmt->getCallee()->IgnoreImpCasts());
-    const bool  isCXXMethod{callee && isa<CXXMethodDecl>(callee->getDecl())};
+    if(IsOptionEnabled(InsightsOptionBit::ShowAtomics) and InsertAtomicOperation(*stmt)) {
+        return;
+    }
 
-    if(2 == stmt->getNumArgs()) {
-        const auto* param1 = dyn_cast_or_null<DeclRefExpr>(stmt->getArg(0)->IgnoreImpCasts());
-        const auto* param2 = dyn_cast_or_null<DeclRefExpr>(stmt->getArg(1)->IgnoreImpCasts());
+    if(IsOptionEnabled(InsightsOptionBit::ShowMemcpy) and InsertMemcpy(*stmt)) {
+        return;
+    }
 
-        if(callee && param1 && param2) {
+    // The notes of a single call, they go in front of each call of a chain.
+    auto insertCallNotes = [&](const CXXOperatorCallExpr& call) {
+        // The old value of the left-hand side is released, a copy also increments the counter of the right-hand side.
+        if(const auto* counter = GetRefCountName(call.getArg(0)->getType());
+           counter and (OO_Equal == call.getOperator()) and IsOptionEnabled(InsightsOptionBit::ShowRefCounts)) {
+            if(const auto* method = dyn_cast_or_null<CXXMethodDecl>(call.getCalleeDecl());
+               method and (1 == method->getNumParams()) and
+               method->getParamDecl(0)->getType()->isLValueReferenceType()) {
+                mOutputFormatHelper.Append("/* atomic ", counter, " increment and decrement */ ");
+                ++gFunctionCounts.refCountIncrements;
 
-            const std::string replace = [&]() {
-                if(isa<CXXMethodDecl>(callee->getDecl())) {
-                    const std::string tmpl = FormatVarTemplateSpecializationDecl(param1->getDecl(), {});
+            } else {
+                mOutputFormatHelper.Append("/* atomic ", counter, " decrement */ ");
+            }
 
-                    return StrCat(GetName(*param1), tmpl, ".", GetName(*callee), "(", GetName(*param2), ")");
-                } else {
-                    return StrCat(GetName(*callee), "(", GetName(*param1), ", ", GetName(*param2), ")");
-                }
-            }();
+            ++gFunctionCounts.refCountDecrements;
+        }
 
-            mOutputFormatHelper.Append(replace);
+        // A member operator is called on its first argument.
+        InsertVirtualCallNote(dyn_cast_or_null<CXXMethodDecl>(call.getCalleeDecl()), call.getArg(0), false);
 
-            return;
+        if(IsOptionEnabled(InsightsOptionBit::ShowFunctionErasure) and IsFunctionInvocation(call)) {
+            mOutputFormatHelper.Append("/* std::function: indirect call */ ");
         }
-    }
+    };
+
+    insertCallNotes(*stmt);
+
+    if(IsOperatorCallOfDeclRefs(*stmt)) {
+        const auto* callee = GetOperatorCallee(*stmt);
+        const auto* param1 = dyn_cast_or_null<DeclRefExpr>(stmt->getArg(0)->IgnoreImpCasts());
+        const auto* param2 = dyn_cast_or_null<DeclRefExpr>(stmt->getArg(1)->IgnoreImpCasts());
+
+        const std::string replace = [&]() {
+            if(isa<CXXMethodDecl>(callee->getDecl())) {
+                const std::string tmpl = FormatVarTemplateSpecializationDecl(param1->getDecl(), {});
+
+                return StrCat(GetName(*param1), tmpl, ".", GetName(*callee), "(", GetName(*param2), ")");
+            } else {
+                return StrCat(GetName(*callee), "(", GetName(*param1), ", ", GetName(*param2), ")");
+            }
+        }();
 
-    auto        cb           = stmt->child_begin();
-    const auto* fallbackArg0 = stmt->getArg(0);
+        mOutputFormatHelper.Append(replace);
 
-    // arg0 := operator
-    // skip arg0
-    ++cb;
+        return;
+    }
 
-    const auto* arg1 = *cb;
-    ++cb;
+    auto isCXXMethod = [](const CXXOperatorCallExpr& call) {
+        const auto* callee = GetOperatorCallee(call);
+        return callee && isa<CXXMethodDecl>(callee->getDecl());
+    };
 
     // operators in a namespace but outside a class so operator goes first
-    if(!isCXXMethod) {
+    auto insertOperatorName = [&](const CXXOperatorCallExpr& call) {
+        if(isCXXMethod(call)) {
+            return;
+        }
+
         // happens for UnresolvedLooupExpr
-        if(not callee) {
-            if(const auto* adl = dyn_cast_or_null<UnresolvedLookupExpr>(stmt->getCallee())) {
+        if(const auto* callee = GetOperatorCallee(call); not callee) {
+            if(const auto* adl = dyn_cast_or_null<UnresolvedLookupExpr>(call.getCallee())) {
                 InsertArg(adl);
             }
         } else {
@@ -1708,39 +4252,80 @@ void CodeGenerator::InsertArg(const CXXOperatorCallExpr* stmt)
         }
 
         mOutputFormatHelper.Append("(");
-    }
+    };
 
-    // insert the arguments
-    if(isa<DeclRefExpr>(fallbackArg0)) {
-        InsertArgWithParensIfNeeded(fallbackArg0);
+    // everything after the first argument
+    auto insertRemainingArgs = [&](const CXXOperatorCallExpr& call) {
+        // if it is a class operator the operator follows now
+        if(isCXXMethod(call)) {
+            const OverloadedOperatorKind opKind = call.getOperator();
 
-    } else {
-        InsertArgWithParensIfNeeded(arg1);
+            mOutputFormatHelper.Append(".operator", getOperatorSpelling(opKind), "(");
+        }
+
+        // skip the callee and the first argument, at least the call-operator can have more than 2 parameters
+        const auto childRange = llvm::make_range(std::next(call.child_begin(), 2), call.child_end());
+
+        ForEachArg(childRange, [&](const auto& child) {
+            if(!isCXXMethod(call)) {
+                // in global operators we need to separate the two parameters by comma
+                mOutputFormatHelper.Append(", ");
+            }
+
+            InsertArg(child);
+        });
+
+        mOutputFormatHelper.Append(')');
+    };
+
+    // A chain like std::cout << a << b nests on the first argument. As for a BinaryOperator, walk down the chain
+    // instead of recursing into it. The lambda scopes of the nested calls are opened and closed in the same order as
+    // with the recursion.
+    llvm::SmallVector<const CXXOperatorCallExpr*, 8> chain{stmt};
+
+    // A call which --show-atomics or --show-memcpy may replace as a whole ends the chain, it goes through InsertArg.
+    auto isReplaceable = [](const CXXOperatorCallExpr& call) {
+        return (IsOptionEnabled(InsightsOptionBit::ShowAtomics) and GetAtomicOperation(call)) or
+               (IsOptionEnabled(InsightsOptionBit::ShowMemcpy) and (OO_Equal == call.getOperator()));
+    };
+
+    for(const auto* arg0 = dyn_cast<CXXOperatorCallExpr>(stmt->getArg(0));
+        arg0 and not IsOperatorCallOfDeclRefs(*arg0) and not isReplaceable(*arg0);
+        arg0 = dyn_cast<CXXOperatorCallExpr>(arg0->getArg(0))) {
+        chain.push_back(arg0);
     }
 
-    // if it is a class operator the operator follows now
-    if(isCXXMethod) {
-        const OverloadedOperatorKind opKind = stmt->getOperator();
+    std::forward_list<LambdaScopeHandler> lambdaScopes{};
 
-        mOutputFormatHelper.Append(".operator", getOperatorSpelling(opKind), "(");
+    insertOperatorName(*stmt);
+
+    for(size_t i = 1; i < chain.size(); ++i) {
+        lambdaScopes.emplace_front(mLambdaStack, mOutputFormatHelper, LambdaCallerType::OperatorCallExpr);
+        insertCallNotes(*chain[i]);
+        insertOperatorName(*chain[i]);
     }
 
-    // consume all remaining arguments
-    const auto childRange = llvm::make_range(cb, stmt->child_end());
+    // insert the arguments
+    InsertArgWithParensIfNeeded(chain.back()->getArg(0));
+
+    for(const auto* call : llvm::reverse(chain)) {
+        insertRemainingArgs(*call);
 
-    // at least the call-operator can have more than 2 parameters
-    ForEachArg(childRange, [&](const auto& child) {
-        if(!isCXXMethod) {
-            // in global operators we need to separate the two parameters by comma
-            mOutputFormatHelper.Append(", ");
+        if(call != stmt) {
+            lambdaScopes.pop_front();
         }
+    }
+}
+//-----------------------------------------------------------------------------
 
-        InsertArg(child);
-    });
-
-    mOutputFormatHelper.Append(')');
+#if IS_CLANG_NEWER_THAN(9)
+void CodeGenerator::InsertArg(const CXXRewrittenBinaryOperator* stmt)
+{
+    // A C++20 rewritten comparison like `a != b` is shown as what it calls, for example `!(a == b)`.
+    InsertArg(stmt->getSemanticForm());
 }
 //-----------------------------------------------------------------------------
+#endif
 
 void CodeGenerator::InsertArg(const LambdaExpr* stmt)
 {
@@ -1768,7 +4353,40 @@ void CodeGenerator::InsertArg(const CXXThisExpr* stmt)
 
 void CodeGenerator::InsertArg(const CXXBindTemporaryExpr* stmt)
 {
-    InsertArg(stmt->getSubExpr());
+    const auto* dtor = stmt->getTemporary()->getDestructor();
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowRefCounts)) {
+        if(const auto* counter = GetRefCountName(stmt->getType())) {
+            mOutputFormatHelper.Append("/* atomic ", counter, " decrement at the end of the full-expression */ ");
+            ++gFunctionCounts.refCountDecrements;
+        }
+    }
+
+    if(not mTemporaries or not dtor) {
+        InsertArg(stmt->getSubExpr());
+        return;
+    }
+
+    // --show-temporaries: declare the temporary before the statement and use it by its name.
+    auto&       ofmToInsert = mTemporaries->outputFormatHelper;
+    const auto& sm          = GetGlobalAST().getSourceManager();
+    const auto [lineNo, columnNo] = GetSpellingLineColumn(sm, stmt->getBeginLoc());
+    const std::string name{BuildInternalVarName(StrCat("temporary", lineNo, "_", columnNo))};
+
+    OutputFormatHelper ofm{};
+    ofm.SetIndent(ofmToInsert, OutputFormatHelper::SkipIndenting::Yes);
+    ofm.Append(GetTypeNameAsParameter(stmt->getType(), name), " = ");
+
+    // Temporaries inside this one are constructed first, they are declared first as well.
+    CodeGenerator codeGenerator{ofm, mLambdaStack};
+    codeGenerator.mTemporaries = mTemporaries;
+    codeGenerator.InsertArg(stmt->getSubExpr());
+    ofm.AppendSemiNewLine();
+
+    ofmToInsert.AppendAt(mTemporaries->anchor, ofm.GetString());
+    mTemporaries->destructors.push_back(StrCat(name, ".", dtor->getNameAsString(), "();"));
+
+    mOutputFormatHelper.Append(name);
 }
 //-----------------------------------------------------------------------------
 
@@ -1946,6 +4564,10 @@ void CodeGenerator::InsertArg(const CXXTryStmt* stmt)
 
 void CodeGenerator::InsertArg(const CXXCatchStmt* stmt)
 {
+    if(IsOptionEnabled(InsightsOptionBit::ShowExceptionCost)) {
+        mOutputFormatHelper.Append(" /* ", GetCatchNote(*stmt), " */");
+    }
+
     mOutputFormatHelper.Append(" catch");
 
     WrapInParens(
@@ -1959,21 +4581,48 @@ void CodeGenerator::InsertArg(const CXXCatchStmt* stmt)
         },
         AddSpaceAtTheEnd::Yes);
 
-    InsertArg(stmt->getHandlerBlock());
+    InsertArg(stmt->getHandlerBlock());
+}
+//-----------------------------------------------------------------------------
+
+void CodeGenerator::InsertArg(const CXXThrowExpr* stmt)
+{
+    if(IsOptionEnabled(InsightsOptionBit::ShowExceptionCost)) {
+        if(const auto note = GetThrowNote(*stmt); not note.empty()) {
+            mOutputFormatHelper.Append("/* ", note, " */ ");
+        }
+    }
+
+    mOutputFormatHelper.Append("throw ");
+
+    InsertArg(stmt->getSubExpr());
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const CXXThrowExpr* stmt)
+/// \brief Whether \p expr is a literal, its value is plain to see.
+static bool IsLiteral(const Expr* expr)
 {
-    mOutputFormatHelper.Append("throw ");
+    expr = expr->IgnoreParenImpCasts();
 
-    InsertArg(stmt->getSubExpr());
+    return isa<IntegerLiteral>(expr) or isa<CharacterLiteral>(expr) or isa<CXXBoolLiteralExpr>(expr) or
+           isa<FloatingLiteral>(expr);
 }
 //-----------------------------------------------------------------------------
 
 void CodeGenerator::InsertArg(const ConstantExpr* stmt)
 {
+    if(IsOptionEnabled(InsightsOptionBit::ShowConstantEvaluation) and not gInConstantExpr and
+       not IsLiteral(stmt->getSubExpr())) {
+        if(const auto value = EvaluateConstant(*stmt)) {
+            mOutputFormatHelper.Append("/* evaluated at compile time", value->empty() ? "" : ": ", *value, " */ ");
+        }
+    }
+
+    const bool inConstantExpr{std::exchange(gInConstantExpr, true)};
+
     InsertArg(stmt->getSubExpr());
+
+    gInConstantExpr = inConstantExpr;
 }
 //-----------------------------------------------------------------------------
 
@@ -2030,7 +4679,6 @@ void CodeGenerator::InsertCXXMethodHeader(const CXXMethodDecl* stmt, OutputForma
     // name and the type. The CXXMethodDecl above knows only the type.
     if(const auto* ctor = dyn_cast_or_null<CXXConstructorDecl>(stmt)) {
         CodeGenerator codeGenerator{initOutputFormatHelper, mLambdaStack};
-        codeGenerator.mCurrentPos                = mCurrentPos;
         codeGenerator.mCurrentFieldPos           = mCurrentFieldPos;
         codeGenerator.mOutputFormatHelperOutside = &mOutputFormatHelper;
 
@@ -2073,7 +4721,7 @@ void CodeGenerator::InsertCXXMethodHeader(const CXXMethodDecl* stmt, OutputForma
     if(stmt->isDeleted()) {
         mOutputFormatHelper.AppendNewLine(" = delete;");
 
-    } else if(stmt->isDefaulted()) {
+    } else if(stmt->isDefaulted() and not IsExpandedDefaultedComparison(*stmt)) {
         mOutputFormatHelper.AppendNewLine(" = default;");
     }
 }
@@ -2081,12 +4729,15 @@ void CodeGenerator::InsertCXXMethodHeader(const CXXMethodDecl* stmt, OutputForma
 
 void CodeGenerator::InsertCXXMethodDecl(const CXXMethodDecl* stmt, SkipBody skipBody)
 {
+    // The member initializers of a constructor count as well.
+    FunctionSummaryScope functionSummary{};
+
     OutputFormatHelper initOutputFormatHelper{};
     initOutputFormatHelper.SetIndent(mOutputFormatHelper, OutputFormatHelper::SkipIndenting::Yes);
 
     InsertCXXMethodHeader(stmt, initOutputFormatHelper);
 
-    if(not stmt->isUserProvided()) {
+    if(not stmt->isUserProvided() and not IsExpandedDefaultedComparison(*stmt)) {
         InsertTemplateGuardEnd(stmt);
         return;
     }
@@ -2110,6 +4761,15 @@ void CodeGenerator::InsertCXXMethodDecl(const CXXMethodDecl* stmt, SkipBody skip
         InsertArg(stmt->getBody());
         mOutputFormatHelper.AppendNewLine();
 
+        functionSummary.InsertSummary(mOutputFormatHelper, *stmt);
+        InsertCoroutineFrameIfEnabled(mOutputFormatHelper, *stmt);
+        InsertAbiPassingIfEnabled(mOutputFormatHelper, *stmt);
+        InsertStackFrameIfEnabled(mOutputFormatHelper, *stmt);
+
+        if(IsExpandedDefaultedComparison(*stmt)) {
+            InsertDefaultedComparisonCost(mOutputFormatHelper, *stmt);
+        }
+
     } else if(not InsertLambdaStaticInvoker(stmt) || (SkipBody::Yes == skipBody)) {
         mOutputFormatHelper.AppendSemiNewLine();
     }
@@ -2190,6 +4850,8 @@ void CodeGenerator::InsertArg(const EnumConstantDecl* stmt)
 
 void CodeGenerator::InsertArg(const FieldDecl* stmt)
 {
+    mOutputFormatHelper.Append(GetCodeGenAttributes(*stmt));
+
     if(stmt->isMutable()) {
         mOutputFormatHelper.Append("mutable ");
     }
@@ -2490,7 +5152,7 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
         }
     }
 
-    mOutputFormatHelper.Append(GetClassOrStructTagName(*stmt), GetName(*stmt));
+    mOutputFormatHelper.Append(GetClassOrStructTagName(*stmt), GetCodeGenAttributes(*stmt), GetName(*stmt));
 
     // skip classes/struct's without a definition
     if(not stmt->hasDefinition() || not stmt->isCompleteDefinition()) {
@@ -2516,7 +5178,19 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
     mOutputFormatHelper.AppendNewLine();
     mOutputFormatHelper.OpenScope();
 
-    mCurrentFieldPos = mOutputFormatHelper.CurrentPos();
+    mCurrentFieldPos = mOutputFormatHelper.ReserveAnchor();
+
+    llvm::Optional<RecordLayoutAnnotator> layoutAnnotator{};
+    const bool showLayout{IsOptionEnabled(InsightsOptionBit::ShowLayout) or
+                          (stmt->isLambda() and IsOptionEnabled(InsightsOptionBit::ShowClosureLayout))};
+
+    if(showLayout and RecordLayoutAnnotator::HasLayout(*stmt)) {
+        layoutAnnotator.emplace(*stmt);
+    }
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowVTable)) {
+        InsertVPtr(mOutputFormatHelper, *stmt);
+    }
 
     OnceTrue        firstRecordDecl{};
     OnceTrue        firstDecl{};
@@ -2548,6 +5222,10 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
             }
         }
 
+        if(const auto* fieldDecl = dyn_cast_or_null<FieldDecl>(d); fieldDecl and layoutAnnotator) {
+            layoutAnnotator->InsertBeforeField(mOutputFormatHelper, *fieldDecl);
+        }
+
         InsertArg(d);
         formerKind = d->getKind();
     }
@@ -2682,6 +5360,15 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
             }
         }
 
+        if(layoutAnnotator) {
+            layoutAnnotator->InsertFooter(mOutputFormatHelper);
+
+            if(IsOptionEnabled(InsightsOptionBit::ShowClosureLayout)) {
+                layoutAnnotator->InsertFunctionBufferNote(mOutputFormatHelper,
+                                                          GetInsightsOptions().functionBufferSize);
+            }
+        }
+
         // close the class scope
         mOutputFormatHelper.CloseScope();
 
@@ -2692,12 +5379,39 @@ void CodeGenerator::InsertArg(const CXXRecordDecl* stmt)
         }
 
     } else {
+        if(layoutAnnotator) {
+            layoutAnnotator->InsertFooter(mOutputFormatHelper);
+        }
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowVTable)) {
+            InsertVTableLayout(mOutputFormatHelper, *stmt);
+        }
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowNoexceptMove)) {
+            if(const auto note = GetThrowingMoveNote(*stmt); not note.empty()) {
+                mOutputFormatHelper.AppendNewLine("/* ", note, " */");
+            }
+        }
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowSpecialMembers)) {
+            InsertSpecialMemberSummary(mOutputFormatHelper, *stmt);
+        }
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowFalseSharing) and RecordLayoutAnnotator::HasLayout(*stmt)) {
+            InsertFalseSharingReport(mOutputFormatHelper, *stmt);
+        }
+
         mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
     }
 
     mOutputFormatHelper.AppendSemiNewLine();
     mOutputFormatHelper.AppendNewLine();
 
+    if(not stmt->isLambda() and not GetInsightsOptions().fieldAccessCounts.empty() and
+       RecordLayoutAnnotator::HasLayout(*stmt)) {
+        InsertHotColdSplit(mOutputFormatHelper, *stmt);
+    }
+
     if(tmplRequiresIfDef) {
         mOutputFormatHelper.AppendNewLine("#endif");
     }
@@ -2730,15 +5444,102 @@ void CodeGenerator::InsertArg(const SizeOfPackExpr* stmt)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief Why the object \p source ends up copied or moved into the return slot instead of being constructed there.
+static std::string GetNoNrvoReason(const Expr& source, const QualType& returnType)
+{
+    if(const auto* callExpr = dyn_cast_or_null<CallExpr>(&source); callExpr and callExpr->isCallToStdMove()) {
+        return "std::move prevents it";
+    }
+
+    const auto* declRef = dyn_cast_or_null<DeclRefExpr>(&source);
+    const auto* varDecl = declRef ? dyn_cast_or_null<VarDecl>(declRef->getDecl()) : nullptr;
+
+    if(not varDecl) {
+        return "not a local object";
+    }
+
+    const std::string name{GetName(*varDecl)};
+
+    if(isa<ParmVarDecl>(varDecl)) {
+        return StrCat(name, " is a parameter");
+
+    } else if(not varDecl->hasLocalStorage()) {
+        return StrCat(name, " is not a local variable");
+
+    } else if(varDecl->getType().isVolatileQualified()) {
+        return StrCat(name, " is volatile");
+
+    } else if(not varDecl->getASTContext().hasSameUnqualifiedType(varDecl->getType(), returnType)) {
+        return StrCat("the type of ", name, " differs from the return type");
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief How the returned object of \p stmt gets into the return slot, see \c --show-elision.
+static std::string GetReturnSlotNote(const ReturnStmt& stmt)
+{
+    const auto* retVal = stmt.getRetValue();
+
+    // Only a function returning by value has a return slot, a reference is no prvalue.
+    if(not retVal or not retVal->getType()->isRecordType() or (VK_RValue != retVal->getValueKind())) {
+        return {};
+    }
+
+    if(const auto* nrvoCandidate = stmt.getNRVOCandidate()) {
+        if(nrvoCandidate->isNRVOVariable()) {
+            return StrCat("NRVO, ", GetName(*nrvoCandidate), " is constructed in the return slot");
+        }
+
+        return StrCat("no NRVO for ", GetName(*nrvoCandidate), ", another return returns a different object");
+    }
+
+    const auto* cxxConstructExpr = dyn_cast_or_null<CXXConstructExpr>(retVal->IgnoreImplicit());
+
+    // A prvalue initializes the return slot directly, guaranteed since C++17.
+    if(not cxxConstructExpr or not cxxConstructExpr->getConstructor()->isCopyOrMoveConstructor()) {
+        return "constructed in place in the return slot";
+
+    } else if(cxxConstructExpr->isElidable() and
+              isa<MaterializeTemporaryExpr>(cxxConstructExpr->getArg(0)->IgnoreImpCasts())) {
+        // Before C++17 the copy of a temporary is there, but elidable.
+        return "constructed in place in the return slot, the copy of the temporary is elided";
+    }
+
+    const std::string how{cxxConstructExpr->getConstructor()->isMoveConstructor() ? "moved" : "copied"};
+    const std::string reason{GetNoNrvoReason(*cxxConstructExpr->getArg(0)->IgnoreImplicit(), retVal->getType())};
+
+    if(reason.empty()) {
+        return StrCat(how, " into the return slot");
+    }
+
+    return StrCat(how, " into the return slot, no NRVO: ", reason);
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const ReturnStmt* stmt)
 {
     LAMBDA_SCOPE_HELPER(ReturnStmt);
-    mCurrentReturnPos = mOutputFormatHelper.CurrentPos();
+    mCurrentReturnPos = mOutputFormatHelper.ReserveAnchor();
 
     mOutputFormatHelper.Append("return");
 
     if(const auto* retVal = stmt->getRetValue()) {
         mOutputFormatHelper.Append(' ');
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowElision)) {
+            if(const auto note = GetReturnSlotNote(*stmt); not note.empty()) {
+                mOutputFormatHelper.Append("/* ", note, " */ ");
+            }
+        }
+
+        if(IsOptionEnabled(InsightsOptionBit::ShowPessimizingMoves)) {
+            if(const auto note = GetPessimizingReturnMoveNote(*stmt); not note.empty()) {
+                mOutputFormatHelper.Append("/* ", note, " */ ");
+            }
+        }
+
         InsertArg(retVal);
     }
 
@@ -2754,32 +5555,88 @@ void CodeGenerator::InsertArg(const NullStmt* /*stmt*/)
 
 void CodeGenerator::InsertArg(const CXXDefaultArgExpr* stmt)
 {
+    if(IsOptionEnabled(InsightsOptionBit::ShowDefaultArgs)) {
+        uint64_t constructions{};
+
+        if(const auto note = GetDefaultArgNote(*stmt, constructions); not note.empty()) {
+            mOutputFormatHelper.Append("/* ", note, " */ ");
+        }
+
+        gFunctionCounts.defaultArgConstructions += constructions;
+    }
+
     InsertArg(stmt->getExpr());
 }
 //-----------------------------------------------------------------------------
 
+/// \brief Insert a comment for the copies of the \p size elements of class type out of the backing array \p listName
+/// of a \c std::initializer_list, see \c --edu-show-initlist. Elements of other types get none.
+static void InsertInitializerListCopyNote(OutputFormatHelper&             outputFormatHelper,
+                                          const MaterializeTemporaryExpr& list,
+                                          const std::string&              listName,
+                                          const size_t                    size)
+{
+    const auto* arrayType = list.getType()->getAsArrayTypeUnsafe();
+
+    if(not arrayType or (0 == size)) {
+        return;
+    }
+
+    const auto  elementType = arrayType->getElementType().getUnqualifiedType();
+    const auto* record      = elementType->getAsCXXRecordDecl();
+
+    if(not record or not record->hasDefinition() or record->isDependentType()) {
+        return;
+    }
+
+    if(elementType.isTriviallyCopyableType(GetGlobalAST())) {
+        outputFormatHelper.AppendNewLine(
+            "/* the ", size, " elements are copied out of the const ", listName, ", trivial copies */");
+        return;
+    }
+
+    // The elements are const, the container can only copy them.
+    gFunctionCounts.nonTrivialCopies += size;
+
+    const auto elementName = GetName(elementType);
+
+    outputFormatHelper.AppendNewLine("/* the ",
+                                     size,
+                                     " elements are copied, never moved, out of the const ",
+                                     listName,
+                                     ": ",
+                                     size,
+                                     " calls of ",
+                                     elementName,
+                                     "(const ",
+                                     elementName,
+                                     " &)");
+    outputFormatHelper.AppendNewLine("   consider reserve(", size, ") and emplace_back for each element instead */");
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertArg(const CXXStdInitializerListExpr* stmt)
 {
-    if(GetInsightsOptions().UseShowInitializerList) {
+    if(IsOptionEnabled(InsightsOptionBit::UseShowInitializerList)) {
         if(not mCurrentPos.hasValue() && not mCurrentFieldPos.hasValue() && not mCurrentReturnPos.hasValue()) {
             return;
         }
 
-        std::string modifiers{};
-        size_t      variableInsertPos = mCurrentReturnPos.getValueOr(mCurrentPos.getValueOr(0));
-
-        auto& ofmToInsert = [&]() -> decltype(auto) {
-            if(not mCurrentPos.hasValue() && not mCurrentReturnPos.hasValue()) {
-                variableInsertPos = mCurrentFieldPos.getValueOr(0);
-                mCurrentPos       = variableInsertPos;
-                modifiers         = kwStaticSpace;
-                modifiers += kwInlineSpace;
-                return (*mOutputFormatHelperOutside);
+        // Outside of a function the expansion goes into the class containing the constructor.
+        const bool inClass{not mCurrentPos.hasValue() && not mCurrentReturnPos.hasValue()};
+        auto&      ofmToInsert = inClass ? *mOutputFormatHelperOutside : mOutputFormatHelper;
+        const auto anchor      = [&] {
+            if(inClass) {
+                return mCurrentFieldPos.getValue();
+            } else if(mCurrentReturnPos.hasValue()) {
+                return mCurrentReturnPos.getValue();
             }
 
-            return (mOutputFormatHelper);
+            return mCurrentPos.getValue();
         }();
 
+        const std::string modifiers{inClass ? StrCat(kwStaticSpace, kwInlineSpace) : ""};
+
         OutputFormatHelper ofm{};
         ofm.SetIndent(ofmToInsert, OutputFormatHelper::SkipIndenting::Yes);
 
@@ -2792,25 +5649,21 @@ void CodeGenerator::InsertArg(const CXXStdInitializerListExpr* stmt)
             return 0;
         }();
 
-        const auto& internalListName = BuildInternalVarName("list").append(std::to_string(variableInsertPos));
+        const auto& internalListName =
+            BuildInternalVarName("list").append(std::to_string(ofmToInsert.AnchorPos(anchor)));
 
         ofm.Append(modifiers, GetTypeNameAsParameter(mat->getType(), internalListName));
         CodeGenerator codeGenerator{ofm};
         codeGenerator.InsertArg(stmt->getSubExpr());
         ofm.AppendSemiNewLine();
 
-        ofmToInsert.InsertAt(variableInsertPos, ofm.GetString());
+        InsertInitializerListCopyNote(ofm, *mat, internalListName, size);
+
+        ofmToInsert.AppendAt(anchor, ofm.GetString());
 
         // No qualifiers like const or volatile here. This appears in  function calls or operators as a parameter. CV's
         // are not allowed there.
         mOutputFormatHelper.Append(GetName(stmt->getType(), Unqualified::Yes), "{", internalListName, ", ", size, "}");
-
-        if(mCurrentReturnPos.hasValue()) {
-            mCurrentReturnPos = mCurrentReturnPos.getValue() + ofm.GetString().size();
-        } else {
-            mCurrentPos = mCurrentPos.getValue() + ofm.GetString().size();
-        }
-
     } else {
         // No qualifiers like const or volatile here. This appears in  function calls or operators as a parameter. CV's
         // are not allowed there.
@@ -2832,19 +5685,84 @@ void CodeGenerator::InsertArg(const LabelDecl* stmt)
 }
 //-----------------------------------------------------------------------------
 
-void CodeGenerator::InsertArg(const Decl* stmt)
+/// \brief A list of the node types of \c CodeGeneratorTypes.h, in the order of the file.
+template<typename... Ts>
+struct TypeList
 {
-#define SUPPORTED_DECL(type)                                                                                           \
-    if(isa<type>(stmt)) {                                                                                              \
-        InsertArg(static_cast<const type*>(stmt));                                                                     \
-        return;                                                                                                        \
-    }
+};
 
+using DeclTypes = TypeList<
+#define SUPPORTED_DECL(type) type,
 #define IGNORED_DECL SUPPORTED_DECL
+#include "CodeGeneratorTypes.h"
+    void>;  // terminates the list
 
+using StmtTypes = TypeList<
+#define SUPPORTED_STMT(type) type,
+#define IGNORED_STMT SUPPORTED_STMT
 #include "CodeGeneratorTypes.h"
+    void>;  // terminates the list
+//-----------------------------------------------------------------------------
+
+/// \brief The first type of \p List which is \p Node or a base of it, \c void if there is none.
+///
+/// This is the type the former chain of \c isa checks picked for a node of the dynamic type \p Node.
+template<typename Node, typename List>
+struct FirstBaseOf;
+
+template<typename Node>
+struct FirstBaseOf<Node, TypeList<void>>
+{
+    using type = void;
+};
+
+template<typename Node, typename T, typename... Ts>
+struct FirstBaseOf<Node, TypeList<T, Ts...>>
+{
+    using type = std::conditional_t<std::is_base_of_v<T, Node>, T, typename FirstBaseOf<Node, TypeList<Ts...>>::type>;
+};
+
+template<typename Node, typename List>
+using FirstBaseOf_t = typename FirstBaseOf<Node, List>::type;
+//-----------------------------------------------------------------------------
+
+template<typename T>
+struct TypeTag
+{
+    using type = T;
+};
+//-----------------------------------------------------------------------------
+
+// The dispatch switches over the kind of the node and maps each of them at compile time to the overload the first
+// matching entry of CodeGeneratorTypes.h selects. This keeps the semantics of the isa chain without testing a node
+// against all the entries before the matching one.
+void CodeGenerator::InsertArg(const Decl* stmt)
+{
+    if(IsDeadlineExceeded()) {
+        return;
+    }
+
+    auto insertAs = [&](auto tag) {
+        using Target = FirstBaseOf_t<typename decltype(tag)::type, DeclTypes>;
+
+        if constexpr(std::is_void_v<Target>) {
+            TODO(stmt, mOutputFormatHelper);
+        } else {
+            InsertArg(static_cast<const Target*>(stmt));
+        }
+    };
+
+    NodeProfileScope nodeProfile{stmt, mOutputFormatHelper};
+    mOutputFormatHelper.MarkSource(stmt->getBeginLoc());
+
+    switch(stmt->getKind()) {
+#define ABSTRACT_DECL(DECL)
+#define DECL(DERIVED, BASE)                                                                                            \
+    case Decl::DERIVED: insertAs(TypeTag<DERIVED##Decl>{}); break;
+#include "clang/AST/DeclNodes.inc"
 
-    TODO(stmt, mOutputFormatHelper);
+        default: TODO(stmt, mOutputFormatHelper); break;
+    }
 }
 //-----------------------------------------------------------------------------
 
@@ -2855,17 +5773,35 @@ void CodeGenerator::InsertArg(const Stmt* stmt)
         return;
     }
 
-#define SUPPORTED_STMT(type)                                                                                           \
-    if(isa<type>(stmt)) {                                                                                              \
-        InsertArg(dyn_cast_or_null<type>(stmt));                                                                       \
-        return;                                                                                                        \
+    if(IsDeadlineExceeded()) {
+        return;
     }
 
-#define IGNORED_STMT SUPPORTED_STMT
+    auto insertAs = [&](auto tag) {
+        using Target = FirstBaseOf_t<typename decltype(tag)::type, StmtTypes>;
 
-#include "CodeGeneratorTypes.h"
+        if constexpr(std::is_void_v<Target>) {
+            TODO(stmt, mOutputFormatHelper);
+        } else {
+            InsertArg(static_cast<const Target*>(stmt));
+        }
+    };
+
+    NodeProfileScope nodeProfile{stmt, mOutputFormatHelper};
+    mOutputFormatHelper.MarkSource(stmt->getBeginLoc());
 
-    TODO(stmt, mOutputFormatHelper);
+    switch(stmt->getStmtClass()) {
+#define ABSTRACT_STMT(STMT)
+#define STMT(CLASS, PARENT)                                                                                            \
+    case Stmt::CLASS##Class: insertAs(TypeTag<CLASS>{}); break;
+#include "clang/AST/StmtNodes.inc"
+
+        default: TODO(stmt, mOutputFormatHelper); break;
+    }
+
+    if(const auto* call = dyn_cast<CallExpr>(stmt); call and IsOptionEnabled(InsightsOptionBit::ShowInlining)) {
+        InsertInlinePreview(*call);
+    }
 }
 //-----------------------------------------------------------------------------
 
@@ -2916,20 +5852,128 @@ void CodeGenerator::InsertSuffix(const QualType& type)
 }
 //-----------------------------------------------------------------------------
 
+/// \brief Check whether one of \p args, including the elements of a pack, is an expression.
+static bool HasExpressionArg(ArrayRef<TemplateArgument> args)
+{
+    return std::any_of(args.begin(), args.end(), [](const TemplateArgument& arg) {
+        return (TemplateArgument::Expression == arg.getKind()) or
+               ((TemplateArgument::Pack == arg.getKind()) and HasExpressionArg(arg.pack_elements()));
+    });
+}
+//-----------------------------------------------------------------------------
+
 void CodeGenerator::InsertTemplateArgs(const ClassTemplateSpecializationDecl& clsTemplateSpe)
 {
-    if(const TypeSourceInfo* typeAsWritten = clsTemplateSpe.getTypeAsWritten()) {
-        const TemplateSpecializationType* tmplSpecType = cast<TemplateSpecializationType>(typeAsWritten->getType());
-        InsertTemplateArgs(*tmplSpecType);
-    } else {
-        InsertTemplateArgs(clsTemplateSpe.getTemplateArgs());
+    const TemplateSpecializationType* tmplSpecType{[&]() -> const TemplateSpecializationType* {
+        if(const TypeSourceInfo* typeAsWritten = clsTemplateSpe.getTypeAsWritten()) {
+            return cast<TemplateSpecializationType>(typeAsWritten->getType());
+        }
+
+        return nullptr;
+    }()};
+
+    const ArrayRef<TemplateArgument> args{tmplSpecType ? tmplSpecType->template_arguments()
+                                                       : clsTemplateSpe.getTemplateArgs().asArray()};
+
+    // The same argument list gets printed for every name which is qualified by the specialization. Everything but an
+    // expression only depends on the scope. An expression can contain a lambda, which inserts its class elsewhere.
+    if(not HasExpressionArg(args)) {
+        mOutputFormatHelper.Append(GetCachedTemplateArgs(clsTemplateSpe, [&] {
+            OutputFormatHelper outputFormatHelper{};
+            CodeGenerator      codeGenerator{outputFormatHelper};
+            codeGenerator.InsertTemplateArgs(args);
+
+            return outputFormatHelper.GetString();
+        }));
+
+        return;
+    }
+
+    InsertTemplateArgs(args);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The shortest run of pack arguments \ref CodeGenerator::HandleTemplateParameterPack writes as a comment.
+static constexpr size_t MIN_PACK_RUN{4};
+//-----------------------------------------------------------------------------
+
+/// \brief The length of the run of \p args which starts at \p begin.
+///
+/// A run consists of equal types or of integers of the same type with the same distance between neighbours, like
+/// the arguments of \c std::make_index_sequence.
+static size_t GetPackRunLength(ArrayRef<TemplateArgument> args, const size_t begin)
+{
+    const auto& first = args[begin];
+    size_t      end{begin + 1};
+
+    if(TemplateArgument::Type == first.getKind()) {
+        while((end < args.size()) and (TemplateArgument::Type == args[end].getKind()) and
+              (args[end].getAsType() == first.getAsType())) {
+            ++end;
+        }
+
+    } else if((TemplateArgument::Integral == first.getKind()) and not first.getIntegralType()->isCharType()) {
+        auto isNextIntegral = [&](const size_t i) {
+            return (i < args.size()) and (TemplateArgument::Integral == args[i].getKind()) and
+                   (args[i].getIntegralType() == first.getIntegralType());
+        };
+
+        if(isNextIntegral(end)) {
+            const llvm::APSInt step{args[end].getAsIntegral() - first.getAsIntegral()};
+
+            while(isNextIntegral(end) and ((args[end].getAsIntegral() - args[end - 1].getAsIntegral()) == step)) {
+                ++end;
+            }
+        }
     }
+
+    return end - begin;
 }
 //-----------------------------------------------------------------------------
 
 void CodeGenerator::HandleTemplateParameterPack(const ArrayRef<TemplateArgument>& args)
 {
-    ForEachArg(args, [&](const auto& arg) { InsertTemplateArg(arg); });
+    // A pack like the one of std::make_index_sequence<10000> would make up most of the output and of the time to
+    // generate it. Above the limit, each run is written as a comment in constant time.
+    if(const auto maxArgs = GetInsightsOptions().maxPackArgs; (0 == maxArgs) or (args.size() <= maxArgs)) {
+        ForEachArg(args, [&](const auto& arg) { InsertTemplateArg(arg); });
+        return;
+    }
+
+    OnceFalse needsComma{};
+
+    for(size_t i = 0; i < args.size();) {
+        const auto  length = GetPackRunLength(args, i);
+        const auto& first  = args[i];
+        const auto& last   = args[i + length - 1];
+
+        mOutputFormatHelper.AppendComma(needsComma);
+
+        if(length < MIN_PACK_RUN) {
+            InsertTemplateArg(first);
+
+            for(size_t j = i + 1; j < i + length; ++j) {
+                mOutputFormatHelper.Append(", ");
+                InsertTemplateArg(args[j]);
+            }
+
+        } else if((TemplateArgument::Type == first.getKind()) or
+                  (first.getAsIntegral() == args[i + 1].getAsIntegral())) {
+            mOutputFormatHelper.Append("/* ", length, " x */ ");
+            InsertTemplateArg(first);
+
+        } else {
+            mOutputFormatHelper.Append("/* ");
+            InsertTemplateArg(first);
+            mOutputFormatHelper.Append(", ");
+            InsertTemplateArg(args[i + 1]);
+            mOutputFormatHelper.Append(", ..., ");
+            InsertTemplateArg(last);
+            mOutputFormatHelper.Append(" */");
+        }
+
+        i += length;
+    }
 }
 //-----------------------------------------------------------------------------
 
@@ -2970,22 +6014,33 @@ void CodeGenerator::HandleLocalStaticNonTrivialClass(const VarDecl* stmt)
     mHaveLocalStatic = true;
 
     const auto* cxxRecordDecl = stmt->getType()->getAsCXXRecordDecl();
-    auto&       langOpts{GetLangOpts(*stmt)};
-    const bool  threadSafe{langOpts.ThreadsafeStatics && langOpts.CPlusPlus11 &&
-                          (stmt->isLocalVarDecl() /*|| NonTemplateInline*/) && !stmt->getTLSKind()};
+    const bool  threadSafe{IsThreadSafeStatic(*stmt)};
+    const bool  threadLocal{VarDecl::TLS_None != stmt->getTLSKind()};
+
+    if(IsOptionEnabled(InsightsOptionBit::ShowStaticInit)) {
+        const auto note = GetStaticInitNote(*stmt, true);
+
+        mOutputFormatHelper.AppendNewLine("/* ", note, " */");
+        RecordFinding(stmt->getLocation(), FindingCategory::Guard, FindingSeverity::Note, 1, note);
+    }
+
+    if(threadLocal and IsOptionEnabled(InsightsOptionBit::ShowThreadLocal)) {
+        mOutputFormatHelper.AppendNewLine("/* thread_local: each thread has its own guard, no lock is required */");
+    }
 
     const std::string internalVarName{BuildInternalVarName(GetName(*stmt))};
     const std::string compilerBoolVarName{StrCat(internalVarName, "Guard")};
     const std::string typeName{GetName(stmt->getType())};
+    const std::string storage{threadLocal ? "thread_local" : "static"};
 
     // insert compiler bool to track init state
     const std::string stateTrackingVarName{threadSafe ? "uint64_t" : "bool"};
 
-    mOutputFormatHelper.AppendNewLine("static ", stateTrackingVarName, " ", compilerBoolVarName, ";");
+    mOutputFormatHelper.AppendNewLine(storage, " ", stateTrackingVarName, " ", compilerBoolVarName, ";");
 
     // insert compiler memory place holder
     mOutputFormatHelper.AppendNewLine(
-        "alignas(", typeName, ") static char ", internalVarName, "[sizeof(", typeName, ")];");
+        "alignas(", typeName, ") ", storage, " char ", internalVarName, "[sizeof(", typeName, ")];");
 
     // insert compiler init if
     mOutputFormatHelper.AppendNewLine();
@@ -3016,6 +6071,9 @@ void CodeGenerator::HandleLocalStaticNonTrivialClass(const VarDecl* stmt)
         mOutputFormatHelper.OpenScope();
     }
 
+    // A std::initializer_list expansion of the initializer belongs into the guarded block.
+    UpdateCurrentPos();
+
     mOutputFormatHelper.Append("new (&", internalVarName, ") ");
     // VarDecl of a static expression always have an initializer
     InsertArg(stmt->getInit());
@@ -3047,6 +6105,71 @@ void CodeGenerator::HandleLocalStaticNonTrivialClass(const VarDecl* stmt)
 }
 //-----------------------------------------------------------------------------
 
+void CodeGenerator::HandleThreadLocalWithWrapper(const VarDecl* stmt)
+{
+    mHaveLocalStatic = true;
+
+    const auto*       cxxRecordDecl = stmt->getType()->getAsCXXRecordDecl();
+    const bool        isRecord{nullptr != cxxRecordDecl};
+    const std::string name{GetName(*stmt)};
+    const std::string internalVarName{BuildInternalVarName(name)};
+    const std::string compilerBoolVarName{StrCat(internalVarName, "Guard")};
+    const std::string wrapperName{BuildThreadLocalWrapperName(name)};
+    const std::string typeName{GetName(stmt->getType())};
+    const std::string qualifiers{GetQualifiers(*stmt)};
+
+    mOutputFormatHelper.AppendNewLine("/* thread_local: each access calls ",
+                                      wrapperName,
+                                      ", which checks the guard of the current thread */");
+
+    // A class type is constructed in place on first use, a scalar is zero-initialized until then.
+    if(isRecord) {
+        mOutputFormatHelper.AppendNewLine(
+            "alignas(", typeName, ") ", qualifiers, "char ", internalVarName, "[sizeof(", typeName, ")];");
+    } else {
+        mOutputFormatHelper.AppendNewLine(qualifiers, GetTypeNameAsParameter(stmt->getType(), name), ";");
+    }
+
+    mOutputFormatHelper.AppendNewLine(qualifiers, "bool ", compilerBoolVarName, ";");
+    mOutputFormatHelper.AppendNewLine();
+
+    mOutputFormatHelper.AppendNewLine(GetTypeNameAsParameter(stmt->getType(), StrCat("& ", wrapperName, "()")));
+    mOutputFormatHelper.OpenScope();
+
+    mOutputFormatHelper.AppendNewLine("if( ! ", compilerBoolVarName, " )");
+    mOutputFormatHelper.OpenScope();
+    mOutputFormatHelper.AppendNewLine(compilerBoolVarName, " = true;");
+
+    mOutputFormatHelper.Append(isRecord ? StrCat("new (&", internalVarName, ") ") : StrCat(name, " = "));
+    InsertArg(stmt->getInit());
+    mOutputFormatHelper.AppendSemiNewLine();
+
+    // The destructor runs when the thread exits.
+    if(isRecord and cxxRecordDecl->hasNonTrivialDestructor()) {
+        mOutputFormatHelper.AppendNewLine("__cxa_thread_atexit(",
+                                          typeName,
+                                          "::~",
+                                          cxxRecordDecl->getName(),
+                                          ", &",
+                                          internalVarName,
+                                          ", &__dso_handle);");
+    }
+
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+    mOutputFormatHelper.AppendNewLine();
+    mOutputFormatHelper.AppendNewLine();
+
+    if(isRecord) {
+        mOutputFormatHelper.AppendNewLine("return *reinterpret_cast<", typeName, "*>(", internalVarName, ");");
+    } else {
+        mOutputFormatHelper.AppendNewLine("return ", name, ";");
+    }
+
+    mOutputFormatHelper.CloseScope(OutputFormatHelper::NoNewLineBefore::Yes);
+    mOutputFormatHelper.AppendNewLine();
+}
+//-----------------------------------------------------------------------------
+
 const char* CodeGenerator::GetKind(const UnaryExprOrTypeTraitExpr& uk)
 {
     switch(uk.getKind()) {
@@ -3139,6 +6262,8 @@ void CodeGenerator::InsertAccessModifierAndNameWithReturnType(const FunctionDecl
         InsertTemplateSpecializationHeader();
     }
 
+    mOutputFormatHelper.Append(GetCodeGenAttributes(decl));
+
     if(!decl.isFunctionTemplateSpecialization() || (isCXXMethodDecl && isFirstCxxMethodDecl)) {
         mOutputFormatHelper.Append(GetStorageClassAsStringWithSpace(decl.getStorageClass()));
     }
@@ -3213,6 +6338,16 @@ void CodeGenerator::InsertAccessModifierAndNameWithReturnType(const FunctionDecl
     // if a CXXInheritedCtorDecl was passed as a pointer us this to get the parameters from.
     if(cxxInheritedCtorDecl) {
         outputFormatHelper.AppendParameterList(cxxInheritedCtorDecl->parameters());
+
+    } else if(IsOptionEnabled(InsightsOptionBit::ShowPassByValue) and decl.doesThisDeclarationHaveABody()) {
+        outputFormatHelper.AppendParameterList(
+            decl.parameters(), OutputFormatHelper::NameOnly::No, [&](const ParmVarDecl& param) {
+                if(const auto note = GetPassByValueNote(param, GetInsightsOptions().passByValueThreshold);
+                   not note.empty()) {
+                    outputFormatHelper.Append("/* ", note, " */ ");
+                }
+            });
+
     } else {
         outputFormatHelper.AppendParameterList(decl.parameters());
     }
@@ -3370,6 +6505,14 @@ void StructuredBindingsCodeGenerator::InsertDecompositionBindings(const Decompos
 
             mOutputFormatHelper.Append(GetName(bindingDecl->getType()), refOrRefRef, " ", GetName(*bindingDecl), " = ");
 
+            // The holding variable of a tuple-like binding is a reference, either to what get returns or to a
+            // temporary which keeps the returned value.
+            if(bindingDecl->getHoldingVar() and IsOptionEnabled(InsightsOptionBit::ShowBindingStorage)) {
+                mOutputFormatHelper.Append(isa<ExprWithCleanups>(holdingVarOrMemberExpr)
+                                               ? "/* get: materializes a temporary */ "
+                                               : "/* get: returns a reference */ ");
+            }
+
             // tuple decomposition
             if(holdingVarOrMemberExpr) {
                 InsertArg(holdingVarOrMemberExpr);
@@ -49,7 +49,7 @@ protected:
     public:
         LambdaHelper(const LambdaCallerType lambdaCallerType, OutputFormatHelper& outputFormatHelper)
         : mLambdaCallerType{lambdaCallerType}
-        , mCurrentPos{outputFormatHelper.CurrentPos()}
+        , mAnchor{outputFormatHelper.ReserveAnchor()}
         , mOutputFormatHelper{outputFormatHelper}
         , mLambdaOutputFormatHelper{}
         , mInits{}
@@ -60,7 +60,7 @@ protected:
         void finish()
         {
             if(!mLambdaOutputFormatHelper.empty()) {
-                mOutputFormatHelper.InsertAt(mCurrentPos, mLambdaOutputFormatHelper.GetString());
+                mOutputFormatHelper.AppendAt(mAnchor, mLambdaOutputFormatHelper.GetString());
             }
         }
 
@@ -78,12 +78,17 @@ protected:
 
         LambdaCallerType callerType() const { return mLambdaCallerType; }
 
+        /// \brief The outermost entry of the stack up to this one, which is a place for a lambda class definition.
+        LambdaHelper* placement() const { return mPlacement; }
+        void          setPlacement(LambdaHelper* placement) { mPlacement = placement; }
+
     private:
-        const LambdaCallerType mLambdaCallerType;
-        const size_t           mCurrentPos;
-        OutputFormatHelper&    mOutputFormatHelper;
-        OutputFormatHelper     mLambdaOutputFormatHelper;
-        std::string            mInits;
+        const LambdaCallerType           mLambdaCallerType;
+        const OutputFormatHelper::Anchor mAnchor;
+        OutputFormatHelper&              mOutputFormatHelper;
+        OutputFormatHelper               mLambdaOutputFormatHelper;
+        std::string                      mInits;
+        LambdaHelper*                    mPlacement{};
     };
     //-----------------------------------------------------------------------------
 
@@ -168,6 +173,35 @@ public:
     /// If so we need to insert the <new> header for the placement-new.
     static bool NeedToInsertNewHeader() { return mHaveLocalStatic; }
 
+    /// Note that the code of this TU requires the <new> header, for code which comes from the declaration cache.
+    static void RequireNewHeader() { mHaveLocalStatic = true; }
+
+    /// Whether the code so far requires the <new> header. The flag is cleared, so that the code which follows can be
+    /// checked on its own.
+    static bool TakeNewHeaderRequirement()
+    {
+        const bool required{mHaveLocalStatic};
+        mHaveLocalStatic = false;
+
+        return required;
+    }
+
+    /// Reset the state which is tracked per TU. Required if more than one TU is processed by the same process.
+    ///
+    /// This also takes the boolean options of the current context for the code generation of the TU.
+    static void ResetTranslationUnitState();
+
+    /// \brief The table of the functions of this TU with allocations and their number, see \c --show-allocations.
+    ///
+    /// It is empty, if there are none.
+    static std::string GetAllocationTable();
+
+    /// \brief The table of the variables of this TU for which something runs at program start, see \c
+    /// --show-global-init.
+    ///
+    /// It is empty, if there are none.
+    static std::string GetGlobalInitTable();
+
     template<typename T>
     void InsertTemplateArgs(const ArrayRef<T>& array)
     {
@@ -176,7 +210,7 @@ public:
         ForEachArg(array, [&](const auto& arg) { InsertTemplateArg(arg); });
 
         /* put as space between to closing brackets: >> -> > > */
-        if(mOutputFormatHelper.GetString().back() == '>') {
+        if(mOutputFormatHelper.back() == '>') {
             mOutputFormatHelper.Append(' ');
         }
 
@@ -191,6 +225,54 @@ protected:
 
     void HandleTemplateParameterPack(const ArrayRef<TemplateArgument>& args);
     void HandleCompoundStmt(const CompoundStmt* stmt);
+
+    /// \brief Annotate a call of the virtual \p method on \p object with how it is dispatched, see \c
+    /// --show-virtual-calls.
+    void InsertVirtualCallNote(const CXXMethodDecl* method, const Expr* object, const bool isQualified);
+
+    /// \brief Insert an operation on a \c std::atomic as the \c __atomic builtin which implements it, annotated with
+    /// its memory order, see \c --show-atomics.
+    ///
+    /// \returns Whether \p call was replaced, otherwise only the annotation is inserted.
+    bool InsertAtomicOperation(const CallExpr& call);
+
+    /// \brief Insert the trivial copy or move assignment \p call as the \c __builtin_memcpy it is, with the bytes it
+    /// copies, see \c --show-memcpy.
+    ///
+    /// \returns Whether \p call was replaced, it stays as written if the source is a temporary or \c volatile.
+    bool InsertMemcpy(const CXXOperatorCallExpr& call);
+
+    /// \brief Insert a \c dynamic_cast as the call of \c __dynamic_cast with its offset hint, annotated with a \c
+    /// static_cast which does the same, see \c --show-rtti.
+    ///
+    /// \returns Whether \p cast was replaced, a cast without a runtime call gets only an annotation.
+    bool InsertDynamicCast(const CXXDynamicCastExpr& cast);
+
+    /// \brief Insert the arguments of \p call in parens, with a note for each \c std::move which has no effect, see \c
+    /// --show-pessimizing-moves.
+    void InsertCallArgs(const CallExpr& call);
+
+    /// \brief Insert the body of the small inline function \p call calls with its parameters bound to the arguments as
+    /// a comment behind the call, see \c --show-inlining.
+    void InsertInlinePreview(const CallExpr& call);
+
+    /// \brief Insert a \c parallel directive as the outlined function and the \c __kmpc_fork_call which runs it, see
+    /// \c --show-openmp.
+    void InsertOMPParallel(const OMPExecutableDirective& stmt);
+    /// \brief Insert the loop of a worksharing loop directive with its schedule as the runtime calls of libomp.
+    void InsertOMPLoop(const OMPLoopDirective& stmt, const std::string& loc, const std::string& threadId);
+    /// \brief Insert the private copies of the variables of the data-sharing clauses of \p stmt.
+    ///
+    /// With \p declareShared a reference called \c __omp_shared_<name> to the original variable is declared in front
+    /// of each copy, which the original needs to be updated at the end.
+    void InsertOMPPrivates(const OMPExecutableDirective& stmt, const bool declareShared);
+    /// \brief Insert the combination of the private copies of the reduction variables of \p stmt with the originals.
+    void InsertOMPReductions(const OMPExecutableDirective& stmt,
+                             const std::string&            loc,
+                             const std::string&            threadId,
+                             const bool                    nowait);
+    /// \brief Insert the statements of the region of a directive without braces of their own.
+    void InsertOMPBody(const Stmt* stmt);
     /// \brief Show what is behind a local static variable.
     ///
     /// [stmt.dcl] p4: Initialization of a block-scope variable with static storage duration is thread-safe since C++11.
@@ -199,6 +281,17 @@ protected:
     /// - www.opensource.apple.com/source/libcppabi/libcppabi-14/src/cxa_guard.cxx
     void HandleLocalStaticNonTrivialClass(const VarDecl* stmt);
 
+    /// \brief Lower a namespace-scope \c thread_local with dynamic initialization into its storage, its guard and the
+    /// wrapper function each access calls, see \c --show-thread-local.
+    ///
+    /// Like a local static, the variable is initialized on first use. However, the guard is a per-thread variable,
+    /// so no lock is required.
+    void HandleThreadLocalWithWrapper(const VarDecl* stmt);
+
+    /// \brief Show the function the compiler synthesizes to initialize the global \p decl and to register its
+    /// destructor at program start.
+    void InsertGlobalInitFunction(const VarDecl& decl);
+
     void
     FormatCast(const std::string castName, const QualType& CastDestType, const Expr* SubExpr, const CastKind& castKind);
 
@@ -261,7 +354,7 @@ protected:
                               T&&                    lambda,
                               const AddSpaceAtTheEnd addSpaceAtTheEnd = AddSpaceAtTheEnd::No);
 
-    void UpdateCurrentPos() { mCurrentPos = mOutputFormatHelper.CurrentPos(); }
+    void UpdateCurrentPos() { mCurrentPos = mOutputFormatHelper.ReserveAnchor(); }
 
     static const char* GetKind(const UnaryExprOrTypeTraitExpr& uk);
     static const char* GetBuiltinTypeSuffix(const BuiltinType::Kind& kind);
@@ -280,6 +373,9 @@ protected:
         LambdaHelper     mHelper;
 
         OutputFormatHelper& GetBuffer(OutputFormatHelper& outputFormatHelper) const;
+
+        /// \brief Whether a lambda class is defined before an entry of type \p lambdaCallerType.
+        static bool IsLambdaPlacement(const LambdaCallerType lambdaCallerType);
     };
 
     void               HandleLambdaExpr(const LambdaExpr* stmt, LambdaHelper& lambdaHelper);
@@ -292,22 +388,34 @@ protected:
     STRONG_BOOL(SkipVarDecl);
     STRONG_BOOL(UseCommaInsteadOfSemi);
 
-    SkipVarDecl           mSkipVarDecl;
-    UseCommaInsteadOfSemi mUseCommaInsteadOfSemi;
-    const LambdaExpr*     mLambdaExpr;
-    static inline bool    mHaveLocalStatic;  //!< Track whether there was a thread-safe \c static in the code. This
-                                             //!< requires adding the \c <new> header.
-    static constexpr auto MAX_FILL_VALUES_FOR_ARRAYS{
-        uint64_t{100}};  //!< This is the upper limit of elements which will be shown for an array when filled by \c
-                         //!< FillConstantArray.
-    llvm::Optional<size_t> mCurrentPos{};        //!< The position in mOutputFormatHelper where a potential
-                                                 //!< std::initializer_list expansion must be inserted.
-    llvm::Optional<size_t> mCurrentReturnPos{};  //!< The position in mOutputFormatHelper from a return where a
-                                                 //!< potential std::initializer_list expansion must be inserted.
-    llvm::Optional<size_t> mCurrentFieldPos{};   //!< The position in mOutputFormatHelper in a class where where a
-                                                 //!< potential std::initializer_list expansion must be inserted.
+    SkipVarDecl                     mSkipVarDecl;
+    UseCommaInsteadOfSemi           mUseCommaInsteadOfSemi;
+    const LambdaExpr*               mLambdaExpr;
+    static inline thread_local bool mHaveLocalStatic;  //!< Track whether there was a thread-safe \c static in the
+                                                       //!< code. This requires adding the \c <new> header. Per
+                                                       //!< thread, as each thread processes its own TU.
+    llvm::Optional<OutputFormatHelper::Anchor> mCurrentPos{};  //!< The anchor in mOutputFormatHelper where a
+                                                               //!< potential std::initializer_list expansion must be
+                                                               //!< inserted.
+    llvm::Optional<OutputFormatHelper::Anchor> mCurrentReturnPos{};  //!< The anchor in mOutputFormatHelper from a
+                                                                     //!< return where a potential
+                                                                     //!< std::initializer_list expansion must be
+                                                                     //!< inserted.
+    llvm::Optional<OutputFormatHelper::Anchor> mCurrentFieldPos{};  //!< The anchor in mOutputFormatHelper in a class
+                                                                    //!< where a potential std::initializer_list
+                                                                    //!< expansion must be inserted.
     OutputFormatHelper* mOutputFormatHelperOutside{
         nullptr};  //!< Helper output buffer for std::initializer_list expansion.
+
+    /// \brief The temporaries of the statement in progress with \c --show-temporaries.
+    struct StatementTemporaries
+    {
+        OutputFormatHelper&               outputFormatHelper;  //!< The buffer of the statement.
+        OutputFormatHelper::Anchor        anchor;              //!< Where the temporaries are declared.
+        llvm::SmallVector<std::string, 4> destructors{};       //!< The destructor calls in construction order.
+    };
+
+    StatementTemporaries* mTemporaries{};  //!< Shared with the generators for parts of the same statement.
 };
 //-----------------------------------------------------------------------------
 
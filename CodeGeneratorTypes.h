@@ -14,9 +14,6 @@
 #define SUPPORTED_STMT(type)
 #endif
 
-IGNORED_STMT(OMPOrderedDirective)
-IGNORED_STMT(OMPParallelForDirective)
-
 IGNORED_DECL(UsingShadowDecl)
 IGNORED_DECL(UsingPackDecl)
 IGNORED_DECL(BindingDecl)
@@ -73,11 +70,15 @@ SUPPORTED_STMT(CXXTypeidExpr)
 SUPPORTED_STMT(GNUNullExpr)
 SUPPORTED_STMT(CharacterLiteral)
 SUPPORTED_STMT(ArraySubscriptExpr)
+SUPPORTED_STMT(ExtVectorElementExpr)
+SUPPORTED_STMT(ShuffleVectorExpr)
+SUPPORTED_STMT(ConvertVectorExpr)
 SUPPORTED_STMT(PredefinedExpr)
 SUPPORTED_STMT(ExprWithCleanups)
 SUPPORTED_STMT(InitListExpr)
 SUPPORTED_STMT(DeclStmt)
 SUPPORTED_STMT(CompoundStmt)
+SUPPORTED_STMT(AttributedStmt)
 SUPPORTED_STMT(IfStmt)
 SUPPORTED_STMT(SubstNonTypeTemplateParmExpr)
 SUPPORTED_STMT(ReturnStmt)
@@ -118,9 +119,16 @@ SUPPORTED_STMT(UnresolvedMemberExpr)
 SUPPORTED_STMT(PackExpansionExpr)
 SUPPORTED_STMT(CXXFoldExpr)
 SUPPORTED_STMT(CoroutineBodyStmt)
+SUPPORTED_STMT(OMPParallelDirective)
+SUPPORTED_STMT(OMPParallelForDirective)
+SUPPORTED_STMT(OMPForDirective)
+SUPPORTED_STMT(OMPOrderedDirective)
 SUPPORTED_STMT(CoroutineSuspendExpr)
 SUPPORTED_STMT(CoreturnStmt)
 SUPPORTED_STMT(DependentScopeDeclRefExpr)
+#if IS_CLANG_NEWER_THAN(9)
+SUPPORTED_STMT(CXXRewrittenBinaryOperator)
+#endif
 
 #undef IGNORED_DECL
 #undef IGNORED_STMT
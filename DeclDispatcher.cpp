@@ -0,0 +1,400 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+
+#include <array>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "ClangCompat.h"
+#include "DeclDispatcher.h"
+#include "FunctionDeclHandler.h"
+#include "GlobalVariableHandler.h"
+#include "InsightsHelpers.h"
+#include "RecordDeclHandler.h"
+#include "StaticAssertHandler.h"
+#include "TemplateHandler.h"
+//-----------------------------------------------------------------------------
+
+using namespace clang;
+using namespace clang::ast_matchers;
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The kinds of ancestors the matchers of the handlers are interested in.
+enum class Ancestor
+{
+    Namespace,
+    Function,
+    Record,
+    ClassTemplate,
+    FunctionTemplate,
+    ClassTemplateSpecialization,
+    VarTemplate,
+    TypeAlias,
+    Var,
+    Friend,
+    Count  // Must be the last entry.
+};
+//-----------------------------------------------------------------------------
+
+static constexpr unsigned ToMask(const Ancestor ancestor)
+{
+    return 1u << static_cast<unsigned>(ancestor);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Get all the \ref Ancestor kinds \p decl is. Like the matchers, this includes derived classes, a \c
+/// CXXMethodDecl is a \c Function and a \c ClassTemplateSpecializationDecl a \c Record.
+static unsigned GetAncestorMask(const Decl& decl)
+{
+    unsigned mask{};
+
+    auto add = [&](const Ancestor ancestor, const bool is) {
+        if(is) {
+            mask |= ToMask(ancestor);
+        }
+    };
+
+    add(Ancestor::Namespace, isa<NamespaceDecl>(decl));
+    add(Ancestor::Function, isa<FunctionDecl>(decl));
+    add(Ancestor::Record, isa<CXXRecordDecl>(decl));
+    add(Ancestor::ClassTemplate, isa<ClassTemplateDecl>(decl));
+    add(Ancestor::FunctionTemplate, isa<FunctionTemplateDecl>(decl));
+    add(Ancestor::ClassTemplateSpecialization, isa<ClassTemplateSpecializationDecl>(decl));
+    add(Ancestor::VarTemplate, isa<VarTemplateDecl>(decl));
+    add(Ancestor::TypeAlias, isa<TypeAliasDecl>(decl));
+    add(Ancestor::Var, isa<VarDecl>(decl));
+    add(Ancestor::Friend, isa<FriendDecl>(decl));
+
+    return mask;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Same as the \c hasInitializer(ignoringImpCasts(callExpr(hasAnyArgument(ignoringParenImpCasts(
+/// declRefExpr(to(decompositionDecl()))))))) matcher of the \ref GlobalVariableHandler.
+static bool IsInitializedFromDecompositionDecl(const VarDecl& varDecl)
+{
+    if(const auto* init = varDecl.getInit()) {
+        if(const auto* callExpr = dyn_cast<CallExpr>(init->IgnoreImpCasts())) {
+            for(const auto* arg : callExpr->arguments()) {
+                if(const auto* declRef = dyn_cast<DeclRefExpr>(arg->IgnoreParenImpCasts());
+                   declRef and isa<DecompositionDecl>(declRef->getDecl())) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Same as the \c hasTemplateDescendant matcher of the \ref FunctionDeclHandler.
+class TemplateDescendantFinder final : public RecursiveASTVisitor<TemplateDescendantFinder>
+{
+public:
+    bool shouldVisitTemplateInstantiations() const { return true; }
+    bool shouldVisitImplicitCode() const { return true; }
+
+    bool VisitClassTemplateDecl(ClassTemplateDecl*) { return Found(); }
+    bool VisitFunctionTemplateDecl(FunctionTemplateDecl*) { return Found(); }
+    bool VisitClassTemplateSpecializationDecl(ClassTemplateSpecializationDecl*) { return Found(); }
+
+    static bool HasTemplateDescendant(const Decl& decl)
+    {
+        TemplateDescendantFinder finder{};
+        finder.TraverseDecl(const_cast<Decl*>(&decl));
+
+        return finder.mFound;
+    }
+
+private:
+    bool mFound{};
+
+    bool Found()
+    {
+        mFound = true;
+        return false;  // stop the traversal
+    }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Hand the bound nodes to a handler the same way \c MatchFinder does.
+class MatchResultRunner final : public internal::BoundNodesTreeBuilder::Visitor
+{
+public:
+    MatchResultRunner(MatchFinder::MatchCallback& handler, ASTContext& context)
+    : mHandler{handler}
+    , mContext{context}
+    {
+    }
+
+    void visitMatch(const BoundNodes& nodes) override { mHandler.run(MatchFinder::MatchResult{nodes, &mContext}); }
+
+private:
+    MatchFinder::MatchCallback& mHandler;
+    ASTContext&                 mContext;
+};
+//-----------------------------------------------------------------------------
+
+class DispatchVisitor final : public RecursiveASTVisitor<DispatchVisitor>
+{
+    using Base = RecursiveASTVisitor<DispatchVisitor>;
+
+public:
+    DispatchVisitor(DeclDispatcher& dispatcher, ASTContext& context)
+    : mDispatcher{dispatcher}
+    , mContext{context}
+    , mSM{context.getSourceManager()}
+    , mParents{}
+    , mAncestorCounts{}
+    {
+    }
+
+    // Same settings as the MatchFinder to get the same nodes in the same order.
+    bool shouldVisitTemplateInstantiations() const { return true; }
+    bool shouldVisitImplicitCode() const { return true; }
+
+    bool TraverseDecl(Decl* decl)
+    {
+        if(nullptr == decl) {
+            return true;
+        }
+
+        // With --traverse-all-decls the traversal starts at the translation unit. A top-level declaration has either
+        // the translation unit or no parent at all, for the dispatcher both is an empty stack.
+        if(isa<TranslationUnitDecl>(decl)) {
+            return Base::TraverseDecl(decl);
+        }
+
+        // Like MatchFinder a node is matched before its children are traversed.
+        Dispatch(*decl);
+
+        Push(decl, GetAncestorMask(*decl));
+        const bool ret = Base::TraverseDecl(decl);
+        Pop();
+
+        return ret;
+    }
+
+    // The parent map knows statements, type and name specifier locations as parents. A declaration below them has no
+    // declaration as direct parent, which matters for hasParent.
+    bool TraverseStmt(Stmt* stmt, DataRecursionQueue* = nullptr)
+    {
+        Push(nullptr, 0);
+        // No data recursion, the stack must reflect the current path.
+        const bool ret = Base::TraverseStmt(stmt);
+        Pop();
+
+        return ret;
+    }
+
+    bool TraverseTypeLoc(TypeLoc typeLoc)
+    {
+        Push(nullptr, 0);
+        const bool ret = Base::TraverseTypeLoc(typeLoc);
+        Pop();
+
+        return ret;
+    }
+
+    bool TraverseNestedNameSpecifierLoc(NestedNameSpecifierLoc nnsLoc)
+    {
+        Push(nullptr, 0);
+        const bool ret = Base::TraverseNestedNameSpecifierLoc(nnsLoc);
+        Pop();
+
+        return ret;
+    }
+
+private:
+    struct Parent
+    {
+        const Decl* decl;  //!< nullptr for a node which is not a declaration.
+        unsigned    mask;
+    };
+
+    DeclDispatcher&                                             mDispatcher;
+    ASTContext&                                                 mContext;
+    const SourceManager&                                        mSM;
+    std::vector<Parent>                                         mParents;
+    std::array<unsigned, static_cast<size_t>(Ancestor::Count)> mAncestorCounts;
+
+    void Push(const Decl* decl, const unsigned mask)
+    {
+        mParents.push_back({decl, mask});
+
+        for(size_t i = 0; i < mAncestorCounts.size(); ++i) {
+            if(mask & (1u << i)) {
+                ++mAncestorCounts[i];
+            }
+        }
+    }
+
+    void Pop()
+    {
+        const auto mask = mParents.back().mask;
+        mParents.pop_back();
+
+        for(size_t i = 0; i < mAncestorCounts.size(); ++i) {
+            if(mask & (1u << i)) {
+                --mAncestorCounts[i];
+            }
+        }
+    }
+
+    bool HasAncestor(const Ancestor ancestor) const { return 0 != mAncestorCounts[static_cast<size_t>(ancestor)]; }
+
+    /// \brief The parent \p level levels up, 0 is the direct parent. nullptr if there is none or it is no declaration.
+    const Decl* GetParent(const size_t level = 0) const
+    {
+        if(level < mParents.size()) {
+            return mParents[mParents.size() - 1 - level].decl;
+        }
+
+        return nullptr;
+    }
+
+    template<typename T>
+    bool HasParent(const size_t level = 0) const
+    {
+        const auto* parent = GetParent(level);
+
+        return (nullptr != parent) and isa<T>(parent);
+    }
+
+    /// \brief The \c isTemplate matcher from \c InsightsMatchers.h.
+    bool IsInTemplate() const
+    {
+        return HasAncestor(Ancestor::ClassTemplate) or HasAncestor(Ancestor::FunctionTemplate) or
+               HasAncestor(Ancestor::ClassTemplateSpecialization);
+    }
+
+    void Run(MatchFinder::MatchCallback* handler, std::initializer_list<std::pair<const char*, const Decl*>> bindings)
+    {
+        // A disabled handler has no matchers, there is nothing to call.
+        if(nullptr == handler) {
+            return;
+        }
+
+        internal::BoundNodesTreeBuilder builder{};
+
+        for(const auto& [id, decl] : bindings) {
+#if IS_CLANG_NEWER_THAN(10)
+            builder.setBinding(id, DynTypedNode::create(*decl));
+#else
+            builder.setBinding(id, ast_type_traits::DynTypedNode::create(*decl));
+#endif
+        }
+
+        MatchResultRunner runner{*handler, mContext};
+        builder.visitMatches(&runner);
+    }
+
+    /// \brief Evaluate the matchers of all handlers for \p decl.
+    ///
+    /// The order is the registration order of the matchers in \c CppInsightASTConsumer, the same in which \c
+    /// MatchFinder calls the handlers for a node.
+    void Dispatch(const Decl& decl)
+    {
+        const auto beginLoc       = GetBeginLoc(decl);
+        const bool inSystemHeader = IsExpansionInSystemHeader(mSM, beginLoc);
+        const bool invalidLoc     = IsInvalidLocation(beginLoc);
+        const bool macroOrInvalid = IsMacroLocation(beginLoc) or invalidLoc;
+        const bool isTemplate     = IsInTemplate();
+        const bool inNamespace    = HasAncestor(Ancestor::Namespace);
+        const bool inFunction     = HasAncestor(Ancestor::Function);
+        const bool inRecord       = HasAncestor(Ancestor::Record);
+
+        // RecordDeclHandler
+        if(const auto* recordDecl = dyn_cast<CXXRecordDecl>(&decl)) {
+            if(recordDecl->hasDefinition() and not recordDecl->isLambda() and not inNamespace and not inFunction and
+               not inRecord and not isTemplate and not inSystemHeader and not macroOrInvalid) {
+                Run(mDispatcher.mRecordDeclHandler, {{"cxxRecordDecl", recordDecl}});
+            }
+        }
+
+        if(isa<NamespaceDecl>(decl) and mParents.empty() and not inSystemHeader and not macroOrInvalid) {
+            Run(mDispatcher.mRecordDeclHandler, {{"namespaceDecl", &decl}});
+        }
+
+        // StaticAssertHandler
+        if(isa<StaticAssertDecl>(decl) and not inSystemHeader and not macroOrInvalid and not isTemplate and
+           not inNamespace and not inFunction) {
+            Run(mDispatcher.mStaticAssertHandler, {{"static_assert", &decl}});
+        }
+
+        // TemplateHandler
+        if(const auto* functionDecl = dyn_cast<FunctionDecl>(&decl)) {
+            // The function template is not a record, so the record ancestors of it are the ones of the function.
+            if(not inSystemHeader and not macroOrInvalid and not inNamespace and
+               HasParent<FunctionTemplateDecl>() and not HasParent<ClassTemplateSpecializationDecl>(1) and
+               not inRecord and functionDecl->isTemplateInstantiation()) {
+                Run(mDispatcher.mTemplateHandler, {{"func", functionDecl}});
+            }
+        }
+
+        const auto* clsTmplSpecDecl = dyn_cast<ClassTemplateSpecializationDecl>(&decl);
+
+        if(clsTmplSpecDecl and not inSystemHeader and not inNamespace and not inRecord and
+           HasParent<ClassTemplateDecl>()) {
+            Run(mDispatcher.mTemplateHandler, {{"class", clsTmplSpecDecl}, {"decl", GetParent()}});
+        }
+
+        if(clsTmplSpecDecl and not inSystemHeader and not inNamespace and not HasParent<ClassTemplateDecl>() and
+           (TSK_ExplicitSpecialization != clsTmplSpecDecl->getTemplateSpecializationKind())) {
+            Run(mDispatcher.mTemplateHandler, {{"class", clsTmplSpecDecl}});
+        }
+
+        if(isa<VarTemplateDecl>(decl) and not inSystemHeader and not inNamespace and
+           not HasParent<ClassTemplateDecl>()) {
+            Run(mDispatcher.mTemplateHandler, {{"vd", &decl}});
+        }
+
+        // GlobalVariableHandler
+        if(const auto* varDecl = dyn_cast<VarDecl>(&decl)) {
+            if(not inSystemHeader and not invalidLoc and not HasAncestor(Ancestor::VarTemplate) and not inFunction and
+               not inRecord and not inNamespace and not HasAncestor(Ancestor::TypeAlias) and
+               not isa<ParmVarDecl>(varDecl) and not HasAncestor(Ancestor::Var) and
+               not isa<VarTemplateSpecializationDecl>(varDecl) and not IsInitializedFromDecompositionDecl(*varDecl) and
+               not isTemplate) {
+                Run(mDispatcher.mGlobalVariableHandler, {{"varDecl", varDecl}});
+            }
+        }
+
+        // FunctionDeclHandler
+        if(isa<FunctionDecl>(decl) and not isa<CXXMethodDecl>(decl) and not inSystemHeader and not isTemplate and
+           not HasParent<LinkageSpecDecl>() and not HasAncestor(Ancestor::Friend) and not inFunction and
+           not inNamespace and not invalidLoc) {
+            Run(mDispatcher.mFunctionDeclHandler, {{"funcDecl", &decl}});
+        }
+
+        if(isa<FriendDecl>(decl) and not inRecord and not inNamespace and not inSystemHeader and not isTemplate and
+           not inFunction and not invalidLoc and not TemplateDescendantFinder::HasTemplateDescendant(decl)) {
+            Run(mDispatcher.mFunctionDeclHandler, {{"friendDecl", &decl}});
+        }
+    }
+};
+//-----------------------------------------------------------------------------
+
+void DeclDispatcher::Run(ASTContext& context)
+{
+    DispatchVisitor visitor{*this, context};
+
+    for(auto* decl : context.getTraversalScope()) {
+        visitor.TraverseDecl(decl);
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
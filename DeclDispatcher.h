@@ -0,0 +1,66 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_DECL_DISPATCHER_H
+#define INSIGHTS_DECL_DISPATCHER_H
+
+namespace clang {
+class ASTContext;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+class FunctionDeclHandler;
+class GlobalVariableHandler;
+class RecordDeclHandler;
+class StaticAssertHandler;
+class TemplateHandler;
+//-----------------------------------------------------------------------------
+
+/// \brief A single pass alternative to the \c MatchFinder for dispatching declarations to the handlers.
+///
+/// The matchers of the handlers are full of \c hasAncestor checks, each of them walks the parent map for every
+/// candidate node. The dispatcher visits the traversal scope once in the same order as the \c MatchFinder does and
+/// keeps the ancestors of the current node on a stack. A declaration is passed to a handler, with the bindings of the
+/// corresponding matcher, if the conditions of the matcher hold for it. The result is the same as with the matchers.
+///
+/// Whenever a matcher of a handler changes, the corresponding condition in the dispatcher must follow. A handler which
+/// is a \c nullptr is disabled, see \c --handlers.
+class DeclDispatcher
+{
+public:
+    DeclDispatcher(RecordDeclHandler*     recordDeclHandler,
+                   StaticAssertHandler*   staticAssertHandler,
+                   TemplateHandler*       templateHandler,
+                   GlobalVariableHandler* globalVariableHandler,
+                   FunctionDeclHandler*   functionDeclHandler)
+    : mRecordDeclHandler{recordDeclHandler}
+    , mStaticAssertHandler{staticAssertHandler}
+    , mTemplateHandler{templateHandler}
+    , mGlobalVariableHandler{globalVariableHandler}
+    , mFunctionDeclHandler{functionDeclHandler}
+    {
+    }
+
+    /// \brief Dispatch all declarations of the traversal scope of \p context.
+    void Run(ASTContext& context);
+
+private:
+    friend class DispatchVisitor;
+
+    RecordDeclHandler*     mRecordDeclHandler;
+    StaticAssertHandler*   mStaticAssertHandler;
+    TemplateHandler*       mTemplateHandler;
+    GlobalVariableHandler* mGlobalVariableHandler;
+    FunctionDeclHandler*   mFunctionDeclHandler;
+};
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_DECL_DISPATCHER_H */
@@ -11,6 +11,9 @@
 #include "DPrint.h"
 #include "InsightsHelpers.h"
 #include "InsightsMatchers.h"
+#include "InsightsProbes.h"
+#include "InsightsTimeReport.h"
+#include "InsightsTrace.h"
 #include "OutputFormatHelper.h"
 //-----------------------------------------------------------------------------
 
@@ -20,45 +23,53 @@ using namespace clang::ast_matchers;
 
 namespace clang::insights {
 
-FunctionDeclHandler::FunctionDeclHandler(Rewriter& rewrite, MatchFinder& matcher)
-: InsightsBase(rewrite)
+FunctionDeclHandler::FunctionDeclHandler(OutputSink& outputSink, MatchFinder& matcher)
+: InsightsBase(outputSink, "FunctionDeclHandler")
 {
-    matcher.addMatcher(functionDecl(unless(anyOf(cxxMethodDecl(),
-                                                 isExpansionInSystemHeader(),
-                                                 isTemplate,
-                                                 hasParent(linkageSpecDecl()),  // filter this out for coroutines
-                                                 hasAncestor(friendDecl()),     // friendDecl has functionDecl as child
-                                                 hasAncestor(functionDecl()),   // prevent forward declarations
-                                                 hasAncestor(namespaceDecl()),
-                                                 isInvalidLocation())))
-                           .bind("funcDecl"),
-                       this);
+    AddMatcher(matcher, functionDecl(unless(anyOf(cxxMethodDecl(),
+                                                  isInSystemHeader(),
+                                                  isTemplate,
+                                                  hasParent(linkageSpecDecl()),  // filter this out for coroutines
+                                                  hasAncestor(friendDecl()),     // friendDecl has functionDecl as child
+                                                  hasAncestor(functionDecl()),   // prevent forward declarations
+                                                  hasAncestor(namespaceDecl()),
+                                                  isInvalidLocation())))
+                            .bind("funcDecl"),
+                        this);
 
     static const auto hasTemplateDescendant = anyOf(hasDescendant(classTemplateDecl()),
                                                     hasDescendant(functionTemplateDecl()),
                                                     hasDescendant(classTemplateSpecializationDecl()));
 
-    matcher.addMatcher(friendDecl(unless(anyOf(cxxMethodDecl(),
-                                               hasAncestor(cxxRecordDecl()),
-                                               hasAncestor(namespaceDecl()),
-                                               isExpansionInSystemHeader(),
-                                               isTemplate,
-                                               hasTemplateDescendant,
-                                               hasAncestor(functionDecl()),  // prevent forward declarations
-                                               isInvalidLocation())))
-                           .bind("friendDecl"),
-                       this);
+    AddMatcher(matcher, friendDecl(unless(anyOf(cxxMethodDecl(),
+                                                hasAncestor(cxxRecordDecl()),
+                                                hasAncestor(namespaceDecl()),
+                                                isInSystemHeader(),
+                                                isTemplate,
+                                                hasTemplateDescendant,
+                                                hasAncestor(functionDecl()),  // prevent forward declarations
+                                                isInvalidLocation())))
+                            .bind("friendDecl"),
+                        this);
 }
 //-----------------------------------------------------------------------------
 
 void FunctionDeclHandler::run(const MatchFinder::MatchResult& result)
 {
-    if(const auto* funcDecl = result.Nodes.getNodeAs<FunctionDecl>("funcDecl")) {
-        const auto         columnNr = GetSM(result).getSpellingColumnNumber(GetBeginLoc(funcDecl)) - 1;
+    TimePhaseScope    timePhase{TimePhase::FunctionDeclHandler};
+    DeclTraceScope    timeTrace{"FunctionDeclHandler", result};
+    HandlerProbeScope handlerProbe{"FunctionDeclHandler", result};
+
+    if(const auto* funcDecl = result.Nodes.getNodeAs<FunctionDecl>("funcDecl"); funcDecl and MarkGenerated(funcDecl)) {
+        const auto         columnNr = GetSpellingLineColumn(GetSM(result), GetBeginLoc(funcDecl)).column - 1;
         OutputFormatHelper outputFormatHelper{columnNr};
-        CodeGenerator      codeGenerator{outputFormatHelper};
 
-        codeGenerator.InsertArg(funcDecl);
+        GenerateCached(*funcDecl, outputFormatHelper, [&] {
+            CodeGenerator  codeGenerator{outputFormatHelper};
+            DeclTraceScope insertArgTrace{"CodeGenerator::InsertArg", funcDecl};
+
+            codeGenerator.InsertArg(funcDecl);
+        });
 
         // Find the correct ending of the source range. In case of a declaration we need to find the ending semi,
         // otherwise the provided source range is correct.
@@ -69,7 +80,7 @@ void FunctionDeclHandler::run(const MatchFinder::MatchResult& result)
 
         // DPrint("fd rw:  %d %s\n", (sr.getBegin() == sr.getEnd()), outputFormatHelper.GetString());
 
-        mRewrite.ReplaceText(sr, outputFormatHelper.GetString());
+        ReplaceText(sr, outputFormatHelper);
     }
 }
 //-----------------------------------------------------------------------------
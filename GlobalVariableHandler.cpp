@@ -9,6 +9,9 @@
 #include "CodeGenerator.h"
 #include "InsightsHelpers.h"
 #include "InsightsMatchers.h"
+#include "InsightsProbes.h"
+#include "InsightsTimeReport.h"
+#include "InsightsTrace.h"
 #include "OutputFormatHelper.h"
 //-----------------------------------------------------------------------------
 
@@ -25,12 +28,13 @@ const internal::VariadicDynCastAllOfMatcher<Type, DecltypeType> myDecltypeType;
 
 namespace clang::insights {
 
-GlobalVariableHandler::GlobalVariableHandler(Rewriter& rewrite, MatchFinder& matcher)
-: InsightsBase(rewrite)
+GlobalVariableHandler::GlobalVariableHandler(OutputSink& outputSink, MatchFinder& matcher)
+: InsightsBase(outputSink, "GlobalVariableHandler")
 {
-    matcher.addMatcher(
+    AddMatcher(
+        matcher,
         varDecl(unless(anyOf(
-                    isExpansionInSystemHeader(),
+                    isInSystemHeader(),
                     isInvalidLocation(),
                     hasAncestor(varTemplateDecl()),
                     hasAncestor(functionDecl()),
@@ -55,14 +59,23 @@ GlobalVariableHandler::GlobalVariableHandler(Rewriter& rewrite, MatchFinder& mat
 
 void GlobalVariableHandler::run(const MatchFinder::MatchResult& result)
 {
-    if(const auto* matchedDecl = result.Nodes.getNodeAs<VarDecl>("varDecl")) {
+    TimePhaseScope    timePhase{TimePhase::GlobalVariableHandler};
+    DeclTraceScope    timeTrace{"GlobalVariableHandler", result};
+    HandlerProbeScope handlerProbe{"GlobalVariableHandler", result};
+
+    if(const auto* matchedDecl = result.Nodes.getNodeAs<VarDecl>("varDecl");
+       matchedDecl and MarkGenerated(matchedDecl)) {
         OutputFormatHelper outputFormatHelper{};
-        CodeGenerator      codeGenerator{outputFormatHelper};
-        codeGenerator.InsertArg(matchedDecl);
+
+        GenerateCached(*matchedDecl, outputFormatHelper, [&] {
+            CodeGenerator  codeGenerator{outputFormatHelper};
+            DeclTraceScope insertArgTrace{"CodeGenerator::InsertArg", matchedDecl};
+            codeGenerator.InsertArg(matchedDecl);
+        });
 
         const auto sr = GetSourceRangeAfterSemi(matchedDecl->getSourceRange(), result, RequireSemi::Yes);
 
-        mRewrite.ReplaceText(sr, outputFormatHelper.GetString());
+        ReplaceText(sr, outputFormatHelper);
     }
 }
 //-----------------------------------------------------------------------------
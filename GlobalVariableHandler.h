@@ -10,9 +10,6 @@
 
 #include "InsightsBase.h"                      // for InsightsBase
 #include "clang/ASTMatchers/ASTMatchFinder.h"  // for MatchFinder, MatchFind...
-namespace clang {
-class Rewriter;
-}
 //-----------------------------------------------------------------------------
 
 namespace clang::insights {
@@ -21,8 +18,9 @@ namespace clang::insights {
 class GlobalVariableHandler final : public ast_matchers::MatchFinder::MatchCallback, public InsightsBase
 {
 public:
-    GlobalVariableHandler(Rewriter& rewrite, ast_matchers::MatchFinder& matcher);
+    GlobalVariableHandler(OutputSink& outputSink, ast_matchers::MatchFinder& matcher);
     void run(const ast_matchers::MatchFinder::MatchResult& result) override;
+    StringRef getID() const override { return "GlobalVariableHandler"; }
 };
 //-----------------------------------------------------------------------------
 
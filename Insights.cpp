@@ -9,29 +9,83 @@
 #include "clang/AST/ASTContext.h"
 #include "clang/ASTMatchers/ASTMatchFinder.h"
 #include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/Frontend/ASTUnit.h"
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Lex/Lexer.h"
-#include "clang/Rewrite/Core/Rewriter.h"
+#include "clang/Serialization/PCHContainerOperations.h"
 #include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/JSONCompilationDatabase.h"
 #include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/BuryPointer.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/VirtualFileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "DPrint.h"
 
 #include "CodeGenerator.h"
 #include "DPrint.h"
+#include "DeclDispatcher.h"
 #include "FunctionDeclHandler.h"
 #include "GlobalVariableHandler.h"
 #include "Insights.h"
+#include "InsightsArena.h"
+#include "InsightsBatchArchive.h"
+#include "InsightsBloatReport.h"
+#include "InsightsCodegenShards.h"
+#include "InsightsContentStore.h"
+#include "InsightsDeclCache.h"
+#include "InsightsEstimate.h"
+#include "InsightsExternTemplates.h"
+#include "InsightsFindings.h"
+#include "InsightsHeapProfile.h"
+#include "InsightsHelpers.h"
+#include "InsightsIncludeReport.h"
+#include "InsightsInstantiationCost.h"
+#include "InsightsLayoutAsserts.h"
+#include "InsightsLowering.h"
+#include "InsightsMatcherProfile.h"
+#include "InsightsMemReport.h"
+#include "InsightsMemoryLimit.h"
+#include "InsightsMetrics.h"
+#include "InsightsMoveAudit.h"
+#include "InsightsNodeProfile.h"
+#include "InsightsOutputSink.h"
+#include "InsightsPchCache.h"
+#include "InsightsRemoteCache.h"
+#include "InsightsResultCache.h"
+#include "InsightsResultStore.h"
+#include "InsightsServer.h"
+#include "InsightsSourceMap.h"
+#include "InsightsStdioProtocol.h"
+#include "InsightsTimeReport.h"
+#include "InsightsTrace.h"
+#include "InsightsTypeSizes.h"
+#include "InsightsVerifyOutput.h"
+#include "InsightsVfsSnapshot.h"
 #include "RecordDeclHandler.h"
 #include "StaticAssertHandler.h"
 #include "TemplateHandler.h"
 #include "version.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
 //-----------------------------------------------------------------------------
 
 using namespace clang;
@@ -44,9 +98,82 @@ using namespace clang::insights;
 static InsightsOptions gInsightsOptions{};
 //-----------------------------------------------------------------------------
 
+static thread_local InsightsContext* gContext{};
+//-----------------------------------------------------------------------------
+
+InsightsContextScope::InsightsContextScope(InsightsContext& context)
+: mPrevious{gContext}
+{
+    gContext = &context;
+}
+//-----------------------------------------------------------------------------
+
+InsightsContextScope::~InsightsContextScope()
+{
+    gContext = mPrevious;
+}
+//-----------------------------------------------------------------------------
+
 const InsightsOptions& GetInsightsOptions()
 {
-    return gInsightsOptions;
+    return gContext ? gContext->options : gInsightsOptions;
+}
+//-----------------------------------------------------------------------------
+
+static thread_local const std::atomic<bool>* gCancelled{};
+//-----------------------------------------------------------------------------
+
+CancellationScope::CancellationScope(const std::atomic<bool>& cancelled)
+: mPrevious{gCancelled}
+{
+    gCancelled = &cancelled;
+}
+//-----------------------------------------------------------------------------
+
+CancellationScope::~CancellationScope()
+{
+    gCancelled = mPrevious;
+}
+//-----------------------------------------------------------------------------
+
+bool IsDeadlineExceeded()
+{
+    static thread_local unsigned calls{};
+
+    if((nullptr == gContext) or ((0 == gContext->options.deadlineMs) and (nullptr == gCancelled))) {
+        return false;
+    }
+
+    if(not gContext->deadlineExceeded and (0 == (++calls % 256))) {
+        const bool pastDeadline{(0 != gContext->options.deadlineMs) and
+                                (std::chrono::steady_clock::now() >= gContext->deadline)};
+
+        gContext->deadlineExceeded = pastDeadline or (gCancelled and gCancelled->load());
+    }
+
+    return gContext->deadlineExceeded;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The exit code, if the code generation stopped at the deadline of \c --deadline-ms.
+static constexpr int DEADLINE_EXCEEDED_EXIT_CODE{3};
+//-----------------------------------------------------------------------------
+
+/// \brief The exit code, if the result of \c --verify-output does not compile.
+static constexpr int VERIFY_FAILED_EXIT_CODE{4};
+//-----------------------------------------------------------------------------
+
+static int GetExitCode(const int toolRet, const InsightsContext& context)
+{
+    if((0 == toolRet) and context.deadlineExceeded) {
+        return DEADLINE_EXCEEDED_EXIT_CODE;
+    }
+
+    if((0 == toolRet) and context.verifyFailed) {
+        return VERIFY_FAILED_EXIT_CODE;
+    }
+
+    return toolRet;
 }
 //-----------------------------------------------------------------------------
 
@@ -72,161 +199,3970 @@ static llvm::cl::opt<bool>
     gUseLibCpp("use-libc++", llvm::cl::desc("Use libc++."), llvm::cl::init(false), llvm::cl::cat(gInsightCategory));
 //-----------------------------------------------------------------------------
 
-#define INSIGHTS_OPT(option, name, deflt, description, category)                                                       \
-    static llvm::cl::opt<bool, true> g##name(option,                                                                   \
-                                             llvm::cl::desc(description),                                              \
-                                             llvm::cl::NotHidden,                                                      \
-                                             llvm::cl::location(gInsightsOptions.name),                                \
-                                             llvm::cl::init(deflt),                                                    \
-                                             llvm::cl::cat(category));
+static llvm::cl::opt<bool> gStdModules("std-modules",
+                                       llvm::cl::desc("Import the standard library from clang modules\n"
+                                                      "instead of parsing its headers. Requires -use-libc++.\n"
+                                                      "The modules are built on first use."),
+                                       llvm::cl::init(false),
+                                       llvm::cl::cat(gInsightCategory));
 //-----------------------------------------------------------------------------
 
-#include "InsightsOptions.def"
+static llvm::cl::opt<std::string> gModuleCacheDir("module-cache-dir",
+                                                  llvm::cl::desc("Where --std-modules keeps the modules, next to\n"
+                                                                 "the clang resource directory by default."),
+                                                  llvm::cl::value_desc("directory"),
+                                                  llvm::cl::init(INSIGHTS_MODULE_CACHE_DIR),
+                                                  llvm::cl::cat(gInsightCategory));
 //-----------------------------------------------------------------------------
 
-static const ASTContext* gAST{};
-const ASTContext&        GetGlobalAST()
-{
-    return *gAST;
-}
+static llvm::cl::opt<bool> gTraverseAllDecls("traverse-all-decls",
+                                             llvm::cl::desc("Match the entire translation unit including all\n"
+                                                            "headers. By default only the top-level declarations\n"
+                                                            "of the main file are traversed."),
+                                             llvm::cl::init(false),
+                                             llvm::cl::cat(gInsightCategory));
 //-----------------------------------------------------------------------------
 
-class CppInsightASTConsumer final : public ASTConsumer
-{
-public:
-    explicit CppInsightASTConsumer(Rewriter& rewriter)
-    : ASTConsumer()
-    , mMatcher{}
-    , mRecordDeclHandler{rewriter, mMatcher}
-    , mStaticAssertHandler{rewriter, mMatcher}
-    , mTemplateHandler{rewriter, mMatcher}
-    , mGlobalVariableHandler{rewriter, mMatcher}
-    , mFunctionDeclHandler{rewriter, mMatcher}
-    , mRewriter{rewriter}
-    {
-    }
+static llvm::cl::opt<bool> gSkipHeaderBodies("skip-header-bodies",
+                                             llvm::cl::desc("Skip the bodies of the functions outside of the main\n"
+                                                            "file which are neither templates nor constexpr while\n"
+                                                            "parsing. The output stays the same, except for the\n"
+                                                            "cases listed in the Readme."),
+                                             llvm::cl::init(false),
+                                             llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    void HandleTranslationUnit(ASTContext& context) override
-    {
-        gAST = &context;
-        mMatcher.matchAST(context);
+static llvm::cl::opt<bool> gVisitorDispatch("visitor-dispatch",
+                                            llvm::cl::desc("Dispatch the declarations to the handlers in a single\n"
+                                                           "pass over the AST instead of using the AST matchers.\n"
+                                                           "The result is the same."),
+                                            llvm::cl::init(false),
+                                            llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-        // Check whether we had static local variables which we transformed. Then for the placement-new we need to
-        // include the header <new>.
-        if(CodeGenerator::NeedToInsertNewHeader()) {
-            const auto& sm         = context.getSourceManager();
-            const auto& mainFileId = sm.getMainFileID();
-            const auto  loc        = sm.translateFileLineCol(sm.getFileEntryForID(mainFileId), 1, 1);
+static llvm::cl::opt<std::string> gServerAddress("server",
+                                                 llvm::cl::desc("Run as a persistent server listening on <address>.\n"
+                                                                "<address> is either a path for a Unix domain\n"
+                                                                "socket or host:port for a TCP socket. The server\n"
+                                                                "keeps the file and header-search caches warm\n"
+                                                                "between requests."),
+                                                 llvm::cl::value_desc("address"),
+                                                 llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-            mRewriter.InsertText(loc, "#include <new> // for thread-safe static's placement new\n");
-        }
-    }
+static llvm::cl::opt<bool> gForkServer("fork-server",
+                                       llvm::cl::desc("With --server serve each connection in a child\n"
+                                                      "process forked from the initialized server."),
+                                       llvm::cl::init(false),
+                                       llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-private:
-    MatchFinder           mMatcher;
-    RecordDeclHandler     mRecordDeclHandler;
-    StaticAssertHandler   mStaticAssertHandler;
-    TemplateHandler       mTemplateHandler;
-    GlobalVariableHandler mGlobalVariableHandler;
-    FunctionDeclHandler   mFunctionDeclHandler;
-    Rewriter&             mRewriter;
-};
+static llvm::cl::opt<bool> gWorkerPool("worker-pool",
+                                       llvm::cl::desc("With --server transform the requests in a pool of\n"
+                                                      "worker processes forked from the initialized server.\n"
+                                                      "A crashing worker is replaced right away, the other\n"
+                                                      "requests are not affected."),
+                                       llvm::cl::init(false),
+                                       llvm::cl::cat(gInsightCategory));
 //-----------------------------------------------------------------------------
 
-class CppInsightFrontendAction final : public ASTFrontendAction
-{
-public:
-    CppInsightFrontendAction() = default;
-    void EndSourceFileAction() override
-    {
-        mRewriter.getEditBuffer(mRewriter.getSourceMgr().getMainFileID()).write(llvm::outs());
-    }
+static llvm::cl::opt<std::string> gPipeline("pipeline",
+                                            llvm::cl::desc("With --server pass the requests through a pipeline\n"
+                                                           "of an I/O thread, <parse> parse threads, <codegen>\n"
+                                                           "code generation threads and a writer thread."),
+                                            llvm::cl::value_desc("parse:codegen"),
+                                            llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance& CI, StringRef /*file*/) override
-    {
-        mRewriter.setSourceMgr(CI.getSourceManager(), CI.getLangOpts());
-        return
-#if IS_CLANG_NEWER_THAN(9)
+static llvm::cl::opt<bool> gScheduler("scheduler",
+                                      llvm::cl::desc("With --server schedule the requests by their\n"
+                                                     "estimated cost in an interactive and a batch lane,\n"
+                                                     "with weighted fair queuing across the tenants. A\n"
+                                                     "long batch request makes room for an interactive\n"
+                                                     "one."),
+                                      llvm::cl::init(false),
+                                      llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-            std
-#else
-            llvm
-#endif
+static llvm::cl::opt<uint64_t> gInteractiveCost("interactive-cost",
+                                                llvm::cl::desc("With --scheduler the highest estimated cost of a\n"
+                                                               "request of the interactive lane, in tokens."),
+                                                llvm::cl::value_desc("tokens"),
+                                                llvm::cl::init(500000),
+                                                llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-            ::make_unique<CppInsightASTConsumer>(mRewriter);
-    }
+static llvm::cl::list<std::string> gTenantWeights("tenant-weight",
+                                                  llvm::cl::desc("With --scheduler the share of <tenant>, the\n"
+                                                                 "tenants without one have a share of 1."),
+                                                  llvm::cl::value_desc("tenant:weight"),
+                                                  llvm::cl::CommaSeparated,
+                                                  llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-private:
-    Rewriter mRewriter;
-};
+static llvm::cl::opt<bool> gMetrics("metrics",
+                                    llvm::cl::desc("With --server answer HTTP GET /metrics on the server\n"
+                                                   "address with Prometheus metrics."),
+                                    llvm::cl::init(false),
+                                    llvm::cl::cat(gInsightCategory));
 //-----------------------------------------------------------------------------
 
-#include "clang/Basic/Version.h"
+static llvm::cl::opt<std::string> gForkServerWarmup("fork-server-warmup",
+                                                    llvm::cl::desc("With --fork-server or --worker-pool transform\n"
+                                                                   "<file> once before the first fork. The children\n"
+                                                                   "inherit the warm caches."),
+                                                    llvm::cl::value_desc("file"),
+                                                    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-static void PrintVersion(raw_ostream& ostream)
-{
-    ostream << "cpp-insights " << INSIGHTS_VERSION << " https://cppinsights.io (" << GIT_REPO_URL << " "
-            << GIT_COMMIT_HASH << ")"
-            << "\n";
+static llvm::cl::opt<bool> gBatchMode("batch",
+                                      llvm::cl::desc("Read newline-delimited JSON records\n"
+                                                     "{id, code, std, options} from <stdin> and write\n"
+                                                     "one JSON result per record to <stdout>."),
+                                      llvm::cl::init(false),
+                                      llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-#ifdef INSIGHTS_DEBUG
-    ostream << "  Build with debug enabled\n";
-#endif
-    ostream << "  LLVM  Revision: " << clang::getLLVMRevision() << '\n';
-    ostream << "  Clang Revision: " << clang::getClangFullCPPVersion() << '\n';
-}
+static llvm::cl::opt<std::string>
+    gBatchArchive("batch-archive",
+                  llvm::cl::desc("With --batch read the sources and their arguments\n"
+                                 "from the memory-mapped archive <file> instead of\n"
+                                 "<stdin>. The entries are transformed by -j threads."),
+                  llvm::cl::value_desc("file"),
+                  llvm::cl::cat(gInsightCategory));
 //-----------------------------------------------------------------------------
 
-int main(int argc, const char** argv)
+static llvm::cl::opt<std::string>
+    gBatchArchiveOutput("batch-archive-output",
+                        llvm::cl::desc("The archive --batch-archive writes the results to.\n"
+                                       "Default: <file>.results"),
+                        llvm::cl::value_desc("file"),
+                        llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool>
+    gStdioProtocol("stdio-protocol",
+                   llvm::cl::desc("Serve an editor integration over <stdin> and\n"
+                                  "<stdout> with Content-Length framed JSON-RPC\n"
+                                  "messages. Open documents stay resident between\n"
+                                  "their transforms."),
+                   llvm::cl::init(false),
+                   llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gPchCacheDir("pch-cache-dir",
+                                               llvm::cl::desc("Precompile the leading block of #include <...>\n"
+                                                              "directives of the main file and cache the PCH\n"
+                                                              "in <directory>."),
+                                               llvm::cl::value_desc("directory"),
+                                               llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gPchWarmTop("pch-warm-top",
+                                           llvm::cl::desc("With --server and --pch-cache-dir, build the PCHs\n"
+                                                          "of the <K> most frequent include prefixes of the\n"
+                                                          "requests in the background. Requests no longer\n"
+                                                          "wait for a PCH. 0 turns it off."),
+                                           llvm::cl::value_desc("K"),
+                                           llvm::cl::init(0),
+                                           llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gVfsSnapshot("vfs-snapshot",
+                                               llvm::cl::desc("Remember the paths the header search found missing\n"
+                                                              "in <file> and answer them from there in later\n"
+                                                              "runs, as long as their directory is unchanged."),
+                                               llvm::cl::value_desc("file"),
+                                               llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gCacheDir("cache-dir",
+                                            llvm::cl::desc("Cache the results in <directory>. A cached result\n"
+                                                           "is returned without running the transformation."),
+                                            llvm::cl::value_desc("directory"),
+                                            llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t> gCacheSizeLimit("cache-size-limit",
+                                               llvm::cl::desc("Maximum size of the result cache in MiB. The least\n"
+                                                              "recently used results are removed first."),
+                                               llvm::cl::value_desc("MiB"),
+                                               llvm::cl::init(512),
+                                               llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string>
+    gRemoteCache("remote-cache",
+                 llvm::cl::desc("Share the result cache through the HTTP server at\n"
+                                "<url>, like http://host:port/prefix. Results are\n"
+                                "read with GET and stored with PUT of <url>/<key>.\n"
+                                "--cache-dir is the local cache in front of it."),
+                 llvm::cl::value_desc("url"),
+                 llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t> gDeclCacheSize("decl-cache-size",
+                                              llvm::cl::desc("Keep the generated code of unchanged top-level\n"
+                                                             "declarations of up to <MiB> in memory and reuse it\n"
+                                                             "for later requests. Pays off with --server and\n"
+                                                             "--batch. 0 turns it off."),
+                                              llvm::cl::value_desc("MiB"),
+                                              llvm::cl::init(0),
+                                              llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t> gMaxMemoryMb("max-memory-mb",
+                                            llvm::cl::desc("Keep the memory for the generated code and the\n"
+                                                           "caches below <MiB>. Close to the limit no more\n"
+                                                           "template instantiations are generated, they are\n"
+                                                           "summarized instead, and the caches are dropped.\n"
+                                                           "0 means no limit."),
+                                            llvm::cl::value_desc("MiB"),
+                                            llvm::cl::init(0),
+                                            llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t>
+    gResultStoreSize("result-store-size",
+                     llvm::cl::desc("Keep the responses of up to <MiB> in memory.\n"
+                                    "Identical requests in progress at the same time\n"
+                                    "run only once. Pays off with --server. 0 turns it\n"
+                                    "off."),
+                     llvm::cl::value_desc("MiB"),
+                     llvm::cl::init(0),
+                     llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gJobs("j",
+                                     llvm::cl::desc("Process up to <N> translation units in parallel.\n"
+                                                    "With --server serve up to <N> connections in\n"
+                                                    "parallel. 0 uses one job per hardware thread."),
+                                     llvm::cl::value_desc("N"),
+                                     llvm::cl::init(1),
+                                     llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gCodegenJobs("codegen-jobs",
+                                            llvm::cl::desc("Split the code generation of a single file across\n"
+                                                           "<N> threads. Each of them parses the file on its own\n"
+                                                           "and generates every N-th top-level declaration.\n"
+                                                           "Pays off for files with many large instantiations."),
+                                            llvm::cl::value_desc("N"),
+                                            llvm::cl::init(1),
+                                            llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gMaxInstantiations("max-instantiations",
+                       llvm::cl::desc("Generate at most <N> template instantiations per\n"
+                                      "translation unit. The remaining ones are summarized\n"
+                                      "in a comment per template. 0 means no limit."),
+                       llvm::cl::value_desc("N"),
+                       llvm::cl::location(gInsightsOptions.maxInstantiations),
+                       llvm::cl::init(0),
+                       llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gMaxOutputBytes("max-output-bytes",
+                    llvm::cl::desc("Stop generating template instantiations once they\n"
+                                   "take up <N> bytes. The remaining ones are summarized\n"
+                                   "in a comment per template. 0 means no limit."),
+                    llvm::cl::value_desc("N"),
+                    llvm::cl::location(gInsightsOptions.maxOutputBytes),
+                    llvm::cl::init(0),
+                    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gMaxArrayElements("max-array-elements",
+                      llvm::cl::desc("Spell out at most <N> equal elements when filling an\n"
+                                     "array. Longer runs are written as '/* <count> x */\n"
+                                     "<value>'. 0 means no limit."),
+                      llvm::cl::value_desc("N"),
+                      llvm::cl::location(gInsightsOptions.maxArrayElements),
+                      llvm::cl::init(100),
+                      llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gMaxPackArgs("max-pack-args",
+                 llvm::cl::desc("Spell out at most <N> arguments of a template\n"
+                                "parameter pack. In a longer pack, runs of integers\n"
+                                "with the same distance are written as '/* 0, 1, ...,\n"
+                                "<last> */' and runs of the same type as '/* <count>\n"
+                                "x */ <type>'. 0 means no limit."),
+                 llvm::cl::value_desc("N"),
+                 llvm::cl::location(gInsightsOptions.maxPackArgs),
+                 llvm::cl::init(100),
+                 llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gFunctionBufferSize("function-buffer-size",
+                        llvm::cl::desc("The size in bytes of the small buffer of std::function\n"
+                                       "--show-closure-layout compares closures against."),
+                        llvm::cl::value_desc("N"),
+                        llvm::cl::location(gInsightsOptions.functionBufferSize),
+                        llvm::cl::init(16),
+                        llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gPassByValueThreshold("pass-by-value-threshold",
+                          llvm::cl::desc("The size in bytes above which --show-pass-by-value\n"
+                                         "annotates a trivially copyable parameter."),
+                          llvm::cl::value_desc("N"),
+                          llvm::cl::location(gInsightsOptions.passByValueThreshold),
+                          llvm::cl::init(16),
+                          llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gStackFrameThreshold("stack-frame-threshold",
+                         llvm::cl::desc("The estimated stack frame size in bytes above which\n"
+                                        "--show-stack-frame marks a function."),
+                         llvm::cl::value_desc("N"),
+                         llvm::cl::location(gInsightsOptions.stackFrameThreshold),
+                         llvm::cl::init(4096),
+                         llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gCacheLineSize("cache-line-size",
+                   llvm::cl::desc("The size in bytes of a cache line for --show-layout\n"
+                                  "and --show-false-sharing."),
+                   llvm::cl::value_desc("N"),
+                   llvm::cl::location(gInsightsOptions.cacheLineSize),
+                   llvm::cl::init(64),
+                   llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gUnrollFactor("alt-syntax-unroll",
+                  llvm::cl::desc("Unroll the for-loops and range-based for-loops with\n"
+                                 "a constant trip count: fully up to <N> iterations,\n"
+                                 "otherwise <N> copies of the body per iteration with\n"
+                                 "the remaining iterations peeled off in front."),
+                  llvm::cl::value_desc("N"),
+                  llvm::cl::location(gInsightsOptions.unrollFactor),
+                  llvm::cl::init(0),
+                  llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::list<std::string>
+    gSyncAnnotations("sync-annotation",
+                     llvm::cl::desc("Fields with __attribute__((annotate(\"<name>\"))) of one of\n"
+                                    "these names are synchronization members for\n"
+                                    "--show-false-sharing, like atomics and mutexes."),
+                     llvm::cl::value_desc("name"),
+                     llvm::cl::CommaSeparated,
+                     llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::list<std::string>
+    gLockTypes("lock-type",
+               llvm::cl::desc("The qualified names of the classes and class templates\n"
+                              "whose local variables --show-lock-scope treats as\n"
+                              "locks. Default: std::lock_guard, std::unique_lock,\n"
+                              "std::scoped_lock and std::shared_lock."),
+               llvm::cl::value_desc("name"),
+               llvm::cl::CommaSeparated,
+               llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string>
+    gFieldProfile("field-profile",
+                  llvm::cl::desc("Read the accesses of each field as lines of\n"
+                                 "'<Record>::<field>,<count>' from <file> and suggest\n"
+                                 "a split of each profiled class into the hot fields\n"
+                                 "and the cold ones behind a pointer."),
+                  llvm::cl::value_desc("file"),
+                  llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<CastCost, true> gShowCasts(
+    "show-casts",
+    llvm::cl::desc("Tag the implicit conversions of this cost class and\n"
+                   "the costlier ones:"),
+    llvm::cl::values(clEnumValN(CastCost::None, "none", "None (default)."),
+                     clEnumValN(CastCost::Free, "all", "All, also the ones without code."),
+                     clEnumValN(CastCost::Cheap, "cheap", "Integral and floating point casts."),
+                     clEnumValN(CastCost::IntFloat, "int-float", "Conversions between integral and floating point."),
+                     clEnumValN(CastCost::Adjustment, "adjust", "Derived-to-base conversions adjusting the pointer."),
+                     clEnumValN(CastCost::Expensive, "expensive", "User-defined conversions, only inside of loops.")),
+    llvm::cl::location(gInsightsOptions.showCasts),
+    llvm::cl::init(CastCost::None),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+enum class OutputFormat
 {
-    llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
-    llvm::cl::HideUnrelatedOptions(gInsightCategory);
-    llvm::cl::SetVersionPrinter(&PrintVersion);
+    Source,
+    EditsJson,
+};
 
-    CommonOptionsParser op(argc, argv, gInsightCategory);
-    ClangTool           tool(op.getCompilations(), op.getSourcePathList());
+static llvm::cl::opt<OutputFormat>
+    gOutputFormat("output",
+                  llvm::cl::desc("The format of the result:"),
+                  llvm::cl::values(clEnumValN(OutputFormat::Source, "source", "The transformed file (default)."),
+                                   clEnumValN(OutputFormat::EditsJson,
+                                              "edits-json",
+                                              "Only the edits as JSON, each with its byte range\n"
+                                              "in the original file, the replacement and the\n"
+                                              "handler which made it.")),
+                  llvm::cl::init(OutputFormat::Source),
+                  llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    llvm::StringRef sourceFilePath = op.getSourcePathList().front();
-    // In STDINMode, we override the file content with the <stdin> input.
-    // Since `tool.mapVirtualFile` takes `StringRef`, we define `Code` outside of
-    // the if-block so that `Code` is not released after the if-block.
-    std::unique_ptr<llvm::MemoryBuffer> inMemoryCode{};
+static llvm::cl::list<std::string> gHandlers("handlers",
+                                             llvm::cl::desc("Create only the listed handlers, out of templates,\n"
+                                                            "records, functions, globals and static-asserts.\n"
+                                                            "The matchers of the others never run."),
+                                             llvm::cl::value_desc("handler"),
+                                             llvm::cl::CommaSeparated,
+                                             llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    if(gStdinMode) {
-        assert(op.getSourcePathList().size() == 1 && "Expect exactly one file path in STDINMode.");
-        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> codeOrErr = llvm::MemoryBuffer::getSTDIN();
-        if(const std::error_code errorCode = codeOrErr.getError()) {
-            llvm::errs() << errorCode.message() << "\n";
-            return 1;
-        }
-        inMemoryCode = std::move(codeOrErr.get());
-        if(inMemoryCode->getBufferSize() == 0) {
-            Error("empty file\n");
-            return 1;  // Skip empty files.
-        }
+static llvm::cl::opt<std::string> gRange("range",
+                                         llvm::cl::desc("Transform only the top-level declarations which\n"
+                                                        "overlap the lines <first>:<last> of the main file.\n"
+                                                        "The rest of the file is copied unchanged."),
+                                         llvm::cl::value_desc("first>:<last"),
+                                         llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-        tool.mapVirtualFile(sourceFilePath, inMemoryCode->getBuffer());
-    }
+static llvm::cl::opt<uint64_t> gOffset("offset",
+                                       llvm::cl::desc("Transform only the top-level declaration at the\n"
+                                                      "byte <offset> of the main file. The rest of the file\n"
+                                                      "is copied unchanged."),
+                                       llvm::cl::value_desc("offset"),
+                                       llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    auto prependArgument = [&](auto arg) {
-        tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(arg, ArgumentInsertPosition::BEGIN));
-    };
+static llvm::cl::list<std::string> gStdMatrix("std-matrix",
+                                              llvm::cl::desc("Transform the source file once for each of the\n"
+                                                             "listed standards, like c++14,c++17,c++2a, in\n"
+                                                             "parallel. Prints a JSON object with the result and\n"
+                                                             "the time of each standard."),
+                                              llvm::cl::value_desc("standard"),
+                                              llvm::cl::CommaSeparated,
+                                              llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    // Special handling to spare users to figure out what include paths to add.
+static llvm::cl::list<std::string>
+    gOptionMatrix("option-matrix",
+                  llvm::cl::desc("Parse the source file once and transform it for\n"
+                                 "each of the listed option sets. A set is a list of\n"
+                                 "options joined by '+', like alt-syntax-for+show-all-\n"
+                                 "implicit-casts=false, on top of the other options.\n"
+                                 "'default' is the other options as they are. Prints a\n"
+                                 "JSON object with the result of each set."),
+                  llvm::cl::value_desc("options"),
+                  llvm::cl::CommaSeparated,
+                  llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    // For some reason, Clang on Apple seems to require an additional hint for the C++ headers.
-#ifdef __APPLE__
-    gUseLibCpp = true;
-#endif /* __APPLE__ */
+static llvm::cl::opt<uint64_t, true>
+    gDeadlineMs("deadline-ms",
+                llvm::cl::desc("Stop the code generation of a translation unit after\n"
+                               "<N> ms. The output is the code generated so far,\n"
+                               "followed by a 'truncated: deadline exceeded'\n"
+                               "comment, and the exit code is 3. 0 means no limit."),
+                llvm::cl::value_desc("N"),
+                llvm::cl::location(gInsightsOptions.deadlineMs),
+                llvm::cl::init(0),
+                llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    if(gUseLibCpp) {
-        prependArgument(INSIGHTS_LLVM_INCLUDE_DIR);
-        prependArgument("-stdlib=libc++");
-    }
+static llvm::cl::opt<std::string> gOutputDir("output-dir",
+                                             llvm::cl::desc("Write the result for each source file to\n"
+                                                            "<directory>/<file name> instead of stdout."),
+                                             llvm::cl::value_desc("directory"),
+                                             llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
 
-    prependArgument(INSIGHTS_CLANG_RESOURCE_INCLUDE_DIR);
-    prependArgument(INSIGHTS_CLANG_RESOURCE_DIR);
+static llvm::cl::opt<std::string> gProject("project",
+                                           llvm::cl::desc("Process every translation unit of the compilation\n"
+                                                          "database <compile_commands.json> in parallel. The\n"
+                                                          "results go to --output-dir, with the same relative\n"
+                                                          "paths as the sources."),
+                                           llvm::cl::value_desc("compile_commands.json"),
+                                           llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gDedupStore("dedup-store",
+                                       llvm::cl::desc("With --output-dir, store the generated code once in\n"
+                                                      "<directory>/.insights-store, keyed by its hash, and\n"
+                                                      "write <file name>.manifest instead of each result."),
+                                       llvm::cl::init(false),
+                                       llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gMaterialize("materialize",
+                                               llvm::cl::desc("Write the result a --dedup-store manifest describes\n"
+                                                              "to stdout."),
+                                               llvm::cl::value_desc("manifest"),
+                                               llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gTimeReport("time-report",
+                                       llvm::cl::desc("Print wall and CPU time of parsing, matching, each\n"
+                                                      "handler and writing the result to stderr."),
+                                       llvm::cl::init(false),
+                                       llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gTimeReportJson("time-report-json",
+                                           llvm::cl::desc("Like --time-report, but print the report as JSON.\n"
+                                                          "In --batch mode the report is part of each result."),
+                                           llvm::cl::init(false),
+                                           llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gMemReport("mem-report",
+                                      llvm::cl::desc("Print peak RSS, the AST memory, the size of the\n"
+                                                     "rewrite buffer and the output buffers per handler\n"
+                                                     "to stderr."),
+                                      llvm::cl::init(false),
+                                      llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gMemReportJson("mem-report-json",
+                                          llvm::cl::desc("Like --mem-report, but print the report as JSON.\n"
+                                                         "In --batch mode the report is part of each result."),
+                                          llvm::cl::init(false),
+                                          llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gAllocSites("alloc-sites",
+                                       llvm::cl::desc("Print the heap allocations and their bytes per\n"
+                                                      "handler and node kind of the code generation to\n"
+                                                      "stderr, the most frequent first."),
+                                       llvm::cl::init(false),
+                                       llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gHeapProfile("heap-profile",
+                                               llvm::cl::desc("Sample the heap allocations with their stack traces\n"
+                                                              "and write them as a pprof profile to <file>. The\n"
+                                                              "bottom frame and the label 'phase' tell parsing\n"
+                                                              "from the handlers."),
+                                               llvm::cl::value_desc("file"),
+                                               llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t> gHeapProfileRate("heap-profile-rate",
+                                                llvm::cl::desc("Sample an allocation every <N> bytes on average\n"
+                                                               "for --heap-profile."),
+                                                llvm::cl::value_desc("N"),
+                                                llvm::cl::init(512 * 1024),
+                                                llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gBloatReport("bloat-report",
+                                        llvm::cl::desc("Print the number of instantiations and the size of\n"
+                                                       "the generated code per template and the argument\n"
+                                                       "with the most distinct values to stderr."),
+                                        llvm::cl::init(false),
+                                        llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<FindingsFormat>
+    gFindings("findings",
+              llvm::cl::desc("Write the performance annotations which are\n"
+                             "enabled with their location, category, severity\n"
+                             "and cost to stderr or --findings-file:"),
+              llvm::cl::values(clEnumValN(FindingsFormat::None, "none", "No findings (default)."),
+                               clEnumValN(FindingsFormat::Sarif, "sarif", "As SARIF 2.1.0."),
+                               clEnumValN(FindingsFormat::Json, "json", "As a JSON array.")),
+              llvm::cl::init(FindingsFormat::None),
+              llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gFindingsFile("findings-file",
+                                                llvm::cl::desc("Write the --findings to <file> instead of stderr."),
+                                                llvm::cl::value_desc("file"),
+                                                llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gSourceMap("source-map",
+                                             llvm::cl::desc("Write a source map of the result to <file>, which\n"
+                                                            "maps each part of the generated code to the line\n"
+                                                            "and column of the node it was generated from."),
+                                             llvm::cl::value_desc("file"),
+                                             llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gSemanticTokens("semantic-tokens",
+                                                  llvm::cl::desc("Write the offset, length and class of each token of\n"
+                                                                 "the result to <file>, with a mark for the code C++\n"
+                                                                 "Insights generated."),
+                                                  llvm::cl::value_desc("file"),
+                                                  llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gLowered("lowered",
+                                           llvm::cl::desc("Compile the result again and write the optimized\n"
+                                                          "code of each function with its line in the result\n"
+                                                          "and its instruction count to <file> as JSON."),
+                                           llvm::cl::value_desc("file"),
+                                           llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<LoweredFormat>
+    gLoweredFormat("lowered-format",
+                   llvm::cl::desc("What --lowered writes per function:"),
+                   llvm::cl::values(clEnumValN(LoweredFormat::Asm, "asm", "The assembly (default)."),
+                                    clEnumValN(LoweredFormat::IR, "ir", "The LLVM IR.")),
+                   llvm::cl::init(LoweredFormat::Asm),
+                   llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gLoweredOptLevel("lowered-opt-level",
+                                                llvm::cl::desc("The -O level --lowered compiles the result with,\n"
+                                                               "0 to 3. Default 2."),
+                                                llvm::cl::value_desc("level"),
+                                                llvm::cl::init(2),
+                                                llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gIncludeReport("include-report",
+                                          llvm::cl::desc("Print the files, bytes, declarations and parse time\n"
+                                                         "of each #include of the main file to stderr."),
+                                          llvm::cl::init(false),
+                                          llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gUnusedIncludes("unused-includes",
+                                           llvm::cl::desc("Print the #includes of the main file which add no\n"
+                                                          "declaration or macro the main file refers to, with\n"
+                                                          "their parse time, to stderr."),
+                                           llvm::cl::init(false),
+                                           llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned>
+    gInstantiationReport("instantiation-report",
+                         llvm::cl::desc("Print the <n> instantiated templates which took\n"
+                                        "the most compile time to stderr."),
+                         llvm::cl::value_desc("n"),
+                         llvm::cl::init(0),
+                         llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string>
+    gEmitExternTemplates("emit-extern-templates",
+                         llvm::cl::desc("Write extern_templates.h with 'extern template'\n"
+                                        "declarations of the heaviest instantiations of all\n"
+                                        "translation units and extern_templates.cpp with the\n"
+                                        "matching explicit instantiations to <dir>."),
+                         llvm::cl::value_desc("dir"),
+                         llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned>
+    gExternTemplatesCount("extern-templates-count",
+                          llvm::cl::desc("The number of instantiations --emit-extern-templates\n"
+                                         "writes (default 32)."),
+                          llvm::cl::value_desc("n"),
+                          llvm::cl::init(32),
+                          llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<ExternTemplatesRank> gExternTemplatesBy(
+    "extern-templates-by",
+    llvm::cl::desc("What makes an instantiation heavy for\n--emit-extern-templates:"),
+    llvm::cl::values(clEnumValN(ExternTemplatesRank::Size, "size", "The size of the generated code (default)."),
+                     clEnumValN(ExternTemplatesRank::Time, "time", "The compile time of the instantiation.")),
+    llvm::cl::init(ExternTemplatesRank::Size),
+    llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string>
+    gEmitLayoutAsserts("emit-layout-asserts",
+                       llvm::cl::desc("Write a header with static_asserts of the size, the\n"
+                                      "alignment and the field offsets of the hot classes\n"
+                                      "of all translation units to <file>."),
+                       llvm::cl::value_desc("file"),
+                       llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::list<std::string>
+    gHotRecords("hot-record",
+                llvm::cl::desc("The qualified names of the classes and class templates\n"
+                               "--emit-layout-asserts treats as hot, in addition to the\n"
+                               "ones with __attribute__((annotate(\"hot\")))."),
+                llvm::cl::value_desc("name"),
+                llvm::cl::CommaSeparated,
+                llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<TypeSizesFormat>
+    gTypeSizes("type-sizes",
+               llvm::cl::desc("Print the size, alignment, fields, padding and\n"
+                              "triviality of the classes of the main file to\n"
+                              "stderr, the largest first:"),
+               llvm::cl::values(clEnumValN(TypeSizesFormat::None, "none", "No table (default)."),
+                                clEnumValN(TypeSizesFormat::Csv, "csv", "As CSV."),
+                                clEnumValN(TypeSizesFormat::Json, "json", "As a JSON array.")),
+               llvm::cl::init(TypeSizesFormat::None),
+               llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gProfileNodes("profile-nodes",
+                                         llvm::cl::desc("Print the calls, the time with and without the\n"
+                                                        "nested nodes and the generated bytes of the code\n"
+                                                        "generation per node kind to stderr."),
+                                         llvm::cl::init(false),
+                                         llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gProfileMatchers("profile-matchers",
+                                            llvm::cl::desc("Print the time spent in each matcher, grouped by\n"
+                                                           "handler and sorted by cost, to stderr."),
+                                            llvm::cl::init(false),
+                                            llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gTraceFile("trace",
+                                             llvm::cl::desc("Write trace events of the handlers, the code\n"
+                                                            "generation and expensive helpers to <file> in the\n"
+                                                            "Chrome trace-event format (chrome://tracing,\n"
+                                                            "Perfetto)."),
+                                             llvm::cl::value_desc("file.json"),
+                                             llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<unsigned> gTraceGranularity("trace-granularity",
+                                                 llvm::cl::desc("Drop --trace events shorter than <us> microseconds.\n"
+                                                                "Default: 0, all events are kept."),
+                                                 llvm::cl::value_desc("us"),
+                                                 llvm::cl::init(0),
+                                                 llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gMeasureOverhead("measure-overhead",
+                                            llvm::cl::desc("Parse each source file once with a no-op action\n"
+                                                           "and once with C++ Insights, both with the same\n"
+                                                           "arguments, and print the times and their ratio."),
+                                            llvm::cl::init(false),
+                                            llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gEstimate("estimate",
+                                     llvm::cl::desc("Run only the preprocessor and print a JSON estimate\n"
+                                                    "of the cost of each source file: the includes, the\n"
+                                                    "tokens, the lambdas, the template declarations and\n"
+                                                    "the largest array extent."),
+                                     llvm::cl::init(false),
+                                     llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string> gFromAst("from-ast",
+                                           llvm::cl::desc("Transform the translation unit serialized in <file.ast>\n"
+                                                          "by 'clang -emit-ast' instead of parsing the source\n"
+                                                          "files. The sources it was built from must be\n"
+                                                          "unchanged."),
+                                           llvm::cl::value_desc("file.ast"),
+                                           llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gFreeOnExit("free-on-exit",
+                                       llvm::cl::desc("Free the AST and the rewriter buffers of a single\n"
+                                                      "file before exiting. By default they are leaked,\n"
+                                                      "like clang -disable-free does, which saves the\n"
+                                                      "time to tear them down. For leak checkers."),
+                                       llvm::cl::init(false),
+                                       llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gStream("stream",
+                                   llvm::cl::desc("Write each top-level declaration of the main file as\n"
+                                                  "soon as it is transformed instead of the entire file\n"
+                                                  "at the end. The header <new> is included before the\n"
+                                                  "first declaration which needs it."),
+                                   llvm::cl::init(false),
+                                   llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<std::string, true>
+    gFormat("format",
+            llvm::cl::desc("Format the generated code in-process with the\n"
+                           "clang-format style <style>, like LLVM or file. The\n"
+                           "code of the source stays as it is."),
+            llvm::cl::value_desc("style"),
+            llvm::cl::location(gInsightsOptions.formatStyle),
+            llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool, true>
+    gVerifyOutput("verify-output",
+                  llvm::cl::desc("Parse the result again in-process with the same\n"
+                                 "arguments and report its errors. The exit code is 4,\n"
+                                 "if the result does not compile."),
+                  llvm::cl::location(gInsightsOptions.verifyOutput),
+                  llvm::cl::init(false),
+                  llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool, true>
+    gSkipOnError("skip-on-error",
+                 llvm::cl::desc("Skip the code generation of a translation unit with\n"
+                                "errors. Only the diagnostics are written, there is\n"
+                                "no output."),
+                 llvm::cl::location(gInsightsOptions.skipOnError),
+                 llvm::cl::init(false),
+                 llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<uint64_t, true>
+    gErrorLimit("error-limit",
+                llvm::cl::desc("Stop parsing after <N> errors, like -ferror-limit.\n"
+                               "0 keeps the limit of clang."),
+                llvm::cl::value_desc("N"),
+                llvm::cl::location(gInsightsOptions.errorLimit),
+                llvm::cl::init(0),
+                llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+static llvm::cl::opt<bool> gShowStats("stats",
+                                      llvm::cl::desc("Print statistics to stderr when done."),
+                                      llvm::cl::init(false),
+                                      llvm::cl::cat(gInsightCategory));
+//-----------------------------------------------------------------------------
+
+#define INSIGHTS_OPT(option, name, deflt, description, category)                                                       \
+    static llvm::cl::opt<bool, true> g##name(option,                                                                   \
+                                             llvm::cl::desc(description),                                              \
+                                             llvm::cl::NotHidden,                                                      \
+                                             llvm::cl::location(gInsightsOptions.name),                                \
+                                             llvm::cl::init(deflt),                                                    \
+                                             llvm::cl::cat(category));
+//-----------------------------------------------------------------------------
+
+#include "InsightsOptions.def"
+//-----------------------------------------------------------------------------
+
+const ASTContext& GetGlobalAST()
+{
+    return *gContext->ast;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Check whether \p decl is within the range selected with \c --range or \c --offset.
+static bool IsInSelectedRange(const Decl& decl, const SourceManager& sm, const InsightsOptions& options)
+{
+    const auto begin = sm.getExpansionLoc(decl.getBeginLoc());
+    const auto end   = sm.getExpansionLoc(decl.getEndLoc());
+
+    if(options.hasRangeOffset) {
+        const uint64_t endOffset{sm.getFileOffset(end) + Lexer::MeasureTokenLength(end, sm, decl.getLangOpts())};
+
+        return (sm.getFileOffset(begin) <= options.rangeOffset) and (options.rangeOffset < endOffset);
+    }
+
+    if(0 != options.rangeFirstLine) {
+        return (sm.getExpansionLineNumber(begin) <= options.rangeLastLine) and
+               (sm.getExpansionLineNumber(end) >= options.rangeFirstLine);
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Restrict all AST traversals, including the one of the \ref MatchFinder, to the top-level declarations of the
+/// main file, which overlap the range selected with \c --range or \c --offset.
+///
+/// Without this, every matcher walks all the declarations from the headers, only to filter them out with \c
+/// isExpansionInSystemHeader. The rewriter only emits the main file, so nothing outside of it is of interest. The
+/// instantiations of a template are part of its declaration, they come along with it.
+static void LimitTraversalScopeToMainFile(ASTContext& context)
+{
+    const auto&        sm      = context.getSourceManager();
+    const auto&        options = GetInsightsOptions();
+    std::vector<Decl*> mainFileDecls{};
+
+    for(auto* decl : context.getTranslationUnitDecl()->decls()) {
+        if(IsExpansionInMainFile(sm, decl->getBeginLoc()) and IsInSelectedRange(*decl, sm, options)) {
+            mainFileDecls.push_back(decl);
+        }
+    }
+
+    context.setTraversalScope(mainFileDecls);
+}
+//-----------------------------------------------------------------------------
+
+class CppInsightASTConsumer final : public ASTConsumer
+{
+public:
+    CppInsightASTConsumer(OutputSink& outputSink, InsightsContext& insightsContext, raw_ostream& output)
+    : ASTConsumer()
+    , mMatcherProfile{}
+    , mMatcher{GetMatchFinderOptions(mMatcherProfile)}
+    , mInsightsContext{insightsContext}
+    , mRecordDeclHandler{MakeHandler<RecordDeclHandler>(InsightsHandler::Records, outputSink)}
+    , mStaticAssertHandler{MakeHandler<StaticAssertHandler>(InsightsHandler::StaticAsserts, outputSink)}
+    , mTemplateHandler{MakeHandler<TemplateHandler>(InsightsHandler::Templates, outputSink)}
+    , mGlobalVariableHandler{MakeHandler<GlobalVariableHandler>(InsightsHandler::Globals, outputSink)}
+    , mFunctionDeclHandler{MakeHandler<FunctionDeclHandler>(InsightsHandler::Functions, outputSink)}
+    , mDeclDispatcher{GetHandler(mRecordDeclHandler),
+                      GetHandler(mStaticAssertHandler),
+                      GetHandler(mTemplateHandler),
+                      GetHandler(mGlobalVariableHandler),
+                      GetHandler(mFunctionDeclHandler)}
+    , mOutputSink{outputSink}
+    , mOutput{output}
+    , mParsingPhase{TimePhase::Parsing}
+    {
+        // The deadline covers parsing as well, only the code generation can stop early though.
+        if(const auto deadlineMs = mInsightsContext.options.deadlineMs) {
+            mInsightsContext.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds{deadlineMs};
+        }
+    }
+
+    /// \brief Sema asks this for each function body with \c --skip-header-bodies. It already keeps the bodies of \c
+    /// constexpr functions and of those with a deduced return type, both may be needed to parse the rest.
+    bool shouldSkipFunctionBody(Decl* decl) override
+    {
+        // A template gets instantiated with its body, which the main file may use.
+        if(const auto* function = decl->getAsFunction(); not function or function->isTemplated()) {
+            return false;
+        }
+
+        const auto& sm = decl->getASTContext().getSourceManager();
+
+        return not IsExpansionInMainFile(sm, decl->getLocation());
+    }
+
+    void HandleTranslationUnit(ASTContext& context) override
+    {
+        // The consumer is created right before parsing starts and this is called when the entire TU is parsed.
+        mParsingPhase.Stop();
+
+        mInsightsContext.ast = &context;
+        InsightsContextScope contextScope{mInsightsContext};
+
+        // The AST of an input with errors is partially invalid, the output would be of little use. The diagnostics
+        // are all a user needs then.
+        if(mInsightsContext.options.skipOnError and context.getDiagnostics().hasErrorOccurred()) {
+            mInsightsContext.skippedOnError = true;
+            return;
+        }
+
+        CodeGenerator::ResetTranslationUnitState();
+        ResetTypeNameCache();
+        // The parsed units of --pipeline, --from-ast and --option-matrix may reuse the address of an earlier
+        // SourceManager, the cache would hand out the kinds of that file.
+        ResetFileKindCache();
+        ResetTokenIndex();
+        ResetDeclCacheTranslationUnit();
+        ResetMemoryLimitTranslationUnit();
+        ResetArena();
+        ResetGenerationUnits();
+
+        if(not gTraverseAllDecls) {
+            LimitTraversalScopeToMainFile(context);
+        }
+
+        // Sema is done, all instantiations of this translation unit have their events.
+        if(GetInsightsOptions().ShowInstantiationCost or IsInstantiationReportEnabled() or
+           (IsExternTemplatesEnabled() and (ExternTemplatesRank::Time == gExternTemplatesBy))) {
+            CollectInstantiationCosts();
+        }
+
+        {
+            TimePhaseScope timePhase{TimePhase::Matching};
+
+            if(mInsightsContext.options.streamOutput) {
+                MatchAndStream(context);
+
+            } else {
+                Match(context);
+            }
+        }
+
+        if(mInsightsContext.deadlineExceeded) {
+            const auto& sm = context.getSourceManager();
+
+            mOutputSink.InsertText(sm.getLocForEndOfFile(sm.getMainFileID()),
+                                   "\n/* truncated: deadline exceeded */\n",
+                                   OutputSink::IndentNewLines::No,
+                                   "CppInsightASTConsumer");
+        }
+
+        if(IsMatcherProfilingEnabled()) {
+            AddMatcherProfile(mMatcherProfile);
+        }
+
+        if(IsNodeProfilingEnabled()) {
+            AddNodeProfile();
+        }
+
+        if(IsAllocationSitesEnabled()) {
+            AddAllocationSites();
+        }
+
+        // Check whether we had static local variables which we transformed. Then for the placement-new we need to
+        // include the header <new>.
+        if(auto* shardResult = GetShardResult(); shardResult and CodeGenerator::NeedToInsertNewHeader()) {
+            // The shards merge their results, the header must be included only once.
+            shardResult->needsNewHeader = true;
+
+        } else if(CodeGenerator::NeedToInsertNewHeader() and not mInsightsContext.options.streamOutput) {
+            const auto& sm         = context.getSourceManager();
+            const auto& mainFileId = sm.getMainFileID();
+            const auto  loc        = sm.translateFileLineCol(sm.getFileEntryForID(mainFileId), 1, 1);
+
+            mOutputSink.InsertText(loc,
+                                   "#include <new> // for thread-safe static's placement new\n",
+                                   OutputSink::IndentNewLines::No,
+                                   "CppInsightASTConsumer");
+        }
+
+        // The tables cannot be combined with --codegen-jobs and --stream, see main. A shard sees only a part of the
+        // functions and the streamed output is already written.
+        if(not GetShardResult() and not mInsightsContext.options.streamOutput) {
+            if(GetInsightsOptions().ShowAllocations) {
+                AppendTable(context, CodeGenerator::GetAllocationTable());
+            }
+
+            if(GetInsightsOptions().ShowGlobalInit) {
+                AppendTable(context, CodeGenerator::GetGlobalInitTable());
+            }
+
+            if(GetInsightsOptions().ShowNoexceptMove) {
+                AppendTable(context, GetThrowingMoveElementTable(context));
+            }
+        }
+
+        // Each shard parses the entire translation unit, the classes are recorded by one of them.
+        if(IsTypeSizesEnabled() and IsFirstCodegenShard()) {
+            RecordTypeSizes(context);
+        }
+
+        if(IsLayoutAssertsEnabled() and IsFirstCodegenShard()) {
+            RecordLayoutAsserts(context);
+        }
+
+        if((IsIncludeReportEnabled() or IsUnusedIncludesEnabled()) and IsFirstCodegenShard()) {
+            FinishIncludeReport(context);
+        }
+
+        RecordASTMemory(context);
+
+        if(IsMetricsEnabled()) {
+            RecordTranslationUnitMetrics(mTemplateHandler ? mTemplateHandler->GetInstantiations() : 0,
+                                         context.getASTAllocatedMemory() + context.getSideTableAllocatedMemory(),
+                                         mInsightsContext.deadlineExceeded);
+        }
+
+        mInsightsContext.ast = nullptr;
+    }
+
+private:
+    /// \brief Append the report \p table to the end of the main file.
+    void AppendTable(const ASTContext& context, const std::string& table)
+    {
+        if(table.empty()) {
+            return;
+        }
+
+        const auto& sm = context.getSourceManager();
+
+        mOutputSink.InsertText(sm.getLocForEndOfFile(sm.getMainFileID()),
+                               "\n" + table,
+                               OutputSink::IndentNewLines::No,
+                               "CppInsightASTConsumer");
+    }
+
+    void Match(ASTContext& context)
+    {
+        if(gVisitorDispatch) {
+            mDeclDispatcher.Run(context);
+        } else {
+            mMatcher.matchAST(context);
+        }
+
+        if(mTemplateHandler) {
+            mTemplateHandler->InsertSuppressedSummary();
+        }
+    }
+
+    /// \brief Match the top-level declarations one by one and write the output up to the next one after each, see \c
+    /// --stream.
+    ///
+    /// The edits of a declaration stay within it, so everything before the next declaration is final. The header
+    /// <new> is included right before the first declaration which needs it, not at the top of the file.
+    void MatchAndStream(ASTContext& context)
+    {
+        const auto&        sm = context.getSourceManager();
+        std::vector<Decl*> decls{context.getTraversalScope()};
+
+        auto getOffset = [&](const Decl* decl) { return sm.getFileOffset(sm.getExpansionLoc(decl->getBeginLoc())); };
+
+        // Outside of the main file, with --traverse-all-decls, everything is written at the end.
+        const bool inMainFile{std::all_of(decls.begin(), decls.end(), [&](const Decl* decl) {
+            return IsExpansionInMainFile(sm, decl->getBeginLoc());
+        })};
+
+        if(not inMainFile) {
+            Match(context);
+            return;
+        }
+
+        std::stable_sort(decls.begin(), decls.end(), [&](const Decl* lhs, const Decl* rhs) {
+            return getOffset(lhs) < getOffset(rhs);
+        });
+
+        bool newHeaderInserted{};
+
+        for(size_t i = 0; i < decls.size(); ++i) {
+            context.setTraversalScope({decls[i]});
+            Match(context);
+
+            if(not newHeaderInserted and CodeGenerator::NeedToInsertNewHeader()) {
+                newHeaderInserted = true;
+                mOutputSink.StreamLine(mOutput, "#include <new> // for thread-safe static's placement new\n");
+            }
+
+            if(i + 1 < decls.size()) {
+                mOutputSink.Stream(mOutput, getOffset(decls[i + 1]));
+                mOutput.flush();
+            }
+        }
+
+        context.setTraversalScope(decls);
+    }
+
+    /// \brief Create a handler, which registers its matchers, only if it is enabled with \c --handlers.
+    template<typename T>
+    std::optional<T> MakeHandler(const InsightsHandler handler, OutputSink& outputSink)
+    {
+        if(not mInsightsContext.options.IsEnabled(handler)) {
+            return std::nullopt;
+        }
+
+        return std::optional<T>{std::in_place, outputSink, mMatcher};
+    }
+
+    template<typename T>
+    static T* GetHandler(std::optional<T>& handler)
+    {
+        return handler ? &*handler : nullptr;
+    }
+
+    llvm::StringMap<llvm::TimeRecord>    mMatcherProfile;
+    MatchFinder                          mMatcher;
+    InsightsContext&                     mInsightsContext;
+    std::optional<RecordDeclHandler>     mRecordDeclHandler;
+    std::optional<StaticAssertHandler>   mStaticAssertHandler;
+    std::optional<TemplateHandler>       mTemplateHandler;
+    std::optional<GlobalVariableHandler> mGlobalVariableHandler;
+    std::optional<FunctionDeclHandler>   mFunctionDeclHandler;
+    DeclDispatcher                       mDeclDispatcher;
+    OutputSink&                          mOutputSink;
+    raw_ostream&                         mOutput;  //!< Where the output goes with \c --stream.
+    TimePhaseScope                       mParsingPhase;
+};
+//-----------------------------------------------------------------------------
+
+class CppInsightFrontendAction final : public ASTFrontendAction
+{
+public:
+    CppInsightFrontendAction(raw_ostream& ostream, InsightsContext& insightsContext)
+    : mOutput{ostream}
+    , mInsightsContext{insightsContext}
+    {
+    }
+
+    bool BeginSourceFileAction(CompilerInstance& CI) override
+    {
+        // Before clang loads the PCH, so that it uses the shared mapping instead of reading its own copy.
+        MapModuleFiles(CI);
+
+        return true;
+    }
+
+    void EndSourceFileAction() override
+    {
+        TimePhaseScope timePhase{TimePhase::EndSourceFileAction};
+
+        if(mInsightsContext.skippedOnError) {
+            return;
+        }
+
+        if(auto* shardResult = GetShardResult()) {
+            mOutputSink.Export(*shardResult);
+        } else if(mInsightsContext.options.outputEdits) {
+            mOutputSink.WriteEdits(mOutput);
+
+        } else if(mInsightsContext.options.verifyOutput and not mInsightsContext.options.streamOutput) {
+            WriteVerified();
+
+        } else if(not mInsightsContext.options.formatStyle.empty()) {
+            mOutputSink.WriteFormatted(mOutput, mInsightsContext.options.formatStyle);
+
+        } else if(IsContentStoreEnabled()) {
+            if(not mOutputSink.WriteManifest(mOutput)) {
+                Error("content store: cannot store the result\n");
+            }
+
+        } else if(mInsightsContext.options.streamOutput) {
+            mOutputSink.FinishStream(mOutput);
+
+        } else if(&llvm::outs() == &mOutput) {
+            // The result is mostly slices of the main file, they go to stdout without a copy into the stream buffer.
+            llvm::outs().flush();
+
+            if(not mOutputSink.WriteGathered(fileno(stdout))) {
+                Error("cannot write the result to stdout\n");
+            }
+
+        } else {
+            mOutputSink.Write(mOutput);
+        }
+
+        // Only the plain result consists of the parts the sink knows.
+        if(mInsightsContext.segments and not GetShardResult() and not mInsightsContext.options.outputEdits and
+           not mInsightsContext.options.verifyOutput and mInsightsContext.options.formatStyle.empty() and
+           not IsContentStoreEnabled() and not mInsightsContext.options.streamOutput) {
+            mOutputSink.GetSegments(*mInsightsContext.segments);
+        }
+
+        if(not gSourceMap.empty() and not GetShardResult() and not mInsightsContext.options.outputEdits) {
+            mOutputSink.WriteSourceMap(gSourceMap);
+        }
+
+        if(not gSemanticTokens.empty() and not GetShardResult() and not mInsightsContext.options.outputEdits) {
+            mOutputSink.WriteSemanticTokens(gSemanticTokens);
+        }
+
+        if(not gLowered.empty() and not GetShardResult() and not mInsightsContext.options.outputEdits) {
+            WriteLoweredResult();
+        }
+    }
+
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance& CI, StringRef /*file*/) override
+    {
+        mOutputSink.SetSourceMgr(CI.getSourceManager(), CI.getLangOpts());
+        ResetFileKindCache();
+
+        if(const auto errorLimit = mInsightsContext.options.errorLimit) {
+            CI.getDiagnostics().setErrorLimit(static_cast<unsigned>(errorLimit));
+        }
+
+        // The consumer decides which bodies are skipped, see CppInsightASTConsumer::shouldSkipFunctionBody.
+        if(gSkipHeaderBodies) {
+            CI.getFrontendOpts().SkipFunctionBodies = true;
+        }
+
+        // Each shard parses the entire translation unit, the includes are counted by one of them.
+        if((IsIncludeReportEnabled() or IsUnusedIncludesEnabled()) and IsFirstCodegenShard()) {
+            StartIncludeReport(CI.getPreprocessor());
+        }
+
+        return
+#if IS_CLANG_NEWER_THAN(9)
+
+            std
+#else
+            llvm
+#endif
+
+            ::make_unique<CppInsightASTConsumer>(mOutputSink, mInsightsContext, mOutput);
+    }
+
+private:
+    /// \brief Write the result, like the other branches of \ref EndSourceFileAction, and parse it again.
+    void WriteVerified()
+    {
+        std::string              result{};
+        llvm::raw_string_ostream stream{result};
+
+        if(not mInsightsContext.options.formatStyle.empty()) {
+            mOutputSink.WriteFormatted(stream, mInsightsContext.options.formatStyle);
+        } else {
+            mOutputSink.Write(stream);
+        }
+
+        stream.flush();
+        mOutput << result;
+
+        if(not VerifyOutput(getCompilerInstance(), result)) {
+            mInsightsContext.verifyFailed = true;
+        }
+    }
+
+    /// \brief Compile the result, as the other branches of \ref EndSourceFileAction write it, for \c --lowered.
+    void WriteLoweredResult()
+    {
+        std::string              result{};
+        llvm::raw_string_ostream stream{result};
+
+        if(not mInsightsContext.options.formatStyle.empty()) {
+            mOutputSink.WriteFormatted(stream, mInsightsContext.options.formatStyle);
+        } else {
+            mOutputSink.Write(stream);
+        }
+
+        stream.flush();
+
+        WriteLowered(gLowered, getCompilerInstance(), result, gLoweredFormat, gLoweredOptLevel);
+    }
+
+    OutputSink       mOutputSink;
+    raw_ostream&     mOutput;
+    InsightsContext& mInsightsContext;
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Factory which creates a \ref CppInsightFrontendAction writing its result to the given stream and using the
+/// given context.
+///
+/// With \p disableFree the compiler instance, the AST and the rewriter buffers are leaked, like clang does it with \c
+/// -disable-free. Tearing them down takes noticeable time for a large translation unit, right before the process exits
+/// anyway.
+class CppInsightFrontendActionFactory final : public FrontendActionFactory
+{
+public:
+    CppInsightFrontendActionFactory(raw_ostream&     ostream,
+                                    InsightsContext& insightsContext,
+                                    const bool       disableFree = false)
+    : mOutput{ostream}
+    , mInsightsContext{insightsContext}
+    , mDisableFree{disableFree}
+    {
+    }
+
+    bool runInvocation(std::shared_ptr<CompilerInvocation>     invocation,
+                       FileManager*                            files,
+                       std::shared_ptr<PCHContainerOperations> pchContainerOps,
+                       DiagnosticConsumer*                     diagConsumer) override
+    {
+        if(not mDisableFree) {
+            return FrontendActionFactory::runInvocation(
+                std::move(invocation), files, std::move(pchContainerOps), diagConsumer);
+        }
+
+        // Same as the base, with the compiler instance and the action on the heap so that they can be leaked. The
+        // tooling turns off the -disable-free of the driver, so it is set here again.
+        invocation->getFrontendOpts().DisableFree = true;
+
+        auto compiler = std::make_unique<CompilerInstance>(std::move(pchContainerOps));
+        compiler->setInvocation(std::move(invocation));
+        compiler->setFileManager(files);
+
+        std::unique_ptr<FrontendAction> action{create()};
+
+        compiler->createDiagnostics(diagConsumer, /*ShouldOwnClient=*/false);
+        if(not compiler->hasDiagnostics()) {
+            return false;
+        }
+
+        compiler->createSourceManager(*files);
+
+        const bool success = compiler->ExecuteAction(*action);
+
+        files->clearStatCache();
+        mOutput.flush();
+
+        llvm::BuryPointer(std::move(action));
+        llvm::BuryPointer(std::move(compiler));
+
+        return success;
+    }
+
+#if IS_CLANG_NEWER_THAN(9)
+    std::unique_ptr<FrontendAction> create() override
+    {
+        return std::make_unique<CppInsightFrontendAction>(mOutput, mInsightsContext);
+    }
+#else
+    FrontendAction* create() override { return new CppInsightFrontendAction(mOutput, mInsightsContext); }
+#endif
+
+private:
+    raw_ostream&     mOutput;
+    InsightsContext& mInsightsContext;
+    const bool       mDisableFree;
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Add the arguments which spare users to figure out what include paths to add.
+static void AddInsightsArgumentAdjusters(ClangTool& tool, const bool useLibCpp)
+{
+    auto prependArgument = [&](auto arg) {
+        tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(arg, ArgumentInsertPosition::BEGIN));
+    };
+
+    if(useLibCpp and gStdModules) {
+        // The module map of libc++ marks the standard library as a system module. An #include of one of its headers
+        // turns into an import and the declarations keep their locations in the system headers.
+        prependArgument(StrCat("-fmodules-cache-path=", gModuleCacheDir.getValue()).c_str());
+        prependArgument("-fimplicit-module-maps");
+        prependArgument("-fmodules");
+    }
+
+    if(useLibCpp) {
+        prependArgument(INSIGHTS_LLVM_INCLUDE_DIR);
+        prependArgument("-stdlib=libc++");
+    }
+
+    prependArgument(INSIGHTS_CLANG_RESOURCE_INCLUDE_DIR);
+    prependArgument(INSIGHTS_CLANG_RESOURCE_DIR);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Run C++ Insights with \p tool, the result goes to \p output and the diagnostics to \p diagnostics.
+///
+/// Without \p options the command line options are used.
+static int RunTool(ClangTool&                  tool,
+                   raw_ostream&                output,
+                   raw_ostream&                diagnostics,
+                   const InsightsOptions&      options  = gInsightsOptions,
+                   std::vector<OutputSegment>* segments = nullptr)
+{
+    llvm::IntrusiveRefCntPtr<DiagnosticOptions> diagOpts{new DiagnosticOptions};
+    TextDiagnosticPrinter                       diagPrinter(diagnostics, diagOpts.get());
+    tool.setDiagnosticConsumer(&diagPrinter);
+
+    InsightsContext context{options};
+    context.segments = segments;
+
+    CppInsightFrontendActionFactory factory{output, context};
+
+    return GetExitCode(tool.run(&factory), context);
+}
+//-----------------------------------------------------------------------------
+
+int TransformCode(StringRef                       fileName,
+                  StringRef                       code,
+                  const std::vector<std::string>& compilerArgs,
+                  raw_ostream&                    output,
+                  raw_ostream&                    diagnostics)
+{
+    FixedCompilationDatabase compilations{".", compilerArgs};
+    ClangTool                tool(compilations, {fileName.str()});
+
+    tool.mapVirtualFile(fileName, code);
+    AddInsightsArgumentAdjusters(tool, gUseLibCpp);
+
+    return RunTool(tool, output, diagnostics);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Transform the already parsed \p unit and write the result to \p output.
+static void TransformUnit(ASTUnit& unit, InsightsContext& context, raw_ostream& output)
+{
+    OutputSink outputSink{};
+    outputSink.SetSourceMgr(unit.getSourceManager(), unit.getLangOpts());
+
+    {
+        CppInsightASTConsumer consumer{outputSink, context, output};
+        consumer.HandleTranslationUnit(unit.getASTContext());
+    }
+
+    if(context.skippedOnError) {
+        return;
+    }
+
+    TimePhaseScope timePhase{TimePhase::EndSourceFileAction};
+
+    if(context.options.outputEdits) {
+        outputSink.WriteEdits(output);
+    } else if(context.options.streamOutput) {
+        outputSink.FinishStream(output);
+    } else if(not context.options.formatStyle.empty()) {
+        outputSink.WriteFormatted(output, context.options.formatStyle);
+    } else {
+        outputSink.Write(output);
+    }
+
+    if(not gSourceMap.empty() and not context.options.outputEdits) {
+        outputSink.WriteSourceMap(gSourceMap);
+    }
+
+    if(not gSemanticTokens.empty() and not context.options.outputEdits) {
+        outputSink.WriteSemanticTokens(gSemanticTokens);
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Transform the translation unit in \p astPath, written by \c clang \c -emit-ast.
+///
+/// Nothing is parsed, the AST is deserialized and handed to the same consumer as a parsed one. The rewriter still reads
+/// the original source files, the AST file only refers to them.
+static int RunFromAst(const std::string& astPath, raw_ostream& output)
+{
+    auto diags           = CompilerInstance::createDiagnostics(new DiagnosticOptions);
+    auto pchContainerOps = std::make_shared<PCHContainerOperations>();
+
+    std::unique_ptr<ASTUnit> unit = ASTUnit::LoadFromASTFile(
+        astPath, pchContainerOps->getRawReader(), ASTUnit::LoadEverything, diags, FileSystemOptions{});
+
+    if(not unit) {
+        Error("cannot load '%s'\n", astPath);
+        return 1;
+    }
+
+    InsightsContext context{gInsightsOptions};
+    TransformUnit(*unit, context, output);
+
+    return GetExitCode(diags->hasErrorOccurred() ? 1 : 0, context);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Compare, for each of \p sourcePaths, the time of a parse with an action that does nothing to that of a
+/// C++ Insights run, see \c --measure-overhead.
+///
+/// Both use the same argument adjusters, the only difference is the action. A ratio close to 1 means the time goes into
+/// parsing, which only a PCH or a cache can avoid.
+static int RunOverheadBenchmark(const CompilationDatabase&      compilations,
+                                const std::vector<std::string>& sourcePaths,
+                                const bool                      useLibCpp)
+{
+    using namespace std::chrono;
+
+    auto measure = [&](const std::string& sourcePath, auto&& run) -> Optional<double> {
+        ClangTool tool(compilations, {sourcePath});
+        AddInsightsArgumentAdjusters(tool, useLibCpp);
+
+        IgnoringDiagConsumer diagConsumer{};
+        tool.setDiagnosticConsumer(&diagConsumer);
+
+        const auto start = steady_clock::now();
+
+        if(0 != run(tool)) {
+            return {};
+        }
+
+        return duration<double, std::milli>{steady_clock::now() - start}.count();
+    };
+
+    auto parse    = [](ClangTool& tool) { return tool.run(newFrontendActionFactory<SyntaxOnlyAction>().get()); };
+    auto insights = [](ClangTool& tool) { return RunTool(tool, llvm::nulls(), llvm::nulls()); };
+
+    // The first parse reads the headers into the page cache, without this the first file would look cheap.
+    measure(sourcePaths.front(), parse);
+
+    int    ret{};
+    double totalParse{};
+    double totalInsights{};
+
+    for(const auto& sourcePath : sourcePaths) {
+        const auto parseMs    = measure(sourcePath, parse);
+        const auto insightsMs = measure(sourcePath, insights);
+
+        if(not parseMs or not insightsMs) {
+            llvm::outs() << sourcePath << ": failed\n";
+            ret = 1;
+            continue;
+        }
+
+        totalParse += *parseMs;
+        totalInsights += *insightsMs;
+
+        llvm::outs() << llvm::format("%s: parse %.1f ms, insights %.1f ms, overhead %.2fx\n",
+                                     sourcePath.c_str(),
+                                     *parseMs,
+                                     *insightsMs,
+                                     *insightsMs / *parseMs);
+    }
+
+    if(0 != totalParse) {
+        llvm::outs() << llvm::format("total: parse %.1f ms, insights %.1f ms, overhead %.2fx\n",
+                                     totalParse,
+                                     totalInsights,
+                                     totalInsights / totalParse);
+    }
+
+    return ret;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Run the code generation for the file of the tools \p makeTool creates in \p jobs shards, see \ref
+/// SetCodegenShard.
+///
+/// \returns \c false, if the file requires a single thread, because of errors or overlapping edits. Nothing is written
+/// to \p output then.
+template<typename MakeTool>
+static bool RunCodegenShards(MakeTool&& makeTool, const unsigned jobs, raw_ostream& output)
+{
+    // Setting up a tool is not thread-safe, create all of them first.
+    std::vector<std::unique_ptr<ClangTool>> tools{};
+    for(unsigned i = 0; i < jobs; ++i) {
+        tools.push_back(makeTool());
+    }
+
+    std::vector<ShardResult> results(jobs);
+    std::vector<std::string> diagnostics(jobs);
+    std::atomic<bool>        failed{};
+
+    auto runShard = [&](const unsigned index) {
+        SetCodegenShard(index, jobs, &results[index]);
+
+        llvm::raw_string_ostream diagStream{diagnostics[index]};
+
+        if(0 != RunTool(*tools[index], llvm::nulls(), diagStream)) {
+            failed = true;
+        }
+
+        diagStream.flush();
+        SetCodegenShard(0, 1, nullptr);
+    };
+
+    std::vector<std::thread> threads{};
+    for(unsigned i = 1; i < jobs; ++i) {
+        threads.emplace_back(runShard, i);
+    }
+
+    // The main thread is a shard as well.
+    runShard(0);
+
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    if(failed or not WriteShards(results, output)) {
+        return false;
+    }
+
+    // All shards parse the same file, they all report the same diagnostics.
+    llvm::errs() << diagnostics.front();
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Get the compiler arguments for \p sourceFilePath without the program name and the file itself.
+static std::vector<std::string> GetCompilerArgs(const CompilationDatabase& compilations, StringRef sourceFilePath)
+{
+    const auto               commands = compilations.getCompileCommands(sourceFilePath);
+    std::vector<std::string> compilerArgs{};
+
+    if(commands.empty()) {
+        return compilerArgs;
+    }
+
+    for(const auto& arg : llvm::makeArrayRef(commands.front().CommandLine).drop_front()) {
+        if(arg != commands.front().Filename) {
+            compilerArgs.push_back(arg);
+        }
+    }
+
+    return compilerArgs;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The size of the declaration cache with \c --stdio-protocol, unless \c --decl-cache-size says otherwise.
+static constexpr uint64_t STDIO_PROTOCOL_DECL_CACHE_SIZE{64 * 1024 * 1024};
+//-----------------------------------------------------------------------------
+
+static uint64_t GetCacheSizeLimit()
+{
+    return gCacheSizeLimit * 1024 * 1024;
+}
+//-----------------------------------------------------------------------------
+
+STRONG_BOOL(UsePreamble);
+STRONG_BOOL(UsePch);
+//-----------------------------------------------------------------------------
+
+/// \brief Let \p tool include the PCH at \p pchPath.
+static void AddPchArgument(ClangTool& tool, const std::string& pchPath)
+{
+    tool.appendArgumentsAdjuster(
+        getInsertArgumentAdjuster(CommandLineArguments{"-include-pch", pchPath}, ArgumentInsertPosition::BEGIN));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Let the tool use a cached PCH for the include prefix or, with \p usePreamble, the entire preamble of \p
+/// source.
+///
+/// \returns the path of the PCH, empty if there is none.
+static std::string UsePrecompiledHeader(ClangTool&                 tool,
+                                        const CompilationDatabase& compilations,
+                                        StringRef                  sourceFilePath,
+                                        StringRef                  source,
+                                        const bool                 useLibCpp,
+                                        const UsePreamble          usePreamble)
+{
+    const auto compilerArgs = GetCompilerArgs(compilations, sourceFilePath);
+
+    auto addAdjusters = [&](ClangTool& pchTool) { AddInsightsArgumentAdjusters(pchTool, useLibCpp); };
+
+    const std::string pchPath{[&] {
+        if(UsePreamble::Yes == usePreamble) {
+            llvm::SmallString<256> sourceDir{sourceFilePath};
+            llvm::sys::fs::make_absolute(sourceDir);
+            llvm::sys::path::remove_filename(sourceDir);
+
+            return GetPrecompiledPreamble(gPchCacheDir, source, sourceDir, compilerArgs, useLibCpp, addAdjusters);
+        }
+
+        if(IsPchWarmingEnabled()) {
+            return GetWarmedPrecompiledHeader(source, compilerArgs, useLibCpp);
+        }
+
+        return GetPrecompiledHeader(gPchCacheDir, source, compilerArgs, useLibCpp, addAdjusters);
+    }()};
+
+    if(not pchPath.empty()) {
+        AddPchArgument(tool, pchPath);
+    }
+
+    return pchPath;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The deepest directory which contains all of \p paths.
+static std::string GetCommonDirectory(const std::vector<std::string>& paths)
+{
+    StringRef common{llvm::sys::path::parent_path(paths.front())};
+
+    auto contains = [&](StringRef path) {
+        return path.startswith(common) and ((path.size() == common.size()) or
+                                            llvm::sys::path::is_separator(common.back()) or
+                                            llvm::sys::path::is_separator(path[common.size()]));
+    };
+
+    for(const auto& path : paths) {
+        while(not common.empty() and not contains(path)) {
+            common = llvm::sys::path::parent_path(common);
+        }
+    }
+
+    return common.str();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Process \p sourcePaths with \p jobs threads, each file with its own \ref ClangTool.
+///
+/// The results are either written to \p outputDir or, in the order of \p sourcePaths, to stdout. Diagnostics are
+/// collected per file so that the output of different files does not interleave. With a \p sourceRoot the result of a
+/// file keeps its path relative to it below \p outputDir, otherwise only the file name is used. With \c
+/// --pch-cache-dir the files share a PCH for each distinct include prefix and set of arguments.
+static int RunParallel(const CompilationDatabase&      compilations,
+                       const std::vector<std::string>& sourcePaths,
+                       unsigned                        jobs,
+                       StringRef                       outputDir,
+                       StringRef                       sourceRoot,
+                       const bool                      useLibCpp)
+{
+    if(0 == jobs) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    jobs = std::min<unsigned>(jobs, sourcePaths.size());
+
+    if(not outputDir.empty()) {
+        if(const auto ec = llvm::sys::fs::create_directories(outputDir)) {
+            Error("cannot create '%s': %s\n", outputDir, ec.message());
+            return 1;
+        }
+    }
+
+    std::vector<std::string> results(sourcePaths.size());
+    std::atomic<size_t>      next{};
+    std::atomic<int>         ret{};
+    std::mutex               errsMutex{};
+
+    auto worker = [&] {
+        for(size_t i = next++; i < sourcePaths.size(); i = next++) {
+            const auto& sourcePath = sourcePaths[i];
+
+            ClangTool tool(compilations, {sourcePath}, std::make_shared<PCHContainerOperations>(), GetBaseFileSystem());
+            AddInsightsArgumentAdjusters(tool, useLibCpp);
+
+            std::string pchPath{};
+            if(not gPchCacheDir.empty()) {
+                if(auto source = llvm::MemoryBuffer::getFile(sourcePath)) {
+                    pchPath = UsePrecompiledHeader(
+                        tool, compilations, sourcePath, source.get()->getBuffer(), useLibCpp, UsePreamble::No);
+                }
+            }
+
+            std::string              diagnostics{};
+            llvm::raw_string_ostream diagStream{diagnostics};
+            llvm::raw_string_ostream output{results[i]};
+
+            int toolRet = RunTool(tool, output, diagStream);
+
+            // Clang may reject the PCH, the file is transformed again without it.
+            if((0 != toolRet) and not pchPath.empty()) {
+                DropPrecompiledHeader(pchPath);
+
+                output.flush();
+                diagStream.flush();
+                results[i].clear();
+                diagnostics.clear();
+
+                ClangTool retryTool(
+                    compilations, {sourcePath}, std::make_shared<PCHContainerOperations>(), GetBaseFileSystem());
+                AddInsightsArgumentAdjusters(retryTool, useLibCpp);
+
+                toolRet = RunTool(retryTool, output, diagStream);
+            }
+
+            if(0 != toolRet) {
+                ret = toolRet;
+            }
+
+            output.flush();
+            diagStream.flush();
+
+            if(not outputDir.empty()) {
+                llvm::SmallString<256> outputPath{outputDir};
+                StringRef              relativePath{sourcePath};
+
+                if(not sourceRoot.empty() and relativePath.consume_front(sourceRoot)) {
+                    llvm::sys::path::append(outputPath, relativePath);
+                    llvm::sys::fs::create_directories(llvm::sys::path::parent_path(outputPath));
+                } else {
+                    llvm::sys::path::append(outputPath, llvm::sys::path::filename(sourcePath));
+                }
+
+                if(IsContentStoreEnabled()) {
+                    outputPath += ".manifest";
+                }
+
+                std::error_code      ec{};
+                llvm::raw_fd_ostream file{outputPath, ec};
+
+                if(ec) {
+                    diagnostics += StrCat("cannot write '", outputPath.str(), "': ", ec.message(), "\n");
+                    ret = 1;
+                } else {
+                    file << results[i];
+                }
+
+                results[i].clear();
+            }
+
+            if(not diagnostics.empty()) {
+                std::lock_guard lock{errsMutex};
+                llvm::errs() << diagnostics;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads{};
+    for(unsigned i = 1; i < jobs; ++i) {
+        threads.emplace_back(worker);
+    }
+
+    // The main thread is a worker as well.
+    worker();
+
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    for(const auto& result : results) {
+        llvm::outs() << result;
+    }
+
+    return ret;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Transform \p source once for each of \p standards, each in a thread of its own, see \c --std-matrix.
+///
+/// All runs read the same buffer, the file is not read again. The results are printed as one JSON object to stdout,
+/// with the fields of a batch result for each standard.
+static int RunStdMatrix(const CompilationDatabase&      compilations,
+                        const std::string&              sourcePath,
+                        StringRef                       source,
+                        const std::vector<std::string>& standards,
+                        const bool                      useLibCpp)
+{
+    struct Result
+    {
+        ServerResponse response{};
+        double         timeMs{};
+        bool           cached{};
+    };
+
+    const auto          compilerArgs = GetCompilerArgs(compilations, sourcePath);
+    std::vector<Result> results(standards.size());
+
+    auto run = [&](const size_t i) {
+        const auto  start    = std::chrono::steady_clock::now();
+        const auto  stdArg   = StrCat("-std=", standards[i]);
+        auto&       result   = results[i];
+        std::string cacheKey{};
+
+        if(not gCacheDir.empty()) {
+            auto args = compilerArgs;
+            args.push_back(stdArg);
+            cacheKey = GetResultCacheKey(source, args, gInsightsOptions, useLibCpp);
+
+            if(auto cached = LookupCachedResult(gCacheDir, cacheKey)) {
+                result.response.output = std::move(*cached);
+                result.cached          = true;
+            }
+        }
+
+        if(not result.cached) {
+            ClangTool tool(compilations, {sourcePath});
+            tool.mapVirtualFile(sourcePath, source);
+            AddInsightsArgumentAdjusters(tool, useLibCpp);
+            // The last -std= wins, this one overrides that of the compilation database.
+            tool.appendArgumentsAdjuster(getInsertArgumentAdjuster(stdArg.c_str(), ArgumentInsertPosition::END));
+
+            llvm::raw_string_ostream output{result.response.output};
+            llvm::raw_string_ostream diagnostics{result.response.diagnostics};
+
+            result.response.returnCode = RunTool(tool, output, diagnostics);
+
+            output.flush();
+            diagnostics.flush();
+
+            if(not cacheKey.empty() and IsResultStorable(result.response.returnCode)) {
+                StoreCachedResult(gCacheDir, cacheKey, result.response.output, GetCacheSizeLimit());
+            }
+        }
+
+        result.timeMs = std::chrono::duration<double, std::milli>{std::chrono::steady_clock::now() - start}.count();
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads{};
+    for(size_t i = 1; i < standards.size(); ++i) {
+        threads.emplace_back(run, i);
+    }
+
+    // The main thread takes the first standard.
+    run(0);
+
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    llvm::json::Array resultsJson{};
+    int               ret{};
+
+    for(size_t i = 0; i < standards.size(); ++i) {
+        auto& result = results[i];
+
+        resultsJson.push_back(llvm::json::Object{{"std", standards[i]},
+                                                 {"returnCode", result.response.returnCode},
+                                                 {"code", std::move(result.response.output)},
+                                                 {"diagnostics", std::move(result.response.diagnostics)},
+                                                 {"timeMs", result.timeMs},
+                                                 {"cached", result.cached}});
+
+        if(result.response.returnCode) {
+            ret = 1;
+        }
+    }
+
+    const std::chrono::duration<double, std::milli> duration{std::chrono::steady_clock::now() - start};
+
+    llvm::outs() << llvm::json::Value{llvm::json::Object{
+                        {"file", sourcePath}, {"results", std::move(resultsJson)}, {"timeMs", duration.count()}}}
+                 << '\n';
+
+    return ret;
+}
+//-----------------------------------------------------------------------------
+
+static void PrintReports()
+{
+    if(not gTraceFile.empty()) {
+        WriteTrace(gTraceFile);
+    }
+
+    if(IsTimeReportEnabled()) {
+        PrintTimeReport(llvm::errs(), gTimeReportJson);
+    }
+
+    if(IsMemReportEnabled()) {
+        PrintMemReport(llvm::errs(), gMemReportJson);
+    }
+
+    if(IsAllocationSitesEnabled()) {
+        PrintAllocationSites(llvm::errs());
+    }
+
+    if(IsHeapProfileEnabled()) {
+        WriteHeapProfile(gHeapProfile);
+    }
+
+    if(IsBloatReportEnabled()) {
+        PrintBloatReport(llvm::errs());
+    }
+
+    if(IsIncludeReportEnabled()) {
+        PrintIncludeReport(llvm::errs());
+    }
+
+    if(IsUnusedIncludesEnabled()) {
+        PrintUnusedIncludes(llvm::errs());
+    }
+
+    if(IsFindingsEnabled()) {
+        WriteFindings(gFindingsFile);
+    }
+
+    if(IsInstantiationReportEnabled()) {
+        PrintInstantiationReport(llvm::errs());
+    }
+
+    if(IsExternTemplatesEnabled()) {
+        WriteExternTemplates();
+    }
+
+    if(IsLayoutAssertsEnabled()) {
+        WriteLayoutAsserts();
+    }
+
+    if(IsTypeSizesEnabled()) {
+        PrintTypeSizes(llvm::errs());
+    }
+
+    if(IsMatcherProfilingEnabled()) {
+        PrintMatcherProfile(llvm::errs());
+    }
+
+    if(IsNodeProfilingEnabled()) {
+        PrintNodeProfile(llvm::errs());
+    }
+
+    if(not gShowStats) {
+        return;
+    }
+
+    const auto& pchStats = GetPchCacheStats();
+
+    llvm::errs() << "pch cache: " << pchStats.hits << " hits, " << pchStats.misses << " misses, " << pchStats.failures
+                 << " failures, " << pchStats.mapped << " mapped (" << pchStats.mappedBytes << " bytes), "
+                 << pchStats.warmed << " warmed, " << pchStats.evicted << " evicted, " << pchStats.rejected
+                 << " rejected\n";
+
+    const auto& resultStats = GetResultCacheStats();
+
+    llvm::errs() << "result cache: " << resultStats.hits << " hits, " << resultStats.misses << " misses, "
+                 << resultStats.evictions << " evictions\n";
+
+    const auto remoteStats = GetRemoteCacheStats();
+
+    llvm::errs() << "remote cache: " << remoteStats.hits << " hits, " << remoteStats.misses << " misses, "
+                 << remoteStats.failures << " failures, " << remoteStats.uploads << " uploads\n";
+
+    const auto resultStoreStats = GetResultStoreStats();
+
+    llvm::errs() << "result store: " << resultStoreStats.hits << " hits, " << resultStoreStats.misses << " misses, "
+                 << resultStoreStats.coalesced << " coalesced, " << resultStoreStats.evictions << " evictions\n";
+
+    const auto typeNameStats = GetTypeNameCacheStats();
+
+    llvm::errs() << "type name cache: " << typeNameStats.hits << " hits, " << typeNameStats.misses << " misses\n";
+
+    const auto templateArgsStats = GetTemplateArgsCacheStats();
+
+    llvm::errs() << "template args cache: " << templateArgsStats.hits << " hits, " << templateArgsStats.misses
+                 << " misses\n";
+
+    const auto evaluationStats = GetEvaluationCacheStats();
+
+    llvm::errs() << "evaluation cache: " << evaluationStats.hits << " hits, " << evaluationStats.misses << " misses\n";
+
+    const auto declCacheStats = GetDeclCacheStats();
+
+    llvm::errs() << "decl cache: " << declCacheStats.hits << " hits, " << declCacheStats.misses << " misses, "
+                 << declCacheStats.evictions << " evictions\n";
+
+    llvm::errs() << "memory limit: " << GetDegradedTranslationUnits() << " degraded translation units\n";
+
+    const auto outputSinkStats = GetOutputSinkStats();
+
+    llvm::errs() << "output sink: " << outputSinkStats.chunks << " chunks, " << outputSinkStats.overlapping
+                 << " overlapping\n";
+
+    const auto contentStoreStats = GetContentStoreStats();
+
+    llvm::errs() << "content store: " << contentStoreStats.stored << " stored, " << contentStoreStats.reused
+                 << " reused, " << contentStoreStats.bytesStored << " bytes written, " << contentStoreStats.bytesReused
+                 << " bytes saved\n";
+
+    const auto vfsSnapshotStats = GetVfsSnapshotStats();
+
+    llvm::errs() << "vfs snapshot: " << vfsSnapshotStats.hits << " hits, " << vfsSnapshotStats.misses << " misses, "
+                 << vfsSnapshotStats.invalidated << " invalidated directories\n";
+
+    const auto duplicateStats = GetDuplicateStats();
+
+    llvm::errs() << "duplicates skipped: " << duplicateStats.matches << " matches\n";
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Apply a single C++ Insights option as it came in with a server request.
+///
+/// The option can be spelled as on the command line, with or without leading dashes, and with an optional \c =true
+/// or \c =false. \c alt-syntax-unroll takes its factor instead, like \c alt-syntax-unroll=4.
+///
+/// \returns \c false, if \p option is unknown.
+static bool ParseInsightsOption(StringRef option, InsightsOptions& options, bool& useLibCpp)
+{
+    option         = option.ltrim('-');
+    auto [name, v] = option.split('=');
+
+    if(name == "alt-syntax-unroll") {
+        return not v.getAsInteger(10, options.unrollFactor);
+    }
+
+    bool value{true};
+    if(v == "false") {
+        value = false;
+    } else if(not v.empty() && (v != "true")) {
+        return false;
+    }
+
+#define INSIGHTS_OPT(opt, member, deflt, description, category)                                                        \
+    if(name == opt) {                                                                                                  \
+        options.member = value;                                                                                        \
+        return true;                                                                                                   \
+    }
+
+#include "InsightsOptions.def"
+
+    if(name == "use-libc++") {
+        useLibCpp = value;
+        return true;
+    }
+
+    if(name == "verify-output") {
+        options.verifyOutput = value;
+        return true;
+    }
+
+    if(name == "skip-on-error") {
+        options.skipOnError = value;
+        return true;
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Read the lines \c Record::field,count of a \c --field-profile into \p counts.
+///
+/// Empty lines and lines starting with \c # are skipped, the counts of a field listed more than once add up.
+///
+/// \returns \c false, if a line is malformed. The error is in \p error then.
+static bool ParseFieldProfile(StringRef profile, std::map<std::string, uint64_t>& counts, std::string& error)
+{
+    llvm::SmallVector<StringRef, 64> lines{};
+    profile.split(lines, '\n');
+
+    for(size_t i = 0; i < lines.size(); ++i) {
+        const auto line = lines[i].trim();
+
+        if(line.empty() or line.startswith("#")) {
+            continue;
+        }
+
+        const auto [field, countText] = line.rsplit(',');
+        uint64_t count{};
+
+        if(field.trim().empty() or not field.contains("::") or countText.trim().getAsInteger(10, count)) {
+            error = StrCat("line ", i + 1, ": expected '<Record>::<field>,<count>'");
+            return false;
+        }
+
+        counts[field.trim().str()] += count;
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Apply each of \p optionSets of \c --option-matrix to a copy of \p options.
+///
+/// A set is a list of options separated by \c +, each spelled as for \ref ParseInsightsOption. The set \c default
+/// leaves \p options as they are.
+///
+/// \returns \c false, if an option is unknown or changes the parsing. The error is in \p error then.
+static bool ParseOptionSets(ArrayRef<std::string>         optionSets,
+                            const InsightsOptions&        options,
+                            std::vector<InsightsOptions>& result,
+                            std::string&                  error)
+{
+    for(const auto& optionSet : optionSets) {
+        auto& setOptions = result.emplace_back(options);
+
+        if(optionSet == "default") {
+            continue;
+        }
+
+        llvm::SmallVector<StringRef, 4> setParts{};
+        StringRef{optionSet}.split(setParts, '+', -1, false);
+
+        for(const auto& option : setParts) {
+            // The AST is shared by all sets, an option which changes the parsing cannot differ between them.
+            bool useLibCpp{};
+
+            if(not ParseInsightsOption(option, setOptions, useLibCpp) or useLibCpp) {
+                error = StrCat("unknown option in the option set '", optionSet, "': ", option, "\n");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Parse the single source of \p tool once and transform it for each of \p optionSets, see \c --option-matrix.
+///
+/// The options of \c InsightsOptions.def only change the code generation, so all sets share the AST. Each of them
+/// gets its own context and consumer, that are new handlers and a new rewriter. The results are written as one JSON
+/// object to \p output, with the code, the return code and the time of each set.
+static int RunOptionMatrix(ClangTool&                tool,
+                           ArrayRef<std::string>     optionSets,
+                           ArrayRef<InsightsOptions> setOptions,
+                           raw_ostream&              output,
+                           raw_ostream&              diagnostics)
+{
+    using namespace std::chrono;
+
+    TextDiagnosticPrinter diagPrinter{diagnostics, new DiagnosticOptions};
+    tool.setDiagnosticConsumer(&diagPrinter);
+
+    const auto start = steady_clock::now();
+
+    // Destroyed before the diagnostic printer, it is the client of its engine.
+    std::vector<std::unique_ptr<ASTUnit>> units{};
+
+    {
+        TimePhaseScope timePhase{TimePhase::Parsing};
+        tool.buildASTs(units);
+    }
+
+    if(units.empty() or not units.front()) {
+        return 1;
+    }
+
+    const duration<double, std::milli> parseDuration{steady_clock::now() - start};
+
+    auto&             unit = *units.front();
+    const bool        hasErrors{unit.getDiagnostics().hasErrorOccurred()};
+    llvm::json::Array resultsJson{};
+    int               ret{};
+
+    for(size_t i = 0; i < optionSets.size(); ++i) {
+        const auto setStart = steady_clock::now();
+
+        InsightsContext          context{setOptions[i]};
+        std::string              code{};
+        llvm::raw_string_ostream codeStream{code};
+
+        TransformUnit(unit, context, codeStream);
+        codeStream.flush();
+
+        const int returnCode{GetExitCode(hasErrors ? 1 : 0, context)};
+
+        if(returnCode) {
+            ret = returnCode;
+        }
+
+        resultsJson.push_back(
+            llvm::json::Object{{"options", optionSets[i]},
+                               {"returnCode", returnCode},
+                               {"code", std::move(code)},
+                               {"timeMs", duration<double, std::milli>{steady_clock::now() - setStart}.count()}});
+    }
+
+    const duration<double, std::milli> totalDuration{steady_clock::now() - start};
+
+    output << llvm::json::Value{llvm::json::Object{{"parseMs", parseDuration.count()},
+                                                   {"results", std::move(resultsJson)},
+                                                   {"timeMs", totalDuration.count()}}}
+           << '\n';
+
+    return ret;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief A request of \c --pipeline, parsed and waiting for its code generation.
+///
+/// The AST refers to the \ref FileManager of the thread which parsed it. That one only reads the buffers of the
+/// source manager which are loaded already, the job must be destroyed on the thread which parsed it though.
+class ParsedRequest final : public PipelineJob
+{
+public:
+    ParsedRequest(const InsightsOptions& options, std::string cacheKey)
+    : mOptions{options}
+    , mCacheKey{std::move(cacheKey)}
+    {
+    }
+
+    DiagnosticConsumer& GetDiagnosticConsumer() { return mDiagPrinter; }
+
+    /// \returns \c false, if there is no AST. The response then has the diagnostics of the failed parse.
+    bool SetUnit(std::vector<std::unique_ptr<ASTUnit>>& units, ServerResponse& response)
+    {
+        if(units.empty() or not units.front()) {
+            mDiagnostics.flush();
+            response.returnCode  = 1;
+            response.diagnostics = std::move(mResponse.diagnostics);
+
+            return false;
+        }
+
+        mUnit = std::move(units.front());
+
+        return true;
+    }
+
+    ServerResponse Finish() override
+    {
+        return MeasureRequest([&] {
+            InsightsContext          context{mOptions};
+            llvm::raw_string_ostream output{mResponse.output};
+
+            TransformUnit(*mUnit, context, output);
+
+            output.flush();
+            mDiagnostics.flush();
+
+            mResponse.returnCode = GetExitCode(mUnit->getDiagnostics().hasErrorOccurred() ? 1 : 0, context);
+
+            if(not mCacheKey.empty() and IsResultStorable(mResponse.returnCode)) {
+                StoreCachedResult(gCacheDir, mCacheKey, mResponse.output, GetCacheSizeLimit());
+            }
+
+            return std::move(mResponse);
+        });
+    }
+
+private:
+    const InsightsOptions    mOptions;
+    const std::string        mCacheKey;
+    ServerResponse           mResponse{};
+    llvm::raw_string_ostream mDiagnostics{mResponse.diagnostics};
+    TextDiagnosticPrinter    mDiagPrinter{mDiagnostics, new DiagnosticOptions};
+    std::unique_ptr<ASTUnit> mUnit{};  //!< Destroyed before the diagnostic printer, it is the client of its engine.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The state which is kept alive between the requests of a server.
+///
+/// All requests share a single \ref FileManager on top of an overlay file system. The overlay consists of the real
+/// file system and an in-memory file system which holds the sources sent by the clients. Keeping the file manager
+/// around saves the stat calls and header lookups for all the headers a typical request includes. As the in-memory
+/// file system only grows, the state is recreated after \ref MAX_REQUESTS. The batch mode uses the same state. A state
+/// must not be shared between threads, the options of a request go into its own \ref InsightsContext.
+class InsightsServerState
+{
+public:
+    InsightsServerState() { Reset(); }
+
+    ServerResponse Run(const ServerRequest& request);
+
+    /// \brief Same as \ref Run, the options are already separated from the compiler arguments, see \ref
+    /// TransformSource.
+    ServerResponse Run(const ServerRequest&            request,
+                       const InsightsOptions&          options,
+                       const bool                      useLibCpp,
+                       const std::vector<std::string>& compilerArgs);
+
+    /// \brief Parse \p request, the code generation can run in another thread, see \c --pipeline.
+    ///
+    /// \returns \c nullptr, if \p response is the final one already.
+    std::unique_ptr<PipelineJob> Parse(const ServerRequest& request, ServerResponse& response);
+
+private:
+    /// \brief Split the arguments of \p request into the C++ Insights options and the compiler arguments.
+    ///
+    /// The option sets of an \c option-matrix argument go into \p optionMatrix.
+    ///
+    /// \returns \c false, if an option is unknown. The error is in \p response then.
+    static bool ParseArguments(const ServerRequest&      request,
+                               InsightsOptions&          options,
+                               bool&                     useLibCpp,
+                               std::vector<std::string>& compilerArgs,
+                               std::vector<std::string>& optionMatrix,
+                               ServerResponse&           response);
+
+    /// \brief Add the source of \p request to the in-memory file system and create a tool for it.
+    ///
+    /// With \p usePch the tool includes the PCH of the include prefix, if there is one. Its path goes to \p pchPath.
+    std::unique_ptr<ClangTool> CreateTool(const ServerRequest&       request,
+                                          const CompilationDatabase& compilations,
+                                          const bool                 useLibCpp,
+                                          const UsePch               usePch  = UsePch::Yes,
+                                          std::string*               pchPath = nullptr);
+
+    ServerResponse Transform(const ServerRequest&            request,
+                             const std::vector<std::string>& compilerArgs,
+                             const InsightsOptions&          options,
+                             const bool                      useLibCpp,
+                             const std::string&              cacheKey);
+
+    /// \brief Parse \p request once and transform it for each of \p optionMatrix, see \ref RunOptionMatrix.
+    ///
+    /// The results bypass the result cache and the result store, they are keyed by a single set of options.
+    ServerResponse TransformOptionMatrix(const ServerRequest&            request,
+                                         const std::vector<std::string>& compilerArgs,
+                                         const InsightsOptions&          options,
+                                         const bool                      useLibCpp,
+                                         const std::vector<std::string>& optionMatrix);
+
+    static constexpr unsigned MAX_REQUESTS{256};
+
+    llvm::IntrusiveRefCntPtr<llvm::vfs::InMemoryFileSystem> mMemoryFS{};
+    llvm::IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem>  mOverlayFS{};
+    llvm::IntrusiveRefCntPtr<FileManager>                   mFiles{};
+    unsigned                                                mRequests{};
+
+    void Reset()
+    {
+        mMemoryFS  = new llvm::vfs::InMemoryFileSystem;
+        mOverlayFS = new llvm::vfs::OverlayFileSystem(llvm::vfs::getRealFileSystem());
+        mOverlayFS->pushOverlay(mMemoryFS);
+        mFiles    = new FileManager(FileSystemOptions{}, mOverlayFS);
+        mRequests = 0;
+    }
+};
+//-----------------------------------------------------------------------------
+
+ServerResponse InsightsServerState::Run(const ServerRequest& request)
+{
+    ServerResponse response{};
+
+    // The counters of the result store, the request transforms nothing.
+    if((1 == request.arguments.size()) and (request.arguments.front() == "--result-store-stats")) {
+        llvm::raw_string_ostream output{response.output};
+        output << llvm::json::Value{GetResultStoreJSON()} << '\n';
+        output.flush();
+
+        return response;
+    }
+
+    InsightsOptions          options{gInsightsOptions};
+    bool                     useLibCpp{gUseLibCpp};
+    std::vector<std::string> compilerArgs{};
+    std::vector<std::string> optionMatrix{};
+
+    if(not ParseArguments(request, options, useLibCpp, compilerArgs, optionMatrix, response)) {
+        return response;
+    }
+
+    if(not optionMatrix.empty()) {
+        return TransformOptionMatrix(request, compilerArgs, options, useLibCpp, optionMatrix);
+    }
+
+    return Run(request, options, useLibCpp, compilerArgs);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The main file of \p request, either its own \c source or the memory \c sourceView refers to.
+static StringRef GetRequestSource(const ServerRequest& request)
+{
+    if(request.sourceView.data()) {
+        return {request.sourceView.data(), request.sourceView.size()};
+    }
+
+    return request.source;
+}
+//-----------------------------------------------------------------------------
+
+ServerResponse InsightsServerState::Run(const ServerRequest&            request,
+                                        const InsightsOptions&          options,
+                                        const bool                      useLibCpp,
+                                        const std::vector<std::string>& compilerArgs)
+{
+    std::string cacheKey{};
+    if(not gCacheDir.empty() or IsResultStoreEnabled()) {
+        cacheKey = GetResultCacheKey(GetRequestSource(request), compilerArgs, options, useLibCpp);
+    }
+
+    if(IsResultStoreEnabled()) {
+        return GetOrComputeResult(cacheKey,
+                                  [&] { return Transform(request, compilerArgs, options, useLibCpp, cacheKey); });
+    }
+
+    return Transform(request, compilerArgs, options, useLibCpp, cacheKey);
+}
+//-----------------------------------------------------------------------------
+
+std::unique_ptr<PipelineJob> InsightsServerState::Parse(const ServerRequest& request, ServerResponse& response)
+{
+    InsightsOptions          options{gInsightsOptions};
+    bool                     useLibCpp{gUseLibCpp};
+    std::vector<std::string> compilerArgs{};
+    std::vector<std::string> optionMatrix{};
+
+    if(not ParseArguments(request, options, useLibCpp, compilerArgs, optionMatrix, response)) {
+        return nullptr;
+    }
+
+    // The code generation gets only the AST, not the invocation the result is parsed again with.
+    if(options.verifyOutput) {
+        response.diagnostics += "verify-output cannot be used together with --pipeline\n";
+        response.returnCode = 1;
+        return nullptr;
+    }
+
+    if(not optionMatrix.empty()) {
+        response.diagnostics += "option-matrix cannot be used together with --pipeline\n";
+        response.returnCode = 1;
+        return nullptr;
+    }
+
+    std::string cacheKey{};
+    if(not gCacheDir.empty()) {
+        cacheKey = GetResultCacheKey(GetRequestSource(request), compilerArgs, options, useLibCpp);
+
+        if(auto cached = LookupCachedResult(gCacheDir, cacheKey)) {
+            response.output = std::move(*cached);
+            return nullptr;
+        }
+    }
+
+    auto job = std::make_unique<ParsedRequest>(options, std::move(cacheKey));
+
+    FixedCompilationDatabase compilations{".", compilerArgs};
+    const auto               tool = CreateTool(request, compilations, useLibCpp);
+    tool->setDiagnosticConsumer(&job->GetDiagnosticConsumer());
+
+    std::vector<std::unique_ptr<ASTUnit>> units{};
+
+    {
+        TimePhaseScope timePhase{TimePhase::Parsing};
+        tool->buildASTs(units);
+    }
+
+    if(not job->SetUnit(units, response)) {
+        return nullptr;
+    }
+
+    return job;
+}
+//-----------------------------------------------------------------------------
+
+bool InsightsServerState::ParseArguments(const ServerRequest&      request,
+                                         InsightsOptions&          options,
+                                         bool&                     useLibCpp,
+                                         std::vector<std::string>& compilerArgs,
+                                         std::vector<std::string>& optionMatrix,
+                                         ServerResponse&           response)
+{
+    bool isCompilerArg{};
+
+    for(const auto& arg : request.arguments) {
+        if(isCompilerArg) {
+            compilerArgs.push_back(arg);
+
+        } else if(arg == "--") {
+            isCompilerArg = true;
+
+        } else if(StringRef matrix{StringRef{arg}.ltrim('-')}; matrix.consume_front("option-matrix=")) {
+            llvm::SmallVector<StringRef, 4> optionSets{};
+            matrix.split(optionSets, ',', -1, false);
+
+            for(const auto& optionSet : optionSets) {
+                optionMatrix.push_back(optionSet.str());
+            }
+
+        } else if(not ParseInsightsOption(arg, options, useLibCpp)) {
+            response.diagnostics += StrCat("unknown option: ", arg, "\n");
+            response.returnCode = 1;
+            return false;
+        }
+    }
+
+#ifdef __APPLE__
+    useLibCpp = true;
+#endif /* __APPLE__ */
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+std::unique_ptr<ClangTool> InsightsServerState::CreateTool(const ServerRequest&       request,
+                                                           const CompilationDatabase& compilations,
+                                                           const bool                 useLibCpp,
+                                                           const UsePch               usePch,
+                                                           std::string*               pchPath)
+{
+    if(MAX_REQUESTS <= mRequests) {
+        Reset();
+    }
+
+    ++mRequests;
+
+    // Each request gets its own directory. A file with the same name from a previous request must not be visible.
+    const StringRef fileName{request.fileName.empty() ? StringRef{"input.cpp"}
+                                                      : llvm::sys::path::filename(request.fileName)};
+    const std::string path{StrCat("/insights-server/", mRequests, "/", fileName)};
+    // A source outside of the request stays in memory as long as the state, the file system can refer to it.
+    if(request.sourceView.data()) {
+        mMemoryFS->addFile(path, 0, llvm::MemoryBuffer::getMemBuffer(GetRequestSource(request), path));
+    } else {
+        mMemoryFS->addFile(path, 0, llvm::MemoryBuffer::getMemBufferCopy(request.source, path));
+    }
+
+#if IS_CLANG_NEWER_THAN(9)
+    auto tool = std::make_unique<ClangTool>(
+        compilations, std::vector<std::string>{path}, std::make_shared<PCHContainerOperations>(), mOverlayFS, mFiles);
+#else
+    // Older versions create their own FileManager, at least the file system is shared.
+    auto tool = std::make_unique<ClangTool>(
+        compilations, std::vector<std::string>{path}, std::make_shared<PCHContainerOperations>(), mOverlayFS);
+#endif
+
+    AddInsightsArgumentAdjusters(*tool, useLibCpp);
+
+    // Most requests, and every refresh of a document of --stdio-protocol, start with the same includes.
+    if((UsePch::Yes == usePch) and not gPchCacheDir.empty()) {
+        auto usedPch =
+            UsePrecompiledHeader(*tool, compilations, path, GetRequestSource(request), useLibCpp, UsePreamble::No);
+
+        if(pchPath) {
+            *pchPath = std::move(usedPch);
+        }
+    }
+
+    return tool;
+}
+//-----------------------------------------------------------------------------
+
+ServerResponse InsightsServerState::Transform(const ServerRequest&            request,
+                                              const std::vector<std::string>& compilerArgs,
+                                              const InsightsOptions&          options,
+                                              const bool                      useLibCpp,
+                                              const std::string&              cacheKey)
+{
+    ServerResponse response{};
+
+    if(not gCacheDir.empty()) {
+        if(auto cached = LookupCachedResult(gCacheDir, cacheKey)) {
+            response.output = std::move(*cached);
+            return response;
+        }
+    }
+
+    llvm::raw_string_ostream diagnostics{response.diagnostics};
+
+    FixedCompilationDatabase compilations{".", compilerArgs};
+    std::string              pchPath{};
+    auto                     tool = CreateTool(request, compilations, useLibCpp, UsePch::Yes, &pchPath);
+
+    llvm::raw_string_ostream output{response.output};
+    response.returnCode =
+        RunTool(*tool, output, diagnostics, options, request.withSegments ? &response.segments : nullptr);
+
+    output.flush();
+    diagnostics.flush();
+
+    // Clang may reject the PCH, the request is transformed again without it.
+    if((0 != response.returnCode) and not pchPath.empty()) {
+        DropPrecompiledHeader(pchPath);
+
+        response.output.clear();
+        response.diagnostics.clear();
+        response.segments.clear();
+
+        tool = CreateTool(request, compilations, useLibCpp, UsePch::No);
+        response.returnCode =
+            RunTool(*tool, output, diagnostics, options, request.withSegments ? &response.segments : nullptr);
+
+        output.flush();
+        diagnostics.flush();
+    }
+
+    if(not gCacheDir.empty() and IsResultStorable(response.returnCode)) {
+        StoreCachedResult(gCacheDir, cacheKey, response.output, GetCacheSizeLimit());
+    }
+
+    return response;
+}
+//-----------------------------------------------------------------------------
+
+ServerResponse InsightsServerState::TransformOptionMatrix(const ServerRequest&            request,
+                                                          const std::vector<std::string>& compilerArgs,
+                                                          const InsightsOptions&          options,
+                                                          const bool                      useLibCpp,
+                                                          const std::vector<std::string>& optionMatrix)
+{
+    ServerResponse               response{};
+    std::vector<InsightsOptions> setOptions{};
+
+    if(not ParseOptionSets(optionMatrix, options, setOptions, response.diagnostics)) {
+        response.returnCode = 1;
+        return response;
+    }
+
+    FixedCompilationDatabase compilations{".", compilerArgs};
+    const auto               tool = CreateTool(request, compilations, useLibCpp);
+
+    llvm::raw_string_ostream output{response.output};
+    llvm::raw_string_ostream diagnostics{response.diagnostics};
+
+    response.returnCode = RunOptionMatrix(*tool, optionMatrix, setOptions, output, diagnostics);
+
+    output.flush();
+    diagnostics.flush();
+
+    return response;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The upper limit of the include prefixes \ref EstimateRequestCost remembers.
+static constexpr size_t MAX_ESTIMATED_PREFIXES{1024};
+//-----------------------------------------------------------------------------
+
+/// \brief The estimated cost of \p request for \c --scheduler, see \ref EstimateSourceCost.
+///
+/// The tokens the headers bring in come from running the preprocessor over the include prefix, once for each distinct
+/// prefix and set of arguments. Most requests share a few prefixes, like the PCHs of \c --pch-cache-dir.
+static uint64_t EstimateRequestCost(const ServerRequest& request)
+{
+    static std::mutex                prefixMutex{};
+    static llvm::StringMap<uint64_t> prefixTokens{};
+
+    const auto includes = GetIncludePrefix(request.source);
+
+    if(includes.empty()) {
+        return EstimateSourceCost(request.source, 0, 0);
+    }
+
+    const auto&                    args      = request.arguments;
+    const auto                     separator = std::find(args.begin(), args.end(), "--");
+    const std::vector<std::string> compilerArgs{(args.end() == separator) ? separator : std::next(separator),
+                                                args.end()};
+
+    std::string prefix{};
+    for(const auto& include : includes) {
+        prefix.append(StrCat("#include ", include, "\n"));
+    }
+
+    std::string key{prefix};
+    for(const auto& arg : compilerArgs) {
+        key.append(StrCat(arg, "\n"));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{prefixMutex};
+
+        if(const auto it = prefixTokens.find(key); prefixTokens.end() != it) {
+            return EstimateSourceCost(request.source, includes.size(), it->second);
+        }
+    }
+
+    FixedCompilationDatabase compilations{".", compilerArgs};
+    const std::string        path{"/insights-estimate/prefix.cpp"};
+    ClangTool                tool{compilations, {path}};
+    tool.mapVirtualFile(path, prefix);
+    AddInsightsArgumentAdjusters(tool, gUseLibCpp);
+
+    IgnoringDiagConsumer ignore{};
+    tool.setDiagnosticConsumer(&ignore);
+
+    const uint64_t tokens{CountPreprocessedTokens(tool)};
+
+    {
+        std::lock_guard<std::mutex> lock{prefixMutex};
+
+        if(MAX_ESTIMATED_PREFIXES <= prefixTokens.size()) {
+            prefixTokens.clear();
+        }
+
+        prefixTokens[key] = tokens;
+    }
+
+    return EstimateSourceCost(request.source, includes.size(), tokens);
+}
+//-----------------------------------------------------------------------------
+
+InsightsOptions GetDefaultInsightsOptions()
+{
+    return gInsightsOptions;
+}
+//-----------------------------------------------------------------------------
+
+TransformResult TransformSource(StringRef                       fileName,
+                                StringRef                       source,
+                                const std::vector<std::string>& compilerArgs,
+                                const InsightsOptions&          options)
+{
+    // A state must not be shared between threads, each thread of the caller gets its own.
+    static thread_local InsightsServerState state{};
+
+    const auto start = std::chrono::steady_clock::now();
+
+    bool useLibCpp{gUseLibCpp};
+#ifdef __APPLE__
+    useLibCpp = true;
+#endif /* __APPLE__ */
+
+    ServerRequest request{fileName.str(), {}, source.str()};
+    auto          response = state.Run(request, options, useLibCpp, compilerArgs);
+
+    TransformResult result{response.returnCode, std::move(response.output), std::move(response.diagnostics)};
+    result.stats.timeMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    result.stats.outputBytes = result.code.size();
+
+    return result;
+}
+//-----------------------------------------------------------------------------
+
+std::vector<TransformResult> TransformSources(const std::vector<TransformInput>& inputs,
+                                              const std::vector<std::string>&    compilerArgs,
+                                              const InsightsOptions&             options,
+                                              unsigned                           jobs)
+{
+    if(0 == jobs) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    jobs = std::min<unsigned>(jobs, inputs.size());
+
+    std::vector<TransformResult> results(inputs.size());
+    std::atomic<size_t>          next{};
+
+    auto worker = [&] {
+        for(size_t i = next++; i < inputs.size(); i = next++) {
+            results[i] = TransformSource(inputs[i].fileName, inputs[i].source, compilerArgs, options);
+        }
+    };
+
+    std::vector<std::thread> threads{};
+    for(unsigned i = 1; i < jobs; ++i) {
+        threads.emplace_back(worker);
+    }
+
+    // The calling thread is a worker as well.
+    worker();
+
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    return results;
+}
+//-----------------------------------------------------------------------------
+
+bool SetInsightsOption(StringRef option, InsightsOptions& options)
+{
+    // The standard library is a property of the process, see --use-libc++.
+    bool useLibCpp{gUseLibCpp};
+
+    return ParseInsightsOption(option, options, useLibCpp) and (useLibCpp == gUseLibCpp);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Turn a single batch record into a \ref ServerRequest.
+///
+/// \returns An error message, if \p record is malformed.
+static std::string ParseBatchRecord(const llvm::json::Object& record, ServerRequest& request)
+{
+    const auto code = record.getString("code");
+
+    if(not code) {
+        return "missing \"code\"";
+    }
+
+    request.fileName = "input.cpp";
+    request.source   = code->str();
+
+    if(const auto* options = record.getArray("options")) {
+        for(const auto& option : *options) {
+            const auto opt = option.getAsString();
+
+            if(not opt) {
+                return "\"options\" must be an array of strings";
+            }
+
+            request.arguments.push_back(opt->str());
+        }
+    }
+
+    request.arguments.push_back("--");
+
+    if(const auto standard = record.getString("std")) {
+        request.arguments.push_back(standard->startswith("-std=") ? standard->str() : StrCat("-std=", *standard));
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Process newline-delimited JSON records from stdin, one JSON result per record is written to stdout.
+///
+/// All records share the warm state of a \ref InsightsServerState.
+static int RunBatch()
+{
+    InsightsServerState state{};
+    std::string         line{};
+    int                 ret{};
+
+    while(std::getline(std::cin, line)) {
+        if(StringRef{line}.trim().empty()) {
+            continue;
+        }
+
+        llvm::json::Object result{};
+        ServerResponse     response{};
+
+        ResetTimeReport();
+        ResetMemReport();
+        const auto         start = std::chrono::steady_clock::now();
+
+        if(auto record = llvm::json::parse(line)) {
+            const auto* object = record->getAsObject();
+            ServerRequest request{};
+            std::string   error{object ? ParseBatchRecord(*object, request) : "record is not an object"};
+
+            if(object) {
+                if(const auto* id = object->get("id")) {
+                    result["id"] = *id;
+                }
+            }
+
+            if(error.empty()) {
+                response = state.Run(request);
+            } else {
+                response.returnCode  = 1;
+                response.diagnostics = std::move(error);
+            }
+
+        } else {
+            response.returnCode  = 1;
+            response.diagnostics = llvm::toString(record.takeError());
+        }
+
+        const std::chrono::duration<double, std::milli> duration{std::chrono::steady_clock::now() - start};
+
+        if(not result.get("id")) {
+            result["id"] = nullptr;
+        }
+
+        result["returnCode"]  = response.returnCode;
+        result["code"]        = std::move(response.output);
+        result["diagnostics"] = std::move(response.diagnostics);
+        result["timeMs"]      = duration.count();
+
+        if(IsTimeReportEnabled()) {
+            result["timeReport"] = GetTimeReportJSON();
+            ResetTimeReport();
+        }
+
+        if(IsMemReportEnabled()) {
+            result["memReport"] = GetMemReportJSON();
+            ResetMemReport();
+        }
+
+        llvm::outs() << llvm::json::Value{std::move(result)} << '\n';
+        llvm::outs().flush();
+
+        if(response.returnCode) {
+            ret = 1;
+        }
+    }
+
+    return ret;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Transform the entries of the archive \p archiveFile with \p jobs threads, the results go to \p resultFile,
+/// see \ref BatchArchive.
+///
+/// The sources are not copied, the in-memory file system of each thread refers to the mapped archive. The archive
+/// stays mapped until all states are gone. The results are written as they finish, only their index stays in memory.
+static int RunBatchArchive(StringRef archiveFile, StringRef resultFile, unsigned jobs)
+{
+    std::string error{};
+    const auto  archive = BatchArchive::Open(archiveFile, error);
+
+    if(not archive) {
+        Error("%s\n", error);
+        return 1;
+    }
+
+    const auto results = BatchResultArchive::Create(resultFile, archive->size(), error);
+
+    if(not results) {
+        Error("%s\n", error);
+        return 1;
+    }
+
+    if(0 == jobs) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    jobs = static_cast<unsigned>(std::min<uint64_t>(jobs, std::max<uint64_t>(1, archive->size())));
+
+    std::atomic<uint64_t> next{};
+    std::atomic<bool>     failed{};
+    std::atomic<bool>     writeFailed{};
+
+    auto worker = [&] {
+        // A state must not be shared between threads.
+        InsightsServerState state{};
+
+        for(uint64_t i = next++; (i < archive->size()) and not writeFailed; i = next++) {
+            ServerRequest  request{"input.cpp", {}, {}};
+            ServerResponse response{};
+
+            if(auto entryError = archive->GetEntry(i, request.sourceView, request.arguments); entryError.empty()) {
+                response = state.Run(request);
+
+            } else {
+                response.returnCode  = 1;
+                response.diagnostics = std::move(entryError);
+            }
+
+            if(response.returnCode) {
+                failed = true;
+            }
+
+            if(not results->Write(i, response.returnCode, response.output, response.diagnostics)) {
+                writeFailed = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads{};
+    for(unsigned i = 1; i < jobs; ++i) {
+        threads.emplace_back(worker);
+    }
+
+    // The calling thread is a worker as well.
+    worker();
+
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    if(not results->Close() or writeFailed) {
+        return 1;
+    }
+
+    return failed ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+#include "clang/Basic/Version.h"
+
+static void PrintVersion(raw_ostream& ostream)
+{
+    ostream << "cpp-insights " << INSIGHTS_VERSION << " https://cppinsights.io (" << GIT_REPO_URL << " "
+            << GIT_COMMIT_HASH << ")"
+            << "\n";
+
+#ifdef INSIGHTS_DEBUG
+    ostream << "  Build with debug enabled\n";
+#endif
+    ostream << "  LLVM  Revision: " << clang::getLLVMRevision() << '\n';
+    ostream << "  Clang Revision: " << clang::getClangFullCPPVersion() << '\n';
+}
+//-----------------------------------------------------------------------------
+
+// The benchmarks, see benchmarks/InsightsBench.cpp, bring their own main.
+#ifndef INSIGHTS_NO_MAIN
+int main(int argc, const char** argv)
+{
+    // Until here the binary was loaded and the static objects, most of them llvm::cl options, were initialized.
+    const auto cpuBeforeMain    = GetProcessCpuTime();
+    const auto commandLineStart = std::chrono::steady_clock::now();
+
+    llvm::sys::PrintStackTraceOnErrorSignal(argv[0]);
+    llvm::cl::HideUnrelatedOptions(gInsightCategory);
+    llvm::cl::SetVersionPrinter(&PrintVersion);
+
+    CommonOptionsParser op(argc, argv, gInsightCategory, llvm::cl::ZeroOrMore);
+
+    if(gTimeReport or gTimeReportJson) {
+        EnableTimeReport();
+        RecordStartup(cpuBeforeMain,
+                      std::chrono::steady_clock::now() - commandLineStart,
+                      llvm::cl::getRegisteredOptions().size());
+    }
+
+    if(gMemReport or gMemReportJson) {
+        EnableMemReport();
+    }
+
+    if(gAllocSites) {
+        EnableAllocationSites();
+    }
+
+    if(not gHeapProfile.empty() and not EnableHeapProfile(gHeapProfileRate)) {
+        Error("--heap-profile is not supported on this platform\n");
+        return 1;
+    }
+
+    if(gBloatReport) {
+        EnableBloatReport();
+    }
+
+    if(gIncludeReport) {
+        EnableIncludeReport();
+    }
+
+    if(gUnusedIncludes) {
+        EnableUnusedIncludes();
+    }
+
+    if(gProfileNodes) {
+        EnableNodeProfiling();
+    }
+
+    if(FindingsFormat::None != gFindings) {
+        // A cached result is not generated again, its findings would be missing.
+        if(not gCacheDir.empty()) {
+            Error("--findings cannot be used together with --cache-dir\n");
+            return 1;
+        }
+
+        EnableFindings(gFindings);
+    }
+
+    EnableTypeSizes(gTypeSizes);
+
+    if(gProfileMatchers) {
+        // The dispatcher does not use the matchers, there is nothing to profile.
+        if(gVisitorDispatch) {
+            Error("--profile-matchers cannot be used together with --visitor-dispatch\n");
+            return 1;
+        }
+
+        EnableMatcherProfiling();
+    }
+
+    if(not gTraceFile.empty()) {
+        // The trace profiler of LLVM records the events of a single thread only.
+        if(1 != gJobs) {
+            Error("--trace cannot be used together with -j\n");
+            return 1;
+        }
+
+        if(1 != gCodegenJobs) {
+            Error("--trace cannot be used together with --codegen-jobs\n");
+            return 1;
+        }
+
+        StartTrace(gTraceGranularity);
+    }
+
+    if(gInsightsOptions.ShowInstantiationCost or (0 != gInstantiationReport)) {
+        // The costs come from the same profiler as the events of --trace.
+        if(1 != gJobs) {
+            Error("--show-instantiation-cost and --instantiation-report cannot be used together with -j\n");
+            return 1;
+        }
+
+        if(1 != gCodegenJobs) {
+            Error("--show-instantiation-cost and --instantiation-report cannot be used together with --codegen-jobs\n");
+            return 1;
+        }
+
+        EnableInstantiationReport(gInstantiationReport);
+        StartInstantiationCost();
+    }
+
+    if(not gEmitExternTemplates.empty()) {
+        // Only with all declarations the instantiations of the templates from the headers are seen.
+        if(not gTraverseAllDecls) {
+            Error("--emit-extern-templates requires --traverse-all-decls\n");
+            return 1;
+        }
+
+        if(0 == gExternTemplatesCount) {
+            Error("--extern-templates-count must be greater than 0\n");
+            return 1;
+        }
+
+        if(ExternTemplatesRank::Time == gExternTemplatesBy) {
+            // The costs come from the same profiler as the ones of --show-instantiation-cost.
+            if((1 != gJobs) or (1 != gCodegenJobs)) {
+                Error("--extern-templates-by=time cannot be used together with -j or --codegen-jobs\n");
+                return 1;
+            }
+        }
+
+        EnableExternTemplates(gEmitExternTemplates, gExternTemplatesCount, gExternTemplatesBy);
+    }
+
+    if(not gEmitLayoutAsserts.empty()) {
+        EnableLayoutAsserts(gEmitLayoutAsserts, {gHotRecords.begin(), gHotRecords.end()});
+    }
+
+    if(not gVfsSnapshot.empty()) {
+        LoadVfsSnapshot(gVfsSnapshot);
+    }
+
+    if(0 != gMaxMemoryMb) {
+        SetMemoryLimit(gMaxMemoryMb * 1024 * 1024);
+    }
+
+    if(0 != gDeclCacheSize) {
+        EnableDeclCache(gDeclCacheSize * 1024 * 1024);
+
+    } else if(gStdioProtocol and not gDeclCacheSize.getNumOccurrences()) {
+        // Between two refreshes of a document usually only a single declaration changes.
+        EnableDeclCache(STDIO_PROTOCOL_DECL_CACHE_SIZE);
+    }
+
+    if(OutputFormat::EditsJson == gOutputFormat) {
+        // The shards are merged as a whole file and batch results are a file per record.
+        if((1 != gCodegenJobs) or gBatchMode) {
+            Error("--output=edits-json cannot be used together with --codegen-jobs or --batch\n");
+            return 1;
+        }
+
+        gInsightsOptions.outputEdits = true;
+    }
+
+    if(gStream) {
+        // Edits and shards are only complete at the end and the cache stores a result only when the run succeeds.
+        if((OutputFormat::EditsJson == gOutputFormat) or (1 != gCodegenJobs) or not gCacheDir.empty()) {
+            Error("--stream cannot be used together with --output=edits-json, --codegen-jobs or --cache-dir\n");
+            return 1;
+        }
+
+        gInsightsOptions.streamOutput = true;
+    }
+
+    if(gInsightsOptions.ShowAllocations or gInsightsOptions.ShowGlobalInit or gInsightsOptions.ShowNoexceptMove) {
+        // The tables go to the end of the file once all functions are seen. A shard sees only a part of them and the
+        // streamed output is written before.
+        if((1 != gCodegenJobs) or gStream) {
+            Error("--show-allocations, --show-global-init and --show-noexcept-move cannot be used together with "
+                  "--codegen-jobs or --stream\n");
+            return 1;
+        }
+    }
+
+    if(not gFormat.empty()) {
+        // The formatter needs the entire result, the positions of the edits and the source map no longer fit to it.
+        if((1 != gCodegenJobs) or gStream or gDedupStore or not gSourceMap.empty() or not gSemanticTokens.empty() or
+           (OutputFormat::EditsJson == gOutputFormat)) {
+            Error("--format cannot be used together with --codegen-jobs, --stream, --dedup-store, --source-map, "
+                  "--semantic-tokens or --output=edits-json\n");
+            return 1;
+        }
+    }
+
+    if(gVerifyOutput) {
+        // The result is parsed again with the invocation of the translation unit, which only the one parsing it has.
+        if((1 != gCodegenJobs) or gStream or gDedupStore or not gFromAst.empty() or not gPipeline.empty() or
+           (OutputFormat::EditsJson == gOutputFormat)) {
+            Error("--verify-output cannot be used together with --codegen-jobs, --stream, --dedup-store, --from-ast, "
+                  "--pipeline or --output=edits-json\n");
+            return 1;
+        }
+    }
+
+    if(not gLowered.empty()) {
+        // Same as --verify-output, the result is compiled with the invocation of the translation unit.
+        if((1 != gCodegenJobs) or gStream or gDedupStore or not gFromAst.empty() or not gPipeline.empty() or
+           (OutputFormat::EditsJson == gOutputFormat)) {
+            Error("--lowered cannot be used together with --codegen-jobs, --stream, --dedup-store, --from-ast, "
+                  "--pipeline or --output=edits-json\n");
+            return 1;
+        }
+
+        if(3 < gLoweredOptLevel) {
+            Error("--lowered-opt-level expects a level from 0 to 3\n");
+            return 1;
+        }
+    }
+
+    if(gDedupStore) {
+        // The manifests reference the slices of the main file, the shards and the cache keep only the whole result.
+        if(gOutputDir.empty() or (1 != gCodegenJobs) or gStream or not gCacheDir.empty() or
+           (OutputFormat::EditsJson == gOutputFormat)) {
+            Error("--dedup-store requires --output-dir and cannot be used together with --codegen-jobs, --stream, "
+                  "--cache-dir or --output=edits-json\n");
+            return 1;
+        }
+
+        llvm::SmallString<256> storeDir{gOutputDir.getValue()};
+        llvm::sys::path::append(storeDir, ".insights-store");
+        EnableContentStore(storeDir);
+    }
+
+    if(not gSourceMap.empty()) {
+        // The source map belongs to the one result this process writes, the shards and the cache keep no positions.
+        if(((1 != op.getSourcePathList().size()) and gFromAst.empty()) or (1 != gJobs) or not gOutputDir.empty() or
+           (1 != gCodegenJobs) or gStream or gBatchMode or not gCacheDir.empty() or
+           (OutputFormat::EditsJson == gOutputFormat)) {
+            Error("--source-map requires exactly one source file and cannot be used together with -j, --output-dir, "
+                  "--codegen-jobs, --stream, --batch, --cache-dir or --output=edits-json\n");
+            return 1;
+        }
+
+        EnableSourceMap();
+    }
+
+    if(not gSemanticTokens.empty()) {
+        // Like the source map, the tokens belong to the one result this process writes.
+        if(((1 != op.getSourcePathList().size()) and gFromAst.empty()) or (1 != gJobs) or not gOutputDir.empty() or
+           (1 != gCodegenJobs) or gStream or gBatchMode or not gCacheDir.empty() or
+           (OutputFormat::EditsJson == gOutputFormat)) {
+            Error("--semantic-tokens requires exactly one source file and cannot be used together with -j, "
+                  "--output-dir, --codegen-jobs, --stream, --batch, --cache-dir or --output=edits-json\n");
+            return 1;
+        }
+    }
+
+    if(gStdModules) {
+#ifndef __APPLE__
+        // Only the module map of libc++ is known to cover the entire standard library.
+        if(not gUseLibCpp) {
+            Error("--std-modules requires -use-libc++\n");
+            return 1;
+        }
+#endif /* __APPLE__ */
+
+        // A PCH built with modules does not match a run without them and the other way around.
+        if(not gPchCacheDir.empty()) {
+            Error("--std-modules cannot be used together with --pch-cache-dir\n");
+            return 1;
+        }
+    }
+
+    if(gHandlers.getNumOccurrences()) {
+        unsigned enabled{};
+
+        for(const auto& name : gHandlers) {
+            const auto handler = llvm::StringSwitch<unsigned>(name)
+                                     .Case("templates", static_cast<unsigned>(InsightsHandler::Templates))
+                                     .Case("records", static_cast<unsigned>(InsightsHandler::Records))
+                                     .Case("functions", static_cast<unsigned>(InsightsHandler::Functions))
+                                     .Case("globals", static_cast<unsigned>(InsightsHandler::Globals))
+                                     .Case("static-asserts", static_cast<unsigned>(InsightsHandler::StaticAsserts))
+                                     .Default(0);
+
+            if(0 == handler) {
+                Error("unknown handler '%s' for --handlers\n", name.c_str());
+                return 1;
+            }
+
+            enabled |= handler;
+        }
+
+        gInsightsOptions.disabledHandlers = ~enabled;
+    }
+
+    if(0 == gInsightsOptions.cacheLineSize) {
+        Error("--cache-line-size must not be 0\n");
+        return 1;
+    }
+
+    gInsightsOptions.syncAnnotations.assign(gSyncAnnotations.begin(), gSyncAnnotations.end());
+
+    if(gLockTypes.empty()) {
+        gInsightsOptions.lockTypes = {"std::lock_guard", "std::unique_lock", "std::scoped_lock", "std::shared_lock"};
+
+    } else {
+        gInsightsOptions.lockTypes.assign(gLockTypes.begin(), gLockTypes.end());
+    }
+
+    if(not gFieldProfile.empty()) {
+        auto profile = llvm::MemoryBuffer::getFile(gFieldProfile);
+
+        if(not profile) {
+            Error("cannot read '%s' for --field-profile\n", gFieldProfile.c_str());
+            return 1;
+        }
+
+        if(std::string error{};
+           not ParseFieldProfile(profile.get()->getBuffer(), gInsightsOptions.fieldAccessCounts, error)) {
+            Error("%s: %s\n", gFieldProfile.c_str(), error.c_str());
+            return 1;
+        }
+    }
+
+    // The headers are transformed as well, they need their bodies.
+    if(gSkipHeaderBodies and gTraverseAllDecls) {
+        Error("--skip-header-bodies cannot be used together with --traverse-all-decls\n");
+        return 1;
+    }
+
+    if(not gRange.empty() or gOffset.getNumOccurrences()) {
+        // Everything outside of the main file is transformed only with --traverse-all-decls.
+        if(gTraverseAllDecls) {
+            Error("--range and --offset cannot be used together with --traverse-all-decls\n");
+            return 1;
+        }
+
+        if(gOffset.getNumOccurrences()) {
+            gInsightsOptions.hasRangeOffset = true;
+            gInsightsOptions.rangeOffset    = gOffset;
+        }
+
+        if(not gRange.empty()) {
+            const auto [first, last] = StringRef{gRange}.split(':');
+
+            if(first.getAsInteger(10, gInsightsOptions.rangeFirstLine) or
+               last.getAsInteger(10, gInsightsOptions.rangeLastLine) or (0 == gInsightsOptions.rangeFirstLine) or
+               (gInsightsOptions.rangeLastLine < gInsightsOptions.rangeFirstLine)) {
+                Error("--range expects <first>:<last> with 0 < first <= last\n");
+                return 1;
+            }
+        }
+    }
+
+    // A shard which stops at the deadline fails, which makes the whole file run a second time.
+    if((0 != gDeadlineMs) and (1 != gCodegenJobs)) {
+        Error("--deadline-ms cannot be used together with --codegen-jobs\n");
+        return 1;
+    }
+
+    // The shards generate different parts of the file, each of them would count only its own bytes.
+    if((0 != gMaxOutputBytes) and (1 != gCodegenJobs)) {
+        Error("--max-output-bytes cannot be used together with --codegen-jobs\n");
+        return 1;
+    }
+
+    if((gForkServer or gWorkerPool or not gForkServerWarmup.empty()) and gServerAddress.empty()) {
+        Error("--fork-server, --worker-pool and --fork-server-warmup require --server\n");
+        return 1;
+    }
+
+    if(gForkServer and gWorkerPool) {
+        Error("--fork-server cannot be used together with --worker-pool\n");
+        return 1;
+    }
+
+    unsigned pipelineParseJobs{};
+    unsigned pipelineCodegenJobs{};
+
+    if(not gPipeline.empty()) {
+        const auto [parse, codegen] = StringRef{gPipeline}.split(':');
+
+        if(parse.getAsInteger(10, pipelineParseJobs) or codegen.getAsInteger(10, pipelineCodegenJobs) or
+           (0 == pipelineParseJobs) or (0 == pipelineCodegenJobs)) {
+            Error("--pipeline expects <parse>:<codegen> with 0 < parse and 0 < codegen\n");
+            return 1;
+        }
+
+        // A request is parsed and generated by different threads, the result store coalesces entire requests.
+        if(gServerAddress.empty() or gForkServer or gWorkerPool or (0 != gResultStoreSize)) {
+            Error("--pipeline requires --server and cannot be used together with --fork-server, --worker-pool or "
+                  "--result-store-size\n");
+            return 1;
+        }
+    }
+
+    ServerSchedule schedule{EstimateRequestCost, gInteractiveCost.getValue(), {}};
+
+    if(gScheduler) {
+        // A preempted request would hand its truncated result to all requests the result store coalesced with it.
+        if(gServerAddress.empty() or gForkServer or gWorkerPool or not gPipeline.empty() or (0 != gResultStoreSize)) {
+            Error("--scheduler requires --server and cannot be used together with --fork-server, --worker-pool, "
+                  "--pipeline or --result-store-size\n");
+            return 1;
+        }
+
+        for(const auto& tenantWeight : gTenantWeights) {
+            const auto [tenant, weightText] = StringRef{tenantWeight}.rsplit(':');
+            unsigned weight{};
+
+            if(tenant.empty() or weightText.getAsInteger(10, weight) or (0 == weight)) {
+                Error("--tenant-weight expects <tenant>:<weight> with 0 < weight\n");
+                return 1;
+            }
+
+            schedule.weights.emplace_back(tenant.str(), weight);
+        }
+
+    } else if(gInteractiveCost.getNumOccurrences() or gTenantWeights.getNumOccurrences()) {
+        Error("--interactive-cost and --tenant-weight require --scheduler\n");
+        return 1;
+    }
+
+    if(gMetrics) {
+        // The metrics of a request would be lost with its child. The workers of --worker-pool only report their
+        // resident set.
+        if(gServerAddress.empty() or gForkServer) {
+            Error("--metrics requires --server and cannot be used together with --fork-server\n");
+            return 1;
+        }
+
+        EnableMetrics();
+    }
+
+    if(not gRemoteCache.empty()) {
+        // The remote cache is only consulted on a miss of the local one.
+        if(gCacheDir.empty()) {
+            Error("--remote-cache requires --cache-dir\n");
+            return 1;
+        }
+
+        if(not EnableRemoteCache(gRemoteCache)) {
+            Error("--remote-cache: '%s' is not a valid http:// URL\n", gRemoteCache.getValue());
+            return 1;
+        }
+    }
+
+    if(0 != gPchWarmTop) {
+        // The thread which builds the PCHs does not survive a fork.
+        if(gServerAddress.empty() or gPchCacheDir.empty() or gForkServer or gWorkerPool) {
+            Error("--pch-warm-top requires --server and --pch-cache-dir and cannot be used together with "
+                  "--fork-server or --worker-pool\n");
+            return 1;
+        }
+
+        EnablePchWarming(gPchCacheDir, gPchWarmTop, [](ClangTool& tool, const bool useLibCpp) {
+            AddInsightsArgumentAdjusters(tool, useLibCpp);
+        });
+    }
+
+    if(0 != gResultStoreSize) {
+        // Every child would have a store of its own, which sees only the requests of a single connection.
+        if(gForkServer or gWorkerPool) {
+            Error("--result-store-size cannot be used together with --fork-server or --worker-pool\n");
+            return 1;
+        }
+
+        EnableResultStore(gResultStoreSize * 1024 * 1024);
+    }
+
+    if((not gBatchArchive.empty() or not gBatchArchiveOutput.empty()) and not gBatchMode) {
+        Error("--batch-archive and --batch-archive-output require --batch\n");
+        return 1;
+    }
+
+    if(gStdioProtocol) {
+        if(not gServerAddress.empty() or gBatchMode or gStdinMode) {
+            Error("--stdio-protocol cannot be used together with --server, --batch or --stdin\n");
+            return 1;
+        }
+
+        // Each document keeps its own file manager. The transforms run one at a time on the same thread.
+        const int ret = RunStdioProtocol([] {
+            return [state = std::make_shared<InsightsServerState>()](const ServerRequest& request) {
+                return state->Run(request);
+            };
+        });
+
+        PrintReports();
+
+        return ret;
+    }
+
+    if(not gServerAddress.empty()) {
+        const unsigned jobs{(0 == gJobs) ? std::max(1u, std::thread::hardware_concurrency()) : gJobs.getValue()};
+
+        // Each request runs with its own context. The file manager is not thread-safe, every thread keeps its own.
+        const auto handler = [](const ServerRequest& request) {
+            static thread_local InsightsServerState state{};
+
+            return MeasureRequest([&] { return state.Run(request); });
+        };
+
+        if(not gPipeline.empty()) {
+            const auto parse = [](const ServerRequest& request, ServerResponse& response) {
+                static thread_local InsightsServerState state{};
+
+                return state.Parse(request, response);
+            };
+
+            return RunPipelineServer(gServerAddress,
+                                     pipelineParseJobs,
+                                     pipelineCodegenJobs,
+                                     parse,
+                                     gMetrics ? ServerMetricsHandler{GetMetricsText} : nullptr);
+        }
+
+        if(gScheduler) {
+            // A preempted request stops at the next deadline check, like one whose deadline passed.
+            const auto cancellableHandler = [](const ServerRequest& request, const std::atomic<bool>& cancelled) {
+                static thread_local InsightsServerState state{};
+                CancellationScope                       cancellationScope{cancelled};
+
+                return MeasureRequest([&] { return state.Run(request); });
+            };
+
+            return RunScheduledServer(gServerAddress,
+                                      jobs,
+                                      cancellableHandler,
+                                      schedule,
+                                      gMetrics ? ServerMetricsHandler{GetMetricsText} : nullptr);
+        }
+
+        if(not gForkServer and not gWorkerPool) {
+            return RunServer(gServerAddress, jobs, handler, gMetrics ? ServerMetricsHandler{GetMetricsText} : nullptr);
+        }
+
+        if(not gForkServerWarmup.empty()) {
+            auto source = llvm::MemoryBuffer::getFile(gForkServerWarmup);
+
+            if(not source) {
+                Error("cannot read '%s' for --fork-server-warmup\n", gForkServerWarmup.c_str());
+                return 1;
+            }
+
+            // Only the caches the request leaves behind matter, not its result.
+            handler({gForkServerWarmup, {}, source.get()->getBuffer().str()});
+        }
+
+        if(gWorkerPool) {
+            return RunWorkerPool(gServerAddress, jobs, handler, gMetrics);
+        }
+
+        return RunForkServer(gServerAddress, jobs, handler);
+
+    } else if(gBatchMode) {
+        const int ret = gBatchArchive.empty()
+                            ? RunBatch()
+                            : RunBatchArchive(gBatchArchive,
+                                              gBatchArchiveOutput.empty() ? StrCat(gBatchArchive, ".results")
+                                                                          : gBatchArchiveOutput.getValue(),
+                                              gJobs);
+        PrintReports();
+
+        return ret;
+    }
+
+    if(not gMaterialize.empty()) {
+        return MaterializeManifest(gMaterialize, llvm::outs()) ? 0 : 1;
+    }
+
+    if(not gFromAst.empty()) {
+        if(not op.getSourcePathList().empty() or gStdinMode or (1 != gJobs) or not gCacheDir.empty() or
+           not gPchCacheDir.empty()) {
+            Error("--from-ast cannot be used together with source files, --stdin, -j, --cache-dir or "
+                  "--pch-cache-dir\n");
+            return 1;
+        }
+
+        const int ret = RunFromAst(gFromAst, llvm::outs());
+        PrintReports();
+
+        return ret;
+    }
+
+    if(op.getSourcePathList().empty() and gProject.empty()) {
+        Error("no input files\n");
+        return 1;
+    }
+
+    // For some reason, Clang on Apple seems to require an additional hint for the C++ headers.
+#ifdef __APPLE__
+    gUseLibCpp = true;
+#endif /* __APPLE__ */
+
+    if(not gProject.empty()) {
+        if(gOutputDir.empty() or gStdinMode or not op.getSourcePathList().empty()) {
+            Error("--project requires --output-dir and cannot be used together with source files or --stdin\n");
+            return 1;
+        }
+
+        std::string errorMessage{};
+        const auto  compilations =
+            JSONCompilationDatabase::loadFromFile(gProject, errorMessage, JSONCommandLineSyntax::AutoDetect);
+
+        if(not compilations) {
+            Error("cannot load '%s': %s\n", gProject.getValue(), errorMessage);
+            return 1;
+        }
+
+        // A file listed more than once, for example for several configurations, is processed once.
+        const auto sourcePaths = compilations->getAllFiles();
+
+        if(sourcePaths.empty()) {
+            Error("no translation units in '%s'\n", gProject.getValue());
+            return 1;
+        }
+
+        // Most files of a project share their flags and system includes, so they share a PCH as well.
+        if(gPchCacheDir.empty()) {
+            llvm::SmallString<256> pchCacheDir{gOutputDir.getValue()};
+            llvm::sys::path::append(pchCacheDir, ".insights-pch");
+            gPchCacheDir = pchCacheDir.str().str();
+        }
+
+        const int ret =
+            RunParallel(*compilations, sourcePaths, gJobs, gOutputDir, GetCommonDirectory(sourcePaths), gUseLibCpp);
+        SaveVfsSnapshot();
+        PrintReports();
+
+        return ret;
+    }
+
+    if(gMeasureOverhead) {
+        if(gStdinMode or (1 != gJobs) or not gCacheDir.empty() or not gPchCacheDir.empty()) {
+            Error("--measure-overhead cannot be used together with --stdin, -j, --cache-dir or --pch-cache-dir\n");
+            return 1;
+        }
+
+        return RunOverheadBenchmark(op.getCompilations(), op.getSourcePathList(), gUseLibCpp);
+    }
+
+    if(gEstimate) {
+        ClangTool estimateTool(op.getCompilations(), op.getSourcePathList());
+        AddInsightsArgumentAdjusters(estimateTool, gUseLibCpp);
+
+        std::unique_ptr<llvm::MemoryBuffer> code{};
+        if(gStdinMode) {
+            auto codeOrErr = llvm::MemoryBuffer::getSTDIN();
+
+            if(not codeOrErr) {
+                Error("cannot read stdin: %s\n", codeOrErr.getError().message());
+                return 1;
+            }
+
+            code = std::move(codeOrErr.get());
+            estimateTool.mapVirtualFile(op.getSourcePathList().front(), code->getBuffer());
+        }
+
+        return RunEstimate(estimateTool, llvm::outs());
+    }
+
+    if(not gOptionMatrix.empty()) {
+        if((1 != op.getSourcePathList().size()) or (1 != gJobs) or not gOutputDir.empty() or (1 != gCodegenJobs) or
+           not gStdMatrix.empty()) {
+            Error("--option-matrix requires exactly one source file and cannot be used together with -j, "
+                  "--output-dir, --codegen-jobs or --std-matrix\n");
+            return 1;
+        }
+
+        const std::vector<std::string> optionSets{gOptionMatrix.begin(), gOptionMatrix.end()};
+        std::vector<InsightsOptions>   setOptions{};
+        std::string                    error{};
+
+        if(not ParseOptionSets(optionSets, gInsightsOptions, setOptions, error)) {
+            Error("%s", error);
+            return 1;
+        }
+
+        const auto& sourcePath = op.getSourcePathList().front();
+        ClangTool   tool(op.getCompilations(), {sourcePath});
+
+        // As for a single file, in STDINMode the content comes from <stdin>.
+        std::unique_ptr<llvm::MemoryBuffer> inMemoryCode{};
+
+        if(gStdinMode) {
+            auto codeOrErr = llvm::MemoryBuffer::getSTDIN();
+
+            if(not codeOrErr) {
+                Error("cannot read <stdin>: %s\n", codeOrErr.getError().message());
+                return 1;
+            }
+
+            inMemoryCode = std::move(codeOrErr.get());
+            tool.mapVirtualFile(sourcePath, inMemoryCode->getBuffer());
+        }
+
+        AddInsightsArgumentAdjusters(tool, gUseLibCpp);
+
+        const int ret = RunOptionMatrix(tool, optionSets, setOptions, llvm::outs(), llvm::errs());
+        PrintReports();
+
+        return ret;
+    }
+
+    if(not gStdMatrix.empty()) {
+        if((1 != op.getSourcePathList().size()) or (1 != gJobs) or not gOutputDir.empty() or (1 != gCodegenJobs)) {
+            Error("--std-matrix requires exactly one source file and cannot be used together with -j, --output-dir "
+                  "or --codegen-jobs\n");
+            return 1;
+        }
+
+        const auto& sourcePath = op.getSourcePathList().front();
+        auto        source     = gStdinMode ? llvm::MemoryBuffer::getSTDIN() : llvm::MemoryBuffer::getFile(sourcePath);
+
+        if(not source) {
+            Error("cannot read '%s': %s\n", sourcePath, source.getError().message());
+            return 1;
+        }
+
+        const std::vector<std::string> standards{gStdMatrix.begin(), gStdMatrix.end()};
+
+        const int ret =
+            RunStdMatrix(op.getCompilations(), sourcePath, source.get()->getBuffer(), standards, gUseLibCpp);
+        PrintReports();
+
+        return ret;
+    }
+
+    if((1 != gJobs) or not gOutputDir.empty()) {
+        if(gStdinMode) {
+            Error("-j and --output-dir cannot be used together with --stdin\n");
+            return 1;
+        }
+
+        const int ret = RunParallel(op.getCompilations(), op.getSourcePathList(), gJobs, gOutputDir, {}, gUseLibCpp);
+        SaveVfsSnapshot();
+        PrintReports();
+
+        return ret;
+    }
+
+    ClangTool tool(
+        op.getCompilations(), op.getSourcePathList(), std::make_shared<PCHContainerOperations>(), GetBaseFileSystem());
+
+    llvm::StringRef sourceFilePath = op.getSourcePathList().front();
+    // In STDINMode, we override the file content with the <stdin> input.
+    // Since `tool.mapVirtualFile` takes `StringRef`, we define `Code` outside of
+    // the if-block so that `Code` is not released after the if-block.
+    std::unique_ptr<llvm::MemoryBuffer> inMemoryCode{};
+
+    if(gStdinMode) {
+        assert(op.getSourcePathList().size() == 1 && "Expect exactly one file path in STDINMode.");
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> codeOrErr = llvm::MemoryBuffer::getSTDIN();
+        if(const std::error_code errorCode = codeOrErr.getError()) {
+            llvm::errs() << errorCode.message() << "\n";
+            return 1;
+        }
+        inMemoryCode = std::move(codeOrErr.get());
+        if(inMemoryCode->getBufferSize() == 0) {
+            Error("empty file\n");
+            return 1;  // Skip empty files.
+        }
+
+        tool.mapVirtualFile(sourceFilePath, inMemoryCode->getBuffer());
+    }
+
+    AddInsightsArgumentAdjusters(tool, gUseLibCpp);
+
+    // With more than one file there is no single main file to key a cache by.
+    const bool singleFile{1 == op.getSourcePathList().size()};
+
+    if(singleFile and (not gPchCacheDir.empty() or not gCacheDir.empty()) and not inMemoryCode) {
+        if(auto codeOrErr = llvm::MemoryBuffer::getFile(sourceFilePath)) {
+            inMemoryCode = std::move(codeOrErr.get());
+        }
+    }
+
+    std::string cacheKey{};
+    if(singleFile and not gCacheDir.empty() and inMemoryCode) {
+        cacheKey = GetResultCacheKey(inMemoryCode->getBuffer(),
+                                     GetCompilerArgs(op.getCompilations(), sourceFilePath),
+                                     gInsightsOptions,
+                                     gUseLibCpp);
+
+        if(const auto cached = LookupCachedResult(gCacheDir, cacheKey)) {
+            llvm::outs() << *cached;
+
+            PrintReports();
+
+            return 0;
+        }
+    }
+
+    std::string pchPath{};
+    if(singleFile and not gPchCacheDir.empty() and inMemoryCode) {
+        // The editor integration re-runs on nearly every change, usually only the body changes. Precompile the whole
+        // preamble then.
+        pchPath = UsePrecompiledHeader(tool,
+                                       op.getCompilations(),
+                                       sourceFilePath,
+                                       inMemoryCode->getBuffer(),
+                                       gUseLibCpp,
+                                       UsePreamble{gStdinMode.getValue()});
+    }
+
+    // With the result cache the output is collected first, as it is stored only when the run succeeds. With a PCH the
+    // run may be repeated without it, the output and the diagnostics of the first one are dropped then.
+    std::string              result{};
+    llvm::raw_string_ostream resultStream{result};
+    raw_ostream&             output =
+        (cacheKey.empty() and pchPath.empty()) ? static_cast<raw_ostream&>(llvm::outs()) : resultStream;
+
+    std::string                                 pchDiagnostics{};
+    llvm::raw_string_ostream                    pchDiagStream{pchDiagnostics};
+    llvm::IntrusiveRefCntPtr<DiagnosticOptions> pchDiagOpts{new DiagnosticOptions};
+    TextDiagnosticPrinter                       pchDiagPrinter{pchDiagStream, pchDiagOpts.get()};
+
+    if(not pchPath.empty()) {
+        tool.setDiagnosticConsumer(&pchDiagPrinter);
+    }
+
+    auto run = [&](ClangTool& runTool) {
+        if(singleFile and (1 < gCodegenJobs)) {
+            auto makeTool = [&] {
+                auto shardTool = std::make_unique<ClangTool>(op.getCompilations(),
+                                                             op.getSourcePathList(),
+                                                             std::make_shared<PCHContainerOperations>(),
+                                                             GetBaseFileSystem());
+
+                if(gStdinMode) {
+                    shardTool->mapVirtualFile(sourceFilePath, inMemoryCode->getBuffer());
+                }
+
+                AddInsightsArgumentAdjusters(*shardTool, gUseLibCpp);
+
+                if(not pchPath.empty()) {
+                    AddPchArgument(*shardTool, pchPath);
+                }
+
+                return shardTool;
+            };
+
+            if(RunCodegenShards(makeTool, gCodegenJobs, output)) {
+                return 0;
+            }
+        }
+
+        // A single file is the last thing this process does, there is no need to free its AST.
+        InsightsContext                 context{gInsightsOptions};
+        CppInsightFrontendActionFactory factory{output, context, singleFile and not gFreeOnExit};
+
+        return GetExitCode(runTool.run(&factory), context);
+    };
+
+    int ret = run(tool);
+
+    if(not pchPath.empty()) {
+        pchDiagStream.flush();
+
+        if(0 == ret) {
+            llvm::errs() << pchDiagnostics;
+
+        } else {
+            // Clang rejected the PCH or the preamble broke the code, for example with a header without an include
+            // guard which the main file includes again. Try again without the PCH.
+            DropPrecompiledHeader(pchPath);
+            pchPath.clear();
+
+            resultStream.flush();
+            result.clear();
+
+            ClangTool retryTool(op.getCompilations(),
+                                op.getSourcePathList(),
+                                std::make_shared<PCHContainerOperations>(),
+                                GetBaseFileSystem());
+
+            if(gStdinMode) {
+                retryTool.mapVirtualFile(sourceFilePath, inMemoryCode->getBuffer());
+            }
+
+            AddInsightsArgumentAdjusters(retryTool, gUseLibCpp);
+
+            ret = run(retryTool);
+        }
+
+        if(cacheKey.empty()) {
+            resultStream.flush();
+            llvm::outs() << result;
+        }
+    }
+
+    if(not cacheKey.empty()) {
+        resultStream.flush();
+        llvm::outs() << result;
+
+        if(IsResultStorable(ret)) {
+            StoreCachedResult(gCacheDir, cacheKey, result, GetCacheSizeLimit());
+        }
+    }
+
+    SaveVfsSnapshot();
+    PrintReports();
 
-    return tool.run(newFrontendActionFactory<CppInsightFrontendAction>().get());
+    return ret;
 }
 //-----------------------------------------------------------------------------
+#endif /* INSIGHTS_NO_MAIN */
@@ -9,9 +9,49 @@
 #define INSIGHTS_H
 //-----------------------------------------------------------------------------
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace llvm {
+class raw_ostream;
+class StringRef;
+}  // namespace llvm
+
 namespace clang {
 class ASTContext;
 }
+
+namespace clang::insights {
+struct OutputSegment;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The handlers which can be turned off with \c --handlers, as a bit mask.
+enum class InsightsHandler : unsigned
+{
+    Templates     = 1u << 0,
+    Records       = 1u << 1,
+    Functions     = 1u << 2,
+    Globals       = 1u << 3,
+    StaticAsserts = 1u << 4,
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The cost classes of implicit conversions, from cheapest to costliest, see \c --show-casts.
+enum class CastCost : unsigned
+{
+    None,        //!< No conversion gets tagged.
+    Free,        //!< No code, like lvalue-to-rvalue or a no-op.
+    Cheap,       //!< A single instruction, like an integral or floating point cast to a different width.
+    IntFloat,    //!< A conversion between integral and floating point.
+    Adjustment,  //!< A derived-to-base conversion which adjusts the pointer.
+    Expensive,   //!< A user-defined conversion operator or converting constructor.
+};
 //-----------------------------------------------------------------------------
 
 /// \brief Global C++ Insights command line options.
@@ -19,15 +59,207 @@ struct InsightsOptions
 {
 #define INSIGHTS_OPT(opt, name, deflt, description, category) bool name;
 #include "InsightsOptions.def"
+
+    uint64_t maxInstantiations;     //!< The number of instantiations TemplateHandler generates, 0 for no limit.
+    uint64_t maxOutputBytes;        //!< The size of the code TemplateHandler generates, 0 for no limit.
+    uint64_t maxArrayElements;      //!< The number of equal array elements spelled out, 0 for no limit.
+    uint64_t maxPackArgs;           //!< The number of template pack arguments spelled out, 0 for no limit.
+    uint64_t functionBufferSize;    //!< The small buffer of \c std::function assumed by \c --show-closure-layout.
+    uint64_t passByValueThreshold;  //!< The size above which \c --show-pass-by-value annotates a parameter.
+    uint64_t stackFrameThreshold;   //!< The stack frame size above which \c --show-stack-frame marks a function.
+    CastCost showCasts;             //!< The cheapest implicit conversions \c --show-casts tags.
+    uint64_t cacheLineSize;         //!< The size of a cache line for \c --show-layout and \c --show-false-sharing.
+    uint64_t unrollFactor;          //!< The copies of a loop body \c --alt-syntax-unroll makes, 0 for no unrolling.
+
+    /// \brief The \c annotate attributes which mark a field as synchronization member for \c --show-false-sharing.
+    std::vector<std::string> syncAnnotations;
+
+    /// \brief The classes and class templates whose local variables \c --show-lock-scope treats as locks.
+    std::vector<std::string> lockTypes;
+
+    /// \brief The accesses of each \c Record::field read from \c --field-profile, empty for no hot/cold split.
+    std::map<std::string, uint64_t> fieldAccessCounts;
+
+    uint64_t rangeFirstLine;  //!< The first line of the selected range, 0 to transform the entire file.
+    uint64_t rangeLastLine;   //!< The last line of the selected range.
+    bool     hasRangeOffset;  //!< Whether only the top-level declaration at \c rangeOffset gets transformed.
+    uint64_t rangeOffset;     //!< The byte offset in the main file of the selected declaration.
+
+    unsigned disabledHandlers;  //!< The \ref InsightsHandler bits of the handlers which are not created.
+    bool     outputEdits;       //!< Write only the edits as JSON instead of the transformed file.
+    bool     streamOutput;      //!< Write each top-level declaration of the main file as soon as it is transformed.
+    uint64_t deadlineMs;        //!< The time a translation unit may take, 0 for no limit.
+
+    /// \brief The clang-format style the generated code is formatted in, empty to leave it as it is.
+    std::string formatStyle;
+
+    bool verifyOutput;  //!< Parse the result again and report its errors, see \c --verify-output.
+    bool     skipOnError;  //!< Generate nothing for a translation unit with errors, see \c --skip-on-error.
+    uint64_t errorLimit;   //!< The errors after which clang stops parsing, 0 for its default.
+
+    bool IsEnabled(const InsightsHandler handler) const
+    {
+        return 0 == (disabledHandlers & static_cast<unsigned>(handler));
+    }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The bit of each boolean option of \c InsightsOptions.def in \ref GetOptionBits.
+enum class InsightsOptionBit : unsigned
+{
+#define INSIGHTS_OPT(opt, name, deflt, description, category) name,
+#include "InsightsOptions.def"
+    Count
+};
+
+static_assert(static_cast<unsigned>(InsightsOptionBit::Count) <= 64, "The option bits do not fit into uint64_t");
+//-----------------------------------------------------------------------------
+
+/// \brief The boolean options of \c InsightsOptions.def in \p options as a bit set, see \ref InsightsOptionBit.
+inline uint64_t GetOptionBits(const InsightsOptions& options)
+{
+    uint64_t bits{};
+
+#define INSIGHTS_OPT(opt, name, deflt, description, category)                                                       \
+    bits |= uint64_t{options.name ? 1u : 0u} << static_cast<unsigned>(InsightsOptionBit::name);
+#include "InsightsOptions.def"
+
+    return bits;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The state of a single C++ Insights run, one translation unit at a time.
+///
+/// Each run gets its own context, which allows to run multiple requests with different options on different threads.
+/// While a translation unit is processed, its context is the current one of the thread, see \ref
+/// InsightsContextScope. The caches of the code generation are kept per thread and reset for each translation unit.
+struct InsightsContext
+{
+    InsightsOptions          options{};
+    const clang::ASTContext* ast{};  //!< The translation unit in progress, the source manager is part of it.
+
+    std::chrono::steady_clock::time_point deadline{};  //!< When the code generation stops, see \ref IsDeadlineExceeded.
+    bool deadlineExceeded{};  //!< Whether the code generation stopped at the deadline and the output is incomplete.
+    bool verifyFailed{};      //!< Whether the result did not compile, see \c --verify-output.
+    bool skippedOnError{};    //!< Whether the input had errors and nothing was generated, see \c --skip-on-error.
+
+    /// Where the parts of the result per top-level declaration go, if someone wants them, see \ref OutputSegment.
+    std::vector<clang::insights::OutputSegment>* segments{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Make \p context the current context of this thread, for as long as the scope lives.
+class InsightsContextScope
+{
+public:
+    explicit InsightsContextScope(InsightsContext& context);
+    ~InsightsContextScope();
+
+    InsightsContextScope(const InsightsContextScope&) = delete;
+    InsightsContextScope& operator=(const InsightsContextScope&) = delete;
+
+private:
+    InsightsContext* mPrevious;
 };
 //-----------------------------------------------------------------------------
 
-/// \brief Get the global C++ Insights options.
+/// \brief Get the C++ Insights options of the current context or the command line options without one.
 extern const InsightsOptions& GetInsightsOptions();
 //-----------------------------------------------------------------------------
 
-/// \brief Get access to the ASTContext
+/// \brief Check whether the deadline of the current context, see \c --deadline-ms, has passed.
+///
+/// The code generation calls this cooperatively and stops generating once it returns \c true. Only every few hundred
+/// calls look at the clock. Once the deadline passed, this returns \c true for the rest of the translation unit. A
+/// cancelled request, see \ref CancellationScope, counts as a passed deadline.
+extern bool IsDeadlineExceeded();
+//-----------------------------------------------------------------------------
+
+/// \brief Let the code generation of this thread stop at the next check of \ref IsDeadlineExceeded once \p cancelled
+/// becomes \c true, for as long as the scope lives.
+class CancellationScope
+{
+public:
+    explicit CancellationScope(const std::atomic<bool>& cancelled);
+    ~CancellationScope();
+
+    CancellationScope(const CancellationScope&) = delete;
+    CancellationScope& operator=(const CancellationScope&) = delete;
+
+private:
+    const std::atomic<bool>* mPrevious;
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Get access to the ASTContext of the current context.
 extern const clang::ASTContext& GetGlobalAST();
 //-----------------------------------------------------------------------------
 
+/// \brief Transform \p code like \c --stdin does, with the command line options and \p compilerArgs.
+///
+/// This is the entry point for the fuzzer, see fuzz/InsightsFuzzer.cpp. The result goes to \p output and the
+/// diagnostics to \p diagnostics.
+///
+/// \returns The exit code C++ Insights would have.
+extern int TransformCode(llvm::StringRef                 fileName,
+                         llvm::StringRef                 code,
+                         const std::vector<std::string>& compilerArgs,
+                         llvm::raw_ostream&              output,
+                         llvm::raw_ostream&              diagnostics);
+//-----------------------------------------------------------------------------
+
+/// \brief The numbers of a single \ref TransformSource call.
+struct TransformStats
+{
+    double   timeMs{};       //!< The wall time of the call.
+    uint64_t outputBytes{};  //!< The size of the transformed code.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The result of \ref TransformSource.
+struct TransformResult
+{
+    int            returnCode{};  //!< The exit code C++ Insights would have.
+    std::string    code{};
+    std::string    diagnostics{};
+    TransformStats stats{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The options a \ref TransformSource call starts with, the defaults or the ones of the command line.
+extern InsightsOptions GetDefaultInsightsOptions();
+
+/// \brief Transform \p source with \p options and \p compilerArgs in this process, the entry point of \c libinsights.
+///
+/// The call is reentrant, each thread keeps the state of a server, see \ref InsightsServerState. Consecutive calls of
+/// a thread share its file manager, and all calls share the result store, \c --cache-dir and \c --pch-cache-dir, as
+/// far as they are enabled. \p fileName is the name of the main file in the output and the diagnostics.
+extern TransformResult TransformSource(llvm::StringRef                 fileName,
+                                       llvm::StringRef                 source,
+                                       const std::vector<std::string>& compilerArgs,
+                                       const InsightsOptions&          options);
+//-----------------------------------------------------------------------------
+
+/// \brief A single source of \ref TransformSources.
+struct TransformInput
+{
+    std::string fileName{};
+    std::string source{};
+};
+
+/// \brief Transform all of \p inputs with \p jobs threads, the results are in the order of \p inputs.
+///
+/// Each thread calls \ref TransformSource, 0 \p jobs means one per hardware thread.
+extern std::vector<TransformResult> TransformSources(const std::vector<TransformInput>& inputs,
+                                                     const std::vector<std::string>&    compilerArgs,
+                                                     const InsightsOptions&             options,
+                                                     unsigned                           jobs);
+
+/// \brief Set the boolean option \p option, like \c show-all-implicit-casts or \c --edu-show-padding=false, in \p
+/// options.
+///
+/// \returns \c false, if \p option is unknown.
+extern bool SetInsightsOption(llvm::StringRef option, InsightsOptions& options);
+//-----------------------------------------------------------------------------
+
 #endif /* INSIGHTS_H */
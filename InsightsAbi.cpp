@@ -0,0 +1,153 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/Basic/TargetInfo.h"
+
+#include "InsightsAbi.h"
+#include "InsightsHelpers.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+enum class CallingConvention
+{
+    SysVX86_64,
+    MicrosoftX64,
+    AArch64,
+    Other,
+};
+//-----------------------------------------------------------------------------
+
+static CallingConvention GetCallingConvention(const llvm::Triple& triple)
+{
+    switch(triple.getArch()) {
+        case llvm::Triple::x86_64:
+            return triple.isOSWindows() ? CallingConvention::MicrosoftX64 : CallingConvention::SysVX86_64;
+        case llvm::Triple::aarch64: return CallingConvention::AArch64;
+        default: return CallingConvention::Other;
+    }
+}
+//-----------------------------------------------------------------------------
+
+static const char* GetConventionName(const CallingConvention cc)
+{
+    switch(cc) {
+        case CallingConvention::SysVX86_64: return "x86-64 System V";
+        case CallingConvention::MicrosoftX64: return "Microsoft x64";
+        case CallingConvention::AArch64: return "AArch64";
+        case CallingConvention::Other: break;
+    }
+
+    return "";
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether an object of \p type is passed like a class, by its size, instead of in a single register.
+static bool IsPassedLikeAggregate(const QualType& type)
+{
+    return type->isRecordType() or type->isMemberFunctionPointerType() or type->isAnyComplexType() or
+           type->isVectorType();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief How an object of \p type is passed, \p isReturn selects the rules for the return value.
+static std::string GetPassing(const ASTContext& ctx, const CallingConvention cc, QualType type, const bool isReturn)
+{
+    type = type.getCanonicalType();
+
+    if(type->isDependentType() or type->isIncompleteType()) {
+        return "unknown";
+    }
+
+    // A reference is a pointer in the ABI.
+    if(type->isReferenceType()) {
+        return "register, a pointer";
+    }
+
+    const uint64_t size{static_cast<uint64_t>(ctx.getTypeSizeInChars(type).getQuantity())};
+
+    if(const auto* record = type->getAsRecordDecl(); record and not record->canPassInRegisters()) {
+        return StrCat(isReturn ? "hidden pointer (sret)" : "invisible reference to a copy of the caller",
+                      ", ",
+                      size,
+                      " bytes, not trivial for calls");
+    }
+
+    if(not IsPassedLikeAggregate(type)) {
+        return "register";
+    }
+
+    const uint64_t pointerSize{ctx.getTargetInfo().getPointerWidth(0) / 8};
+
+    switch(cc) {
+        case CallingConvention::SysVX86_64:
+        case CallingConvention::AArch64:
+            if(2 * pointerSize >= size) {
+                return StrCat("registers, ", size, " bytes");
+            }
+
+            if(isReturn) {
+                return StrCat("hidden pointer (sret), ", size, " bytes");
+            }
+
+            return StrCat((CallingConvention::SysVX86_64 == cc) ? "stack" : "pointer to a copy of the caller",
+                          ", ",
+                          size,
+                          " bytes");
+
+        case CallingConvention::MicrosoftX64:
+            if((1 == size) or (2 == size) or (4 == size) or (8 == size)) {
+                return StrCat("register, ", size, " bytes");
+            }
+
+            return StrCat(isReturn ? "hidden pointer (sret)" : "pointer to a copy of the caller", ", ", size, " bytes");
+
+        case CallingConvention::Other: break;
+    }
+
+    return StrCat(size, " bytes");
+}
+//-----------------------------------------------------------------------------
+
+void InsertAbiPassing(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function)
+{
+    if(function.isDependentContext()) {
+        return;
+    }
+
+    const auto& ctx    = function.getASTContext();
+    const auto& triple = ctx.getTargetInfo().getTriple();
+    const auto  cc     = GetCallingConvention(triple);
+
+    if(CallingConvention::Other == cc) {
+        outputFormatHelper.AppendNewLine("/* passing on ", triple.str(), ", the calling convention is not modeled");
+    } else {
+        outputFormatHelper.AppendNewLine("/* passing on ", GetConventionName(cc));
+    }
+
+    if(const auto returnType = function.getReturnType(); not returnType->isVoidType()) {
+        outputFormatHelper.AppendNewLine("   return: ", GetPassing(ctx, cc, returnType, true));
+    }
+
+    if(const auto* method = dyn_cast<CXXMethodDecl>(&function); method and method->isInstance()) {
+        outputFormatHelper.AppendNewLine("   this: register, a pointer");
+    }
+
+    for(const auto* param : function.parameters()) {
+        const std::string name{param->getName().empty() ? GetUnnamedParameterName(*param) : GetName(*param)};
+
+        outputFormatHelper.AppendNewLine("   ", name, ": ", GetPassing(ctx, cc, param->getType(), false));
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,34 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_ABI_H
+#define INSIGHTS_ABI_H
+
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class FunctionDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Insert a comment which tells how the target passes each parameter and the return value of \p function, see
+/// \c --show-abi-passing.
+///
+/// A class which is not trivial for the purpose of calls, for example because of a user-provided destructor, is passed
+/// by an invisible reference to a copy the caller makes and returned via a hidden pointer (sret) under the Itanium ABI.
+/// Other classes follow the size rules of the calling convention of the target: x86-64 System V, Microsoft x64 and
+/// AArch64 are modeled, the other targets only tell the size. The rules for floating point members and homogeneous
+/// aggregates are left out, so this is an estimate, not what the backend emits.
+void InsertAbiPassing(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_ABI_H */
@@ -0,0 +1,319 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/StringSwitch.h"
+
+#include "InsightsAllocations.h"
+#include "InsightsHelpers.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+bool IsLibCpp(const Decl& decl)
+{
+    for(const auto* ctx = decl.getDeclContext(); ctx; ctx = ctx->getParent()) {
+        if(const auto* ns = dyn_cast<NamespaceDecl>(ctx); ns and ns->isInline() and (ns->getName() == "__1")) {
+            return true;
+        }
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+uint64_t GetStringSmallBufferCapacity(const Decl& decl, const uint64_t charSize)
+{
+    if(0 == charSize) {
+        return 0;
+    }
+
+    // libc++ reuses the three pointers of the long form for the characters and one byte of them for the size.
+    if(IsLibCpp(decl)) {
+        const auto     pointerSize{decl.getASTContext().getTypeSizeInChars(decl.getASTContext().VoidPtrTy)};
+        const uint64_t capacity{(3 * static_cast<uint64_t>(pointerSize.getQuantity()) - 1) / charSize};
+
+        return (capacity > 1) ? (capacity - 1) : 1;
+    }
+
+    // libstdc++ has a local buffer of 16 bytes, one character of it is the terminating null.
+    return 15 / charSize;
+}
+//-----------------------------------------------------------------------------
+
+bool IsAllocatingContainer(StringRef name)
+{
+    return llvm::StringSwitch<bool>(name)
+        .Cases("vector", "deque", "list", "forward_list", true)
+        .Cases("map", "multimap", "set", "multiset", true)
+        .Cases("unordered_map", "unordered_multimap", "unordered_set", "unordered_multiset", true)
+        .Default(false);
+}
+//-----------------------------------------------------------------------------
+
+std::string GetAllocationNote(const CXXNewExpr& expr)
+{
+    // The placement forms of the standard library only construct, they do not allocate.
+    if(const auto* opNew = expr.getOperatorNew(); opNew and opNew->isReservedGlobalPlacementOperator()) {
+        return {};
+    }
+
+    return expr.isArray() ? "allocation: new[]" : "allocation: new";
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetStringAllocationNote(const CXXConstructExpr& expr, const CXXRecordDecl& record)
+{
+    if(0 == expr.getNumArgs()) {
+        return {};
+    }
+
+    const auto* literal = dyn_cast_or_null<StringLiteral>(expr.getArg(0)->IgnoreParenImpCasts());
+
+    if(not literal) {
+        return "may allocate: std::string longer than its small buffer";
+    }
+
+    const uint64_t capacity{GetStringSmallBufferCapacity(record, literal->getCharByteWidth())};
+
+    if(literal->getLength() <= capacity) {
+        return {};
+    }
+
+    return StrCat(
+        "allocation: std::string of ", literal->getLength(), " characters, the small buffer holds ", capacity);
+}
+//-----------------------------------------------------------------------------
+
+std::string GetAllocationNote(const CXXConstructExpr& expr)
+{
+    const auto* ctor   = expr.getConstructor();
+    const auto* record = ctor->getParent();
+
+    // Default constructed and moved-from objects take over what they have, neither allocates.
+    if(expr.isElidable() or ctor->isDefaultConstructor() or ctor->isMoveConstructor() or
+       not record->isInStdNamespace() or not record->getIdentifier()) {
+        return {};
+    }
+
+    const auto name = record->getName();
+
+    if(name == "basic_string") {
+        return GetStringAllocationNote(expr, *record);
+    }
+
+    if(IsAllocatingContainer(name)) {
+        return StrCat("may allocate: std::", name, " with elements");
+    }
+
+    if(const auto erasure = GetFunctionErasure(expr); erasure and erasure->allocates) {
+        return StrCat("allocation: std::function of a ", erasure->callableSize, " bytes callable, ", erasure->reason);
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether a copy of \p record cannot throw. An implicit copy constructor, which is not declared yet, cannot
+/// throw if the ones of all bases and fields cannot.
+static bool IsNothrowCopyConstructible(const CXXRecordDecl& record)
+{
+    if(record.hasTrivialCopyConstructor()) {
+        return true;
+    }
+
+    for(const auto* ctor : record.ctors()) {
+        if(not ctor->isCopyConstructor()) {
+            continue;
+        }
+
+        if(const auto* proto = ctor->getType()->getAs<FunctionProtoType>();
+           proto and not isUnresolvedExceptionSpec(proto->getExceptionSpecType())) {
+            return proto->isNothrow();
+        }
+    }
+
+    auto isNothrow = [](QualType type) {
+        const auto* other = type->getBaseElementTypeUnsafe()->getAsCXXRecordDecl();
+
+        return not other or not other->hasDefinition() or IsNothrowCopyConstructible(*other);
+    };
+
+    for(const auto& base : record.bases()) {
+        if(not isNothrow(base.getType())) {
+            return false;
+        }
+    }
+
+    for(const auto* field : record.fields()) {
+        if(not isNothrow(field->getType())) {
+            return false;
+        }
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p record is a specialization of \c std::function.
+static bool IsStdFunction(const CXXRecordDecl* record)
+{
+    return record and record->isInStdNamespace() and record->getIdentifier() and (record->getName() == "function");
+}
+//-----------------------------------------------------------------------------
+
+std::optional<FunctionErasure> GetFunctionErasure(const CXXConstructExpr& expr)
+{
+    const auto* ctor = expr.getConstructor();
+
+    if(not IsStdFunction(ctor->getParent()) or ctor->isCopyOrMoveConstructor() or (1 != expr.getNumArgs())) {
+        return {};
+    }
+
+    auto&       ctx     = ctor->getASTContext();
+    const auto  argType = ctx.getDecayedType(expr.getArg(0)->getType().getNonReferenceType());
+
+    // Neither a std::function nor a nullptr gets erased.
+    if(argType->isDependentType() or argType->isNullPtrType() or argType->isIncompleteType() or
+       IsStdFunction(argType->getAsCXXRecordDecl())) {
+        return {};
+    }
+
+    const auto     pointerSize{static_cast<uint64_t>(ctx.getTypeSizeInChars(ctx.VoidPtrTy).getQuantity())};
+    const uint64_t size{static_cast<uint64_t>(ctx.getTypeSizeInChars(argType).getQuantity())};
+    const uint64_t align{static_cast<uint64_t>(ctx.getTypeAlignInChars(argType).getQuantity())};
+    const bool     isLibCpp{IsLibCpp(*ctor->getParent())};
+
+    // Both buffers leave two pointers to the callable: libstdc++ has a buffer of this size, libc++ one of three
+    // pointers where the first is the vptr of its wrapper.
+    FunctionErasure erasure{size, 2 * pointerSize, false, {}, isLibCpp ? "libc++" : "libstdc++"};
+
+    if(size > erasure.bufferSize) {
+        erasure.reason = StrCat("larger than the ", erasure.bufferSize, " bytes buffer");
+
+    } else if(align > erasure.bufferSize) {
+        erasure.reason = "over-aligned for the buffer";
+
+    } else if(isLibCpp) {
+        if(const auto* record = argType->getAsCXXRecordDecl(); record and not IsNothrowCopyConstructible(*record)) {
+            erasure.reason = "its copy constructor is not noexcept";
+        }
+
+    } else if(not argType.isTriviallyCopyableType(ctx)) {
+        erasure.reason = "not trivially copyable";
+    }
+
+    erasure.allocates = not erasure.reason.empty();
+
+    return erasure;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetFunctionErasureNote(const CXXConstructExpr& expr)
+{
+    const auto erasure = GetFunctionErasure(expr);
+
+    if(not erasure) {
+        return {};
+    }
+
+    const std::string storage = [&]() -> std::string {
+        if(erasure->allocates) {
+            return StrCat("allocated on the heap, ", erasure->reason);
+        }
+
+        return StrCat("stored in the ", erasure->bufferSize, " bytes buffer");
+    }();
+
+    return StrCat("type erasure (",
+                  erasure->library,
+                  "): ",
+                  erasure->callableSize,
+                  " bytes callable, ",
+                  storage,
+                  "; each call is an indirect call");
+}
+//-----------------------------------------------------------------------------
+
+std::string GetStringTemporaryNote(const Expr& temporary, const bool boundToParameter)
+{
+    const auto* construct = dyn_cast_or_null<CXXConstructExpr>(temporary.IgnoreImplicit());
+
+    if(not construct or (0 == construct->getNumArgs())) {
+        return {};
+    }
+
+    const auto* record = construct->getConstructor()->getParent();
+
+    if(not record->isInStdNamespace() or not record->getIdentifier() or (record->getName() != "basic_string")) {
+        return {};
+    }
+
+    const auto* literal = dyn_cast_or_null<StringLiteral>(construct->getArg(0)->IgnoreParenImpCasts());
+
+    if(not literal) {
+        return {};
+    }
+
+    const uint64_t capacity{GetStringSmallBufferCapacity(*record, literal->getCharByteWidth())};
+    const auto     storage = (literal->getLength() <= capacity) ? "fits into the small buffer of "
+                                                                : "allocates, longer than the small buffer of ";
+
+    return StrCat("temporary std::string from a literal of ",
+                  literal->getLength(),
+                  " characters, ",
+                  storage,
+                  capacity,
+                  " (",
+                  IsLibCpp(*record) ? "libc++" : "libstdc++",
+                  ")",
+                  boundToParameter ? "; a std::string_view parameter avoids it" : "");
+}
+//-----------------------------------------------------------------------------
+
+bool IsFunctionInvocation(const CXXOperatorCallExpr& call)
+{
+    if(OO_Call != call.getOperator()) {
+        return false;
+    }
+
+    const auto* method = dyn_cast_or_null<CXXMethodDecl>(call.getCalleeDecl());
+
+    return method and IsStdFunction(method->getParent());
+}
+//-----------------------------------------------------------------------------
+
+std::string GetAllocationNote(const CallExpr& expr)
+{
+    const auto* callee = expr.getDirectCallee();
+
+    if(not callee) {
+        return {};
+    }
+
+    if(const auto* body = dyn_cast_or_null<CoroutineBodyStmt>(callee->getBody()); body and body->getAllocate()) {
+        return StrCat("allocation: coroutine frame of ", GetName(*callee));
+    }
+
+    if(callee->isInStdNamespace() and callee->getIdentifier()) {
+        const auto name = callee->getName();
+
+        if((name == "make_shared") or (name == "allocate_shared") or (name == "make_unique") or
+           (name == "make_shared_for_overwrite") or (name == "make_unique_for_overwrite")) {
+            return StrCat("allocation: std::", name);
+        }
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_ALLOCATIONS_H
+#define INSIGHTS_ALLOCATIONS_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CallExpr;
+class CXXConstructExpr;
+class CXXNewExpr;
+class CXXOperatorCallExpr;
+class Decl;
+class Expr;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Whether \p decl comes from libc++, which puts the standard library into the inline namespace \c std::__1.
+bool IsLibCpp(const Decl& decl);
+//-----------------------------------------------------------------------------
+
+/// \brief The number of characters a \c std::basic_string of \p charSize bytes long characters stores without an
+/// allocation, for the standard library of \p decl.
+uint64_t GetStringSmallBufferCapacity(const Decl& decl, const uint64_t charSize);
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p name is one of the standard containers which allocate their elements on the heap.
+bool IsAllocatingContainer(llvm::StringRef name);
+//-----------------------------------------------------------------------------
+
+/// \brief The notes for the places which allocate on the heap, see \c --show-allocations.
+///
+/// A note starts with \c allocation if the heap is used for sure and with \c may \c allocate if it depends on values
+/// only known at runtime. An empty note means no allocation.
+std::string GetAllocationNote(const CXXNewExpr& expr);
+std::string GetAllocationNote(const CXXConstructExpr& expr);
+std::string GetAllocationNote(const CallExpr& expr);
+//-----------------------------------------------------------------------------
+
+/// \brief Where \c std::function stores a callable, see \c --show-function-erasure.
+struct FunctionErasure
+{
+    uint64_t    callableSize{};  //!< In bytes.
+    uint64_t    bufferSize{};    //!< The part of the small buffer a callable can use, in bytes.
+    bool        allocates{};
+    std::string reason{};   //!< Why the callable does not go into the small buffer, empty if it does.
+    const char* library{};  //!< The standard library whose rules apply.
+};
+
+/// \brief How the standard library of \p expr stores the callable \p expr constructs a \c std::function from.
+///
+/// libstdc++ keeps a callable in its buffer of two pointers only if it is trivially copyable. libc++ has a buffer of
+/// three pointers, which holds the vptr of its wrapper too, and keeps a callable only if its copy constructor is \c
+/// noexcept.
+///
+/// \returns Nothing, if \p expr is not such a construction, like a copy or a move of a \c std::function.
+std::optional<FunctionErasure> GetFunctionErasure(const CXXConstructExpr& expr);
+//-----------------------------------------------------------------------------
+
+/// \brief The note for a construction of a \c std::function from a callable, empty for any other \p expr.
+std::string GetFunctionErasureNote(const CXXConstructExpr& expr);
+//-----------------------------------------------------------------------------
+
+/// \brief The note for a temporary \c std::string created from a string literal, see \c --show-string-temporaries.
+///
+/// It tells the length of the literal against the small buffer of the standard library in use and so whether the
+/// temporary allocates. If it is \p boundToParameter, a \c std::string_view parameter is suggested instead.
+///
+/// \returns The note, empty if \p temporary is not such a temporary.
+std::string GetStringTemporaryNote(const Expr& temporary, const bool boundToParameter);
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p call invokes a \c std::function, which is an indirect call.
+bool IsFunctionInvocation(const CXXOperatorCallExpr& call);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_ALLOCATIONS_H */
@@ -0,0 +1,84 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include <algorithm>
+#include <vector>
+
+#include "InsightsArena.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The number of buffers kept for reuse, deeper nesting than this is rare.
+static constexpr size_t MAX_SCRATCH_BUFFERS{64};
+
+/// \brief Larger buffers are not kept, usually they hold the code of an entire top-level declaration.
+static constexpr size_t MAX_SCRATCH_CAPACITY{64 * 1024};
+//-----------------------------------------------------------------------------
+
+static thread_local llvm::BumpPtrAllocator   gArena{};           // NOLINT
+static thread_local std::vector<std::string> gScratchBuffers{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+llvm::BumpPtrAllocator& GetArena()
+{
+    return gArena;
+}
+//-----------------------------------------------------------------------------
+
+llvm::StringRef SaveInArena(llvm::StringRef str)
+{
+    if(str.empty()) {
+        return {};
+    }
+
+    char* data = gArena.Allocate<char>(str.size());
+    std::copy(str.begin(), str.end(), data);
+
+    return {data, str.size()};
+}
+//-----------------------------------------------------------------------------
+
+void ResetArena()
+{
+    gArena.Reset();
+}
+//-----------------------------------------------------------------------------
+
+std::string GetScratchBuffer()
+{
+    if(gScratchBuffers.empty()) {
+        return {};
+    }
+
+    std::string buffer{std::move(gScratchBuffers.back())};
+    gScratchBuffers.pop_back();
+
+    return buffer;
+}
+//-----------------------------------------------------------------------------
+
+void ReturnScratchBuffer(std::string&& buffer)
+{
+    // A buffer without heap memory, like a moved from one, has nothing worth keeping.
+    if((std::string{}.capacity() >= buffer.capacity()) or (MAX_SCRATCH_CAPACITY < buffer.capacity()) or
+       (MAX_SCRATCH_BUFFERS <= gScratchBuffers.size())) {
+        return;
+    }
+
+    buffer.clear();
+    gScratchBuffers.push_back(std::move(buffer));
+}
+//-----------------------------------------------------------------------------
+
+void ReleaseScratchBuffers()
+{
+    std::vector<std::string>{}.swap(gScratchBuffers);
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
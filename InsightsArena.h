@@ -0,0 +1,48 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_ARENA_H
+#define INSIGHTS_ARENA_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The arena for the scratch data of the code generation of one translation unit.
+///
+/// There is one arena per thread, as each thread processes its own translation unit. It is released in one shot by
+/// \ref ResetArena when the next translation unit starts. The first slab is kept, so the next request in server or
+/// batch mode starts without going back to malloc.
+llvm::BumpPtrAllocator& GetArena();
+
+/// \brief Copy \p str into the arena, the result lives until the next \ref ResetArena.
+llvm::StringRef SaveInArena(llvm::StringRef str);
+
+/// \brief Release everything in the arena of the current thread.
+void ResetArena();
+//-----------------------------------------------------------------------------
+
+/// \brief Get an empty buffer for a short-lived \ref OutputFormatHelper.
+///
+/// The buffers handed back with \ref ReturnScratchBuffer are reused together with their capacity, which saves most of
+/// the allocations of the many nested \ref OutputFormatHelper objects.
+std::string GetScratchBuffer();
+
+/// \brief Hand \p buffer back for reuse by \ref GetScratchBuffer.
+void ReturnScratchBuffer(std::string&& buffer);
+
+/// \brief Free the buffers kept for reuse by the current thread.
+void ReleaseScratchBuffers();
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_ARENA_H */
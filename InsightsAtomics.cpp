@@ -0,0 +1,228 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/Basic/TargetInfo.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
+#include "Insights.h"
+#include "InsightsAtomics.h"
+#include "InsightsHelpers.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The \c T of \p type, if it is a <tt>std::atomic<T></tt>. The operations of the integral and pointer types are
+/// members of base classes, only the type of the object tells that it is a \c std::atomic.
+static QualType GetAtomicValueType(const QualType& type)
+{
+    const auto* record = dyn_cast_or_null<ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+
+    if(not record or not record->isInStdNamespace() or not record->getIdentifier() or ("atomic" != record->getName())) {
+        return {};
+    }
+
+    if(const auto& args = record->getTemplateArgs(); (1 == args.size()) and (TemplateArgument::Type == args[0].getKind())) {
+        return args[0].getAsType();
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The argument \p index of \p call, \c nullptr if there is none or it is a default argument.
+static const Expr* GetWrittenArg(const CallExpr& call, const unsigned index)
+{
+    if(index < call.getNumArgs()) {
+        if(const auto* arg = call.getArg(index); not isa<CXXDefaultArgExpr>(arg)) {
+            return arg;
+        }
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The builtin name of the arithmetic or bitwise operation \p op, like \c add, of an \c std::atomic.
+static std::string GetFetchBuiltin(const StringRef op, const bool fetchFirst)
+{
+    return fetchFirst ? StrCat("__atomic_fetch_", op) : StrCat("__atomic_", op, "_fetch");
+}
+//-----------------------------------------------------------------------------
+
+static llvm::Optional<AtomicOperation> GetAtomicMemberOperation(const CXXMemberCallExpr& call)
+{
+    const auto* method     = call.getMethodDecl();
+    const auto* memberExpr = dyn_cast_or_null<MemberExpr>(call.getCallee()->IgnoreParens());
+
+    if(not method or not memberExpr) {
+        return {};
+    }
+
+    const auto* object  = call.getImplicitObjectArgument();
+    const bool  isArrow = memberExpr->isArrow();
+    const auto  type    = isArrow ? object->getType()->getPointeeType() : object->getType();
+
+    AtomicOperation op{{}, object, isArrow, GetAtomicValueType(type), nullptr, nullptr, false, nullptr, nullptr};
+
+    if(op.valueType.isNull()) {
+        return {};
+    }
+
+    // The conversion to T is an implicit load.
+    if(isa<CXXConversionDecl>(method)) {
+        op.builtin = "__atomic_load_n";
+        return op;
+    }
+
+    if(not method->getIdentifier()) {
+        return {};
+    }
+
+    const auto name = method->getName();
+
+    if("load" == name) {
+        op.builtin = "__atomic_load_n";
+        op.order   = GetWrittenArg(call, 0);
+
+    } else if(("store" == name) or ("exchange" == name)) {
+        op.builtin = StrCat("__atomic_", name, "_n");
+        op.operand = call.getArg(0);
+        op.order   = GetWrittenArg(call, 1);
+
+    } else if(("compare_exchange_weak" == name) or ("compare_exchange_strong" == name)) {
+        op.builtin      = "__atomic_compare_exchange_n";
+        op.expected     = call.getArg(0);
+        op.operand      = call.getArg(1);
+        op.weak         = ("compare_exchange_weak" == name);
+        op.order        = GetWrittenArg(call, 2);
+        op.failureOrder = GetWrittenArg(call, 3);
+
+    } else if(name.consume_front("fetch_") and
+              (("add" == name) or ("sub" == name) or ("and" == name) or ("or" == name) or ("xor" == name))) {
+        op.builtin = GetFetchBuiltin(name, true);
+        op.operand = call.getArg(0);
+        op.order   = GetWrittenArg(call, 1);
+
+    } else {
+        return {};
+    }
+
+    return op;
+}
+//-----------------------------------------------------------------------------
+
+static llvm::Optional<AtomicOperation> GetAtomicOperatorOperation(const CXXOperatorCallExpr& call)
+{
+    if(0 == call.getNumArgs()) {
+        return {};
+    }
+
+    const auto* object = call.getArg(0);
+
+    AtomicOperation op{
+        {}, object, false, GetAtomicValueType(object->getType()), nullptr, nullptr, false, nullptr, nullptr};
+
+    if(op.valueType.isNull()) {
+        return {};
+    }
+
+    // The postfix operators have a second, unused, int argument.
+    const bool isPostfix{2 == call.getNumArgs()};
+
+    switch(call.getOperator()) {
+        case OO_PlusPlus: op.builtin = GetFetchBuiltin("add", isPostfix); break;
+        case OO_MinusMinus: op.builtin = GetFetchBuiltin("sub", isPostfix); break;
+        case OO_PlusEqual: op.builtin = GetFetchBuiltin("add", false); break;
+        case OO_MinusEqual: op.builtin = GetFetchBuiltin("sub", false); break;
+        case OO_AmpEqual: op.builtin = GetFetchBuiltin("and", false); break;
+        case OO_PipeEqual: op.builtin = GetFetchBuiltin("or", false); break;
+        case OO_CaretEqual: op.builtin = GetFetchBuiltin("xor", false); break;
+        case OO_Equal: op.builtin = "__atomic_store_n"; break;
+        default: return {};
+    }
+
+    if((OO_PlusPlus != call.getOperator()) and (OO_MinusMinus != call.getOperator())) {
+        op.operand = call.getArg(1);
+    }
+
+    return op;
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<AtomicOperation> GetAtomicOperation(const CallExpr& call)
+{
+    if(const auto* memberCall = dyn_cast_or_null<CXXMemberCallExpr>(&call)) {
+        return GetAtomicMemberOperation(*memberCall);
+
+    } else if(const auto* operatorCall = dyn_cast_or_null<CXXOperatorCallExpr>(&call)) {
+        return GetAtomicOperatorOperation(*operatorCall);
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+bool HasAtomicBuiltin(const AtomicOperation& op)
+{
+    return op.valueType->isIntegralOrEnumerationType() or op.valueType->isPointerType();
+}
+//-----------------------------------------------------------------------------
+
+std::string GetAtomicMemoryOrder(const Expr* order)
+{
+    if(nullptr == order) {
+        return "__ATOMIC_SEQ_CST";
+    }
+
+    // The enumerators of std::memory_order have the values of the macros.
+    if(Expr::EvalResult result{}; order->EvaluateAsRValue(result, GetGlobalAST()) and result.Val.isInt()) {
+        switch(result.Val.getInt().getExtValue()) {
+            case 0: return "__ATOMIC_RELAXED";
+            case 1: return "__ATOMIC_CONSUME";
+            case 2: return "__ATOMIC_ACQUIRE";
+            case 3: return "__ATOMIC_RELEASE";
+            case 4: return "__ATOMIC_ACQ_REL";
+            case 5: return "__ATOMIC_SEQ_CST";
+        }
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+std::string GetAtomicFailureOrder(const std::string& successOrder)
+{
+    // A failed compare-exchange only loads, it cannot have a release part.
+    if("__ATOMIC_ACQ_REL" == successOrder) {
+        return "__ATOMIC_ACQUIRE";
+    } else if("__ATOMIC_RELEASE" == successOrder) {
+        return "__ATOMIC_RELAXED";
+    }
+
+    return successOrder;
+}
+//-----------------------------------------------------------------------------
+
+bool IsAtomicLockFree(const QualType& valueType)
+{
+    const auto& ctx  = GetGlobalAST();
+    const auto  size = ctx.getTypeSize(valueType);
+
+    // std::atomic aligns a T of a power of two size to its size, like the builtin __atomic_is_lock_free expects it.
+    const auto align = llvm::isPowerOf2_64(size) ? std::max<uint64_t>(size, ctx.getTypeAlign(valueType))
+                                                 : ctx.getTypeAlign(valueType);
+
+    return ctx.getTargetInfo().hasBuiltinAtomic(size, align);
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
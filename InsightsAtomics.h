@@ -0,0 +1,55 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_ATOMICS_H
+#define INSIGHTS_ATOMICS_H
+
+#include "clang/AST/ExprCXX.h"
+#include "llvm/ADT/Optional.h"
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief An operation on a \c std::atomic together with the \c __atomic builtin which implements it, see \c
+/// --show-atomics.
+struct AtomicOperation
+{
+    std::string builtin;       //!< The builtin, like \c __atomic_fetch_add.
+    const Expr* object;        //!< The atomic object, a pointer to it if \c isArrow.
+    bool        isArrow;       //!< Whether \c object is a pointer.
+    QualType    valueType;     //!< The \c T of <tt>std::atomic<T></tt>.
+    const Expr* operand;       //!< The value to store or to combine with, \c nullptr for a load and for \c ++ and \c --.
+    const Expr* expected;      //!< The expected value of a compare-exchange, otherwise \c nullptr.
+    bool        weak;          //!< Whether a compare-exchange may fail spuriously.
+    const Expr* order;         //!< The memory order as written, \c nullptr if it is the default \c seq_cst.
+    const Expr* failureOrder;  //!< The failure order of a compare-exchange, \c nullptr to derive it from \c order.
+};
+
+/// \brief The operation \p call performs, if it is one on a \c std::atomic.
+llvm::Optional<AtomicOperation> GetAtomicOperation(const CallExpr& call);
+
+/// \brief Whether the builtin of \p op can be called with the object itself. This is the case for the integral and
+/// pointer types, the other ones go through a temporary and stay as written.
+bool HasAtomicBuiltin(const AtomicOperation& op);
+
+/// \brief The \c __ATOMIC macro of the memory order \p order, \c __ATOMIC_SEQ_CST for \c nullptr. Empty if \p order is
+/// no constant.
+std::string GetAtomicMemoryOrder(const Expr* order);
+
+/// \brief The failure order of a compare-exchange with only the success order \p successOrder, as the library derives
+/// it.
+std::string GetAtomicFailureOrder(const std::string& successOrder);
+
+/// \brief Whether the target implements a <tt>std::atomic<T></tt> of \p valueType without a lock.
+bool IsAtomicLockFree(const QualType& valueType);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_ATOMICS_H */
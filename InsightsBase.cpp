@@ -5,17 +5,131 @@
  *
  ****************************************************************************/
 
-#include "clang/Rewrite/Core/Rewriter.h"
+#include <atomic>
 
+#include "CodeGenerator.h"
+#include "Insights.h"
 #include "InsightsBase.h"
+#include "InsightsCodegenShards.h"
+#include "InsightsDeclCache.h"
+#include "InsightsMemoryLimit.h"
+#include "InsightsOutputSink.h"
 #include "OutputFormatHelper.h"
 //-----------------------------------------------------------------------------
 
 namespace clang::insights {
 
+static std::atomic<uint64_t> gDuplicateMatches{};
+//-----------------------------------------------------------------------------
+
+DuplicateStats GetDuplicateStats()
+{
+    return {gDuplicateMatches};
+}
+//-----------------------------------------------------------------------------
+
 void InsightsBase::InsertIndentedText(SourceLocation loc, OutputFormatHelper& outputFormatHelper)
 {
-    mRewrite.InsertText(loc, outputFormatHelper.GetString(), true, true);
+    auto marks = outputFormatHelper.TakeSourceMarks();
+
+    mOutputSink.InsertText(
+        loc, std::move(outputFormatHelper.GetString()), OutputSink::IndentNewLines::Yes, mName, std::move(marks));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the code of a declaration depends on or adds to the state of the entire translation unit.
+///
+/// The tables of \c --show-allocations and \c --show-global-init are filled while the declarations are generated, the
+/// global init functions are numbered in the order of the translation unit and the notes of \c --show-pass-by-value
+/// count the copies at all call sites. The key of the declaration cache covers none of it.
+static bool UsesTranslationUnitState()
+{
+    const auto& options = GetInsightsOptions();
+
+    return options.ShowAllocations or options.ShowGlobalInit or options.ShowPassByValue;
+}
+//-----------------------------------------------------------------------------
+
+void InsightsBase::GenerateCached(const Decl&                decl,
+                                  OutputFormatHelper&        outputFormatHelper,
+                                  llvm::function_ref<void()> generate)
+{
+    if(not IsDeclCacheEnabled() or UsesTranslationUnitState()) {
+        generate();
+        return;
+    }
+
+    const auto key = GetDeclCacheKey(decl);
+
+    if(const auto cached = LookupCachedDecl(key)) {
+        // The cached text has no marks of its own, all of it maps to the declaration.
+        outputFormatHelper.MarkSource(decl.getBeginLoc());
+        outputFormatHelper.Append(cached->text);
+
+        if(cached->needsNewHeader) {
+            CodeGenerator::RequireNewHeader();
+        }
+
+        mOutputSink.AddDeclSegment(decl.getSourceRange(), key);
+
+        return;
+    }
+
+    // Find out whether this declaration on its own requires the <new> header, the entry must carry that. The rest of
+    // the state of the translation unit stays as it is.
+    const bool neededNewHeader{CodeGenerator::TakeNewHeaderRequirement()};
+
+    generate();
+
+    const bool needsNewHeader{CodeGenerator::NeedToInsertNewHeader()};
+
+    if(neededNewHeader) {
+        CodeGenerator::RequireNewHeader();
+    }
+
+    // Code which stopped at the deadline is incomplete, the key must not stand for it.
+    if(IsDeadlineExceeded()) {
+        return;
+    }
+
+    mOutputSink.AddDeclSegment(decl.getSourceRange(), key);
+
+    // In the degraded mode nothing new gets cached.
+    if(not IsMemoryDegraded()) {
+        StoreCachedDecl(key, {outputFormatHelper.GetString(), needsNewHeader});
+    }
+}
+//-----------------------------------------------------------------------------
+
+void InsightsBase::ReplaceText(SourceRange range, OutputFormatHelper& outputFormatHelper)
+{
+    auto marks = outputFormatHelper.TakeSourceMarks();
+
+    mOutputSink.ReplaceText(range, std::move(outputFormatHelper.GetString()), mName, std::move(marks));
+}
+//-----------------------------------------------------------------------------
+
+bool InsightsBase::MarkGenerated(const void* node)
+{
+    // With --codegen-jobs another thread may be responsible for this one.
+    return MarkFirstMatch(node) and TakeGenerationUnit();
+}
+//-----------------------------------------------------------------------------
+
+bool InsightsBase::MarkFirstMatch(const void* node)
+{
+    // Past the deadline the matches are left as they are.
+    if(IsDeadlineExceeded()) {
+        return false;
+    }
+
+    if(mMap.emplace(reinterpret_cast<intptr_t>(node), true).second) {
+        return true;
+    }
+
+    ++gDuplicateMatches;
+
+    return false;
 }
 //-----------------------------------------------------------------------------
 
@@ -9,38 +9,99 @@
 #define INSIGHTS_BASE_H
 //-----------------------------------------------------------------------------
 
+#include "clang/ASTMatchers/ASTMatchFinder.h"  // for MatchFinder, DynTypedMatcher
+#include "llvm/ADT/STLExtras.h"                 // for function_ref
+
+#include <memory>         // for unique_ptr
 #include <stdint.h>       // for intptr_t
 #include <unordered_map>  // for unordered_map
+#include <vector>         // for vector
+
+#include "InsightsMatcherProfile.h"
 namespace clang {
-class Rewriter;
-}
-namespace clang {
+class Decl;
 class SourceLocation;
+class SourceRange;
 }
 namespace clang {
 namespace insights {
 class OutputFormatHelper;
+class OutputSink;
 }
 }  // namespace clang
 //-----------------------------------------------------------------------------
 
 namespace clang::insights {
+
+/// \brief Number of duplicate matches the handlers skipped, see \c --stats.
+struct DuplicateStats
+{
+    uint64_t matches;
+};
+
+DuplicateStats GetDuplicateStats();
+//-----------------------------------------------------------------------------
+
 class InsightsBase
 {
 protected:
-    Rewriter& mRewrite;
+    OutputSink& mOutputSink;
 
-    explicit InsightsBase(Rewriter& rewriter)
-    : mRewrite{rewriter}
+    /// \param name The name of the handler, the sink records it with every edit the handler makes.
+    InsightsBase(OutputSink& outputSink, const char* name)
+    : mOutputSink{outputSink}
+    , mName{name}
     , mMap{}
+    , mProfiledCallbacks{}
     {
     }
 
 protected:
     void InsertIndentedText(SourceLocation loc, OutputFormatHelper& outputFormatHelper);
 
+    /// \brief Let \p generate write the code for the top-level declaration \p decl to \p outputFormatHelper, or take
+    /// the code of an earlier run from the declaration cache, see \c --decl-cache-size.
+    void GenerateCached(const Decl& decl, OutputFormatHelper& outputFormatHelper, llvm::function_ref<void()> generate);
+
+    /// \brief Replace \p range with the code in \p outputFormatHelper, the buffer is handed over to the sink.
+    void ReplaceText(SourceRange range, OutputFormatHelper& outputFormatHelper);
+
+    /// \brief Register \p nodeMatcher for \p callback.
+    ///
+    /// With \c --profile-matchers each matcher gets a \ref ProfiledMatchCallback of its own.
+    template<typename T>
+    void AddMatcher(ast_matchers::MatchFinder&                finder,
+                    const T&                                  nodeMatcher,
+                    ast_matchers::MatchFinder::MatchCallback* callback)
+    {
+        if(IsMatcherProfilingEnabled()) {
+            const ast_matchers::internal::DynTypedMatcher dynMatcher{nodeMatcher};
+
+            // The matchers are numbered from 1 in the order the handler registers them.
+            callback = mProfiledCallbacks
+                           .emplace_back(std::make_unique<ProfiledMatchCallback>(
+                               *callback, mProfiledCallbacks.size() + 1, dynMatcher.getSupportedKind().asStringRef()))
+                           .get();
+        }
+
+        finder.addMatcher(nodeMatcher, callback);
+    }
+
+    /// \brief Note that code for \p node gets generated by this handler.
+    ///
+    /// \returns \c false, if this handler already generated code for \p node. Generating it twice would edit the same
+    /// source range twice. Also \c false, if another shard generates the code for \p node, see \ref SetCodegenShard.
+    bool MarkGenerated(const void* node);
+
+    /// \brief The first half of \ref MarkGenerated, without the check for the shard.
+    ///
+    /// Handlers which must see every new node in all shards use this and call \ref TakeGenerationUnit themselves.
+    bool MarkFirstMatch(const void* node);
+
 private:
-    std::unordered_map<intptr_t, bool> mMap;
+    const char*                                         mName;
+    std::unordered_map<intptr_t, bool>                  mMap;  //!< The nodes this handler generated.
+    std::vector<std::unique_ptr<ProfiledMatchCallback>> mProfiledCallbacks;
 };
 //-----------------------------------------------------------------------------
 
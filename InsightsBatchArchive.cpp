@@ -0,0 +1,196 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+
+#include "ClangCompat.h"
+#include "DPrint.h"
+#include "InsightsBatchArchive.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static constexpr llvm::StringLiteral ARCHIVE_MAGIC{"INSARC01"};
+static constexpr llvm::StringLiteral RESULT_MAGIC{"INSRES01"};
+static constexpr uint64_t            HEADER_SIZE{16};      //!< The magic and the number of entries.
+static constexpr uint64_t            INDEX_ENTRY_SIZE{32};  //!< Offset and length of the source and the arguments.
+static constexpr uint64_t            RESULT_INDEX_FIELDS{5};
+//-----------------------------------------------------------------------------
+
+static uint64_t Read64(llvm::StringRef data, const uint64_t offset)
+{
+    return llvm::support::endian::read64le(data.data() + offset);
+}
+//-----------------------------------------------------------------------------
+
+static void Append64(std::string& data, const uint64_t value)
+{
+    char bytes[sizeof(value)]{};
+    llvm::support::endian::write64le(bytes, value);
+
+    data.append(bytes, sizeof(bytes));
+}
+//-----------------------------------------------------------------------------
+
+std::unique_ptr<BatchArchive> BatchArchive::Open(llvm::StringRef fileName, std::string& error)
+{
+    // Without a null terminator the file is mapped instead of read, even if it is large.
+#if IS_CLANG_NEWER_THAN(12)
+    auto buffer = llvm::MemoryBuffer::getFile(fileName, /*IsText*/ false, /*RequiresNullTerminator*/ false);
+#else
+    auto buffer = llvm::MemoryBuffer::getFile(fileName, /*FileSize*/ -1, /*RequiresNullTerminator*/ false);
+#endif
+
+    if(not buffer) {
+        error = StrCat("cannot read batch archive '", fileName, "': ", buffer.getError().message());
+        return nullptr;
+    }
+
+    const auto data = (*buffer)->getBuffer();
+
+    if((HEADER_SIZE > data.size()) or not data.startswith(ARCHIVE_MAGIC)) {
+        error = StrCat("'", fileName, "' is no batch archive");
+        return nullptr;
+    }
+
+    // The index has to fit into the file, compared without an overflow.
+    const auto entries = Read64(data, ARCHIVE_MAGIC.size());
+
+    if(entries > ((data.size() - HEADER_SIZE) / INDEX_ENTRY_SIZE)) {
+        error = StrCat("the index of '", fileName, "' is truncated");
+        return nullptr;
+    }
+
+    return std::unique_ptr<BatchArchive>{new BatchArchive{std::move(*buffer), entries}};
+}
+//-----------------------------------------------------------------------------
+
+std::string
+BatchArchive::GetEntry(const uint64_t index, std::string_view& source, std::vector<std::string>& arguments) const
+{
+    const auto data   = mBuffer->getBuffer();
+    const auto entry  = HEADER_SIZE + (index * INDEX_ENTRY_SIZE);
+    const auto inFile = [&](const uint64_t offset, const uint64_t length) {
+        return (offset <= data.size()) and (length <= (data.size() - offset));
+    };
+
+    const auto sourceOffset    = Read64(data, entry);
+    const auto sourceLength    = Read64(data, entry + 8);
+    const auto argumentsOffset = Read64(data, entry + 16);
+    const auto argumentsLength = Read64(data, entry + 24);
+
+    // The '\0' behind the source is part of the file.
+    if(not inFile(sourceOffset, sourceLength) or (sourceLength == (data.size() - sourceOffset)) or
+       ('\0' != data[sourceOffset + sourceLength])) {
+        return StrCat("entry ", index, ": the source is out of bounds or not followed by '\\0'");
+    }
+
+    if(not inFile(argumentsOffset, argumentsLength) or
+       ((0 != argumentsLength) and ('\0' != data[argumentsOffset + argumentsLength - 1]))) {
+        return StrCat("entry ", index, ": the arguments are out of bounds or not terminated by '\\0'");
+    }
+
+    source = std::string_view{data.data() + sourceOffset, sourceLength};
+
+    llvm::SmallVector<llvm::StringRef, 8> parts{};
+    data.substr(argumentsOffset, argumentsLength).split(parts, '\0', -1, false);
+
+    for(const auto& part : parts) {
+        arguments.push_back(part.str());
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+BatchResultArchive::BatchResultArchive(std::unique_ptr<llvm::raw_fd_ostream> out, const uint64_t entries)
+: mOut{std::move(out)}
+, mIndex(entries * RESULT_INDEX_FIELDS)
+, mOffset{RESULT_MAGIC.size()}
+{
+    // An entry without a result failed.
+    for(uint64_t i = 0; i < entries; ++i) {
+        mIndex[i * RESULT_INDEX_FIELDS] = 1;
+    }
+}
+//-----------------------------------------------------------------------------
+
+std::unique_ptr<BatchResultArchive>
+BatchResultArchive::Create(llvm::StringRef fileName, const uint64_t entries, std::string& error)
+{
+    std::error_code ec{};
+    auto            out = std::make_unique<llvm::raw_fd_ostream>(fileName, ec, llvm::sys::fs::OF_None);
+
+    if(ec) {
+        error = StrCat("cannot write batch results '", fileName, "': ", ec.message());
+        return nullptr;
+    }
+
+    *out << RESULT_MAGIC;
+
+    return std::unique_ptr<BatchResultArchive>{new BatchResultArchive{std::move(out), entries}};
+}
+//-----------------------------------------------------------------------------
+
+bool BatchResultArchive::CheckStream()
+{
+    if(not mOut->has_error()) {
+        return true;
+    }
+
+    Error("cannot write batch results: %s\n", mOut->error().message());
+    mOut->clear_error();
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+bool BatchResultArchive::Write(const uint64_t  index,
+                               const int       returnCode,
+                               llvm::StringRef output,
+                               llvm::StringRef diagnostics)
+{
+    std::lock_guard lock{mMutex};
+
+    auto* entry = &mIndex[index * RESULT_INDEX_FIELDS];
+    entry[0]    = static_cast<uint64_t>(static_cast<int64_t>(returnCode));
+    entry[1]    = mOffset;
+    entry[2]    = output.size();
+    entry[3]    = mOffset + output.size();
+    entry[4]    = diagnostics.size();
+
+    *mOut << output << diagnostics;
+    mOffset += output.size() + diagnostics.size();
+
+    return CheckStream();
+}
+//-----------------------------------------------------------------------------
+
+bool BatchResultArchive::Close()
+{
+    std::lock_guard lock{mMutex};
+
+    std::string index{};
+    index.reserve((mIndex.size() + 2) * sizeof(uint64_t));
+
+    for(const auto value : mIndex) {
+        Append64(index, value);
+    }
+
+    Append64(index, mIndex.size() / RESULT_INDEX_FIELDS);
+    Append64(index, mOffset);
+
+    *mOut << index;
+    mOut->close();
+
+    return CheckStream();
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
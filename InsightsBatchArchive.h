@@ -0,0 +1,94 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_BATCH_ARCHIVE_H
+#define INSIGHTS_BATCH_ARCHIVE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief A memory-mapped archive of sources for \c --batch-archive.
+///
+/// All numbers are 64-bit little endian. The archive starts with the magic \c INSARC01 and the number of entries,
+/// followed by the index: for each entry the offset and the length of its source and of its arguments. The data the
+/// index refers to follows. Each source is followed by a '\0', which does not count for its length, so that the lexer
+/// can use it in place. The arguments are the ones of a \ref ServerRequest, each followed by a '\0'.
+class BatchArchive
+{
+public:
+    /// \returns \c nullptr and the reason in \p error, if \p fileName cannot be read or is no archive.
+    static std::unique_ptr<BatchArchive> Open(llvm::StringRef fileName, std::string& error);
+
+    uint64_t size() const { return mEntries; }
+
+    /// \brief The source and the arguments of the entry \p index. \p source refers to the mapped archive.
+    ///
+    /// \returns An error message, if the entry is malformed.
+    std::string GetEntry(const uint64_t index, std::string_view& source, std::vector<std::string>& arguments) const;
+
+private:
+    explicit BatchArchive(std::unique_ptr<llvm::MemoryBuffer> buffer, const uint64_t entries)
+    : mBuffer{std::move(buffer)}
+    , mEntries{entries}
+    {
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> mBuffer;
+    uint64_t                            mEntries;
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The results of a \ref BatchArchive, written while the entries are transformed.
+///
+/// The archive starts with the magic \c INSRES01, followed by the output and the diagnostics of the entries in the
+/// order they finished. The index comes at the end, in the order of the entries: for each the return code, the offset
+/// and the length of the output and of the diagnostics. The last 16 bytes are the number of entries and the offset of
+/// the index. All numbers are 64-bit little endian.
+class BatchResultArchive
+{
+public:
+    /// \returns \c nullptr and the reason in \p error, if \p fileName cannot be created.
+    static std::unique_ptr<BatchResultArchive>
+    Create(llvm::StringRef fileName, const uint64_t entries, std::string& error);
+
+    /// \brief Append the result of the entry \p index, it can be called from several threads.
+    ///
+    /// \returns \c false, if the archive could not be written.
+    bool Write(const uint64_t index, const int returnCode, llvm::StringRef output, llvm::StringRef diagnostics);
+
+    /// \brief Write the index, entries without a result have an empty output and diagnostics and the return code 1.
+    ///
+    /// \returns \c false, if the archive could not be written.
+    bool Close();
+
+private:
+    BatchResultArchive(std::unique_ptr<llvm::raw_fd_ostream> out, const uint64_t entries);
+
+    /// \brief Report and clear an error of the stream, the stream must not be destroyed with one.
+    bool CheckStream();
+
+    std::mutex                            mMutex{};
+    std::unique_ptr<llvm::raw_fd_ostream> mOut;
+    std::vector<uint64_t>                 mIndex;
+    uint64_t                              mOffset{};
+};
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_BATCH_ARCHIVE_H */
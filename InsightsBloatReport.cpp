@@ -0,0 +1,183 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "clang/AST/DeclCXX.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "InsightsBloatReport.h"
+#include "InsightsHelpers.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief The distinct values of one argument of a template.
+struct ArgumentValues
+{
+    llvm::StringSet<> values{};
+    uint64_t          lambdas{};  //!< How many of the distinct values are closure types.
+};
+//-----------------------------------------------------------------------------
+
+struct TemplateBloat
+{
+    uint64_t                    instantiations{};
+    uint64_t                    lines{};
+    uint64_t                    bytes{};
+    std::vector<ArgumentValues> arguments{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static bool                           gBloatReportEnabled{};
+static std::mutex                     gBloatMutex{};
+static llvm::StringMap<TemplateBloat> gTemplates{};
+//-----------------------------------------------------------------------------
+
+void EnableBloatReport()
+{
+    gBloatReportEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsBloatReportEnabled()
+{
+    return gBloatReportEnabled;
+}
+//-----------------------------------------------------------------------------
+
+static bool IsLambda(const TemplateArgument& arg)
+{
+    if(TemplateArgument::Type != arg.getKind()) {
+        return false;
+    }
+
+    const auto* record = arg.getAsType()->getAsCXXRecordDecl();
+
+    return record and record->isLambda();
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetArgumentValue(const NamedDecl& primary, const TemplateArgument& arg)
+{
+    if(TemplateArgument::Type == arg.getKind()) {
+        return GetName(arg.getAsType());
+    }
+
+    StringStream sstream{};
+    arg.print(primary.getASTContext().getPrintingPolicy(), sstream);
+
+    return sstream.str();
+}
+//-----------------------------------------------------------------------------
+
+void RecordInstantiation(const NamedDecl& primary, llvm::ArrayRef<TemplateArgument> args)
+{
+    // The strings are built outside of the lock, with --codegen-jobs the shards call this concurrently.
+    std::vector<std::pair<std::string, bool>> values{};
+
+    for(const auto& arg : args) {
+        values.emplace_back(GetArgumentValue(primary, arg), IsLambda(arg));
+    }
+
+    const std::string name{GetName(primary)};
+
+    std::lock_guard lock{gBloatMutex};
+    auto&           bloat = gTemplates[name];
+
+    ++bloat.instantiations;
+
+    if(bloat.arguments.size() < values.size()) {
+        bloat.arguments.resize(values.size());
+    }
+
+    for(size_t i = 0; i < values.size(); ++i) {
+        auto& argument = bloat.arguments[i];
+
+        if(argument.values.insert(values[i].first).second and values[i].second) {
+            ++argument.lambdas;
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+void RecordGeneratedCode(const NamedDecl& primary, StringRef code)
+{
+    const std::string name{GetName(primary)};
+
+    std::lock_guard lock{gBloatMutex};
+    auto&           bloat = gTemplates[name];
+
+    bloat.lines += code.count('\n');
+    bloat.bytes += code.size();
+}
+//-----------------------------------------------------------------------------
+
+void PrintBloatReport(llvm::raw_ostream& ostream)
+{
+    std::lock_guard lock{gBloatMutex};
+
+    std::vector<const llvm::StringMapEntry<TemplateBloat>*> templates{};
+
+    for(const auto& entry : gTemplates) {
+        templates.push_back(&entry);
+    }
+
+    std::stable_sort(templates.begin(), templates.end(), [](const auto* a, const auto* b) {
+        if(a->second.bytes != b->second.bytes) {
+            return a->second.bytes > b->second.bytes;
+        }
+
+        return a->first() < b->first();
+    });
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                      C++ Insights template bloat report\n"
+            << "===-------------------------------------------------------------------------===\n"
+            << llvm::format("  %-40s %14s %8s %10s\n", "Template", "Instantiations", "Lines", "Bytes");
+
+    for(const auto* entry : templates) {
+        const auto& bloat = entry->second;
+
+        ostream << llvm::format("  %-40s %14llu %8llu %10llu\n",
+                                entry->first().str().c_str(),
+                                static_cast<unsigned long long>(bloat.instantiations),
+                                static_cast<unsigned long long>(bloat.lines),
+                                static_cast<unsigned long long>(bloat.bytes));
+
+        // The argument which varies the most is the one to look at, a single value does not add instantiations.
+        const auto mostDistinct =
+            std::max_element(bloat.arguments.begin(), bloat.arguments.end(), [](const auto& a, const auto& b) {
+                return a.values.size() < b.values.size();
+            });
+
+        if((bloat.arguments.end() == mostDistinct) or (2 > mostDistinct->values.size())) {
+            continue;
+        }
+
+        ostream << llvm::format("    argument %zu: %u distinct values",
+                                static_cast<size_t>(std::distance(bloat.arguments.begin(), mostDistinct) + 1),
+                                mostDistinct->values.size());
+
+        if(mostDistinct->lambdas) {
+            ostream << llvm::format(", %llu of them lambdas", static_cast<unsigned long long>(mostDistinct->lambdas));
+        }
+
+        ostream << '\n';
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,44 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_BLOAT_REPORT_H
+#define INSIGHTS_BLOAT_REPORT_H
+
+#include "clang/AST/TemplateBase.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class NamedDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+void EnableBloatReport();
+bool IsBloatReportEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Record one instantiation of the primary template \p primary with the arguments \p args, see \ref
+/// TemplateHandler.
+void RecordInstantiation(const NamedDecl& primary, llvm::ArrayRef<TemplateArgument> args);
+//-----------------------------------------------------------------------------
+
+/// \brief Record the code generated for instantiations of \p primary, the number of lines and bytes are counted.
+void RecordGeneratedCode(const NamedDecl& primary, StringRef code);
+//-----------------------------------------------------------------------------
+
+/// \brief Print the number of instantiations and the size of the generated code per primary template, the largest
+/// first. For each template, the argument with the most distinct values is shown, with how many of them are lambdas.
+void PrintBloatReport(llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_BLOAT_REPORT_H */
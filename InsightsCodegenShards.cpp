@@ -0,0 +1,120 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/ADT/StringRef.h"
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+
+#include "InsightsCodegenShards.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static thread_local unsigned     gShardIndex{};
+static thread_local unsigned     gShardCount{1};
+static thread_local ShardResult* gShardResult{};
+static thread_local uint64_t     gGenerationUnit{};
+//-----------------------------------------------------------------------------
+
+void SetCodegenShard(const unsigned index, const unsigned count, ShardResult* result)
+{
+    gShardIndex  = index;
+    gShardCount  = std::max(1u, count);
+    gShardResult = result;
+}
+//-----------------------------------------------------------------------------
+
+ShardResult* GetShardResult()
+{
+    return gShardResult;
+}
+//-----------------------------------------------------------------------------
+
+bool IsFirstCodegenShard()
+{
+    return 0 == gShardIndex;
+}
+//-----------------------------------------------------------------------------
+
+void ResetGenerationUnits()
+{
+    gGenerationUnit = 0;
+}
+//-----------------------------------------------------------------------------
+
+bool TakeGenerationUnit()
+{
+    return gShardIndex == (gGenerationUnit++ % gShardCount);
+}
+//-----------------------------------------------------------------------------
+
+uint64_t GetCurrentGenerationUnit()
+{
+    return gGenerationUnit;
+}
+//-----------------------------------------------------------------------------
+
+bool WriteShards(const std::vector<ShardResult>& results, llvm::raw_ostream& ostream)
+{
+    if(results.empty()) {
+        return false;
+    }
+
+    // The position of a chunk in its shard keeps the order of the chunks of one unit.
+    using OrderedChunk = std::tuple<uint64_t, size_t, const ShardChunk*>;
+
+    std::vector<OrderedChunk> chunks{};
+    bool                      needsNewHeader{};
+
+    for(const auto& result : results) {
+        for(size_t i = 0; i < result.chunks.size(); ++i) {
+            chunks.emplace_back(result.chunks[i].unit, i, &result.chunks[i]);
+        }
+
+        needsNewHeader |= result.needsNewHeader;
+    }
+
+    // A single thread inserts the header at the very beginning after all the handlers are done.
+    const ShardChunk newHeader{0, 0, 0, "#include <new> // for thread-safe static's placement new\n"};
+
+    if(needsNewHeader) {
+        chunks.emplace_back(std::numeric_limits<uint64_t>::max(), 0, &newHeader);
+    }
+
+    // First bring the chunks into the order a single thread records them, then sort them by their position like the
+    // OutputSink does.
+    std::sort(chunks.begin(), chunks.end(), [](const OrderedChunk& lhs, const OrderedChunk& rhs) {
+        return std::tie(std::get<0>(lhs), std::get<1>(lhs)) < std::tie(std::get<0>(rhs), std::get<1>(rhs));
+    });
+
+    std::stable_sort(chunks.begin(), chunks.end(), [](const OrderedChunk& lhs, const OrderedChunk& rhs) {
+        return std::get<2>(lhs)->begin < std::get<2>(rhs)->begin;
+    });
+
+    for(size_t i = 1; i < chunks.size(); ++i) {
+        if(std::get<2>(chunks[i])->begin < std::get<2>(chunks[i - 1])->end) {
+            return false;
+        }
+    }
+
+    const llvm::StringRef original{results.front().mainFile};
+    size_t                start{};
+
+    for(const auto& [unit, index, chunk] : chunks) {
+        ostream << original.slice(start, chunk->begin) << chunk->text;
+        start = chunk->end;
+    }
+
+    ostream << original.substr(start);
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
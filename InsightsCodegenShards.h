@@ -0,0 +1,75 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_CODEGEN_SHARDS_H
+#define INSIGHTS_CODEGEN_SHARDS_H
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief A chunk of generated code for the main file, see \ref OutputSink.
+struct ShardChunk
+{
+    unsigned    begin;  //!< The offset of the replaced range in the main file.
+    unsigned    end;    //!< The offset behind the replaced range in the main file.
+    uint64_t    unit;   //!< The generation unit which produced the chunk, see \ref TakeGenerationUnit.
+    std::string text;
+};
+
+/// \brief The result of one shard of the code generation of a translation unit.
+struct ShardResult
+{
+    std::vector<ShardChunk> chunks;
+    std::string             mainFile;        //!< The content of the main file.
+    bool                    needsNewHeader;  //!< Whether the \c <new> header must be included.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Let the current thread generate only every \p count-th top-level unit, starting with \p index.
+///
+/// The code generation of a translation unit can be split across threads this way. Each thread parses the
+/// translation unit on its own, so that nothing of clang is shared between the threads. All threads match the same
+/// declarations in the same order, but each one generates code only for its share of them. The chunks go to \p
+/// result instead of the output stream. A \p count of one turns sharding off.
+void SetCodegenShard(const unsigned index, const unsigned count, ShardResult* result);
+
+/// \brief The result of the shard of the current thread, \c nullptr if the thread is not a shard.
+ShardResult* GetShardResult();
+
+/// \brief Whether the current thread is the first shard or not a shard at all. Work for the entire translation unit,
+/// which is not split, is done by this one only.
+bool IsFirstCodegenShard();
+
+/// \brief Start counting the generation units of a new translation unit.
+void ResetGenerationUnits();
+
+/// \brief Count the next generation unit, a top-level declaration a handler generates code for.
+///
+/// \returns whether the current thread generates the code for it.
+bool TakeGenerationUnit();
+
+/// \brief The number of the current generation unit of this thread.
+uint64_t GetCurrentGenerationUnit();
+//-----------------------------------------------------------------------------
+
+/// \brief Write the main file with the chunks of all \p results applied in the order a single thread would have
+/// applied them.
+///
+/// \returns \c false without writing anything, if chunks overlap. They require the \c Rewriter, the caller has to fall
+/// back to a single thread then.
+bool WriteShards(const std::vector<ShardResult>& results, llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_CODEGEN_SHARDS_H */
@@ -0,0 +1,92 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "InsightsCompression.h"
+
+#ifdef INSIGHTS_USE_ZLIB
+#include <algorithm>
+#include <limits>
+
+#define ZLIB_CONST
+#include <zlib.h>
+
+#include "response_dictionary.h"
+#endif /* INSIGHTS_USE_ZLIB */
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+bool IsCompressionAvailable()
+{
+#ifdef INSIGHTS_USE_ZLIB
+    return true;
+#else
+    return false;
+#endif /* INSIGHTS_USE_ZLIB */
+}
+//-----------------------------------------------------------------------------
+
+bool CompressResponse(std::string_view data, std::string& compressed)
+{
+#ifdef INSIGHTS_USE_ZLIB
+    z_stream stream{};
+
+    if(Z_OK != deflateInit(&stream, Z_DEFAULT_COMPRESSION)) {
+        return false;
+    }
+
+    bool ok{Z_OK == deflateSetDictionary(&stream, INSIGHTS_RESPONSE_DICTIONARY, sizeof(INSIGHTS_RESPONSE_DICTIONARY))};
+
+    if(ok) {
+        // zlib counts the bytes in an uInt, larger data goes in and out in slices. Below 4 GiB a single call of deflate
+        // does it, the bound is large enough for all of the data.
+        constexpr size_t SLICE{std::numeric_limits<uInt>::max()};
+
+        compressed.resize(deflateBound(&stream, static_cast<uLong>(std::min(data.size(), SLICE))));
+
+        size_t remaining{data.size()};
+        size_t written{};
+        int    result{Z_OK};
+
+        stream.next_in = reinterpret_cast<const Bytef*>(data.data());
+
+        while(Z_OK == result) {
+            if(0 == stream.avail_in) {
+                stream.avail_in = static_cast<uInt>(std::min(remaining, SLICE));
+                remaining -= stream.avail_in;
+            }
+
+            if(written == compressed.size()) {
+                compressed.resize(2 * compressed.size());
+            }
+
+            const size_t space{std::min(compressed.size() - written, SLICE)};
+
+            stream.next_out  = reinterpret_cast<Bytef*>(compressed.data() + written);
+            stream.avail_out = static_cast<uInt>(space);
+
+            result = deflate(&stream, (0 == remaining) ? Z_FINISH : Z_NO_FLUSH);
+            written += space - stream.avail_out;
+        }
+
+        ok = (Z_STREAM_END == result);
+        compressed.resize(written);
+    }
+
+    deflateEnd(&stream);
+
+    return ok;
+#else
+    static_cast<void>(data);
+    static_cast<void>(compressed);
+
+    return false;
+#endif /* INSIGHTS_USE_ZLIB */
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
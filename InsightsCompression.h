@@ -0,0 +1,33 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_COMPRESSION_H
+#define INSIGHTS_COMPRESSION_H
+
+#include <string>
+#include <string_view>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Whether this build can compress the responses of the server, it requires zlib.
+bool IsCompressionAvailable();
+//-----------------------------------------------------------------------------
+
+/// \brief Compress \p data into \p compressed in the zlib format, with the preset dictionary of
+/// \c scripts/response-dictionary.txt.
+///
+/// The dictionary is trained on the expected outputs of the tests by \c scripts/train-dictionary.py. The header of the
+/// stream carries its Adler-32, a client with a different dictionary notices the mismatch when it decompresses.
+///
+/// \returns \c false, if zlib is not available or failed.
+bool CompressResponse(std::string_view data, std::string& compressed);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_COMPRESSION_H */
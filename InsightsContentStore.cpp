@@ -0,0 +1,254 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <atomic>
+#include <mutex>
+
+#include "DPrint.h"
+#include "InsightsContentStore.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static std::string gContentStoreDir{};
+
+static std::mutex        gContentKeysMutex{};
+static llvm::StringSet<> gContentKeys{};  //!< The keys this process knows to be in the store.
+
+static std::atomic<uint64_t> gContentStored{};
+static std::atomic<uint64_t> gContentReused{};
+static std::atomic<uint64_t> gContentBytesStored{};
+static std::atomic<uint64_t> gContentBytesReused{};
+//-----------------------------------------------------------------------------
+
+/// \brief Chunks up to this size stay in the manifest, see \ref IsInlineContent.
+static constexpr size_t MAX_INLINE_CONTENT{64};
+//-----------------------------------------------------------------------------
+
+ContentStoreStats GetContentStoreStats()
+{
+    return {gContentStored, gContentReused, gContentBytesStored, gContentBytesReused};
+}
+//-----------------------------------------------------------------------------
+
+void EnableContentStore(llvm::StringRef storeDir)
+{
+    llvm::SmallString<256> dir{storeDir};
+    llvm::sys::fs::make_absolute(dir);
+
+    gContentStoreDir = dir.str().str();
+}
+//-----------------------------------------------------------------------------
+
+bool IsContentStoreEnabled()
+{
+    return not gContentStoreDir.empty();
+}
+//-----------------------------------------------------------------------------
+
+llvm::StringRef GetContentStoreDir()
+{
+    return gContentStoreDir;
+}
+//-----------------------------------------------------------------------------
+
+bool IsInlineContent(llvm::StringRef text)
+{
+    return text.size() <= MAX_INLINE_CONTENT;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetContentKey(llvm::StringRef text)
+{
+    llvm::MD5 hash{};
+    hash.update(text);
+
+    llvm::MD5::MD5Result result{};
+    hash.final(result);
+
+    return result.digest().str().str();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The path of the entry \p key in \p storeDir.
+///
+/// The entries are spread over subdirectories named after the first two characters of the key, a whole project easily
+/// has more chunks than a single directory handles well.
+static llvm::SmallString<256> GetContentPath(llvm::StringRef storeDir, llvm::StringRef key)
+{
+    llvm::SmallString<256> path{storeDir};
+    llvm::sys::path::append(path, key.take_front(2), key);
+
+    return path;
+}
+//-----------------------------------------------------------------------------
+
+static bool WriteContent(llvm::StringRef path, llvm::StringRef text)
+{
+    const auto dir = llvm::sys::path::parent_path(path);
+
+    if(const auto ec = llvm::sys::fs::create_directories(dir)) {
+        Error("content store: cannot create '%s': %s\n", dir, ec.message());
+        return false;
+    }
+
+    int                    fd{};
+    llvm::SmallString<256> tmpPath{};
+    if(const auto ec = llvm::sys::fs::createUniqueFile(path + "-%%%%%%.tmp", fd, tmpPath)) {
+        Error("content store: cannot create a temporary file: %s\n", ec.message());
+        return false;
+    }
+
+    {
+        llvm::raw_fd_ostream out{fd, /*shouldClose*/ true};
+        out << text;
+        out.close();
+
+        if(out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmpPath);
+            return false;
+        }
+    }
+
+    // The rename is atomic, a concurrent reader sees either no entry or the complete one. Two writers of the same key
+    // write the same bytes, which of them wins does not matter.
+    if(llvm::sys::fs::rename(tmpPath, path)) {
+        llvm::sys::fs::remove(tmpPath);
+        return false;
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+std::string PutContent(llvm::StringRef text)
+{
+    std::string key{GetContentKey(text)};
+
+    {
+        std::lock_guard lock{gContentKeysMutex};
+
+        if(gContentKeys.contains(key)) {
+            ++gContentReused;
+            gContentBytesReused += text.size();
+            return key;
+        }
+    }
+
+    const auto path = GetContentPath(gContentStoreDir, key);
+
+    // A previous run may have stored it already.
+    if(llvm::sys::fs::exists(path)) {
+        ++gContentReused;
+        gContentBytesReused += text.size();
+
+    } else if(WriteContent(path, text)) {
+        ++gContentStored;
+        gContentBytesStored += text.size();
+
+    } else {
+        return {};
+    }
+
+    std::lock_guard lock{gContentKeysMutex};
+    gContentKeys.insert(key);
+
+    return key;
+}
+//-----------------------------------------------------------------------------
+
+bool MaterializeManifest(llvm::StringRef manifestPath, llvm::raw_ostream& ostream)
+{
+    auto manifestBuffer = llvm::MemoryBuffer::getFile(manifestPath);
+
+    if(not manifestBuffer) {
+        Error("cannot read '%s': %s\n", manifestPath, manifestBuffer.getError().message());
+        return false;
+    }
+
+    auto parsed = llvm::json::parse(manifestBuffer.get()->getBuffer());
+
+    if(not parsed) {
+        Error("'%s' is not a manifest: %s\n", manifestPath, llvm::toString(parsed.takeError()));
+        return false;
+    }
+
+    const auto* manifest  = parsed->getAsObject();
+    const auto  source    = manifest ? manifest->getString("source") : llvm::None;
+    const auto  sourceKey = manifest ? manifest->getString("sourceKey") : llvm::None;
+    const auto  store     = manifest ? manifest->getString("store") : llvm::None;
+    const auto* parts     = manifest ? manifest->getArray("parts") : nullptr;
+
+    if(not source or not sourceKey or not store or not parts) {
+        Error("'%s' is not a manifest\n", manifestPath);
+        return false;
+    }
+
+    auto sourceBuffer = llvm::MemoryBuffer::getFile(*source);
+
+    if(not sourceBuffer) {
+        Error("cannot read '%s': %s\n", *source, sourceBuffer.getError().message());
+        return false;
+    }
+
+    const llvm::StringRef original = sourceBuffer.get()->getBuffer();
+
+    if(GetContentKey(original) != *sourceKey) {
+        Error("'%s' changed since '%s' was written\n", *source, manifestPath);
+        return false;
+    }
+
+    for(const auto& partValue : *parts) {
+        const auto* part = partValue.getAsObject();
+
+        if(not part) {
+            Error("'%s' is not a manifest\n", manifestPath);
+            return false;
+        }
+
+        if(const auto text = part->getString("text")) {
+            ostream << *text;
+
+        } else if(const auto key = part->getString("chunk")) {
+            const auto path  = GetContentPath(*store, *key);
+            auto       chunk = llvm::MemoryBuffer::getFile(path);
+
+            if(not chunk) {
+                Error("content store: cannot read '%s': %s\n", path.str(), chunk.getError().message());
+                return false;
+            }
+
+            ostream << chunk.get()->getBuffer();
+
+        } else {
+            const auto begin = part->getInteger("begin");
+            const auto end   = part->getInteger("end");
+
+            if(not begin or not end or (*begin < 0) or (*begin > *end) or
+               (static_cast<uint64_t>(*end) > original.size())) {
+                Error("'%s' is not a manifest\n", manifestPath);
+                return false;
+            }
+
+            ostream << original.slice(*begin, *end);
+        }
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
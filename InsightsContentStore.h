@@ -0,0 +1,69 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_CONTENT_STORE_H
+#define INSIGHTS_CONTENT_STORE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Counters of the content store, reported with \c --stats.
+struct ContentStoreStats
+{
+    uint64_t stored{};       //!< Chunks written to the store.
+    uint64_t reused{};       //!< Chunks which were in the store already.
+    uint64_t bytesStored{};  //!< The bytes of the written chunks.
+    uint64_t bytesReused{};  //!< The bytes not written, as the chunks were in the store already.
+};
+
+ContentStoreStats GetContentStoreStats();
+//-----------------------------------------------------------------------------
+
+/// \brief Store the generated chunks in \p storeDir and write manifests instead of the results, see \c --dedup-store.
+void EnableContentStore(llvm::StringRef storeDir);
+
+bool IsContentStoreEnabled();
+
+/// \brief The directory of the content store, empty if it is not enabled.
+llvm::StringRef GetContentStoreDir();
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p text is small enough to stay in the manifest.
+///
+/// An entry of its own costs a file and a lookup, which is more than the bytes of a short chunk are worth.
+bool IsInlineContent(llvm::StringRef text);
+
+/// \brief Add \p text to the content store, if it is not there already.
+///
+/// The key is the hash of \p text. Each entry is written once to a temporary file and renamed afterwards, which makes it
+/// safe for multiple threads and processes to share one store.
+///
+/// \returns The key of \p text, empty if it could not be written.
+std::string PutContent(llvm::StringRef text);
+
+/// \brief The hash of \p text the content store and the manifests use as key.
+std::string GetContentKey(llvm::StringRef text);
+//-----------------------------------------------------------------------------
+
+/// \brief Write the file the manifest \p manifestPath describes to \p ostream, see \c --materialize.
+///
+/// The slices come from the source file, the chunks from the store the manifest names. A source file which changed
+/// since the manifest was written is an error, the slices no longer match.
+///
+/// \returns \c false, if the file could not be rebuilt.
+bool MaterializeManifest(llvm::StringRef manifestPath, llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_CONTENT_STORE_H */
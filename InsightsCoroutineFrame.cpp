@@ -0,0 +1,270 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+#include <string>
+
+#include "ClangCompat.h"
+#include "InsightsCoroutineFrame.h"
+#include "InsightsHelpers.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+struct FrameMember
+{
+    QualType    type;
+    std::string name;
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Collects the suspend points of a coroutine body and the locals which live across one of them.
+class SuspendPointFinder
+{
+public:
+    explicit SuspendPointFinder(const SourceManager& sm)
+    : mSm{sm}
+    {
+    }
+
+    void Find(const Stmt* stmt, const SourceLocation scopeEnd)
+    {
+        if(not stmt or isa<LambdaExpr>(stmt)) {
+            return;
+        }
+
+        if(const auto* suspend = dyn_cast<CoroutineSuspendExpr>(stmt)) {
+            mSuspends.push_back(suspend);
+
+        } else if(const auto* declStmt = dyn_cast<DeclStmt>(stmt)) {
+            for(const auto* decl : declStmt->decls()) {
+                if(const auto* var = dyn_cast<VarDecl>(decl); var and var->hasLocalStorage()) {
+                    mLocals.push_back({var, scopeEnd});
+                }
+            }
+        }
+
+        // The variables of a compound statement or declared in the head of a control statement live to its end.
+        const bool opensScope{isa<CompoundStmt>(stmt) or isa<ForStmt>(stmt) or isa<CXXForRangeStmt>(stmt) or
+                              isa<IfStmt>(stmt) or isa<WhileStmt>(stmt) or isa<SwitchStmt>(stmt)};
+
+        for(const auto* child : stmt->children()) {
+            Find(child, opensScope ? stmt->getEndLoc() : scopeEnd);
+        }
+    }
+
+    const llvm::SmallVector<const CoroutineSuspendExpr*, 8>& GetSuspends() const { return mSuspends; }
+
+    /// \brief The locals which are declared before and go out of scope after a suspend point.
+    llvm::SmallVector<const VarDecl*, 8> GetLocalsAcrossSuspends() const
+    {
+        llvm::SmallVector<const VarDecl*, 8> locals{};
+
+        for(const auto& [var, scopeEnd] : mLocals) {
+            for(const auto* suspend : mSuspends) {
+                const auto loc = suspend->getBeginLoc();
+
+                if(mSm.isBeforeInTranslationUnit(var->getLocation(), loc) and
+                   mSm.isBeforeInTranslationUnit(loc, scopeEnd)) {
+                    locals.push_back(var);
+                    break;
+                }
+            }
+        }
+
+        return locals;
+    }
+
+private:
+    const SourceManager&                                            mSm;
+    llvm::SmallVector<const CoroutineSuspendExpr*, 8>               mSuspends{};
+    llvm::SmallVector<std::pair<const VarDecl*, SourceLocation>, 8> mLocals{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The temporary awaiter of \p suspend, it is kept in the frame while the coroutine is suspended.
+static const Expr* GetTemporaryAwaiter(const CoroutineSuspendExpr& suspend)
+{
+    return dyn_cast_or_null<MaterializeTemporaryExpr>(suspend.getCommonExpr());
+}
+//-----------------------------------------------------------------------------
+
+static const CoroutineSuspendExpr* FindSuspend(const Stmt* stmt)
+{
+    if(not stmt) {
+        return nullptr;
+    }
+
+    if(const auto* suspend = dyn_cast<CoroutineSuspendExpr>(stmt)) {
+        return suspend;
+    }
+
+    for(const auto* child : stmt->children()) {
+        if(const auto* suspend = FindSuspend(child)) {
+            return suspend;
+        }
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The function which allocates the frame, the one of the promise if it has one.
+static std::string GetAllocationFunction(const CoroutineBodyStmt& body)
+{
+    const auto* allocate = body.getAllocate();
+
+    if(const auto* call = dyn_cast_or_null<CallExpr>(allocate ? allocate->IgnoreImplicit() : nullptr)) {
+        if(const auto* method = dyn_cast_or_null<CXXMethodDecl>(call->getDirectCallee())) {
+            return StrCat(GetName(*method->getParent()), "::operator new");
+        }
+    }
+
+    return "operator new";
+}
+//-----------------------------------------------------------------------------
+
+void InsertCoroutineFrame(OutputFormatHelper&      outputFormatHelper,
+                          const FunctionDecl&      function,
+                          const CoroutineBodyStmt& body)
+{
+    if(function.isDependentContext() or not body.getPromiseDecl()) {
+        return;
+    }
+
+    const auto&       ctx = function.getASTContext();
+    const auto&       sm  = ctx.getSourceManager();
+    const std::string name{function.getNameAsString()};
+    const std::string frameName{StrCat("__", name, "Frame")};
+
+    SuspendPointFinder finder{sm};
+    finder.Find(body.getBody(), body.getBody()->getEndLoc());
+
+    const auto& suspends = finder.GetSuspends();
+
+    llvm::SmallVector<FrameMember, 16> members{};
+    members.push_back({body.getPromiseDecl()->getType(), "__promise"});
+    members.push_back({ctx.IntTy, "__suspend_index"});
+
+    if(const auto* suspend = FindSuspend(body.getInitSuspendStmt()); suspend and GetTemporaryAwaiter(*suspend)) {
+        members.push_back({suspend->getCommonExpr()->getType(), "__initial_suspend"});
+    }
+
+    if(const auto* suspend = FindSuspend(body.getFinalSuspendStmt()); suspend and GetTemporaryAwaiter(*suspend)) {
+        members.push_back({suspend->getCommonExpr()->getType(), "__final_suspend"});
+    }
+
+    if(const auto* method = dyn_cast_or_null<CXXMethodDecl>(&function); method and method->isInstance()) {
+#if IS_CLANG_NEWER_THAN(8)
+        members.push_back({method->getThisType(), "__this"});
+#else
+        members.push_back({method->getThisType(ctx), "__this"});
+#endif
+    }
+
+    for(const auto* param : function.parameters()) {
+        members.push_back({param->getType(), GetName(*param)});
+    }
+
+    for(const auto* suspend : suspends) {
+        if(const auto* awaiter = GetTemporaryAwaiter(*suspend)) {
+            const auto [line, column] = GetSpellingLineColumn(sm, suspend->getBeginLoc());
+
+            members.push_back({awaiter->getType(), StrCat("__suspend_", line, "_", column)});
+        }
+    }
+
+    for(const auto* var : finder.GetLocalsAcrossSuspends()) {
+        members.push_back({var->getType(), GetName(*var)});
+    }
+
+    // Both function pointers come first, so that resume and destroy work without knowing the type of the frame.
+    const auto pointerInfo = ctx.getTypeInfo(ctx.VoidPtrTy);
+    uint64_t   size{2 * pointerInfo.Width};
+    uint64_t   align{pointerInfo.Align};
+
+    outputFormatHelper.AppendNewLine("/* coroutine frame of ", GetName(function));
+    outputFormatHelper.AppendNewLine("   struct ", frameName);
+    outputFormatHelper.AppendNewLine("   {");
+    outputFormatHelper.AppendNewLine("     void (*resume_fn)(", frameName, " *);");
+    outputFormatHelper.AppendNewLine("     void (*destroy_fn)(", frameName, " *);");
+
+    for(const auto& member : members) {
+        outputFormatHelper.AppendNewLine("     ", GetTypeNameAsParameter(member.type, member.name), ";");
+
+        if(member.type->isDependentType() or member.type->isIncompleteType()) {
+            continue;
+        }
+
+        const auto info = ctx.getTypeInfo(member.type);
+
+        size  = llvm::alignTo(size, info.Align) + info.Width;
+        align = std::max<uint64_t>(align, info.Align);
+    }
+
+    outputFormatHelper.AppendNewLine("   };");
+
+    const uint64_t frameSize{llvm::alignTo(size, align) / ctx.getCharWidth()};
+
+    outputFormatHelper.AppendNewLine("   size: about ",
+                                     frameSize,
+                                     " bytes, allocated on the heap with ",
+                                     GetAllocationFunction(body),
+                                     "(sizeof(",
+                                     frameName,
+                                     "))",
+                                     body.getReturnStmtOnAllocFailure()
+                                         ? ", returns get_return_object_on_allocation_failure() if it fails"
+                                         : "");
+
+    const auto suspendPoints = suspends.size();
+
+    outputFormatHelper.AppendNewLine("   resume: void __",
+                                     name,
+                                     "Resume(",
+                                     frameName,
+                                     " *), a switch over ",
+                                     suspendPoints,
+                                     (1 == suspendPoints) ? " suspend point" : " suspend points",
+                                     ", each resume is an indirect call through resume_fn");
+    outputFormatHelper.AppendNewLine("   destroy: void __",
+                                     name,
+                                     "Destroy(",
+                                     frameName,
+                                     " *), an indirect call through destroy_fn");
+
+    // The heap allocation can be elided if the caller inlines the coroutine and the frame does not outlive it. For
+    // that, the returned object must destroy the coroutine in its destructor.
+    const auto* returnRecord = function.getReturnType()->getAsCXXRecordDecl();
+    const auto  returnName   = GetName(function.getReturnType());
+
+    if(returnRecord and returnRecord->hasUserDeclaredDestructor()) {
+        outputFormatHelper.AppendNewLine("   HALO: the allocation can be elided, if a caller inlines ",
+                                         name,
+                                         " and destroys the ",
+                                         returnName,
+                                         " before it returns");
+    } else {
+        outputFormatHelper.AppendNewLine(
+            "   HALO: unlikely, ", returnName, " does not destroy the coroutine, the frame outlives the call");
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
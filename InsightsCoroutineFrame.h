@@ -0,0 +1,36 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_COROUTINE_FRAME_H
+#define INSIGHTS_COROUTINE_FRAME_H
+
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CoroutineBodyStmt;
+class FunctionDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Insert the frame of the coroutine \p function as a comment, see \c --show-coroutine-frame.
+///
+/// The frame is shown as the struct the compiler allocates for each call: the resume and destroy function pointers,
+/// the promise, the index of the suspend point, the copies of the parameters, the awaiters and the locals which live
+/// across a suspend point. Its size is estimated, the compiler can reorder the members and drop the ones it does not
+/// need. The allocation of the frame, the resume and destroy functions and whether the frame allocation can be elided
+/// follow.
+void InsertCoroutineFrame(OutputFormatHelper&      outputFormatHelper,
+                          const FunctionDecl&      function,
+                          const CoroutineBodyStmt& body);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_COROUTINE_FRAME_H */
@@ -0,0 +1,425 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ODRHash.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/StringMap.h"
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "Insights.h"
+#include "InsightsDeclCache.h"
+#include "InsightsProbes.h"
+#include "InsightsResultCache.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief The cache shared by all threads, the least recently used entry is at the back of \c order.
+struct DeclCache
+{
+    struct Entry
+    {
+        DeclCacheEntry                   entry;
+        std::list<std::string>::iterator position;
+    };
+
+    std::mutex             mutex{};
+    llvm::StringMap<Entry> entries{};
+    std::list<std::string> order{};
+    uint64_t               size{};
+    uint64_t               maxSize{};
+    DeclCacheStats         stats{};
+};
+}  // namespace
+
+static DeclCache gDeclCache{};  // NOLINT
+
+/// The part of the key which is the same for all declarations of a translation unit.
+static thread_local std::optional<std::string> gTranslationUnitKey{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+DeclCacheStats GetDeclCacheStats()
+{
+    std::lock_guard lock{gDeclCache.mutex};
+
+    return gDeclCache.stats;
+}
+//-----------------------------------------------------------------------------
+
+void EnableDeclCache(const uint64_t maxSize)
+{
+    gDeclCache.maxSize = maxSize;
+}
+//-----------------------------------------------------------------------------
+
+bool IsDeclCacheEnabled()
+{
+    return 0 != gDeclCache.maxSize;
+}
+//-----------------------------------------------------------------------------
+
+void ClearDeclCache()
+{
+    std::lock_guard lock{gDeclCache.mutex};
+
+    gDeclCache.stats.evictions += gDeclCache.entries.size();
+
+    gDeclCache.entries.clear();
+    gDeclCache.order.clear();
+    gDeclCache.size = 0;
+}
+//-----------------------------------------------------------------------------
+
+uint64_t GetDeclCacheSize()
+{
+    std::lock_guard lock{gDeclCache.mutex};
+
+    return gDeclCache.size;
+}
+//-----------------------------------------------------------------------------
+
+void ResetDeclCacheTranslationUnit()
+{
+    gTranslationUnitKey.reset();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Get the top-level declaration \p decl is part of.
+static const Decl* GetTopLevelDecl(const Decl* decl)
+{
+    while(const auto* ctx = decl->getLexicalDeclContext()) {
+        if(ctx->isTranslationUnit()) {
+            break;
+        }
+
+        decl = Decl::castFromDeclContext(ctx);
+    }
+
+    return decl;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Get the source text of \p decl, if it is in the main file.
+static llvm::Optional<StringRef> GetMainFileText(const Decl& decl, const SourceManager& sm)
+{
+    const auto begin = sm.getExpansionLoc(decl.getBeginLoc());
+    const auto end   = sm.getExpansionLoc(decl.getEndLoc());
+
+    if(begin.isInvalid() or end.isInvalid() or not sm.isInMainFile(begin) or not sm.isInMainFile(end)) {
+        return {};
+    }
+
+    const auto beginOffset = sm.getFileOffset(begin);
+    const auto endOffset   = sm.getFileOffset(end) + Lexer::MeasureTokenLength(end, sm, decl.getLangOpts());
+
+    return sm.getBufferData(sm.getMainFileID()).slice(beginOffset, endOffset);
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief Collects the top-level declarations of the main file a declaration refers to, directly or through other
+/// declarations of the main file.
+///
+/// Everything the generated code of a declaration depends on is reachable this way: the called functions, the used
+/// types, the constructors and conversions. Declarations outside of the main file are covered by the file stamps.
+class DependencyCollector final : public RecursiveASTVisitor<DependencyCollector>
+{
+public:
+    explicit DependencyCollector(const SourceManager& sm)
+    : mSM{sm}
+    {
+    }
+
+    void Collect(const Decl& decl)
+    {
+        mVisited.insert(&decl);
+        TraverseDecl(const_cast<Decl*>(&decl));
+
+        while(not mPending.empty()) {
+            const auto* dependency = mPending.back();
+            mPending.pop_back();
+
+            mDependencies.push_back(dependency);
+            TraverseDecl(const_cast<Decl*>(dependency));
+        }
+    }
+
+    /// \brief The dependencies sorted by their position, which makes the key independent of the traversal order.
+    std::vector<const Decl*> GetDependencies()
+    {
+        std::sort(mDependencies.begin(), mDependencies.end(), [&](const Decl* a, const Decl* b) {
+            return mSM.isBeforeInTranslationUnit(a->getBeginLoc(), b->getBeginLoc());
+        });
+
+        return mDependencies;
+    }
+
+    bool shouldVisitTemplateInstantiations() const { return true; }
+
+    bool VisitDeclRefExpr(DeclRefExpr* expr)
+    {
+        Add(expr->getDecl());
+        return true;
+    }
+
+    bool VisitMemberExpr(MemberExpr* expr)
+    {
+        Add(expr->getMemberDecl());
+        return true;
+    }
+
+    bool VisitCallExpr(CallExpr* expr)
+    {
+        Add(expr->getCalleeDecl());
+        return true;
+    }
+
+    bool VisitCXXConstructExpr(CXXConstructExpr* expr)
+    {
+        Add(expr->getConstructor());
+        return true;
+    }
+
+    bool VisitTagTypeLoc(TagTypeLoc typeLoc)
+    {
+        Add(typeLoc.getDecl());
+        return true;
+    }
+
+    bool VisitTypedefTypeLoc(TypedefTypeLoc typeLoc)
+    {
+        Add(typeLoc.getTypedefNameDecl());
+        return true;
+    }
+
+    bool VisitTemplateSpecializationTypeLoc(TemplateSpecializationTypeLoc typeLoc)
+    {
+        Add(typeLoc.getTypePtr()->getTemplateName().getAsTemplateDecl());
+        return true;
+    }
+
+private:
+    const SourceManager&               mSM;
+    llvm::SmallPtrSet<const Decl*, 16> mVisited{};
+    std::vector<const Decl*>           mPending{};
+    std::vector<const Decl*>           mDependencies{};
+
+    void Add(const Decl* decl)
+    {
+        if(nullptr == decl) {
+            return;
+        }
+
+        const auto* topLevelDecl = GetTopLevelDecl(decl);
+
+        if(GetMainFileText(*topLevelDecl, mSM) and mVisited.insert(topLevelDecl).second) {
+            mPending.push_back(topLevelDecl);
+        }
+    }
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The name, size and modification time of all files except the main file, the language options and the
+/// target.
+static std::string GetTranslationUnitKey(const ASTContext& context)
+{
+    const auto& sm       = context.getSourceManager();
+    const auto* mainFile = sm.getFileEntryForID(sm.getMainFileID());
+
+    std::vector<std::string> files{};
+
+    for(auto it = sm.fileinfo_begin(); it != sm.fileinfo_end(); ++it) {
+        if(const auto* file = it->first; file and (file != mainFile)) {
+            files.push_back(StrCat(file->getName(),
+                                   ":",
+                                   static_cast<uint64_t>(file->getSize()),
+                                   ":",
+                                   static_cast<int64_t>(file->getModificationTime())));
+        }
+    }
+
+    // The iteration order of the map is not stable between runs.
+    std::sort(files.begin(), files.end());
+
+    const auto& langOpts = context.getLangOpts();
+
+    // The flags are bit-fields, they need a copy before they can be passed on.
+    const bool languageFlags[]{bool(langOpts.CPlusPlus11),
+                               bool(langOpts.CPlusPlus14),
+                               bool(langOpts.CPlusPlus17),
+                               bool(langOpts.CPlusPlus2a),
+                               bool(langOpts.GNUMode),
+                               bool(langOpts.Coroutines),
+                               bool(langOpts.Exceptions),
+                               bool(langOpts.RTTI)};
+
+    std::string target{context.getTargetInfo().getTriple().str()};
+
+    for(const bool flag : languageFlags) {
+        target += flag ? '1' : '0';
+    }
+
+    files.push_back(std::move(target));
+
+    return GetResultCacheKey({}, files, GetInsightsOptions(), false);
+}
+//-----------------------------------------------------------------------------
+
+static unsigned GetODRHash(const Decl& decl)
+{
+    ODRHash hash{};
+
+    if(const auto* functionDecl = dyn_cast<FunctionDecl>(&decl)) {
+        hash.AddFunctionDecl(functionDecl);
+
+    } else if(const auto* recordDecl = dyn_cast<CXXRecordDecl>(&decl); recordDecl and recordDecl->hasDefinition()) {
+        hash.AddCXXRecordDecl(recordDecl);
+
+    } else {
+        // The variables have no ODR hash of their own, the text of the declaration covers them.
+        hash.AddDecl(&decl);
+    }
+
+    return hash.CalculateHash();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Append the members of \p ctx which Sema adds for uses elsewhere in the translation unit to \p members.
+///
+/// The special members are declared and the member templates instantiated, if code after the class uses them. The
+/// generated code of the class shows them, but neither the ODR hash nor the source text of the class covers them. In a
+/// specialization each member function gets its definition only when it is used, \p allFunctions includes them.
+static void AddImplicitMembers(const DeclContext& ctx, std::string& members, const bool allFunctions)
+{
+    const auto addFunction = [&](const FunctionDecl& function) {
+        members += StrCat(function.getNameAsString(),
+                          " ",
+                          function.getType().getAsString(),
+                          function.isDefined() ? " defined;" : ";");
+    };
+
+    for(const auto* decl : ctx.decls()) {
+        if(const auto* function = dyn_cast<FunctionDecl>(decl); function and (allFunctions or function->isImplicit())) {
+            addFunction(*function);
+
+        } else if(const auto* functionTemplate = dyn_cast<FunctionTemplateDecl>(decl)) {
+            for(const auto* spec : functionTemplate->specializations()) {
+                addFunction(*spec);
+            }
+
+        } else if(const auto* classTemplate = dyn_cast<ClassTemplateDecl>(decl)) {
+            for(const auto* spec : classTemplate->specializations()) {
+                members += StrCat(GetGlobalAST().getTypeDeclType(spec).getAsString(), ";");
+                AddImplicitMembers(*spec, members, true);
+            }
+
+        } else if(const auto* record = dyn_cast<CXXRecordDecl>(decl); record and not record->isImplicit()) {
+            // The implicit one is the injected class name.
+            AddImplicitMembers(*record, members, allFunctions);
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+std::string GetDeclCacheKey(const Decl& decl)
+{
+    const auto& context = GetGlobalAST();
+    const auto& sm      = context.getSourceManager();
+
+    if(not gTranslationUnitKey) {
+        gTranslationUnitKey = GetTranslationUnitKey(context);
+    }
+
+    const auto begin = sm.getExpansionLoc(decl.getBeginLoc());
+
+    // The position is part of the generated code, for example in the names of the lambdas.
+    std::vector<std::string> parts{*gTranslationUnitKey,
+                                   StrCat(GetODRHash(decl),
+                                          ":",
+                                          sm.getExpansionLineNumber(begin),
+                                          ":",
+                                          sm.getExpansionColumnNumber(begin))};
+
+    if(const auto* recordDecl = dyn_cast<CXXRecordDecl>(&decl)) {
+        std::string members{};
+        AddImplicitMembers(*recordDecl, members, false);
+
+        parts.push_back(std::move(members));
+    }
+
+    DependencyCollector collector{sm};
+    collector.Collect(decl);
+
+    for(const auto* dependency : collector.GetDependencies()) {
+        parts.push_back(GetMainFileText(*dependency, sm)->str());
+    }
+
+    return GetResultCacheKey(GetMainFileText(decl, sm).getValueOr(""), parts, GetInsightsOptions(), false);
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<DeclCacheEntry> LookupCachedDecl(llvm::StringRef key)
+{
+    std::lock_guard lock{gDeclCache.mutex};
+
+    const auto it = gDeclCache.entries.find(key);
+
+    if(gDeclCache.entries.end() == it) {
+        ++gDeclCache.stats.misses;
+        ProbeCacheLookup("decl", false);
+        return {};
+    }
+
+    ++gDeclCache.stats.hits;
+    ProbeCacheLookup("decl", true);
+
+    gDeclCache.order.splice(gDeclCache.order.begin(), gDeclCache.order, it->second.position);
+
+    return it->second.entry;
+}
+//-----------------------------------------------------------------------------
+
+void StoreCachedDecl(llvm::StringRef key, DeclCacheEntry entry)
+{
+    std::lock_guard lock{gDeclCache.mutex};
+
+    // Another thread may have generated the same declaration in the meantime.
+    if(gDeclCache.entries.count(key)) {
+        return;
+    }
+
+    gDeclCache.size += key.size() + entry.text.size();
+    gDeclCache.order.push_front(key.str());
+    gDeclCache.entries[key] = {std::move(entry), gDeclCache.order.begin()};
+
+    while((gDeclCache.size > gDeclCache.maxSize) and (gDeclCache.order.size() > 1)) {
+        const auto& oldest = gDeclCache.order.back();
+        const auto  it     = gDeclCache.entries.find(oldest);
+
+        gDeclCache.size -= oldest.size() + it->second.entry.text.size();
+        gDeclCache.entries.erase(it);
+        gDeclCache.order.pop_back();
+
+        ++gDeclCache.stats.evictions;
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
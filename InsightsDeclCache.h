@@ -0,0 +1,82 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_DECL_CACHE_H
+#define INSIGHTS_DECL_CACHE_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class Decl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Counters of the declaration cache, reported with \c --stats.
+struct DeclCacheStats
+{
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t evictions{};
+};
+//-----------------------------------------------------------------------------
+
+DeclCacheStats GetDeclCacheStats();
+//-----------------------------------------------------------------------------
+
+/// \brief Keep the generated code of top-level declarations of up to \p maxSize bytes in memory, see \c
+/// --decl-cache-size. The cache lives as long as the process, it pays off with \c --server and \c --batch.
+void EnableDeclCache(const uint64_t maxSize);
+
+bool IsDeclCacheEnabled();
+
+/// \brief Remove all entries, the cache stays enabled.
+void ClearDeclCache();
+
+/// \brief The bytes the keys and the code of all entries take up.
+uint64_t GetDeclCacheSize();
+//-----------------------------------------------------------------------------
+
+/// \brief Drop what the key computation knows about the current translation unit. Must be called for every new
+/// translation unit.
+void ResetDeclCacheTranslationUnit();
+//-----------------------------------------------------------------------------
+
+/// \brief The generated code of a declaration together with the state its generation changed.
+struct DeclCacheEntry
+{
+    std::string text;
+    bool        needsNewHeader;  //!< Whether the code requires the \c <new> header, see \ref CodeGenerator.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Build the key for the code of the top-level declaration \p decl of the current translation unit.
+///
+/// It covers the ODR hash of \p decl, its source text and position, the source text of all top-level declarations of
+/// the main file it depends on, directly or indirectly, the name, size and modification time of all other files, the
+/// language options and everything the result cache key covers. For a class it also covers the implicit members and
+/// the specializations of the member templates, which depend on the uses elsewhere in the translation unit.
+std::string GetDeclCacheKey(const Decl& decl);
+//-----------------------------------------------------------------------------
+
+/// \brief Look up the code for \p key. A hit marks the entry as recently used.
+llvm::Optional<DeclCacheEntry> LookupCachedDecl(llvm::StringRef key);
+//-----------------------------------------------------------------------------
+
+/// \brief Store \p entry for \p key. If the cache exceeds its size, the least recently used entries are removed.
+void StoreCachedDecl(llvm::StringRef key, DeclCacheEntry entry);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_DECL_CACHE_H */
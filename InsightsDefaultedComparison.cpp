@@ -0,0 +1,248 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/ExprCXX.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include "Insights.h"
+#include "InsightsDefaultedComparison.h"
+#include "InsightsHelpers.h"
+#include "InsightsOnce.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+using Comparisons = llvm::DenseMap<const Decl*, SmallVector<const Expr*, 2>>;
+//-----------------------------------------------------------------------------
+
+bool IsExpandedDefaultedComparison(const FunctionDecl& function)
+{
+    if(not IsOptionEnabled(InsightsOptionBit::ShowDefaultedComparisons) or not function.isDefaulted() or
+       not function.doesThisDeclarationHaveABody()) {
+        return false;
+    }
+
+    const auto op = function.getOverloadedOperator();
+
+    return (OO_EqualEqual == op) or (OO_Spaceship == op);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The base class or the field \p expr refers to, looking through the subscripts of the loop over an array.
+static const Decl* GetSubobject(const Expr* expr)
+{
+    while(expr) {
+        expr = expr->IgnoreParens();
+
+        if(const auto* cast = dyn_cast<ImplicitCastExpr>(expr)) {
+            if((CK_DerivedToBase == cast->getCastKind()) or (CK_UncheckedDerivedToBase == cast->getCastKind())) {
+                return cast->getType()->getAsCXXRecordDecl();
+            }
+
+            expr = cast->getSubExpr();
+
+        } else if(const auto* subscript = dyn_cast<ArraySubscriptExpr>(expr)) {
+            expr = subscript->getBase();
+
+        } else if(const auto* member = dyn_cast<MemberExpr>(expr)) {
+            return member->getMemberDecl();
+
+        } else {
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Collect the comparisons of \p stmt by the subobject they compare.
+///
+/// The loop conditions and the checks of the comparison category, like <tt>cmp != 0</tt>, compare no subobject.
+static void CollectComparisons(const Stmt* stmt, Comparisons& comparisons)
+{
+    if(not stmt) {
+        return;
+    }
+
+    const Expr* lhs{};
+    const Expr* rhs{};
+
+    if(const auto* call = dyn_cast<CXXOperatorCallExpr>(stmt); call and (2 == call->getNumArgs())) {
+        lhs = call->getArg(0);
+        rhs = call->getArg(1);
+
+    } else if(const auto* op = dyn_cast<BinaryOperator>(stmt); op and op->isComparisonOp()) {
+        lhs = op->getLHS();
+        rhs = op->getRHS();
+    }
+
+    const auto* subobject = GetSubobject(lhs);
+
+    if(not subobject) {
+        subobject = GetSubobject(rhs);
+    }
+
+    if(subobject) {
+        comparisons[subobject].push_back(cast<Expr>(stmt));
+        return;
+    }
+
+    for(const auto* child : stmt->children()) {
+        CollectComparisons(child, comparisons);
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The operator \p comparison calls, empty for a built-in comparison.
+static std::string GetCallee(const Expr& comparison)
+{
+    const auto* call   = dyn_cast<CXXOperatorCallExpr>(&comparison);
+    const auto* callee = call ? call->getDirectCallee() : nullptr;
+
+    if(not callee) {
+        return {};
+    }
+
+    std::string name{GetName(*callee)};
+
+    if(const auto* method = dyn_cast<CXXMethodDecl>(callee)) {
+        name = StrCat(GetName(*method->getParent()), "::", name);
+    }
+
+    return StrCat(callee->isDefaulted() ? "defaulted " : "", name, callee->isInlined() ? "" : " (not inline)");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The cost of comparing a subobject of \p type with \p comparisons. Adds the calls to \p calls.
+static std::string GetComparisonCost(const FunctionDecl&   function,
+                                     QualType              type,
+                                     ArrayRef<const Expr*> comparisons,
+                                     uint64_t&             calls)
+{
+    const auto& ctx = function.getASTContext();
+    const bool  isEquality{OO_EqualEqual == function.getOverloadedOperator()};
+    uint64_t    count{1};
+
+    if(const auto* arrayType = ctx.getAsConstantArrayType(type)) {
+        count = ctx.getConstantArrayElementCount(arrayType);
+        type  = ctx.getBaseElementType(type);
+    }
+
+    std::string cost{};
+
+    if(type->isRecordType()) {
+        SmallVector<std::string, 2> callees{};
+
+        for(const auto* comparison : comparisons) {
+            if(auto callee = GetCallee(*comparison);
+               not callee.empty() and (callees.end() == llvm::find(callees, callee))) {
+                callees.push_back(std::move(callee));
+            }
+        }
+
+        if(callees.empty()) {
+            return "no comparison";
+        }
+
+        calls += count * callees.size();
+
+        cost = (1 == count) ? "call to " : StrCat("loop of ", count, " calls to ");
+
+        OnceFalse needsAnd{};
+        for(const auto& callee : callees) {
+            if(needsAnd) {
+                cost.append(" and ");
+            }
+
+            cost.append(callee);
+        }
+
+    } else if(1 == count) {
+        cost = "scalar compare";
+
+    } else {
+        const auto elementSize = ctx.getTypeSizeInChars(type).getQuantity();
+        // memcmp equals comparing each element only for types with a single representation of each value, which rules
+        // out floating point types. Its order is the one of <=> only for bytes without a sign.
+        const bool isMemcmpable{(type->isIntegralOrEnumerationType() or type->isPointerType()) and
+                                (isEquality or ((1 == elementSize) and type->isUnsignedIntegerOrEnumerationType()))};
+
+        if(isMemcmpable) {
+            cost = StrCat("memcmp-able range of ", count * elementSize, " bytes, ", count, " x ", GetName(type));
+        } else {
+            cost = StrCat("loop of ", count, " scalar compares");
+        }
+    }
+
+    // A three-way comparison converts the category of each subobject comparison to the return type.
+    if(not isEquality) {
+        for(const auto* comparison : comparisons) {
+            if(const auto category = comparison->getType(); category->isRecordType()) {
+                if(not ctx.hasSameUnqualifiedType(category, function.getReturnType())) {
+                    cost.append(StrCat(", ", GetName(category), " converted to ", GetName(function.getReturnType())));
+                }
+
+                break;
+            }
+        }
+    }
+
+    return cost;
+}
+//-----------------------------------------------------------------------------
+
+void InsertDefaultedComparisonCost(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function)
+{
+    const auto* method = dyn_cast<CXXMethodDecl>(&function);
+    const auto* record = method ? method->getParent() : nullptr;
+
+    // A friend compares the class of its first parameter.
+    if(not record and function.getNumParams()) {
+        record = function.getParamDecl(0)->getType().getNonReferenceType()->getAsCXXRecordDecl();
+    }
+
+    if(not record) {
+        return;
+    }
+
+    Comparisons comparisons{};
+    CollectComparisons(function.getBody(), comparisons);
+
+    // The order of [class.compare.default]: the bases in the order of declaration, then the fields.
+    SmallVector<std::string, 16> subobjects{};
+    uint64_t                     calls{};
+
+    for(const auto& base : record->bases()) {
+        const auto& type = base.getType();
+        const auto  cost = GetComparisonCost(function, type, comparisons.lookup(type->getAsCXXRecordDecl()), calls);
+
+        subobjects.push_back(StrCat("base ", GetName(type), ": ", cost));
+    }
+
+    for(const auto* field : record->fields()) {
+        if(not field->isUnnamedBitfield()) {
+            const auto cost = GetComparisonCost(function, field->getType(), comparisons.lookup(field), calls);
+
+            subobjects.push_back(StrCat(GetName(*field), ": ", cost));
+        }
+    }
+
+    outputFormatHelper.AppendNewLine(
+        "/* defaulted ", GetName(function), ", ", subobjects.size(), " subobjects, ", calls, " calls");
+
+    for(const auto& subobject : subobjects) {
+        outputFormatHelper.AppendNewLine("   ", subobject);
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,37 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_DEFAULTED_COMPARISON_H
+#define INSIGHTS_DEFAULTED_COMPARISON_H
+
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class FunctionDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Whether the body of the defaulted \c operator== or \c operator<=> \p function is shown instead of <tt>=
+/// default</tt>, see \c --show-defaulted-comparisons.
+///
+/// The compiler synthesizes the body only for a comparison which is used, the others stay <tt>= default</tt>.
+bool IsExpandedDefaultedComparison(const FunctionDecl& function);
+
+/// \brief Insert a comment with the cost of each subobject comparison of the defaulted comparison \p function.
+///
+/// Each base and member is a scalar compare, a range of scalars which one \c memcmp could compare, a loop of scalar
+/// compares or one or more calls of the operator of its class. The first line counts the calls, with the ones in loops
+/// over arrays per element.
+void InsertDefaultedComparisonCost(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_DEFAULTED_COMPARISON_H */
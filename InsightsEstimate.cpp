@@ -0,0 +1,311 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/Basic/SourceManager.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/JSON.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+
+#include "ClangCompat.h"
+#include "InsightsEstimate.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+struct Estimate
+{
+    uint64_t includes{};        //!< How often a header was entered, a header without an include guard counts each time.
+    uint64_t files{};           //!< The number of distinct headers.
+    uint64_t tokens{};          //!< All tokens after preprocessing.
+    uint64_t mainFileTokens{};  //!< The tokens of the main file only, these are what the code generation sees.
+    uint64_t lambdas{};
+    uint64_t templates{};
+    uint64_t maxArrayExtent{};
+};
+//-----------------------------------------------------------------------------
+
+class IncludeCounter : public PPCallbacks
+{
+public:
+    IncludeCounter(const SourceManager& sm, Estimate& estimate)
+    : mSm{sm}
+    , mEstimate{estimate}
+    {
+    }
+
+    void FileChanged(SourceLocation   loc,
+                     FileChangeReason reason,
+                     SrcMgr::CharacteristicKind /*fileType*/,
+                     FileID /*prevFID*/) override
+    {
+        if(EnterFile != reason) {
+            return;
+        }
+
+        const FileID fileId{mSm.getFileID(loc)};
+
+        if(fileId == mSm.getMainFileID()) {
+            return;
+        }
+
+        // The predefines and the command line have no file entry.
+        if(const auto* fileEntry = mSm.getFileEntryForID(fileId)) {
+            ++mEstimate.includes;
+
+            if(mFiles.insert(fileEntry).second) {
+                ++mEstimate.files;
+            }
+        }
+    }
+
+private:
+    const SourceManager&             mSm;
+    Estimate&                        mEstimate;
+    llvm::DenseSet<const FileEntry*> mFiles{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Whether a \c [ after \p prev starts a lambda. A lambda introducer follows a punctuator which ends nothing,
+/// like \c = or \c (, or \c return. After an identifier, \c ] or \c ) it is a subscript or an array declarator.
+static bool CanStartLambda(const Token& prev)
+{
+    if(prev.isOneOf(tok::kw_return, tok::kw_co_return, tok::kw_co_yield)) {
+        return true;
+    }
+
+    return (nullptr != tok::getPunctuatorSpelling(prev.getKind())) and
+           not prev.isOneOf(tok::r_square, tok::r_paren, tok::l_square, tok::greater);
+}
+//-----------------------------------------------------------------------------
+
+static uint64_t GetIntegerValue(const Token& token)
+{
+    if(not token.getLiteralData()) {
+        return 0;
+    }
+
+    // Without a suffix like u or UL the spelling is the value in C notation.
+    const StringRef spelling{StringRef{token.getLiteralData(), token.getLength()}.rtrim("uUlLzZ")};
+    uint64_t        value{};
+
+    if(spelling.getAsInteger(0, value)) {
+        return 0;
+    }
+
+    return value;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Counts the tokens of the main file together with the lambdas, the template declarations and the largest
+/// array extent among them.
+class MainFileCounter
+{
+public:
+    explicit MainFileCounter(Estimate& estimate)
+    : mEstimate{estimate}
+    {
+        mPrev2.startToken();
+        mPrev.startToken();
+    }
+
+    void Add(const Token& token)
+    {
+        ++mEstimate.mainFileTokens;
+
+        // The [ before decided it could be a lambda, a second [ makes it an attribute instead.
+        if(mPendingLambda and token.isNot(tok::l_square)) {
+            ++mEstimate.lambdas;
+        }
+
+        mPendingLambda = token.is(tok::l_square) and CanStartLambda(mPrev);
+
+        if(mPrev.is(tok::kw_template) and token.is(tok::less) and
+           not mPrev2.isOneOf(tok::period, tok::arrow, tok::coloncolon)) {
+            ++mEstimate.templates;
+        }
+
+        if(mPrev2.is(tok::l_square) and mPrev.is(tok::numeric_constant) and token.is(tok::r_square)) {
+            mEstimate.maxArrayExtent = std::max(mEstimate.maxArrayExtent, GetIntegerValue(mPrev));
+        }
+
+        mPrev2 = mPrev;
+        mPrev  = token;
+    }
+
+private:
+    Estimate& mEstimate;
+
+    // The last two tokens, enough to tell a lambda from an attribute and an array extent.
+    Token mPrev2{};
+    Token mPrev{};
+    bool  mPendingLambda{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Receives the estimate of each source file of the tool.
+using EstimateConsumer = std::function<void(StringRef file, const Estimate& estimate, double timeMs)>;
+
+class EstimateAction : public PreprocessorFrontendAction
+{
+public:
+    explicit EstimateAction(const EstimateConsumer& consumer)
+    : mConsumer{consumer}
+    {
+    }
+
+protected:
+    void ExecuteAction() override
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        auto& pp = getCompilerInstance().getPreprocessor();
+        auto& sm = pp.getSourceManager();
+
+        Estimate estimate{};
+        pp.addPPCallbacks(std::make_unique<IncludeCounter>(sm, estimate));
+        pp.EnterMainSourceFile();
+
+        MainFileCounter counter{estimate};
+        Token           token{};
+
+        for(pp.Lex(token); token.isNot(tok::eof); pp.Lex(token)) {
+            ++estimate.tokens;
+
+            if(sm.isInMainFile(sm.getExpansionLoc(token.getLocation()))) {
+                counter.Add(token);
+            }
+        }
+
+        const std::chrono::duration<double, std::milli> duration{std::chrono::steady_clock::now() - start};
+
+        const auto* mainFile = sm.getFileEntryForID(sm.getMainFileID());
+
+        mConsumer(mainFile ? mainFile->getName() : StringRef{}, estimate, duration.count());
+    }
+
+private:
+    const EstimateConsumer& mConsumer;
+};
+//-----------------------------------------------------------------------------
+
+class EstimateActionFactory final : public tooling::FrontendActionFactory
+{
+public:
+    explicit EstimateActionFactory(EstimateConsumer consumer)
+    : mConsumer{std::move(consumer)}
+    {
+    }
+
+#if IS_CLANG_NEWER_THAN(9)
+    std::unique_ptr<FrontendAction> create() override { return std::make_unique<EstimateAction>(mConsumer); }
+#else
+    FrontendAction* create() override { return new EstimateAction(mConsumer); }
+#endif
+
+private:
+    const EstimateConsumer mConsumer;
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+int RunEstimate(tooling::ClangTool& tool, llvm::raw_ostream& output)
+{
+    EstimateActionFactory factory{[&](StringRef file, const Estimate& estimate, const double timeMs) {
+        output << llvm::json::Value{llvm::json::Object{
+                      {"file", file.str()},
+                      {"includes", static_cast<int64_t>(estimate.includes)},
+                      {"files", static_cast<int64_t>(estimate.files)},
+                      {"tokens", static_cast<int64_t>(estimate.tokens)},
+                      {"mainFileTokens", static_cast<int64_t>(estimate.mainFileTokens)},
+                      {"lambdas", static_cast<int64_t>(estimate.lambdas)},
+                      {"templates", static_cast<int64_t>(estimate.templates)},
+                      {"maxArrayExtent", static_cast<int64_t>(estimate.maxArrayExtent)},
+                      {"timeMs", timeMs}}}
+               << '\n';
+    }};
+
+    return tool.run(&factory);
+}
+//-----------------------------------------------------------------------------
+
+uint64_t CountPreprocessedTokens(tooling::ClangTool& tool)
+{
+    uint64_t tokens{};
+
+    EstimateActionFactory factory{
+        [&](StringRef /*file*/, const Estimate& estimate, const double /*timeMs*/) { tokens += estimate.tokens; }};
+
+    tool.run(&factory);
+
+    return tokens;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief What a header costs in tokens for \ref EstimateSourceCost, if it is not one of the include prefix. Most
+/// headers of the standard library bring some ten thousand tokens with them.
+static constexpr uint64_t INCLUDE_COST{10000};
+
+/// \brief What a lambda costs in tokens for \ref EstimateSourceCost in addition to its own, for its closure class.
+static constexpr uint64_t LAMBDA_COST{100};
+
+/// \brief What a template declaration costs in tokens for \ref EstimateSourceCost in addition to its own, for its
+/// instantiations.
+static constexpr uint64_t TEMPLATE_COST{500};
+//-----------------------------------------------------------------------------
+
+uint64_t EstimateSourceCost(StringRef source, const size_t prefixIncludes, const uint64_t prefixTokens)
+{
+    LangOptions langOpts{};
+    langOpts.CPlusPlus   = true;
+    langOpts.CPlusPlus11 = true;
+    langOpts.CPlusPlus14 = true;
+    langOpts.CPlusPlus17 = true;
+
+    // The raw lexer does not know the keywords, the table turns the identifiers into them.
+    IdentifierTable identifiers{langOpts};
+    Lexer           lexer{SourceLocation{}, langOpts, source.begin(), source.begin(), source.end()};
+
+    Estimate        estimate{};
+    MainFileCounter counter{estimate};
+    Token           token{};
+    bool            directive{};
+
+    for(lexer.LexFromRawLexer(token); token.isNot(tok::eof); lexer.LexFromRawLexer(token)) {
+        if(token.is(tok::raw_identifier)) {
+            auto& info = identifiers.get(token.getRawIdentifier());
+            token.setIdentifierInfo(&info);
+            token.setKind(info.getTokenID());
+        }
+
+        if(directive and token.is(tok::identifier) and (token.getIdentifierInfo()->getName() == "include")) {
+            ++estimate.includes;
+        }
+
+        directive = token.is(tok::hash) and token.isAtStartOfLine();
+
+        counter.Add(token);
+    }
+
+    const uint64_t otherIncludes{estimate.includes - std::min<uint64_t>(estimate.includes, prefixIncludes)};
+
+    return estimate.mainFileTokens + prefixTokens + (otherIncludes * INCLUDE_COST) + (estimate.lambdas * LAMBDA_COST) +
+           (estimate.templates * TEMPLATE_COST) + estimate.maxArrayExtent;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
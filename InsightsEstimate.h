@@ -0,0 +1,53 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_ESTIMATE_H
+#define INSIGHTS_ESTIMATE_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstddef>
+#include <cstdint>
+//-----------------------------------------------------------------------------
+
+namespace clang::tooling {
+class ClangTool;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Estimate the cost of transforming the source files of \p tool by running only the preprocessor, see \c
+/// --estimate.
+///
+/// For each file one JSON object is written to \p output, on a line of its own. It has the number of entered headers
+/// and distinct files, the number of tokens in total and in the main file and, found lexically in the main file, the
+/// number of lambdas and template declarations and the largest array extent.
+///
+/// \returns The exit code of the tool.
+int RunEstimate(tooling::ClangTool& tool, llvm::raw_ostream& output);
+//-----------------------------------------------------------------------------
+
+/// \brief The number of tokens the preprocessor produces for all source files of \p tool.
+///
+/// For a source which is only an include prefix, these are the tokens its headers bring in.
+uint64_t CountPreprocessedTokens(tooling::ClangTool& tool);
+//-----------------------------------------------------------------------------
+
+/// \brief Estimate the cost of transforming \p source in about the number of tokens processed, see \c --scheduler.
+///
+/// Only \p source itself is lexed, without the preprocessor. The \p prefixIncludes headers of its include prefix add
+/// \p prefixTokens, each other include a fixed amount. Lambdas and template declarations count more than their
+/// tokens, they come with a closure class or instantiations, and the largest array extent adds the elements which
+/// may be spelled out.
+uint64_t EstimateSourceCost(llvm::StringRef source, const size_t prefixIncludes, const uint64_t prefixTokens);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_ESTIMATE_H */
@@ -0,0 +1,174 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/AST/StmtCXX.h"
+
+#include "Insights.h"
+#include "InsightsExceptionCost.h"
+#include "InsightsHelpers.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+std::string GetThrowNote(const CXXThrowExpr& expr)
+{
+    const auto* subExpr = expr.getSubExpr();
+
+    if(not subExpr) {
+        return "__cxa_rethrow()";
+    }
+
+    const auto& ctx  = GetGlobalAST();
+    const auto  type = ctx.getDecayedType(subExpr->getType().getNonReferenceType()).getUnqualifiedType();
+
+    if(type->isDependentType() or type->isIncompleteType()) {
+        return {};
+    }
+
+    const auto  typeName = GetName(type);
+    const auto* record   = type->getAsCXXRecordDecl();
+    const auto  dtor     = (record and not record->hasTrivialDestructor())
+                          ? StrCat("&", typeName, "::~", GetName(*record))
+                          : std::string{"nullptr"};
+
+    return StrCat("__cxa_allocate_exception(",
+                  ctx.getTypeSizeInChars(type).getQuantity(),
+                  "), construct ",
+                  typeName,
+                  " in it, __cxa_throw(exception, &typeid(",
+                  typeName,
+                  "), ",
+                  dtor,
+                  ")");
+}
+//-----------------------------------------------------------------------------
+
+std::string GetCatchNote(const CXXCatchStmt& stmt)
+{
+    const auto caughtType = stmt.getCaughtType();
+
+    if(caughtType.isNull()) {
+        return "landing pad: matches any exception, __cxa_begin_catch, __cxa_end_catch at the end";
+    }
+
+    const auto typeName = GetName(caughtType.getNonReferenceType().getUnqualifiedType());
+    const auto binding  = [&]() -> std::string {
+        if(caughtType->isReferenceType()) {
+            return "binds by reference, no copy";
+        }
+
+        const auto* record = caughtType->getAsCXXRecordDecl();
+
+        if(not record or caughtType->isDependentType()) {
+            return "copies the value";
+        }
+
+        // The exception object stays where __cxa_allocate_exception put it, the handler gets a copy of it.
+        const auto& ctx = GetGlobalAST();
+        const auto  copy =
+            caughtType.isTriviallyCopyableType(ctx) ? std::string{} : StrCat(", ", typeName, "(const ", typeName, " &)");
+
+        return StrCat("copies the exception, ", ctx.getTypeSizeInChars(caughtType).getQuantity(), " bytes", copy);
+    }();
+
+    return StrCat(
+        "landing pad: matches typeid(", typeName, "), __cxa_begin_catch, ", binding, ", __cxa_end_catch at the end");
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief Looks for anything in a function body which can throw.
+class ThrowFinder : public RecursiveASTVisitor<ThrowFinder>
+{
+public:
+    bool VisitCXXThrowExpr(const CXXThrowExpr*) { return Found(); }
+    bool VisitCXXTryStmt(const CXXTryStmt*) { return Found(); }
+
+    bool VisitCallExpr(const CallExpr* call)
+    {
+        if(const auto* callee = call->getDirectCallee()) {
+            return IsNothrow(callee->getType()) or Found();
+        }
+
+        // A call through a pointer or a reference to a function.
+        auto calleeType = call->getCallee()->getType();
+
+        if(const auto* pointer = calleeType->getAs<PointerType>()) {
+            calleeType = pointer->getPointeeType();
+        }
+
+        return IsNothrow(calleeType) or Found();
+    }
+
+    bool VisitCXXConstructExpr(const CXXConstructExpr* construct)
+    {
+        return IsNothrow(construct->getConstructor()->getType()) or Found();
+    }
+
+    bool VisitCXXNewExpr(const CXXNewExpr* expr)
+    {
+        const auto* opNew = expr->getOperatorNew();
+
+        return not opNew or IsNothrow(opNew->getType()) or Found();
+    }
+
+    bool VisitCXXDynamicCastExpr(const CXXDynamicCastExpr* cast)
+    {
+        // A failed cast to a reference throws std::bad_cast.
+        return not cast->getType()->isReferenceType() or Found();
+    }
+
+    // Lambdas are functions of their own.
+    bool TraverseLambdaExpr(LambdaExpr*) { return true; }
+
+    bool HasFound() const { return mFound; }
+
+private:
+    static bool IsNothrow(QualType type)
+    {
+        const auto* proto = type->getAs<FunctionProtoType>();
+
+        return proto and not isUnresolvedExceptionSpec(proto->getExceptionSpecType()) and proto->isNothrow();
+    }
+
+    bool Found()
+    {
+        mFound = true;
+
+        // Stop the traversal, one is enough.
+        return false;
+    }
+
+    bool mFound{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+bool CouldBeNoexcept(const FunctionDecl& function)
+{
+    const auto* proto = function.getType()->getAs<FunctionProtoType>();
+
+    // Only a function without any exception specification, noexcept(false) is a decision. Destructors are noexcept
+    // already.
+    if(not proto or (EST_None != proto->getExceptionSpecType()) or isa<CXXDestructorDecl>(function) or
+       function.isDependentContext() or function.isDeleted() or not function.hasBody() or function.isMain()) {
+        return false;
+    }
+
+    ThrowFinder finder{};
+    finder.TraverseStmt(function.getBody());
+
+    return not finder.HasFound();
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
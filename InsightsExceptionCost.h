@@ -0,0 +1,40 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_EXCEPTION_COST_H
+#define INSIGHTS_EXCEPTION_COST_H
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CXXCatchStmt;
+class CXXThrowExpr;
+class FunctionDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The calls of the Itanium C++ ABI a \c throw lowers to, see \c --show-exception-cost.
+std::string GetThrowNote(const CXXThrowExpr& expr);
+//-----------------------------------------------------------------------------
+
+/// \brief What the landing pad of \p stmt does, including the copy of an exception caught by value.
+std::string GetCatchNote(const CXXCatchStmt& stmt);
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the definition \p function, which is not \c noexcept, could be.
+///
+/// This is the case if its body contains no \c throw and calls only functions, constructors and \c operator \c new
+/// which are \c noexcept. A function with a \c try block is left out, it catches something.
+bool CouldBeNoexcept(const FunctionDecl& function);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_EXCEPTION_COST_H */
@@ -0,0 +1,556 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/QualTypeNames.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "DPrint.h"
+#include "InsightsExternTemplates.h"
+#include "InsightsHelpers.h"
+#include "InsightsInstantiationCost.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief One instantiation, summed up over all translation units it appeared in.
+struct ExternTemplate
+{
+    llvm::StringSet<> includes{};
+    llvm::StringSet<> translationUnits{};
+    uint64_t          weight{};  //!< Bytes or microseconds, see \ref ExternTemplatesRank.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Collects what an instantiation needs to be named by another translation unit.
+class Naming
+{
+public:
+    explicit Naming(const ASTContext& ctx)
+    : mCtx{ctx}
+    , mSM{ctx.getSourceManager()}
+    , mPolicy{ctx.getPrintingPolicy()}
+    {
+        mPolicy.SuppressUnwrittenScope = true;
+    }
+
+    /// \brief Check that \p decl comes from a header and remember the include which brought it into the main file.
+    bool AddDecl(const NamedDecl& decl);
+
+    bool AddType(QualType type);
+
+    /// \brief \p arg as written in an explicit instantiation, none if another translation unit cannot name it.
+    llvm::Optional<std::string> GetArgument(const TemplateArgument& arg);
+
+    std::string GetType(const QualType& type) const
+    {
+        return TypeName::getFullyQualifiedName(type, mCtx, mPolicy);
+    }
+
+    std::vector<std::string> includes{};
+
+private:
+    const ASTContext&    mCtx;
+    const SourceManager& mSM;
+    PrintingPolicy       mPolicy;
+
+    /// \brief The header as the main file spells it in the \c #include which brought \p loc in.
+    std::string GetInclude(SourceLocation loc) const;
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static bool                            gExternTemplatesEnabled{};
+static std::string                     gExternTemplatesDir{};
+static unsigned                        gExternTemplatesCount{};
+static ExternTemplatesRank             gExternTemplatesRank{};
+static std::mutex                      gExternTemplatesMutex{};
+static llvm::StringMap<ExternTemplate> gExternTemplates{};
+//-----------------------------------------------------------------------------
+
+void EnableExternTemplates(llvm::StringRef dir, const unsigned count, const ExternTemplatesRank rank)
+{
+    gExternTemplatesEnabled = true;
+    gExternTemplatesDir     = dir.str();
+    gExternTemplatesCount   = count;
+    gExternTemplatesRank    = rank;
+
+    if(ExternTemplatesRank::Time == rank) {
+        StartInstantiationCost();
+    }
+}
+//-----------------------------------------------------------------------------
+
+bool IsExternTemplatesEnabled()
+{
+    return gExternTemplatesEnabled;
+}
+//-----------------------------------------------------------------------------
+
+std::string Naming::GetInclude(SourceLocation loc) const
+{
+    FileID fileId{mSM.getFileID(mSM.getFileLoc(loc))};
+
+    while(fileId.isValid()) {
+        const auto includeLoc = mSM.getIncludeLoc(fileId);
+
+        if(includeLoc.isInvalid()) {
+            return {};
+        }
+
+        if(mSM.getFileID(includeLoc) != mSM.getMainFileID()) {
+            fileId = mSM.getFileID(includeLoc);
+            continue;
+        }
+
+        // The include location is the one of the file name token. A name which comes from a macro is replaced by the
+        // name of the file.
+        const StringRef spelling{mSM.getCharacterData(includeLoc)};
+
+        if(spelling.startswith("<") or spelling.startswith("\"")) {
+            const StringRef terminators{spelling.startswith("<") ? ">\n" : "\"\n"};
+
+            if(const auto end = spelling.find_first_of(terminators, 1);
+               (StringRef::npos != end) and (terminators.front() == spelling[end])) {
+                return spelling.take_front(end + 1).str();
+            }
+        }
+
+        if(const auto* fileEntry = mSM.getFileEntryForID(fileId)) {
+            return StrCat("\"", fileEntry->getName(), "\"");
+        }
+
+        return {};
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+bool Naming::AddDecl(const NamedDecl& decl)
+{
+    const auto loc = decl.getLocation();
+
+    // A definition in the main file is not visible to the explicit instantiation definition.
+    if(loc.isInvalid() or mSM.isInMainFile(mSM.getFileLoc(loc)) or decl.isInAnonymousNamespace() or
+       decl.getParentFunctionOrMethod()) {
+        return false;
+    }
+
+    auto include = GetInclude(loc);
+
+    if(include.empty()) {
+        return false;
+    }
+
+    if(includes.end() == std::find(includes.begin(), includes.end(), include)) {
+        includes.push_back(std::move(include));
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+bool Naming::AddType(QualType type)
+{
+    type = type.getCanonicalType();
+
+    // Pointers, references, arrays and member pointers are as nameable as what they point to.
+    while(true) {
+        if(const auto* memberPointer = type->getAs<MemberPointerType>()) {
+            if(not AddType(QualType(memberPointer->getClass(), 0))) {
+                return false;
+            }
+
+            type = memberPointer->getPointeeType();
+
+        } else if(type->isPointerType() or type->isReferenceType()) {
+            type = type->getPointeeType();
+
+        } else if(const auto* array = mCtx.getAsArrayType(type)) {
+            type = array->getElementType();
+
+        } else {
+            break;
+        }
+    }
+
+    if(const auto* function = type->getAs<FunctionProtoType>()) {
+        if(not AddType(function->getReturnType())) {
+            return false;
+        }
+
+        return std::all_of(function->param_type_begin(), function->param_type_end(), [&](const QualType& param) {
+            return AddType(param);
+        });
+    }
+
+    const auto* tag = type->getAsTagDecl();
+
+    if(not tag) {
+        return true;
+    }
+
+    if(const auto* record = dyn_cast<CXXRecordDecl>(tag); record and record->isLambda()) {
+        return false;
+    }
+
+    if(not tag->getIdentifier() and not tag->getTypedefNameForAnonDecl()) {
+        return false;
+    }
+
+    if(not AddDecl(*tag)) {
+        return false;
+    }
+
+    if(const auto* spec = dyn_cast<ClassTemplateSpecializationDecl>(tag)) {
+        return std::all_of(spec->getTemplateArgs().asArray().begin(),
+                           spec->getTemplateArgs().asArray().end(),
+                           [&](const TemplateArgument& arg) { return GetArgument(arg).hasValue(); });
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<std::string> Naming::GetArgument(const TemplateArgument& arg)
+{
+    switch(arg.getKind()) {
+        case TemplateArgument::Type:
+            if(not AddType(arg.getAsType())) {
+                return {};
+            }
+
+            return GetType(arg.getAsType());
+
+        case TemplateArgument::Integral: {
+            const auto type = arg.getIntegralType();
+
+            if(not AddType(type)) {
+                return {};
+            }
+
+            const auto value = arg.getAsIntegral();
+
+            if(type->isBooleanType()) {
+                return std::string{value.getBoolValue() ? "true" : "false"};
+            }
+
+            std::string number{};
+            llvm::raw_string_ostream{number} << value;
+
+            if(type->isEnumeralType()) {
+                return StrCat("static_cast<", GetType(type), ">(", number, ")");
+            }
+
+            return number;
+        }
+
+        case TemplateArgument::NullPtr: return std::string{"nullptr"};
+
+        case TemplateArgument::Declaration: {
+            const auto* decl = arg.getAsDecl();
+
+            if(not AddDecl(*decl)) {
+                return {};
+            }
+
+            return StrCat(arg.getParamTypeForDecl()->isPointerType() ? "&" : "", decl->getQualifiedNameAsString());
+        }
+
+        case TemplateArgument::Template: {
+            const auto* decl = arg.getAsTemplate().getAsTemplateDecl();
+
+            if(not decl or not AddDecl(*decl)) {
+                return {};
+            }
+
+            return decl->getQualifiedNameAsString();
+        }
+
+        case TemplateArgument::Pack: {
+            std::string pack{};
+
+            for(const auto& element : arg.pack_elements()) {
+                const auto value = GetArgument(element);
+
+                if(not value) {
+                    return {};
+                }
+
+                pack.append(StrCat(pack.empty() ? "" : ", ", *value));
+            }
+
+            return pack;
+        }
+
+        default: return {};
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The explicit instantiation of \p function, without \c extern and the semicolon.
+static std::string GetFunctionInstantiation(const FunctionDecl& function, Naming& naming)
+{
+    const auto* primary = function.getPrimaryTemplate();
+    const auto* args    = function.getTemplateSpecializationArgs();
+
+    // An explicit instantiation declaration does not stop the compiler from instantiating an inline function, and the
+    // deduced return type of an instantiation is needed where it is called.
+    if(not primary or not args or function.isInlined() or function.isConstexpr() or isa<CXXMethodDecl>(function) or
+       primary->getTemplatedDecl()->getReturnType()->getContainedDeducedType()) {
+        return {};
+    }
+
+    // A returned function pointer would need the declarator wrapped around the name.
+    const auto returnType = function.getReturnType();
+
+    if(returnType->isFunctionPointerType() or returnType->isFunctionReferenceType() or
+       returnType->isMemberFunctionPointerType() or not naming.AddDecl(*primary) or not naming.AddType(returnType)) {
+        return {};
+    }
+
+    std::string arguments{};
+
+    for(const auto& arg : args->asArray()) {
+        const auto value = naming.GetArgument(arg);
+
+        if(not value) {
+            return {};
+        }
+
+        // An empty pack adds nothing.
+        if(value->empty()) {
+            continue;
+        }
+
+        arguments.append(StrCat(arguments.empty() ? "" : ", ", *value));
+    }
+
+    std::string parameters{};
+
+    for(const auto* param : function.parameters()) {
+        if(not naming.AddType(param->getType())) {
+            return {};
+        }
+
+        parameters.append(StrCat(parameters.empty() ? "" : ", ", naming.GetType(param->getType())));
+    }
+
+    if(function.isVariadic()) {
+        parameters.append(parameters.empty() ? "..." : ", ...");
+    }
+
+    return StrCat("template ",
+                  naming.GetType(returnType),
+                  " ",
+                  primary->getQualifiedNameAsString(),
+                  "<",
+                  arguments,
+                  ">(",
+                  parameters,
+                  ")");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The explicit instantiation of \p spec, without \c extern and the semicolon.
+static std::string GetClassInstantiation(const ClassTemplateSpecializationDecl& spec, Naming& naming)
+{
+    const auto& ctx  = spec.getASTContext();
+    const auto  type = ctx.getRecordType(&spec);
+
+    if(not naming.AddDecl(*spec.getSpecializedTemplate()) or not naming.AddType(type)) {
+        return {};
+    }
+
+    return StrCat("template ", spec.getKindName(), " ", naming.GetType(type));
+}
+//-----------------------------------------------------------------------------
+
+void RecordExternTemplate(const Decl& instantiation, const uint64_t generatedBytes)
+{
+    const auto& ctx = instantiation.getASTContext();
+    Naming      naming{ctx};
+    std::string declaration{};
+
+    if(const auto* function = dyn_cast<FunctionDecl>(&instantiation)) {
+        if(TSK_ImplicitInstantiation == function->getTemplateSpecializationKind()) {
+            declaration = GetFunctionInstantiation(*function, naming);
+        }
+
+    } else if(const auto* spec = dyn_cast<ClassTemplateSpecializationDecl>(&instantiation)) {
+        if(TSK_ImplicitInstantiation == spec->getSpecializationKind()) {
+            declaration = GetClassInstantiation(*spec, naming);
+        }
+    }
+
+    if(declaration.empty()) {
+        return;
+    }
+
+    uint64_t weight{generatedBytes};
+
+    if(ExternTemplatesRank::Time == gExternTemplatesRank) {
+        const auto cost = GetInstantiationCost(cast<NamedDecl>(instantiation));
+
+        if(not cost) {
+            return;
+        }
+
+        weight = *cost;
+    }
+
+    const auto& sm = ctx.getSourceManager();
+    std::string mainFile{};
+
+    if(const auto* fileEntry = sm.getFileEntryForID(sm.getMainFileID())) {
+        mainFile = fileEntry->getName().str();
+    }
+
+    std::lock_guard lock{gExternTemplatesMutex};
+    auto&           entry = gExternTemplates[declaration];
+
+    // The same instantiation is generated once per translation unit, a second record comes from another one.
+    if(entry.translationUnits.insert(mainFile).second) {
+        entry.weight += weight;
+    }
+
+    for(const auto& include : naming.includes) {
+        entry.includes.insert(include);
+    }
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetWeight(const uint64_t weight)
+{
+    if(ExternTemplatesRank::Size == gExternTemplatesRank) {
+        return StrCat(weight, " bytes");
+    }
+
+    std::string milliseconds{};
+    llvm::raw_string_ostream{milliseconds} << llvm::format("%.3f", static_cast<double>(weight) / 1000.0);
+
+    return StrCat(milliseconds, " ms");
+}
+//-----------------------------------------------------------------------------
+
+static bool WriteFile(const llvm::SmallString<256>& fileName, const std::string& content)
+{
+    std::error_code      ec{};
+    llvm::raw_fd_ostream out{fileName, ec, llvm::sys::fs::OF_Text};
+
+    if(ec) {
+        Error("cannot write extern templates '%s': %s\n", fileName.str(), ec.message());
+        return false;
+    }
+
+    out << content;
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+bool WriteExternTemplates()
+{
+    std::lock_guard lock{gExternTemplatesMutex};
+
+    std::vector<const llvm::StringMapEntry<ExternTemplate>*> templates{};
+
+    for(const auto& entry : gExternTemplates) {
+        templates.push_back(&entry);
+    }
+
+    std::stable_sort(templates.begin(), templates.end(), [](const auto* a, const auto* b) {
+        if(a->second.weight != b->second.weight) {
+            return a->second.weight > b->second.weight;
+        }
+
+        return a->first() < b->first();
+    });
+
+    if(templates.size() > gExternTemplatesCount) {
+        templates.resize(gExternTemplatesCount);
+    }
+
+    // The includes in a stable order, the declarations keep the order of their weight.
+    llvm::StringSet<> includeSet{};
+
+    for(const auto* entry : templates) {
+        for(const auto& include : entry->second.includes) {
+            includeSet.insert(include.first());
+        }
+    }
+
+    std::vector<StringRef> includes{};
+
+    for(const auto& include : includeSet) {
+        includes.push_back(include.first());
+    }
+
+    std::sort(includes.begin(), includes.end());
+
+    std::string header{
+        "// Explicit instantiation declarations of the heaviest instantiations, generated by C++ Insights.\n"
+        "// Include this header where the templates are used and compile extern_templates.cpp once.\n"
+        "#pragma once\n\n"};
+
+    for(const auto& include : includes) {
+        header.append(StrCat("#include ", include, "\n"));
+    }
+
+    std::string source{"// Explicit instantiation definitions, generated by C++ Insights.\n"
+                       "#include \"extern_templates.h\"\n\n"};
+
+    if(not includes.empty()) {
+        header.append("\n");
+    }
+
+    for(const auto* entry : templates) {
+        const auto& tmpl  = entry->second;
+        const auto  units = tmpl.translationUnits.size();
+
+        header.append(StrCat("extern ",
+                             entry->first(),
+                             ";  // ",
+                             units,
+                             (1 == units) ? " translation unit, " : " translation units, ",
+                             GetWeight(tmpl.weight),
+                             "\n"));
+        source.append(StrCat(entry->first(), ";\n"));
+    }
+
+    if(const auto ec = llvm::sys::fs::create_directories(gExternTemplatesDir)) {
+        Error("cannot create extern templates directory '%s': %s\n", gExternTemplatesDir, ec.message());
+        return false;
+    }
+
+    llvm::SmallString<256> headerPath{gExternTemplatesDir};
+    llvm::sys::path::append(headerPath, "extern_templates.h");
+
+    llvm::SmallString<256> sourcePath{gExternTemplatesDir};
+    llvm::sys::path::append(sourcePath, "extern_templates.cpp");
+
+    return WriteFile(headerPath, header) and WriteFile(sourcePath, source);
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,59 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_EXTERN_TEMPLATES_H
+#define INSIGHTS_EXTERN_TEMPLATES_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class Decl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief What makes an instantiation heavy for \c --emit-extern-templates.
+enum class ExternTemplatesRank
+{
+    Size,  //!< The bytes of the code C++ Insights generated for it.
+    Time,  //!< The time Sema spent instantiating it, see \ref GetInstantiationCost.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Write the \p count heaviest instantiations of all translation units to \p dir at exit, see \ref
+/// WriteExternTemplates.
+void EnableExternTemplates(llvm::StringRef dir, const unsigned count, const ExternTemplatesRank rank);
+bool IsExternTemplatesEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Record the class template specialization or function template instantiation \p instantiation, for which \ref
+/// TemplateHandler generated \p generatedBytes of code.
+///
+/// Only implicit instantiations which another translation unit can name are recorded: the template and all types in
+/// the arguments come from a header, none of them is local, unnamed or in an anonymous namespace. Inline, constexpr
+/// and functions with a deduced return type are left out, an explicit instantiation declaration does not keep the
+/// compiler from instantiating them.
+void RecordExternTemplate(const Decl& instantiation, const uint64_t generatedBytes);
+//-----------------------------------------------------------------------------
+
+/// \brief Write \c extern_templates.h with an explicit instantiation declaration for each of the heaviest
+/// instantiations and \c extern_templates.cpp with the matching explicit instantiation definitions.
+///
+/// An instantiation seen in several translation units is written once, its weight is the sum of all of them. The
+/// header includes the headers through which the main files got the templates and the types of the arguments.
+///
+/// \returns \c false, if a file could not be written.
+bool WriteExternTemplates();
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_EXTERN_TEMPLATES_H */
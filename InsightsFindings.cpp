@@ -0,0 +1,234 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <mutex>
+#include <vector>
+
+#include "DPrint.h"
+#include "Insights.h"
+#include "InsightsFindings.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+struct Finding
+{
+    std::string     file{};
+    unsigned        line{};
+    unsigned        column{};
+    FindingCategory category{};
+    FindingSeverity severity{};
+    uint64_t        cost{};
+    std::string     message{};
+};
+//-----------------------------------------------------------------------------
+
+struct CategoryInfo
+{
+    const char* id;
+    const char* description;
+    const char* costUnit;
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static FindingsFormat       gFindingsFormat{FindingsFormat::None};
+static std::mutex           gFindingsMutex{};
+static std::vector<Finding> gFindings{};
+static llvm::StringSet<>    gSeenFindings{};  //!< The instantiations of a template report the same findings.
+//-----------------------------------------------------------------------------
+
+static CategoryInfo GetCategoryInfo(const FindingCategory category)
+{
+    switch(category) {
+        case FindingCategory::Copy: return {"copy", "A copy or move constructor runs.", "bytes"};
+        case FindingCategory::Allocation: return {"allocation", "The allocator is called.", "allocations"};
+        case FindingCategory::VirtualCall: return {"virtual-call", "A call goes through the vtable.", "calls"};
+        case FindingCategory::Padding: return {"padding", "A class has padding between or after its fields.", "bytes"};
+        case FindingCategory::Conversion: return {"conversion", "An implicit conversion generates code.", "cast cost"};
+        case FindingCategory::Guard: return {"guard", "A static local variable is guarded.", "checks"};
+        case FindingCategory::Atomic:
+            return {"atomic", "An atomic operation is seq_cst by default or not lock-free.", "operations"};
+        case FindingCategory::Rtti: return {"rtti", "A dynamic_cast calls into the runtime.", "calls"};
+        case FindingCategory::ZeroInit:
+            return {"zero-init", "A value-initialization fills an object with zeros.", "bytes"};
+    }
+
+    return {"unknown", "", ""};
+}
+//-----------------------------------------------------------------------------
+
+void EnableFindings(const FindingsFormat format)
+{
+    gFindingsFormat = format;
+}
+//-----------------------------------------------------------------------------
+
+bool IsFindingsEnabled()
+{
+    return FindingsFormat::None != gFindingsFormat;
+}
+//-----------------------------------------------------------------------------
+
+void RecordFinding(const SourceLocation  loc,
+                   const FindingCategory category,
+                   const FindingSeverity severity,
+                   const uint64_t        cost,
+                   llvm::StringRef       message)
+{
+    if(not IsFindingsEnabled() or loc.isInvalid()) {
+        return;
+    }
+
+    const auto& sm       = GetGlobalAST().getSourceManager();
+    const auto  presumed = sm.getPresumedLoc(sm.getExpansionLoc(loc));
+
+    if(presumed.isInvalid()) {
+        return;
+    }
+
+    Finding finding{presumed.getFilename(),
+                    presumed.getLine(),
+                    presumed.getColumn(),
+                    category,
+                    severity,
+                    cost,
+                    message.str()};
+
+    const std::string key{StrCat(finding.file,
+                                 ":",
+                                 finding.line,
+                                 ":",
+                                 finding.column,
+                                 ":",
+                                 static_cast<unsigned>(category),
+                                 ":",
+                                 finding.message)};
+
+    std::lock_guard lock{gFindingsMutex};
+
+    if(gSeenFindings.insert(key).second) {
+        gFindings.push_back(std::move(finding));
+    }
+}
+//-----------------------------------------------------------------------------
+
+static const char* GetSeverityName(const FindingSeverity severity)
+{
+    return (FindingSeverity::Warning == severity) ? "warning" : "note";
+}
+//-----------------------------------------------------------------------------
+
+static llvm::json::Value GetFindingsJSON()
+{
+    llvm::json::Array findings{};
+
+    for(const auto& finding : gFindings) {
+        const auto info = GetCategoryInfo(finding.category);
+
+        findings.push_back(llvm::json::Object{{"file", finding.file},
+                                              {"line", static_cast<int64_t>(finding.line)},
+                                              {"column", static_cast<int64_t>(finding.column)},
+                                              {"category", info.id},
+                                              {"severity", GetSeverityName(finding.severity)},
+                                              {"cost", static_cast<int64_t>(finding.cost)},
+                                              {"costUnit", info.costUnit},
+                                              {"message", finding.message}});
+    }
+
+    return std::move(findings);
+}
+//-----------------------------------------------------------------------------
+
+static llvm::json::Value GetFindingsSARIF()
+{
+    llvm::json::Array rules{};
+
+    for(const auto category : {FindingCategory::Copy,
+                               FindingCategory::Allocation,
+                               FindingCategory::VirtualCall,
+                               FindingCategory::Padding,
+                               FindingCategory::Conversion,
+                               FindingCategory::Guard,
+                               FindingCategory::Atomic,
+                               FindingCategory::Rtti,
+                               FindingCategory::ZeroInit}) {
+        const auto info = GetCategoryInfo(category);
+
+        rules.push_back(llvm::json::Object{{"id", info.id},
+                                           {"shortDescription", llvm::json::Object{{"text", info.description}}},
+                                           {"properties", llvm::json::Object{{"costUnit", info.costUnit}}}});
+    }
+
+    llvm::json::Array results{};
+
+    for(const auto& finding : gFindings) {
+        llvm::json::Object region{{"startLine", static_cast<int64_t>(finding.line)},
+                                  {"startColumn", static_cast<int64_t>(finding.column)}};
+        llvm::json::Object location{
+            {"physicalLocation",
+             llvm::json::Object{{"artifactLocation", llvm::json::Object{{"uri", finding.file}}},
+                                {"region", std::move(region)}}}};
+
+        results.push_back(
+            llvm::json::Object{{"ruleId", GetCategoryInfo(finding.category).id},
+                               {"level", GetSeverityName(finding.severity)},
+                               {"message", llvm::json::Object{{"text", finding.message}}},
+                               {"locations", llvm::json::Array{std::move(location)}},
+                               {"properties", llvm::json::Object{{"cost", static_cast<int64_t>(finding.cost)}}}});
+    }
+
+    llvm::json::Object driver{{"name", "C++ Insights"},
+                              {"informationUri", "https://cppinsights.io"},
+                              {"rules", std::move(rules)}};
+
+    return llvm::json::Object{
+        {"version", "2.1.0"},
+        {"$schema", "https://json.schemastore.org/sarif-2.1.0.json"},
+        {"runs",
+         llvm::json::Array{llvm::json::Object{{"tool", llvm::json::Object{{"driver", std::move(driver)}}},
+                                              {"results", std::move(results)}}}}};
+}
+//-----------------------------------------------------------------------------
+
+bool WriteFindings(llvm::StringRef fileName)
+{
+    std::lock_guard lock{gFindingsMutex};
+
+    const llvm::json::Value findings{(FindingsFormat::Sarif == gFindingsFormat) ? GetFindingsSARIF()
+                                                                                   : GetFindingsJSON()};
+
+    if(fileName.empty()) {
+        llvm::errs() << llvm::formatv("{0:2}", findings) << '\n';
+        return true;
+    }
+
+    std::error_code      ec{};
+    llvm::raw_fd_ostream out{fileName, ec, llvm::sys::fs::OF_Text};
+
+    if(ec) {
+        Error("cannot write findings '%s': %s\n", fileName, ec.message());
+        return false;
+    }
+
+    out << llvm::formatv("{0:2}", findings) << '\n';
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_FINDINGS_H
+#define INSIGHTS_FINDINGS_H
+
+#include "clang/Basic/SourceLocation.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+enum class FindingsFormat
+{
+    None,
+    Sarif,
+    Json,
+};
+//-----------------------------------------------------------------------------
+
+enum class FindingSeverity
+{
+    Note,
+    Warning,
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The kind of a performance annotation, each one is a rule of its own in SARIF.
+enum class FindingCategory
+{
+    Copy,         //!< A copy or move constructor, \c --show-copies. The cost is the size of the object in bytes.
+    Allocation,   //!< A call to the allocator, \c --show-allocations. The cost is one allocation.
+    VirtualCall,  //!< An indirect call through the vtable, \c --show-virtual-calls. The cost is one call.
+    Padding,      //!< A hole in the layout of a class, \c --show-layout. The cost is the size of the hole in bytes.
+    Conversion,   //!< An implicit conversion, \c --show-casts. The cost is its \ref CastCost.
+    Guard,        //!< The guard of a static local variable, \c --show-static-init. The cost is one check per pass.
+    Atomic,       //!< An atomic operation, \c --show-atomics. The cost is one operation.
+    Rtti,         //!< A call of \c __dynamic_cast, \c --show-rtti. The cost is one call.
+    ZeroInit,     //!< A value-initialization which fills zeros, \c --show-zero-init. The cost is the size in bytes.
+};
+//-----------------------------------------------------------------------------
+
+void EnableFindings(const FindingsFormat format);
+bool IsFindingsEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Record a performance annotation at \p loc in the main file for \c --findings.
+///
+/// The annotations are recorded next to the comments they produce, the options which enable the comments decide which
+/// findings there are. A finding in a template is recorded once, not once per instantiation.
+void RecordFinding(const SourceLocation  loc,
+                   const FindingCategory category,
+                   const FindingSeverity severity,
+                   const uint64_t        cost,
+                   llvm::StringRef       message);
+//-----------------------------------------------------------------------------
+
+/// \brief Write the findings of all translation units to \p fileName, or to stderr if it is empty, as SARIF 2.1.0 or as
+/// a JSON array.
+///
+/// \returns \c false, if the file could not be written.
+bool WriteFindings(llvm::StringRef fileName);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_FINDINGS_H */
@@ -0,0 +1,457 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Demangle/Demangle.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if __has_include(<execinfo.h>) and __has_include(<dlfcn.h>)
+#include <dlfcn.h>
+#include <execinfo.h>
+#define INSIGHTS_HAS_BACKTRACE 1
+#endif
+
+#if defined(__linux__) and __has_include(<link.h>)
+#include <link.h>
+#include <unistd.h>
+#define INSIGHTS_HAS_PHDR 1
+#endif
+
+#include "DPrint.h"
+#include "InsightsHeapProfile.h"
+#include "InsightsTimeReport.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The frames of a stack trace, deeper ones are cut off.
+static constexpr size_t MAX_FRAMES{64};
+/// \brief The frames of \ref SampleHeapAllocation and \c operator \c new, they are in every stack.
+static constexpr int SKIP_FRAMES{2};
+//-----------------------------------------------------------------------------
+
+namespace {
+struct HeapSample
+{
+    std::array<void*, MAX_FRAMES> frames;
+    int                           depth;
+    std::size_t                   size;
+    TimePhase                     phase;
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static bool                     gHeapProfileEnabled{};
+static uint64_t                 gSampleRate{};
+static std::mutex               gSamplesMutex{};
+static std::vector<HeapSample>  gSamples{};
+static std::chrono::nanoseconds gStartTime{};
+
+static thread_local bool     gInSample{};          //!< Whether this thread is inside the sampling.
+static thread_local int64_t  gBytesUntilSample{};  //!< The allocated bytes after which the next sample is taken.
+static thread_local uint64_t gRandom{};            //!< The state of the random distances, 0 before the first one.
+//-----------------------------------------------------------------------------
+
+bool EnableHeapProfile(const uint64_t sampleRate)
+{
+#ifdef INSIGHTS_HAS_BACKTRACE
+    // The first call of backtrace loads the unwinder, which allocates. Do it before sampling starts.
+    std::array<void*, 1> frame{};
+    backtrace(frame.data(), static_cast<int>(frame.size()));
+
+    gSampleRate         = std::max<uint64_t>(1, sampleRate);
+    gStartTime          = std::chrono::system_clock::now().time_since_epoch();
+    gHeapProfileEnabled = true;
+
+    return true;
+#else
+    (void)sampleRate;
+
+    return false;
+#endif /* INSIGHTS_HAS_BACKTRACE */
+}
+//-----------------------------------------------------------------------------
+
+bool IsHeapProfileEnabled()
+{
+    return gHeapProfileEnabled;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief A random distance in bytes to the next sample, exponentially distributed around the sample rate.
+///
+/// A fixed distance would sample allocations which repeat with the same period always or never.
+static int64_t NextSampleDistance()
+{
+    if(0 == gRandom) {
+        gRandom = reinterpret_cast<uintptr_t>(&gRandom) | 1;
+    }
+
+    // xorshift64, it must not allocate.
+    gRandom ^= gRandom << 13;
+    gRandom ^= gRandom >> 7;
+    gRandom ^= gRandom << 17;
+
+    const double uniform{static_cast<double>((gRandom >> 11) + 1) / static_cast<double>(uint64_t{1} << 53)};
+
+    return static_cast<int64_t>(-std::log(uniform) * static_cast<double>(gSampleRate)) + 1;
+}
+//-----------------------------------------------------------------------------
+
+void SampleHeapAllocation(const std::size_t size)
+{
+#ifdef INSIGHTS_HAS_BACKTRACE
+    if(gInSample) {
+        return;
+    }
+
+    // A new thread starts with a distance, not with a sample.
+    if(0 == gRandom) {
+        gBytesUntilSample = NextSampleDistance();
+    }
+
+    gBytesUntilSample -= static_cast<int64_t>(size);
+
+    if(gBytesUntilSample > 0) {
+        return;
+    }
+
+    // From here on, the allocations of this thread are not sampled, the vector may grow.
+    gInSample         = true;
+    gBytesUntilSample = NextSampleDistance();
+
+    HeapSample sample{};
+    sample.depth = backtrace(sample.frames.data(), static_cast<int>(sample.frames.size()));
+    sample.size  = size;
+    sample.phase = GetCurrentTimePhase();
+
+    {
+        std::lock_guard lock{gSamplesMutex};
+        gSamples.push_back(sample);
+    }
+
+    gInSample = false;
+#else
+    (void)size;
+#endif /* INSIGHTS_HAS_BACKTRACE */
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief Writes the wire format of protocol buffers, only what profile.proto of pprof needs.
+class ProtoWriter
+{
+public:
+    void Varint(const uint32_t field, const uint64_t value)
+    {
+        Tag(field, 0);
+        Encode(value);
+    }
+
+    void Bytes(const uint32_t field, llvm::StringRef value)
+    {
+        Tag(field, 2);
+        Encode(value.size());
+        mBuffer.append(value.begin(), value.end());
+    }
+
+    void Message(const uint32_t field, const ProtoWriter& message) { Bytes(field, message.mBuffer); }
+
+    /// \brief A packed repeated field of varints.
+    void Packed(const uint32_t field, const std::vector<uint64_t>& values)
+    {
+        ProtoWriter packed{};
+
+        for(const auto value : values) {
+            packed.Encode(value);
+        }
+
+        Bytes(field, packed.mBuffer);
+    }
+
+    const std::string& GetBuffer() const { return mBuffer; }
+
+private:
+    void Tag(const uint32_t field, const uint32_t wireType) { Encode((uint64_t{field} << 3) | wireType); }
+
+    void Encode(uint64_t value)
+    {
+        while(value >= 0x80) {
+            mBuffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        mBuffer.push_back(static_cast<char>(value));
+    }
+
+    std::string mBuffer{};
+};
+
+struct Mapping
+{
+    uint64_t    start;
+    uint64_t    limit;
+    uint64_t    offset;
+    std::string fileName;
+};
+
+/// \brief The tables of a profile, which the samples refer to by index or id.
+class ProfileBuilder
+{
+public:
+    ProfileBuilder() { String(""); }
+
+    uint64_t String(llvm::StringRef str)
+    {
+        const auto [it, inserted] = mStrings.try_emplace(str, mStrings.size());
+
+        if(inserted) {
+            mProfile.Bytes(6, str);
+        }
+
+        return it->second;
+    }
+
+    uint64_t Function(llvm::StringRef name)
+    {
+        const auto [it, inserted] = mFunctions.try_emplace(name, mFunctions.size() + 1);
+
+        if(inserted) {
+            ProtoWriter function{};
+            function.Varint(1, it->second);
+            function.Varint(2, String(name));
+            function.Varint(3, String(name));
+            mProfile.Message(5, function);
+        }
+
+        return it->second;
+    }
+
+    /// \brief The location of the return address \p address, named if the dynamic symbol table knows its function.
+    uint64_t Location(const uintptr_t address)
+    {
+        const auto [it, inserted] = mLocations.try_emplace(address, mNextLocationId);
+
+        if(not inserted) {
+            return it->second;
+        }
+
+        ++mNextLocationId;
+
+        // The call is the instruction before the return address.
+        const uint64_t pc{address - 1};
+
+        ProtoWriter location{};
+        location.Varint(1, it->second);
+        location.Varint(3, pc);
+
+        if(const auto mappingId = FindMapping(pc)) {
+            location.Varint(2, mappingId);
+        }
+
+#ifdef INSIGHTS_HAS_BACKTRACE
+        if(Dl_info info{}; dladdr(reinterpret_cast<void*>(pc), &info) and info.dli_sname) {
+            ProtoWriter line{};
+            line.Varint(1, Function(llvm::demangle(info.dli_sname)));
+            location.Message(4, line);
+        }
+#endif /* INSIGHTS_HAS_BACKTRACE */
+
+        mProfile.Message(4, location);
+
+        return it->second;
+    }
+
+    /// \brief A location without an address for the bottom frame of the stacks of \p phase.
+    uint64_t PhaseLocation(const TimePhase phase)
+    {
+        auto& id = mPhaseLocations[static_cast<size_t>(phase)];
+
+        if(0 == id) {
+            id = mNextLocationId++;
+
+            ProtoWriter line{};
+            line.Varint(1, Function(std::string{"["} + GetTimePhaseName(phase) + "]"));
+
+            ProtoWriter location{};
+            location.Varint(1, id);
+            location.Message(4, line);
+            mProfile.Message(4, location);
+        }
+
+        return id;
+    }
+
+    void AddMapping(const Mapping& mapping)
+    {
+        mMappings.push_back(mapping);
+
+        ProtoWriter message{};
+        message.Varint(1, mMappings.size());
+        message.Varint(2, mapping.start);
+        message.Varint(3, mapping.limit);
+        message.Varint(4, mapping.offset);
+        message.Varint(5, String(mapping.fileName));
+        mProfile.Message(3, message);
+    }
+
+    ProtoWriter& GetProfile() { return mProfile; }
+
+private:
+    uint64_t FindMapping(const uint64_t address) const
+    {
+        for(size_t i = 0; i < mMappings.size(); ++i) {
+            if((mMappings[i].start <= address) and (address < mMappings[i].limit)) {
+                return i + 1;
+            }
+        }
+
+        return 0;
+    }
+
+    ProtoWriter                         mProfile{};
+    llvm::StringMap<uint64_t>           mStrings{};
+    llvm::StringMap<uint64_t>           mFunctions{};
+    llvm::DenseMap<uintptr_t, uint64_t> mLocations{};
+    uint64_t                            mNextLocationId{1};
+    std::vector<Mapping>                mMappings{};
+
+    /// \brief The bottom frame of each \ref TimePhase and of the allocations outside of all of them.
+    std::array<uint64_t, static_cast<size_t>(TimePhase::Count) + 1> mPhaseLocations{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+#ifdef INSIGHTS_HAS_PHDR
+/// \brief Add the executable segments of the binary and the shared libraries as mappings to \p builder.
+static void AddMappings(ProfileBuilder& builder)
+{
+    // The binary itself has no name in the list of loaded objects.
+    std::array<char, 4096> exe{};
+    const auto             length = readlink("/proc/self/exe", exe.data(), exe.size() - 1);
+    const std::string      exePath{exe.data(), (0 < length) ? static_cast<size_t>(length) : 0};
+
+    std::vector<Mapping> mappings{};
+
+    dl_iterate_phdr(
+        [](dl_phdr_info* info, size_t, void* data) {
+            auto& result = *static_cast<std::vector<Mapping>*>(data);
+
+            for(int i = 0; i < info->dlpi_phnum; ++i) {
+                const auto& header = info->dlpi_phdr[i];
+
+                if((PT_LOAD == header.p_type) and (header.p_flags & PF_X)) {
+                    result.push_back({info->dlpi_addr + header.p_vaddr,
+                                      info->dlpi_addr + header.p_vaddr + header.p_memsz,
+                                      header.p_offset,
+                                      info->dlpi_name ? info->dlpi_name : ""});
+                }
+            }
+
+            return 0;
+        },
+        &mappings);
+
+    for(auto& mapping : mappings) {
+        if(mapping.fileName.empty()) {
+            mapping.fileName = exePath;
+        }
+
+        builder.AddMapping(mapping);
+    }
+}
+#endif /* INSIGHTS_HAS_PHDR */
+//-----------------------------------------------------------------------------
+
+bool WriteHeapProfile(llvm::StringRef fileName)
+{
+    gHeapProfileEnabled = false;
+
+    std::vector<HeapSample> samples{};
+
+    {
+        std::lock_guard lock{gSamplesMutex};
+        samples.swap(gSamples);
+    }
+
+    ProfileBuilder builder{};
+    auto&          profile = builder.GetProfile();
+
+    // sample_type: the estimated number of allocations and their bytes.
+    for(const auto& [type, unit] : {std::pair{"alloc_objects", "count"}, std::pair{"alloc_space", "bytes"}}) {
+        ProtoWriter valueType{};
+        valueType.Varint(1, builder.String(type));
+        valueType.Varint(2, builder.String(unit));
+        profile.Message(1, valueType);
+    }
+
+#ifdef INSIGHTS_HAS_PHDR
+    AddMappings(builder);
+#endif /* INSIGHTS_HAS_PHDR */
+
+    const uint64_t phaseKey{builder.String("phase")};
+
+    for(const auto& sample : samples) {
+        std::vector<uint64_t> locations{};
+
+        for(int i = SKIP_FRAMES; i < sample.depth; ++i) {
+            locations.push_back(builder.Location(reinterpret_cast<uintptr_t>(sample.frames[static_cast<size_t>(i)])));
+        }
+
+        locations.push_back(builder.PhaseLocation(sample.phase));
+
+        // A sample stands for all the allocations of its size which were probably not sampled, as pprof expects it.
+        const double size{static_cast<double>(std::max<std::size_t>(1, sample.size))};
+        const double scale{1.0 / (1.0 - std::exp(-size / static_cast<double>(gSampleRate)))};
+
+        ProtoWriter label{};
+        label.Varint(1, phaseKey);
+        label.Varint(2, builder.String(GetTimePhaseName(sample.phase)));
+
+        ProtoWriter message{};
+        message.Packed(1, locations);
+        message.Packed(2,
+                       {static_cast<uint64_t>(std::llround(scale)), static_cast<uint64_t>(std::llround(scale * size))});
+        message.Message(3, label);
+        profile.Message(2, message);
+    }
+
+    profile.Varint(9, static_cast<uint64_t>(gStartTime.count()));
+    profile.Varint(
+        10, static_cast<uint64_t>((std::chrono::system_clock::now().time_since_epoch() - gStartTime).count()));
+
+    // period_type and period: a sample every gSampleRate bytes on average.
+    ProtoWriter periodType{};
+    periodType.Varint(1, builder.String("space"));
+    periodType.Varint(2, builder.String("bytes"));
+    profile.Message(11, periodType);
+    profile.Varint(12, gSampleRate);
+
+    std::error_code      ec{};
+    llvm::raw_fd_ostream out{fileName, ec, llvm::sys::fs::OF_None};
+
+    if(ec) {
+        Error("cannot write heap profile '%s': %s\n", fileName, ec.message());
+        return false;
+    }
+
+    out << profile.GetBuffer();
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,48 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_HEAP_PROFILE_H
+#define INSIGHTS_HEAP_PROFILE_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstddef>
+#include <cstdint>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Start sampling the heap allocations with their stack traces, see \c --heap-profile.
+///
+/// On average every \p sampleRate bytes an allocation is sampled, the distance between two samples is random, so that
+/// allocations of all sizes are found. Each sample records the \ref TimePhase it happened in, which separates the
+/// allocations of parsing from those of the handlers, the code generation and the \ref OutputFormatHelper buffers.
+///
+/// \returns \c false, if the platform cannot take stack traces.
+bool EnableHeapProfile(const uint64_t sampleRate);
+bool IsHeapProfileEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Sample the allocation of \p size bytes, called by the global \c operator \c new.
+///
+/// The allocations the sampling makes itself are not sampled.
+void SampleHeapAllocation(const std::size_t size);
+//-----------------------------------------------------------------------------
+
+/// \brief Stop sampling and write the samples to \p fileName as a pprof profile.
+///
+/// The profile has the sample types \c alloc_objects and \c alloc_space, scaled to estimate all allocations, not only
+/// the sampled ones. The bottom frame of each stack is the \ref TimePhase, the same is the label \c phase. The
+/// functions are named, if the dynamic symbol table knows them, the mappings let \c pprof symbolize the others.
+///
+/// \returns \c false, if the file could not be written.
+bool WriteHeapProfile(llvm::StringRef fileName);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_HEAP_PROFILE_H */
@@ -9,14 +9,138 @@
 #include "ClangCompat.h"
 #include "CodeGenerator.h"
 #include "DPrint.h"
+#include "Insights.h"
+#include "InsightsArena.h"
 #include "InsightsStaticStrings.h"
+#include "InsightsTrace.h"
 #include "OutputFormatHelper.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
 //-----------------------------------------------------------------------------
 
 namespace clang::insights {
 
-ScopeHandler::ScopeStackType ScopeHandler::mGlobalStack{};  // NOLINT
-std::string                  ScopeHandler::mScope{};        // NOLINT
+thread_local ScopeHandler::ScopeStackType ScopeHandler::mGlobalStack{};  // NOLINT
+thread_local std::string                  ScopeHandler::mScope{};        // NOLINT
+//-----------------------------------------------------------------------------
+
+/// \brief The names printed in one scope. They live in the arena of the translation unit.
+struct ScopeNames
+{
+    /// The names of the types, keyed by the opaque \c QualType pointer and the flags of the printing policy.
+    llvm::DenseMap<std::pair<const void*, unsigned>, StringRef> typeNames;
+    /// The template argument lists of class template specializations.
+    llvm::DenseMap<const ClassTemplateSpecializationDecl*, StringRef> templateArgs;
+    /// The qualified prefixes of declaration contexts, see \ref GetDeclContext.
+    llvm::DenseMap<const DeclContext*, StringRef> declContexts;
+    /// The qualified names of declarations with the current scope already removed.
+    llvm::DenseMap<const NamedDecl*, StringRef> qualifiedNames;
+};
+
+// The printed name depends on the current scope, see ScopeHandler::RemoveCurrentScope. The cache has therefore one map
+// per scope. The map of the current scope is looked up lazily and dropped every time the scope changes.
+static thread_local llvm::StringMap<ScopeNames> gTypeNameCache{};            // NOLINT
+static thread_local ScopeNames*                 gScopeNames{};               // NOLINT
+static std::atomic<uint64_t>                    gTypeNameCacheHits{};        // NOLINT
+static std::atomic<uint64_t>                    gTypeNameCacheMisses{};      // NOLINT
+static std::atomic<uint64_t>                    gTemplateArgsCacheHits{};    // NOLINT
+static std::atomic<uint64_t>                    gTemplateArgsCacheMisses{};  // NOLINT
+
+// Constant evaluation does not depend on the scope. A template instantiation shares the non-dependent expressions of
+// its pattern, so the same noexcept condition or literal is printed once per instantiation.
+static thread_local llvm::DenseMap<const Expr*, bool>                 gNoexceptConditions{};     // NOLINT
+static thread_local llvm::DenseMap<const FloatingLiteral*, StringRef> gFloatLiterals{};          // NOLINT
+static std::atomic<uint64_t>                                          gEvaluationCacheHits{};    // NOLINT
+static std::atomic<uint64_t>                                          gEvaluationCacheMisses{};  // NOLINT
+
+// The names built from the location of a declaration, like the one of a lambda, are asked for each time the
+// declaration is referred to.
+static thread_local llvm::DenseMap<std::pair<const Decl*, const char*>, StringRef> gLineColumnNames{};  // NOLINT
+
+// The line and column by the raw encoding of a spelling location.
+static thread_local llvm::DenseMap<unsigned, LineColumn> gLineColumns{};  // NOLINT
+
+// The typedefs of the ext_vector_types by their canonical type, collected once per translation unit.
+static thread_local llvm::DenseMap<const Type*, const TypedefNameDecl*> gExtVectorTypedefs{};     // NOLINT
+static thread_local bool                                                gHaveExtVectorTypedefs{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+static ScopeNames& GetScopeNames()
+{
+    if(nullptr == gScopeNames) {
+        gScopeNames = &gTypeNameCache[ScopeHandler::GetScopeKey()];
+    }
+
+    return *gScopeNames;
+}
+//-----------------------------------------------------------------------------
+
+TypeNameCacheStats GetTypeNameCacheStats()
+{
+    return {gTypeNameCacheHits, gTypeNameCacheMisses};
+}
+//-----------------------------------------------------------------------------
+
+TypeNameCacheStats GetTemplateArgsCacheStats()
+{
+    return {gTemplateArgsCacheHits, gTemplateArgsCacheMisses};
+}
+//-----------------------------------------------------------------------------
+
+TypeNameCacheStats GetEvaluationCacheStats()
+{
+    return {gEvaluationCacheHits, gEvaluationCacheMisses};
+}
+//-----------------------------------------------------------------------------
+
+void ResetTypeNameCache()
+{
+    gScopeNames = nullptr;
+    gTypeNameCache.clear();
+    gNoexceptConditions.clear();
+    gFloatLiterals.clear();
+    gLineColumnNames.clear();
+    gLineColumns.clear();
+    gExtVectorTypedefs.clear();
+    gHaveExtVectorTypedefs = false;
+}
+//-----------------------------------------------------------------------------
+
+LineColumn GetSpellingLineColumn(const SourceManager& sm, const SourceLocation& loc)
+{
+    auto [it, inserted] = gLineColumns.try_emplace(loc.getRawEncoding());
+
+    if(inserted) {
+        // This is what getSpellingLineNumber and getSpellingColumnNumber do, but resolving the spelling location once.
+        const auto [fileId, offset] = sm.getDecomposedSpellingLoc(loc);
+
+        it->second = {sm.getLineNumber(fileId, offset), sm.getColumnNumber(fileId, offset)};
+    }
+
+    return it->second;
+}
+//-----------------------------------------------------------------------------
+
+StringRef GetCachedTemplateArgs(const ClassTemplateSpecializationDecl& decl, llvm::function_ref<std::string()> print)
+{
+    if(const auto& templateArgs = GetScopeNames().templateArgs; templateArgs.count(&decl)) {
+        ++gTemplateArgsCacheHits;
+        return templateArgs.lookup(&decl);
+    }
+
+    ++gTemplateArgsCacheMisses;
+
+    // Printing can print other argument lists and with that extend the map, look the map up again afterwards.
+    const StringRef args = SaveInArena(print());
+    GetScopeNames().templateArgs[&decl] = args;
+
+    return args;
+}
 //-----------------------------------------------------------------------------
 
 ScopeHandler::ScopeHandler(const Decl* d)
@@ -24,6 +148,7 @@ ScopeHandler::ScopeHandler(const Decl* d)
 , mHelper{mScope.length()}
 {
     mStack.push(mHelper);
+    gScopeNames = nullptr;
 
     if(const auto* recordDecl = dyn_cast_or_null<CXXRecordDecl>(d)) {
         mScope.append(GetName(*recordDecl));
@@ -42,6 +167,8 @@ ScopeHandler::ScopeHandler(const Decl* d)
     if(not mScope.empty()) {
         mScope.append("::");
     }
+
+    gScopeNames = nullptr;
 }
 //-----------------------------------------------------------------------------
 
@@ -49,14 +176,34 @@ ScopeHandler::~ScopeHandler()
 {
     const auto length = mStack.pop()->mLength;
     mScope.resize(length);
+
+    gScopeNames = nullptr;
+}
+//-----------------------------------------------------------------------------
+
+std::string ScopeHandler::GetScopeKey()
+{
+    // RemoveCurrentScope uses the entire scope and, as a fallback, the part of it before the last item.
+    const size_t lastItemStart = mGlobalStack.empty() ? 0 : mGlobalStack.back().mLength;
+
+    return StrCat(mScope, "\n", lastItemStart);
 }
 //-----------------------------------------------------------------------------
 
 std::string ScopeHandler::RemoveCurrentScope(std::string name)
 {
-    auto findAndReplace = [&name](const std::string& scope) {
-        if(const auto startPos = name.find(scope, 0); std::string::npos != startPos) {
-            name.replace(startPos, scope.length(), "");
+    // At file scope there is nothing to remove.
+    if(mScope.empty()) {
+        return name;
+    }
+
+    auto findAndReplace = [&name](const size_t length) {
+        if(0 == length) {
+            return true;
+        }
+
+        if(const auto startPos = name.find(mScope.data(), 0, length); std::string::npos != startPos) {
+            name.erase(startPos, length);
             return true;
         }
 
@@ -65,13 +212,11 @@ std::string ScopeHandler::RemoveCurrentScope(std::string name)
 
     // The default is that we can replace the entire scope. Suppose we are currently in N::X and having a symbol N::X::y
     // then N::X:: is removed.
-    if(not findAndReplace(mScope)) {
-
-        // A special case where we need to remove the scope without the last item.
-        std::string tmp{mScope};
-        tmp.resize(mGlobalStack.back().mLength);
+    if(not findAndReplace(mScope.length())) {
 
-        findAndReplace(tmp);
+        // A special case where we need to remove the scope without the last item, which is a prefix of the entire
+        // scope.
+        findAndReplace(mGlobalStack.back().mLength);
     }
 
     return name;
@@ -166,41 +311,61 @@ std::string GetNestedName(const NestedNameSpecifier* nns)
 }
 //-----------------------------------------------------------------------------
 
-static std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
+/// \brief Turn the names clang makes up for unnamed template type parameters, \c type-parameter-D-I, into the
+/// identifiers \c type_parameter_D_I. Only the dashes of these names are replaced, in place.
+static std::string ReplaceDash(std::string&& str)
 {
-    if(Contains(str, "type-parameter-")) {
-        for(size_t startPos = 0; (startPos = str.find(from, startPos)) != std::string::npos; startPos += to.length()) {
-            str.replace(startPos, from.length(), to);
+    static constexpr char typeParameter[]{"type-parameter-"};
+
+    for(auto pos = str.find(typeParameter); std::string::npos != pos; pos = str.find(typeParameter, pos)) {
+        str[pos + 4]  = '_';
+        str[pos + 14] = '_';
+        pos += sizeof(typeParameter) - 1;
+
+        // The dash between the depth and the index.
+        while((pos < str.size()) and llvm::isDigit(str[pos])) {
+            ++pos;
+        }
+
+        if((pos < str.size()) and ('-' == str[pos])) {
+            str[pos] = '_';
         }
     }
 
-    return str;
+    return std::move(str);
 }
 //-----------------------------------------------------------------------------
 
-static std::string ReplaceDash(std::string&& str)
+/// \brief Print \p t with clang's type printer, for the types \c SimpleTypePrinter does not handle.
+///
+/// \c SimpleTypePrinter emits \c type_parameter_D_I itself. Only an instantiation dependent type, like \c
+/// decltype(sizeof(T)), can still contain a \c type-parameter-D-I from clang's printer, all other types skip the
+/// post-processing.
+static std::string GetAsCPPStyleString(const QualType& t, const CppInsightsPrintingPolicy& printingPolicy)
 {
-    return ReplaceAll(std::move(str), "-", "_");
-}
-//-----------------------------------------------------------------------------
+    if(not t->isInstantiationDependentType()) {
+        return t.getAsString(printingPolicy);
+    }
 
-static const std::string GetAsCPPStyleString(const QualType& t, const CppInsightsPrintingPolicy& printingPolicy)
-{
     return ReplaceDash(t.getAsString(printingPolicy));
 }
 //-----------------------------------------------------------------------------
 
-std::string BuildInternalVarName(const std::string& varName)
+std::string BuildInternalVarName(StringRef varName)
 {
     return StrCat("__", varName);
 }
 //-----------------------------------------------------------------------------
 
-static std::string BuildInternalVarName(const std::string& varName, const SourceLocation& loc, const SourceManager& sm)
+std::string GetUnnamedParameterName(const ParmVarDecl& param)
 {
-    const auto lineNo = sm.getSpellingLineNumber(loc);
+    return BuildInternalVarName(StrCat("param", param.getFunctionScopeIndex()));
+}
+//-----------------------------------------------------------------------------
 
-    return StrCat(BuildInternalVarName(varName), lineNo);
+static std::string BuildInternalVarName(StringRef varName, const SourceLocation& loc, const SourceManager& sm)
+{
+    return StrCat(BuildInternalVarName(varName), GetSpellingLineColumn(sm, loc).line);
 }
 //-----------------------------------------------------------------------------
 
@@ -210,12 +375,155 @@ static const LangOptions& GetLangOpts(const ast_matchers::MatchFinder::MatchResu
 }
 //-----------------------------------------------------------------------------
 
+/// \brief The raw tokens of the main file. Each handler looks for the token following a declaration, with many
+/// declarations that is cheaper as a lookup than lexing around each of them.
+struct TokenIndex
+{
+    struct Entry
+    {
+        unsigned       begin;  //!< The offset of the token in the main file.
+        unsigned       end;    //!< The offset behind the token.
+        tok::TokenKind kind;
+    };
+
+    const SourceManager* sm{};
+    FileID               fileId{};
+    std::vector<Entry>   tokens{};
+};
+
+static thread_local TokenIndex gTokenIndex{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+void ResetTokenIndex()
+{
+    gTokenIndex = {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The kinds of the files of the translation unit by the ID of their \c FileID. The files loaded from a PCH or a
+/// module have negative IDs, they get an array of their own.
+struct FileKindCache
+{
+    const SourceManager*  sm{};
+    std::vector<FileKind> local{};
+    std::vector<FileKind> loaded{};
+};
+
+static thread_local FileKindCache gFileKindCache{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+void ResetFileKindCache()
+{
+    gFileKindCache = {};
+}
+//-----------------------------------------------------------------------------
+
+FileKind GetFileKind(const SourceManager& sm, const SourceLocation& loc)
+{
+    if(loc.isInvalid()) {
+        return FileKind::Unknown;
+    }
+
+    if(&sm != gFileKindCache.sm) {
+        ResetFileKindCache();
+        gFileKindCache.sm = &sm;
+    }
+
+    const auto expansionLoc = sm.getExpansionLoc(loc);
+    const auto fileId       = sm.getFileID(expansionLoc);
+    const auto id           = static_cast<int>(fileId.getHashValue());
+    auto&      kinds        = (0 <= id) ? gFileKindCache.local : gFileKindCache.loaded;
+    const auto index        = static_cast<size_t>((0 <= id) ? id : -id);
+
+    if(index >= kinds.size()) {
+        kinds.resize(index + 1, FileKind::Unknown);
+    }
+
+    auto& kind = kinds[index];
+
+    if(FileKind::Unknown == kind) {
+        if(fileId == sm.getMainFileID()) {
+            kind = FileKind::MainFile;
+        } else if(sm.isInSystemHeader(expansionLoc)) {
+            kind = FileKind::SystemHeader;
+        } else {
+            kind = FileKind::Other;
+        }
+    }
+
+    return kind;
+}
+//-----------------------------------------------------------------------------
+
+static const TokenIndex& GetTokenIndex(const SourceManager& sm, const LangOptions& langOpts)
+{
+    if((&sm == gTokenIndex.sm) and (sm.getMainFileID() == gTokenIndex.fileId)) {
+        return gTokenIndex;
+    }
+
+    gTokenIndex.sm     = &sm;
+    gTokenIndex.fileId = sm.getMainFileID();
+    gTokenIndex.tokens.clear();
+
+    const StringRef buffer = sm.getBufferData(gTokenIndex.fileId);
+
+    // The same raw lexing Lexer::findLocationAfterToken does, only once for the entire file.
+    Lexer lexer{sm.getLocForStartOfFile(gTokenIndex.fileId), langOpts, buffer.begin(), buffer.begin(), buffer.end()};
+
+    for(Token token{};;) {
+        const bool atEnd = lexer.LexFromRawLexer(token);
+
+        if(token.is(tok::eof)) {
+            break;
+        }
+
+        const unsigned begin = sm.getFileOffset(token.getLocation());
+        gTokenIndex.tokens.push_back({begin, begin + token.getLength(), token.getKind()});
+
+        if(atEnd) {
+            break;
+        }
+    }
+
+    return gTokenIndex;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Same as \c Lexer::findLocationAfterToken, but with a lookup into the \ref TokenIndex for locations in the
+/// main file.
+static SourceLocation FindLocationAfterToken(const SourceLocation loc,
+                                             const tok::TokenKind tKind,
+                                             const SourceManager& sm,
+                                             const LangOptions&   langOpts)
+{
+    if(loc.isFileID() and (sm.getFileID(loc) == sm.getMainFileID())) {
+        const auto& tokens = GetTokenIndex(sm, langOpts).tokens;
+        const auto  offset = sm.getFileOffset(loc);
+
+        const auto it = std::lower_bound(tokens.begin(), tokens.end(), offset, [](const auto& token, unsigned value) {
+            return token.begin < value;
+        });
+
+        // Only a location at the start of a token can be looked up, everything else is for the Lexer.
+        if((tokens.end() != it) and (it->begin == offset)) {
+            if(const auto next = std::next(it); (tokens.end() != next) and (next->kind == tKind)) {
+                return sm.getLocForStartOfFile(gTokenIndex.fileId).getLocWithOffset(next->end);
+            }
+
+            return {};
+        }
+    }
+
+    return clang::Lexer::findLocationAfterToken(loc, tKind, sm, langOpts, false);
+}
+//-----------------------------------------------------------------------------
+
 SourceLocation FindLocationAfterSemi(const SourceLocation                          loc,
                                      const ast_matchers::MatchFinder::MatchResult& result,
                                      RequireSemi                                   requireSemi)
 {
     auto findLocation = [&](const tok::TokenKind tKind) {
-        return clang::Lexer::findLocationAfterToken(loc, tKind, GetSM(result), GetLangOpts(result), false);
+        return FindLocationAfterToken(loc, tKind, GetSM(result), GetLangOpts(result));
     };
 
     if(const auto locEnd{findLocation(tok::semi)}; locEnd.isValid()) {
@@ -288,28 +596,50 @@ static void InsertAfter(std::string& source, const std::string& find, const std:
 }
 //-----------------------------------------------------------------------------
 
-static std::string MakeLineColumnName(const Decl& decl, const std::string& prefix)
+/// \brief The name \p prefix followed by the line and column of \p decl. The prefix must be a string literal, it is
+/// part of the key.
+static StringRef MakeLineColumnName(const Decl& decl, const char* prefix)
 {
-    const auto& sm       = GetSM(decl);
-    const auto  locBegin = GetBeginLoc(decl);
-    const auto  lineNo   = sm.getSpellingLineNumber(locBegin);
-    const auto  columnNo = sm.getSpellingColumnNumber(locBegin);
+    auto& name = gLineColumnNames[{&decl, prefix}];
+
+    if(name.empty()) {
+        const auto [lineNo, columnNo] = GetSpellingLineColumn(GetSM(decl), GetBeginLoc(decl));
+
+        name = SaveInArena(StrCat(prefix, lineNo, "_", columnNo));
+    }
+
+    return name;
+}
+//-----------------------------------------------------------------------------
 
-    return StrCat(prefix, lineNo, "_", columnNo);
+StringRef GetLambdaName(const CXXRecordDecl& lambda)
+{
+    return MakeLineColumnName(lambda, "__lambda_");
 }
 //-----------------------------------------------------------------------------
 
-std::string GetLambdaName(const CXXRecordDecl& lambda)
+StringRef BuildRetTypeName(const Decl& decl)
 {
-    static const std::string lambdaPrefix{"__lambda_"};
-    return MakeLineColumnName(lambda, lambdaPrefix);
+    return MakeLineColumnName(decl, "retType_");
 }
 //-----------------------------------------------------------------------------
 
-std::string BuildRetTypeName(const Decl& decl)
+std::string GetVectorLanes(const QualType& t)
 {
-    static const std::string retTypePrefix{"retType_"};
-    return MakeLineColumnName(decl, retTypePrefix);
+    if(t.isNull()) {
+        return {};
+    }
+
+    if(const auto* vector = t->getAs<VectorType>()) {
+        return StrCat(vector->getNumElements(),
+                      " x ",
+                      GetName(vector->getElementType()),
+                      ", ",
+                      GetGlobalAST().getTypeSize(t),
+                      " bits");
+    }
+
+    return {};
 }
 //-----------------------------------------------------------------------------
 
@@ -330,6 +660,13 @@ const QualType GetDesugarType(const QualType& QT)
 
 const std::string EvaluateAsFloat(const FloatingLiteral& expr)
 {
+    if(const auto it = gFloatLiterals.find(&expr); gFloatLiterals.end() != it) {
+        ++gEvaluationCacheHits;
+        return it->second.str();
+    }
+
+    ++gEvaluationCacheMisses;
+
     SmallString<16> str{};
     expr.getValue().toString(str);
 
@@ -339,6 +676,8 @@ const std::string EvaluateAsFloat(const FloatingLiteral& expr)
         str.append(".0");
     }
 
+    gFloatLiterals[&expr] = SaveInArena(str.str());
+
     return str.str();
 }
 //-----------------------------------------------------------------------------
@@ -360,7 +699,7 @@ std::string GetNameAsWritten(const QualType& t)
 //-----------------------------------------------------------------------------
 
 // own implementation due to lambdas
-std::string GetDeclContext(const DeclContext* ctx)
+static std::string BuildDeclContext(const DeclContext* ctx)
 {
     OutputFormatHelper                 mOutputFormatHelper{};
     SmallVector<const DeclContext*, 8> contexts{};
@@ -414,6 +753,22 @@ std::string GetDeclContext(const DeclContext* ctx)
 }
 //-----------------------------------------------------------------------------
 
+std::string GetDeclContext(const DeclContext* ctx)
+{
+    // The template arguments of the enclosing specializations are printed relative to the current scope, so the prefix
+    // is cached per scope like all other names.
+    if(const auto& declContexts = GetScopeNames().declContexts; declContexts.count(ctx)) {
+        return declContexts.lookup(ctx).str();
+    }
+
+    // Building the prefix can build other prefixes and with that extend the map, look the map up again afterwards.
+    std::string prefix{BuildDeclContext(ctx)};
+    GetScopeNames().declContexts[ctx] = SaveInArena(prefix);
+
+    return prefix;
+}
+//-----------------------------------------------------------------------------
+
 namespace details {
 
 STRONG_BOOL(RemoveCurrentScope);  ///!< In some cases we need to keep the scope for a while, so don't remove the scope
@@ -423,15 +778,19 @@ STRONG_BOOL(RemoveCurrentScope);  ///!< In some cases we need to keep the scope
 static std::string GetQualifiedName(const NamedDecl&         decl,
                                     const RemoveCurrentScope removeCurrentScope = RemoveCurrentScope::Yes)
 {
-    std::string scope{GetDeclContext(decl.getDeclContext())};
-
-    scope += decl.getName().str();
+    if(RemoveCurrentScope::No == removeCurrentScope) {
+        return StrCat(GetDeclContext(decl.getDeclContext()), decl.getName());
+    }
 
-    if(RemoveCurrentScope::Yes == removeCurrentScope) {
-        return ScopeHandler::RemoveCurrentScope(scope);
+    // The name without the current scope only depends on the scope, build it once per scope.
+    if(const auto& qualifiedNames = GetScopeNames().qualifiedNames; qualifiedNames.count(&decl)) {
+        return qualifiedNames.lookup(&decl).str();
     }
 
-    return scope;
+    std::string name{ScopeHandler::RemoveCurrentScope(StrCat(GetDeclContext(decl.getDeclContext()), decl.getName()))};
+    GetScopeNames().qualifiedNames[&decl] = SaveInArena(name);
+
+    return name;
 }
 //-----------------------------------------------------------------------------
 
@@ -458,6 +817,41 @@ static std::string GetScope(const DeclContext*       declCtx,
 }
 //-----------------------------------------------------------------------------
 
+static void CollectExtVectorTypedefs(const DeclContext& ctx)
+{
+    for(const auto* decl : ctx.decls()) {
+        if(const auto* typedefDecl = dyn_cast_or_null<TypedefNameDecl>(decl)) {
+            const auto type = typedefDecl->getUnderlyingType().getCanonicalType();
+
+            if(isa<ExtVectorType>(type)) {
+                gExtVectorTypedefs.try_emplace(type.getTypePtr(), typedefDecl);
+            }
+
+        } else if(isa<NamespaceDecl>(decl) or isa<LinkageSpecDecl>(decl)) {
+            CollectExtVectorTypedefs(*cast<DeclContext>(decl));
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The first typedef which names the ext_vector_type \p type, \c nullptr if there is none.
+static const TypedefNameDecl* GetExtVectorTypedef(const ExtVectorType& type)
+{
+    if(not gHaveExtVectorTypedefs) {
+        gHaveExtVectorTypedefs = true;
+        CollectExtVectorTypedefs(*GetGlobalAST().getTranslationUnitDecl());
+    }
+
+    const auto* canonicalType = type.getCanonicalTypeInternal().getTypePtr();
+
+    if(const auto it = gExtVectorTypedefs.find(canonicalType); it != gExtVectorTypedefs.end()) {
+        return it->second;
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
 /// \brief SimpleTypePrinter a partially substitution of Clang's TypePrinter.
 ///
 /// With Clang 9 there seems to be a change in `lib/AST/TypePrinter.cpp` in `printTemplateTypeParmBefore`. It now
@@ -705,6 +1099,19 @@ private:
         return ret;
     }
 
+    bool HandleType(const ExtVectorType* type)
+    {
+        // The attribute ext_vector_type applies only to typedefs. A vector which lost its sugar can only be spelled by
+        // one of them.
+        if(const auto* typedefDecl = GetExtVectorTypedef(*type)) {
+            mData.Append(GetName(*typedefDecl));
+
+            return true;
+        }
+
+        return false;
+    }
+
     bool HandleType(const PackExpansionType* type)
     {
         const bool ret = HandleType(type->getPattern().getTypePtrOrNull());
@@ -761,6 +1168,7 @@ private:
         HANDLE_TYPE(BuiltinType);
         HANDLE_TYPE(TypedefType);
         HANDLE_TYPE(ConstantArrayType);
+        HANDLE_TYPE(ExtVectorType);
         HANDLE_TYPE(InjectedClassNameType);
         HANDLE_TYPE(DependentTemplateSpecializationType);
         HANDLE_TYPE(PackExpansionType);
@@ -804,7 +1212,16 @@ public:
 
     bool GetTypeString()
     {
-        if(const SplitQualType splitted{mType.split()}; splitted.Quals.empty()) {
+        // A restrict qualifies the pointer itself, it goes after the *, like in int *__restrict.
+        const bool isRestrictPointer{mType.isLocalRestrictQualified() and isa<PointerType>(mType.getTypePtrOrNull())};
+
+        SplitQualType splitted{mType.split()};
+
+        if(isRestrictPointer) {
+            splitted.Quals.removeRestrict();
+        }
+
+        if(splitted.Quals.empty()) {
             AddCVQualifiers(mType.getCanonicalType()->getPointeeType().getLocalQualifiers());
         } else {
             AddCVQualifiers(splitted.Quals);
@@ -815,21 +1232,31 @@ public:
         mData.Append(mDataAfter);
 
         // Take care of 'char* const'
-        if(mType.getQualifiers().hasFastQualifiers()) {
-            const QualType fastQualifierType{typePtr, mType.getQualifiers().getFastQualifiers()};
+        auto qualifiers = mType.getQualifiers();
+
+        if(isRestrictPointer) {
+            qualifiers.removeRestrict();
+        }
+
+        if(qualifiers.hasFastQualifiers()) {
+            const QualType fastQualifierType{typePtr, qualifiers.getFastQualifiers()};
 
             mSkipSpace = true;
             AddCVQualifiers(fastQualifierType.getCanonicalType()->getPointeeType().getLocalQualifiers());
         }
 
+        if(isRestrictPointer) {
+            mData.Append(StringRef{mData.GetString()}.endswith("*") ? "" : " ", "__restrict");
+        }
+
         return mHasData;
     }
 };
 //-----------------------------------------------------------------------------
 
-static std::string GetName(const QualType&             t,
-                           const Unqualified           unqualified  = Unqualified::No,
-                           const InsightsSuppressScope supressScope = InsightsSuppressScope::No)
+static std::string PrintName(const QualType&             t,
+                             const Unqualified           unqualified,
+                             const InsightsSuppressScope supressScope)
 {
     const CppInsightsPrintingPolicy printingPolicy{unqualified, supressScope};
 
@@ -842,6 +1269,117 @@ static std::string GetName(const QualType&             t,
 
     return ScopeHandler::RemoveCurrentScope(GetAsCPPStyleString(t, printingPolicy));
 }
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p t has no other local qualifiers than \c const and \c volatile.
+static bool HasOnlyCVQualifiers(const QualType& t)
+{
+    return not t.hasLocalNonFastQualifiers() and not t.isLocalRestrictQualified();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The name of an unsugared builtin type, like \c int, or of a pointer or reference to one without building the
+/// printing policy and running the type printer.
+///
+/// These are by far the most frequently printed types. Their name does not depend on the current scope and the result
+/// is the same as the one of clang's \c TypePrinter, for example \c const char *const. Everything else, including a
+/// typedef of a builtin type, returns \c false.
+static bool GetBuiltinName(std::string& name, const QualType& t, const Unqualified unqualified)
+{
+    static const CppInsightsPrintingPolicy printingPolicy{};
+
+    const auto appendBuiltin = [&](const QualType& builtinType) {
+        const auto* builtin = dyn_cast_or_null<BuiltinType>(builtinType.getTypePtrOrNull());
+
+        if((nullptr == builtin) or builtin->isPlaceholderType() or builtin->isDependentType() or
+           not HasOnlyCVQualifiers(builtinType)) {
+            return false;
+        }
+
+        if(builtinType.isLocalConstQualified()) {
+            name.append("const ");
+        }
+
+        if(builtinType.isLocalVolatileQualified()) {
+            name.append("volatile ");
+        }
+
+        name.append(builtin->getName(printingPolicy));
+
+        return true;
+    };
+
+    if(t.isNull() or not HasOnlyCVQualifiers(t)) {
+        return false;
+    }
+
+    if(isa<BuiltinType>(t.getTypePtr())) {
+        return appendBuiltin((Unqualified::Yes == unqualified) ? t.getLocalUnqualifiedType() : t);
+    }
+
+    if(const auto* ref = dyn_cast<ReferenceType>(t.getTypePtr())) {
+        if(not appendBuiltin(ref->getPointeeTypeAsWritten())) {
+            return false;
+        }
+
+        name.append(isa<LValueReferenceType>(ref) ? " &" : " &&");
+
+        return true;
+    }
+
+    if(const auto* pointer = dyn_cast<PointerType>(t.getTypePtr())) {
+        if(not appendBuiltin(pointer->getPointeeType())) {
+            return false;
+        }
+
+        name.append(" *");
+
+        if(Unqualified::No == unqualified) {
+            if(t.isLocalConstQualified()) {
+                name.append("const");
+            }
+
+            if(t.isLocalVolatileQualified()) {
+                name.append(t.isLocalConstQualified() ? " volatile" : "volatile");
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetName(const QualType&             t,
+                           const Unqualified           unqualified  = Unqualified::No,
+                           const InsightsSuppressScope supressScope = InsightsSuppressScope::No)
+{
+    // Builtin types are spelled the same everywhere, there is no need to look them up in the cache of the scope.
+    if(std::string name{}; GetBuiltinName(name, t, unqualified)) {
+        ++gTypeNameCacheHits;
+        return name;
+    }
+
+    const std::pair<const void*, unsigned> key{
+        t.getAsOpaquePtr(),
+        (static_cast<unsigned>(unqualified) << 1) | static_cast<unsigned>(supressScope)};
+
+    // Printing can print other types and with that extend the map, don't keep an iterator.
+    auto& typeNames = GetScopeNames().typeNames;
+
+    if(const auto it = typeNames.find(key); typeNames.end() != it) {
+        ++gTypeNameCacheHits;
+        return it->second.str();
+    }
+
+    ++gTypeNameCacheMisses;
+
+    auto name = PrintName(t, unqualified, supressScope);
+    typeNames[key] = SaveInArena(name);
+
+    return name;
+}
 }  // namespace details
 //-----------------------------------------------------------------------------
 
@@ -872,6 +1410,8 @@ static bool NeedsNamespace(const Decl& decl, UseLexicalParent useLexicalParent)
 
 std::string GetName(const NamedDecl& nd)
 {
+    DeclTraceScope timeTrace{"GetName", &nd};
+
     std::string name{};
 
     if(NeedsNamespace(nd, UseLexicalParent::No)) {
@@ -887,7 +1427,7 @@ std::string GetName(const NamedDecl& nd)
 std::string GetName(const CXXRecordDecl& RD)
 {
     if(RD.isLambda()) {
-        return GetLambdaName(RD);
+        return GetLambdaName(RD).str();
     }
 
     // get the namespace as well
@@ -905,6 +1445,8 @@ std::string GetName(const CXXRecordDecl& RD)
 
 std::string GetName(const QualType& t, const Unqualified unqualified)
 {
+    TypeTraceScope timeTrace{"GetName", t};
+
     return details::GetName(t, unqualified);
 }
 //-----------------------------------------------------------------------------
@@ -938,6 +1480,8 @@ static bool HasTypeWithSubType(const QualType& t)
 
 std::string GetTypeNameAsParameter(const QualType& t, const std::string& varName, const Unqualified unqualified)
 {
+    TypeTraceScope timeTrace{"GetTypeNameAsParameter", t};
+
     const bool isFunctionPointer = HasTypeWithSubType<ReferenceType, FunctionProtoType>(t);
     const bool isArrayRef        = HasTypeWithSubType<ReferenceType, ArrayType>(t);
     // Special case for Issue81, auto returns an array-ref and to catch auto deducing an array (Issue106)
@@ -1021,7 +1565,9 @@ bool IsTrivialStaticClassVarDecl(const VarDecl& varDecl)
     if(varDecl.isStaticLocal()) {
         if(const auto* cxxRecordDecl = varDecl.getType()->getAsCXXRecordDecl()) {
             if(cxxRecordDecl->hasNonTrivialDestructor() || cxxRecordDecl->hasNonTrivialDefaultConstructor()) {
-                return true;
+                // With a constant initializer there is nothing left to guard, unless a destructor must be registered.
+                return not GetInsightsOptions().ShowStaticInit or cxxRecordDecl->hasNonTrivialDestructor() or
+                       not IsConstantInitialized(varDecl);
             }
         }
     }
@@ -1030,6 +1576,44 @@ bool IsTrivialStaticClassVarDecl(const VarDecl& varDecl)
 }
 //-----------------------------------------------------------------------------
 
+bool IsConstantInitialized(const VarDecl& varDecl)
+{
+    const auto* init = varDecl.getInit();
+
+    if(not init or init->isValueDependent()) {
+        return false;
+    }
+
+    return nullptr != varDecl.evaluateValue();
+}
+//-----------------------------------------------------------------------------
+
+bool IsThreadLocalWithWrapper(const VarDecl& varDecl)
+{
+    if(not GetInsightsOptions().ShowThreadLocal or (VarDecl::TLS_Dynamic != varDecl.getTLSKind()) or
+       not varDecl.getDeclContext()->isFileContext() or varDecl.getDeclContext()->isDependentContext()) {
+        return false;
+    }
+
+    // An extern declaration is accessed through the wrapper as well, whether there is one depends on the definition.
+    const auto* definition = varDecl.getDefinition();
+
+    if(not definition or not definition->hasInit()) {
+        return false;
+    }
+
+    const auto* cxxRecordDecl = definition->getType()->getAsCXXRecordDecl();
+
+    return not IsConstantInitialized(*definition) or (cxxRecordDecl and cxxRecordDecl->hasNonTrivialDestructor());
+}
+//-----------------------------------------------------------------------------
+
+std::string BuildThreadLocalWrapperName(StringRef varName)
+{
+    return StrCat(BuildInternalVarName(varName), "TlsWrapper");
+}
+//-----------------------------------------------------------------------------
+
 static const SubstTemplateTypeParmType* GetSubstTemplateTypeParmType(const Type* t)
 {
     if(const auto* substTemplateTypeParmType = dyn_cast_or_null<SubstTemplateTypeParmType>(t)) {
@@ -1100,6 +1684,11 @@ std::string GetName(const DeclRefExpr& declRefExpr)
     if(needsNamespace || not declRefExpr.hasQualifier()) {
         std::string plainName{GetPlainName(declRefExpr)};
 
+        // Only a body the compiler synthesized refers to an unnamed parameter.
+        if(const auto* parmVarDecl = dyn_cast_or_null<ParmVarDecl>(declRefDecl); parmVarDecl and plainName.empty()) {
+            plainName = GetUnnamedParameterName(*parmVarDecl);
+        }
+
         // try to handle the special case of a function local static with class type and non trivial destructor. In
         // this case, as we teared that variable apart, we need to adjust the variable named and add a reinterpret
         // cast
@@ -1180,10 +1769,19 @@ std::string GetName(const VarDecl& VD)
 
 static bool EvaluateAsBoolenCondition(const Expr& expr, const Decl& decl)
 {
+    if(const auto it = gNoexceptConditions.find(&expr); gNoexceptConditions.end() != it) {
+        ++gEvaluationCacheHits;
+        return it->second;
+    }
+
+    ++gEvaluationCacheMisses;
+
     bool r{false};
 
     expr.EvaluateAsBooleanCondition(r, decl.getASTContext());
 
+    gNoexceptConditions[&expr] = r;
+
     return r;
 }
 //-----------------------------------------------------------------------------
@@ -29,7 +29,12 @@ static inline bool IsNewLine(const char c)
 }
 //-----------------------------------------------------------------------------
 
-std::string BuildInternalVarName(const std::string& varName);
+std::string BuildInternalVarName(StringRef varName);
+//-----------------------------------------------------------------------------
+
+/// \brief The name of the unnamed parameter \p param where a synthesized body, like the one of a defaulted comparison,
+/// refers to it.
+std::string GetUnnamedParameterName(const ParmVarDecl& param);
 //-----------------------------------------------------------------------------
 
 STRONG_BOOL(RequireSemi);
@@ -41,6 +46,10 @@ SourceLocation FindLocationAfterSemi(const SourceLocation
 SourceRange    GetSourceRangeAfterSemi(const SourceRange                             range,
                                        const ast_matchers::MatchFinder::MatchResult& Result,
                                        RequireSemi                                   requireSemi = RequireSemi::No);
+
+/// \brief Drop the token index of the main file \ref FindLocationAfterSemi uses. Must be called for every new
+/// translation unit.
+void ResetTokenIndex();
 //-----------------------------------------------------------------------------
 
 static inline bool IsMacroLocation(const SourceLocation& loc)
@@ -81,7 +90,41 @@ static inline bool IsInvalidLocation(const T& t, Args... args)
 }
 //-----------------------------------------------------------------------------
 
-std::string BuildRetTypeName(const Decl& decl);
+/// \brief The kind of file a location of the translation unit expands into.
+enum class FileKind : uint8_t
+{
+    Unknown,  //!< Not computed yet.
+    MainFile,
+    SystemHeader,
+    Other,
+};
+
+/// \brief The kind of the file \p loc expands into, \c FileKind::Unknown for an invalid location.
+///
+/// The matchers and the handlers ask this for nearly every node. Instead of the lookups of the file characteristic
+/// in the \c SourceManager for each of them, the kind is computed once per \c FileID and kept in a flat array.
+FileKind GetFileKind(const SourceManager& sm, const SourceLocation& loc);
+
+static inline bool IsExpansionInSystemHeader(const SourceManager& sm, const SourceLocation& loc)
+{
+    return FileKind::SystemHeader == GetFileKind(sm, loc);
+}
+//-----------------------------------------------------------------------------
+
+static inline bool IsExpansionInMainFile(const SourceManager& sm, const SourceLocation& loc)
+{
+    return FileKind::MainFile == GetFileKind(sm, loc);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Drop the file kinds \ref GetFileKind keeps. Must be called before every new translation unit is parsed or
+/// transformed.
+void ResetFileKindCache();
+//-----------------------------------------------------------------------------
+
+/// \brief The name of the type alias for the return type of \p decl. It is computed once per declaration and lives in
+/// the arena of the translation unit.
+StringRef BuildRetTypeName(const Decl& decl);
 //-----------------------------------------------------------------------------
 
 #define SKIP_MACRO_LOCATION(...)                                                                                       \
@@ -115,6 +158,17 @@ static inline const SourceManager& GetSM(const Decl& decl)
 }
 //-----------------------------------------------------------------------------
 
+struct LineColumn
+{
+    unsigned line{};
+    unsigned column{};
+};
+
+/// \brief The spelling line and column of \p loc. Both are resolved together and are cached per translation unit until
+/// \ref ResetTypeNameCache, the made up names of lambdas, temporaries and the like ask for the same locations again.
+LineColumn GetSpellingLineColumn(const SourceManager& sm, const SourceLocation& loc);
+//-----------------------------------------------------------------------------
+
 static inline const LangOptions& GetLangOpts(const Decl& decl)
 {
     return decl.getASTContext().getLangOpts();
@@ -124,6 +178,16 @@ static inline const LangOptions& GetLangOpts(const Decl& decl)
 std::string GetNameAsWritten(const QualType& t);
 
 bool IsTrivialStaticClassVarDecl(const VarDecl& varDecl);
+
+/// \brief Whether the initializer of \p varDecl is a constant expression, which the compiler evaluates at compile time.
+bool IsConstantInitialized(const VarDecl& varDecl);
+
+/// \brief Whether each access of the namespace-scope \c thread_local \p varDecl calls a wrapper function which
+/// initializes it in the current thread first, see \c --show-thread-local.
+bool IsThreadLocalWithWrapper(const VarDecl& varDecl);
+
+/// \brief The name of the wrapper function of a \c thread_local, see \ref IsThreadLocalWithWrapper.
+std::string BuildThreadLocalWrapperName(StringRef varName);
 //-----------------------------------------------------------------------------
 
 /*
@@ -141,9 +205,11 @@ std::string GetName(const NamedDecl& ND);
 std::string GetNameAsFunctionPointer(const QualType& t);
 //-----------------------------------------------------------------------------
 
-std::string GetLambdaName(const CXXRecordDecl& lambda);
+/// \brief The name of the closure type \p lambda. It is computed once per lambda and lives in the arena of the
+/// translation unit.
+StringRef GetLambdaName(const CXXRecordDecl& lambda);
 
-static inline std::string GetLambdaName(const LambdaExpr& lambda)
+static inline StringRef GetLambdaName(const LambdaExpr& lambda)
 {
     return GetLambdaName(*lambda.getLambdaClass());
 }
@@ -152,6 +218,10 @@ static inline std::string GetLambdaName(const LambdaExpr& lambda)
 std::string GetName(const CXXRecordDecl& RD);
 //-----------------------------------------------------------------------------
 
+/// \brief The lanes of the vector type \p t like <tt>4 x float, 128 bits</tt>, empty if it is no vector.
+std::string GetVectorLanes(const QualType& t);
+//-----------------------------------------------------------------------------
+
 /// \brief Remove decltype from a QualType, if possible.
 const QualType GetDesugarType(const QualType& QT);
 // -----------------------------------------------------------------------------
@@ -174,7 +244,36 @@ std::string
 GetTypeNameAsParameter(const QualType& t, const std::string& varName, const Unqualified unqualified = Unqualified::No);
 //-----------------------------------------------------------------------------
 
+/// \brief Hits and misses of the cache for the names of types, see \c --stats.
+struct TypeNameCacheStats
+{
+    uint64_t hits;
+    uint64_t misses;
+};
+
+TypeNameCacheStats GetTypeNameCacheStats();
+
+/// \brief Hits and misses of the cache for the template argument lists, see \ref GetCachedTemplateArgs.
+TypeNameCacheStats GetTemplateArgsCacheStats();
+
+/// \brief Hits and misses of the cache for the results of constant evaluation, the conditions of \c noexcept and the
+/// values of floating point literals.
+TypeNameCacheStats GetEvaluationCacheStats();
+
+/// \brief Drop all names of types and template argument lists of this thread. Must be called for every new translation
+/// unit, the cache is keyed by the types and declarations of its \c ASTContext.
+void ResetTypeNameCache();
+
+/// \brief Get the template argument list of \p decl as printed in the current scope, \p print prints it on the first
+/// request.
+///
+/// The result stays valid until \ref ResetTypeNameCache.
+StringRef GetCachedTemplateArgs(const ClassTemplateSpecializationDecl& decl, llvm::function_ref<std::string()> print);
+//-----------------------------------------------------------------------------
+
 std::string GetNestedName(const NestedNameSpecifier* nns);
+
+/// \brief Get the qualified prefix, ending with \c ::, of \p ctx. It is built once per declaration context and scope.
 std::string GetDeclContext(const DeclContext* ctx);
 //-----------------------------------------------------------------------------
 
@@ -245,14 +344,18 @@ public:
     /// the last item is skipped.
     static std::string RemoveCurrentScope(std::string name);
 
+    /// \brief A key for everything \ref RemoveCurrentScope depends on.
+    static std::string GetScopeKey();
+
 private:
     using ScopeStackType = StackList<ScopeHelper>;
 
     ScopeStackType& mStack;   //!< Access to the global \c ScopeHelper stack.
     ScopeHelper     mHelper;  //!< The \c ScopeHelper this item refers to.
 
-    static ScopeStackType mGlobalStack;  //!< Global stack to keep track of the scope elements.
-    static std::string    mScope;        //!< The entire scope we are already in.
+    // Both are per thread, as each thread processes its own translation unit.
+    static thread_local ScopeStackType mGlobalStack;  //!< Global stack to keep track of the scope elements.
+    static thread_local std::string    mScope;        //!< The entire scope we are already in.
 };
 //-----------------------------------------------------------------------------
 
@@ -0,0 +1,434 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Lex/MacroInfo.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "InsightsIncludeReport.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief The cost of one \c #include of the main file, with all the headers it includes.
+struct IncludeCost
+{
+    std::string                               name{};  //!< The file name of the header, without its path.
+    unsigned                                  line{};  //!< The line of the \c #include in the main file.
+    uint64_t                                  files{};
+    uint64_t                                  bytes{};
+    uint64_t                                  decls{};
+    bool                                      used{};  //!< The main file refers to a declaration or macro of it.
+    std::chrono::steady_clock::time_point     start{};
+    std::chrono::duration<double, std::milli> time{};
+};
+//-----------------------------------------------------------------------------
+
+struct TranslationUnitIncludes
+{
+    std::string                    mainFile{};
+    std::vector<IncludeCost>       includes{};
+    llvm::DenseMap<FileID, size_t> fileToInclude{};  //!< The include of the main file which entered a header.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Mark the include of the main file which brought \p loc in as used, see \c --unused-includes.
+void MarkUsed(const SourceManager& sm, TranslationUnitIncludes& includes, SourceLocation loc)
+{
+    const auto it = includes.fileToInclude.find(sm.getFileID(sm.getExpansionLoc(loc)));
+
+    if(includes.fileToInclude.end() != it) {
+        includes.includes[it->second].used = true;
+    }
+}
+//-----------------------------------------------------------------------------
+
+class IncludeCostCollector : public PPCallbacks
+{
+public:
+    IncludeCostCollector(const SourceManager& sm, TranslationUnitIncludes& includes)
+    : mSm{sm}
+    , mIncludes{includes}
+    {
+    }
+
+    void FileChanged(SourceLocation   loc,
+                     FileChangeReason reason,
+                     SrcMgr::CharacteristicKind /*fileType*/,
+                     FileID /*prevFID*/) override
+    {
+        const FileID fileId{mSm.getFileID(loc)};
+
+        if(ExitFile == reason) {
+            // Back in the main file, the current include is done.
+            if((fileId == mSm.getMainFileID()) and mCurrent) {
+                auto& include = mIncludes.includes[*mCurrent];
+                include.time  = std::chrono::steady_clock::now() - include.start;
+                mCurrent.reset();
+            }
+
+            return;
+        }
+
+        if(EnterFile != reason) {
+            return;
+        }
+
+        // The predefines and the command line have no file entry.
+        const auto* fileEntry = mSm.getFileEntryForID(fileId);
+
+        if((fileId == mSm.getMainFileID()) or not fileEntry) {
+            return;
+        }
+
+        if(not mCurrent) {
+            const auto includeLoc = mSm.getIncludeLoc(fileId);
+
+            if(mSm.getFileID(includeLoc) != mSm.getMainFileID()) {
+                return;
+            }
+
+            IncludeCost include{};
+            include.name  = llvm::sys::path::filename(fileEntry->getName()).str();
+            include.line  = mSm.getPresumedLineNumber(includeLoc);
+            include.start = std::chrono::steady_clock::now();
+
+            mCurrent = mIncludes.includes.size();
+            mIncludes.includes.push_back(std::move(include));
+        }
+
+        auto& include = mIncludes.includes[*mCurrent];
+        ++include.files;
+        include.bytes += static_cast<uint64_t>(fileEntry->getSize());
+
+        mIncludes.fileToInclude[fileId] = *mCurrent;
+    }
+
+    void MacroExpands(const Token& /*macroNameTok*/,
+                      const MacroDefinition& macro,
+                      SourceRange            range,
+                      const MacroArgs* /*args*/) override
+    {
+        UseMacro(macro, range.getBegin());
+    }
+
+    void Defined(const Token& /*macroNameTok*/, const MacroDefinition& macro, SourceRange range) override
+    {
+        UseMacro(macro, range.getBegin());
+    }
+
+    void Ifdef(SourceLocation loc, const Token& /*macroNameTok*/, const MacroDefinition& macro) override
+    {
+        UseMacro(macro, loc);
+    }
+
+    void Ifndef(SourceLocation loc, const Token& /*macroNameTok*/, const MacroDefinition& macro) override
+    {
+        UseMacro(macro, loc);
+    }
+
+private:
+    const SourceManager&     mSm;
+    TranslationUnitIncludes& mIncludes;
+    llvm::Optional<size_t>   mCurrent{};  //!< The include of the main file which is being entered.
+
+    /// \brief A macro the main file uses keeps the include which defined it.
+    void UseMacro(const MacroDefinition& macro, SourceLocation loc)
+    {
+        if(const auto* info = macro.getMacroInfo(); info and mSm.isInMainFile(mSm.getExpansionLoc(loc))) {
+            MarkUsed(mSm, mIncludes, info->getDefinitionLoc());
+        }
+    }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Marks the includes which declare what the code of the main file refers to.
+///
+/// All redeclarations of a referenced declaration count, a forward declaration in one header and the definition in
+/// another keep both includes.
+class ReferenceCollector : public RecursiveASTVisitor<ReferenceCollector>
+{
+public:
+    ReferenceCollector(const SourceManager& sm, TranslationUnitIncludes& includes)
+    : mSm{sm}
+    , mIncludes{includes}
+    {
+    }
+
+    bool shouldVisitTemplateInstantiations() const { return true; }
+    bool shouldVisitImplicitCode() const { return true; }
+
+    bool VisitDeclRefExpr(const DeclRefExpr* expr)
+    {
+        Use(expr->getFoundDecl());
+        Use(expr->getDecl());
+
+        return true;
+    }
+
+    bool VisitMemberExpr(const MemberExpr* expr)
+    {
+        Use(expr->getMemberDecl());
+
+        return true;
+    }
+
+    bool VisitCXXConstructExpr(const CXXConstructExpr* expr)
+    {
+        Use(expr->getConstructor());
+
+        return true;
+    }
+
+    bool VisitCXXNewExpr(const CXXNewExpr* expr)
+    {
+        Use(expr->getOperatorNew());
+
+        return true;
+    }
+
+    bool VisitCXXDeleteExpr(const CXXDeleteExpr* expr)
+    {
+        Use(expr->getOperatorDelete());
+
+        return true;
+    }
+
+    bool VisitUsingShadowDecl(const UsingShadowDecl* decl)
+    {
+        Use(decl->getTargetDecl());
+
+        return true;
+    }
+
+    bool VisitTagTypeLoc(TagTypeLoc loc)
+    {
+        Use(loc.getDecl());
+
+        return true;
+    }
+
+    bool VisitTypedefTypeLoc(TypedefTypeLoc loc)
+    {
+        Use(loc.getTypedefNameDecl());
+
+        return true;
+    }
+
+    bool VisitTemplateSpecializationTypeLoc(TemplateSpecializationTypeLoc loc)
+    {
+        Use(loc.getTypePtr()->getTemplateName().getAsTemplateDecl());
+
+        return true;
+    }
+
+    bool VisitDeducedTemplateSpecializationTypeLoc(DeducedTemplateSpecializationTypeLoc loc)
+    {
+        Use(loc.getTypePtr()->getTemplateName().getAsTemplateDecl());
+
+        return true;
+    }
+
+private:
+    const SourceManager&     mSm;
+    TranslationUnitIncludes& mIncludes;
+
+    void Use(const Decl* decl)
+    {
+        if(not decl) {
+            return;
+        }
+
+        for(const auto* redecl : decl->redecls()) {
+            MarkUsed(mSm, mIncludes, redecl->getLocation());
+        }
+    }
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief Count the declarations of \p declContext and the namespaces, linkage specifications and classes in it.
+static void CountDecls(const DeclContext& declContext, const SourceManager& sm, TranslationUnitIncludes& includes)
+{
+    for(const auto* decl : declContext.decls()) {
+        if(decl->isImplicit()) {
+            continue;
+        }
+
+        const auto it = includes.fileToInclude.find(sm.getFileID(sm.getExpansionLoc(decl->getLocation())));
+
+        if(includes.fileToInclude.end() != it) {
+            ++includes.includes[it->second].decls;
+        }
+
+        if(isa<NamespaceDecl>(decl) or isa<LinkageSpecDecl>(decl) or isa<CXXRecordDecl>(decl)) {
+            CountDecls(*cast<DeclContext>(decl), sm, includes);
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+static bool                                 gIncludeReportEnabled{};
+static bool                                 gUnusedIncludesEnabled{};
+static std::mutex                           gIncludeReportMutex{};
+static std::vector<TranslationUnitIncludes> gTranslationUnits{};
+// With -j each thread parses a translation unit of its own.
+static thread_local TranslationUnitIncludes gCurrent{};
+//-----------------------------------------------------------------------------
+
+void EnableIncludeReport()
+{
+    gIncludeReportEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsIncludeReportEnabled()
+{
+    return gIncludeReportEnabled;
+}
+//-----------------------------------------------------------------------------
+
+void EnableUnusedIncludes()
+{
+    gUnusedIncludesEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsUnusedIncludesEnabled()
+{
+    return gUnusedIncludesEnabled;
+}
+//-----------------------------------------------------------------------------
+
+void StartIncludeReport(Preprocessor& pp)
+{
+    gCurrent = {};
+
+    pp.addPPCallbacks(std::make_unique<IncludeCostCollector>(pp.getSourceManager(), gCurrent));
+}
+//-----------------------------------------------------------------------------
+
+void FinishIncludeReport(ASTContext& ctx)
+{
+    const auto& sm = ctx.getSourceManager();
+
+    if(const auto* mainFile = sm.getFileEntryForID(sm.getMainFileID())) {
+        gCurrent.mainFile = mainFile->getName().str();
+    }
+
+    CountDecls(*ctx.getTranslationUnitDecl(), sm, gCurrent);
+
+    if(gUnusedIncludesEnabled) {
+        ReferenceCollector collector{sm, gCurrent};
+
+        for(auto* decl : ctx.getTranslationUnitDecl()->decls()) {
+            if(sm.isInMainFile(sm.getExpansionLoc(decl->getLocation()))) {
+                collector.TraverseDecl(decl);
+            }
+        }
+    }
+
+    std::lock_guard lock{gIncludeReportMutex};
+    gTranslationUnits.push_back(std::move(gCurrent));
+    gCurrent = {};
+}
+//-----------------------------------------------------------------------------
+
+void PrintIncludeReport(llvm::raw_ostream& ostream)
+{
+    std::lock_guard lock{gIncludeReportMutex};
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                       C++ Insights include report\n"
+            << "===-------------------------------------------------------------------------===\n";
+
+    for(auto& translationUnit : gTranslationUnits) {
+        auto& includes = translationUnit.includes;
+
+        std::stable_sort(includes.begin(), includes.end(), [](const IncludeCost& a, const IncludeCost& b) {
+            return a.time > b.time;
+        });
+
+        ostream << translationUnit.mainFile << ":\n"
+                << llvm::format(
+                       "  %-30s %6s %8s %12s %8s %10s\n", "Include", "Line", "Files", "Bytes", "Decls", "Time (ms)");
+
+        for(const auto& include : includes) {
+            ostream << llvm::format("  %-30s %6u %8llu %12llu %8llu %10.2f\n",
+                                    include.name.c_str(),
+                                    include.line,
+                                    static_cast<unsigned long long>(include.files),
+                                    static_cast<unsigned long long>(include.bytes),
+                                    static_cast<unsigned long long>(include.decls),
+                                    include.time.count());
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+void PrintUnusedIncludes(llvm::raw_ostream& ostream)
+{
+    std::lock_guard lock{gIncludeReportMutex};
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                   C++ Insights unused includes report\n"
+            << "===-------------------------------------------------------------------------===\n";
+
+    for(const auto& translationUnit : gTranslationUnits) {
+        std::vector<const IncludeCost*> unused{};
+
+        for(const auto& include : translationUnit.includes) {
+            if(not include.used) {
+                unused.push_back(&include);
+            }
+        }
+
+        if(unused.empty()) {
+            continue;
+        }
+
+        std::stable_sort(unused.begin(), unused.end(), [](const IncludeCost* a, const IncludeCost* b) {
+            return a->time > b->time;
+        });
+
+        ostream << translationUnit.mainFile << ":\n"
+                << llvm::format("  %-30s %6s %8s %12s %10s\n", "Include", "Line", "Files", "Bytes", "Time (ms)");
+
+        std::chrono::duration<double, std::milli> total{};
+
+        for(const auto* include : unused) {
+            ostream << llvm::format("  %-30s %6u %8llu %12llu %10.2f\n",
+                                    include->name.c_str(),
+                                    include->line,
+                                    static_cast<unsigned long long>(include->files),
+                                    static_cast<unsigned long long>(include->bytes),
+                                    include->time.count());
+
+            total += include->time;
+        }
+
+        ostream << llvm::format("  %-30s %6s %8s %12s %10.2f\n", "Total", "", "", "", total.count());
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,62 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_INCLUDE_REPORT_H
+#define INSIGHTS_INCLUDE_REPORT_H
+
+#include "llvm/Support/raw_ostream.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class ASTContext;
+class Preprocessor;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+void EnableIncludeReport();
+bool IsIncludeReportEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Print the includes of the main file which the main file does not use at exit, see \ref PrintUnusedIncludes.
+void EnableUnusedIncludes();
+bool IsUnusedIncludesEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Watch the headers \p pp enters for the translation unit which is about to be parsed, see \c
+/// --include-report.
+///
+/// For each \c #include of the main file the number of files it pulls in, their bytes and the time from entering to
+/// leaving the header are counted. The parser pulls the tokens from the preprocessor, so the time includes parsing the
+/// header and Sema.
+void StartIncludeReport(Preprocessor& pp);
+//-----------------------------------------------------------------------------
+
+/// \brief Count the declarations each include of the main file of \p ctx added and keep the results of this
+/// translation unit for \ref PrintIncludeReport.
+///
+/// The declarations at namespace scope and the members of classes are counted, the ones in function bodies are not.
+/// With \c --unused-includes the references of the code of the main file are collected as well.
+void FinishIncludeReport(ASTContext& ctx);
+//-----------------------------------------------------------------------------
+
+/// \brief Print the includes of the main file of all translation units, the most expensive first.
+void PrintIncludeReport(llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+/// \brief Print the includes of the main file of all translation units which add no declaration and no macro the main
+/// file refers to, with their cost, the most expensive first.
+///
+/// A header which is only needed by a template of the standard library, for example a specialization of \c std::hash,
+/// is not seen as used. The report lists candidates, removing them still needs a compiler to agree.
+void PrintUnusedIncludes(llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_INCLUDE_REPORT_H */
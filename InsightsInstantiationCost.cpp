@@ -0,0 +1,199 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "ClangCompat.h"
+#include "InsightsInstantiationCost.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static unsigned                  gReportCount{};
+static bool                      gOwnsProfiler{};
+static uint64_t                  gSeenEvents{};  //!< The events of the previous translation units, with --trace.
+static llvm::StringMap<uint64_t> gCosts{};       //!< The cost of each instantiation of the current translation unit.
+static llvm::StringMap<uint64_t> gReport{};      //!< The costs of the instantiations C++ Insights generated.
+//-----------------------------------------------------------------------------
+
+void StartInstantiationCost()
+{
+    // --trace started it already, its events must stay for the file.
+    if(llvm::timeTraceProfilerEnabled()) {
+        return;
+    }
+
+    gOwnsProfiler = true;
+
+#if IS_CLANG_NEWER_THAN(9)
+    // Most instantiations are shorter than the 500us of -ftime-trace, all of them are kept.
+    llvm::timeTraceProfilerInitialize(0, "insights");
+#else
+    llvm::timeTraceProfilerInitialize();
+#endif
+}
+//-----------------------------------------------------------------------------
+
+void EnableInstantiationReport(const unsigned count)
+{
+    gReportCount = count;
+}
+//-----------------------------------------------------------------------------
+
+bool IsInstantiationReportEnabled()
+{
+    return 0 != gReportCount;
+}
+//-----------------------------------------------------------------------------
+
+void CollectInstantiationCosts()
+{
+    gCosts.clear();
+
+    if(not llvm::timeTraceProfilerEnabled()) {
+        return;
+    }
+
+    // The profiler offers its events only in the Chrome trace-event format.
+    llvm::SmallString<4096> buffer{};
+
+    {
+#if IS_CLANG_NEWER_THAN(9)
+        llvm::raw_svector_ostream out{buffer};
+        llvm::timeTraceProfilerWrite(out);
+#else
+        std::unique_ptr<llvm::raw_pwrite_stream> out{std::make_unique<llvm::raw_svector_ostream>(buffer)};
+        llvm::timeTraceProfilerWrite(out);
+#endif
+    }
+
+    auto trace = llvm::json::parse(buffer);
+
+    if(not trace) {
+        llvm::consumeError(trace.takeError());
+        return;
+    }
+
+    const auto* root   = trace->getAsObject();
+    const auto* events = root ? root->getArray("traceEvents") : nullptr;
+
+    if(not events) {
+        return;
+    }
+
+    uint64_t instantiationEvents{};
+
+    for(const auto& value : *events) {
+        const auto* event = value.getAsObject();
+        const auto  name  = event ? event->getString("name") : llvm::None;
+
+        if(not name or ((*name != "InstantiateClass") and (*name != "InstantiateFunction"))) {
+            continue;
+        }
+
+        // The events stay in the order they ended, the ones of the previous translation units come first.
+        if(instantiationEvents++ < gSeenEvents) {
+            continue;
+        }
+
+        const auto* args   = event->getObject("args");
+        const auto  detail = args ? args->getString("detail") : llvm::None;
+        const auto  dur    = event->getInteger("dur");
+
+        if(detail and dur) {
+            gCosts[*detail] += static_cast<uint64_t>(*dur);
+        }
+    }
+
+    if(gOwnsProfiler) {
+        // Start over, the events of this translation unit are no longer needed.
+        llvm::timeTraceProfilerCleanup();
+        gOwnsProfiler = false;
+        StartInstantiationCost();
+
+    } else {
+        gSeenEvents = instantiationEvents;
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The name Sema uses for the detail of the instantiation events of \p decl.
+static std::string GetEventDetail(const NamedDecl& decl)
+{
+    std::string              name{};
+    llvm::raw_string_ostream stream{name};
+
+    decl.getNameForDiagnostic(stream, decl.getASTContext().getPrintingPolicy(), /*Qualified*/ true);
+
+    return stream.str();
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<uint64_t> GetInstantiationCost(const NamedDecl& decl)
+{
+    if(const auto it = gCosts.find(GetEventDetail(decl)); gCosts.end() != it) {
+        return it->second;
+    }
+
+    return llvm::None;
+}
+//-----------------------------------------------------------------------------
+
+void RecordInstantiationCost(const NamedDecl& decl, const uint64_t microseconds)
+{
+    gReport[GetEventDetail(decl)] += microseconds;
+}
+//-----------------------------------------------------------------------------
+
+void PrintInstantiationReport(llvm::raw_ostream& ostream)
+{
+    std::vector<const llvm::StringMapEntry<uint64_t>*> instantiations{};
+    uint64_t                                           total{};
+
+    for(const auto& entry : gReport) {
+        instantiations.push_back(&entry);
+        total += entry.second;
+    }
+
+    std::stable_sort(instantiations.begin(), instantiations.end(), [](const auto* a, const auto* b) {
+        if(a->second != b->second) {
+            return a->second > b->second;
+        }
+
+        return a->first() < b->first();
+    });
+
+    if(instantiations.size() > gReportCount) {
+        instantiations.resize(gReportCount);
+    }
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                   C++ Insights template instantiation report\n"
+            << "===-------------------------------------------------------------------------===\n"
+            << llvm::format("  %-50s %12s %8s\n", "Instantiation", "Time (ms)", "Share");
+
+    for(const auto* entry : instantiations) {
+        const double share{total ? (100.0 * static_cast<double>(entry->second) / static_cast<double>(total)) : 0.0};
+
+        ostream << llvm::format("  %-50s %12.3f %7.1f%%\n",
+                                entry->first().str().c_str(),
+                                static_cast<double>(entry->second) / 1000.0,
+                                share);
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
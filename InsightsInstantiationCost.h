@@ -0,0 +1,60 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_INSTANTIATION_COST_H
+#define INSIGHTS_INSTANTIATION_COST_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class NamedDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Start the time trace profiler of LLVM, unless \c --trace already did, see \c --show-instantiation-cost and
+/// \c --instantiation-report.
+///
+/// Sema records an \c InstantiateClass or \c InstantiateFunction event for each instantiation while it is running.
+void StartInstantiationCost();
+
+/// \brief Print the \p count most expensive instantiations at exit, see \ref PrintInstantiationReport.
+void EnableInstantiationReport(const unsigned count);
+bool IsInstantiationReportEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Take the instantiation events the profiler recorded while the current translation unit was parsed.
+///
+/// Each call replaces the events of the previous translation unit.
+void CollectInstantiationCosts();
+//-----------------------------------------------------------------------------
+
+/// \brief The time in microseconds Sema spent instantiating \p decl, a class template specialization or a function
+/// template instantiation, if the profiler recorded it.
+///
+/// The time includes the instantiations triggered by this one. Events shorter than the granularity of the profiler are
+/// not recorded, with LLVM 10 and newer it is set to zero.
+llvm::Optional<uint64_t> GetInstantiationCost(const NamedDecl& decl);
+//-----------------------------------------------------------------------------
+
+/// \brief Remember the cost of \p decl for the report at exit, see \c --instantiation-report.
+void RecordInstantiationCost(const NamedDecl& decl, const uint64_t microseconds);
+//-----------------------------------------------------------------------------
+
+/// \brief Print the most expensive of the instantiations recorded with \ref RecordInstantiationCost, with their share
+/// of the time all of them took.
+void PrintInstantiationReport(llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_INSTANTIATION_COST_H */
@@ -0,0 +1,250 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/QualTypeNames.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "DPrint.h"
+#include "InsightsHelpers.h"
+#include "InsightsLayoutAsserts.h"
+#include "InsightsRecordLayout.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+struct LayoutAssert
+{
+    std::string                                   file{};
+    std::string                                   name{};
+    uint64_t                                      size{};
+    uint64_t                                      align{};
+    std::vector<std::pair<std::string, uint64_t>> offsets{};  //!< Empty for a class which is not standard-layout.
+};
+//-----------------------------------------------------------------------------
+
+class HotRecordCollector : public RecursiveASTVisitor<HotRecordCollector>
+{
+public:
+    HotRecordCollector(ASTContext& ctx, const llvm::StringSet<>& hotRecords, std::vector<LayoutAssert>& asserts)
+    : mCtx{ctx}
+    , mHotRecords{hotRecords}
+    , mAsserts{asserts}
+    , mPolicy{ctx.getPrintingPolicy()}
+    {
+        // A class in an anonymous namespace can be named in the same translation unit.
+        mPolicy.SuppressUnwrittenScope = true;
+
+        if(const auto* mainFile = ctx.getSourceManager().getFileEntryForID(ctx.getSourceManager().getMainFileID())) {
+            mFile = mainFile->getName().str();
+        }
+    }
+
+    bool shouldVisitTemplateInstantiations() const { return true; }
+
+    bool VisitCXXRecordDecl(const CXXRecordDecl* record)
+    {
+        Record(*record);
+
+        return true;
+    }
+
+private:
+    bool IsHot(const CXXRecordDecl& record) const
+    {
+        const auto isAnnotated = [](const Decl& decl) {
+            return llvm::any_of(decl.specific_attrs<AnnotateAttr>(),
+                                [](const AnnotateAttr* attr) { return attr->getAnnotation() == "hot"; });
+        };
+
+        // An instantiation is hot if its template is.
+        const auto* pattern = record.getTemplateInstantiationPattern();
+
+        return isAnnotated(record) or (pattern and isAnnotated(*pattern)) or
+               mHotRecords.count(record.getQualifiedNameAsString());
+    }
+
+    /// \brief Whether \p record can be named at the end of the main file.
+    static bool IsNameable(const CXXRecordDecl& record)
+    {
+        for(const auto* enclosing = &record; enclosing; enclosing = dyn_cast<CXXRecordDecl>(enclosing->getParent())) {
+            if(not enclosing->getIdentifier() or enclosing->isLambda()) {
+                return false;
+            }
+
+            // A nested class which is not public can only be named inside of its class.
+            if(isa<CXXRecordDecl>(enclosing->getParent()) and (AS_public != enclosing->getAccess())) {
+                return false;
+            }
+        }
+
+        return not record.getParentFunctionOrMethod();
+    }
+
+    void Record(const CXXRecordDecl& record)
+    {
+        if((record.getDefinition() != &record) or record.isInjectedClassName() or record.isDependentType() or
+           not RecordLayoutAnnotator::HasLayout(record) or not mSeen.insert(&record).second) {
+            return;
+        }
+
+        // An instantiation is located at its template.
+        if(not IsExpansionInMainFile(mCtx.getSourceManager(), record.getLocation()) or not IsHot(record) or
+           not IsNameable(record)) {
+            return;
+        }
+
+        const auto&  layout = mCtx.getASTRecordLayout(&record);
+        LayoutAssert layoutAssert{};
+
+        layoutAssert.file  = mFile;
+        layoutAssert.name  = TypeName::getFullyQualifiedName(mCtx.getRecordType(&record), mCtx, mPolicy);
+        layoutAssert.size  = layout.getSize().getQuantity();
+        layoutAssert.align = layout.getAlignment().getQuantity();
+
+        // offsetof cannot take a bit-field, and a private field cannot be named outside of the class.
+        if(record.isStandardLayout()) {
+            for(const auto* field : record.fields()) {
+                if(field->isBitField() or not field->getIdentifier() or (AS_public != field->getAccess())) {
+                    continue;
+                }
+
+                const auto offset = mCtx.toCharUnitsFromBits(layout.getFieldOffset(field->getFieldIndex()));
+
+                layoutAssert.offsets.emplace_back(field->getName().str(), offset.getQuantity());
+            }
+        }
+
+        mAsserts.push_back(std::move(layoutAssert));
+    }
+
+    ASTContext&                          mCtx;
+    const llvm::StringSet<>&             mHotRecords;
+    std::vector<LayoutAssert>&           mAsserts;
+    PrintingPolicy                       mPolicy;
+    std::string                          mFile{};
+    llvm::DenseSet<const CXXRecordDecl*> mSeen{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static std::string               gLayoutAssertsFile{};
+static llvm::StringSet<>         gHotRecords{};
+static std::mutex                gLayoutAssertsMutex{};
+static std::vector<LayoutAssert> gLayoutAsserts{};
+//-----------------------------------------------------------------------------
+
+void EnableLayoutAsserts(llvm::StringRef file, const std::vector<std::string>& hotRecords)
+{
+    gLayoutAssertsFile = file.str();
+
+    for(const auto& name : hotRecords) {
+        // The qualified name of a record has no leading ::.
+        gHotRecords.insert(StringRef{name}.ltrim(':'));
+    }
+}
+//-----------------------------------------------------------------------------
+
+bool IsLayoutAssertsEnabled()
+{
+    return not gLayoutAssertsFile.empty();
+}
+//-----------------------------------------------------------------------------
+
+void RecordLayoutAsserts(ASTContext& ctx)
+{
+    // The layouts are computed outside of the lock, in --server mode the translation units run concurrently.
+    std::vector<LayoutAssert> asserts{};
+    HotRecordCollector        collector{ctx, gHotRecords, asserts};
+
+    for(auto* decl : ctx.getTraversalScope()) {
+        collector.TraverseDecl(decl);
+    }
+
+    std::lock_guard lock{gLayoutAssertsMutex};
+    std::move(asserts.begin(), asserts.end(), std::back_inserter(gLayoutAsserts));
+}
+//-----------------------------------------------------------------------------
+
+bool WriteLayoutAsserts()
+{
+    std::lock_guard lock{gLayoutAssertsMutex};
+
+    std::string header{
+        "// Layout asserts of the hot classes, generated by C++ Insights.\n"
+        "// Include this header after the definitions of the classes, a change of their layout fails to compile.\n"
+        "#pragma once\n"};
+
+    llvm::StringSet<> written{};
+    StringRef         lastFile{};
+
+    for(const auto& layoutAssert : gLayoutAsserts) {
+        if(not written.insert(layoutAssert.name).second) {
+            continue;
+        }
+
+        if(lastFile != layoutAssert.file) {
+            lastFile = layoutAssert.file;
+            header.append(StrCat("\n// ", lastFile, "\n"));
+        }
+
+        const auto& name = layoutAssert.name;
+
+        header.append(StrCat(
+            "static_assert(sizeof(", name, ") == ", layoutAssert.size, ", \"the size of ", name, " changed\");\n"));
+        header.append(StrCat("static_assert(alignof(",
+                             name,
+                             ") == ",
+                             layoutAssert.align,
+                             ", \"the alignment of ",
+                             name,
+                             " changed\");\n"));
+
+        for(const auto& [field, offset] : layoutAssert.offsets) {
+            header.append(StrCat("static_assert(__builtin_offsetof(",
+                                 name,
+                                 ", ",
+                                 field,
+                                 ") == ",
+                                 offset,
+                                 ", \"the offset of ",
+                                 name,
+                                 "::",
+                                 field,
+                                 " changed\");\n"));
+        }
+    }
+
+    std::error_code      ec{};
+    llvm::raw_fd_ostream out{gLayoutAssertsFile, ec, llvm::sys::fs::OF_Text};
+
+    if(ec) {
+        Error("cannot write layout asserts '%s': %s\n", gLayoutAssertsFile, ec.message());
+        return false;
+    }
+
+    out << header;
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
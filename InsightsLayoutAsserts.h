@@ -0,0 +1,51 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_LAYOUT_ASSERTS_H
+#define INSIGHTS_LAYOUT_ASSERTS_H
+
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class ASTContext;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Write the layout asserts of the hot records of all translation units to \p file at exit, see \ref
+/// WriteLayoutAsserts. A record is hot if it carries <tt>__attribute__((annotate("hot")))</tt> or its qualified name
+/// is one of \p hotRecords.
+void EnableLayoutAsserts(llvm::StringRef file, const std::vector<std::string>& hotRecords);
+bool IsLayoutAssertsEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Record the size, the alignment and the offsets of the public fields of every hot class and class template
+/// instantiation defined in the main file of \p ctx, see \c --emit-layout-asserts.
+///
+/// Records which cannot be named at the end of the main file are skipped: local and unnamed classes, lambdas and
+/// classes nested in another one as non-public members.
+void RecordLayoutAsserts(ASTContext& ctx);
+//-----------------------------------------------------------------------------
+
+/// \brief Write a header with a \c static_assert for the size, the alignment and the offset of each field of the
+/// recorded classes. A class recorded by more than one translation unit is written once.
+///
+/// The offsets are only checked for standard-layout classes, for others \c offsetof is only conditionally supported.
+/// They use \c __builtin_offsetof, as the \c offsetof macro cannot take a type with a comma in it.
+///
+/// \returns \c false, if the file could not be written.
+bool WriteLayoutAsserts();
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_LAYOUT_ASSERTS_H */
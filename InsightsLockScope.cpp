@@ -0,0 +1,342 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringSwitch.h"
+
+#include "Insights.h"
+#include "InsightsAllocations.h"
+#include "InsightsLockScope.h"
+#include "InsightsStrCat.h"
+
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The number of distinct calls a note lists by name.
+static constexpr size_t MAX_LISTED_CALLS{8};
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief A function called while a lock is held, with why it is expensive.
+struct HeldCall
+{
+    std::string name{};
+    std::string flag{};  //!< Empty for an ordinary call.
+    unsigned    count{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Collects the calls of the statements which run while a lock is held.
+class HeldCallCollector
+{
+public:
+    explicit HeldCallCollector(const VarDecl& lock)
+    : mLock{lock}
+    {
+    }
+
+    void Collect(const Stmt* stmt);
+
+    bool                  unlocked{};  //!< A call of \c unlock on the lock ended the collection.
+    unsigned              calls{};
+    std::vector<HeldCall> heldCalls{};  //!< The distinct calls, in the order they are made.
+
+private:
+    const VarDecl& mLock;
+
+    void Add(std::string name, std::string flag);
+    bool IsUnlock(const CXXMemberCallExpr& call) const;
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The class template of \p record, if it is a specialization, otherwise \p record itself.
+static const NamedDecl& GetClassOrTemplate(const CXXRecordDecl& record)
+{
+    if(const auto* spec = dyn_cast<ClassTemplateSpecializationDecl>(&record)) {
+        return *spec->getSpecializedTemplate();
+    }
+
+    return record;
+}
+//-----------------------------------------------------------------------------
+
+bool IsLockVariable(const VarDecl& var)
+{
+    if(not var.hasLocalStorage() or isa<ParmVarDecl>(var)) {
+        return false;
+    }
+
+    const auto* record = var.getType()->getAsCXXRecordDecl();
+
+    // An inline namespace, like the std::__1 of libc++, is not part of the qualified name.
+    return record and llvm::is_contained(GetInsightsOptions().lockTypes,
+                                         GetClassOrTemplate(*record).getQualifiedNameAsString());
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p type is one of the streams of the standard library which read or write a file or a terminal.
+static bool IsIOStream(QualType type)
+{
+    if(type->isPointerType()) {
+        type = type->getPointeeType();
+    }
+
+    const auto* record = type.getNonReferenceType()->getAsCXXRecordDecl();
+
+    if(not record or not record->isInStdNamespace()) {
+        return false;
+    }
+
+    const auto& decl = GetClassOrTemplate(*record);
+
+    if(not decl.getIdentifier()) {
+        return false;
+    }
+
+    // The string streams stay in memory.
+    return llvm::StringSwitch<bool>(decl.getName())
+        .Cases("basic_ostream", "basic_istream", "basic_iostream", true)
+        .Cases("basic_ofstream", "basic_ifstream", "basic_fstream", "basic_filebuf", true)
+        .Default(false);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p callee is one of the C or POSIX functions which do I/O.
+static bool IsIOFunction(const FunctionDecl& callee)
+{
+    const auto* declContext = callee.getDeclContext()->getRedeclContext();
+
+    if(isa<CXXMethodDecl>(callee) or not callee.getIdentifier() or
+       not(declContext->isTranslationUnit() or declContext->isStdNamespace())) {
+        return false;
+    }
+
+    return llvm::StringSwitch<bool>(callee.getName())
+        .Cases("printf", "fprintf", "vprintf", "vfprintf", "puts", "fputs", "putchar", "fputc", "fwrite", true)
+        .Cases("scanf", "fscanf", "getchar", "fgetc", "fgets", "fread", "getline", true)
+        .Cases("fopen", "fclose", "fflush", "open", "close", "read", "write", "pread", "pwrite", true)
+        .Cases("send", "recv", "sendto", "recvfrom", "connect", "accept", "poll", "select", "fsync", true)
+        .Default(false);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p method is one of the waits of a condition variable, which release the lock while they block.
+static bool IsConditionWait(const CXXMethodDecl& method)
+{
+    const auto* parent = method.getParent();
+
+    return parent->isInStdNamespace() and parent->getIdentifier() and
+           ((parent->getName() == "condition_variable") or (parent->getName() == "condition_variable_any")) and
+           method.getIdentifier() and method.getName().startswith("wait");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The flag for the allocation \p note of \c --show-allocations.
+static std::string GetAllocationFlag(llvm::StringRef note)
+{
+    return note.startswith("allocation") ? "allocation" : "may allocate";
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetCallFlag(const CallExpr& call, const FunctionDecl& callee)
+{
+    if(const auto note = GetAllocationNote(call); not note.empty()) {
+        return GetAllocationFlag(note);
+    }
+
+    if(const auto* memberCall = dyn_cast<CXXMemberCallExpr>(&call)) {
+        const auto* method = memberCall->getMethodDecl();
+        const auto* object = memberCall->getImplicitObjectArgument();
+        const auto* member = dyn_cast<MemberExpr>(memberCall->getCallee()->IgnoreParens());
+
+        if(method and method->isVirtual() and not(member and member->hasQualifier()) and
+           not method->getDevirtualizedMethod(object, false)) {
+            return "virtual";
+        }
+
+        if(method and IsConditionWait(*method)) {
+            return "waits, releases the lock meanwhile";
+        }
+
+        if(object and IsIOStream(object->getType())) {
+            return "I/O";
+        }
+
+    } else if(const auto* opCall = dyn_cast<CXXOperatorCallExpr>(&call)) {
+        // The stream operators, a chain of them passes the stream on as the left operand.
+        if(((OO_LessLess == opCall->getOperator()) or (OO_GreaterGreater == opCall->getOperator())) and
+           (0 < opCall->getNumArgs()) and IsIOStream(opCall->getArg(0)->getType())) {
+            return "I/O";
+        }
+    }
+
+    return IsIOFunction(callee) ? "I/O" : "";
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The name of \p callee together with its class, like \c vector::push_back.
+static std::string GetCallName(const FunctionDecl& callee)
+{
+    if(const auto* method = dyn_cast<CXXMethodDecl>(&callee)) {
+        const auto* parent = method->getParent();
+
+        if(not parent->getIdentifier()) {
+            return callee.getNameAsString();
+        }
+
+        const std::string name{isa<CXXConstructorDecl>(method) ? parent->getName().str() : callee.getNameAsString()};
+
+        return StrCat(parent->getName(), "::", name);
+    }
+
+    return callee.getNameAsString();
+}
+//-----------------------------------------------------------------------------
+
+void HeldCallCollector::Add(std::string name, std::string flag)
+{
+    ++calls;
+
+    const auto it = llvm::find_if(heldCalls, [&](const HeldCall& call) {
+        return (call.name == name) and (call.flag == flag);
+    });
+
+    if(heldCalls.end() != it) {
+        ++it->count;
+        return;
+    }
+
+    heldCalls.push_back({std::move(name), std::move(flag), 1});
+}
+//-----------------------------------------------------------------------------
+
+bool HeldCallCollector::IsUnlock(const CXXMemberCallExpr& call) const
+{
+    const auto* method = call.getMethodDecl();
+
+    if(not method or not method->getIdentifier() or (method->getName() != "unlock")) {
+        return false;
+    }
+
+    const auto* object = dyn_cast_or_null<DeclRefExpr>(call.getImplicitObjectArgument()->IgnoreParenImpCasts());
+
+    return object and (object->getDecl() == &mLock);
+}
+//-----------------------------------------------------------------------------
+
+void HeldCallCollector::Collect(const Stmt* stmt)
+{
+    if(not stmt or unlocked) {
+        return;
+    }
+
+    // The body of a lambda runs when it is called, nothing in an unevaluated operand runs.
+    if(isa<LambdaExpr>(stmt) or isa<UnaryExprOrTypeTraitExpr>(stmt) or isa<CXXNoexceptExpr>(stmt)) {
+        return;
+    }
+
+    if(const auto* memberCall = dyn_cast<CXXMemberCallExpr>(stmt); memberCall and IsUnlock(*memberCall)) {
+        unlocked = true;
+        return;
+    }
+
+    if(isa<CXXNewExpr>(stmt)) {
+        Add("new", "allocation");
+
+    } else if(const auto* construct = dyn_cast<CXXConstructExpr>(stmt)) {
+        // Only a construction which allocates is worth a line, the others are part of the surrounding code.
+        if(const auto note = GetAllocationNote(*construct); not note.empty()) {
+            Add(GetCallName(*construct->getConstructor()), GetAllocationFlag(note));
+        }
+
+    } else if(const auto* call = dyn_cast<CallExpr>(stmt)) {
+        if(const auto* callee = call->getDirectCallee()) {
+            Add(GetCallName(*callee), GetCallFlag(*call, *callee));
+
+        } else {
+            Add("<indirect call>", "");
+        }
+    }
+
+    for(const auto* child : stmt->children()) {
+        Collect(child);
+    }
+}
+//-----------------------------------------------------------------------------
+
+std::string GetLockReleaseNote(const VarDecl& lock, const CompoundStmt& scope)
+{
+    HeldCallCollector collector{lock};
+    bool              held{};
+
+    for(const auto* item : scope.body()) {
+        if(held) {
+            collector.Collect(item);
+            continue;
+        }
+
+        // The variables declared together with the lock and after it are initialized while it is held.
+        if(const auto* declStmt = dyn_cast<DeclStmt>(item)) {
+            for(const auto* decl : declStmt->decls()) {
+                if(held) {
+                    if(const auto* var = dyn_cast<VarDecl>(decl)) {
+                        collector.Collect(var->getInit());
+                    }
+                }
+
+                held = held or (decl == &lock);
+            }
+        }
+    }
+
+    if(not held) {
+        return {};
+    }
+
+    const auto* record = lock.getType()->getAsCXXRecordDecl();
+    std::string note{StrCat(lock.getName(),
+                            ".~",
+                            GetClassOrTemplate(*record).getName(),
+                            "(): ",
+                            collector.unlocked ? "unlock() released the lock before, " : "lock released, ")};
+
+    if(0 == collector.calls) {
+        return note.append("no call while held");
+    }
+
+    note.append(StrCat("held across ", collector.calls, (1 == collector.calls) ? " call: " : " calls: "));
+
+    for(size_t i = 0; (i < collector.heldCalls.size()) and (i < MAX_LISTED_CALLS); ++i) {
+        const auto& call = collector.heldCalls[i];
+
+        note.append(StrCat((0 == i) ? "" : ", ", call.name));
+
+        if(1 < call.count) {
+            note.append(StrCat(" (", call.count, "x)"));
+        }
+
+        if(not call.flag.empty()) {
+            note.append(StrCat(" [", call.flag, "]"));
+        }
+    }
+
+    if(MAX_LISTED_CALLS < collector.heldCalls.size()) {
+        note.append(StrCat(" and ", collector.heldCalls.size() - MAX_LISTED_CALLS, " more"));
+    }
+
+    return note;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
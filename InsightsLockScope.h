@@ -0,0 +1,36 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_LOCK_SCOPE_H
+#define INSIGHTS_LOCK_SCOPE_H
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CompoundStmt;
+class VarDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Whether \p var is a local variable of one of the lock types of \c --lock-type, see \c --show-lock-scope.
+bool IsLockVariable(const VarDecl& var);
+//-----------------------------------------------------------------------------
+
+/// \brief The note for the end of \p scope, where the destructor of the lock \p lock releases it.
+///
+/// It lists the calls of the statements after the declaration of \p lock, which run while the lock is held. Calls
+/// which allocate, look like I/O, go through the vtable or wait on a condition variable are flagged. A call of \c
+/// unlock on the lock ends the list. Empty, if \p lock is not declared in \p scope.
+std::string GetLockReleaseNote(const VarDecl& lock, const CompoundStmt& scope);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_LOCK_SCOPE_H */
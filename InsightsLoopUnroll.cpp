@@ -0,0 +1,310 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/STLExtras.h"
+
+#include "InsightsHelpers.h"
+#include "InsightsLoopUnroll.h"
+#include "InsightsStrCat.h"
+
+#include <limits>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The value of \p expr, if it is an integer constant which fits into an \c int64_t.
+static llvm::Optional<int64_t> EvaluateInt(const Expr* expr)
+{
+    if(not expr or expr->isValueDependent() or expr->isTypeDependent()) {
+        return {};
+    }
+
+    if(Expr::EvalResult result{};
+       expr->EvaluateAsRValue(result, GetGlobalAST()) and not result.HasSideEffects and result.Val.isInt()) {
+        const auto& value = result.Val.getInt();
+
+        if(value.isSigned() ? (value.getMinSignedBits() <= 64) : (value.getActiveBits() <= 63)) {
+            return value.getExtValue();
+        }
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The variable \p expr refers to, \c nullptr if it is something else.
+static const VarDecl* GetReferencedVar(const Expr* expr)
+{
+    const auto* ref = dyn_cast_or_null<DeclRefExpr>(expr ? expr->IgnoreParenImpCasts() : nullptr);
+
+    return ref ? dyn_cast<VarDecl>(ref->getDecl()) : nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief What the increment \p inc adds to \p var: \c ++ and \c -- or \c += and \c -= with a constant.
+static llvm::Optional<int64_t> GetStep(const Expr* inc, const VarDecl& var)
+{
+    if(not inc) {
+        return {};
+    }
+
+    inc = inc->IgnoreParens();
+
+    if(const auto* unary = dyn_cast<UnaryOperator>(inc);
+       unary and unary->isIncrementDecrementOp() and (GetReferencedVar(unary->getSubExpr()) == &var)) {
+        return unary->isIncrementOp() ? 1 : -1;
+    }
+
+    if(const auto* assign = dyn_cast<CompoundAssignOperator>(inc);
+       assign and (GetReferencedVar(assign->getLHS()) == &var)) {
+        const auto step = EvaluateInt(assign->getRHS());
+
+        if(step and (BO_AddAssign == assign->getOpcode())) {
+            return step;
+
+        } else if(step and (BO_SubAssign == assign->getOpcode()) and
+                  (std::numeric_limits<int64_t>::min() != *step)) {
+            return -*step;
+        }
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The number of iterations of <tt>for(i = start; i op bound; i += step)</tt>, if the loop ends without \c i
+/// leaving <tt>[min, max]</tt>, the range of its type.
+static llvm::Optional<uint64_t> CountIterations(int64_t            start,
+                                                BinaryOperatorKind op,
+                                                int64_t            bound,
+                                                int64_t            step,
+                                                int64_t            min,
+                                                int64_t            max)
+{
+    constexpr auto lowest = std::numeric_limits<int64_t>::min();
+
+    if(0 == step) {
+        return {};
+    }
+
+    // A descending loop counts up with all values negated.
+    if(0 > step) {
+        if((lowest == start) or (lowest == bound) or (lowest == step) or (lowest == min)) {
+            return {};
+        }
+
+        const auto oldMin = min;
+        start             = -start;
+        bound             = -bound;
+        step              = -step;
+        min               = -max;
+        max               = -oldMin;
+
+        switch(op) {
+            case BO_GT: op = BO_LT; break;
+            case BO_GE: op = BO_LE; break;
+            case BO_NE: break;
+            default: return {};
+        }
+    }
+
+    // The distance in unsigned arithmetic, it does not overflow for start <= bound.
+    const auto distance = static_cast<uint64_t>(bound) - static_cast<uint64_t>(start);
+    const auto stride   = static_cast<uint64_t>(step);
+    uint64_t   trips{};
+
+    if((BO_LT == op) and (start < bound)) {
+        trips = ((distance - 1) / stride) + 1;
+
+    } else if((BO_LE == op) and (start <= bound)) {
+        trips = (distance / stride) + 1;
+
+    } else if((BO_NE == op) and (start <= bound) and (0 == (distance % stride))) {
+        trips = distance / stride;
+
+    } else {
+        // No iteration at all, or one which never ends.
+        return {};
+    }
+
+    // The value of the last increment has to fit into the type of the variable, otherwise the loop runs on.
+    if((start < min) or (start > max) or
+       (trips > ((static_cast<uint64_t>(max) - static_cast<uint64_t>(start)) / stride))) {
+        return {};
+    }
+
+    return trips;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p stmt can be repeated as part of an unrolled loop body and reads \p var at most.
+///
+/// \p inLoop and \p inSwitch tell whether a \c break or \c continue belongs to a statement nested in the body.
+static bool IsRepeatable(const Stmt* stmt, const VarDecl* var, const bool inLoop, const bool inSwitch)
+{
+    if(not stmt) {
+        return true;
+    }
+
+    if(isa<LambdaExpr>(stmt) or isa<LabelStmt>(stmt) or isa<GotoStmt>(stmt) or isa<IndirectGotoStmt>(stmt)) {
+        return false;
+
+    } else if(isa<BreakStmt>(stmt)) {
+        return inLoop or inSwitch;
+
+    } else if(isa<ContinueStmt>(stmt)) {
+        return inLoop;
+
+    } else if(const auto* declStmt = dyn_cast<DeclStmt>(stmt)) {
+        // Each copy would have its own static variable.
+        for(const auto* decl : declStmt->decls()) {
+            if(const auto* localVar = dyn_cast<VarDecl>(decl); localVar and localVar->isStaticLocal()) {
+                return false;
+            }
+        }
+    }
+
+    // Only a read of the induction variable keeps the trip count, anything else could change it.
+    const auto* implicitCast = dyn_cast<ImplicitCastExpr>(stmt);
+    const bool  isRead{implicitCast and (CK_LValueToRValue == implicitCast->getCastKind())};
+
+    const bool isLoop{isa<ForStmt>(stmt) or isa<WhileStmt>(stmt) or isa<DoStmt>(stmt) or isa<CXXForRangeStmt>(stmt)};
+    const bool isSwitch{isa<SwitchStmt>(stmt)};
+
+    for(const auto* child : stmt->children()) {
+        if(const auto* ref = dyn_cast_or_null<DeclRefExpr>(child);
+           var and not isRead and ref and (ref->getDecl() == var)) {
+            return false;
+        }
+
+        if(not IsRepeatable(child, var, inLoop or isLoop, inSwitch or isSwitch)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The range of values of the integer type \p type which fit into an \c int64_t.
+static std::pair<int64_t, int64_t> GetValueRange(QualType type)
+{
+    const auto width = GetGlobalAST().getIntWidth(type);
+
+    if(type->isUnsignedIntegerOrEnumerationType()) {
+        const auto max = (63 > width) ? static_cast<int64_t>((uint64_t{1} << width) - 1)
+                                      : std::numeric_limits<int64_t>::max();
+
+        return {0, max};
+    }
+
+    if(64 > width) {
+        return {-(int64_t{1} << (width - 1)), (int64_t{1} << (width - 1)) - 1};
+    }
+
+    return {std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()};
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<uint64_t> GetUnrollTripCount(const ForStmt& stmt)
+{
+    const auto* cond =
+        dyn_cast_or_null<BinaryOperator>(stmt.getCond() ? stmt.getCond()->IgnoreParenImpCasts() : nullptr);
+    const auto* init = dyn_cast_or_null<DeclStmt>(stmt.getInit());
+
+    if(not cond or not cond->isComparisonOp() or (BO_EQ == cond->getOpcode()) or not init or
+       stmt.getConditionVariable()) {
+        return {};
+    }
+
+    // The induction variable can be on either side of the comparison.
+    auto        op        = cond->getOpcode();
+    const auto* var       = GetReferencedVar(cond->getLHS());
+    const auto* boundExpr = cond->getRHS();
+
+    if(not var or not llvm::is_contained(init->decls(), var)) {
+        var       = GetReferencedVar(cond->getRHS());
+        boundExpr = cond->getLHS();
+        op        = BinaryOperator::reverseComparisonOp(op);
+    }
+
+    if(not var or not llvm::is_contained(init->decls(), var) or not var->getType()->isIntegerType() or
+       var->getType()->isBooleanType()) {
+        return {};
+    }
+
+    const auto start = EvaluateInt(var->getInit());
+    const auto bound = EvaluateInt(boundExpr);
+    const auto step  = GetStep(stmt.getInc(), *var);
+
+    if(not start or not bound or not step or not IsRepeatable(stmt.getBody(), var, false, false) or
+       not IsRepeatable(stmt.getInc(), nullptr, false, false)) {
+        return {};
+    }
+
+    const auto [min, max] = GetValueRange(var->getType());
+
+    return CountIterations(*start, op, *bound, *step, min, max);
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<uint64_t> GetUnrollTripCount(const CXXForRangeStmt& stmt)
+{
+    // In a template the begin and end statements are missing.
+    if(not stmt.getBeginStmt() or not stmt.getEndStmt() or not stmt.getRangeInit() or
+       not IsRepeatable(stmt.getBody(), nullptr, false, false)) {
+        return {};
+    }
+
+    const auto& ctx  = GetGlobalAST();
+    const auto  type = stmt.getRangeInit()->getType().getNonReferenceType();
+    uint64_t    trips{};
+
+    if(const auto* arrayType = ctx.getAsConstantArrayType(type)) {
+        trips = arrayType->getSize().getZExtValue();
+
+    } else if(const auto* spec = dyn_cast_or_null<ClassTemplateSpecializationDecl>(type->getAsCXXRecordDecl());
+              spec and spec->isInStdNamespace() and spec->getIdentifier() and (spec->getName() == "array")) {
+        const auto& args = spec->getTemplateArgs();
+
+        if((2 != args.size()) or (TemplateArgument::Integral != args[1].getKind())) {
+            return {};
+        }
+
+        trips = args[1].getAsIntegral().getZExtValue();
+    }
+
+    if(0 == trips) {
+        return {};
+    }
+
+    return trips;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetUnrollNote(const uint64_t tripCount, const uint64_t factor)
+{
+    if(tripCount <= factor) {
+        return StrCat("alt-syntax-unroll: trip count ", tripCount, ", fully unrolled");
+    }
+
+    const auto  peeled = tripCount % factor;
+    std::string note{StrCat("alt-syntax-unroll: trip count ", tripCount, ", unrolled by ", factor)};
+
+    if(0 == peeled) {
+        return note;
+    }
+
+    return StrCat(note, ", ", peeled, (1 == peeled) ? " iteration" : " iterations", " peeled off in front");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
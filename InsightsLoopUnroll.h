@@ -0,0 +1,45 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_LOOP_UNROLL_H
+#define INSIGHTS_LOOP_UNROLL_H
+
+#include "llvm/ADT/Optional.h"
+
+#include <cstdint>
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CXXForRangeStmt;
+class ForStmt;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The trip count of \p stmt, if \c --alt-syntax-unroll can unroll it.
+///
+/// That is a loop like <tt>for(int i = 0; i < 10; i += 2)</tt>: the init-statement declares the induction variable,
+/// the condition compares it with a constant and the increment adds a constant to it. The initial value has to be a
+/// constant as well. The body may only read the induction variable, and it must be possible to repeat it: no \c break
+/// or \c continue of the loop itself, no label and no lambda, whose class would be defined more than once.
+llvm::Optional<uint64_t> GetUnrollTripCount(const ForStmt& stmt);
+//-----------------------------------------------------------------------------
+
+/// \brief The trip count of \p stmt, if it iterates over a built-in array or a \c std::array and the body can be
+/// repeated, see above.
+llvm::Optional<uint64_t> GetUnrollTripCount(const CXXForRangeStmt& stmt);
+//-----------------------------------------------------------------------------
+
+/// \brief The note in front of a loop with \p tripCount iterations, unrolled by \p factor.
+std::string GetUnrollNote(const uint64_t tripCount, const uint64_t factor);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_LOOP_UNROLL_H */
@@ -0,0 +1,319 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/CodeGen/CodeGenAction.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
+#include "llvm/Demangle/Demangle.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "ClangCompat.h"
+#include "DPrint.h"
+#include "InsightsLowering.h"
+#include "InsightsVerifyOutput.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The comments the verbose assembly puts around each function.
+static constexpr llvm::StringLiteral BEGIN_FUNCTION{"-- Begin function "};
+static constexpr llvm::StringLiteral END_FUNCTION{"-- End function"};
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief A function of the compiled result.
+struct LoweredFunction
+{
+    std::string symbol{};
+    unsigned    line{};  //!< The line in the result, 0 for a function from another file.
+    unsigned    instructions{};
+    std::string code{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The code generator only knows the targets which are initialized.
+static void InitializeTargets()
+{
+    static std::once_flag initialized{};
+
+    std::call_once(initialized, [] {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+    });
+}
+//-----------------------------------------------------------------------------
+
+static bool IsResultFile(llvm::StringRef path, llvm::StringRef resultFile)
+{
+    return llvm::sys::path::filename(path) == llvm::sys::path::filename(resultFile);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Let \p invocation generate code at \c -O\p optLevel, with the line tables which map each function back.
+static void SetCodeGenOptions(CompilerInvocation& invocation, const unsigned optLevel)
+{
+    invocation.getFrontendOpts().DisableFree = false;
+
+    auto& codeGenOpts             = invocation.getCodeGenOpts();
+    codeGenOpts.OptimizationLevel = optLevel;
+    codeGenOpts.AsmVerbose        = true;
+
+#if IS_CLANG_NEWER_THAN(16)
+    codeGenOpts.setDebugInfo(llvm::codegenoptions::DebugLineTablesOnly);
+#else
+    codeGenOpts.setDebugInfo(codegenoptions::DebugLineTablesOnly);
+#endif
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The IR of the functions defined in \p module, the debug info is removed after reading the lines.
+static std::vector<LoweredFunction> GetIRFunctions(llvm::Module& module, llvm::StringRef resultFile)
+{
+    std::vector<LoweredFunction> functions{};
+
+    for(const auto& function : module) {
+        if(function.isDeclaration()) {
+            continue;
+        }
+
+        LoweredFunction lowered{function.getName().str()};
+
+        if(const auto* subprogram = function.getSubprogram();
+           subprogram and IsResultFile(subprogram->getFilename(), resultFile)) {
+            lowered.line = subprogram->getLine();
+        }
+
+        lowered.instructions = function.getInstructionCount();
+        functions.push_back(std::move(lowered));
+    }
+
+    // Otherwise each instruction carries a !dbg attachment.
+    llvm::StripDebugInfo(module);
+
+    auto lowered = functions.begin();
+
+    for(const auto& function : module) {
+        if(function.isDeclaration()) {
+            continue;
+        }
+
+        llvm::raw_string_ostream code{lowered->code};
+        function.print(code);
+        code.flush();
+
+        ++lowered;
+    }
+
+    return functions;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The last quoted string of a \c .file directive, the file name.
+static llvm::StringRef GetFileDirectiveName(llvm::StringRef directive)
+{
+    const auto end = directive.rfind('"');
+
+    if(llvm::StringRef::npos == end) {
+        return {};
+    }
+
+    directive        = directive.take_front(end);
+    const auto begin = directive.rfind('"');
+
+    return (llvm::StringRef::npos == begin) ? llvm::StringRef{} : directive.drop_front(begin + 1);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Split \p assembly into its functions, without the directives and the labels of the debug info.
+static std::vector<LoweredFunction> GetAsmFunctions(llvm::StringRef assembly, llvm::StringRef resultFile)
+{
+    std::vector<LoweredFunction> functions{};
+    std::vector<unsigned>        resultFileNumbers{};
+    LoweredFunction*             current{};
+
+    auto getNumber = [](llvm::StringRef& operands) {
+        unsigned number{};
+        operands = operands.ltrim();
+        operands.consumeInteger(10, number);
+
+        return number;
+    };
+
+    while(not assembly.empty()) {
+        llvm::StringRef line{};
+        std::tie(line, assembly) = assembly.split('\n');
+
+        const llvm::StringRef trimmed{line.trim()};
+
+        if(const auto begin = trimmed.find(BEGIN_FUNCTION); llvm::StringRef::npos != begin) {
+            functions.push_back({trimmed.drop_front(begin + BEGIN_FUNCTION.size()).trim().str()});
+            current = &functions.back();
+            continue;
+
+        } else if(llvm::StringRef::npos != trimmed.find(END_FUNCTION)) {
+            current = nullptr;
+            continue;
+
+        } else if(llvm::StringRef operands{trimmed}; operands.consume_front(".file")) {
+            if(const unsigned number = getNumber(operands);
+               (not operands.empty()) and IsResultFile(GetFileDirectiveName(operands), resultFile)) {
+                resultFileNumbers.push_back(number);
+            }
+
+            continue;
+        }
+
+        if(not current or trimmed.empty()) {
+            continue;
+        }
+
+        if(llvm::StringRef operands{trimmed}; operands.consume_front(".loc")) {
+            const unsigned file = getNumber(operands);
+            const unsigned row  = getNumber(operands);
+
+            if((0 == current->line) and llvm::is_contained(resultFileNumbers, file)) {
+                current->line = row;
+            }
+
+            continue;
+        }
+
+        const bool isLabel{trimmed.endswith(":")};
+
+        // The labels the debug info and the size of the function refer to.
+        const bool isDebugLabel{isLabel and ((llvm::StringRef::npos != trimmed.find("tmp")) or
+                                             (llvm::StringRef::npos != trimmed.find("func_begin")) or
+                                             (llvm::StringRef::npos != trimmed.find("func_end")))};
+
+        if(isDebugLabel or (trimmed.startswith(".") and not isLabel) or trimmed.startswith("#") or
+           trimmed.startswith("//") or trimmed.startswith(";")) {
+            continue;
+        }
+
+        if(not isLabel) {
+            ++current->instructions;
+        }
+
+        current->code.append(line.rtrim().str()).append(1, '\n');
+    }
+
+    return functions;
+}
+//-----------------------------------------------------------------------------
+
+static std::string ToJsonString(llvm::StringRef str)
+{
+    return llvm::json::isUTF8(str) ? str.str() : llvm::json::fixUTF8(str);
+}
+//-----------------------------------------------------------------------------
+
+bool WriteLowered(llvm::StringRef     fileName,
+                  CompilerInstance&   ci,
+                  llvm::StringRef     result,
+                  const LoweredFormat format,
+                  const unsigned      optLevel)
+{
+    auto invocation = CreateResultInvocation(ci, result);
+
+    if(not invocation) {
+        return false;
+    }
+
+    InitializeTargets();
+    SetCodeGenOptions(*invocation, optLevel);
+
+    const std::string resultFile{invocation->getFrontendOpts().Inputs.front().getFile()};
+
+    std::string              diagnostics{};
+    llvm::raw_string_ostream diagStream{diagnostics};
+
+    CompilerInstance compiler{ci.getPCHContainerOperations()};
+    compiler.setInvocation(std::move(invocation));
+    compiler.setFileManager(&ci.getFileManager());
+    compiler.createDiagnostics(new TextDiagnosticPrinter{diagStream, &compiler.getDiagnosticOpts()},
+                               /*ShouldOwnClient*/ true);
+
+    llvm::LLVMContext            llvmContext{};
+    std::vector<LoweredFunction> functions{};
+
+    if(LoweredFormat::IR == format) {
+        EmitLLVMOnlyAction action{&llvmContext};
+
+        if(compiler.ExecuteAction(action)) {
+            if(auto module = action.takeModule()) {
+                functions = GetIRFunctions(*module, resultFile);
+            }
+        }
+
+    } else {
+        llvm::SmallString<128> assemblyPath{};
+
+        if(const auto ec = llvm::sys::fs::createTemporaryFile("insights-lowered", "s", assemblyPath)) {
+            Error("cannot create a file for --lowered: %s\n", ec.message());
+            return false;
+        }
+
+        compiler.getFrontendOpts().OutputFile = assemblyPath.str().str();
+
+        EmitAssemblyAction action{&llvmContext};
+
+        if(compiler.ExecuteAction(action)) {
+            if(auto assembly = llvm::MemoryBuffer::getFile(assemblyPath)) {
+                functions = GetAsmFunctions(assembly.get()->getBuffer(), resultFile);
+            }
+        }
+
+        llvm::sys::fs::remove(assemblyPath);
+    }
+
+    diagStream.flush();
+
+    llvm::json::Array functionsJson{};
+
+    for(const auto& function : functions) {
+        functionsJson.push_back(llvm::json::Object{{"name", ToJsonString(llvm::demangle(function.symbol))},
+                                                   {"symbol", ToJsonString(function.symbol)},
+                                                   {"line", static_cast<int64_t>(function.line)},
+                                                   {"instructions", static_cast<int64_t>(function.instructions)},
+                                                   {"code", ToJsonString(function.code)}});
+    }
+
+    std::error_code      ec{};
+    llvm::raw_fd_ostream out{fileName, ec, llvm::sys::fs::OF_Text};
+
+    if(ec) {
+        Error("cannot write lowered code '%s': %s\n", fileName, ec.message());
+        return false;
+    }
+
+    out << llvm::json::Value{llvm::json::Object{{"format", (LoweredFormat::IR == format) ? "ir" : "asm"},
+                                                {"optLevel", static_cast<int64_t>(optLevel)},
+                                                {"result", ToJsonString(result)},
+                                                {"diagnostics", ToJsonString(diagnostics)},
+                                                {"functions", std::move(functionsJson)}}}
+        << '\n';
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
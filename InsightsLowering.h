@@ -0,0 +1,46 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_LOWERING_H
+#define INSIGHTS_LOWERING_H
+
+#include "llvm/ADT/StringRef.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CompilerInstance;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+enum class LoweredFormat
+{
+    IR,
+    Asm,
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Compile \p result, the transformed main file of \p ci, at \c -O\p optLevel and write the LLVM IR or the
+/// assembly of each function to \p fileName as JSON, see \c --lowered.
+///
+/// The compilation uses the invocation of \ref CreateResultInvocation plus line tables, which map each function back
+/// to its line in \p result. The JSON holds the options, \p result itself, the diagnostics and per function its name,
+/// its symbol, its line, 0 for functions from other files, its instruction count and its code. If \p result does not
+/// compile, there are no functions and the diagnostics say why.
+///
+/// \returns \c false, if the file could not be written.
+bool WriteLowered(llvm::StringRef     fileName,
+                  CompilerInstance&   ci,
+                  llvm::StringRef     result,
+                  const LoweredFormat format,
+                  const unsigned      optLevel);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_LOWERING_H */
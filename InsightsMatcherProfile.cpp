@@ -0,0 +1,125 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "InsightsMatcherProfile.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Separates the handler from the matcher in the ID of a \ref ProfiledMatchCallback.
+static constexpr const char* ID_SEPARATOR{"/"};
+//-----------------------------------------------------------------------------
+
+static bool                              gMatcherProfilingEnabled{};
+static std::mutex                        gMatcherProfileMutex{};
+static llvm::StringMap<llvm::TimeRecord> gMatcherProfile{};
+//-----------------------------------------------------------------------------
+
+void EnableMatcherProfiling()
+{
+    gMatcherProfilingEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsMatcherProfilingEnabled()
+{
+    return gMatcherProfilingEnabled;
+}
+//-----------------------------------------------------------------------------
+
+ast_matchers::MatchFinder::MatchFinderOptions GetMatchFinderOptions(llvm::StringMap<llvm::TimeRecord>& records)
+{
+    ast_matchers::MatchFinder::MatchFinderOptions options{};
+
+    if(gMatcherProfilingEnabled) {
+        options.CheckProfiling.emplace(records);
+    }
+
+    return options;
+}
+//-----------------------------------------------------------------------------
+
+void AddMatcherProfile(const llvm::StringMap<llvm::TimeRecord>& records)
+{
+    std::lock_guard<std::mutex> lock{gMatcherProfileMutex};
+
+    for(const auto& record : records) {
+        gMatcherProfile[record.getKey()] += record.getValue();
+    }
+}
+//-----------------------------------------------------------------------------
+
+void PrintMatcherProfile(llvm::raw_ostream& ostream)
+{
+    struct Row
+    {
+        llvm::StringRef matcher;
+        double          wall;
+        double          cpu;
+    };
+
+    struct Group
+    {
+        llvm::StringRef  handler;
+        double           wall;
+        std::vector<Row> rows;
+    };
+
+    std::lock_guard<std::mutex> lock{gMatcherProfileMutex};
+    std::vector<Group>          groups{};
+
+    for(const auto& record : gMatcherProfile) {
+        const auto [handler, matcher] = record.getKey().split(ID_SEPARATOR);
+        const auto& time              = record.getValue();
+
+        auto group = std::find_if(groups.begin(), groups.end(), [&](const Group& g) { return g.handler == handler; });
+
+        if(groups.end() == group) {
+            group = groups.insert(groups.end(), Group{handler, 0, {}});
+        }
+
+        group->wall += time.getWallTime();
+        group->rows.push_back({matcher, time.getWallTime(), time.getProcessTime()});
+    }
+
+    std::sort(groups.begin(), groups.end(), [](const Group& a, const Group& b) { return a.wall > b.wall; });
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                        C++ Insights matcher profile\n"
+            << "===-------------------------------------------------------------------------===\n"
+            << llvm::format("  %-40s %12s %12s\n", "Matcher", "Wall (ms)", "CPU (ms)");
+
+    for(auto& group : groups) {
+        std::sort(group.rows.begin(), group.rows.end(), [](const Row& a, const Row& b) { return a.wall > b.wall; });
+
+        ostream << llvm::format("  %-40s %12.3f\n", group.handler.str().c_str(), group.wall * 1000.0);
+
+        for(const auto& row : group.rows) {
+            ostream << llvm::format(
+                "    %-38s %12.3f %12.3f\n", row.matcher.str().c_str(), row.wall * 1000.0, row.cpu * 1000.0);
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+ProfiledMatchCallback::ProfiledMatchCallback(ast_matchers::MatchFinder::MatchCallback& handler,
+                                             const size_t                              index,
+                                             llvm::StringRef                           nodeKind)
+: mHandler{handler}
+, mID{StrCat(handler.getID(), ID_SEPARATOR, "#", index, " ", nodeKind.str())}
+{
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
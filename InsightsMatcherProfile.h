@@ -0,0 +1,64 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_MATCHER_PROFILE_H
+#define INSIGHTS_MATCHER_PROFILE_H
+
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+void EnableMatcherProfiling();
+bool IsMatcherProfilingEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief The options for a \c MatchFinder. With \c --profile-matchers the time of each matcher is recorded in \p
+/// records.
+ast_matchers::MatchFinder::MatchFinderOptions GetMatchFinderOptions(llvm::StringMap<llvm::TimeRecord>& records);
+//-----------------------------------------------------------------------------
+
+/// \brief Add the \p records of one \c MatchFinder run to the profile.
+void AddMatcherProfile(const llvm::StringMap<llvm::TimeRecord>& records);
+//-----------------------------------------------------------------------------
+
+/// \brief Print the time per matcher, grouped by handler. Both, the handlers and the matchers of a handler, are sorted
+/// by cost.
+void PrintMatcherProfile(llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+/// \brief Forwards the matches of a single matcher to its handler.
+///
+/// \c MatchFinder records the profile per callback ID. Handlers register each matcher with a callback of its own to
+/// get a row per matcher instead of one per handler.
+class ProfiledMatchCallback final : public ast_matchers::MatchFinder::MatchCallback
+{
+public:
+    ProfiledMatchCallback(ast_matchers::MatchFinder::MatchCallback& handler,
+                          const size_t                              index,
+                          llvm::StringRef                           nodeKind);
+
+    void run(const ast_matchers::MatchFinder::MatchResult& result) override { mHandler.run(result); }
+    void onStartOfTranslationUnit() override { mHandler.onStartOfTranslationUnit(); }
+    void onEndOfTranslationUnit() override { mHandler.onEndOfTranslationUnit(); }
+
+    llvm::StringRef getID() const override { return mID; }
+
+private:
+    ast_matchers::MatchFinder::MatchCallback& mHandler;
+    const std::string                         mID;
+};
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_MATCHER_PROFILE_H */
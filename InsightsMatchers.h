@@ -65,6 +65,16 @@ AST_POLYMORPHIC_MATCHER(isInvalidLocation, AST_POLYMORPHIC_SUPPORTED_TYPES(Decl,
     return insights::IsInvalidLocation(insights::GetBeginLoc(Node));
 }
 
+/// \brief Same as \c isExpansionInSystemHeader, with the kind of the file looked up once per \c FileID, see \ref
+/// insights::GetFileKind.
+AST_POLYMORPHIC_MATCHER(isInSystemHeader, AST_POLYMORPHIC_SUPPORTED_TYPES(Decl, Stmt))
+{
+    (void)Builder;
+
+    return insights::IsExpansionInSystemHeader(Finder->getASTContext().getSourceManager(),
+                                               insights::GetBeginLoc(Node));
+}
+
 }  // namespace ast_matchers
 }  // namespace clang
 //-----------------------------------------------------------------------------
@@ -0,0 +1,378 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif /* _WIN32 */
+
+#include "InsightsHeapProfile.h"
+#include "InsightsMemReport.h"
+#include "InsightsNodeProfile.h"
+#include "InsightsStrCat.h"
+#include "InsightsTimeReport.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief One slot per \ref TimePhase and one for everything outside of a phase.
+static constexpr auto BUFFER_SLOTS{static_cast<size_t>(TimePhase::Count) + 1};
+//-----------------------------------------------------------------------------
+
+static bool                                            gMemReportEnabled{};
+static std::atomic<uint64_t>                           gASTMemory{};
+static std::atomic<uint64_t>                           gRewriteBufferSize{};
+static std::array<std::atomic<uint64_t>, BUFFER_SLOTS> gOutputBufferSizes{};
+static std::atomic<uint64_t>                           gHeapAllocations{};
+static std::atomic<uint64_t>                           gTranslationUnits{};
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief The allocations of one handler and node kind. The type is trivial, the table of a thread needs no
+/// initialization which could allocate.
+struct AllocationSite
+{
+    const char* kind;  //!< The node kind, \c nullptr outside of the code generation.
+    bool        isDecl;
+    TimePhase   phase;
+    uint64_t    count;
+    uint64_t    bytes;
+};
+
+struct SiteTotals
+{
+    uint64_t count{};
+    uint64_t bytes{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The slots of the table of a thread, enough for the node kinds the handlers usually see.
+static constexpr size_t SITE_SLOTS{512};
+/// \brief How many slots are tried before an allocation goes to the overflow.
+static constexpr size_t SITE_PROBES{8};
+
+static bool                                                gAllocationSitesEnabled{};
+static std::mutex                                          gAllocationSitesMutex{};
+static llvm::StringMap<SiteTotals>                         gAllocationSites{};
+static thread_local std::array<AllocationSite, SITE_SLOTS> gThreadSites{};
+static thread_local AllocationSite                         gThreadOverflow{};
+//-----------------------------------------------------------------------------
+
+void EnableAllocationSites()
+{
+    gAllocationSitesEnabled = true;
+    EnableNodeTracking();
+}
+//-----------------------------------------------------------------------------
+
+bool IsAllocationSitesEnabled()
+{
+    return gAllocationSitesEnabled;
+}
+//-----------------------------------------------------------------------------
+
+static void RecordAllocationSite(const std::size_t size)
+{
+    const auto* scope  = GetCurrentNodeScope();
+    const char* kind   = scope ? scope->GetKind() : nullptr;
+    const bool  isDecl = scope and scope->IsDecl();
+    const auto  phase  = GetCurrentTimePhase();
+
+    const size_t hash{(reinterpret_cast<uintptr_t>(kind) >> 3) ^ (static_cast<size_t>(phase) * 31) ^ isDecl};
+
+    for(size_t i = 0; i < SITE_PROBES; ++i) {
+        auto& site = gThreadSites[(hash + i) % SITE_SLOTS];
+
+        // A used slot has a count, a free one can take the site.
+        if((0 == site.count) or ((site.kind == kind) and (site.isDecl == isDecl) and (site.phase == phase))) {
+            site.kind   = kind;
+            site.isDecl = isDecl;
+            site.phase  = phase;
+            ++site.count;
+            site.bytes += size;
+            return;
+        }
+    }
+
+    ++gThreadOverflow.count;
+    gThreadOverflow.bytes += size;
+}
+//-----------------------------------------------------------------------------
+
+void AddAllocationSites()
+{
+    // Adding to the report allocates, which changes the table of this thread. Take it first.
+    const auto sites    = gThreadSites;
+    const auto overflow = gThreadOverflow;
+    gThreadSites        = {};
+    gThreadOverflow     = {};
+
+    auto add = [](const std::string& name, const AllocationSite& site) {
+        auto& totals = gAllocationSites[name];
+        totals.count += site.count;
+        totals.bytes += site.bytes;
+    };
+
+    std::lock_guard lock{gAllocationSitesMutex};
+
+    for(const auto& site : sites) {
+        if(0 == site.count) {
+            continue;
+        }
+
+        // The names of the declaration kinds come without the Decl, VarDecl is Var.
+        add(StrCat(GetTimePhaseName(site.phase),
+                   " / ",
+                   site.kind ? site.kind : "(no node)",
+                   (site.kind and site.isDecl) ? "Decl" : ""),
+            site);
+    }
+
+    if(0 != overflow.count) {
+        add("(other)", overflow);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void PrintAllocationSites(llvm::raw_ostream& ostream)
+{
+    // The sites after the first ones hardly matter, they would only make the report long.
+    static constexpr size_t MAX_ROWS{25};
+
+    // The allocations of the thread printing the report since its last translation unit.
+    AddAllocationSites();
+
+    std::lock_guard lock{gAllocationSitesMutex};
+
+    std::vector<const llvm::StringMapEntry<SiteTotals>*> sites{};
+
+    for(const auto& entry : gAllocationSites) {
+        sites.push_back(&entry);
+    }
+
+    std::stable_sort(sites.begin(), sites.end(), [](const auto* a, const auto* b) {
+        if(a->second.count != b->second.count) {
+            return a->second.count > b->second.count;
+        }
+
+        return a->first() < b->first();
+    });
+
+    if(sites.size() > MAX_ROWS) {
+        sites.resize(MAX_ROWS);
+    }
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                      C++ Insights allocation sites\n"
+            << "===-------------------------------------------------------------------------===\n"
+            << llvm::format("  %-50s %12s %14s\n", "Handler / Node", "Allocations", "Bytes");
+
+    for(const auto* entry : sites) {
+        ostream << llvm::format("  %-50s %12llu %14llu\n",
+                                entry->first().str().c_str(),
+                                static_cast<unsigned long long>(entry->second.count),
+                                static_cast<unsigned long long>(entry->second.bytes));
+    }
+}
+//-----------------------------------------------------------------------------
+
+void RecordHeapAllocation(const std::size_t size)
+{
+    if(gMemReportEnabled) {
+        gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if(gAllocationSitesEnabled) {
+        RecordAllocationSite(size);
+    }
+
+    if(IsHeapProfileEnabled()) {
+        SampleHeapAllocation(size);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void EnableMemReport()
+{
+    gMemReportEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsMemReportEnabled()
+{
+    return gMemReportEnabled;
+}
+//-----------------------------------------------------------------------------
+
+void ResetMemReport()
+{
+    gASTMemory         = 0;
+    gRewriteBufferSize = 0;
+    gHeapAllocations   = 0;
+    gTranslationUnits  = 0;
+
+    for(auto& size : gOutputBufferSizes) {
+        size = 0;
+    }
+}
+//-----------------------------------------------------------------------------
+
+void RecordASTMemory(const ASTContext& context)
+{
+    if(gMemReportEnabled) {
+        gASTMemory += context.getASTAllocatedMemory() + context.getSideTableAllocatedMemory();
+        ++gTranslationUnits;
+    }
+}
+//-----------------------------------------------------------------------------
+
+void RecordRewriteBufferSize(const size_t size)
+{
+    if(gMemReportEnabled) {
+        gRewriteBufferSize += size;
+    }
+}
+//-----------------------------------------------------------------------------
+
+void RecordOutputBufferSize(const size_t size)
+{
+    if(gMemReportEnabled) {
+        gOutputBufferSizes[static_cast<size_t>(GetCurrentTimePhase())] += size;
+    }
+}
+//-----------------------------------------------------------------------------
+
+uint64_t GetPeakRSS()
+{
+#ifndef _WIN32
+    rusage usage{};
+
+    if(0 == getrusage(RUSAGE_SELF, &usage)) {
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        // Linux reports kilobytes.
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif /* __APPLE__ */
+    }
+#endif /* _WIN32 */
+
+    return 0;
+}
+//-----------------------------------------------------------------------------
+
+RssUsage GetRssUsage(const int pid)
+{
+    RssUsage usage{};
+
+    // Only Linux tells, in kilobytes. The rollup sums up all mappings of the process.
+    std::ifstream smaps{(0 == pid) ? std::string{"/proc/self/smaps_rollup"}
+                                   : "/proc/" + std::to_string(pid) + "/smaps_rollup"};
+
+    for(std::string line{}; std::getline(smaps, line);) {
+        const auto [name, value] = llvm::StringRef{line}.split(':');
+        uint64_t kilobytes{};
+
+        // The lines look like "Shared_Clean:       1234 kB".
+        if(value.trim().split(' ').first.getAsInteger(10, kilobytes)) {
+            continue;
+        }
+
+        if(("Shared_Clean" == name) or ("Shared_Dirty" == name)) {
+            usage.shared += kilobytes * 1024;
+        } else if(("Private_Clean" == name) or ("Private_Dirty" == name)) {
+            usage.privateBytes += kilobytes * 1024;
+        }
+    }
+
+    return usage;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The heap allocations per translation unit, all of them if there was none.
+static uint64_t GetHeapAllocationsPerTU()
+{
+    return gHeapAllocations / std::max<uint64_t>(1, gTranslationUnits);
+}
+//-----------------------------------------------------------------------------
+
+llvm::json::Object GetMemReportJSON()
+{
+    llvm::json::Object outputBuffers{};
+
+    for(size_t i = 0; i < BUFFER_SLOTS; ++i) {
+        if(const uint64_t size = gOutputBufferSizes[i]) {
+            outputBuffers[GetTimePhaseName(static_cast<TimePhase>(i))] = static_cast<int64_t>(size);
+        }
+    }
+
+    const auto rss = GetRssUsage();
+
+    return llvm::json::Object{{"peakRSS", static_cast<int64_t>(GetPeakRSS())},
+                              {"sharedRSS", static_cast<int64_t>(rss.shared)},
+                              {"privateRSS", static_cast<int64_t>(rss.privateBytes)},
+                              {"astAllocated", static_cast<int64_t>(gASTMemory.load())},
+                              {"rewriteBuffer", static_cast<int64_t>(gRewriteBufferSize.load())},
+                              {"outputBuffers", std::move(outputBuffers)},
+                              {"heapAllocations", static_cast<int64_t>(gHeapAllocations.load())},
+                              {"heapAllocationsPerTU", static_cast<int64_t>(GetHeapAllocationsPerTU())}};
+}
+//-----------------------------------------------------------------------------
+
+void PrintMemReport(llvm::raw_ostream& ostream, const bool asJson)
+{
+    if(asJson) {
+        ostream << llvm::json::Value{GetMemReportJSON()} << '\n';
+        return;
+    }
+
+    auto printLine = [&](const char* name, const uint64_t bytes) {
+        ostream << llvm::format("  %-26s %14llu\n", name, static_cast<unsigned long long>(bytes));
+    };
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                          C++ Insights memory report\n"
+            << "===-------------------------------------------------------------------------===\n"
+            << llvm::format("  %-26s %14s\n", "Item", "Bytes");
+
+    const auto rss = GetRssUsage();
+
+    printLine("Peak RSS", GetPeakRSS());
+    printLine("Shared RSS", rss.shared);
+    printLine("Private RSS", rss.privateBytes);
+    printLine("ASTContext allocated", gASTMemory);
+    printLine("Output sink", gRewriteBufferSize);
+
+    ostream << "  Output buffers:\n";
+
+    for(size_t i = 0; i < BUFFER_SLOTS; ++i) {
+        if(const uint64_t size = gOutputBufferSizes[i]) {
+            printLine((std::string{"  "} + GetTimePhaseName(static_cast<TimePhase>(i))).c_str(), size);
+        }
+    }
+
+    ostream << llvm::format("  %-26s %14s\n", "Item", "Count");
+
+    printLine("Heap allocations", gHeapAllocations);
+    printLine("Heap allocations per TU", GetHeapAllocationsPerTU());
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,96 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_MEM_REPORT_H
+#define INSIGHTS_MEM_REPORT_H
+
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstddef>
+#include <cstdint>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class ASTContext;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+void EnableMemReport();
+bool IsMemReportEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Clear all collected data, used to get a report per request.
+void ResetMemReport();
+//-----------------------------------------------------------------------------
+
+/// \brief Record the memory allocated by \p context, called once the code generation is done.
+void RecordASTMemory(const ASTContext& context);
+//-----------------------------------------------------------------------------
+
+/// \brief Record the size of the generated code for the main file, see \ref OutputSink.
+void RecordRewriteBufferSize(const size_t size);
+//-----------------------------------------------------------------------------
+
+/// \brief Record the bytes of an \ref OutputFormatHelper buffer, they are attributed to the current handler.
+void RecordOutputBufferSize(const size_t size);
+//-----------------------------------------------------------------------------
+
+/// \brief The peak resident set size of the process in bytes, 0 if the platform does not tell.
+uint64_t GetPeakRSS();
+//-----------------------------------------------------------------------------
+
+/// \brief The resident set of a process, split into the pages it shares with other processes and its own ones.
+struct RssUsage
+{
+    uint64_t shared{};
+    uint64_t privateBytes{};
+};
+
+/// \brief The current resident set of the process \p pid, of this one for 0. All zero, if the platform does not tell.
+///
+/// Pages of a mapped PCH, which the workers of \c --worker-pool map from the same file, count as shared.
+RssUsage GetRssUsage(const int pid = 0);
+//-----------------------------------------------------------------------------
+
+/// \brief Print peak RSS, the shared and private RSS, the AST memory, the rewrite buffer, the output buffers per handler and the number of heap
+/// allocations.
+void PrintMemReport(llvm::raw_ostream& ostream, const bool asJson);
+//-----------------------------------------------------------------------------
+
+llvm::json::Object GetMemReportJSON();
+//-----------------------------------------------------------------------------
+
+/// \brief Count a heap allocation of \p size bytes for the memory report, the allocation sites and the heap profile.
+///
+/// Called by the replaced global \c operator \c new, which only the \c insights executable links, see
+/// InsightsOperatorNew.cpp. It must not allocate.
+void RecordHeapAllocation(const std::size_t size);
+//-----------------------------------------------------------------------------
+
+/// \brief Attribute each heap allocation to the current handler and the innermost node kind of the code generation,
+/// see \c --alloc-sites.
+///
+/// The global \c operator \c new counts the allocations and their bytes per site in a fixed table of the current
+/// thread, it must not allocate itself.
+void EnableAllocationSites();
+bool IsAllocationSitesEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Add the allocation sites the current thread counted to the report. Called after each translation unit.
+void AddAllocationSites();
+//-----------------------------------------------------------------------------
+
+/// \brief Print the sites with the most allocations.
+void PrintAllocationSites(llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_MEM_REPORT_H */
@@ -0,0 +1,204 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/Stmt.h"
+
+#include "InsightsHelpers.h"
+#include "InsightsLoopUnroll.h"
+#include "InsightsMemcpy.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+uint64_t GetMemcpyBytes(const CXXMethodDecl& method)
+{
+    const bool isCopyOrMove = [&] {
+        if(const auto* ctor = dyn_cast<CXXConstructorDecl>(&method)) {
+            return ctor->isCopyOrMoveConstructor();
+        }
+
+        return method.isCopyAssignmentOperator() or method.isMoveAssignmentOperator();
+    }();
+
+    const auto* record = method.getParent();
+
+    if(not isCopyOrMove or not method.isTrivial() or record->isEmpty() or record->isDependentType()) {
+        return 0;
+    }
+
+    const auto& ctx = GetGlobalAST();
+
+    return static_cast<uint64_t>(ctx.getTypeSizeInChars(ctx.getRecordType(record)).getQuantity());
+}
+//-----------------------------------------------------------------------------
+
+const Expr* GetMemcpySource(const Expr& arg)
+{
+    const auto* source = arg.IgnoreParenImpCasts();
+
+    if(const auto* call = dyn_cast<CallExpr>(source); call and call->isCallToStdMove()) {
+        source = call->getArg(0)->IgnoreParenImpCasts();
+    }
+
+    // A derived object sliced to its base does not necessarily start with the base.
+    if(not source->isLValue() or
+       not GetGlobalAST().hasSameUnqualifiedType(source->getType(), arg.getType().getNonReferenceType())) {
+        return nullptr;
+    }
+
+    return source;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p inc adds one to \p var: \c ++var, \c var++ or <tt>var += 1</tt>.
+static bool IsIncrementByOne(const Expr* inc, const VarDecl& var)
+{
+    const auto refersToVar = [&](const Expr* expr) {
+        const auto* ref = dyn_cast<DeclRefExpr>(expr->IgnoreParenImpCasts());
+
+        return ref and (ref->getDecl() == &var);
+    };
+
+    if(const auto* unary = dyn_cast_or_null<UnaryOperator>(inc)) {
+        return unary->isIncrementOp() and refersToVar(unary->getSubExpr());
+
+    } else if(const auto* assign = dyn_cast_or_null<CompoundAssignOperator>(inc);
+              assign and (BO_AddAssign == assign->getOpcode()) and refersToVar(assign->getLHS())) {
+        const auto* one = dyn_cast<IntegerLiteral>(assign->getRHS()->IgnoreParenImpCasts());
+
+        return one and (1 == one->getValue());
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief \p expr as <tt>array[var]</tt> of a named array or pointer, \c nullptr if it is something else.
+static const ArraySubscriptExpr* GetElementAt(const Expr* expr, const VarDecl& var)
+{
+    const auto* subscript = dyn_cast<ArraySubscriptExpr>(expr->IgnoreParenImpCasts());
+
+    if(not subscript or not isa<DeclRefExpr>(subscript->getBase()->IgnoreParenImpCasts())) {
+        return nullptr;
+    }
+
+    const auto* index = dyn_cast<DeclRefExpr>(subscript->getIdx()->IgnoreParenImpCasts());
+
+    return (index and (index->getDecl() == &var)) ? subscript : nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p array is a local array or one of a namespace, which no other name refers to.
+static bool IsDistinctArray(const ValueDecl& array)
+{
+    return isa<VarDecl>(array) and not isa<ParmVarDecl>(array) and
+           GetGlobalAST().getAsConstantArrayType(array.getType());
+}
+//-----------------------------------------------------------------------------
+
+std::string GetElementwiseCopyNote(const ForStmt& stmt)
+{
+    const auto* init = dyn_cast_or_null<DeclStmt>(stmt.getInit());
+    const auto* var  = (init and init->isSingleDecl()) ? dyn_cast<VarDecl>(init->getSingleDecl()) : nullptr;
+
+    if(not var or not IsIncrementByOne(stmt.getInc(), *var)) {
+        return {};
+    }
+
+    const Stmt* body = stmt.getBody();
+
+    if(const auto* compound = dyn_cast_or_null<CompoundStmt>(body); compound and (1 == compound->size())) {
+        body = compound->body_front();
+    }
+
+    // Both the built-in assignment of a scalar and the trivial one of a class copy the element as a whole.
+    const Expr* lhs{};
+    const Expr* rhs{};
+
+    if(const auto* assign = dyn_cast_or_null<BinaryOperator>(body); assign and (BO_Assign == assign->getOpcode())) {
+        lhs = assign->getLHS();
+        rhs = assign->getRHS();
+
+    } else if(const auto* call = dyn_cast_or_null<CXXOperatorCallExpr>(body);
+              call and (OO_Equal == call->getOperator()) and (2 == call->getNumArgs())) {
+        const auto* method = dyn_cast_or_null<CXXMethodDecl>(call->getCalleeDecl());
+
+        if(not method or (0 == GetMemcpyBytes(*method))) {
+            return {};
+        }
+
+        lhs = call->getArg(0);
+        rhs = call->getArg(1);
+
+    } else {
+        return {};
+    }
+
+    if(lhs->isInstantiationDependent() or rhs->isInstantiationDependent()) {
+        return {};
+    }
+
+    const auto* dst = GetElementAt(lhs, *var);
+    const auto* src = GetElementAt(rhs, *var);
+    const auto& ctx = GetGlobalAST();
+
+    if(not dst or not src or not ctx.hasSameUnqualifiedType(dst->getType(), src->getType()) or
+       dst->getType().isVolatileQualified() or src->getType().isVolatileQualified() or
+       not dst->getType().isTriviallyCopyableType(ctx)) {
+        return {};
+    }
+
+    const auto* dstArray = cast<DeclRefExpr>(dst->getBase()->IgnoreParenImpCasts());
+    const auto* srcArray = cast<DeclRefExpr>(src->getBase()->IgnoreParenImpCasts());
+
+    // Copying an array onto itself is no copy.
+    if(dstArray->getDecl() == srcArray->getDecl()) {
+        return {};
+    }
+
+    const auto elementType = GetName(dst->getType(), Unqualified::Yes);
+    const auto tripCount   = GetUnrollTripCount(stmt);
+
+    Expr::EvalResult start{};
+
+    if(not tripCount or not var->getInit() or var->getInit()->isValueDependent() or
+       not var->getInit()->EvaluateAsInt(start, ctx)) {
+        return StrCat(
+            "element-wise copy of ", elementType, ", std::copy copies the range in bulk with __builtin_memmove");
+    }
+
+    const bool distinct{IsDistinctArray(*dstArray->getDecl()) and IsDistinctArray(*srcArray->getDecl())};
+    const auto startIndex = start.Val.getInt().getExtValue();
+    const auto bytes = *tripCount * static_cast<uint64_t>(ctx.getTypeSizeInChars(dst->getType()).getQuantity());
+
+    const auto address = [&](const DeclRefExpr& array) {
+        return (0 == startIndex) ? GetName(array) : StrCat("&", GetName(array), "[", startIndex, "]");
+    };
+
+    return StrCat("element-wise copy of ",
+                  *tripCount,
+                  " x ",
+                  elementType,
+                  ", ",
+                  bytes,
+                  " bytes, in bulk: ",
+                  distinct ? "__builtin_memcpy(" : "__builtin_memmove(",
+                  address(*dstArray),
+                  ", ",
+                  address(*srcArray),
+                  ", ",
+                  *tripCount,
+                  " * sizeof(",
+                  elementType,
+                  "))");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,42 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_MEMCPY_H
+#define INSIGHTS_MEMCPY_H
+
+#include <cstdint>
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CXXMethodDecl;
+class Expr;
+class ForStmt;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The bytes a trivial copy or move by \p method copies, see \c --show-memcpy. 0 if \p method is no such
+/// constructor or assignment operator, or if its class is empty and there is nothing to copy.
+uint64_t GetMemcpyBytes(const CXXMethodDecl& method);
+//-----------------------------------------------------------------------------
+
+/// \brief The object a trivial copy or move reads from \p arg, with a \c std::move stripped. \c nullptr if it is a
+/// temporary which has no address.
+const Expr* GetMemcpySource(const Expr& arg);
+//-----------------------------------------------------------------------------
+
+/// \brief The note in front of a \c for loop which copies an array of a trivially copyable type element by element,
+/// like <tt>dst[i] = src[i]</tt>. It suggests the bulk copy, \c __builtin_memcpy for two distinct arrays and
+/// \c __builtin_memmove for pointers, which can overlap. Empty for any other loop.
+std::string GetElementwiseCopyNote(const ForStmt& stmt);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_MEMCPY_H */
@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+
+#include "InsightsArena.h"
+#include "InsightsDeclCache.h"
+#include "InsightsMemoryLimit.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static uint64_t              gMaxMemory{};
+static std::atomic<int64_t>  gOutputMemory{};
+static std::atomic<uint64_t> gDegradedTranslationUnits{};
+static thread_local bool     gDegraded{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+void SetMemoryLimit(const uint64_t maxBytes)
+{
+    gMaxMemory = maxBytes;
+}
+//-----------------------------------------------------------------------------
+
+void TrackOutputMemory(const int64_t bytes)
+{
+    if(0 != gMaxMemory) {
+        gOutputMemory += bytes;
+    }
+}
+//-----------------------------------------------------------------------------
+
+void ResetMemoryLimitTranslationUnit()
+{
+    gDegraded = false;
+}
+//-----------------------------------------------------------------------------
+
+static uint64_t GetTrackedMemory()
+{
+    const auto outputMemory = static_cast<uint64_t>(std::max<int64_t>(0, gOutputMemory));
+
+    return outputMemory + GetArena().getTotalMemory() + GetDeclCacheSize();
+}
+//-----------------------------------------------------------------------------
+
+bool IsMemoryLimitReached()
+{
+    if((0 == gMaxMemory) or gDegraded) {
+        return gDegraded;
+    }
+
+    // Switch a bit before the limit, writing the summaries and the result needs some memory as well.
+    if(GetTrackedMemory() < (gMaxMemory / 10 * 9)) {
+        return false;
+    }
+
+    gDegraded = true;
+    ++gDegradedTranslationUnits;
+
+    ClearDeclCache();
+    ReleaseScratchBuffers();
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsMemoryDegraded()
+{
+    return gDegraded;
+}
+//-----------------------------------------------------------------------------
+
+bool IsResultStorable(const int returnCode)
+{
+    return (0 == returnCode) and not IsMemoryDegraded();
+}
+//-----------------------------------------------------------------------------
+
+uint64_t GetDegradedTranslationUnits()
+{
+    return gDegradedTranslationUnits;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
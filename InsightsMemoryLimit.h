@@ -0,0 +1,55 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_MEMORY_LIMIT_H
+#define INSIGHTS_MEMORY_LIMIT_H
+
+#include <cstdint>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Limit the memory C++ Insights keeps for the generated code to \p maxBytes, see \c --max-memory-mb.
+///
+/// The tracked memory is the code all \ref OutputSink objects hold, the arena of the current thread and the
+/// declaration cache. It does not cover the AST, that memory belongs to clang.
+void SetMemoryLimit(const uint64_t maxBytes);
+//-----------------------------------------------------------------------------
+
+/// \brief Note that \p bytes more (or, negative, less) of generated code are held, see \ref OutputSink.
+void TrackOutputMemory(const int64_t bytes);
+//-----------------------------------------------------------------------------
+
+/// \brief Leave the degraded mode, must be called for every new translation unit.
+void ResetMemoryLimitTranslationUnit();
+//-----------------------------------------------------------------------------
+
+/// \brief Check whether the tracked memory gets close to the limit.
+///
+/// The first time it does in a translation unit, the current thread switches to the degraded mode: the caches are
+/// dropped and no more template instantiations are generated. The mode lasts until the next translation unit.
+bool IsMemoryLimitReached();
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the current translation unit runs in the degraded mode, without checking the memory again.
+bool IsMemoryDegraded();
+//-----------------------------------------------------------------------------
+
+/// \brief Whether a result with \p returnCode may go into one of the caches or the result store.
+///
+/// Only successful results qualify and none of the degraded mode, which depends on what else the process held at that
+/// time.
+bool IsResultStorable(const int returnCode);
+//-----------------------------------------------------------------------------
+
+/// \brief The number of translation units which ran in the degraded mode, see \c --stats.
+uint64_t GetDegradedTranslationUnits();
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_MEMORY_LIMIT_H */
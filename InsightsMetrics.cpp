@@ -0,0 +1,333 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <tuple>
+
+#include "InsightsDeclCache.h"
+#include "InsightsHelpers.h"
+#include "InsightsMemReport.h"
+#include "InsightsMemoryLimit.h"
+#include "InsightsMetrics.h"
+#include "InsightsPchCache.h"
+#include "InsightsRemoteCache.h"
+#include "InsightsResultCache.h"
+#include "InsightsResultStore.h"
+#include "InsightsTimeReport.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The upper bounds of the buckets for the durations in seconds.
+static constexpr std::array<double, 12> DURATION_BUCKETS{
+    0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0, 30.0};
+
+/// \brief The upper bounds of the buckets for the memory of a request in bytes, 1 MiB to 4 GiB.
+static constexpr std::array<double, 7> MEMORY_BUCKETS{
+    1024.0 * 1024, 16.0 * 1024 * 1024, 64.0 * 1024 * 1024, 256.0 * 1024 * 1024, 512.0 * 1024 * 1024,
+    1024.0 * 1024 * 1024, 4096.0 * 1024 * 1024};
+//-----------------------------------------------------------------------------
+
+namespace {
+template<size_t N>
+struct Histogram
+{
+    std::array<uint64_t, N> buckets{};  //!< Not cumulative, unlike in the output.
+    uint64_t                count{};
+    double                  sum{};
+
+    void Observe(const std::array<double, N>& bounds, const double value)
+    {
+        if(const auto it = std::lower_bound(bounds.begin(), bounds.end(), value); bounds.end() != it) {
+            ++buckets[static_cast<size_t>(std::distance(bounds.begin(), it))];
+        }
+
+        ++count;
+        sum += value;
+    }
+};
+
+/// \brief The phases of the metrics, a coarser version of \ref TimePhase.
+enum class MetricsPhase
+{
+    Parse,
+    Match,
+    Codegen,
+    Rewrite,
+    Count  // Must be the last entry.
+};
+
+static constexpr std::array<const char*, static_cast<size_t>(MetricsPhase::Count)> METRICS_PHASE_NAMES{
+    "parse", "match", "codegen", "rewrite"};
+
+struct Metrics
+{
+    std::mutex                                                                  mutex{};
+    uint64_t                                                                    requests{};
+    uint64_t                                                                    failedRequests{};
+    Histogram<DURATION_BUCKETS.size()>                                          latency{};
+    std::array<Histogram<DURATION_BUCKETS.size()>, METRICS_PHASE_NAMES.size()> phases{};
+    Histogram<MEMORY_BUCKETS.size()>                                            memory{};
+    uint64_t                                                                    instantiations{};
+    uint64_t                                                                    outputBytes{};
+    uint64_t                                                                    deadlineTruncations{};
+    uint64_t                                                                    memoryTruncations{};
+};
+
+/// \brief What the translation units of the request in progress on this thread did.
+struct RequestRecord
+{
+    uint64_t translationUnits{};
+    uint64_t instantiations{};
+    uint64_t memory{};
+    bool     deadlineExceeded{};
+};
+}  // namespace
+
+static bool                       gMetricsEnabled{};
+static Metrics                    gMetrics{};        // NOLINT
+static thread_local RequestRecord gRequestRecord{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+void EnableMetrics()
+{
+    gMetricsEnabled = true;
+    EnableThreadPhaseTimes();
+}
+//-----------------------------------------------------------------------------
+
+bool IsMetricsEnabled()
+{
+    return gMetricsEnabled;
+}
+//-----------------------------------------------------------------------------
+
+void RecordTranslationUnitMetrics(const uint64_t instantiations, const uint64_t memory, const bool deadlineExceeded)
+{
+    if(not gMetricsEnabled) {
+        return;
+    }
+
+    ++gRequestRecord.translationUnits;
+    gRequestRecord.instantiations += instantiations;
+    gRequestRecord.memory = std::max(gRequestRecord.memory, memory);
+    gRequestRecord.deadlineExceeded |= deadlineExceeded;
+}
+//-----------------------------------------------------------------------------
+
+static double ToSeconds(const std::chrono::nanoseconds duration)
+{
+    return std::chrono::duration<double>{duration}.count();
+}
+//-----------------------------------------------------------------------------
+
+ServerResponse MeasureRequest(llvm::function_ref<ServerResponse()> run)
+{
+    if(not gMetricsEnabled) {
+        return run();
+    }
+
+    gRequestRecord = {};
+    ResetThreadPhaseTimes();
+
+    const auto     start = std::chrono::steady_clock::now();
+    ServerResponse response{run()};
+    const auto     latency = ToSeconds(std::chrono::steady_clock::now() - start);
+
+    const auto& phaseTimes = GetThreadPhaseTimes();
+    auto phaseSeconds      = [&](const TimePhase phase) { return ToSeconds(phaseTimes[static_cast<size_t>(phase)]); };
+
+    // The handlers run inside the matching, their time is the code generation.
+    double codegen{};
+    for(auto phase : {TimePhase::RecordDeclHandler,
+                      TimePhase::TemplateHandler,
+                      TimePhase::FunctionDeclHandler,
+                      TimePhase::GlobalVariableHandler,
+                      TimePhase::StaticAssertHandler}) {
+        codegen += phaseSeconds(phase);
+    }
+
+    const double match{std::max(0.0, phaseSeconds(TimePhase::Matching) - codegen)};
+
+    const std::array<double, METRICS_PHASE_NAMES.size()> phases{
+        phaseSeconds(TimePhase::Parsing), match, codegen, phaseSeconds(TimePhase::EndSourceFileAction)};
+
+    std::lock_guard lock{gMetrics.mutex};
+
+    ++gMetrics.requests;
+
+    if(0 != response.returnCode) {
+        ++gMetrics.failedRequests;
+    }
+
+    gMetrics.latency.Observe(DURATION_BUCKETS, latency);
+    gMetrics.outputBytes += response.output.size();
+
+    // A cached response has no phases, they would only blur the histograms.
+    if(0 != gRequestRecord.translationUnits) {
+        for(size_t i = 0; i < phases.size(); ++i) {
+            gMetrics.phases[i].Observe(DURATION_BUCKETS, phases[i]);
+        }
+
+        gMetrics.memory.Observe(MEMORY_BUCKETS, static_cast<double>(gRequestRecord.memory));
+    }
+
+    gMetrics.instantiations += gRequestRecord.instantiations;
+
+    if(gRequestRecord.deadlineExceeded) {
+        ++gMetrics.deadlineTruncations;
+    }
+
+    if(IsMemoryDegraded()) {
+        ++gMetrics.memoryTruncations;
+    }
+
+    return response;
+}
+//-----------------------------------------------------------------------------
+
+static void WriteHeader(llvm::raw_ostream& ostream, const char* name, const char* type, const char* help)
+{
+    ostream << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name << ' ' << type << '\n';
+}
+//-----------------------------------------------------------------------------
+
+template<size_t N>
+static void WriteHistogram(llvm::raw_ostream&           ostream,
+                           const char*                  name,
+                           const std::string&           labels,
+                           const std::array<double, N>& bounds,
+                           const Histogram<N>&          histogram)
+{
+    const std::string prefix{labels.empty() ? labels : labels + ","};
+    uint64_t          cumulative{};
+
+    for(size_t i = 0; i < N; ++i) {
+        cumulative += histogram.buckets[i];
+        ostream << name << "_bucket{" << prefix << "le=\"" << llvm::format("%g", bounds[i]) << "\"} " << cumulative
+                << '\n';
+    }
+
+    ostream << name << "_bucket{" << prefix << "le=\"+Inf\"} " << histogram.count << '\n';
+
+    const std::string suffix{labels.empty() ? labels : "{" + labels + "}"};
+    ostream << name << "_sum" << suffix << ' ' << llvm::format("%g", histogram.sum) << '\n';
+    ostream << name << "_count" << suffix << ' ' << histogram.count << '\n';
+}
+//-----------------------------------------------------------------------------
+
+std::string GetMetricsText()
+{
+    std::string              text{};
+    llvm::raw_string_ostream ostream{text};
+
+    {
+        std::lock_guard lock{gMetrics.mutex};
+
+        WriteHeader(ostream, "insights_requests_total", "counter", "Requests handled by the server.");
+        ostream << "insights_requests_total " << gMetrics.requests << '\n';
+
+        WriteHeader(ostream, "insights_failed_requests_total", "counter", "Requests with a non-zero return code.");
+        ostream << "insights_failed_requests_total " << gMetrics.failedRequests << '\n';
+
+        WriteHeader(ostream, "insights_request_duration_seconds", "histogram", "Latency of the requests.");
+        WriteHistogram(ostream, "insights_request_duration_seconds", "", DURATION_BUCKETS, gMetrics.latency);
+
+        WriteHeader(ostream,
+                    "insights_phase_duration_seconds",
+                    "histogram",
+                    "Time of the phases of the requests which were not cached.");
+        for(size_t i = 0; i < METRICS_PHASE_NAMES.size(); ++i) {
+            WriteHistogram(ostream,
+                           "insights_phase_duration_seconds",
+                           std::string{"phase=\""} + METRICS_PHASE_NAMES[i] + "\"",
+                           DURATION_BUCKETS,
+                           gMetrics.phases[i]);
+        }
+
+        WriteHeader(ostream,
+                    "insights_request_memory_bytes",
+                    "histogram",
+                    "Memory the AST of the requests allocated.");
+        WriteHistogram(ostream, "insights_request_memory_bytes", "", MEMORY_BUCKETS, gMetrics.memory);
+
+        WriteHeader(ostream, "insights_instantiations_total", "counter", "Template instantiations generated.");
+        ostream << "insights_instantiations_total " << gMetrics.instantiations << '\n';
+
+        WriteHeader(ostream, "insights_output_bytes_total", "counter", "Bytes of the responses.");
+        ostream << "insights_output_bytes_total " << gMetrics.outputBytes << '\n';
+
+        WriteHeader(ostream,
+                    "insights_truncations_total",
+                    "counter",
+                    "Requests stopped by --deadline-ms or degraded by --max-memory-mb.");
+        ostream << "insights_truncations_total{reason=\"deadline\"} " << gMetrics.deadlineTruncations << '\n';
+        ostream << "insights_truncations_total{reason=\"memory\"} " << gMetrics.memoryTruncations << '\n';
+    }
+
+    WriteHeader(ostream, "insights_peak_rss_bytes", "gauge", "Peak resident set size of the server.");
+    ostream << "insights_peak_rss_bytes " << GetPeakRSS() << '\n';
+
+    const auto rss = GetRssUsage();
+
+    WriteHeader(ostream,
+                "insights_rss_bytes",
+                "gauge",
+                "Resident set of the server, shared with other processes or private.");
+    ostream << "insights_rss_bytes{kind=\"shared\"} " << rss.shared << '\n';
+    ostream << "insights_rss_bytes{kind=\"private\"} " << rss.privateBytes << '\n';
+
+    const auto& pchStats = GetPchCacheStats();
+
+    WriteHeader(ostream, "insights_pch_mapped_bytes", "gauge", "PCH and module files mapped by this process.");
+    ostream << "insights_pch_mapped_bytes " << pchStats.mappedBytes << '\n';
+
+    const auto& resultStats      = GetResultCacheStats();
+    const auto  resultStoreStats = GetResultStoreStats();
+    const auto  typeNameStats    = GetTypeNameCacheStats();
+    const auto  declCacheStats   = GetDeclCacheStats();
+    const auto  remoteStats      = GetRemoteCacheStats();
+
+    const std::array<std::tuple<const char*, uint64_t, uint64_t>, 6> caches{
+        std::tuple{"pch", uint64_t{pchStats.hits}, uint64_t{pchStats.misses}},
+        std::tuple{"result", uint64_t{resultStats.hits}, uint64_t{resultStats.misses}},
+        std::tuple{"remote", remoteStats.hits, remoteStats.misses},
+        std::tuple{"result_store", resultStoreStats.hits, resultStoreStats.misses},
+        std::tuple{"type_name", typeNameStats.hits, typeNameStats.misses},
+        std::tuple{"decl", declCacheStats.hits, declCacheStats.misses}};
+
+    WriteHeader(ostream, "insights_cache_hits_total", "counter", "Hits of the caches.");
+    for(const auto& [name, hits, misses] : caches) {
+        ostream << "insights_cache_hits_total{cache=\"" << name << "\"} " << hits << '\n';
+    }
+
+    WriteHeader(ostream, "insights_cache_misses_total", "counter", "Misses of the caches.");
+    for(const auto& [name, hits, misses] : caches) {
+        ostream << "insights_cache_misses_total{cache=\"" << name << "\"} " << misses << '\n';
+    }
+
+    WriteHeader(ostream, "insights_cache_hit_ratio", "gauge", "Hits of the caches divided by all lookups.");
+    for(const auto& [name, hits, misses] : caches) {
+        const double lookups = static_cast<double>(hits + misses);
+
+        ostream << "insights_cache_hit_ratio{cache=\"" << name << "\"} "
+                << llvm::format("%g", (0 == lookups) ? 0.0 : static_cast<double>(hits) / lookups) << '\n';
+    }
+
+    ostream.flush();
+
+    return text;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
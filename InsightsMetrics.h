@@ -0,0 +1,42 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_METRICS_H
+#define INSIGHTS_METRICS_H
+
+#include "llvm/ADT/STLExtras.h"
+
+#include <cstdint>
+#include <string>
+
+#include "InsightsServer.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Collect the metrics of the server requests, see \c --metrics.
+void EnableMetrics();
+bool IsMetricsEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Note what the code generation of a translation unit of the current request did.
+///
+/// \p memory is what the AST of the translation unit allocated, which is the bulk of the memory of a request.
+void RecordTranslationUnitMetrics(const uint64_t instantiations, const uint64_t memory, const bool deadlineExceeded);
+//-----------------------------------------------------------------------------
+
+/// \brief Run the request \p run and record its latency, the time of its phases and what it generated.
+ServerResponse MeasureRequest(llvm::function_ref<ServerResponse()> run);
+//-----------------------------------------------------------------------------
+
+/// \brief All metrics in the Prometheus text format.
+std::string GetMetricsText();
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_METRICS_H */
@@ -0,0 +1,396 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SetVector.h"
+
+#include "InsightsAllocations.h"
+#include "InsightsHelpers.h"
+#include "InsightsMoveAudit.h"
+#include "InsightsStrCat.h"
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief The special member a move of a class ends up in.
+enum class MoveMember
+{
+    Constructor,
+    Assignment,
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The declared, not deleted move member of \p record or, if it has none, the copy member, which takes over.
+static const CXXMethodDecl* GetMoveMember(const CXXRecordDecl& record, const MoveMember member)
+{
+    const CXXMethodDecl* copy{};
+
+    for(const auto* method : record.methods()) {
+        if(method->isDeleted()) {
+            continue;
+        }
+
+        if(MoveMember::Constructor == member) {
+            if(const auto* ctor = dyn_cast_or_null<CXXConstructorDecl>(method)) {
+                if(ctor->isMoveConstructor()) {
+                    return ctor;
+
+                } else if(ctor->isCopyConstructor()) {
+                    copy = ctor;
+                }
+            }
+
+        } else if(method->isMoveAssignmentOperator()) {
+            return method;
+
+        } else if(method->isCopyAssignmentOperator()) {
+            copy = method;
+        }
+    }
+
+    return copy;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the exception specification of \p method is known and says it cannot throw.
+///
+/// \returns Nothing, if the specification of an implicit member is not evaluated yet.
+static llvm::Optional<bool> IsNothrow(const CXXMethodDecl& method)
+{
+    const auto* proto = method.getType()->getAs<FunctionProtoType>();
+
+    if(not proto or isUnresolvedExceptionSpec(proto->getExceptionSpecType())) {
+        return {};
+    }
+
+    return proto->isNothrow();
+}
+//-----------------------------------------------------------------------------
+
+static bool IsTrivialMove(const CXXRecordDecl& record, const MoveMember member)
+{
+    if(MoveMember::Constructor == member) {
+        return record.hasTrivialMoveConstructor() or
+               (not record.hasMoveConstructor() and record.hasTrivialCopyConstructor());
+    }
+
+    return record.hasTrivialMoveAssignment() or
+           (not record.hasMoveAssignment() and record.hasTrivialCopyAssignment());
+}
+//-----------------------------------------------------------------------------
+
+static bool IsNothrowMove(const CXXRecordDecl& record, const MoveMember member);
+
+/// \brief The first base or field of \p record whose move can throw, the implicit member of \p record can throw
+/// because of it. Empty if there is none.
+static std::string GetThrowingSubobject(const CXXRecordDecl& record, const MoveMember member)
+{
+    auto canThrow = [&](QualType type) {
+        const auto* other = type->getBaseElementTypeUnsafe()->getAsCXXRecordDecl();
+
+        return other and other->hasDefinition() and not IsNothrowMove(*other, member);
+    };
+
+    for(const auto& base : record.bases()) {
+        if(canThrow(base.getType())) {
+            return StrCat("base ", GetName(base.getType()));
+        }
+    }
+
+    for(const auto* field : record.fields()) {
+        if(canThrow(field->getType())) {
+            return StrCat("member ", GetName(*field));
+        }
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+static bool IsNothrowMove(const CXXRecordDecl& record, const MoveMember member)
+{
+    if(IsTrivialMove(record, member)) {
+        return true;
+    }
+
+    if(const auto* method = GetMoveMember(record, member)) {
+        if(const auto nothrow = IsNothrow(*method)) {
+            return *nothrow;
+        }
+    }
+
+    return GetThrowingSubobject(record, member).empty();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Why a move of \p record with \p member can throw, empty if it cannot.
+static std::string GetThrowingMoveReason(const CXXRecordDecl& record, const MoveMember member)
+{
+    if(IsTrivialMove(record, member)) {
+        return {};
+    }
+
+    const char* name{(MoveMember::Constructor == member) ? "move constructor" : "move assignment"};
+    const bool  hasMove{(MoveMember::Constructor == member) ? record.hasMoveConstructor() : record.hasMoveAssignment()};
+    const bool  needsImplicitMove{(MoveMember::Constructor == member) ? record.needsImplicitMoveConstructor()
+                                                                     : record.needsImplicitMoveAssignment()};
+
+    const auto* method = GetMoveMember(record, member);
+
+    // A user-declared copy member or destructor suppresses the implicit move, the copy does its job.
+    if(not hasMove and not needsImplicitMove) {
+        if(not method) {
+            return {};
+        }
+
+        return StrCat("no ", name, ", the copy is used");
+    }
+
+    if(method) {
+        if(const auto nothrow = IsNothrow(*method)) {
+            if(*nothrow) {
+                return {};
+            }
+
+            return StrCat(name, " is not noexcept");
+        }
+    }
+
+    if(const auto subobject = GetThrowingSubobject(record, member); not subobject.empty()) {
+        return StrCat("implicit ", name, " is not noexcept because of ", subobject);
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+std::string GetThrowingMoveNote(const CXXRecordDecl& record)
+{
+    if(record.isLambda() or record.isDependentType() or not record.hasDefinition() or record.isInvalidDecl()) {
+        return {};
+    }
+
+    const auto ctorReason       = GetThrowingMoveReason(record, MoveMember::Constructor);
+    const auto assignmentReason = GetThrowingMoveReason(record, MoveMember::Assignment);
+
+    if(ctorReason.empty() and assignmentReason.empty()) {
+        return {};
+    }
+
+    std::string note{};
+
+    if(not ctorReason.empty()) {
+        note = StrCat(ctorReason, ": std::vector reallocation copies instead of moving");
+    }
+
+    if(not assignmentReason.empty()) {
+        note += StrCat(note.empty() ? "" : "; ", assignmentReason);
+    }
+
+    return note;
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief Collects the classes with a throwing move which are elements of a standard container.
+class ContainerElementCollector : public RecursiveASTVisitor<ContainerElementCollector>
+{
+public:
+    bool shouldVisitTemplateInstantiations() const { return true; }
+
+    bool VisitValueDecl(const ValueDecl* decl)
+    {
+        Collect(decl->getType());
+
+        return true;
+    }
+
+    bool VisitCXXConstructExpr(const CXXConstructExpr* construct)
+    {
+        Collect(construct->getType());
+
+        return true;
+    }
+
+    const llvm::MapVector<const CXXRecordDecl*, llvm::SetVector<std::string>>& GetElements() const
+    {
+        return mElements;
+    }
+
+private:
+    void Collect(QualType type)
+    {
+        if(type.isNull() or type->isDependentType()) {
+            return;
+        }
+
+        const auto* container = dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+            type.getNonReferenceType()->getPointeeOrArrayElementType()->getAsCXXRecordDecl());
+
+        if(not container or not container->isInStdNamespace() or not container->getIdentifier() or
+           not IsAllocatingContainer(container->getName())) {
+            return;
+        }
+
+        // The allocator and the comparison are template arguments too, they are in the std namespace or no class.
+        for(const auto& arg : container->getTemplateArgs().asArray()) {
+            if(TemplateArgument::Type != arg.getKind()) {
+                continue;
+            }
+
+            const auto* element = arg.getAsType()->getAsCXXRecordDecl();
+
+            if(element and not element->isInStdNamespace() and not GetThrowingMoveNote(*element).empty()) {
+                mElements[element].insert(StrCat("std::", container->getName()));
+            }
+        }
+    }
+
+    llvm::MapVector<const CXXRecordDecl*, llvm::SetVector<std::string>> mElements{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The argument of \p expr, if it is a call to \c std::move.
+static const Expr* GetStdMoveArg(const Expr* expr)
+{
+    const auto* call = dyn_cast_or_null<CallExpr>(expr ? expr->IgnoreImplicit()->IgnoreParens() : nullptr);
+
+    if(not call or (1 != call->getNumArgs())) {
+        return nullptr;
+    }
+
+    if(const auto* callee = call->getDirectCallee();
+       callee and callee->isInStdNamespace() and callee->getIdentifier() and ("move" == callee->getName())) {
+        return call->getArg(0);
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The constructor \p ctor like it is declared, for example \c Movable(const Movable &).
+static std::string GetConstructorSignature(const CXXConstructorDecl& ctor)
+{
+    std::string signature{StrCat(GetName(*ctor.getParent()), "(")};
+
+    for(const auto* param : ctor.parameters()) {
+        signature += StrCat((param == ctor.getParamDecl(0)) ? "" : ", ", GetName(param->getType()));
+    }
+
+    return StrCat(signature, ")");
+}
+//-----------------------------------------------------------------------------
+
+std::string GetPessimizingReturnMoveNote(const ReturnStmt& stmt)
+{
+    const auto* construct = dyn_cast_or_null<CXXConstructExpr>(
+        stmt.getRetValue() ? stmt.getRetValue()->IgnoreImplicit()->IgnoreParens() : nullptr);
+
+    if(not construct or (1 != construct->getNumArgs())) {
+        return {};
+    }
+
+    const auto* moved   = GetStdMoveArg(construct->getArg(0));
+    const auto* declRef = dyn_cast_or_null<DeclRefExpr>(moved ? moved->IgnoreParenImpCasts() : nullptr);
+    const auto* var     = dyn_cast_or_null<VarDecl>(declRef ? declRef->getDecl() : nullptr);
+
+    // Only a local variable of the returned type is a candidate for NRVO, a parameter never is.
+    if(not var or isa<ParmVarDecl>(var) or not var->hasLocalStorage() or var->getType().isVolatileQualified() or
+       not var->getASTContext().hasSameUnqualifiedType(var->getType(), construct->getType())) {
+        return {};
+    }
+
+    const auto* ctor = construct->getConstructor();
+
+    // Without NRVO a trivial copy is all that is left, the std::move costs nothing.
+    if(ctor->isTrivial()) {
+        return {};
+    }
+
+    return StrCat("std::move prevents NRVO of ", GetName(*var), ", runs ", GetConstructorSignature(*ctor));
+}
+//-----------------------------------------------------------------------------
+
+std::string GetIneffectiveMoveNote(const CXXConstructExpr& construct)
+{
+    const auto* ctor = construct.getConstructor();
+
+    if(not ctor->isCopyConstructor() or (0 == construct.getNumArgs())) {
+        return {};
+    }
+
+    const auto* moved = GetStdMoveArg(construct.getArg(0));
+
+    if(not moved) {
+        return {};
+    }
+
+    if(moved->getType().isConstQualified()) {
+        return StrCat("std::move of a const object copies, runs ", GetConstructorSignature(*ctor));
+    }
+
+    return StrCat("std::move has no effect, ",
+                  GetName(*ctor->getParent()),
+                  " has no move constructor, runs ",
+                  GetConstructorSignature(*ctor));
+}
+//-----------------------------------------------------------------------------
+
+std::string GetIneffectiveMoveArgNote(const Expr& arg, const ParmVarDecl& param)
+{
+    const auto type = param.getType();
+
+    if(not GetStdMoveArg(&arg) or not type->isLValueReferenceType() or not type->getPointeeType().isConstQualified()) {
+        return {};
+    }
+
+    return StrCat("std::move has no effect, binds to ", GetName(type), " ", GetName(param));
+}
+//-----------------------------------------------------------------------------
+
+std::string GetThrowingMoveElementTable(ASTContext& ctx)
+{
+    ContainerElementCollector collector{};
+
+    for(auto* decl : ctx.getTraversalScope()) {
+        collector.TraverseDecl(decl);
+    }
+
+    if(collector.GetElements().empty()) {
+        return {};
+    }
+
+    OutputFormatHelper outputFormatHelper{};
+    outputFormatHelper.AppendNewLine("/* container elements without a noexcept move");
+
+    for(const auto& [element, containers] : collector.GetElements()) {
+        outputFormatHelper.Append("   ", GetName(*element), ":");
+
+        for(const auto& container : containers) {
+            outputFormatHelper.Append(" ", container);
+        }
+
+        outputFormatHelper.AppendNewLine();
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+
+    return outputFormatHelper.GetString();
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,68 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_MOVE_AUDIT_H
+#define INSIGHTS_MOVE_AUDIT_H
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class ASTContext;
+class CXXConstructExpr;
+class CXXRecordDecl;
+class Expr;
+class ParmVarDecl;
+class ReturnStmt;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The note for a class whose move constructor or move assignment can throw, see \c --show-noexcept-move.
+///
+/// A move constructor which is not \c noexcept makes \c std::vector copy the elements when it reallocates. The same
+/// applies to a class without a move constructor but a non-trivial copy constructor. An implicit member which is not
+/// declared yet is \c noexcept if the ones of all bases and fields are, the first one which is not is named.
+///
+/// \returns The note, empty if moving \p record cannot throw.
+std::string GetThrowingMoveNote(const CXXRecordDecl& record);
+//-----------------------------------------------------------------------------
+
+/// \brief The table of the classes with a throwing move which are used as elements of standard containers in the
+/// declarations of \p ctx which get transformed.
+///
+/// It is empty, if there are none.
+std::string GetThrowingMoveElementTable(ASTContext& ctx);
+//-----------------------------------------------------------------------------
+
+/// \brief The note for <tt>return std::move(local)</tt> in \p stmt, see \c --show-pessimizing-moves.
+///
+/// Without the \c std::move the local variable could be constructed in the return slot (NRVO). With it, the move
+/// constructor always runs.
+///
+/// \returns The note, empty if \p stmt returns no moved local variable.
+std::string GetPessimizingReturnMoveNote(const ReturnStmt& stmt);
+//-----------------------------------------------------------------------------
+
+/// \brief The note for a \c std::move argument of \p construct which still copies, see \c --show-pessimizing-moves.
+///
+/// This is the case for a \c const object, the result binds to the copy constructor, and for a class without a move
+/// constructor.
+///
+/// \returns The note, empty if no \c std::move argument ends up in a copy constructor.
+std::string GetIneffectiveMoveNote(const CXXConstructExpr& construct);
+//-----------------------------------------------------------------------------
+
+/// \brief The note for the argument \p arg of \p param, if it is a \c std::move and \p param takes a \c const
+/// reference, see \c --show-pessimizing-moves.
+std::string GetIneffectiveMoveArgNote(const Expr& arg, const ParmVarDecl& param);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_MOVE_AUDIT_H */
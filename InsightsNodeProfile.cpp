@@ -0,0 +1,211 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/DeclBase.h"
+#include "clang/AST/Stmt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "InsightsNodeProfile.h"
+#include "InsightsStrCat.h"
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+struct NodeStats
+{
+    uint64_t                            calls{};
+    std::chrono::steady_clock::duration inclusive{};
+    std::chrono::steady_clock::duration exclusive{};
+    uint64_t                            bytes{};  //!< Inclusive of the nested calls.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The node kinds of one thread, keyed by the name clang returns for the kind. The names are string literals.
+struct ThreadNodeStats
+{
+    llvm::DenseMap<const char*, NodeStats> stmts{};
+    llvm::DenseMap<const char*, NodeStats> decls{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static bool                           gNodeProfilingEnabled{};
+static bool                           gNodeTrackingEnabled{};
+static std::mutex                     gNodeProfileMutex{};
+static llvm::StringMap<NodeStats>     gNodeProfile{};
+static thread_local ThreadNodeStats   gThreadNodeStats{};
+static thread_local NodeProfileScope* gCurrentScope{};
+//-----------------------------------------------------------------------------
+
+void EnableNodeProfiling()
+{
+    gNodeProfilingEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsNodeProfilingEnabled()
+{
+    return gNodeProfilingEnabled;
+}
+//-----------------------------------------------------------------------------
+
+void EnableNodeTracking()
+{
+    gNodeTrackingEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+const NodeProfileScope* GetCurrentNodeScope()
+{
+    return gCurrentScope;
+}
+//-----------------------------------------------------------------------------
+
+NodeProfileScope::NodeProfileScope(const Stmt* stmt, const OutputFormatHelper& outputFormatHelper)
+: mOutputFormatHelper{outputFormatHelper}
+{
+    if((gNodeProfilingEnabled or gNodeTrackingEnabled) and stmt) {
+        Start(stmt->getStmtClassName(), false);
+    }
+}
+//-----------------------------------------------------------------------------
+
+NodeProfileScope::NodeProfileScope(const Decl* decl, const OutputFormatHelper& outputFormatHelper)
+: mOutputFormatHelper{outputFormatHelper}
+{
+    if((gNodeProfilingEnabled or gNodeTrackingEnabled) and decl) {
+        Start(decl->getDeclKindName(), true);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void NodeProfileScope::Start(const char* kind, const bool isDecl)
+{
+    mKind         = kind;
+    mIsDecl       = isDecl;
+    mParent       = gCurrentScope;
+    gCurrentScope = this;
+
+    if(gNodeProfilingEnabled) {
+        mStartPos = mOutputFormatHelper.CurrentPos();
+        mStart    = std::chrono::steady_clock::now();
+    }
+}
+//-----------------------------------------------------------------------------
+
+NodeProfileScope::~NodeProfileScope()
+{
+    if(not mKind) {
+        return;
+    }
+
+    gCurrentScope = mParent;
+
+    if(not gNodeProfilingEnabled) {
+        return;
+    }
+
+    const auto inclusive = std::chrono::steady_clock::now() - mStart;
+    auto&      stats     = (mIsDecl ? gThreadNodeStats.decls : gThreadNodeStats.stmts)[mKind];
+
+    ++stats.calls;
+    stats.inclusive += inclusive;
+    stats.exclusive += inclusive - mChildren;
+
+    // A call can write into a helper of its own, which the caller inserts later. Only the growth of this one counts.
+    if(const auto pos = mOutputFormatHelper.CurrentPos(); pos > mStartPos) {
+        stats.bytes += pos - mStartPos;
+    }
+
+    if(mParent) {
+        mParent->mChildren += inclusive;
+    }
+}
+//-----------------------------------------------------------------------------
+
+void AddNodeProfile()
+{
+    auto add = [](const llvm::DenseMap<const char*, NodeStats>& kinds, const char* suffix) {
+        for(const auto& [kind, stats] : kinds) {
+            auto& total = gNodeProfile[StrCat(kind, suffix)];
+
+            total.calls += stats.calls;
+            total.inclusive += stats.inclusive;
+            total.exclusive += stats.exclusive;
+            total.bytes += stats.bytes;
+        }
+    };
+
+    {
+        std::lock_guard lock{gNodeProfileMutex};
+
+        // The names of the declaration kinds come without the Decl, VarDecl is Var.
+        add(gThreadNodeStats.stmts, "");
+        add(gThreadNodeStats.decls, "Decl");
+    }
+
+    gThreadNodeStats = {};
+}
+//-----------------------------------------------------------------------------
+
+void PrintNodeProfile(llvm::raw_ostream& ostream)
+{
+    // The kinds after the first ones hardly matter, they would only make the report long.
+    static constexpr size_t MAX_ROWS{25};
+
+    std::lock_guard lock{gNodeProfileMutex};
+
+    std::vector<const llvm::StringMapEntry<NodeStats>*> kinds{};
+
+    for(const auto& entry : gNodeProfile) {
+        kinds.push_back(&entry);
+    }
+
+    std::stable_sort(kinds.begin(), kinds.end(), [](const auto* a, const auto* b) {
+        if(a->second.exclusive != b->second.exclusive) {
+            return a->second.exclusive > b->second.exclusive;
+        }
+
+        return a->first() < b->first();
+    });
+
+    if(kinds.size() > MAX_ROWS) {
+        kinds.resize(MAX_ROWS);
+    }
+
+    auto ms = [](const std::chrono::steady_clock::duration& duration) {
+        return std::chrono::duration<double, std::milli>{duration}.count();
+    };
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                      C++ Insights code generation profile\n"
+            << "===-------------------------------------------------------------------------===\n"
+            << llvm::format(
+                   "  %-36s %10s %12s %12s %10s\n", "Node", "Calls", "Incl. (ms)", "Excl. (ms)", "Bytes");
+
+    for(const auto* entry : kinds) {
+        const auto& stats = entry->second;
+
+        ostream << llvm::format("  %-36s %10llu %12.3f %12.3f %10llu\n",
+                                entry->first().str().c_str(),
+                                static_cast<unsigned long long>(stats.calls),
+                                ms(stats.inclusive),
+                                ms(stats.exclusive),
+                                static_cast<unsigned long long>(stats.bytes));
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,80 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_NODE_PROFILE_H
+#define INSIGHTS_NODE_PROFILE_H
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class Decl;
+class Stmt;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+class OutputFormatHelper;
+
+void EnableNodeProfiling();
+bool IsNodeProfilingEnabled();
+
+/// \brief Track the innermost node kind of the code generation without profiling it, see \ref GetCurrentNodeScope.
+void EnableNodeTracking();
+//-----------------------------------------------------------------------------
+
+/// \brief Measures one call of \c CodeGenerator::InsertArg for a statement or a declaration, see \c --profile-nodes.
+///
+/// The calls are counted per node kind, with the time inclusive and exclusive of the nested calls and the bytes the
+/// call wrote to \p outputFormatHelper. Without \c --profile-nodes the scope does nothing.
+class NodeProfileScope
+{
+public:
+    NodeProfileScope(const Stmt* stmt, const OutputFormatHelper& outputFormatHelper);
+    NodeProfileScope(const Decl* decl, const OutputFormatHelper& outputFormatHelper);
+    ~NodeProfileScope();
+
+    NodeProfileScope(const NodeProfileScope&) = delete;
+    NodeProfileScope& operator=(const NodeProfileScope&) = delete;
+
+    const char* GetKind() const { return mKind; }
+    bool        IsDecl() const { return mIsDecl; }
+
+private:
+    void Start(const char* kind, const bool isDecl);
+
+    const OutputFormatHelper&             mOutputFormatHelper;
+    const char*                           mKind{};  //!< The kind name clang returns, \c nullptr if not tracking.
+    bool                                  mIsDecl{};
+    size_t                                mStartPos{};
+    std::chrono::steady_clock::time_point mStart{};
+    std::chrono::steady_clock::duration   mChildren{};  //!< The time spent in the nested calls.
+    NodeProfileScope*                     mParent{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The innermost active \ref NodeProfileScope of this thread, \c nullptr outside of the code generation or if
+/// neither \c --profile-nodes nor \c --alloc-sites is enabled.
+///
+/// This allocates nothing, it can be called from the global \c operator \c new.
+const NodeProfileScope* GetCurrentNodeScope();
+//-----------------------------------------------------------------------------
+
+/// \brief Add the calls the current thread measured to the profile. Called after each translation unit.
+void AddNodeProfile();
+//-----------------------------------------------------------------------------
+
+/// \brief Print the node kinds which took the most time, exclusive of the nested calls.
+void PrintNodeProfile(llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_NODE_PROFILE_H */
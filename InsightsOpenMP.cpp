@@ -0,0 +1,303 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclOpenMP.h"
+#include "clang/AST/Expr.h"
+#include "clang/AST/OpenMPClause.h"
+#include "clang/Basic/OperatorKinds.h"
+#include "clang/Lex/Lexer.h"
+#include "llvm/Support/Path.h"
+
+#include <cctype>
+
+#include "Insights.h"
+#include "InsightsHelpers.h"
+#include "InsightsOpenMP.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static bool IsRefTo(const Expr* expr, const VarDecl* var)
+{
+    if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(expr ? expr->IgnoreParenImpCasts() : nullptr)) {
+        return declRef->getDecl() == var;
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<OMPCanonicalLoop> GetOMPCanonicalLoop(const ForStmt& loop)
+{
+    const auto* declStmt = dyn_cast_or_null<DeclStmt>(loop.getInit());
+
+    if(not declStmt or not declStmt->isSingleDecl()) {
+        return {};
+    }
+
+    const auto* var = dyn_cast_or_null<VarDecl>(declStmt->getSingleDecl());
+
+    if(not var or not var->hasInit() or not var->getType()->isIntegerType()) {
+        return {};
+    }
+
+    OMPCanonicalLoop canonical{var, var->getInit(), nullptr, nullptr, true, false};
+
+    // The increment: ++var, var++, --var, var--, var += step or var -= step.
+    if(const auto* unary = dyn_cast_or_null<UnaryOperator>(loop.getInc()); unary and IsRefTo(unary->getSubExpr(), var)) {
+        if(not unary->isIncrementDecrementOp()) {
+            return {};
+        }
+
+        canonical.increments = unary->isIncrementOp();
+
+    } else if(const auto* assign = dyn_cast_or_null<CompoundAssignOperator>(loop.getInc());
+              assign and IsRefTo(assign->getLHS(), var)) {
+        if((BO_AddAssign != assign->getOpcode()) and (BO_SubAssign != assign->getOpcode())) {
+            return {};
+        }
+
+        canonical.increments = BO_AddAssign == assign->getOpcode();
+        canonical.step       = assign->getRHS();
+
+    } else {
+        return {};
+    }
+
+    // The condition: var op end or end op var.
+    const auto* cond = dyn_cast_or_null<BinaryOperator>(loop.getCond() ? loop.getCond()->IgnoreParenImpCasts() : nullptr);
+
+    if(not cond) {
+        return {};
+    }
+
+    auto opcode = cond->getOpcode();
+
+    if(IsRefTo(cond->getLHS(), var)) {
+        canonical.end = cond->getRHS();
+
+    } else if(IsRefTo(cond->getRHS(), var)) {
+        canonical.end = cond->getLHS();
+        opcode        = BinaryOperator::reverseComparisonOp(opcode);
+
+    } else {
+        return {};
+    }
+
+    switch(opcode) {
+        case BO_LE: canonical.inclusive = true; [[fallthrough]];
+        case BO_LT:
+            if(not canonical.increments) {
+                return {};
+            }
+            break;
+
+        case BO_GE: canonical.inclusive = true; [[fallthrough]];
+        case BO_GT:
+            if(canonical.increments) {
+                return {};
+            }
+            break;
+
+        case BO_NE: break;
+
+        default: return {};
+    }
+
+    return canonical;
+}
+//-----------------------------------------------------------------------------
+
+const Stmt* GetOMPAssociatedStmt(const OMPExecutableDirective& directive)
+{
+    if(not directive.hasAssociatedStmt()) {
+        return nullptr;
+    }
+
+    const Stmt* stmt = directive.getAssociatedStmt();
+
+    while(const auto* captured = dyn_cast_or_null<CapturedStmt>(stmt)) {
+        stmt = captured->getCapturedStmt();
+    }
+
+    return stmt;
+}
+//-----------------------------------------------------------------------------
+
+const Expr* IgnoreOMPCapturedExpr(const Expr* expr)
+{
+    while(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(expr ? expr->IgnoreParenImpCasts() : nullptr)) {
+        const auto* captured = dyn_cast_or_null<OMPCapturedExprDecl>(declRef->getDecl());
+
+        if(not captured or not captured->hasInit()) {
+            break;
+        }
+
+        expr = captured->getInit();
+    }
+
+    return expr;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetOMPPragma(const OMPExecutableDirective& directive)
+{
+    const auto& ctx  = GetGlobalAST();
+    const auto  text = Lexer::getSourceText(CharSourceRange::getCharRange(directive.getBeginLoc(), directive.getEndLoc()),
+                                           ctx.getSourceManager(),
+                                           ctx.getLangOpts());
+
+    // The directive can span several lines, each line break with its backslash becomes a single space.
+    std::string pragma{};
+
+    for(const char c : text) {
+        if(isspace(c) or ('\\' == c)) {
+            if(not pragma.empty() and (' ' != pragma.back())) {
+                pragma += ' ';
+            }
+
+        } else {
+            pragma += c;
+        }
+    }
+
+    while(not pragma.empty() and (' ' == pragma.back())) {
+        pragma.pop_back();
+    }
+
+    if(not StringRef{pragma}.startswith("#pragma")) {
+        return StrCat("#pragma ", pragma);
+    }
+
+    return pragma;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetOMPLocation(const OMPExecutableDirective& directive, const std::string& name, const unsigned flags)
+{
+    const auto& sm       = GetGlobalAST().getSourceManager();
+    const auto  presumed = sm.getPresumedLoc(sm.getExpansionLoc(directive.getBeginLoc()));
+    const auto [line, column] = GetSpellingLineColumn(sm, directive.getBeginLoc());
+
+    return StrCat("static ident_t ",
+                  name,
+                  " = {0, ",
+                  flags,
+                  ", 0, 0, \";",
+                  presumed.isValid() ? llvm::sys::path::filename(presumed.getFilename()) : StringRef{},
+                  ";;",
+                  line,
+                  ";",
+                  column,
+                  ";;\"};");
+}
+//-----------------------------------------------------------------------------
+
+OMPSchedule GetOMPSchedule(const OMPLoopDirective& directive)
+{
+    // The values of enum sched_type of libomp. The ordered variants are the unordered ones plus 32.
+    enum : unsigned
+    {
+        kmp_sch_static_chunked  = 33,
+        kmp_sch_static          = 34,
+        kmp_sch_dynamic_chunked = 35,
+        kmp_sch_guided_chunked  = 36,
+        kmp_sch_runtime         = 37,
+        kmp_sch_auto            = 38,
+        kmp_ord_offset          = 32,
+    };
+
+    OMPSchedule schedule{kmp_sch_static, nullptr, true};
+
+    if(const auto* clause = directive.getSingleClause<OMPScheduleClause>()) {
+        schedule.chunk = clause->getChunkSize();
+
+        switch(clause->getScheduleKind()) {
+            case OMPC_SCHEDULE_dynamic: schedule.type = kmp_sch_dynamic_chunked; break;
+            case OMPC_SCHEDULE_guided: schedule.type = kmp_sch_guided_chunked; break;
+            case OMPC_SCHEDULE_runtime: schedule.type = kmp_sch_runtime; break;
+            case OMPC_SCHEDULE_auto: schedule.type = kmp_sch_auto; break;
+            default: schedule.type = schedule.chunk ? kmp_sch_static_chunked : kmp_sch_static; break;
+        }
+    }
+
+    // The iterations of an ordered loop are handed out by the dispatcher, which also enforces their order.
+    if(directive.getSingleClause<OMPOrderedClause>()) {
+        schedule.type += kmp_ord_offset;
+    }
+
+    schedule.isStatic = (kmp_sch_static_chunked == schedule.type) or (kmp_sch_static == schedule.type);
+
+    return schedule;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetOMPLoopFunctionSuffix(const ASTContext& ctx, const QualType& type)
+{
+    return StrCat((64 == ctx.getTypeSize(type)) ? "8" : "4", type->isUnsignedIntegerType() ? "u" : "");
+}
+//-----------------------------------------------------------------------------
+
+llvm::SmallVector<OMPReduction, 4> GetOMPReductions(const OMPExecutableDirective& directive)
+{
+    llvm::SmallVector<OMPReduction, 4> reductions{};
+
+    for(const auto* clause : directive.getClausesOfKind<OMPReductionClause>()) {
+        const auto  name = clause->getNameInfo().getName();
+        std::string op{(DeclarationName::CXXOperatorName == name.getNameKind())
+                           ? getOperatorSpelling(name.getCXXOverloadedOperator())
+                           : name.getAsString()};
+
+        for(const auto* ref : clause->varlists()) {
+            if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(ref->IgnoreParenImpCasts())) {
+                if(const auto* var = dyn_cast_or_null<VarDecl>(declRef->getDecl())) {
+                    reductions.push_back({var, op});
+                }
+            }
+        }
+    }
+
+    return reductions;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetOMPReductionIdentity(const std::string& op, const QualType& type)
+{
+    if(("+" == op) or ("-" == op) or ("|" == op) or ("^" == op) or ("||" == op)) {
+        return "0";
+    } else if(("*" == op) or ("&&" == op)) {
+        return "1";
+    } else if("&" == op) {
+        return "~0";
+    } else if("min" == op) {
+        return StrCat("std::numeric_limits<", GetName(type.getUnqualifiedType()), ">::max()");
+    } else if("max" == op) {
+        return StrCat("std::numeric_limits<", GetName(type.getUnqualifiedType()), ">::lowest()");
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+std::string GetOMPReductionCombiner(const std::string& op, const std::string& lhs, const std::string& rhs)
+{
+    if("min" == op) {
+        return StrCat(lhs, " = ", rhs, " < ", lhs, " ? ", rhs, " : ", lhs, ";");
+    } else if("max" == op) {
+        return StrCat(lhs, " = ", lhs, " < ", rhs, " ? ", rhs, " : ", lhs, ";");
+    } else if(GetOMPReductionIdentity(op, {}).empty()) {
+        return {};
+    }
+
+    // The partial results of a - reduction are added up.
+    return StrCat(lhs, " = ", lhs, " ", ("-" == op) ? "+" : op, " ", rhs, ";");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
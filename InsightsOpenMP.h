@@ -0,0 +1,106 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_OPENMP_H
+#define INSIGHTS_OPENMP_H
+
+#include "clang/AST/StmtOpenMP.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The loop of a worksharing loop directive in its canonical form <tt>for(var = start; var op end; var +=
+/// step)</tt>, see \c --show-openmp.
+struct OMPCanonicalLoop
+{
+    const VarDecl* var;         //!< The loop variable.
+    const Expr*    start;       //!< The initial value of \c var.
+    const Expr*    end;         //!< The bound \c var is compared with.
+    const Expr*    step;        //!< The amount \c var changes by in each iteration, \c nullptr for one.
+    bool           increments;  //!< Whether \c var counts up.
+    bool           inclusive;   //!< Whether the comparison is \c <= or \c >=.
+};
+
+/// \brief The loop of \p loop in canonical form, if it is one with a loop variable declared in its init-statement.
+llvm::Optional<OMPCanonicalLoop> GetOMPCanonicalLoop(const ForStmt& loop);
+
+/// \brief The statement \p directive applies to without the captured statements around it, \c nullptr if there is
+/// none.
+const Stmt* GetOMPAssociatedStmt(const OMPExecutableDirective& directive);
+
+/// \brief The directive as it is written, like <tt>#pragma omp parallel for reduction(+: sum)</tt>.
+std::string GetOMPPragma(const OMPExecutableDirective& directive);
+
+/// \brief The expression \p expr stands for, if it refers to the variable clang introduces for a clause expression.
+const Expr* IgnoreOMPCapturedExpr(const Expr* expr);
+
+/// \brief The flags of \c ident_t of libomp.
+enum OMPIdentFlags : unsigned
+{
+    OMPIdentKmpc     = 0x02,   //!< Always set by clang.
+    OMPIdentWorkLoop = 0x200,  //!< The location of a worksharing loop.
+};
+
+/// \brief The declaration of the \c ident_t source location called \p name of \p directive the runtime calls receive.
+std::string GetOMPLocation(const OMPExecutableDirective& directive, const std::string& name, const unsigned flags);
+
+/// \brief The schedule of a worksharing loop as \c __kmpc_for_static_init and \c __kmpc_dispatch_init get it.
+struct OMPSchedule
+{
+    unsigned    type;      //!< The value of the \c sched_type of libomp.
+    const Expr* chunk;     //!< The chunk size, \c nullptr for none.
+    bool        isStatic;  //!< Whether the iterations are assigned once in \c __kmpc_for_static_init.
+};
+
+OMPSchedule GetOMPSchedule(const OMPLoopDirective& directive);
+
+/// \brief The suffix of the runtime loop functions for the type of the iteration variable, like \c 4 or \c 8u.
+std::string GetOMPLoopFunctionSuffix(const ASTContext& ctx, const QualType& type);
+
+/// \brief A variable of a \c reduction clause together with its reduction identifier like \c + or \c max.
+struct OMPReduction
+{
+    const VarDecl* var;
+    std::string    op;
+};
+
+llvm::SmallVector<OMPReduction, 4> GetOMPReductions(const OMPExecutableDirective& directive);
+
+/// \brief The value the private copy of a reduction variable of type \p type starts with, empty for a user-defined
+/// reduction.
+std::string GetOMPReductionIdentity(const std::string& op, const QualType& type);
+
+/// \brief The statement which combines the private copy \p rhs into \p lhs, empty for a user-defined reduction.
+std::string GetOMPReductionCombiner(const std::string& op, const std::string& lhs, const std::string& rhs);
+
+/// \brief The variables of all clauses of type \p Clause of \p directive.
+template<typename Clause>
+llvm::SmallVector<const VarDecl*, 4> GetOMPClauseVars(const OMPExecutableDirective& directive)
+{
+    llvm::SmallVector<const VarDecl*, 4> vars{};
+
+    for(const auto* clause : directive.getClausesOfKind<Clause>()) {
+        for(const auto* ref : clause->varlists()) {
+            if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(ref->IgnoreParenImpCasts())) {
+                if(const auto* var = dyn_cast_or_null<VarDecl>(declRef->getDecl())) {
+                    vars.push_back(var);
+                }
+            }
+        }
+    }
+
+    return vars;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_OPENMP_H */
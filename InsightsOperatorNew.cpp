@@ -0,0 +1,41 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/Support/ErrorHandling.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "InsightsMemReport.h"
+//-----------------------------------------------------------------------------
+
+// The allocations for the memory report are counted and sampled by replacing the global allocation functions. The array and
+// nothrow forms end up here as well. Only the insights executable links this file, a process which loads libinsights or
+// the Python module keeps its own allocation functions.
+void* operator new(const std::size_t size)
+{
+    clang::insights::RecordHeapAllocation(size);
+
+    if(void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+
+    llvm::report_bad_alloc_error("Allocation failed");
+}
+//-----------------------------------------------------------------------------
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+//-----------------------------------------------------------------------------
+
+void operator delete(void* ptr, const std::size_t /*size*/) noexcept
+{
+    std::free(ptr);
+}
+//-----------------------------------------------------------------------------
@@ -0,0 +1,961 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/Basic/IdentifierTable.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Format/Format.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Rewrite/Core/Rewriter.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <deque>
+#include <limits>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+
+#include <cerrno>
+#endif /* _WIN32 */
+
+#include "DPrint.h"
+#include "InsightsCodegenShards.h"
+#include "InsightsContentStore.h"
+#include "InsightsMemReport.h"
+#include "InsightsMemoryLimit.h"
+#include "InsightsOutputSink.h"
+#include "InsightsServer.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static std::atomic<uint64_t> gOutputChunks{};
+static std::atomic<uint64_t> gOverlappingChunks{};
+//-----------------------------------------------------------------------------
+
+OutputSinkStats GetOutputSinkStats()
+{
+    return {gOutputChunks, gOverlappingChunks};
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Same as the \c Rewriter, everything but a newline counts as indention.
+static bool IsWhitespaceExceptNL(const char c)
+{
+    switch(c) {
+        case ' ':
+        case '\t':
+        case '\f':
+        case '\v':
+        case '\r': return true;
+        default: return false;
+    }
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::AddChunk(Chunk&& chunk)
+{
+    mChunksSize += chunk.text.size();
+    TrackOutputMemory(static_cast<int64_t>(chunk.text.size()));
+
+    mChunks.push_back(std::move(chunk));
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::ClearChunks()
+{
+    TrackOutputMemory(-static_cast<int64_t>(mChunksSize));
+    mChunksSize = 0;
+
+    mChunks.clear();
+}
+//-----------------------------------------------------------------------------
+
+bool OutputSink::GetMainFileOffset(SourceLocation loc, unsigned& offset) const
+{
+    // Like the Rewriter, only file locations can be edited.
+    if(loc.isInvalid() or not loc.isFileID()) {
+        return false;
+    }
+
+    const auto [fileId, fileOffset] = mSM->getDecomposedLoc(loc);
+
+    if(fileId != mSM->getMainFileID()) {
+        return false;
+    }
+
+    offset = fileOffset;
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::ReplaceText(SourceRange range, std::string text, const char* origin, std::vector<SourceMark> marks)
+{
+    unsigned begin{};
+    unsigned end{};
+
+    if(not GetMainFileOffset(range.getBegin(), begin) or not GetMainFileOffset(range.getEnd(), end)) {
+        return;
+    }
+
+    end += Lexer::MeasureTokenLength(range.getEnd(), *mSM, *mLangOpts);
+
+    AddChunk({range, begin, end, false, false, GetCurrentGenerationUnit(), origin, std::move(text), std::move(marks)});
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::InsertText(SourceLocation          loc,
+                            std::string             text,
+                            const IndentNewLines    indentNewLines,
+                            const char*             origin,
+                            std::vector<SourceMark> marks)
+{
+    unsigned offset{};
+
+    if(not GetMainFileOffset(loc, offset)) {
+        return;
+    }
+
+    // The indention is applied when the chunks are written, only text with a new line needs it.
+    const bool indent{(IndentNewLines::Yes == indentNewLines) and (std::string::npos != text.find('\n'))};
+
+    AddChunk({SourceRange{loc},
+              offset,
+              offset,
+              true,
+              indent,
+              GetCurrentGenerationUnit(),
+              origin,
+              std::move(text),
+              std::move(marks)});
+}
+//-----------------------------------------------------------------------------
+
+StringRef OutputSink::GetIndention(const unsigned offset) const
+{
+    const StringRef buffer = mSM->getBufferData(mSM->getMainFileID());
+
+    const size_t lineStart = [&]() -> size_t {
+        const auto newLine = buffer.rfind('\n', offset);
+        return (StringRef::npos == newLine) ? 0 : (newLine + 1);
+    }();
+
+    size_t indentEnd{lineStart};
+    while((indentEnd < buffer.size()) and IsWhitespaceExceptNL(buffer[indentEnd])) {
+        ++indentEnd;
+    }
+
+    return buffer.slice(lineStart, indentEnd);
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::WriteChunkText(llvm::raw_ostream& ostream, const Chunk& chunk) const
+{
+    if(not chunk.indentNewLines) {
+        ostream << chunk.text;
+        return;
+    }
+
+    const StringRef indent = GetIndention(chunk.begin);
+    StringRef       text{chunk.text};
+
+    // Every line after the first gets the indention of the line the chunk is inserted at.
+    for(auto newLine = text.find('\n'); StringRef::npos != newLine; newLine = text.find('\n')) {
+        ostream << text.take_front(newLine + 1) << indent;
+        text = text.drop_front(newLine + 1);
+    }
+
+    ostream << text;
+}
+//-----------------------------------------------------------------------------
+
+size_t OutputSink::GetChunkTextSize(const Chunk& chunk) const
+{
+    if(not chunk.indentNewLines) {
+        return chunk.text.size();
+    }
+
+    const auto newLines = static_cast<size_t>(std::count(chunk.text.begin(), chunk.text.end(), '\n'));
+
+    return chunk.text.size() + (newLines * GetIndention(chunk.begin).size());
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::SortChunks(std::vector<const Chunk*>& sorted) const
+{
+    sorted.reserve(mChunks.size());
+
+    for(const auto& chunk : mChunks) {
+        sorted.push_back(&chunk);
+    }
+
+    // The chunks at the same offset keep their order, which is the order the Rewriter applies them.
+    std::stable_sort(
+        sorted.begin(), sorted.end(), [](const Chunk* lhs, const Chunk* rhs) { return lhs->begin < rhs->begin; });
+}
+//-----------------------------------------------------------------------------
+
+bool OutputSink::GetSortedChunks(std::vector<const Chunk*>& sorted) const
+{
+    SortChunks(sorted);
+
+    size_t overlapping{};
+
+    for(size_t i = 1; i < sorted.size(); ++i) {
+        if(sorted[i]->begin < sorted[i - 1]->end) {
+            ++overlapping;
+        }
+    }
+
+    gOutputChunks += mChunks.size();
+    gOverlappingChunks += overlapping;
+
+    return 0 == overlapping;
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::Write(llvm::raw_ostream& ostream) const
+{
+    std::vector<const Chunk*> sorted{};
+
+    if(not GetSortedChunks(sorted)) {
+        WriteWithRewriter(ostream);
+        return;
+    }
+
+    size_t chunksSize{};
+
+    for(const auto& chunk : mChunks) {
+        chunksSize += chunk.text.size();
+    }
+
+    RecordRewriteBufferSize(chunksSize);
+
+    const StringRef original = mSM->getBufferData(mSM->getMainFileID());
+    size_t          start{};
+
+    for(const auto* chunk : sorted) {
+        ostream << original.slice(start, chunk->begin);
+        WriteChunkText(ostream, *chunk);
+        start = chunk->end;
+    }
+
+    ostream << original.substr(start);
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::GetResult(std::string& result, std::vector<tooling::Range>& generated) const
+{
+    llvm::raw_string_ostream  stream{result};
+    std::vector<const Chunk*> sorted{};
+
+    if(GetSortedChunks(sorted)) {
+        const StringRef original = mSM->getBufferData(mSM->getMainFileID());
+        size_t          start{};
+
+        for(const auto* chunk : sorted) {
+            stream << original.slice(start, chunk->begin);
+
+            const auto offset = static_cast<unsigned>(stream.tell());
+            WriteChunkText(stream, *chunk);
+            generated.emplace_back(offset, static_cast<unsigned>(stream.tell()) - offset);
+
+            start = chunk->end;
+        }
+
+        stream << original.substr(start);
+
+    } else {
+        WriteWithRewriter(stream);
+        generated.emplace_back(0, static_cast<unsigned>(stream.tell()));
+    }
+
+    stream.flush();
+}
+//-----------------------------------------------------------------------------
+
+bool OutputSink::WriteFormatted(llvm::raw_ostream& ostream, StringRef style) const
+{
+    const auto* mainFile = mSM->getFileEntryForID(mSM->getMainFileID());
+    const auto  fileName = mainFile ? mainFile->getName() : StringRef{"input.cpp"};
+
+    auto formatStyle = format::getStyle(style, fileName, "LLVM");
+
+    if(not formatStyle) {
+        Error("--format: %s\n", llvm::toString(formatStyle.takeError()));
+        return false;
+    }
+
+    std::string                 result{};
+    std::vector<tooling::Range> ranges{};
+    GetResult(result, ranges);
+
+    const auto replacements = format::reformat(*formatStyle, result, ranges, fileName);
+    auto       formatted    = tooling::applyAllReplacements(result, replacements);
+
+    if(not formatted) {
+        // The replacements come from the formatter itself, they do not conflict. Better the unformatted result than none.
+        llvm::consumeError(formatted.takeError());
+        ostream << result;
+        return true;
+    }
+
+    ostream << *formatted;
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+#ifndef _WIN32
+/// \brief The maximum number of buffers of a single \c writev.
+#ifdef IOV_MAX
+static constexpr size_t MAX_IOV{IOV_MAX};
+#else
+static constexpr size_t MAX_IOV{1024};
+#endif /* IOV_MAX */
+//-----------------------------------------------------------------------------
+
+static bool WriteAll(const int fd, std::vector<iovec>& iov)
+{
+    for(size_t i = 0; i < iov.size();) {
+        const auto written = ::writev(fd, &iov[i], static_cast<int>(std::min(iov.size() - i, MAX_IOV)));
+
+        if((0 > written) and (EINTR == errno)) {
+            continue;
+        } else if(0 > written) {
+            return false;
+        }
+
+        // A partial write can end in the middle of a buffer, the next writev starts with its remainder.
+        for(auto left = static_cast<size_t>(written); (0 < left) and (i < iov.size());) {
+            if(left >= iov[i].iov_len) {
+                left -= iov[i].iov_len;
+                ++i;
+            } else {
+                iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + left;
+                iov[i].iov_len -= left;
+                left = 0;
+            }
+        }
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+#endif /* _WIN32 */
+
+bool OutputSink::WriteGathered(const int fd) const
+{
+    auto writeToStream = [&](auto&& write) {
+        llvm::raw_fd_ostream ostream{fd, /*shouldClose=*/false};
+        write(ostream);
+        ostream.flush();
+
+        // An error which is still set makes the destructor of the stream abort.
+        const bool success{not ostream.has_error()};
+        ostream.clear_error();
+
+        return success;
+    };
+
+#ifndef _WIN32
+    std::vector<const Chunk*> sorted{};
+
+    if(not GetSortedChunks(sorted)) {
+        return writeToStream([&](llvm::raw_ostream& ostream) { WriteWithRewriter(ostream); });
+    }
+
+    size_t chunksSize{};
+
+    for(const auto& chunk : mChunks) {
+        chunksSize += chunk.text.size();
+    }
+
+    RecordRewriteBufferSize(chunksSize);
+
+    // Only chunks with indented new lines need a copy, a deque keeps the addresses of the copies stable.
+    std::deque<std::string> indentedTexts{};
+    std::vector<iovec>      iov{};
+    iov.reserve((2 * sorted.size()) + 1);
+
+    auto add = [&](StringRef data) {
+        if(not data.empty()) {
+            iov.push_back({const_cast<char*>(data.data()), data.size()});
+        }
+    };
+
+    const StringRef original = mSM->getBufferData(mSM->getMainFileID());
+    size_t          start{};
+
+    for(const auto* chunk : sorted) {
+        add(original.slice(start, chunk->begin));
+
+        if(chunk->indentNewLines) {
+            llvm::raw_string_ostream stream{indentedTexts.emplace_back()};
+            WriteChunkText(stream, *chunk);
+            add(stream.str());
+        } else {
+            add(chunk->text);
+        }
+
+        start = chunk->end;
+    }
+
+    add(original.substr(start));
+
+    return WriteAll(fd, iov);
+#else
+    return writeToStream([&](llvm::raw_ostream& ostream) { Write(ostream); });
+#endif /* _WIN32 */
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::Stream(llvm::raw_ostream& ostream, const unsigned offset)
+{
+    if(mStreamStopped) {
+        return;
+    }
+
+    const StringRef original = mSM->getBufferData(mSM->getMainFileID());
+    auto            end      = static_cast<unsigned>(std::min<size_t>(offset, original.size()));
+
+    std::vector<const Chunk*> sorted{};
+    SortChunks(sorted);
+
+    size_t   ready{};
+    unsigned previousEnd{mStreamed};
+
+    for(const auto* chunk : sorted) {
+        if(chunk->begin < mStreamed) {
+            Error("--stream: an edit at offset %u came in after the output up to %u was written\n",
+                  chunk->begin,
+                  mStreamed);
+        }
+
+        if(chunk->begin < previousEnd) {
+            mStreamStopped = true;
+            return;
+        }
+
+        if((chunk->begin >= end) or (chunk->end > end)) {
+            end = std::min(end, chunk->begin);
+            break;
+        }
+
+        ++ready;
+        previousEnd = chunk->end;
+    }
+
+    if(end <= mStreamed) {
+        return;
+    }
+
+    std::vector<bool> written(mChunks.size());
+    uint64_t          writtenSize{};
+
+    for(size_t i = 0; i < ready; ++i) {
+        const auto* chunk = sorted[i];
+
+        ostream << original.slice(mStreamed, chunk->begin);
+        WriteChunkText(ostream, *chunk);
+        mStreamed = chunk->end;
+
+        written[static_cast<size_t>(chunk - mChunks.data())] = true;
+        writtenSize += chunk->text.size();
+    }
+
+    ostream << original.slice(mStreamed, end);
+    mStreamed = end;
+
+    gOutputChunks += ready;
+
+    // Keep the remaining chunks in the order they came in.
+    std::vector<Chunk> remaining{};
+    remaining.reserve(mChunks.size() - ready);
+
+    for(size_t i = 0; i < mChunks.size(); ++i) {
+        if(not written[i]) {
+            remaining.push_back(std::move(mChunks[i]));
+        }
+    }
+
+    mChunks = std::move(remaining);
+    mChunksSize -= writtenSize;
+    TrackOutputMemory(-static_cast<int64_t>(writtenSize));
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::StreamLine(llvm::raw_ostream& ostream, StringRef line)
+{
+    const StringRef original = mSM->getBufferData(mSM->getMainFileID());
+
+    if((0 != mStreamed) and ('\n' != original[mStreamed - 1])) {
+        ostream << '\n';
+    }
+
+    ostream << line;
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::FinishStream(llvm::raw_ostream& ostream)
+{
+    Stream(ostream, std::numeric_limits<unsigned>::max());
+
+    if(not mStreamStopped) {
+        return;
+    }
+
+    // All remaining chunks begin behind the written part, up to there the Rewriter leaves the main file as it is.
+    std::string              rewritten{};
+    llvm::raw_string_ostream stream{rewritten};
+    std::vector<const Chunk*> sorted{};
+
+    GetSortedChunks(sorted);
+    WriteWithRewriter(stream);
+
+    ostream << StringRef{stream.str()}.substr(mStreamed);
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::WriteEdits(llvm::raw_ostream& ostream) const
+{
+    llvm::json::Array         edits{};
+    std::vector<const Chunk*> sorted{};
+
+    if(GetSortedChunks(sorted)) {
+        for(const auto* chunk : sorted) {
+            std::string              text{};
+            llvm::raw_string_ostream stream{text};
+            WriteChunkText(stream, *chunk);
+
+            edits.push_back(llvm::json::Object{{"begin", static_cast<int64_t>(chunk->begin)},
+                                               {"end", static_cast<int64_t>(chunk->end)},
+                                               {"text", std::move(stream.str())},
+                                               {"handler", chunk->origin}});
+        }
+
+    } else {
+        std::string              text{};
+        llvm::raw_string_ostream stream{text};
+        WriteWithRewriter(stream);
+
+        edits.push_back(
+            llvm::json::Object{{"begin", 0},
+                               {"end", static_cast<int64_t>(mSM->getBufferData(mSM->getMainFileID()).size())},
+                               {"text", std::move(stream.str())},
+                               {"handler", "Rewriter"}});
+    }
+
+    ostream << llvm::json::Value{llvm::json::Object{{"edits", std::move(edits)}}} << '\n';
+}
+//-----------------------------------------------------------------------------
+
+bool OutputSink::WriteManifest(llvm::raw_ostream& ostream) const
+{
+    const auto&     mainFileId = mSM->getMainFileID();
+    const StringRef original   = mSM->getBufferData(mainFileId);
+    const auto*     mainFile   = mSM->getFileEntryForID(mainFileId);
+
+    llvm::json::Array parts{};
+    bool              stored{true};
+
+    auto addChunk = [&](std::string text) {
+        if(IsInlineContent(text)) {
+            parts.push_back(llvm::json::Object{{"text", std::move(text)}});
+            return;
+        }
+
+        std::string key{PutContent(text)};
+        stored = stored and not key.empty();
+
+        parts.push_back(llvm::json::Object{{"chunk", std::move(key)}});
+    };
+
+    auto addSlice = [&](const size_t begin, const size_t end) {
+        if(begin < end) {
+            parts.push_back(
+                llvm::json::Object{{"begin", static_cast<int64_t>(begin)}, {"end", static_cast<int64_t>(end)}});
+        }
+    };
+
+    std::vector<const Chunk*> sorted{};
+
+    if(GetSortedChunks(sorted)) {
+        size_t start{};
+
+        for(const auto* chunk : sorted) {
+            addSlice(start, chunk->begin);
+
+            std::string              text{};
+            llvm::raw_string_ostream stream{text};
+            WriteChunkText(stream, *chunk);
+            addChunk(std::move(stream.str()));
+
+            start = chunk->end;
+        }
+
+        addSlice(start, original.size());
+
+    } else {
+        std::string              text{};
+        llvm::raw_string_ostream stream{text};
+        WriteWithRewriter(stream);
+        addChunk(std::move(stream.str()));
+    }
+
+    llvm::SmallString<256> source{mainFile ? mainFile->getName() : StringRef{}};
+    llvm::sys::fs::make_absolute(source);
+
+    ostream << llvm::json::Value{llvm::json::Object{{"source", source.str()},
+                                                    {"sourceKey", GetContentKey(original)},
+                                                    {"store", GetContentStoreDir()},
+                                                    {"parts", std::move(parts)}}}
+            << '\n';
+
+    return stored;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The token classes of \c --semantic-tokens, in the order of their legend.
+enum class TokenClass : unsigned
+{
+    Keyword,
+    Identifier,
+    Synthesized,
+    Number,
+    String,
+    Comment,
+};
+//-----------------------------------------------------------------------------
+
+bool OutputSink::WriteSemanticTokens(StringRef fileName) const
+{
+    std::string                 result{};
+    std::vector<tooling::Range> generated{};
+    GetResult(result, generated);
+
+    IdentifierTable identifiers{*mLangOpts};
+    Lexer           lexer{SourceLocation{}, *mLangOpts, result.data(), result.data(), result.data() + result.size()};
+    lexer.SetCommentRetentionState(true);
+
+    llvm::json::Array data{};
+    unsigned          previous{};
+    auto              nextGenerated = generated.begin();
+
+    Token token{};
+
+    for(lexer.LexFromRawLexer(token); token.isNot(tok::eof); lexer.LexFromRawLexer(token)) {
+        const unsigned offset = static_cast<unsigned>(lexer.getBufferLocation() - result.data()) - token.getLength();
+
+        while((generated.end() != nextGenerated) and
+              ((nextGenerated->getOffset() + nextGenerated->getLength()) <= offset)) {
+            ++nextGenerated;
+        }
+
+        const bool isGenerated{(generated.end() != nextGenerated) and (nextGenerated->getOffset() <= offset)};
+
+        TokenClass tokenClass{};
+
+        if(token.is(tok::raw_identifier)) {
+            const StringRef name = token.getRawIdentifier();
+
+            if(tok::identifier != identifiers.get(name).getTokenID()) {
+                tokenClass = TokenClass::Keyword;
+            } else if(isGenerated and name.startswith("__")) {
+                // The prefix of BuildInternalVarName.
+                tokenClass = TokenClass::Synthesized;
+            } else {
+                tokenClass = TokenClass::Identifier;
+            }
+
+        } else if(token.is(tok::numeric_constant)) {
+            tokenClass = TokenClass::Number;
+        } else if(tok::isStringLiteral(token.getKind()) or token.is(tok::char_constant)) {
+            tokenClass = TokenClass::String;
+        } else if(token.is(tok::comment)) {
+            tokenClass = TokenClass::Comment;
+        } else {
+            continue;
+        }
+
+        data.push_back(static_cast<int64_t>(offset - previous));
+        data.push_back(static_cast<int64_t>(token.getLength()));
+        data.push_back(static_cast<int64_t>(tokenClass));
+        data.push_back(isGenerated ? 1 : 0);
+
+        previous = offset;
+    }
+
+    std::error_code      ec{};
+    llvm::raw_fd_ostream out{fileName, ec, llvm::sys::fs::OF_Text};
+
+    if(ec) {
+        Error("cannot write semantic tokens '%s': %s\n", fileName, ec.message());
+        return false;
+    }
+
+    out << llvm::json::Value{llvm::json::Object{
+               {"legend",
+                llvm::json::Object{
+                    {"tokenTypes",
+                     llvm::json::Array{"keyword", "identifier", "synthesized", "number", "string", "comment"}},
+                    {"tokenModifiers", llvm::json::Array{"generated"}}}},
+               {"data", std::move(data)}}}
+        << '\n';
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+bool OutputSink::WriteSourceMap(StringRef fileName) const
+{
+    const auto&     mainFileId = mSM->getMainFileID();
+    const StringRef original   = mSM->getBufferData(mainFileId);
+    const auto*     mainFile   = mSM->getFileEntryForID(mainFileId);
+
+    SourceMapBuilder          builder{};
+    std::vector<const Chunk*> sorted{};
+    SortChunks(sorted);
+
+    const bool overlapping{std::adjacent_find(sorted.begin(), sorted.end(), [](const Chunk* lhs, const Chunk* rhs) {
+                               return rhs->begin < lhs->end;
+                           }) != sorted.end()};
+
+    if(overlapping) {
+        Error("--source-map: edits overlap, the source map is empty\n");
+        return builder.Write(fileName, mainFile ? mainFile->getName() : StringRef{});
+    }
+
+    unsigned generatedLine{};
+    unsigned generatedColumn{};
+    unsigned sourceLine{};
+    unsigned sourceColumn{};
+    size_t   sourceOffset{};  // The offset in the main file sourceLine and sourceColumn belong to.
+
+    // Everything is walked once from begin to end, the source position follows along over the replaced ranges.
+    auto advanceSource = [&](const size_t offset) {
+        for(; sourceOffset < offset; ++sourceOffset) {
+            if('\n' == original[sourceOffset]) {
+                ++sourceLine;
+                sourceColumn = 0;
+            } else {
+                ++sourceColumn;
+            }
+        }
+    };
+
+    auto writeOriginal = [&](const size_t begin, const size_t end) {
+        advanceSource(begin);
+
+        for(auto offset = begin; offset < end; ++offset) {
+            if(((offset == begin) or (0 == generatedColumn)) and ('\n' != original[offset])) {
+                advanceSource(offset);
+                builder.AddSegment(generatedLine, generatedColumn, sourceLine, sourceColumn);
+            }
+
+            if('\n' == original[offset]) {
+                ++generatedLine;
+                generatedColumn = 0;
+            } else {
+                ++generatedColumn;
+            }
+        }
+    };
+
+    auto writeChunk = [&](const Chunk& chunk) {
+        advanceSource(chunk.begin);
+
+        const StringRef indent = chunk.indentNewLines ? GetIndention(chunk.begin) : StringRef{};
+        auto            mark   = chunk.marks.begin();
+        unsigned        line{sourceLine};
+        unsigned        column{sourceColumn};
+        bool            newLine{true};
+
+        for(size_t offset = 0; offset < chunk.text.size(); ++offset) {
+            for(; (chunk.marks.end() != mark) and (mark->offset <= offset); ++mark) {
+                // Only nodes of the main file have a position in the source, the others keep the previous one.
+                const auto [fileId, fileOffset] = mSM->getDecomposedExpansionLoc(mark->loc);
+
+                if(fileId == mainFileId) {
+                    line    = mSM->getLineNumber(fileId, fileOffset) - 1;
+                    column  = mSM->getColumnNumber(fileId, fileOffset) - 1;
+                    newLine = true;
+                }
+            }
+
+            if(newLine and ('\n' != chunk.text[offset])) {
+                builder.AddSegment(generatedLine, generatedColumn, line, column);
+                newLine = false;
+            }
+
+            if('\n' == chunk.text[offset]) {
+                ++generatedLine;
+                generatedColumn = static_cast<unsigned>(indent.size());
+                newLine         = true;
+            } else {
+                ++generatedColumn;
+            }
+        }
+    };
+
+    size_t start{};
+
+    for(const auto* chunk : sorted) {
+        writeOriginal(start, chunk->begin);
+        writeChunk(*chunk);
+        start = chunk->end;
+    }
+
+    writeOriginal(start, original.size());
+
+    return builder.Write(fileName, mainFile ? mainFile->getName() : StringRef{});
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::AddDeclSegment(SourceRange range, std::string key)
+{
+    unsigned begin{};
+    unsigned end{};
+
+    if(not GetMainFileOffset(range.getBegin(), begin) or not GetMainFileOffset(range.getEnd(), end)) {
+        return;
+    }
+
+    end += Lexer::MeasureTokenLength(range.getEnd(), *mSM, *mLangOpts);
+
+    mDeclSegments.push_back({begin, end, std::move(key)});
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::GetSegments(std::vector<OutputSegment>& segments) const
+{
+    std::vector<const Chunk*> sorted{};
+    SortChunks(sorted);
+
+    // The Rewriter keeps no positions.
+    for(size_t i = 1; i < sorted.size(); ++i) {
+        if(sorted[i]->begin < sorted[i - 1]->end) {
+            return;
+        }
+    }
+
+    std::vector<const DeclSegment*> decls{};
+    decls.reserve(mDeclSegments.size());
+
+    for(const auto& decl : mDeclSegments) {
+        decls.push_back(&decl);
+    }
+
+    std::stable_sort(decls.begin(), decls.end(), [](const DeclSegment* lhs, const DeclSegment* rhs) {
+        return lhs->begin < rhs->begin;
+    });
+
+    size_t   next{};        // The first chunk behind the offset of the last call to getResultOffset.
+    int64_t  growth{};      // What the chunks before that offset added to the result.
+    unsigned segmentEnd{};  // The offset in the result up to which the segments reach.
+    unsigned sourceEnd{};   // The offset in the main file up to which the declarations reach.
+
+    // Chunks at the offset itself come behind it.
+    auto getResultOffset = [&](const unsigned offset) {
+        for(; (next < sorted.size()) and (sorted[next]->begin < offset); ++next) {
+            growth += static_cast<int64_t>(GetChunkTextSize(*sorted[next])) -
+                      static_cast<int64_t>(sorted[next]->end - sorted[next]->begin);
+        }
+
+        return static_cast<unsigned>(offset + growth);
+    };
+
+    auto addSegment = [&](const unsigned end, std::string key) {
+        if(end > segmentEnd) {
+            segments.push_back({end - segmentEnd, std::move(key)});
+            segmentEnd = end;
+        }
+    };
+
+    for(const auto* decl : decls) {
+        // A nested declaration is part of the outer one.
+        if(decl->begin < sourceEnd) {
+            continue;
+        }
+
+        const unsigned begin = getResultOffset(decl->begin);
+
+        // A chunk before the declaration reaches into it.
+        if((0 < next) and (sorted[next - 1]->end > decl->begin)) {
+            continue;
+        }
+
+        // Chunks which begin in the declaration may reach beyond its end, like the one up to the semicolon.
+        unsigned end{decl->end};
+        size_t   chunks{};
+        bool     hasInsertion{};
+
+        for(auto i = next; (i < sorted.size()) and (sorted[i]->begin < end); ++i) {
+            end = std::max(end, sorted[i]->end);
+            ++chunks;
+            hasInsertion |= sorted[i]->isInsertion;
+        }
+
+        addSegment(begin, {});
+        addSegment(getResultOffset(end), ((1 == chunks) and not hasInsertion) ? decl->key : std::string{});
+
+        sourceEnd = end;
+    }
+
+    auto resultSize = static_cast<int64_t>(mSM->getBufferData(mSM->getMainFileID()).size());
+
+    for(const auto* chunk : sorted) {
+        resultSize += static_cast<int64_t>(GetChunkTextSize(*chunk)) - static_cast<int64_t>(chunk->end - chunk->begin);
+    }
+
+    addSegment(static_cast<unsigned>(resultSize), {});
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::Export(ShardResult& result)
+{
+    result.mainFile = mSM->getBufferData(mSM->getMainFileID()).str();
+
+    for(auto& chunk : mChunks) {
+        if(chunk.indentNewLines) {
+            std::string              indented{};
+            llvm::raw_string_ostream stream{indented};
+            WriteChunkText(stream, chunk);
+            chunk.text = std::move(stream.str());
+        }
+
+        result.chunks.push_back({chunk.begin, chunk.end, chunk.unit, std::move(chunk.text)});
+    }
+
+    ClearChunks();
+}
+//-----------------------------------------------------------------------------
+
+void OutputSink::WriteWithRewriter(llvm::raw_ostream& ostream) const
+{
+    Rewriter rewriter{*mSM, *mLangOpts};
+
+    for(const auto& chunk : mChunks) {
+        if(chunk.isInsertion) {
+            rewriter.InsertText(chunk.range.getBegin(), chunk.text, true, chunk.indentNewLines);
+        } else {
+            rewriter.ReplaceText(chunk.range, chunk.text);
+        }
+    }
+
+    const auto& editBuffer = rewriter.getEditBuffer(mSM->getMainFileID());
+
+    RecordRewriteBufferSize(editBuffer.size());
+    editBuffer.write(ostream);
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,234 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_OUTPUT_SINK_H
+#define INSIGHTS_OUTPUT_SINK_H
+//-----------------------------------------------------------------------------
+
+#include "clang/Basic/SourceLocation.h"
+#include "clang/Tooling/Core/Replacement.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <vector>
+
+#include "InsightsSourceMap.h"
+#include "InsightsStrongTypes.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class LangOptions;
+class SourceManager;
+}  // namespace clang
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+struct OutputSegment;
+struct ShardResult;
+//-----------------------------------------------------------------------------
+
+/// \brief The number of chunks all output sinks wrote and how many of them overlapped another one, see \c --stats.
+struct OutputSinkStats
+{
+    uint64_t chunks;
+    uint64_t overlapping;
+};
+
+OutputSinkStats GetOutputSinkStats();
+//-----------------------------------------------------------------------------
+
+/// \brief Collects the code the handlers generate for the main file and writes the final result.
+///
+/// The handlers hand over their generated code as chunks, together with the source range the chunk replaces. As long
+/// as the chunks do not overlap, the result is written as the slices of the original file with the chunks in between.
+/// No edit buffer gets built for that. Overlapping chunks are applied to a \c Rewriter in the order they came in,
+/// which gives the same result as if the handlers had used the \c Rewriter directly. This is the one place to look at,
+/// if two handlers generate code for the same part of the file.
+class OutputSink
+{
+public:
+    OutputSink() = default;
+    ~OutputSink() { ClearChunks(); }
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    void SetSourceMgr(SourceManager& sm, const LangOptions& langOpts)
+    {
+        mSM            = &sm;
+        mLangOpts      = &langOpts;
+        mStreamed      = 0;
+        mStreamStopped = false;
+        mDeclSegments.clear();
+        ClearChunks();
+    }
+
+    /// \brief Replace the token range \p range with \p text. \p origin names the one who made the edit, \p marks are the
+    /// nodes \p text was generated from, see \ref WriteSourceMap.
+    void ReplaceText(SourceRange             range,
+                     std::string             text,
+                     const char*             origin = "",
+                     std::vector<SourceMark> marks  = {});
+
+    STRONG_BOOL(IndentNewLines);
+
+    /// \brief Insert \p text at \p loc, after all text inserted there before.
+    ///
+    /// With \c IndentNewLines::Yes every line of \p text after the first gets the indention of the line \p loc is in.
+    void InsertText(SourceLocation          loc,
+                    std::string             text,
+                    const IndentNewLines    indentNewLines = IndentNewLines::No,
+                    const char*             origin         = "",
+                    std::vector<SourceMark> marks          = {});
+
+    /// \brief Write the main file with all chunks applied to \p ostream.
+    void Write(llvm::raw_ostream& ostream) const;
+
+    /// \brief Same as \ref Write, with the generated code formatted in the clang-format style \p style, see \c --format.
+    ///
+    /// Only the ranges of the chunks in the result are formatted, the slices of the main file stay as they are. With
+    /// overlapping chunks the entire result is formatted.
+    ///
+    /// \returns \c false, if \p style is unknown. Nothing is written then.
+    bool WriteFormatted(llvm::raw_ostream& ostream, StringRef style) const;
+
+    /// \brief Same as \ref Write, directly to the file descriptor \p fd.
+    ///
+    /// The slices of the main file are not copied, they are written straight from the buffer of the source manager.
+    /// Together with the chunks in between they go out in as few gathered writes as possible.
+    ///
+    /// \returns \c false, if writing failed.
+    bool WriteGathered(const int fd) const;
+
+    /// \brief Write the main file up to \p offset with the chunks before it applied to \p ostream, see \c --stream.
+    ///
+    /// Each call continues where the previous one stopped, the written chunks are dropped. The caller guarantees that
+    /// no more chunks for the part before \p offset come in. A chunk which reaches beyond \p offset is held back
+    /// together with everything behind its begin. Once chunks overlap, streaming stops and \ref FinishStream writes
+    /// the rest with a \c Rewriter.
+    void Stream(llvm::raw_ostream& ostream, const unsigned offset);
+
+    /// \brief Write \p line to \p ostream at the current position of \ref Stream, on a line of its own.
+    void StreamLine(llvm::raw_ostream& ostream, StringRef line);
+
+    /// \brief Write everything \ref Stream did not write yet.
+    void FinishStream(llvm::raw_ostream& ostream);
+
+    /// \brief Write only the edits as JSON to \p ostream, see \c --output=edits-json.
+    ///
+    /// Each edit has the byte range of the main file it replaces, the replacement and its origin. Overlapping chunks
+    /// have no such range, they are written as a single edit of the entire file.
+    void WriteEdits(llvm::raw_ostream& ostream) const;
+
+    /// \brief Write a manifest of the result to \p ostream and the chunks to the content store, see \c --dedup-store.
+    ///
+    /// The manifest lists the slices of the main file by their byte range and the chunks by their key in the store.
+    /// Chunks too small for an entry of their own are part of the manifest. Overlapping chunks are written as a single
+    /// chunk of the entire file.
+    ///
+    /// \returns \c false, if a chunk could not be stored.
+    bool WriteManifest(llvm::raw_ostream& ostream) const;
+
+    /// \brief Write the source map of the result \ref Write produces to \p fileName, see \c --source-map.
+    ///
+    /// The code of a chunk maps to the nodes it was generated from, code without a node to the begin of the replaced
+    /// range. The parts of the main file between the chunks map to themselves, line by line. Overlapping chunks go
+    /// through the \c Rewriter, which keeps no positions, then the source map is left empty.
+    ///
+    /// \returns \c false, if the file could not be written.
+    bool WriteSourceMap(StringRef fileName) const;
+
+    /// \brief Write the classes of the tokens of the result \ref Write produces to \p fileName, see \c
+    /// --semantic-tokens.
+    ///
+    /// Each token is four numbers: the distance of its offset to the one of the previous token, its length, its class
+    /// and its modifiers. The classes are keyword, identifier, synthesized for the names C++ Insights makes up, number,
+    /// string and comment. The only modifier marks code C++ Insights generated.
+    ///
+    /// \returns \c false, if the file could not be written.
+    bool WriteSemanticTokens(StringRef fileName) const;
+
+    /// \brief Note that the code for the top-level declaration in \p range is the entry \p key of the declaration cache,
+    /// see \ref GetSegments.
+    void AddDeclSegment(SourceRange range, std::string key);
+
+    /// \brief Split the result \ref Write produces into the parts of the declarations from \ref AddDeclSegment and the
+    /// parts in between.
+    ///
+    /// A declaration keeps its key only, if a single chunk replaces a part of it. Everything else in its range comes
+    /// from the main file then, which the key covers. A declaration together with other chunks, like the include of
+    /// \c <new> at its begin, is a part without a key. Overlapping chunks go through the \c Rewriter, which keeps no
+    /// positions, then there are no parts.
+    void GetSegments(std::vector<OutputSegment>& segments) const;
+
+    /// \brief Hand the chunks and the content of the main file over to \p result, see \ref SetCodegenShard.
+    void Export(ShardResult& result);
+
+private:
+    struct Chunk
+    {
+        SourceRange             range;           //!< The replaced token range, the begin only for an insertion.
+        unsigned                begin;           //!< The offset of the replaced range in the main file.
+        unsigned                end;             //!< The offset behind the replaced range in the main file.
+        bool                    isInsertion;     //!< Whether the chunk replaces nothing.
+        bool                    indentNewLines;  //!< Whether the lines after the first get the indention of \c begin.
+        uint64_t                unit;            //!< The generation unit the chunk belongs to.
+        const char*             origin;          //!< The handler which made the edit.
+        std::string             text;
+        std::vector<SourceMark> marks;           //!< The nodes \c text was generated from, ordered by their offset.
+    };
+
+    struct DeclSegment
+    {
+        unsigned    begin;  //!< The offset of the declaration in the main file.
+        unsigned    end;    //!< The offset behind the declaration in the main file.
+        std::string key;
+    };
+
+    SourceManager*           mSM{};
+    const LangOptions*       mLangOpts{};
+    std::vector<Chunk>       mChunks{};
+    std::vector<DeclSegment> mDeclSegments{};
+    uint64_t                 mChunksSize{};     //!< The bytes of all chunk texts, see \ref TrackOutputMemory.
+    unsigned                 mStreamed{};       //!< The offset of the main file \ref Stream has written up to.
+    bool                     mStreamStopped{};  //!< Whether chunks overlapped while streaming.
+
+    void AddChunk(Chunk&& chunk);
+
+    void ClearChunks();
+
+    /// \brief Get the chunks sorted by their begin, chunks with the same begin in the order they came in.
+    void SortChunks(std::vector<const Chunk*>& sorted) const;
+
+    /// \brief Get the chunks in the order they are applied to the main file.
+    ///
+    /// \returns \c false, if chunks overlap.
+    bool GetSortedChunks(std::vector<const Chunk*>& sorted) const;
+
+    /// \brief Get the offset of \p loc in the main file, if it is a location in the main file.
+    bool GetMainFileOffset(SourceLocation loc, unsigned& offset) const;
+
+    /// \brief Get the indention of the line \p offset is in.
+    StringRef GetIndention(const unsigned offset) const;
+
+    void WriteChunkText(llvm::raw_ostream& ostream, const Chunk& chunk) const;
+
+    /// \brief The number of bytes \ref WriteChunkText writes for \p chunk.
+    size_t GetChunkTextSize(const Chunk& chunk) const;
+
+    void WriteWithRewriter(llvm::raw_ostream& ostream) const;
+
+    /// \brief Get the result \ref Write writes together with the ranges in it which the chunks generated. With
+    /// overlapping chunks the entire result counts as generated.
+    void GetResult(std::string& result, std::vector<tooling::Range>& generated) const;
+};
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_OUTPUT_SINK_H */
@@ -0,0 +1,295 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "llvm/ADT/DenseMap.h"
+
+#include "InsightsHelpers.h"
+#include "InsightsParameterCost.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The copies into each by-value parameter at the call sites of the current translation unit, keyed by the
+/// parameter of the canonical declaration of the function.
+static thread_local llvm::DenseMap<const ParmVarDecl*, uint64_t> gCallerCopies{};
+static thread_local bool                                         gCallerCopiesCounted{};
+//-----------------------------------------------------------------------------
+
+void ResetParameterCostTranslationUnit()
+{
+    gCallerCopies.clear();
+    gCallerCopiesCounted = false;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The parameter of the canonical declaration, the calls may refer to another declaration of the function.
+static const ParmVarDecl* GetCanonicalParam(const FunctionDecl& function, const unsigned index)
+{
+    const auto* canonical = function.getCanonicalDecl();
+
+    if(index >= canonical->getNumParams()) {
+        return nullptr;
+    }
+
+    return canonical->getParamDecl(index);
+}
+//-----------------------------------------------------------------------------
+
+static bool IsCopy(const Expr* arg)
+{
+    const auto* construct = dyn_cast_or_null<CXXConstructExpr>(arg->IgnoreImplicit());
+
+    return construct and construct->getConstructor()->isCopyConstructor();
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+class CallerCopyCounter : public RecursiveASTVisitor<CallerCopyCounter>
+{
+public:
+    bool shouldVisitTemplateInstantiations() const { return true; }
+    bool shouldVisitImplicitCode() const { return true; }
+
+    bool VisitCallExpr(const CallExpr* call)
+    {
+        const auto* callee = call->getDirectCallee();
+
+        if(not callee) {
+            return true;
+        }
+
+        // The object of a member operator is the first argument, it has no parameter.
+        const unsigned offset{(isa<CXXOperatorCallExpr>(call) and isa<CXXMethodDecl>(callee)) ? 1u : 0u};
+
+        for(unsigned i = offset; i < call->getNumArgs(); ++i) {
+            Count(*callee, i - offset, call->getArg(i));
+        }
+
+        return true;
+    }
+
+    bool VisitCXXConstructExpr(const CXXConstructExpr* construct)
+    {
+        for(unsigned i = 0; i < construct->getNumArgs(); ++i) {
+            Count(*construct->getConstructor(), i, construct->getArg(i));
+        }
+
+        return true;
+    }
+
+private:
+    static void Count(const FunctionDecl& callee, const unsigned index, const Expr* arg)
+    {
+        if(IsCopy(arg)) {
+            if(const auto* param = GetCanonicalParam(callee, index)) {
+                ++gCallerCopies[param];
+            }
+        }
+    }
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static uint64_t GetCallerCopies(const FunctionDecl& function, const unsigned index)
+{
+    if(not gCallerCopiesCounted) {
+        gCallerCopiesCounted = true;
+
+        CallerCopyCounter counter{};
+
+        // Only the declarations which get transformed, with --traverse-all-decls these are all of them.
+        for(auto* decl : function.getASTContext().getTraversalScope()) {
+            counter.TraverseDecl(decl);
+        }
+    }
+
+    const auto* param = GetCanonicalParam(function, index);
+
+    return param ? gCallerCopies.lookup(param) : 0;
+}
+//-----------------------------------------------------------------------------
+
+static bool IsMoveOrForward(const CallExpr& call)
+{
+    const auto* callee = call.getDirectCallee();
+
+    if(not callee or not callee->isInStdNamespace() or not callee->getIdentifier() or (1 != call.getNumArgs())) {
+        return false;
+    }
+
+    return (callee->getName() == "move") or (callee->getName() == "forward");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The parameter \p arg refers to, looking through \c std::move and \c std::forward.
+static const ParmVarDecl* GetReferencedParam(const Expr* arg)
+{
+    arg = arg->IgnoreImplicit()->IgnoreParens();
+
+    if(const auto* call = dyn_cast_or_null<CallExpr>(arg); call and IsMoveOrForward(*call)) {
+        return GetReferencedParam(call->getArg(0));
+    }
+
+    if(const auto* declRef = dyn_cast_or_null<DeclRefExpr>(arg)) {
+        return dyn_cast_or_null<ParmVarDecl>(declRef->getDecl());
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief Whether the body of a function copies or moves from one of its parameters.
+struct ParamUse
+{
+    bool copied{};
+    bool moved{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static void FindParamUse(const Stmt* stmt, const ParmVarDecl& param, ParamUse& use)
+{
+    if(not stmt) {
+        return;
+    }
+
+    const auto note = [&](const Expr* arg, const bool isMove) {
+        if(GetReferencedParam(arg) == &param) {
+            (isMove ? use.moved : use.copied) = true;
+        }
+    };
+
+    if(const auto* construct = dyn_cast<CXXConstructExpr>(stmt); construct and (1 <= construct->getNumArgs())) {
+        if(const auto* ctor = construct->getConstructor(); ctor->isCopyOrMoveConstructor()) {
+            note(construct->getArg(0), ctor->isMoveConstructor());
+        }
+
+    } else if(const auto* opCall = dyn_cast<CXXOperatorCallExpr>(stmt);
+              opCall and (OO_Equal == opCall->getOperator()) and (2 == opCall->getNumArgs())) {
+        if(const auto* method = dyn_cast_or_null<CXXMethodDecl>(opCall->getDirectCallee())) {
+            if(method->isCopyAssignmentOperator() or method->isMoveAssignmentOperator()) {
+                note(opCall->getArg(1), method->isMoveAssignmentOperator());
+            }
+        }
+    }
+
+    for(const auto* child : stmt->children()) {
+        FindParamUse(child, param, use);
+    }
+}
+//-----------------------------------------------------------------------------
+
+std::string GetPassByValueNote(const ParmVarDecl& param, const uint64_t threshold)
+{
+    const auto  type     = param.getType();
+    const auto* function = dyn_cast_or_null<FunctionDecl>(param.getDeclContext());
+
+    if(not function or not function->hasBody() or not type->isRecordType() or type->isDependentType() or
+       type->isIncompleteType()) {
+        return {};
+    }
+
+    const auto&    ctx = param.getASTContext();
+    const uint64_t size{static_cast<uint64_t>(ctx.getTypeSizeInChars(type).getQuantity())};
+    const bool     nonTrivial{not type.isTriviallyCopyableType(ctx)};
+
+    if(not nonTrivial and (size <= threshold)) {
+        return {};
+    }
+
+    ParamUse use{};
+    FindParamUse(function->getBody(), param, use);
+
+    // Moving from a type which is trivially copyable is still a copy.
+    if(use.moved and nonTrivial) {
+        return {};
+    }
+
+    std::string note{StrCat("by value: ", size, (1 == size) ? " byte" : " bytes")};
+
+    if(nonTrivial) {
+        note += ", non-trivially-copyable";
+    }
+
+    if(const uint64_t copies = GetCallerCopies(*function, param.getFunctionScopeIndex())) {
+        note += StrCat(", copied by ", copies, (1 == copies) ? " call" : " calls");
+    }
+
+    if(use.copied and nonTrivial) {
+        note += "; copied again inside, std::move it instead";
+    } else {
+        note += "; consider const&";
+    }
+
+    return note;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Collect the constructor calls with code in \p stmt.
+static void CollectConstructions(const Stmt* stmt, SmallVectorImpl<const CXXConstructExpr*>& constructions)
+{
+    if(not stmt) {
+        return;
+    }
+
+    if(const auto* construct = dyn_cast<CXXConstructExpr>(stmt);
+       construct and not construct->getConstructor()->isTrivial()) {
+        constructions.push_back(construct);
+    }
+
+    for(const auto* child : stmt->children()) {
+        CollectConstructions(child, constructions);
+    }
+}
+//-----------------------------------------------------------------------------
+
+std::string GetDefaultArgNote(const CXXDefaultArgExpr& arg, uint64_t& constructions)
+{
+    const auto* expr = arg.getExpr();
+    const auto& ctx  = arg.getParam()->getASTContext();
+
+    SmallVector<const CXXConstructExpr*, 2> constructExprs{};
+    CollectConstructions(expr, constructExprs);
+    constructions = constructExprs.size();
+
+    if(constructExprs.empty()) {
+        if(expr->isValueDependent() or expr->isEvaluatable(ctx)) {
+            return {};
+        }
+
+        return "default argument, evaluated at every call";
+    }
+
+    const auto  type   = constructExprs.front()->getType();
+    const auto* record = type->getAsCXXRecordDecl();
+    std::string note{StrCat("default argument, constructs ", GetName(type))};
+
+    if(not type->isIncompleteType()) {
+        note += StrCat(" of ", ctx.getTypeSizeInChars(type).getQuantity(), " bytes");
+    }
+
+    note += " at every call";
+
+    if(record and record->hasDefinition() and record->hasNonTrivialDestructor()) {
+        note += " and destroys it after the call";
+    }
+
+    if(const auto more = constructions - 1) {
+        note += StrCat(", ", more, (1 == more) ? " more construction" : " more constructions");
+    }
+
+    return note;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,50 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_PARAMETER_COST_H
+#define INSIGHTS_PARAMETER_COST_H
+
+#include <cstdint>
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CXXDefaultArgExpr;
+class ParmVarDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Forget the copies counted at the call sites, must be called for every new translation unit.
+void ResetParameterCostTranslationUnit();
+//-----------------------------------------------------------------------------
+
+/// \brief The note for the by-value parameter \p param of a function definition, see \c --show-pass-by-value.
+///
+/// A parameter of class type gets a note if its type is not trivially copyable or larger than \p threshold bytes. It
+/// tells the size, how many calls in the translation unit copy an argument into it and suggests either \c const& or,
+/// if the function copies the parameter itself, to move it instead. A parameter the function moves from is already a
+/// sink and gets no note.
+///
+/// \returns The note, empty if passing \p param by value is cheap.
+std::string GetPassByValueNote(const ParmVarDecl& param, const uint64_t threshold);
+//-----------------------------------------------------------------------------
+
+/// \brief The note for the default argument \p arg at a call site, see \c --show-default-args.
+///
+/// A default argument is evaluated again at every call which uses it. The note names the first object with a
+/// non-trivial constructor it constructs, with its size and whether the caller destroys it after the call. \p
+/// constructions gets the number of these objects.
+///
+/// \returns The note, empty for a constant which constructs nothing.
+std::string GetDefaultArgNote(const CXXDefaultArgExpr& arg, uint64_t& constructions);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_PARAMETER_COST_H */
@@ -0,0 +1,855 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Lex/HeaderSearch.h"
+#include "clang/Lex/Lexer.h"
+#include "clang/Lex/PPCallbacks.h"
+#include "clang/Lex/Preprocessor.h"
+#include "clang/Lex/PreprocessorOptions.h"
+#include "clang/Serialization/InMemoryModuleCache.h"
+#include "llvm/ADT/StringMap.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "ClangCompat.h"
+#include "DPrint.h"
+#include "InsightsPchCache.h"
+#include "InsightsProbes.h"
+#include "version.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif /* __linux__ */
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static PchCacheStats gPchCacheStats{};
+
+/// \brief Serializes the lookups of all threads, so that a PCH is built once even if many files need it at the same
+/// time.
+static std::mutex gPchCacheMutex{};
+//-----------------------------------------------------------------------------
+
+const PchCacheStats& GetPchCacheStats()
+{
+    return gPchCacheStats;
+}
+//-----------------------------------------------------------------------------
+
+std::vector<std::string> GetIncludePrefix(llvm::StringRef source)
+{
+    std::vector<std::string> includes{};
+    bool                     inBlockComment{};
+
+    while(not source.empty()) {
+        llvm::StringRef line{};
+        std::tie(line, source) = source.split('\n');
+        line                   = line.trim();
+
+        if(inBlockComment) {
+            if(const auto end = line.find("*/"); llvm::StringRef::npos != end) {
+                inBlockComment = false;
+                line           = line.drop_front(end + 2).trim();
+            } else {
+                continue;
+            }
+        }
+
+        if(line.empty() or line.startswith("//")) {
+            continue;
+
+        } else if(line.startswith("/*")) {
+            if(const auto end = line.find("*/", 2); llvm::StringRef::npos == end) {
+                inBlockComment = true;
+                continue;
+            } else if(not line.drop_front(end + 2).trim().empty()) {
+                break;
+            }
+
+            continue;
+        }
+
+        if(not line.consume_front("#")) {
+            break;
+        }
+
+        line = line.ltrim();
+
+        if(not line.consume_front("include")) {
+            break;
+        }
+
+        line = line.ltrim();
+
+        // Only system headers, local headers are more likely to change.
+        if(not line.startswith("<") or (llvm::StringRef::npos == line.find('>'))) {
+            break;
+        }
+
+        includes.emplace_back(line.take_until([](char c) { return '>' == c; }).str() + ">");
+    }
+
+    return includes;
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetCacheKey(llvm::StringRef                 header,
+                               const std::vector<std::string>& compilerArgs,
+                               const bool                      useLibCpp)
+{
+    llvm::MD5 hash{};
+
+    auto add = [&](llvm::StringRef str) {
+        hash.update(str);
+        // Separate the entries, otherwise "ab" "c" and "a" "bc" are the same.
+        hash.update(llvm::StringRef{"\0", 1});
+    };
+
+    add(header);
+
+    // All compiler arguments go into the key, as for example -D or -m64 invalidate a PCH as well as -std= does.
+    for(const auto& arg : compilerArgs) {
+        add(arg);
+    }
+
+    add(useLibCpp ? "libc++" : "");
+    add(INSIGHTS_CLANG_RESOURCE_DIR);
+    add(getClangFullRepositoryVersion());
+
+    llvm::MD5::MD5Result result{};
+    hash.final(result);
+
+    return result.digest().str().str();
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief Collects the headers of the user a PCH includes.
+class UserHeaderCollector : public PPCallbacks
+{
+public:
+    UserHeaderCollector(const SourceManager& sm, std::vector<const FileEntry*>& headers)
+    : mSm{sm}
+    , mHeaders{headers}
+    {
+    }
+
+    void FileChanged(SourceLocation             loc,
+                     FileChangeReason           reason,
+                     SrcMgr::CharacteristicKind fileType,
+                     FileID /*prevFID*/) override
+    {
+        if((EnterFile != reason) or (SrcMgr::C_User != fileType)) {
+            return;
+        }
+
+        const FileID fileId{mSm.getFileID(loc)};
+
+        // The predefines and the command line have no file entry.
+        if(const auto* fileEntry = mSm.getFileEntryForID(fileId); fileEntry and (fileId != mSm.getMainFileID())) {
+            mHeaders.push_back(fileEntry);
+        }
+    }
+
+private:
+    const SourceManager&           mSm;
+    std::vector<const FileEntry*>& mHeaders;
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Builds a PCH and tells whether it includes a header of the user without an include guard.
+///
+/// The main file includes the headers of the PCH again. A guarded header is skipped then, an unguarded one, like an
+/// X-macro header, is expanded a second time and breaks the code.
+class GuardedPchAction : public GeneratePCHAction
+{
+public:
+    explicit GuardedPchAction(bool& unguarded)
+    : mUnguarded{unguarded}
+    {
+    }
+
+protected:
+    bool BeginSourceFileAction(CompilerInstance& CI) override
+    {
+        CI.getPreprocessor().addPPCallbacks(std::make_unique<UserHeaderCollector>(CI.getSourceManager(), mHeaders));
+
+        return GeneratePCHAction::BeginSourceFileAction(CI);
+    }
+
+    void EndSourceFileAction() override
+    {
+        auto& headerSearch = getCompilerInstance().getPreprocessor().getHeaderSearchInfo();
+
+        mUnguarded = llvm::any_of(mHeaders, [&](const FileEntry* header) {
+            return not headerSearch.isFileMultipleIncludeGuarded(header);
+        });
+
+        GeneratePCHAction::EndSourceFileAction();
+    }
+
+private:
+    bool&                         mUnguarded;
+    std::vector<const FileEntry*> mHeaders{};
+};
+//-----------------------------------------------------------------------------
+
+class GuardedPchActionFactory : public tooling::FrontendActionFactory
+{
+public:
+    explicit GuardedPchActionFactory(bool& unguarded)
+    : mUnguarded{unguarded}
+    {
+    }
+
+#if IS_CLANG_NEWER_THAN(9)
+    std::unique_ptr<FrontendAction> create() override { return std::make_unique<GuardedPchAction>(mUnguarded); }
+#else
+    FrontendAction* create() override { return new GuardedPchAction(mUnguarded); }
+#endif
+
+private:
+    bool& mUnguarded;
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The file which marks that the PCH \p pchPath includes a header without an include guard, it is not built
+/// again.
+static std::string GetUnguardedMarkerPath(llvm::StringRef pchPath)
+{
+    llvm::SmallString<256> path{pchPath};
+    llvm::sys::path::replace_extension(path, ".unguarded");
+
+    return path.str().str();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief A file next to \p path to write to, which \ref MoveIntoPlace renames to \p path once it is complete.
+static bool CreateTemporaryFile(llvm::StringRef path, int& fd, llvm::SmallVectorImpl<char>& tmpPath)
+{
+    if(const auto ec = llvm::sys::fs::createUniqueFile(path + "-%%%%%%.tmp", fd, tmpPath)) {
+        Error("pch cache: cannot create a temporary file: %s\n", ec.message());
+        return false;
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+static bool MoveIntoPlace(llvm::StringRef tmpPath, llvm::StringRef path)
+{
+    // The rename is atomic, another process sees either no file or the complete one, never a partly written or, after
+    // a crash, a truncated one.
+    if(const auto ec = llvm::sys::fs::rename(tmpPath, path)) {
+        Error("pch cache: cannot rename '%s': %s\n", tmpPath, ec.message());
+        llvm::sys::fs::remove(tmpPath);
+        return false;
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Write \p content to \p path, which a concurrent build of another process may read.
+static bool WriteCacheFile(llvm::StringRef path, llvm::StringRef content)
+{
+    int                    fd{};
+    llvm::SmallString<256> tmpPath{};
+
+    if(not CreateTemporaryFile(path, fd, tmpPath)) {
+        return false;
+    }
+
+    {
+        llvm::raw_fd_ostream out{fd, /*shouldClose*/ true};
+        out << content;
+        out.close();
+
+        if(out.has_error()) {
+            Error("pch cache: cannot write '%s': %s\n", tmpPath.str(), out.error().message());
+            out.clear_error();
+            llvm::sys::fs::remove(tmpPath);
+            return false;
+        }
+    }
+
+    return MoveIntoPlace(tmpPath, path);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Build the PCH of \p header and put it into the cache as \p pchPath.
+static bool BuildPrecompiledHeader(llvm::StringRef                                   header,
+                                   llvm::StringRef                                   headerPath,
+                                   llvm::StringRef                                   pchPath,
+                                   const std::vector<std::string>&                   compilerArgs,
+                                   llvm::function_ref<void(tooling::ClangTool& tool)> addAdjusters)
+{
+    // The name of the header is its content, a PCH of another process may refer to it and its modification time.
+    if(not llvm::sys::fs::exists(headerPath) and not WriteCacheFile(headerPath, header)) {
+        return false;
+    }
+
+    int                    fd{};
+    llvm::SmallString<256> tmpPath{};
+
+    if(not CreateTemporaryFile(pchPath, fd, tmpPath)) {
+        return false;
+    }
+
+    // Clang writes the file by its name.
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+    std::vector<std::string> args{compilerArgs};
+    args.insert(args.end(), {"-x", "c++-header", "-o", tmpPath.str().str()});
+
+    tooling::FixedCompilationDatabase compilations{".", args};
+    tooling::ClangTool                tool{compilations, {headerPath.str()}};
+
+    // The default adjusters turn this into a syntax-only run and strip the output.
+    tool.clearArgumentsAdjusters();
+    addAdjusters(tool);
+
+    bool                    unguarded{};
+    GuardedPchActionFactory factory{unguarded};
+
+    if((0 != tool.run(&factory)) or unguarded) {
+        llvm::sys::fs::remove(tmpPath);
+
+        if(unguarded) {
+            WriteCacheFile(GetUnguardedMarkerPath(pchPath), "");
+        }
+
+        return false;
+    }
+
+    return MoveIntoPlace(tmpPath, pchPath);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Get the PCH for \p header from the cache, build it if it is not there.
+static std::string GetCachedPch(llvm::StringRef                                   cacheDir,
+                                llvm::StringRef                                   header,
+                                const std::vector<std::string>&                   compilerArgs,
+                                const bool                                        useLibCpp,
+                                llvm::function_ref<void(tooling::ClangTool& tool)> addAdjusters)
+{
+    const std::string key{GetCacheKey(header, compilerArgs, useLibCpp)};
+
+    std::lock_guard lock{gPchCacheMutex};
+
+    llvm::SmallString<256> pchPath{cacheDir};
+    llvm::sys::path::append(pchPath, key + ".pch");
+
+    if(llvm::sys::fs::exists(pchPath)) {
+        ++gPchCacheStats.hits;
+        ProbeCacheLookup("pch", true);
+        return pchPath.str().str();
+    }
+
+    ++gPchCacheStats.misses;
+    ProbeCacheLookup("pch", false);
+
+    if(llvm::sys::fs::exists(GetUnguardedMarkerPath(pchPath))) {
+        return {};
+    }
+
+    if(const auto ec = llvm::sys::fs::create_directories(cacheDir)) {
+        Error("pch cache: cannot create '%s': %s\n", cacheDir, ec.message());
+        ++gPchCacheStats.failures;
+        return {};
+    }
+
+    llvm::SmallString<256> headerPath{cacheDir};
+    llvm::sys::path::append(headerPath, key + ".h");
+
+    if(not BuildPrecompiledHeader(header, headerPath, pchPath, compilerArgs, addAdjusters)) {
+        ++gPchCacheStats.failures;
+        return {};
+    }
+
+    return pchPath.str().str();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The header which includes all of \p includes.
+static std::string GetIncludeHeader(const std::vector<std::string>& includes)
+{
+    std::string header{};
+    for(const auto& include : includes) {
+        header.append(StrCat("#include ", include, "\n"));
+    }
+
+    return header;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetPrecompiledHeader(llvm::StringRef                                   cacheDir,
+                                 llvm::StringRef                                   source,
+                                 const std::vector<std::string>&                   compilerArgs,
+                                 const bool                                        useLibCpp,
+                                 llvm::function_ref<void(tooling::ClangTool& tool)> addAdjusters)
+{
+    const auto includes = GetIncludePrefix(source);
+
+    if(includes.empty()) {
+        return {};
+    }
+
+    return GetCachedPch(cacheDir, GetIncludeHeader(includes), compilerArgs, useLibCpp, addAdjusters);
+}
+//-----------------------------------------------------------------------------
+
+std::string GetPrecompiledPreamble(llvm::StringRef                                   cacheDir,
+                                   llvm::StringRef                                   source,
+                                   llvm::StringRef                                   sourceDir,
+                                   const std::vector<std::string>&                   compilerArgs,
+                                   const bool                                        useLibCpp,
+                                   llvm::function_ref<void(tooling::ClangTool& tool)> addAdjusters)
+{
+    LangOptions langOpts{};
+    langOpts.CPlusPlus = true;
+
+    const auto bounds = Lexer::ComputePreamble(source, langOpts);
+
+    if(0 == bounds.Size) {
+        return {};
+    }
+
+    std::string preamble{source.take_front(bounds.Size).str()};
+
+    if(not bounds.PreambleEndsAtStartOfLine) {
+        preamble.append("\n");
+    }
+
+    // The preamble header lives in the cache directory, quoted includes must still be found next to the source.
+    std::vector<std::string> pchArgs{compilerArgs};
+    if(not sourceDir.empty()) {
+        pchArgs.push_back(StrCat("-iquote", sourceDir));
+    }
+
+    if(auto pchPath = GetCachedPch(cacheDir, preamble, pchArgs, useLibCpp, addAdjusters); not pchPath.empty()) {
+        return pchPath;
+    }
+
+    // A header of the preamble has no include guard, or the preamble does not build on its own. The system includes
+    // at the top still do.
+    return GetPrecompiledHeader(cacheDir, source, compilerArgs, useLibCpp, addAdjusters);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief How often the background thread of \ref EnablePchWarming looks at the counts.
+static constexpr std::chrono::seconds PCH_WARM_INTERVAL{5};
+
+/// \brief An include prefix needs at least that many requests to get a PCH, one-off prefixes do not pay off.
+static constexpr uint64_t PCH_WARM_MIN_REQUESTS{2};
+
+/// \brief After that many requests all counts are halved, the old traffic fades out.
+static constexpr uint64_t PCH_WARM_DECAY_REQUESTS{1024};
+
+/// \brief How long an evicted PCH stays on the disk. A request which got it before the eviction may still read it.
+static constexpr std::chrono::seconds PCH_EVICT_GRACE{60};
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief An include prefix seen by \ref GetWarmedPrecompiledHeader.
+struct WarmEntry
+{
+    enum class State
+    {
+        Cold,
+        Building,
+        Built,
+        Failed,
+    };
+
+    std::string              header{};
+    std::vector<std::string> compilerArgs{};
+    bool                     useLibCpp{};
+    uint64_t                 requests{};
+    State                    state{State::Cold};
+};
+
+/// \brief The files of an evicted PCH, removed once the grace period is over.
+struct EvictedPch
+{
+    std::string                           key{};
+    std::chrono::steady_clock::time_point removeAt{};
+};
+
+/// \brief The state of \ref EnablePchWarming, guarded by \c mutex.
+struct PchWarming
+{
+    std::mutex                 mutex{};
+    std::condition_variable    wakeUp{};
+    bool                       enabled{};
+    std::string                cacheDir{};
+    size_t                     topK{};
+    PchAdjusters               addAdjusters{};
+    llvm::StringMap<WarmEntry> entries{};  //!< By their key in the cache.
+    std::vector<EvictedPch>    evicted{};
+    uint64_t                   requests{};  //!< Since the last decay.
+};
+}  // namespace
+
+static PchWarming gPchWarming{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+/// \brief The path of the file \p key plus \p extension in the cache directory.
+static std::string GetCachePath(const std::string& key, llvm::StringRef extension)
+{
+    llvm::SmallString<256> path{gPchWarming.cacheDir};
+    llvm::sys::path::append(path, key + extension);
+
+    return path.str().str();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Build the PCH of \p entry, unless a previous run left it in the cache.
+static bool WarmPch(const std::string& key, const WarmEntry& entry)
+{
+    const std::string pchPath{GetCachePath(key, ".pch")};
+
+    if(llvm::sys::fs::exists(pchPath)) {
+        return true;
+    }
+
+    if(llvm::sys::fs::exists(GetUnguardedMarkerPath(pchPath))) {
+        return false;
+    }
+
+    auto addAdjusters = [&](tooling::ClangTool& tool) { gPchWarming.addAdjusters(tool, entry.useLibCpp); };
+
+    return BuildPrecompiledHeader(entry.header, GetCachePath(key, ".h"), pchPath, entry.compilerArgs, addAdjusters);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Lower the priority of the calling thread, so that the requests go first.
+static void LowerThreadPriority()
+{
+#ifdef __linux__
+    // On Linux the nice value belongs to the thread, not the process.
+    ::setpriority(PRIO_PROCESS, 0, 19);
+#endif /* __linux__ */
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The background thread of \ref EnablePchWarming, it runs as long as the server does.
+static void RunPchWarming()
+{
+    LowerThreadPriority();
+
+    std::unique_lock lock{gPchWarming.mutex};
+
+    while(true) {
+        gPchWarming.wakeUp.wait_for(lock, PCH_WARM_INTERVAL);
+
+        const auto now = std::chrono::steady_clock::now();
+
+        // Remove the evicted PCHs whose grace period is over.
+        llvm::erase_if(gPchWarming.evicted, [&](const EvictedPch& evicted) {
+            if(now < evicted.removeAt) {
+                return false;
+            }
+
+            // The include prefix may have come back meanwhile.
+            if(const auto it = gPchWarming.entries.find(evicted.key);
+               (gPchWarming.entries.end() != it) and (WarmEntry::State::Cold != it->second.state)) {
+                return true;
+            }
+
+            llvm::sys::fs::remove(GetCachePath(evicted.key, ".pch"));
+            llvm::sys::fs::remove(GetCachePath(evicted.key, ".h"));
+
+            return true;
+        });
+
+        std::vector<std::pair<uint64_t, std::string>> ranking{};
+        for(const auto& entry : gPchWarming.entries) {
+            if((PCH_WARM_MIN_REQUESTS <= entry.second.requests) and (WarmEntry::State::Failed != entry.second.state)) {
+                ranking.emplace_back(entry.second.requests, entry.first().str());
+            }
+        }
+
+        std::sort(ranking.begin(), ranking.end(), std::greater<>{});
+
+        if(ranking.size() > gPchWarming.topK) {
+            ranking.resize(gPchWarming.topK);
+        }
+
+        // Evict the PCHs which are no longer among the most frequent ones.
+        for(auto& entry : gPchWarming.entries) {
+            if(WarmEntry::State::Built != entry.second.state) {
+                continue;
+            }
+
+            if(llvm::none_of(ranking, [&](const auto& ranked) { return ranked.second == entry.first(); })) {
+                entry.second.state = WarmEntry::State::Cold;
+                gPchWarming.evicted.push_back({entry.first().str(), now + PCH_EVICT_GRACE});
+                ++gPchCacheStats.evicted;
+            }
+        }
+
+        // Build the missing ones, the most frequent first. The requests keep going meanwhile.
+        for(const auto& ranked : ranking) {
+            auto& entry = gPchWarming.entries[ranked.second];
+
+            if(WarmEntry::State::Cold != entry.state) {
+                continue;
+            }
+
+            entry.state       = WarmEntry::State::Building;
+            const auto toWarm = entry;
+
+            lock.unlock();
+            const bool built{WarmPch(ranked.second, toWarm)};
+            lock.lock();
+
+            // Only cold entries are dropped by the decay, this one is still there.
+            auto& warmed = gPchWarming.entries[ranked.second];
+            warmed.state = built ? WarmEntry::State::Built : WarmEntry::State::Failed;
+
+            if(built) {
+                ++gPchCacheStats.warmed;
+            } else {
+                ++gPchCacheStats.failures;
+            }
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+void EnablePchWarming(llvm::StringRef cacheDir, const size_t topK, PchAdjusters addAdjusters)
+{
+    {
+        std::lock_guard lock{gPchWarming.mutex};
+
+        gPchWarming.enabled      = true;
+        gPchWarming.cacheDir     = cacheDir.str();
+        gPchWarming.topK         = topK;
+        gPchWarming.addAdjusters = std::move(addAdjusters);
+    }
+
+    if(const auto ec = llvm::sys::fs::create_directories(cacheDir)) {
+        Error("pch cache: cannot create '%s': %s\n", cacheDir, ec.message());
+    }
+
+    std::thread{RunPchWarming}.detach();
+}
+//-----------------------------------------------------------------------------
+
+bool IsPchWarmingEnabled()
+{
+    std::lock_guard lock{gPchWarming.mutex};
+
+    return gPchWarming.enabled;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetWarmedPrecompiledHeader(llvm::StringRef                 source,
+                                       const std::vector<std::string>& compilerArgs,
+                                       const bool                      useLibCpp)
+{
+    auto includes = GetIncludePrefix(source);
+
+    if(includes.empty()) {
+        return {};
+    }
+
+    // <vector> <iostream> and <iostream> <vector> share a PCH, the system headers do not depend on their order.
+    llvm::sort(includes);
+    includes.erase(std::unique(includes.begin(), includes.end()), includes.end());
+
+    std::string       header{GetIncludeHeader(includes)};
+    const std::string key{GetCacheKey(header, compilerArgs, useLibCpp)};
+
+    std::lock_guard lock{gPchWarming.mutex};
+
+    if(PCH_WARM_DECAY_REQUESTS <= ++gPchWarming.requests) {
+        gPchWarming.requests = 0;
+
+        for(auto it = gPchWarming.entries.begin(); gPchWarming.entries.end() != it;) {
+            auto current = it++;
+            current->second.requests /= 2;
+
+            if((0 == current->second.requests) and (WarmEntry::State::Cold == current->second.state)) {
+                gPchWarming.entries.erase(current);
+            }
+        }
+    }
+
+    auto [it, inserted] = gPchWarming.entries.try_emplace(key);
+    auto& entry         = it->second;
+
+    if(inserted) {
+        entry.header       = std::move(header);
+        entry.compilerArgs = compilerArgs;
+        entry.useLibCpp    = useLibCpp;
+    }
+
+    // A new candidate need not wait for the next round.
+    if((PCH_WARM_MIN_REQUESTS == ++entry.requests) and (WarmEntry::State::Cold == entry.state)) {
+        gPchWarming.wakeUp.notify_one();
+    }
+
+    if(WarmEntry::State::Built == entry.state) {
+        ++gPchCacheStats.hits;
+        ProbeCacheLookup("pch", true);
+
+        return GetCachePath(key, ".pch");
+    }
+
+    ++gPchCacheStats.misses;
+    ProbeCacheLookup("pch", false);
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+void DropPrecompiledHeader(llvm::StringRef pchPath)
+{
+    {
+        std::lock_guard lock{gPchCacheMutex};
+
+        llvm::sys::fs::remove(pchPath);
+        ++gPchCacheStats.rejected;
+    }
+
+    // A warmed PCH is built again in the next round of the background thread.
+    std::lock_guard lock{gPchWarming.mutex};
+
+    if(const auto it = gPchWarming.entries.find(llvm::sys::path::stem(pchPath));
+       (gPchWarming.entries.end() != it) and (WarmEntry::State::Built == it->second.state)) {
+        it->second.state = WarmEntry::State::Cold;
+    }
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief A file mapped by \ref MapModuleFiles. The status tells whether the file was replaced since.
+struct MappedFile
+{
+    std::unique_ptr<llvm::MemoryBuffer> buffer{};
+    llvm::sys::TimePoint<>              modificationTime{};
+};
+}  // namespace
+
+/// \brief Guards \ref gMappedFiles, the threads of the server map files at the same time.
+static std::mutex gMappedFilesMutex{};
+
+static llvm::StringMap<MappedFile> gMappedFiles{};
+
+/// \brief The mappings of replaced files, another thread may still read from them.
+static std::vector<std::unique_ptr<llvm::MemoryBuffer>> gReplacedFiles{};
+//-----------------------------------------------------------------------------
+
+/// \brief The mapping of \p path, made on first use or when the file changed. Null, if it cannot be mapped.
+static const llvm::MemoryBuffer* GetMappedFile(llvm::StringRef path)
+{
+    llvm::sys::fs::file_status status{};
+
+    if(llvm::sys::fs::status(path, status) or not llvm::sys::fs::is_regular_file(status)) {
+        return nullptr;
+    }
+
+    std::lock_guard lock{gMappedFilesMutex};
+
+    auto& mapped = gMappedFiles[path];
+
+    if(mapped.buffer and (mapped.buffer->getBufferSize() == status.getSize()) and
+       (mapped.modificationTime == status.getLastModificationTime())) {
+        return mapped.buffer.get();
+    }
+
+    int fd{};
+    if(llvm::sys::fs::openFileForRead(path, fd)) {
+        return nullptr;
+    }
+
+    // Not volatile and without a null terminator, otherwise LLVM reads the file instead of mapping it.
+    auto buffer = llvm::MemoryBuffer::getOpenFile(
+        fd, path, status.getSize(), /*RequiresNullTerminator=*/false, /*IsVolatile=*/false);
+
+    // The mapping outlives the descriptor.
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+    if(not buffer) {
+        return nullptr;
+    }
+
+    if(mapped.buffer) {
+        gReplacedFiles.push_back(std::move(mapped.buffer));
+    }
+
+    mapped = {std::move(buffer.get()), status.getLastModificationTime()};
+
+    ++gPchCacheStats.mapped;
+    gPchCacheStats.mappedBytes += status.getSize();
+
+    return mapped.buffer.get();
+}
+//-----------------------------------------------------------------------------
+
+void MapModuleFiles(CompilerInstance& CI)
+{
+    auto& moduleCache = CI.getModuleCache();
+
+    auto add = [&](llvm::StringRef path) {
+        if(moduleCache.lookupPCM(path)) {
+            return;
+        }
+
+        if(const auto* mapped = GetMappedFile(path)) {
+            // The module cache gets a view, the mapping stays with this process.
+            moduleCache.addPCM(
+                path, llvm::MemoryBuffer::getMemBuffer(mapped->getMemBufferRef(), /*RequiresNullTerminator=*/false));
+        }
+    };
+
+    if(const auto& pch = CI.getPreprocessorOpts().ImplicitPCHInclude; not pch.empty()) {
+        add(pch);
+    }
+
+    if(not CI.getLangOpts().Modules or not CI.hasPreprocessor()) {
+        return;
+    }
+
+    // The directory of this configuration, the module cache path plus the hash clang appends.
+    const auto cachePath = CI.getPreprocessor().getHeaderSearchInfo().getModuleCachePath();
+
+    if(cachePath.empty()) {
+        return;
+    }
+
+    std::error_code ec{};
+    for(llvm::sys::fs::directory_iterator it{cachePath, ec}, end{}; not ec and (it != end); it.increment(ec)) {
+        if(llvm::sys::path::extension(it->path()) == ".pcm") {
+            add(it->path());
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,126 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_PCH_CACHE_H
+#define INSIGHTS_PCH_CACHE_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CompilerInstance;
+}
+
+namespace clang::tooling {
+class ClangTool;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Counters of the precompiled-header cache, reported with \c --stats.
+struct PchCacheStats
+{
+    unsigned hits{};
+    unsigned misses{};
+    unsigned failures{};
+    unsigned mapped{};       //!< PCH and module files mapped by \ref MapModuleFiles.
+    uint64_t mappedBytes{};
+    unsigned warmed{};    //!< PCHs built in the background, see \ref EnablePchWarming.
+    unsigned evicted{};   //!< PCHs removed, as their include prefix was no longer among the most frequent ones.
+    unsigned rejected{};  //!< PCHs removed, as the run which used them failed, see \ref DropPrecompiledHeader.
+};
+//-----------------------------------------------------------------------------
+
+const PchCacheStats& GetPchCacheStats();
+//-----------------------------------------------------------------------------
+
+/// \brief Collect the leading block of `#include <...>` directives of \p source.
+///
+/// Blank lines and comments are skipped, the first other line ends the prefix.
+std::vector<std::string> GetIncludePrefix(llvm::StringRef source);
+//-----------------------------------------------------------------------------
+
+/// \brief Get a precompiled header for the include prefix of \p source, build it if it is not yet in the cache.
+///
+/// The cache in \p cacheDir is keyed by the include list, the compiler arguments, the use of libc++, the clang
+/// resource directory and the clang revision. \p addAdjusters is called to install the same argument adjusters the
+/// main run uses, otherwise clang rejects the PCH.
+///
+/// \returns The path to the PCH or an empty string, if there is no include prefix or building the PCH failed.
+std::string GetPrecompiledHeader(llvm::StringRef                                   cacheDir,
+                                 llvm::StringRef                                   source,
+                                 const std::vector<std::string>&                   compilerArgs,
+                                 const bool                                        useLibCpp,
+                                 llvm::function_ref<void(tooling::ClangTool& tool)> addAdjusters);
+//-----------------------------------------------------------------------------
+
+/// \brief Get a precompiled header for the preamble of \p source, build it if it is not yet in the cache.
+///
+/// In contrast to \ref GetPrecompiledHeader this uses the whole preamble as clang computes it: all the leading
+/// preprocessor directives and comments, not only the system includes. Quoted includes are searched in \p sourceDir.
+/// As long as the preamble does not change, only the remainder of the main file is parsed from scratch.
+///
+/// \returns The path to the PCH or an empty string, if there is no preamble or building the PCH failed.
+std::string GetPrecompiledPreamble(llvm::StringRef                                   cacheDir,
+                                   llvm::StringRef                                   source,
+                                   llvm::StringRef                                   sourceDir,
+                                   const std::vector<std::string>&                   compilerArgs,
+                                   const bool                                        useLibCpp,
+                                   llvm::function_ref<void(tooling::ClangTool& tool)> addAdjusters);
+//-----------------------------------------------------------------------------
+
+/// \brief Installs the argument adjusters of the main run for \p useLibCpp, see \ref EnablePchWarming.
+using PchAdjusters = std::function<void(tooling::ClangTool& tool, const bool useLibCpp)>;
+
+/// \brief Build the PCHs of the \p topK most frequent include prefixes in \p cacheDir on a background thread.
+///
+/// From now on \ref GetWarmedPrecompiledHeader counts the include prefixes of the requests. The prefixes are sorted,
+/// so the order of the includes does not matter, and kept apart by the compiler arguments and the use of libc++. A
+/// thread with the lowest priority periodically builds the PCHs of the most frequent ones and removes those which
+/// dropped out. The counts decay, so that the PCHs follow the current traffic. \p addAdjusters is the same as for
+/// \ref GetPrecompiledHeader.
+void EnablePchWarming(llvm::StringRef cacheDir, const size_t topK, PchAdjusters addAdjusters);
+bool IsPchWarmingEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Count the include prefix of \p source and get its PCH, if the background thread built it already.
+///
+/// Never builds a PCH, a request does not wait for one.
+///
+/// \returns The path to the PCH or an empty string.
+std::string GetWarmedPrecompiledHeader(llvm::StringRef                 source,
+                                       const std::vector<std::string>& compilerArgs,
+                                       const bool                      useLibCpp);
+//-----------------------------------------------------------------------------
+
+/// \brief Remove \p pchPath from the cache, after a run which used it failed.
+///
+/// Clang rejects a PCH which does not fit the run, and a preamble which includes a header without an include guard
+/// breaks the code when the main file includes it again. The caller transforms the file once more without the PCH.
+/// Should the PCH be fine and the code be wrong, the next request builds it again.
+void DropPrecompiledHeader(llvm::StringRef pchPath);
+//-----------------------------------------------------------------------------
+
+/// \brief Let \p CI read its PCH and, with \c -fmodules, the files of its module cache from read-only mappings.
+///
+/// On its own clang reads these files into a private copy, as another compiler could rewrite them meanwhile. The
+/// caches only ever replace a file as a whole, so a mapping is safe. Each file is mapped once per process and all
+/// processes mapping it share its pages, the workers of \c --worker-pool hold a single copy of a PCH between them.
+/// Must be called before clang loads the PCH, from \c BeginSourceFileAction.
+void MapModuleFiles(CompilerInstance& CI);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_PCH_CACHE_H */
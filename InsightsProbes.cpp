@@ -0,0 +1,90 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "InsightsProbes.h"
+//-----------------------------------------------------------------------------
+
+#ifdef INSIGHTS_USDT
+
+// With semaphores the tracer tells us, whether it attached to a probe. Only then are the arguments computed.
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+//-----------------------------------------------------------------------------
+
+#define INSIGHTS_PROBE_SEMAPHORE(name)                                                                                 \
+    __extension__ unsigned short insights_##name##_semaphore __attribute__((unused))                                   \
+    __attribute__((section(".probes")))
+
+extern "C" {
+INSIGHTS_PROBE_SEMAPHORE(phase__begin);
+INSIGHTS_PROBE_SEMAPHORE(phase__end);
+INSIGHTS_PROBE_SEMAPHORE(handler__entry);
+INSIGHTS_PROBE_SEMAPHORE(handler__exit);
+INSIGHTS_PROBE_SEMAPHORE(cache__lookup);
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+void ProbePhaseBegin(const TimePhase phase)
+{
+    if(insights_phase__begin_semaphore) {
+        DTRACE_PROBE1(insights, phase__begin, GetTimePhaseName(phase));
+    }
+}
+//-----------------------------------------------------------------------------
+
+void ProbePhaseEnd(const TimePhase phase)
+{
+    if(insights_phase__end_semaphore) {
+        DTRACE_PROBE1(insights, phase__end, GetTimePhaseName(phase));
+    }
+}
+//-----------------------------------------------------------------------------
+
+void ProbeCacheLookup(const char* cache, const bool hit)
+{
+    if(insights_cache__lookup_semaphore) {
+        const int isHit{hit};
+        DTRACE_PROBE2(insights, cache__lookup, cache, isHit);
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The kind of the first \ref Decl bound in \p result, like \c CXXRecord.
+static const char* GetBoundDeclKind(const ast_matchers::MatchFinder::MatchResult& result)
+{
+    for(const auto& node : result.Nodes.getMap()) {
+        if(const auto* decl = node.second.get<Decl>()) {
+            return decl->getDeclKindName();
+        }
+    }
+
+    return "";
+}
+//-----------------------------------------------------------------------------
+
+HandlerProbeScope::HandlerProbeScope(const char* handler, const ast_matchers::MatchFinder::MatchResult& result)
+: mHandler{handler}
+{
+    if(insights_handler__entry_semaphore) {
+        DTRACE_PROBE2(insights, handler__entry, mHandler, GetBoundDeclKind(result));
+    }
+}
+//-----------------------------------------------------------------------------
+
+HandlerProbeScope::~HandlerProbeScope()
+{
+    if(insights_handler__exit_semaphore) {
+        DTRACE_PROBE1(insights, handler__exit, mHandler);
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_USDT */
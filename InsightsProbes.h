@@ -0,0 +1,61 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_PROBES_H
+#define INSIGHTS_PROBES_H
+
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+
+#include "InsightsTimeReport.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief USDT probes for \c bpftrace, \c perf and friends, built with \c -DINSIGHTS_USDT=On.
+///
+/// The provider is \c insights. Without \c INSIGHTS_USDT all of them are empty inline functions. With it, an unused
+/// probe is a \c nop and its arguments are only computed, if a tracer attached to it.
+///
+/// - \c phase__begin, \c phase__end: the name of a \ref TimePhase. \c EndSourceFileAction is applying the rewrites and
+///   flushing the output.
+/// - \c handler__entry: the name of the handler and the kind of the first bound \ref Decl, \c handler__exit: the name.
+/// - \c cache__lookup: the name of the cache and \c 1 for a hit, \c 0 for a miss.
+#ifdef INSIGHTS_USDT
+void ProbePhaseBegin(const TimePhase phase);
+void ProbePhaseEnd(const TimePhase phase);
+void ProbeCacheLookup(const char* cache, const bool hit);
+#else
+inline void ProbePhaseBegin(const TimePhase) {}
+inline void ProbePhaseEnd(const TimePhase) {}
+inline void ProbeCacheLookup(const char*, const bool) {}
+#endif
+//-----------------------------------------------------------------------------
+
+/// \brief Fire \c handler__entry on construction and \c handler__exit on destruction.
+class HandlerProbeScope
+{
+public:
+#ifdef INSIGHTS_USDT
+    HandlerProbeScope(const char* handler, const ast_matchers::MatchFinder::MatchResult& result);
+    ~HandlerProbeScope();
+#else
+    HandlerProbeScope(const char*, const ast_matchers::MatchFinder::MatchResult&) {}
+#endif
+
+    HandlerProbeScope(const HandlerProbeScope&) = delete;
+    HandlerProbeScope& operator=(const HandlerProbeScope&) = delete;
+
+#ifdef INSIGHTS_USDT
+private:
+    const char* mHandler;
+#endif
+};
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_PROBES_H */
@@ -0,0 +1,409 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "llvm/ADT/StringSwitch.h"
+
+#include "InsightsHelpers.h"
+#include "InsightsRangesPipeline.h"
+#include "InsightsStrCat.h"
+
+#include <algorithm>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+enum class ViewKind
+{
+    Filter,
+    Transform,
+    Take,
+    Drop,
+    TakeWhile,
+    DropWhile,
+    Reverse,
+    Join,
+    Elements,
+    Common,
+    Split,
+    Other,
+};
+//-----------------------------------------------------------------------------
+
+/// \brief One adaptor of a pipeline, like the \c filter_view in \c xs \c | \c views::filter(pred).
+struct ViewLayer
+{
+    ViewKind    kind{};
+    std::string name{};      //!< The name of the view without \c _view.
+    std::string argument{};  //!< The name of the function of the view, the index of \c elements, otherwise empty.
+    bool        baseSizedRandomAccess{};  //!< The base of the view is a sized random access range.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The views of a pipeline from the innermost to the outermost one, together with the range they start from.
+struct Pipeline
+{
+    std::vector<ViewLayer> layers{};
+    std::string            leaf{};
+    std::string            leafIterator{};
+    bool                   leafSizedRandomAccess{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The view of the standard library \p type is, if it is one of \c std::ranges.
+static const ClassTemplateSpecializationDecl* GetRangesView(const QualType& type)
+{
+    const auto* spec =
+        dyn_cast_or_null<ClassTemplateSpecializationDecl>(type.getNonReferenceType()->getAsCXXRecordDecl());
+
+    if(not spec or not spec->isInStdNamespace() or not spec->getIdentifier()) {
+        return nullptr;
+    }
+
+    // libc++ puts the namespace ranges into its inline namespace std::__1.
+    const auto* ns = dyn_cast<NamespaceDecl>(spec->getDeclContext());
+
+    if(not ns or not ns->getIdentifier() or (ns->getName() != "ranges")) {
+        return nullptr;
+    }
+
+    return (spec->getName().endswith("_view") or (spec->getName() == "subrange")) ? spec : nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the range \p type knows its size and offers random access, like a \c std::vector.
+static bool IsSizedRandomAccess(const QualType& type)
+{
+    const auto base = type.getNonReferenceType();
+
+    if(base->isConstantArrayType()) {
+        return true;
+    }
+
+    const auto* record = base->getAsCXXRecordDecl();
+
+    if(not record or not record->isInStdNamespace() or not record->getIdentifier()) {
+        return false;
+    }
+
+    return llvm::StringSwitch<bool>(record->getName())
+        .Cases("vector", "array", "deque", "basic_string", "basic_string_view", "span", true)
+        .Default(false);
+}
+//-----------------------------------------------------------------------------
+
+static ViewLayer GetLayer(const ClassTemplateSpecializationDecl& spec)
+{
+    const auto name = spec.getName();
+    const auto kind = llvm::StringSwitch<ViewKind>(name)
+                          .Case("filter_view", ViewKind::Filter)
+                          .Case("transform_view", ViewKind::Transform)
+                          .Case("take_view", ViewKind::Take)
+                          .Case("drop_view", ViewKind::Drop)
+                          .Case("take_while_view", ViewKind::TakeWhile)
+                          .Case("drop_while_view", ViewKind::DropWhile)
+                          .Case("reverse_view", ViewKind::Reverse)
+                          .Cases("join_view", "join_with_view", ViewKind::Join)
+                          .Case("elements_view", ViewKind::Elements)
+                          .Case("common_view", ViewKind::Common)
+                          .Cases("split_view", "lazy_split_view", ViewKind::Split)
+                          .Default(ViewKind::Other);
+
+    ViewLayer layer{kind, name.endswith("_view") ? name.drop_back(StringRef{"_view"}.size()).str() : name.str()};
+
+    const auto& args = spec.getTemplateArgs();
+
+    if(2 > args.size()) {
+        return layer;
+    }
+
+    if(TemplateArgument::Type == args[1].getKind()) {
+        if((ViewKind::Filter == kind) or (ViewKind::Transform == kind) or (ViewKind::TakeWhile == kind) or
+           (ViewKind::DropWhile == kind)) {
+            layer.argument = GetName(args[1].getAsType());
+        }
+
+    } else if((TemplateArgument::Integral == args[1].getKind()) and (ViewKind::Elements == kind)) {
+        layer.argument = ToString(args[1].getAsIntegral());
+    }
+
+    return layer;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Set the range \p type a pipeline starts from.
+static void SetLeaf(Pipeline& pipeline, const QualType& type)
+{
+    pipeline.leaf                  = GetName(type);
+    pipeline.leafSizedRandomAccess = IsSizedRandomAccess(type);
+
+    if(const auto* array = type.getNonReferenceType()->getAsArrayTypeUnsafe()) {
+        pipeline.leafIterator = StrCat(GetName(array->getElementType()), " *");
+
+    } else {
+        pipeline.leafIterator = StrCat(GetName(type.getNonReferenceType().getUnqualifiedType()), "::iterator");
+    }
+}
+//-----------------------------------------------------------------------------
+
+static Pipeline GetPipeline(QualType type)
+{
+    Pipeline pipeline{};
+
+    while(const auto* spec = GetRangesView(type)) {
+        const auto  name = spec->getName();
+        const auto& args = spec->getTemplateArgs();
+
+        // The views which only refer to or own a range are where a pipeline starts.
+        if(((name == "ref_view") or (name == "owning_view")) and (0 < args.size()) and
+           (TemplateArgument::Type == args[0].getKind())) {
+            SetLeaf(pipeline, args[0].getAsType());
+            break;
+
+        } else if((name == "iota_view") and (2 == args.size()) and (TemplateArgument::Type == args[0].getKind())) {
+            const auto* bound = args[1].getAsType()->getAsCXXRecordDecl();
+
+            pipeline.leaf                  = StrCat("iota(", GetName(args[0].getAsType()), ")");
+            pipeline.leafIterator          = "iota_view::iterator";
+            pipeline.leafSizedRandomAccess = not(bound and bound->getIdentifier() and
+                                                 (bound->getName() == "unreachable_sentinel_t"));
+            break;
+
+        } else if((0 == args.size()) or (TemplateArgument::Type != args[0].getKind()) or
+                  llvm::StringSwitch<bool>(name)
+                      .Cases("empty_view", "single_view", "subrange", "basic_istream_view", true)
+                      .Default(false)) {
+            pipeline.leaf         = name.str();
+            pipeline.leafIterator = StrCat(name, "::iterator");
+            break;
+        }
+
+        pipeline.layers.push_back(GetLayer(*spec));
+        type = args[0].getAsType();
+
+        if(not GetRangesView(type)) {
+            SetLeaf(pipeline, type);
+            break;
+        }
+    }
+
+    std::reverse(pipeline.layers.begin(), pipeline.layers.end());
+
+    bool sizedRandomAccess{pipeline.leafSizedRandomAccess};
+
+    for(auto& layer : pipeline.layers) {
+        layer.baseSizedRandomAccess = sizedRandomAccess;
+
+        sizedRandomAccess = sizedRandomAccess and
+                            ((ViewKind::Transform == layer.kind) or (ViewKind::Take == layer.kind) or
+                             (ViewKind::Drop == layer.kind) or (ViewKind::Reverse == layer.kind) or
+                             (ViewKind::Elements == layer.kind) or (ViewKind::Common == layer.kind));
+    }
+
+    return pipeline;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The iterator \p layer wraps around the iterator of its base, empty if it uses the one of the base.
+static std::string GetIterator(const ViewLayer& layer)
+{
+    switch(layer.kind) {
+        case ViewKind::Take: return layer.baseSizedRandomAccess ? "" : "counted_iterator";
+        case ViewKind::Common: return layer.baseSizedRandomAccess ? "" : "common_iterator";
+        case ViewKind::Reverse: return "reverse_iterator";
+        case ViewKind::Drop:
+        case ViewKind::TakeWhile:
+        case ViewKind::DropWhile: return "";
+        default: return StrCat(layer.name, "_view::iterator");
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief What \c ++it of \p layer does on top of advancing its base.
+static std::string GetIncrement(const ViewLayer& layer)
+{
+    switch(layer.kind) {
+        case ViewKind::Filter: return StrCat("filter calls ", layer.argument, " on each element until it accepts one");
+        case ViewKind::Take: return layer.baseSizedRandomAccess ? "" : "take counts down the remaining elements";
+        case ViewKind::TakeWhile: return StrCat("take_while calls ", layer.argument, " on the next element to stop");
+        case ViewKind::Reverse: return "reverse steps its base backwards";
+        case ViewKind::Join: return "join moves on to the next inner range at the end of one";
+        case ViewKind::Split: return "split searches the next delimiter";
+        default: return "";
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief What \c *it of \p layer does with the element of its base.
+static std::string GetDereference(const ViewLayer& layer)
+{
+    switch(layer.kind) {
+        case ViewKind::Transform: return StrCat("transform calls ", layer.argument, " on *base, on each *it again");
+        case ViewKind::Elements: return StrCat("elements takes get<", layer.argument, "> of *base");
+        default: return "";
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The work the first \c begin() of \p layer does and caches for the next calls.
+static std::string GetCachedBegin(const ViewLayer& layer)
+{
+    switch(layer.kind) {
+        case ViewKind::Filter: return "filter searches the first accepted element";
+        case ViewKind::Drop: return layer.baseSizedRandomAccess ? "" : "drop skips the first elements";
+        case ViewKind::DropWhile: return StrCat("drop_while calls ", layer.argument, " up to the first rejected element");
+        case ViewKind::Reverse: return layer.baseSizedRandomAccess ? "" : "reverse walks to the end of its base";
+        case ViewKind::Split: return "split searches the first delimiter";
+        default: return "";
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Append \p part to \p line, separated by \p separator from what is there already.
+static void AppendPart(std::string& line, const std::string& part, StringRef separator = ", ")
+{
+    if(not part.empty()) {
+        line.append(StrCat(line.empty() ? "" : separator, part));
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The size of the iterator \c begin() of the outermost view \p view returns, 0 if it is not known.
+static uint64_t GetIteratorSize(const ClassTemplateSpecializationDecl& view)
+{
+    auto& ctx = view.getASTContext();
+
+    for(const auto* decl : view.lookup(&ctx.Idents.get("begin"))) {
+        const auto* method = dyn_cast_or_null<CXXMethodDecl>(decl->getAsFunction());
+
+        if(not method or method->isConst()) {
+            continue;
+        }
+
+        // A deduced return type is known once begin() got instantiated, by the range-based for-loop for example.
+        const auto type = method->getReturnType();
+
+        if(type->isUndeducedType() or type->isDependentType() or type->isIncompleteType()) {
+            continue;
+        }
+
+        return static_cast<uint64_t>(ctx.getTypeSizeInChars(type).getQuantity());
+    }
+
+    return 0;
+}
+//-----------------------------------------------------------------------------
+
+std::vector<std::string> GetRangesPipelineNote(const VarDecl& var)
+{
+    const auto* outermost = GetRangesView(var.getType());
+
+    // A copy or reference of a pipeline built elsewhere already got its note.
+    if(not outermost or not var.hasInit() or isa<DeclRefExpr>(var.getInit()->IgnoreParenImpCasts())) {
+        return {};
+    }
+
+    const auto pipeline = GetPipeline(var.getType());
+
+    if(pipeline.layers.empty()) {
+        return {};
+    }
+
+    std::vector<std::string> lines{};
+
+    std::string written{pipeline.leaf};
+
+    for(const auto& layer : pipeline.layers) {
+        written.append(StrCat(" | ", layer.name));
+
+        if(not layer.argument.empty()) {
+            written.append(StrCat((ViewKind::Elements == layer.kind) ? "<" : "(",
+                                  layer.argument,
+                                  (ViewKind::Elements == layer.kind) ? ">" : ")"));
+        }
+    }
+
+    lines.push_back(StrCat("ranges pipeline: ", written));
+
+    // The iterators from the outermost one inwards.
+    std::string iterator{pipeline.leafIterator};
+
+    for(const auto& layer : pipeline.layers) {
+        if(const auto wrapper = GetIterator(layer); not wrapper.empty()) {
+            iterator = StrCat(wrapper, " { ", iterator, " }");
+        }
+    }
+
+    if(const auto size = GetIteratorSize(*outermost); 0 != size) {
+        iterator.append(StrCat(", ", size, " bytes"));
+    }
+
+    lines.push_back(StrCat("iterator: ", iterator));
+
+    std::string increment{};
+    std::string dereference{};
+    std::string cachedBegin{};
+
+    for(auto it = pipeline.layers.rbegin(); it != pipeline.layers.rend(); ++it) {
+        AppendPart(increment, GetIncrement(*it));
+        AppendPart(dereference, GetDereference(*it));
+        AppendPart(cachedBegin, GetCachedBegin(*it), "; ");
+    }
+
+    AppendPart(increment, StrCat("the ", pipeline.leafIterator, " advances"));
+
+    lines.push_back(StrCat("++it: ", increment));
+    lines.push_back(StrCat("*it: ", dereference.empty() ? StrCat("*", pipeline.leafIterator) : dereference));
+
+    if(not cachedBegin.empty()) {
+        lines.push_back(StrCat("begin(), cached after the first call: ", cachedBegin));
+    }
+
+    // A predicate above a transform dereferences through it, *it calls the function once more for the elements which
+    // pass.
+    std::string perElement{};
+
+    for(size_t i = 0; i < pipeline.layers.size(); ++i) {
+        const auto& layer = pipeline.layers[i];
+
+        if(ViewKind::Transform != layer.kind) {
+            continue;
+        }
+
+        std::string predicates{};
+        size_t      runs{1};
+
+        for(size_t j = i + 1; j < pipeline.layers.size(); ++j) {
+            if((ViewKind::Filter == pipeline.layers[j].kind) or (ViewKind::TakeWhile == pipeline.layers[j].kind)) {
+                AppendPart(predicates, pipeline.layers[j].name, " and ");
+                ++runs;
+            }
+        }
+
+        if(1 < runs) {
+            AppendPart(perElement,
+                       StrCat(layer.argument,
+                              " runs ",
+                              runs,
+                              " times for each element which passes ",
+                              predicates,
+                              ", a handwritten loop runs it once"),
+                       "; ");
+        }
+    }
+
+    lines.push_back(StrCat("per element: ", perElement.empty() ? "the same calls as a handwritten loop" : perElement));
+
+    return lines;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,33 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_RANGES_PIPELINE_H
+#define INSIGHTS_RANGES_PIPELINE_H
+
+#include <string>
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class VarDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The lines of the note for \p var, if it holds a pipeline of \c std::ranges views built by its initializer,
+/// see \c --show-ranges-pipeline. Empty for any other variable.
+///
+/// The note flattens the nested view type into the pipeline as written and the iterators wrapped into each other. It
+/// tells what \c ++it and \c *it of the outermost iterator do per element, which views cache their \c begin() and how
+/// often the function of a \c transform runs per element, compared to a handwritten loop.
+std::vector<std::string> GetRangesPipelineNote(const VarDecl& var);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_RANGES_PIPELINE_H */
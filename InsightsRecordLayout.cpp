@@ -0,0 +1,820 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/AST/VTableBuilder.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/MathExtras.h"
+
+#include <algorithm>
+
+#include "ClangCompat.h"
+#include "Insights.h"
+#include "InsightsFindings.h"
+#include "InsightsHelpers.h"
+#include "InsightsOnce.h"
+#include "InsightsRecordLayout.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static constexpr uint64_t CHAR_BITS{8};
+//-----------------------------------------------------------------------------
+
+/// \brief A gap of \p bits as bytes, or as bits if it is not a whole number of bytes.
+static std::string FormatGap(const uint64_t bits)
+{
+    if(0 != (bits % CHAR_BITS)) {
+        return StrCat(bits, (1 == bits) ? " bit" : " bits");
+    }
+
+    const uint64_t bytes{bits / CHAR_BITS};
+
+    return StrCat(bytes, (1 == bytes) ? " byte" : " bytes");
+}
+//-----------------------------------------------------------------------------
+
+bool RecordLayoutAnnotator::HasLayout(const RecordDecl& record)
+{
+    return not record.isInvalidDecl() and record.isCompleteDefinition() and not record.isDependentType();
+}
+//-----------------------------------------------------------------------------
+
+RecordLayoutAnnotator::RecordLayoutAnnotator(const RecordDecl& record)
+: mRecord{record}
+, mLayout{record.getASTContext().getASTRecordLayout(&record)}
+{
+    const auto* cxxRecordDecl = dyn_cast_or_null<CXXRecordDecl>(&record);
+
+    if(not cxxRecordDecl) {
+        return;
+    }
+
+    const auto& ctx = record.getASTContext();
+
+    // The fields start after the vptr and the data of the non-virtual bases. An empty base takes no space, the first
+    // field may share its address.
+    if(mLayout.hasOwnVFPtr()) {
+        mDataEnd = ctx.getTargetInfo().getPointerWidth(0);
+    }
+
+    for(const auto& base : cxxRecordDecl->bases()) {
+        const auto* baseDecl = base.getType()->getAsCXXRecordDecl();
+
+        if(base.isVirtual() or not baseDecl or baseDecl->isEmpty()) {
+            continue;
+        }
+
+        const auto& baseLayout = ctx.getASTRecordLayout(baseDecl);
+        const auto  baseEnd    = mLayout.getBaseClassOffset(baseDecl) + baseLayout.getDataSize();
+
+        mDataEnd = std::max(mDataEnd, static_cast<uint64_t>(ctx.toBits(baseEnd)));
+    }
+
+    mFieldsBegin = mDataEnd;
+}
+//-----------------------------------------------------------------------------
+
+void RecordLayoutAnnotator::InsertBeforeField(OutputFormatHelper& outputFormatHelper, const FieldDecl& field)
+{
+    const auto&    ctx = mRecord.getASTContext();
+    const uint64_t offset{mLayout.getFieldOffset(field.getFieldIndex())};
+    const uint64_t size{field.isBitField() ? field.getBitWidthValue(ctx) : ctx.getTypeSize(field.getType())};
+
+    if(offset > mDataEnd) {
+        const auto gap = FormatGap(offset - mDataEnd);
+
+        outputFormatHelper.AppendNewLine("/* ", gap, " padding */");
+        RecordFinding(field.getLocation(),
+                      FindingCategory::Padding,
+                      FindingSeverity::Note,
+                      (offset - mDataEnd) / CHAR_BITS,
+                      StrCat(gap, " padding before ", field.getName()));
+    }
+
+    const uint64_t offsetBytes{offset / CHAR_BITS};
+    const uint64_t cacheLineSize{GetInsightsOptions().cacheLineSize};
+    const uint64_t cacheLine{offsetBytes / cacheLineSize};
+
+    if(cacheLine > mCacheLine) {
+        outputFormatHelper.AppendNewLine(
+            "/* --- cache line ", cacheLine, " (offset ", cacheLine * cacheLineSize, ") --- */");
+        mCacheLine = cacheLine;
+    }
+
+    if(field.isBitField()) {
+        outputFormatHelper.Append(
+            "/* offset: ", offsetBytes, " + ", offset % CHAR_BITS, " bits, size: ", size, " bits");
+    } else {
+        outputFormatHelper.Append("/* offset: ", offsetBytes, ", size: ", size / CHAR_BITS);
+    }
+
+    const uint64_t cacheLineBits{cacheLineSize * CHAR_BITS};
+
+    if((0 != size) and ((offset / cacheLineBits) != ((offset + size - 1) / cacheLineBits))) {
+        outputFormatHelper.Append(", straddles a cache line");
+    }
+
+    // Each copy of the closure copies such a capture as well, possibly with an allocation.
+    if(const auto* cxxRecordDecl = dyn_cast_or_null<CXXRecordDecl>(&mRecord);
+       cxxRecordDecl and cxxRecordDecl->isLambda() and not field.getType()->isReferenceType() and
+       not field.getType().isTriviallyCopyableType(ctx)) {
+        outputFormatHelper.Append(", by-value capture of a non-trivially-copyable type");
+    }
+
+    outputFormatHelper.Append(" */ ");
+
+    mDataEnd = std::max(mDataEnd, offset + size);
+    mFields.push_back(&field);
+}
+//-----------------------------------------------------------------------------
+
+void RecordLayoutAnnotator::InsertFooter(OutputFormatHelper& outputFormatHelper) const
+{
+    const auto&    ctx = mRecord.getASTContext();
+    const uint64_t size{static_cast<uint64_t>(ctx.toBits(mLayout.getSize()))};
+
+    // The virtual bases go behind the fields, what follows the fields is not only padding then.
+    const auto* cxxRecordDecl = dyn_cast_or_null<CXXRecordDecl>(&mRecord);
+    const bool  hasVirtualBases{cxxRecordDecl and (0 != cxxRecordDecl->getNumVBases())};
+
+    if(not hasVirtualBases and not mRecord.field_empty() and (size > mDataEnd)) {
+        const auto gap = FormatGap(size - mDataEnd);
+
+        outputFormatHelper.AppendNewLine("/* ", gap, " tail padding */");
+        RecordFinding(mRecord.getLocation(),
+                      FindingCategory::Padding,
+                      FindingSeverity::Note,
+                      (size - mDataEnd) / CHAR_BITS,
+                      StrCat(gap, " tail padding"));
+    }
+
+    InsertEmptySubobjects(outputFormatHelper);
+
+    outputFormatHelper.AppendNewLine("/* sizeof: ",
+                                     mLayout.getSize().getQuantity(),
+                                     ", alignof: ",
+                                     mLayout.getAlignment().getQuantity(),
+                                     " */");
+
+    InsertReorderSuggestion(outputFormatHelper);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p type is a class without data, which needs no space of its own.
+static bool IsEmptyClass(const QualType& type)
+{
+    const auto* record = type->getAsCXXRecordDecl();
+
+    return record and record->isEmpty();
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief An empty base or an empty \c [[no_unique_address]] member, which can share the address of other subobjects.
+struct EmptySubobject
+{
+    std::string    name{};
+    uint64_t       offset{};  //!< In bytes.
+    SourceLocation loc{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+void RecordLayoutAnnotator::InsertEmptySubobjects(OutputFormatHelper& outputFormatHelper) const
+{
+    const auto* cxxRecordDecl = dyn_cast_or_null<CXXRecordDecl>(&mRecord);
+
+    // The captures of a lambda are not up to the user, the members of a union share their address anyway.
+    if(not cxxRecordDecl or cxxRecordDecl->isLambda() or mRecord.isUnion()) {
+        return;
+    }
+
+    const auto&                          ctx = mRecord.getASTContext();
+    const uint64_t                       size{static_cast<uint64_t>(mLayout.getSize().getQuantity())};
+    llvm::SmallVector<EmptySubobject, 4> subobjects{};
+
+    for(const auto& base : cxxRecordDecl->bases()) {
+        if(const auto* baseDecl = base.getType()->getAsCXXRecordDecl();
+           not base.isVirtual() and baseDecl and baseDecl->isEmpty()) {
+            subobjects.push_back({StrCat("empty base ", GetName(base.getType())),
+                                  static_cast<uint64_t>(mLayout.getBaseClassOffset(baseDecl).getQuantity()),
+                                  base.getBeginLoc()});
+        }
+    }
+
+    // The end of the vptr, the non-empty bases and the fields which need space of their own, in bytes.
+    uint64_t dataEnd{llvm::alignTo(mFieldsBegin, CHAR_BITS) / CHAR_BITS};
+
+    for(auto it = mFields.begin(); it != mFields.end(); ++it) {
+        const auto*    field = *it;
+        const uint64_t offset{mLayout.getFieldOffset(field->getFieldIndex())};
+
+        if(field->isBitField()) {
+            dataEnd = std::max(dataEnd, llvm::alignTo(offset + field->getBitWidthValue(ctx), CHAR_BITS) / CHAR_BITS);
+            continue;
+        }
+
+        const uint64_t offsetBytes{offset / CHAR_BITS};
+
+        if(not IsEmptyClass(field->getType())) {
+            dataEnd = std::max(
+                dataEnd, offsetBytes + static_cast<uint64_t>(ctx.getTypeSizeInChars(field->getType()).getQuantity()));
+            continue;
+        }
+
+        if(field->hasAttr<NoUniqueAddressAttr>()) {
+            subobjects.push_back({StrCat("empty member ", GetName(*field)), offsetBytes, field->getLocation()});
+            continue;
+        }
+
+        // An empty member without [[no_unique_address]] takes a byte and the padding up to the next field.
+        const auto     next = std::next(it);
+        const uint64_t end{(next != mFields.end()) ? (mLayout.getFieldOffset((*next)->getFieldIndex()) / CHAR_BITS)
+                                                   : size};
+        const uint64_t cost{std::max(end, offsetBytes + 1) - offsetBytes};
+
+        outputFormatHelper.AppendNewLine("/* empty member ",
+                                         GetName(*field),
+                                         " without [[no_unique_address]]: takes ",
+                                         FormatGap(cost * CHAR_BITS),
+                                         " with its padding */");
+        RecordFinding(field->getLocation(),
+                      FindingCategory::Padding,
+                      FindingSeverity::Note,
+                      cost,
+                      StrCat("empty member ", GetName(*field), " without [[no_unique_address]]"));
+
+        dataEnd = std::max(dataEnd, offsetBytes + 1);
+    }
+
+    // A class has at least one byte, the first empty subobject in an otherwise empty class is free.
+    uint64_t       end{std::max<uint64_t>(dataEnd, 1)};
+    uint64_t       costs{};
+    const uint64_t wasted{size - std::min(size, llvm::alignTo(end, mLayout.getAlignment().getQuantity()))};
+
+    std::stable_sort(subobjects.begin(), subobjects.end(), [](const auto& a, const auto& b) {
+        return a.offset < b.offset;
+    });
+
+    for(auto it = subobjects.begin(); it != subobjects.end(); ++it) {
+        // Two subobjects of the same type must have different addresses. Where clang found none inside the data, it
+        // placed the subobject behind it.
+        if(it->offset < end) {
+            outputFormatHelper.AppendNewLine("/* ", it->name, ": takes no space */");
+            continue;
+        }
+
+        uint64_t cost{it->offset + 1 - end};
+        end = it->offset + 1;
+
+        // The last one pays for the alignment of the class.
+        if(std::none_of(std::next(it), subobjects.end(), [&](const auto& other) { return other.offset >= end; })) {
+            cost = std::max(cost, wasted - std::min(wasted, costs));
+        }
+
+        costs += cost;
+
+        outputFormatHelper.AppendNewLine("/* ",
+                                         it->name,
+                                         " at offset ",
+                                         it->offset,
+                                         ": needs an address of its own, costs ",
+                                         FormatGap(cost * CHAR_BITS),
+                                         " */");
+        RecordFinding(it->loc,
+                      FindingCategory::Padding,
+                      FindingSeverity::Note,
+                      cost,
+                      StrCat(it->name, " needs an address of its own"));
+    }
+}
+//-----------------------------------------------------------------------------
+
+void RecordLayoutAnnotator::InsertFunctionBufferNote(OutputFormatHelper& outputFormatHelper,
+                                                     const uint64_t      bufferSize) const
+{
+    const auto size  = static_cast<uint64_t>(mLayout.getSize().getQuantity());
+    const auto align = static_cast<uint64_t>(mLayout.getAlignment().getQuantity());
+
+    if((size <= bufferSize) and (align <= bufferSize)) {
+        outputFormatHelper.AppendNewLine("/* fits into a std::function buffer of ", bufferSize, " bytes */");
+        return;
+    }
+
+    outputFormatHelper.AppendNewLine(
+        "/* exceeds a std::function buffer of ", bufferSize, " bytes, std::function allocates it on the heap */");
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief Fields which move together: a single field or a run of adjacent bit-fields, which share storage units.
+struct FieldBlock
+{
+    llvm::SmallVector<const FieldDecl*, 2> fields{};
+    uint64_t                               size{};   //!< In bytes.
+    uint64_t                               align{};  //!< In bytes.
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The size in bytes of a class with \p blocks in this order, starting at \p begin and aligned to \p align.
+static uint64_t
+GetSizeForOrder(const llvm::SmallVectorImpl<FieldBlock>& blocks, const uint64_t begin, const uint64_t align)
+{
+    uint64_t end{begin};
+
+    for(const auto& block : blocks) {
+        end = llvm::alignTo(end, block.align) + block.size;
+    }
+
+    return std::max(llvm::alignTo(end, align), align);
+}
+//-----------------------------------------------------------------------------
+
+void RecordLayoutAnnotator::InsertReorderSuggestion(OutputFormatHelper& outputFormatHelper) const
+{
+    // The order of the captures of a lambda is not up to the user, that of a packed class does not matter.
+    if(mRecord.isUnion() or mRecord.hasAttr<PackedAttr>() or (2 > mFields.size())) {
+        return;
+    }
+
+    if(const auto* cxxRecordDecl = dyn_cast_or_null<CXXRecordDecl>(&mRecord);
+       cxxRecordDecl and cxxRecordDecl->isLambda()) {
+        return;
+    }
+
+    const auto&                       ctx = mRecord.getASTContext();
+    llvm::SmallVector<FieldBlock, 16> blocks{};
+    uint64_t                          bitRunBegin{};
+    uint64_t                          bitRunEnd{};
+
+    for(const auto* field : mFields) {
+        const uint64_t offset{mLayout.getFieldOffset(field->getFieldIndex())};
+        const uint64_t align{static_cast<uint64_t>(ctx.getDeclAlign(field).getQuantity())};
+
+        if(field->isBitField()) {
+            const uint64_t width{field->getBitWidthValue(ctx)};
+
+            // A zero-width bit-field forces the next one into a new storage unit, moving it changes the meaning.
+            if(0 == width) {
+                return;
+            }
+
+            if(blocks.empty() or not blocks.back().fields.back()->isBitField()) {
+                blocks.push_back({});
+                bitRunBegin = llvm::alignDown(offset, CHAR_BITS);
+                bitRunEnd   = offset;
+            }
+
+            bitRunEnd = std::max(bitRunEnd, offset + width);
+
+            auto& block = blocks.back();
+            block.fields.push_back(field);
+            block.size  = llvm::alignTo(bitRunEnd - bitRunBegin, CHAR_BITS) / CHAR_BITS;
+            block.align = std::max(block.align, align);
+
+            continue;
+        }
+
+        FieldBlock block{};
+        block.fields.push_back(field);
+        block.align = align;
+
+#if IS_CLANG_NEWER_THAN(8)
+        // An empty [[no_unique_address]] member takes no space.
+        if(not field->isZeroSize(ctx))
+#endif
+        {
+            block.size = static_cast<uint64_t>(ctx.getTypeSizeInChars(field->getType()).getQuantity());
+        }
+
+        blocks.push_back(block);
+    }
+
+    const uint64_t begin{llvm::alignTo(mFieldsBegin, CHAR_BITS) / CHAR_BITS};
+    const uint64_t align{static_cast<uint64_t>(mLayout.getAlignment().getQuantity())};
+    const uint64_t declaredSize{GetSizeForOrder(blocks, begin, align)};
+
+    // The largest alignment first leaves no holes, as the size of each type is a multiple of its alignment.
+    std::stable_sort(blocks.begin(), blocks.end(), [](const auto& a, const auto& b) { return a.align > b.align; });
+
+    const uint64_t reorderedSize{GetSizeForOrder(blocks, begin, align)};
+    const uint64_t size{static_cast<uint64_t>(mLayout.getSize().getQuantity())};
+
+    // Compare against the same model for the declared order. Where it misjudges the real layout, it does not suggest.
+    if((reorderedSize >= declaredSize) or (reorderedSize >= size)) {
+        return;
+    }
+
+    outputFormatHelper.AppendNewLine(
+        "/* reordered, sizeof: ", reorderedSize, ", saves ", FormatGap((size - reorderedSize) * CHAR_BITS));
+
+    for(const auto& block : blocks) {
+        for(const auto* field : block.fields) {
+            outputFormatHelper.Append("   ", GetTypeNameAsParameter(field->getType(), GetName(*field)));
+
+            if(field->isBitField()) {
+                outputFormatHelper.Append(":", field->getBitWidthValue(ctx));
+            }
+
+            outputFormatHelper.AppendSemiNewLine();
+        }
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p field synchronizes threads, see \ref InsertFalseSharingReport.
+static bool IsSyncMember(const FieldDecl& field)
+{
+    for(const auto* annotate : field.specific_attrs<AnnotateAttr>()) {
+        const auto& annotations = GetInsightsOptions().syncAnnotations;
+
+        if(std::find(annotations.begin(), annotations.end(), annotate->getAnnotation()) != annotations.end()) {
+            return true;
+        }
+    }
+
+    const auto* record = field.getType()->getBaseElementTypeUnsafe()->getAsCXXRecordDecl();
+
+    if(not record or not record->isInStdNamespace() or not record->getIdentifier()) {
+        return false;
+    }
+
+    return llvm::StringSwitch<bool>(record->getName())
+        .Cases("atomic", "atomic_flag", "mutex", "timed_mutex", "recursive_mutex", "recursive_timed_mutex", true)
+        .Cases("shared_mutex", "shared_timed_mutex", "condition_variable", "condition_variable_any", true)
+        .Default(false);
+}
+//-----------------------------------------------------------------------------
+
+void InsertFalseSharingReport(OutputFormatHelper& outputFormatHelper, const RecordDecl& record)
+{
+    const auto&    ctx    = record.getASTContext();
+    const auto&    layout = ctx.getASTRecordLayout(&record);
+    const uint64_t cacheLineBits{GetInsightsOptions().cacheLineSize * CHAR_BITS};
+
+    struct Member
+    {
+        const FieldDecl* field;
+        uint64_t         firstLine;
+        uint64_t         lastLine;
+        bool             isSync;
+    };
+
+    llvm::SmallVector<Member, 16> members{};
+
+    for(const auto* field : record.fields()) {
+        const uint64_t offset{layout.getFieldOffset(field->getFieldIndex())};
+        const uint64_t size{field->isBitField() ? field->getBitWidthValue(ctx) : ctx.getTypeSize(field->getType())};
+
+        if(0 == size) {
+            continue;
+        }
+
+        members.push_back({field, offset / cacheLineBits, (offset + size - 1) / cacheLineBits, IsSyncMember(*field)});
+    }
+
+    llvm::SmallVector<std::string, 4> lines{};
+    llvm::SmallVector<std::string, 4> suggestions{};
+
+    for(const auto& member : members) {
+        if(not member.isSync) {
+            continue;
+        }
+
+        std::string sharing{};
+
+        for(const auto& other : members) {
+            if((&other != &member) and (other.firstLine <= member.lastLine) and (member.firstLine <= other.lastLine)) {
+                sharing += StrCat(sharing.empty() ? "" : ", ", GetName(*other.field));
+            }
+        }
+
+        if(sharing.empty()) {
+            continue;
+        }
+
+        lines.push_back(
+            StrCat("   ", GetName(*member.field), " (cache line ", member.firstLine, ") shares it with ", sharing));
+
+        // The first field of the class starts a cache line already, the class gets the alignment with the others.
+        if(&member != &members.front()) {
+            suggestions.push_back(GetName(*member.field));
+        }
+    }
+
+    if(lines.empty()) {
+        return;
+    }
+
+    outputFormatHelper.AppendNewLine(
+        "/* false sharing risk with cache lines of ", GetInsightsOptions().cacheLineSize, " bytes");
+
+    for(const auto& line : lines) {
+        outputFormatHelper.AppendNewLine(line);
+    }
+
+    if(not suggestions.empty()) {
+        outputFormatHelper.Append("   consider alignas(std::hardware_destructive_interference_size) for");
+
+        for(const auto& suggestion : suggestions) {
+            outputFormatHelper.Append(" ", suggestion);
+        }
+
+        outputFormatHelper.AppendNewLine();
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The share of all accesses in percent the hot fields of \ref InsertHotColdSplit take at least.
+static constexpr uint64_t HOT_ACCESS_PERCENT{90};
+//-----------------------------------------------------------------------------
+
+void InsertHotColdSplit(OutputFormatHelper& outputFormatHelper, const RecordDecl& record)
+{
+    // The members of a union share their address, those of a packed class have no holes to save.
+    if(record.isUnion() or record.hasAttr<PackedAttr>() or not record.getIdentifier() or record.field_empty()) {
+        return;
+    }
+
+    const auto&       ctx    = record.getASTContext();
+    const auto&       layout = ctx.getASTRecordLayout(&record);
+    const auto&       counts = GetInsightsOptions().fieldAccessCounts;
+    const std::string prefix{StrCat(record.getQualifiedNameAsString(), "::")};
+
+    struct ProfiledField
+    {
+        FieldBlock block;
+        uint64_t   count;
+    };
+
+    llvm::SmallVector<ProfiledField, 16> fields{};
+    uint64_t                             total{};
+    bool                                 isProfiled{};
+
+    for(const auto* field : record.fields()) {
+        // Adjacent bit-fields share their storage units, they cannot move one by one.
+        if(field->isBitField()) {
+            return;
+        }
+
+        uint64_t count{};
+
+        if(const auto it = counts.find(StrCat(prefix, GetName(*field))); counts.end() != it) {
+            count      = it->second;
+            isProfiled = true;
+        }
+
+        ProfiledField profiled{{}, count};
+        profiled.block.fields.push_back(field);
+        profiled.block.size  = static_cast<uint64_t>(ctx.getTypeSizeInChars(field->getType()).getQuantity());
+        profiled.block.align = static_cast<uint64_t>(ctx.getDeclAlign(field).getQuantity());
+
+        fields.push_back(profiled);
+        total += count;
+    }
+
+    if(not isProfiled or (0 == total) or (2 > fields.size())) {
+        return;
+    }
+
+    std::stable_sort(fields.begin(), fields.end(), [](const auto& a, const auto& b) { return a.count > b.count; });
+
+    size_t   hotEnd{};
+    uint64_t hotCount{};
+
+    while((hotEnd < fields.size()) and ((hotCount * 100) < (total * HOT_ACCESS_PERCENT))) {
+        hotCount += fields[hotEnd].count;
+        ++hotEnd;
+    }
+
+    if(hotEnd == fields.size()) {
+        return;
+    }
+
+    // Within each part the largest alignment comes first, which leaves no holes.
+    auto sortByAlign = [&](const size_t first, const size_t last) {
+        std::stable_sort(fields.begin() + first, fields.begin() + last, [](const auto& a, const auto& b) {
+            return a.block.align > b.block.align;
+        });
+    };
+
+    sortByAlign(0, hotEnd);
+    sortByAlign(hotEnd, fields.size());
+
+    const auto     pointerSize  = static_cast<uint64_t>(ctx.getTypeSizeInChars(ctx.VoidPtrTy).getQuantity());
+    const auto     pointerAlign = static_cast<uint64_t>(ctx.getTypeAlignInChars(ctx.VoidPtrTy).getQuantity());
+    const uint64_t begin{layout.getFieldOffset(record.field_begin()->getFieldIndex()) / CHAR_BITS};
+
+    // The bases and the vptr stay, so does their alignment.
+    uint64_t hotAlign{(0 != begin) ? static_cast<uint64_t>(layout.getAlignment().getQuantity()) : pointerAlign};
+
+    llvm::SmallVector<FieldBlock, 16> hotBlocks{};
+
+    for(size_t i = 0; i < hotEnd; ++i) {
+        hotBlocks.push_back(fields[i].block);
+        hotAlign = std::max(hotAlign, fields[i].block.align);
+    }
+
+    hotBlocks.push_back({{}, pointerSize, pointerAlign});
+
+    const uint64_t size{static_cast<uint64_t>(layout.getSize().getQuantity())};
+    const uint64_t hotSize{GetSizeForOrder(hotBlocks, begin, hotAlign)};
+
+    if(hotSize >= size) {
+        return;
+    }
+
+    const std::string coldName{StrCat(record.getName(), "Cold")};
+    const uint64_t    cacheLineSize{GetInsightsOptions().cacheLineSize};
+
+    auto insertFields = [&](const size_t first, const size_t last) {
+        for(size_t i = first; i < last; ++i) {
+            const auto* field = fields[i].block.fields.front();
+            const auto  count = fields[i].count;
+
+            outputFormatHelper.AppendNewLine("   ",
+                                             GetTypeNameAsParameter(field->getType(), GetName(*field)),
+                                             ";  // ",
+                                             count,
+                                             (1 == count) ? " access" : " accesses");
+        }
+    };
+
+    outputFormatHelper.AppendNewLine(
+        "/* hot/cold split, the hot fields take ", (hotCount * 100) / total, "% of the accesses");
+    outputFormatHelper.AppendNewLine("struct ", record.getName());
+    outputFormatHelper.AppendNewLine("{");
+    insertFields(0, hotEnd);
+    outputFormatHelper.AppendNewLine("   ", coldName, "* cold;");
+    outputFormatHelper.AppendNewLine("};  // sizeof: ",
+                                     hotSize,
+                                     " instead of ",
+                                     size,
+                                     ", cache lines: ",
+                                     llvm::alignTo(hotSize, cacheLineSize) / cacheLineSize,
+                                     " instead of ",
+                                     llvm::alignTo(size, cacheLineSize) / cacheLineSize);
+    outputFormatHelper.AppendNewLine();
+    outputFormatHelper.AppendNewLine("struct ", coldName);
+    outputFormatHelper.AppendNewLine("{");
+    insertFields(hotEnd, fields.size());
+    outputFormatHelper.AppendNewLine("};");
+    outputFormatHelper.AppendNewLine("*/");
+    outputFormatHelper.AppendNewLine();
+}
+//-----------------------------------------------------------------------------
+
+void InsertVPtr(OutputFormatHelper& outputFormatHelper, const CXXRecordDecl& record)
+{
+    if(not record.isDynamicClass() or not RecordLayoutAnnotator::HasLayout(record)) {
+        return;
+    }
+
+    // A class with a primary base shares the vptr of that base.
+    if(record.getASTContext().getASTRecordLayout(&record).hasOwnVFPtr()) {
+        outputFormatHelper.AppendNewLine("// void ** __vptr;");
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The name of \p method with its parameter types, like \c A::f(int) \c const.
+static std::string GetSlotName(const CXXMethodDecl& method)
+{
+    std::string name{method.getQualifiedNameAsString()};
+    name.append("(");
+
+    OnceFalse needsComma{};
+    for(const auto* param : method.parameters()) {
+        if(needsComma) {
+            name.append(", ");
+        }
+
+        name.append(GetName(param->getType()));
+    }
+
+    name.append(")");
+
+    if(method.isConst()) {
+        name.append(" const");
+    }
+
+    return name;
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetThunkNote(const ThunkInfo& thunk)
+{
+    std::string note{", thunk:"};
+
+    if(not thunk.This.isEmpty()) {
+        note.append(StrCat(" this ", thunk.This.NonVirtual));
+
+        if(0 != thunk.This.Virtual.Itanium.VCallOffsetOffset) {
+            note.append(StrCat(" and vcall offset at ", thunk.This.Virtual.Itanium.VCallOffsetOffset));
+        }
+    }
+
+    if(not thunk.Return.isEmpty()) {
+        note.append(StrCat(" return ", thunk.Return.NonVirtual));
+
+        if(0 != thunk.Return.Virtual.Itanium.VBaseOffsetOffset) {
+            note.append(StrCat(" and vbase offset at ", thunk.Return.Virtual.Itanium.VBaseOffsetOffset));
+        }
+    }
+
+    return note;
+}
+//-----------------------------------------------------------------------------
+
+void InsertVTableLayout(OutputFormatHelper& outputFormatHelper, const CXXRecordDecl& record)
+{
+    if(not record.isDynamicClass() or not RecordLayoutAnnotator::HasLayout(record)) {
+        return;
+    }
+
+    auto* vtableContext = dyn_cast_or_null<ItaniumVTableContext>(record.getASTContext().getVTableContext());
+
+    if(not vtableContext) {
+        outputFormatHelper.AppendNewLine("/* vtable: only the Itanium C++ ABI is supported */");
+        return;
+    }
+
+    const auto& layout = vtableContext->getVTableLayout(&record);
+
+    llvm::DenseMap<uint64_t, ThunkInfo> thunks{};
+    for(const auto& [index, thunk] : layout.vtable_thunks()) {
+        thunks[index] = thunk;
+    }
+
+    outputFormatHelper.AppendNewLine("/* vtable of ", GetName(record));
+
+    uint64_t index{};
+    for(const auto& component : layout.vtable_components()) {
+        outputFormatHelper.Append("   [", index, "] ");
+
+        switch(component.getKind()) {
+            case VTableComponent::CK_VCallOffset:
+                outputFormatHelper.Append("vcall offset: ", component.getVCallOffset().getQuantity());
+                break;
+            case VTableComponent::CK_VBaseOffset:
+                outputFormatHelper.Append("vbase offset: ", component.getVBaseOffset().getQuantity());
+                break;
+            case VTableComponent::CK_OffsetToTop:
+                outputFormatHelper.Append("offset to top: ", component.getOffsetToTop().getQuantity());
+                break;
+            case VTableComponent::CK_RTTI:
+                outputFormatHelper.Append("RTTI: ", GetName(*component.getRTTIDecl()));
+                break;
+            case VTableComponent::CK_FunctionPointer:
+            case VTableComponent::CK_CompleteDtorPointer:
+            case VTableComponent::CK_DeletingDtorPointer:
+            case VTableComponent::CK_UnusedFunctionPointer: {
+                const auto* method = component.getFunctionDecl();
+                outputFormatHelper.Append(GetSlotName(*method));
+
+                if(method->isPure()) {
+                    outputFormatHelper.Append(" = 0");
+                }
+
+                if(VTableComponent::CK_CompleteDtorPointer == component.getKind()) {
+                    outputFormatHelper.Append(", complete");
+
+                } else if(VTableComponent::CK_DeletingDtorPointer == component.getKind()) {
+                    outputFormatHelper.Append(", deleting");
+
+                } else if(VTableComponent::CK_UnusedFunctionPointer == component.getKind()) {
+                    outputFormatHelper.Append(", unused");
+                }
+
+                if(const auto thunk = thunks.find(index); thunks.end() != thunk) {
+                    outputFormatHelper.Append(GetThunkNote(thunk->second));
+                }
+
+                break;
+            }
+        }
+
+        outputFormatHelper.AppendNewLine();
+        ++index;
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_RECORD_LAYOUT_H
+#define INSIGHTS_RECORD_LAYOUT_H
+
+#include "clang/AST/Decl.h"
+#include "llvm/ADT/SmallVector.h"
+
+#include <cstdint>
+
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class ASTRecordLayout;
+class CXXRecordDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Annotates the fields of a class with the layout clang computed for it, see \c --show-layout.
+///
+/// Each field gets its offset and size as a comment in front of it. Holes between fields, the tail padding and the
+/// start of each cache line of \c --cache-line-size bytes are shown as comments of their own. The fields must be
+/// passed in declaration order. If another order of the fields makes the class smaller, it is suggested in the footer.
+/// The footer also tells for each empty base and empty member whether it shares the address of another subobject or
+/// what it costs.
+/// The captures of a lambda which copy a type that is not trivially copyable are flagged.
+class RecordLayoutAnnotator
+{
+public:
+    explicit RecordLayoutAnnotator(const RecordDecl& record);
+
+    /// \brief Whether \p record has a layout at all. Dependent, invalid and incomplete classes have none.
+    static bool HasLayout(const RecordDecl& record);
+
+    /// \brief Insert the padding before \p field, a marker if it starts a new cache line and its offset and size.
+    void InsertBeforeField(OutputFormatHelper& outputFormatHelper, const FieldDecl& field);
+
+    /// \brief Insert the tail padding, the size and alignment of the class and the suggested field order, if any.
+    void InsertFooter(OutputFormatHelper& outputFormatHelper) const;
+
+    /// \brief Insert whether the closure fits into the small buffer of \c std::function of \p bufferSize bytes, see
+    /// \c --show-closure-layout.
+    void InsertFunctionBufferNote(OutputFormatHelper& outputFormatHelper, const uint64_t bufferSize) const;
+
+private:
+    /// \brief Insert where the empty base optimization applied to the empty bases and members and where it failed.
+    void InsertEmptySubobjects(OutputFormatHelper& outputFormatHelper) const;
+
+    /// \brief Insert the field order which minimizes the size of the class, if it is smaller than the current one.
+    void InsertReorderSuggestion(OutputFormatHelper& outputFormatHelper) const;
+
+    const RecordDecl&                       mRecord;
+    const ASTRecordLayout&                  mLayout;
+    uint64_t                                mFieldsBegin{};  //!< Behind the vptr and the bases, in bits.
+    uint64_t                                mDataEnd{};      //!< The end of the data seen so far, in bits.
+    uint64_t                                mCacheLine{};    //!< The cache line the last field started in.
+    llvm::SmallVector<const FieldDecl*, 16> mFields{};       //!< All fields seen so far, in declaration order.
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Insert the cache lines which a synchronization member of \p record shares with other fields, see \c
+/// --show-false-sharing.
+///
+/// Synchronization members are \c std::atomic, \c std::atomic_flag, the mutexes and condition variables of the
+/// standard library and fields annotated with one of \c --sync-annotation. A thread which writes one of them evicts
+/// the cache line from the other cores, which slows down the threads using the other fields in it. The members to move
+/// to a cache line of their own are suggested. Fields of the bases are not looked at.
+void InsertFalseSharingReport(OutputFormatHelper& outputFormatHelper, const RecordDecl& record);
+//-----------------------------------------------------------------------------
+
+/// \brief Insert the split of \p record into its hot and its cold fields as a comment, see \c --field-profile.
+///
+/// The fields which take most of the accesses of the profile stay in \p record, sorted by their alignment, the others
+/// move to a second class behind a pointer. The split is only suggested if it makes \p record smaller. Unions, packed
+/// classes and classes with bit-fields are not split.
+void InsertHotColdSplit(OutputFormatHelper& outputFormatHelper, const RecordDecl& record);
+//-----------------------------------------------------------------------------
+
+/// \brief Insert the implicit vptr of \p record as a comment, if it has one of its own, see \c --show-vtable.
+void InsertVPtr(OutputFormatHelper& outputFormatHelper, const CXXRecordDecl& record);
+//-----------------------------------------------------------------------------
+
+/// \brief Insert the slots of the vtable of the polymorphic class \p record as a comment, see \c --show-vtable.
+///
+/// The secondary vtables of a multiple or virtual inheritance follow the primary one, each one starts with its offset
+/// to the top of the object. Slots which need a thunk show its adjustment of \c this and of the returned pointer.
+/// Only the Itanium C++ ABI is supported.
+void InsertVTableLayout(OutputFormatHelper& outputFormatHelper, const CXXRecordDecl& record);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_RECORD_LAYOUT_H */
@@ -0,0 +1,299 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "InsightsRemoteCache.h"
+#include "DPrint.h"
+#include "InsightsProbes.h"
+
+#include <atomic>
+#include <chrono>
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif /* _WIN32 */
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static std::atomic<uint64_t> gRemoteHits{};
+static std::atomic<uint64_t> gRemoteMisses{};
+static std::atomic<uint64_t> gRemoteFailures{};
+static std::atomic<uint64_t> gRemoteUploads{};
+//-----------------------------------------------------------------------------
+
+RemoteCacheStats GetRemoteCacheStats()
+{
+    return {gRemoteHits, gRemoteMisses, gRemoteFailures, gRemoteUploads};
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+struct RemoteCache
+{
+    bool        enabled{};
+    std::string host{};
+    std::string port{};
+    std::string path{};  //!< The prefix of the keys, with a trailing slash.
+};
+}  // namespace
+
+static RemoteCache gRemoteCache{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+bool EnableRemoteCache(llvm::StringRef url)
+{
+    if(not url.consume_front("http://")) {
+        return false;
+    }
+
+    const auto [authority, path] = url.split('/');
+    const auto [host, port]      = authority.split(':');
+
+    if(host.empty()) {
+        return false;
+    }
+
+    gRemoteCache.enabled = true;
+    gRemoteCache.host    = host.str();
+    gRemoteCache.port    = port.empty() ? "80" : port.str();
+    gRemoteCache.path    = "/" + path.rtrim('/').str();
+
+    if('/' != gRemoteCache.path.back()) {
+        gRemoteCache.path += '/';
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsRemoteCacheEnabled()
+{
+    return gRemoteCache.enabled;
+}
+//-----------------------------------------------------------------------------
+
+#ifndef _WIN32
+
+/// \brief The time a single request may take. A cache which is slower than that is of no use.
+static constexpr std::chrono::milliseconds REMOTE_TIMEOUT{2000};
+
+/// \brief After a failed request the remote cache is skipped for this long, a node which is down must not slow down
+/// every request.
+static constexpr std::chrono::seconds REMOTE_BACKOFF{30};
+
+/// \brief Upper limit for a response, same as for a frame in server mode.
+static constexpr size_t MAX_RESPONSE_SIZE{64 * 1024 * 1024};
+
+/// \brief A remote cache which closes the connection early must not terminate the process.
+#ifdef MSG_NOSIGNAL
+static constexpr int SEND_FLAGS{MSG_NOSIGNAL};
+#else
+static constexpr int SEND_FLAGS{0};
+#endif /* MSG_NOSIGNAL */
+//-----------------------------------------------------------------------------
+
+static std::atomic<std::chrono::steady_clock::rep> gRemoteBackoffUntil{};
+//-----------------------------------------------------------------------------
+
+static bool IsBackingOff()
+{
+    return std::chrono::steady_clock::now().time_since_epoch().count() < gRemoteBackoffUntil;
+}
+//-----------------------------------------------------------------------------
+
+static void Fail()
+{
+    ++gRemoteFailures;
+    gRemoteBackoffUntil = (std::chrono::steady_clock::now() + REMOTE_BACKOFF).time_since_epoch().count();
+}
+//-----------------------------------------------------------------------------
+
+static int Connect()
+{
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* result{};
+    if(0 != ::getaddrinfo(gRemoteCache.host.c_str(), gRemoteCache.port.c_str(), &hints, &result)) {
+        return -1;
+    }
+
+    const timeval timeout{static_cast<time_t>(REMOTE_TIMEOUT.count() / 1000),
+                          static_cast<suseconds_t>((REMOTE_TIMEOUT.count() % 1000) * 1000)};
+
+    int fd{-1};
+    for(const auto* ai = result; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+        if(0 > fd) {
+            continue;
+        }
+
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        if(0 == ::connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+            break;
+        }
+
+        ::close(fd);
+        fd = -1;
+    }
+
+    ::freeaddrinfo(result);
+
+    return fd;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Send \p request and read the entire response, the server closes the connection after it.
+///
+/// \returns The HTTP status code, 0 if there was no valid response.
+static int Exchange(const std::string& request, std::string& body)
+{
+    const int fd = Connect();
+
+    if(0 > fd) {
+        return 0;
+    }
+
+    auto exchange = [&]() -> int {
+        for(size_t sent{}; sent < request.size();) {
+            const auto ret = ::send(fd, request.data() + sent, request.size() - sent, SEND_FLAGS);
+
+            if((0 > ret) and (EINTR == errno)) {
+                continue;
+            } else if(0 >= ret) {
+                return 0;
+            }
+
+            sent += static_cast<size_t>(ret);
+        }
+
+        std::string response{};
+        char        buffer[16 * 1024];
+
+        for(;;) {
+            const auto ret = ::recv(fd, buffer, sizeof(buffer), 0);
+
+            if((0 > ret) and (EINTR == errno)) {
+                continue;
+            } else if(0 > ret) {
+                return 0;
+            } else if(0 == ret) {
+                break;
+            }
+
+            response.append(buffer, static_cast<size_t>(ret));
+
+            if(response.size() > MAX_RESPONSE_SIZE) {
+                return 0;
+            }
+        }
+
+        // The status line is "HTTP/1.x <code> <reason>".
+        const llvm::StringRef responseRef{response};
+        const auto            headerEnd = responseRef.find("\r\n\r\n");
+        unsigned              status{};
+
+        if(not responseRef.startswith("HTTP/") or (llvm::StringRef::npos == headerEnd) or
+           responseRef.split(' ').second.take_while([](char c) { return ' ' != c; }).getAsInteger(10, status)) {
+            return 0;
+        }
+
+        body = responseRef.substr(headerEnd + 4).str();
+
+        return static_cast<int>(status);
+    };
+
+    const int status = exchange();
+    ::close(fd);
+
+    return status;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The start of a request for \p key. HTTP/1.0 keeps the server from sending a chunked response.
+static std::string GetRequestHead(const char* method, llvm::StringRef key)
+{
+    return std::string{method} + " " + gRemoteCache.path + key.str() + " HTTP/1.0\r\nHost: " + gRemoteCache.host +
+           "\r\nConnection: close\r\n";
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<std::string> FetchRemoteResult(llvm::StringRef key)
+{
+    if(not gRemoteCache.enabled or IsBackingOff()) {
+        return {};
+    }
+
+    std::string body{};
+
+    switch(const int status = Exchange(GetRequestHead("GET", key) + "\r\n", body); status) {
+        case 200:
+            ++gRemoteHits;
+            ProbeCacheLookup("remote", true);
+            return body;
+        case 404:
+            ++gRemoteMisses;
+            ProbeCacheLookup("remote", false);
+            return {};
+        default:
+            if(0 != status) {
+                Error("remote cache: GET returned %d\n", status);
+            }
+
+            Fail();
+            return {};
+    }
+}
+//-----------------------------------------------------------------------------
+
+void PutRemoteResult(llvm::StringRef key, llvm::StringRef result)
+{
+    if(not gRemoteCache.enabled or IsBackingOff()) {
+        return;
+    }
+
+    std::string body{};
+    const int   status = Exchange(GetRequestHead("PUT", key) + "Content-Type: text/plain\r\nContent-Length: " +
+                                    std::to_string(result.size()) + "\r\n\r\n" + result.str(),
+                                body);
+
+    if((200 <= status) and (300 > status)) {
+        ++gRemoteUploads;
+        return;
+    }
+
+    if(0 != status) {
+        Error("remote cache: PUT returned %d\n", status);
+    }
+
+    Fail();
+}
+//-----------------------------------------------------------------------------
+
+#else
+
+llvm::Optional<std::string> FetchRemoteResult(llvm::StringRef /*key*/)
+{
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+void PutRemoteResult(llvm::StringRef /*key*/, llvm::StringRef /*result*/) {}
+//-----------------------------------------------------------------------------
+
+#endif /* _WIN32 */
+
+}  // namespace clang::insights
@@ -0,0 +1,53 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_REMOTE_CACHE_H
+#define INSIGHTS_REMOTE_CACHE_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Counters of the remote result cache, reported with \c --stats.
+struct RemoteCacheStats
+{
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t failures{};  //!< Requests which did not get an answer, the cache is skipped for a while after one.
+    uint64_t uploads{};
+};
+
+RemoteCacheStats GetRemoteCacheStats();
+//-----------------------------------------------------------------------------
+
+/// \brief Share the result cache with other nodes through the HTTP server at \p url, see \c --remote-cache.
+///
+/// An entry is read with \c GET \c <url>/<key> and written with \c PUT \c <url>/<key>. Only plain \c http:// URLs are
+/// supported.
+///
+/// \returns \c false, if \p url is malformed.
+bool EnableRemoteCache(llvm::StringRef url);
+
+bool IsRemoteCacheEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Get the result for \p key from the remote cache.
+llvm::Optional<std::string> FetchRemoteResult(llvm::StringRef key);
+//-----------------------------------------------------------------------------
+
+/// \brief Upload \p result for \p key to the remote cache.
+void PutRemoteResult(llvm::StringRef key, llvm::StringRef result);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_REMOTE_CACHE_H */
@@ -0,0 +1,259 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/Basic/Version.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+#include "DPrint.h"
+#include "InsightsProbes.h"
+#include "InsightsRemoteCache.h"
+#include "InsightsResultCache.h"
+#include "version.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static ResultCacheStats gResultCacheStats{};
+//-----------------------------------------------------------------------------
+
+const ResultCacheStats& GetResultCacheStats()
+{
+    return gResultCacheStats;
+}
+//-----------------------------------------------------------------------------
+
+static constexpr llvm::StringLiteral RESULT_EXTENSION{".out"};
+//-----------------------------------------------------------------------------
+
+std::string GetResultCacheKey(llvm::StringRef                 source,
+                              const std::vector<std::string>& compilerArgs,
+                              const InsightsOptions&          options,
+                              const bool                      useLibCpp)
+{
+    llvm::MD5 hash{};
+
+    auto add = [&](llvm::StringRef str) {
+        hash.update(str);
+        hash.update(llvm::StringRef{"\0", 1});
+    };
+
+    add(source);
+
+    for(const auto& arg : compilerArgs) {
+        add(arg);
+    }
+
+#define INSIGHTS_OPT(opt, name, deflt, description, category) add(options.name ? opt "=1" : opt "=0");
+#include "InsightsOptions.def"
+
+    add(std::to_string(options.maxInstantiations));
+    add(std::to_string(options.maxOutputBytes));
+    add(std::to_string(options.maxArrayElements));
+    add(std::to_string(options.maxPackArgs));
+    add(std::to_string(options.functionBufferSize));
+    add(std::to_string(options.passByValueThreshold));
+    add(std::to_string(options.stackFrameThreshold));
+    add(std::to_string(static_cast<unsigned>(options.showCasts)));
+    add(std::to_string(options.cacheLineSize));
+    add(std::to_string(options.unrollFactor));
+
+    for(const auto& annotation : options.syncAnnotations) {
+        add(annotation);
+    }
+
+    for(const auto& lockType : options.lockTypes) {
+        add(lockType);
+    }
+
+    for(const auto& [field, count] : options.fieldAccessCounts) {
+        add(field + "=" + std::to_string(count));
+    }
+
+    add(std::to_string(options.rangeFirstLine));
+    add(std::to_string(options.rangeLastLine));
+    add(options.hasRangeOffset ? std::to_string(options.rangeOffset) : "");
+    add(std::to_string(options.disabledHandlers));
+    add(options.outputEdits ? "edits-json" : "source");
+    add(options.formatStyle);
+    add(options.verifyOutput ? "verify" : "");
+    add(useLibCpp ? "libc++" : "");
+    add(INSIGHTS_CLANG_RESOURCE_DIR);
+    add(GIT_COMMIT_HASH);
+    add(getClangFullCPPVersion());
+    add(getLLVMRevision());
+
+    // The entries may be shared with other machines through --remote-cache, the default target differs between them.
+    add(llvm::sys::getDefaultTargetTriple());
+
+    llvm::MD5::MD5Result result{};
+    hash.final(result);
+
+    return result.digest().str().str();
+}
+//-----------------------------------------------------------------------------
+
+static llvm::SmallString<256> GetResultPath(llvm::StringRef cacheDir, llvm::StringRef key)
+{
+    llvm::SmallString<256> path{cacheDir};
+    llvm::sys::path::append(path, key + RESULT_EXTENSION);
+
+    return path;
+}
+//-----------------------------------------------------------------------------
+
+static bool WriteEntry(llvm::StringRef cacheDir, llvm::StringRef key, llvm::StringRef result);
+//-----------------------------------------------------------------------------
+
+/// \brief On a miss of the local cache, look at the remote one. A remote hit goes into the local cache.
+static llvm::Optional<std::string> LookupRemoteResult(llvm::StringRef cacheDir, llvm::StringRef key)
+{
+    auto result = FetchRemoteResult(key);
+
+    if(result) {
+        WriteEntry(cacheDir, key, *result);
+    }
+
+    return result;
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<std::string> LookupCachedResult(llvm::StringRef cacheDir, llvm::StringRef key)
+{
+    const auto path = GetResultPath(cacheDir, key);
+
+    int fd{};
+    if(llvm::sys::fs::openFileForRead(path, fd)) {
+        ++gResultCacheStats.misses;
+        ProbeCacheLookup("result", false);
+        return LookupRemoteResult(cacheDir, key);
+    }
+
+    // Touch the entry, eviction removes the entries with the oldest modification time first.
+    llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+
+    auto buffer = llvm::MemoryBuffer::getOpenFile(fd, path, -1);
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+
+    if(not buffer) {
+        ++gResultCacheStats.misses;
+        ProbeCacheLookup("result", false);
+        return LookupRemoteResult(cacheDir, key);
+    }
+
+    ++gResultCacheStats.hits;
+    ProbeCacheLookup("result", true);
+
+    return buffer.get()->getBuffer().str();
+}
+//-----------------------------------------------------------------------------
+
+static void EvictEntries(llvm::StringRef cacheDir, const uint64_t maxSize)
+{
+    struct Entry
+    {
+        std::string            path;
+        uint64_t               size;
+        llvm::sys::TimePoint<> lastUsed;
+    };
+
+    std::vector<Entry> entries{};
+    uint64_t           totalSize{};
+    std::error_code    ec{};
+
+    for(llvm::sys::fs::directory_iterator it{cacheDir, ec}, end; not ec and (it != end); it.increment(ec)) {
+        if(not llvm::StringRef{it->path()}.endswith(RESULT_EXTENSION)) {
+            continue;
+        }
+
+        if(const auto status = it->status()) {
+            entries.push_back({it->path(), status->getSize(), status->getLastModificationTime()});
+            totalSize += status->getSize();
+        }
+    }
+
+    if(totalSize <= maxSize) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUsed < b.lastUsed; });
+
+    for(const auto& entry : entries) {
+        if(totalSize <= maxSize) {
+            break;
+        }
+
+        // Another process may have removed it already, that is fine.
+        if(not llvm::sys::fs::remove(entry.path)) {
+            ++gResultCacheStats.evictions;
+        }
+
+        totalSize -= entry.size;
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Write the entry \p result for \p key to \p cacheDir without evicting other entries.
+static bool WriteEntry(llvm::StringRef cacheDir, llvm::StringRef key, llvm::StringRef result)
+{
+    if(const auto ec = llvm::sys::fs::create_directories(cacheDir)) {
+        Error("result cache: cannot create '%s': %s\n", cacheDir, ec.message());
+        return false;
+    }
+
+    llvm::SmallString<256> tmpModel{cacheDir};
+    llvm::sys::path::append(tmpModel, key + "-%%%%%%.tmp");
+
+    int                    fd{};
+    llvm::SmallString<256> tmpPath{};
+    if(const auto ec = llvm::sys::fs::createUniqueFile(tmpModel, fd, tmpPath)) {
+        Error("result cache: cannot create a temporary file: %s\n", ec.message());
+        return false;
+    }
+
+    {
+        llvm::raw_fd_ostream out{fd, /*shouldClose*/ true};
+        out << result;
+        out.close();
+
+        if(out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmpPath);
+            return false;
+        }
+    }
+
+    // The rename is atomic, a concurrent reader sees either no entry or the complete one.
+    if(llvm::sys::fs::rename(tmpPath, GetResultPath(cacheDir, key))) {
+        llvm::sys::fs::remove(tmpPath);
+        return false;
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+void StoreCachedResult(llvm::StringRef cacheDir, llvm::StringRef key, llvm::StringRef result, const uint64_t maxSize)
+{
+    if(not WriteEntry(cacheDir, key, result)) {
+        return;
+    }
+
+    EvictEntries(cacheDir, maxSize);
+    PutRemoteResult(key, result);
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
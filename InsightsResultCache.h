@@ -0,0 +1,61 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_RESULT_CACHE_H
+#define INSIGHTS_RESULT_CACHE_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Insights.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Counters of the result cache, reported with \c --stats.
+struct ResultCacheStats
+{
+    unsigned hits{};
+    unsigned misses{};
+    unsigned evictions{};
+};
+//-----------------------------------------------------------------------------
+
+const ResultCacheStats& GetResultCacheStats();
+//-----------------------------------------------------------------------------
+
+/// \brief Build the key for a result.
+///
+/// It covers the bytes of the main file, the effective compiler arguments, all flags of \p options, the C++ Insights
+/// commit, the clang and LLVM revisions and the default target.
+std::string GetResultCacheKey(llvm::StringRef                 source,
+                              const std::vector<std::string>& compilerArgs,
+                              const InsightsOptions&          options,
+                              const bool                      useLibCpp);
+//-----------------------------------------------------------------------------
+
+/// \brief Look up the result for \p key in \p cacheDir. A hit marks the entry as recently used.
+///
+/// With \c --remote-cache a miss is looked up in the remote cache as well, a hit there is added to \p cacheDir.
+llvm::Optional<std::string> LookupCachedResult(llvm::StringRef cacheDir, llvm::StringRef key);
+//-----------------------------------------------------------------------------
+
+/// \brief Store \p result for \p key in \p cacheDir.
+///
+/// The entry is written to a temporary file and renamed afterwards, which makes it safe for multiple processes to
+/// share one directory. If the directory exceeds \p maxSize bytes, the least recently used entries are removed. With \c
+/// --remote-cache the entry is uploaded as well.
+void StoreCachedResult(llvm::StringRef cacheDir, llvm::StringRef key, llvm::StringRef result, const uint64_t maxSize);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_RESULT_CACHE_H */
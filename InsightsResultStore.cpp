@@ -0,0 +1,201 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/ADT/StringMap.h"
+
+#include <future>
+#include <list>
+#include <mutex>
+
+#include "InsightsMemoryLimit.h"
+#include "InsightsProbes.h"
+#include "InsightsResultStore.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief What happened to the requests for a single key.
+struct KeyCounters
+{
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t coalesced{};
+};
+
+/// \brief The store shared by all threads, the least recently used entry is at the back of \c order.
+struct ResultStore
+{
+    struct Entry
+    {
+        ServerResponse                   response;
+        KeyCounters                      counters;
+        std::list<std::string>::iterator position;
+    };
+
+    /// \brief A request in progress, the others with the same key wait for \c response.
+    struct InFlight
+    {
+        std::shared_future<ServerResponse> response;
+        KeyCounters                        counters;
+    };
+
+    std::mutex                mutex{};
+    llvm::StringMap<Entry>    entries{};
+    llvm::StringMap<InFlight> inFlight{};
+    std::list<std::string>    order{};
+    uint64_t                  size{};
+    uint64_t                  maxSize{};
+    ResultStoreStats          stats{};
+};
+}  // namespace
+
+static ResultStore gResultStore{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+ResultStoreStats GetResultStoreStats()
+{
+    std::lock_guard lock{gResultStore.mutex};
+
+    return gResultStore.stats;
+}
+//-----------------------------------------------------------------------------
+
+static llvm::json::Object ToJSON(llvm::StringRef key, const KeyCounters& counters, const bool inFlight)
+{
+    return llvm::json::Object{{"key", key},
+                              {"hits", static_cast<int64_t>(counters.hits)},
+                              {"misses", static_cast<int64_t>(counters.misses)},
+                              {"coalesced", static_cast<int64_t>(counters.coalesced)},
+                              {"inFlight", inFlight}};
+}
+//-----------------------------------------------------------------------------
+
+llvm::json::Object GetResultStoreJSON()
+{
+    std::lock_guard lock{gResultStore.mutex};
+
+    llvm::json::Array keys{};
+
+    // The most recently used first.
+    for(const auto& key : gResultStore.order) {
+        keys.push_back(ToJSON(key, gResultStore.entries.find(key)->second.counters, false));
+    }
+
+    for(const auto& entry : gResultStore.inFlight) {
+        keys.push_back(ToJSON(entry.getKey(), entry.getValue().counters, true));
+    }
+
+    const auto& stats = gResultStore.stats;
+
+    return llvm::json::Object{{"hits", static_cast<int64_t>(stats.hits)},
+                              {"misses", static_cast<int64_t>(stats.misses)},
+                              {"coalesced", static_cast<int64_t>(stats.coalesced)},
+                              {"evictions", static_cast<int64_t>(stats.evictions)},
+                              {"size", static_cast<int64_t>(gResultStore.size)},
+                              {"keys", std::move(keys)}};
+}
+//-----------------------------------------------------------------------------
+
+void EnableResultStore(const uint64_t maxSize)
+{
+    gResultStore.maxSize = maxSize;
+}
+//-----------------------------------------------------------------------------
+
+bool IsResultStoreEnabled()
+{
+    return 0 != gResultStore.maxSize;
+}
+//-----------------------------------------------------------------------------
+
+static uint64_t GetEntrySize(llvm::StringRef key, const ServerResponse& response)
+{
+    uint64_t size{key.size() + response.output.size() + response.diagnostics.size()};
+
+    for(const auto& segment : response.segments) {
+        size += sizeof(segment) + segment.key.size();
+    }
+
+    return size;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Store \p response for \p key, the caller holds the lock.
+static void StoreResult(llvm::StringRef key, const ServerResponse& response, const KeyCounters& counters)
+{
+    gResultStore.size += GetEntrySize(key, response);
+    gResultStore.order.push_front(key.str());
+    gResultStore.entries[key] = {response, counters, gResultStore.order.begin()};
+
+    while((gResultStore.size > gResultStore.maxSize) and (gResultStore.order.size() > 1)) {
+        const auto& oldest = gResultStore.order.back();
+        const auto  it     = gResultStore.entries.find(oldest);
+
+        gResultStore.size -= GetEntrySize(oldest, it->second.response);
+        gResultStore.entries.erase(it);
+        gResultStore.order.pop_back();
+
+        ++gResultStore.stats.evictions;
+    }
+}
+//-----------------------------------------------------------------------------
+
+ServerResponse GetOrComputeResult(llvm::StringRef key, llvm::function_ref<ServerResponse()> compute)
+{
+    std::promise<ServerResponse> promise{};
+
+    {
+        std::unique_lock lock{gResultStore.mutex};
+
+        if(const auto it = gResultStore.entries.find(key); gResultStore.entries.end() != it) {
+            ++gResultStore.stats.hits;
+            ProbeCacheLookup("store", true);
+            ++it->second.counters.hits;
+
+            gResultStore.order.splice(gResultStore.order.begin(), gResultStore.order, it->second.position);
+
+            return it->second.response;
+        }
+
+        if(const auto it = gResultStore.inFlight.find(key); gResultStore.inFlight.end() != it) {
+            ++gResultStore.stats.coalesced;
+            ++it->second.counters.coalesced;
+
+            // The future stays valid after the request in progress removed its entry.
+            const auto response = it->second.response;
+            lock.unlock();
+
+            return response.get();
+        }
+
+        ++gResultStore.stats.misses;
+        ProbeCacheLookup("store", false);
+        gResultStore.inFlight[key] = {promise.get_future().share(), KeyCounters{0, 1, 0}};
+    }
+
+    ServerResponse response{compute()};
+
+    {
+        std::lock_guard lock{gResultStore.mutex};
+
+        const auto it       = gResultStore.inFlight.find(key);
+        const auto counters = it->second.counters;
+        gResultStore.inFlight.erase(it);
+
+        if(IsResultStorable(response.returnCode)) {
+            StoreResult(key, response, counters);
+        }
+    }
+
+    promise.set_value(response);
+
+    return response;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
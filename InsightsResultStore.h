@@ -0,0 +1,54 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_RESULT_STORE_H
+#define INSIGHTS_RESULT_STORE_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/JSON.h"
+
+#include <cstdint>
+
+#include "InsightsServer.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Counters of the in-memory result store, reported with \c --stats.
+struct ResultStoreStats
+{
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t coalesced{};  //!< Requests which waited for the same request in progress.
+    uint64_t evictions{};
+};
+
+ResultStoreStats GetResultStoreStats();
+//-----------------------------------------------------------------------------
+
+/// \brief The totals and the counters of every key in the store as JSON, see \ref ServerRequest.
+llvm::json::Object GetResultStoreJSON();
+//-----------------------------------------------------------------------------
+
+/// \brief Keep the responses of up to \p maxSize bytes in memory, see \c --result-store-size.
+void EnableResultStore(const uint64_t maxSize);
+
+bool IsResultStoreEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Get the response for \p key from the store or from \p compute.
+///
+/// While \p compute runs for a key, all other requests for the same key wait for its response instead of running it
+/// again. A successful response is kept for later requests, unless the translation unit ran in the degraded mode of
+/// \c --max-memory-mb. If the store exceeds its size, the least recently used responses are removed.
+ServerResponse GetOrComputeResult(llvm::StringRef key, llvm::function_ref<ServerResponse()> compute);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_RESULT_STORE_H */
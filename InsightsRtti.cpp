@@ -0,0 +1,158 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/CXXInheritance.h"
+#include "clang/AST/RecordLayout.h"
+
+#include "Insights.h"
+#include "InsightsHelpers.h"
+#include "InsightsRtti.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The class of \p type, looking through a pointer.
+static const CXXRecordDecl* GetPointeeRecord(const QualType& type)
+{
+    if(const auto pointee = type->getPointeeType(); not pointee.isNull()) {
+        return pointee->getAsCXXRecordDecl();
+    }
+
+    return type->getAsCXXRecordDecl();
+}
+//-----------------------------------------------------------------------------
+
+llvm::Optional<DynamicCast> GetDynamicCast(const CXXDynamicCastExpr& cast)
+{
+    if(CK_Dynamic != cast.getCastKind()) {
+        return {};
+    }
+
+    const auto* source      = GetPointeeRecord(cast.getSubExpr()->getType());
+    const auto* destination = GetPointeeRecord(cast.getType());
+
+    // A cast to void* takes the offset to the top from the vtable, it has no destination class.
+    if(not source or not destination or not source->hasDefinition() or not destination->hasDefinition()) {
+        return {};
+    }
+
+    return DynamicCast{
+        source, destination, not cast.getType()->isPointerType(), GetDynamicCastHint(*source, *destination)};
+}
+//-----------------------------------------------------------------------------
+
+int64_t GetDynamicCastHint(const CXXRecordDecl& source, const CXXRecordDecl& destination)
+{
+    // This follows computeOffsetHint of clang's ItaniumCXXABI.
+    CXXBasePaths paths{/*FindAmbiguities*/ true, /*RecordPaths*/ true, /*DetectVirtual*/ false};
+
+    if(not destination.isDerivedFrom(&source, paths)) {
+        return -2;
+    }
+
+    const auto& ctx = source.getASTContext();
+    unsigned    publicPaths{};
+    CharUnits   offset{};
+
+    for(const auto& path : paths) {
+        if(AS_public != path.Access) {
+            continue;
+        }
+
+        ++publicPaths;
+
+        for(const auto& element : path) {
+            if(element.Base->isVirtual()) {
+                return -1;
+            }
+
+            if(1 == publicPaths) {
+                offset += ctx.getASTRecordLayout(element.Class)
+                              .getBaseClassOffset(element.Base->getType()->getAsCXXRecordDecl());
+            }
+        }
+    }
+
+    if(0 == publicPaths) {
+        return -2;
+    } else if(1 < publicPaths) {
+        return -3;
+    }
+
+    return offset.getQuantity();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the object \p expr refers to is known to be a \p destination, because it was converted to its base
+/// right before.
+static bool IsKnownToBe(const Expr* expr, const CXXRecordDecl& destination)
+{
+    expr = expr->IgnoreParens();
+
+    while(const auto* cast = dyn_cast<CastExpr>(expr)) {
+        const auto kind = cast->getCastKind();
+
+        if((CK_DerivedToBase != kind) and (CK_UncheckedDerivedToBase != kind) and (CK_NoOp != kind)) {
+            break;
+        }
+
+        expr = cast->getSubExpr()->IgnoreParens();
+    }
+
+    const auto* record = GetPointeeRecord(expr->getType());
+
+    return record and record->hasDefinition() and
+           ((record->getCanonicalDecl() == destination.getCanonicalDecl()) or record->isDerivedFrom(&destination));
+}
+//-----------------------------------------------------------------------------
+
+std::string GetStaticCastAlternative(const CXXDynamicCastExpr& cast, const DynamicCast& dynamicCast)
+{
+    // A static_cast can only go from a unique public non-virtual base.
+    if(0 > dynamicCast.hint) {
+        return {};
+    }
+
+    const auto& destination = *dynamicCast.destination;
+    const auto  name        = GetName(destination);
+
+    if(IsKnownToBe(cast.getSubExpr(), destination)) {
+        return StrCat("the object is a ", name, ", a static_cast does the same without a call");
+    }
+
+    if(destination.hasAttr<FinalAttr>()) {
+        return StrCat(name,
+                      " is final, comparing typeid with typeid(",
+                      name,
+                      ") followed by a static_cast does the same without a call");
+    }
+
+    return StrCat(GetName(*dynamicCast.source),
+                  " is a unique public base of ",
+                  name,
+                  " at offset ",
+                  dynamicCast.hint,
+                  ", where the object is known to be a ",
+                  name,
+                  " a static_cast does the same without a call");
+}
+//-----------------------------------------------------------------------------
+
+std::string GetTypeidNote(const CXXTypeidExpr& expr)
+{
+    if(not expr.isPotentiallyEvaluated()) {
+        return "static type_info, no runtime cost";
+    }
+
+    return StrCat("type_info from the vtable",
+                  expr.hasNullCheck() ? ", throws std::bad_typeid for a null pointer" : "");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,47 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_RTTI_H
+#define INSIGHTS_RTTI_H
+
+#include "clang/AST/ExprCXX.h"
+#include "llvm/ADT/Optional.h"
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief A \c dynamic_cast which calls \c __dynamic_cast of the Itanium C++ ABI, see \c --show-rtti.
+struct DynamicCast
+{
+    const CXXRecordDecl* source;       //!< The static type of the object.
+    const CXXRecordDecl* destination;  //!< The class to cast to.
+    bool                 isReference;  //!< Whether a failure throws \c std::bad_cast instead of returning \c nullptr.
+    int64_t              hint;         //!< The offset hint, see \ref GetDynamicCastHint.
+};
+
+/// \brief The runtime call of \p cast, if it has one. A cast to a base or to <tt>void*</tt> has none.
+llvm::Optional<DynamicCast> GetDynamicCast(const CXXDynamicCastExpr& cast);
+
+/// \brief The hint \c __dynamic_cast gets about the way from \p source to \p destination.
+///
+/// It is the offset of \p source in \p destination if \p source is a unique public non-virtual base of it. Otherwise
+/// it is -1 if a virtual base is on the way, -2 if \p source is no public base and -3 if it is a public base more than
+/// once.
+int64_t GetDynamicCastHint(const CXXRecordDecl& source, const CXXRecordDecl& destination);
+
+/// \brief The note which tells when a \c static_cast does the same as \p cast, empty if it does not.
+std::string GetStaticCastAlternative(const CXXDynamicCastExpr& cast, const DynamicCast& dynamicCast);
+
+/// \brief The note which tells where \p expr gets its \c std::type_info from.
+std::string GetTypeidNote(const CXXTypeidExpr& expr);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_RTTI_H */
@@ -0,0 +1,1885 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "InsightsServer.h"
+#include "DPrint.h"
+#include "InsightsCompression.h"
+#include "InsightsMemReport.h"
+
+#ifndef _WIN32
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#endif /* _WIN32 */
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+#ifndef _WIN32
+
+/// \brief Upper limit for a single frame. Protects the server from clients sending garbage lengths.
+static constexpr size_t MAX_FRAME_SIZE{64 * 1024 * 1024};
+//-----------------------------------------------------------------------------
+
+static bool ReadAll(const int fd, char* data, size_t size)
+{
+    while(size) {
+        const auto ret = ::read(fd, data, size);
+
+        if(0 > ret) {
+            if(EINTR == errno) {
+                continue;
+            }
+
+            return false;
+
+        } else if(0 == ret) {
+            return false;
+        }
+
+        data += ret;
+        size -= static_cast<size_t>(ret);
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+static bool WriteAll(const int fd, const char* data, size_t size)
+{
+    while(size) {
+        const auto ret = ::write(fd, data, size);
+
+        if(0 > ret) {
+            if(EINTR == errno) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data += ret;
+        size -= static_cast<size_t>(ret);
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Read a frame: the decimal length of the payload, a newline and the payload.
+static bool ReadFrame(const int fd, std::string& payload)
+{
+    size_t length{};
+    char   c{};
+
+    for(;;) {
+        if(not ReadAll(fd, &c, 1)) {
+            return false;
+        }
+
+        if('\n' == c) {
+            break;
+
+        } else if(not std::isdigit(static_cast<unsigned char>(c))) {
+            return false;
+        }
+
+        length = (length * 10) + static_cast<size_t>(c - '0');
+
+        if(length > MAX_FRAME_SIZE) {
+            Error("insights server: frame exceeds the maximum size\n");
+            return false;
+        }
+    }
+
+    payload.resize(length);
+
+    return ReadAll(fd, payload.data(), length);
+}
+//-----------------------------------------------------------------------------
+
+static bool WriteFrame(const int fd, const std::string& payload)
+{
+    const std::string header{std::to_string(payload.size()) + '\n'};
+
+    return WriteAll(fd, header.data(), header.size()) && WriteAll(fd, payload.data(), payload.size());
+}
+//-----------------------------------------------------------------------------
+
+static std::vector<std::string> SplitArguments(const std::string& data)
+{
+    std::vector<std::string> arguments{};
+
+    size_t start{};
+    while(start < data.size()) {
+        const auto end = std::min(data.find('\0', start), data.size());
+
+        if(end != start) {
+            arguments.emplace_back(data.substr(start, end - start));
+        }
+
+        start = end + 1;
+    }
+
+    return arguments;
+}
+//-----------------------------------------------------------------------------
+
+static bool ReadRequest(const int fd, ServerRequest& request)
+{
+    std::string arguments{};
+
+    if(not ReadFrame(fd, request.fileName) || not ReadFrame(fd, arguments) || not ReadFrame(fd, request.source)) {
+        return false;
+    }
+
+    request.arguments = SplitArguments(arguments);
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Write \p response, with \p compress its output and diagnostics compressed by \ref CompressResponse.
+///
+/// A compressed response has the return code followed by " zlib". If the compression fails, the response goes
+/// uncompressed.
+static bool WriteResponse(const int fd, const ServerResponse& response, const bool compress = false)
+{
+    std::string output{};
+    std::string diagnostics{};
+
+    if(compress and CompressResponse(response.output, output) and CompressResponse(response.diagnostics, diagnostics)) {
+        return WriteFrame(fd, std::to_string(response.returnCode) + " zlib") && WriteFrame(fd, output) &&
+               WriteFrame(fd, diagnostics);
+    }
+
+    return WriteFrame(fd, std::to_string(response.returnCode)) && WriteFrame(fd, response.output) &&
+           WriteFrame(fd, response.diagnostics);
+}
+//-----------------------------------------------------------------------------
+
+static bool WriteRequest(const int fd, const ServerRequest& request)
+{
+    std::string arguments{};
+
+    for(const auto& argument : request.arguments) {
+        arguments.append(argument).push_back('\0');
+    }
+
+    return WriteFrame(fd, request.fileName) && WriteFrame(fd, arguments) && WriteFrame(fd, request.source);
+}
+//-----------------------------------------------------------------------------
+
+static bool ReadResponse(const int fd, ServerResponse& response)
+{
+    std::string returnCode{};
+
+    if(not ReadFrame(fd, returnCode) || returnCode.empty() || not ReadFrame(fd, response.output) ||
+       not ReadFrame(fd, response.diagnostics)) {
+        return false;
+    }
+
+    response.returnCode = std::atoi(returnCode.c_str());
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief If \p arg is the option \p name, spelled with or without leading dashes, store its value in \p value.
+static bool TakeServerOption(std::string_view arg, std::string_view name, std::string& value)
+{
+    arg.remove_prefix(std::min(arg.find_first_not_of('-'), arg.size()));
+
+    if((arg.size() <= name.size()) or (arg.substr(0, name.size()) != name) or ('=' != arg[name.size()])) {
+        return false;
+    }
+
+    value = std::string{arg.substr(name.size() + 1)};
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Take the option \c compress=zlib out of the C++ Insights options of \p request.
+///
+/// Compression is negotiated per connection: once a request asked for it, \p compress stays set and the responses to
+/// this and all later requests of the connection are compressed.
+///
+/// \returns The error for the response, if the request asks for a compression this server does not offer.
+static std::string TakeCompressionOption(ServerRequest& request, bool& compress)
+{
+    std::vector<std::string> arguments{};
+    bool                     isCompilerArg{};
+    std::string              error{};
+
+    for(auto& arg : request.arguments) {
+        if(std::string method{}; not isCompilerArg and TakeServerOption(arg, "compress", method)) {
+            if(("zlib" == method) and IsCompressionAvailable()) {
+                compress = true;
+
+            } else {
+                error = "insights server: compression '" + method + "' is not available\n";
+            }
+
+            continue;
+        }
+
+        isCompilerArg = isCompilerArg or ("--" == arg);
+        arguments.push_back(std::move(arg));
+    }
+
+    request.arguments = std::move(arguments);
+
+    return error;
+}
+//-----------------------------------------------------------------------------
+
+static bool IsPort(const std::string& str)
+{
+    return not str.empty() && std::all_of(str.begin(), str.end(), [](unsigned char c) { return std::isdigit(c); });
+}
+//-----------------------------------------------------------------------------
+
+static int OpenTcpSocket(const std::string& host, const std::string& port)
+{
+    addrinfo hints{};
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags    = AI_PASSIVE;
+
+    addrinfo* result{};
+    if(const int err = ::getaddrinfo(host.empty() ? "127.0.0.1" : host.c_str(), port.c_str(), &hints, &result)) {
+        Error("insights server: %s\n", ::gai_strerror(err));
+        return -1;
+    }
+
+    int fd{-1};
+    for(const auto* ai = result; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+        if(0 > fd) {
+            continue;
+        }
+
+        const int reuse{1};
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        if(0 == ::bind(fd, ai->ai_addr, ai->ai_addrlen)) {
+            break;
+        }
+
+        ::close(fd);
+        fd = -1;
+    }
+
+    ::freeaddrinfo(result);
+
+    return fd;
+}
+//-----------------------------------------------------------------------------
+
+static int OpenUnixSocket(const std::string& path)
+{
+    sockaddr_un addr{};
+
+    if(path.size() >= sizeof(addr.sun_path)) {
+        Error("insights server: socket path too long\n");
+        return -1;
+    }
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if(0 > fd) {
+        return -1;
+    }
+
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    // A stale socket from a former run would make bind fail.
+    ::unlink(path.c_str());
+
+    if(0 != ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+//-----------------------------------------------------------------------------
+
+static int OpenListenSocket(const std::string& address)
+{
+    const auto colon = address.rfind(':');
+    const bool isTcp{(std::string::npos != colon) && IsPort(address.substr(colon + 1))};
+
+    const int fd = isTcp ? OpenTcpSocket(address.substr(0, colon), address.substr(colon + 1))
+                         : OpenUnixSocket(address);
+
+    if(0 > fd) {
+        return -1;
+    }
+
+    if(0 != ::listen(fd, SOMAXCONN)) {
+        ::close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Upper limit for the request line and the headers of an HTTP request.
+static constexpr size_t MAX_HTTP_HEADER_SIZE{8 * 1024};
+//-----------------------------------------------------------------------------
+
+/// \brief Whether the connection \p fd starts with an HTTP \c GET. Nothing is consumed.
+static bool IsHttpGet(const int fd)
+{
+    char first[4]{};
+
+    for(;;) {
+        const auto ret = ::recv(fd, first, sizeof(first), MSG_PEEK | MSG_WAITALL);
+
+        if((0 > ret) and (EINTR == errno)) {
+            continue;
+        }
+
+        return (sizeof(first) == static_cast<size_t>(ret)) and (0 == std::memcmp(first, "GET ", sizeof(first)));
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Answer the HTTP request on \p fd, only \c /metrics is known.
+///
+/// The part of the request which was read already is passed in as \p header.
+static void ServeHttpRequest(const int fd, const ServerMetricsHandler& metrics, std::string header = {})
+{
+    char c{};
+
+    // Only the request line matters, but the client expects all headers to be read. A GET has no body.
+    while((header.size() < MAX_HTTP_HEADER_SIZE) and
+          ((4 > header.size()) or (0 != header.compare(header.size() - 4, 4, "\r\n\r\n"))) and ReadAll(fd, &c, 1)) {
+        header += c;
+    }
+
+    const auto path = header.substr(4, header.find_first_of(" ?\r\n", 4) - 4);
+    const bool found{"/metrics" == path};
+    const auto body = found ? metrics() : std::string{"not found\n"};
+
+    const std::string response{std::string{found ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n"} +
+                               "Content-Type: text/plain; version=0.0.4\r\n" +
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+                               "Connection: close\r\n\r\n" + body};
+
+    WriteAll(fd, response.data(), response.size());
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Serve all requests of the connection \p clientFd and close it.
+static void ServeConnection(const int                   clientFd,
+                            const ServerRequestHandler& handler,
+                            const ServerMetricsHandler& metrics)
+{
+    if(metrics and IsHttpGet(clientFd)) {
+        ServeHttpRequest(clientFd, metrics);
+        ::close(clientFd);
+        return;
+    }
+
+    bool          compress{};
+    ServerRequest request{};
+    while(ReadRequest(clientFd, request)) {
+        auto       error    = TakeCompressionOption(request, compress);
+        const auto response = error.empty() ? handler(request) : ServerResponse{1, {}, std::move(error)};
+
+        if(not WriteResponse(clientFd, response, compress)) {
+            break;
+        }
+
+        request = {};
+    }
+
+    ::close(clientFd);
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Accept a connection on \p listenFd.
+///
+/// \returns The new socket or -1, if \c accept failed.
+static int AcceptConnection(const int listenFd)
+{
+    for(;;) {
+        if(const int clientFd = ::accept(listenFd, nullptr, nullptr); (0 <= clientFd) or (EINTR != errno)) {
+            if(0 > clientFd) {
+                Error("insights server: accept failed: %s\n", std::strerror(errno));
+            }
+
+            return clientFd;
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Accept and serve connections on \p listenFd until \c accept fails.
+static void
+ServeConnections(const int listenFd, const ServerRequestHandler& handler, const ServerMetricsHandler& metrics)
+{
+    for(int clientFd = AcceptConnection(listenFd); 0 <= clientFd; clientFd = AcceptConnection(listenFd)) {
+        ServeConnection(clientFd, handler, metrics);
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Accept connections on \p listenFd and serve each of them in a child process, up to \p jobs at a time.
+static void ForkConnections(const int listenFd, const unsigned jobs, const ServerRequestHandler& handler)
+{
+    unsigned children{};
+
+    for(;;) {
+        // Reap the children which are done. If all jobs are taken, wait for one of them.
+        while(0 < children) {
+            const pid_t pid = ::waitpid(-1, nullptr, (children < jobs) ? WNOHANG : 0);
+
+            if((0 > pid) and (EINTR == errno)) {
+                continue;
+
+            } else if(0 >= pid) {
+                break;
+            }
+
+            --children;
+        }
+
+        const int clientFd = AcceptConnection(listenFd);
+
+        if(0 > clientFd) {
+            break;
+        }
+
+        if(const pid_t pid = ::fork(); 0 == pid) {
+            // The child inherits the initialized LLVM, the parsed options and the warm caches of the parent. It
+            // serves this one connection, a crash takes down only the child.
+            ::close(listenFd);
+            ServeConnection(clientFd, handler, {});
+            ::_exit(0);
+
+        } else if(0 > pid) {
+            Error("insights server: fork failed: %s\n", std::strerror(errno));
+
+        } else {
+            ++children;
+        }
+
+        ::close(clientFd);
+    }
+
+    while(0 < children) {
+        if(0 < ::waitpid(-1, nullptr, 0)) {
+            --children;
+        } else if(EINTR != errno) {
+            break;
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Upper limit for the file descriptors a new worker closes, see \ref CloseInheritedFds.
+static constexpr long MAX_INHERITED_FDS{64 * 1024};
+//-----------------------------------------------------------------------------
+
+/// \brief Close all file descriptors of a new worker besides stdio and \p keepFd.
+///
+/// The worker must not keep the listen socket and the connections of the supervisor open, otherwise a client would
+/// not see its connection closed.
+static void CloseInheritedFds(const int keepFd)
+{
+    const long maxFd{std::min(::sysconf(_SC_OPEN_MAX), MAX_INHERITED_FDS)};
+
+    for(int fd = STDERR_FILENO + 1; fd < maxFd; ++fd) {
+        if(keepFd != fd) {
+            ::close(fd);
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The worker processes of \ref RunWorkerPool.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(const ServerRequestHandler& handler)
+    : mHandler{handler}
+    {
+    }
+
+    /// \brief Fork \p count workers.
+    ///
+    /// \returns \c false, if not a single worker could be started.
+    bool Start(const unsigned count)
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+
+        for(unsigned i = 0; i < count; ++i) {
+            if(Worker worker{}; Spawn(worker)) {
+                mIdle.push_back(worker);
+            }
+        }
+
+        mWorkers = mIdle.size();
+
+        return 0 != mWorkers;
+    }
+
+    /// \brief Transform \p request in the next idle worker, waits for one if all are busy.
+    ServerResponse Run(const ServerRequest& request)
+    {
+        Worker worker{};
+
+        {
+            std::unique_lock<std::mutex> lock{mMutex};
+            mIdleCondition.wait(lock, [&] { return not mIdle.empty() or (0 == mWorkers); });
+
+            if(mIdle.empty()) {
+                return {1, {}, "insights server: no worker left\n"};
+            }
+
+            worker = mIdle.back();
+            mIdle.pop_back();
+        }
+
+        if(not WriteRequest(worker.fd, request)) {
+            // The worker died while it was idle, the request goes to another one.
+            Replace(worker, request);
+            return Run(request);
+        }
+
+        if(ServerResponse response{}; ReadResponse(worker.fd, response)) {
+            Release(worker);
+
+            return response;
+        }
+
+        const auto [signal, inputHash] = Replace(worker, request);
+
+        return {128 + signal,
+                {},
+                "insights server: C++ Insights crashed on this input, input hash " + inputHash +
+                    ". The stack trace is in the log of the server.\n"};
+    }
+
+    /// \brief The resident set of each worker, the pages of a mapped PCH are shared between them.
+    std::string GetMetricsText()
+    {
+        std::vector<pid_t> pids{};
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            pids = mPids;
+        }
+
+        std::string text{"# HELP insights_worker_rss_bytes Resident set of a worker of --worker-pool, shared with "
+                         "other processes or private.\n"
+                         "# TYPE insights_worker_rss_bytes gauge\n"};
+
+        for(const auto pid : pids) {
+            const auto        rss = GetRssUsage(pid);
+            const std::string worker{"insights_worker_rss_bytes{worker=\"" + std::to_string(pid) + "\",kind="};
+
+            text += worker + "\"shared\"} " + std::to_string(rss.shared) + '\n';
+            text += worker + "\"private\"} " + std::to_string(rss.privateBytes) + '\n';
+        }
+
+        return text;
+    }
+
+private:
+    struct Worker
+    {
+        pid_t pid{-1};
+        int   fd{-1};  //!< The supervisor's end of the socket pair.
+    };
+
+    /// \brief Fork a new worker, \ref mMutex must be held.
+    bool Spawn(Worker& worker)
+    {
+        int fds[2]{};
+
+        if(0 != ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+            Error("insights server: socketpair failed: %s\n", std::strerror(errno));
+            return false;
+        }
+
+        const pid_t pid = ::fork();
+
+        if(0 == pid) {
+            // Only the thread which forked lives on in the child, it serves requests until the supervisor closes its
+            // end.
+            CloseInheritedFds(fds[1]);
+
+            ServerRequest request{};
+            while(ReadRequest(fds[1], request)) {
+                if(not WriteResponse(fds[1], mHandler(request))) {
+                    break;
+                }
+
+                request = {};
+            }
+
+            ::_exit(0);
+        }
+
+        ::close(fds[1]);
+
+        if(0 > pid) {
+            Error("insights server: fork failed: %s\n", std::strerror(errno));
+            ::close(fds[0]);
+            return false;
+        }
+
+        worker = {pid, fds[0]};
+        mPids.push_back(pid);
+
+        return true;
+    }
+
+    void Release(const Worker& worker)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            mIdle.push_back(worker);
+        }
+
+        mIdleCondition.notify_one();
+    }
+
+    /// \brief Reap \p worker, which failed on \p request, report the crash and start a new worker instead.
+    ///
+    /// \returns The signal which killed the worker and the hash of \p request.
+    std::pair<int, std::string> Replace(const Worker& worker, const ServerRequest& request)
+    {
+        // A worker which is still alive answered with garbage, it is not trusted any more.
+        ::close(worker.fd);
+        ::kill(worker.pid, SIGKILL);
+
+        int status{};
+        while((0 > ::waitpid(worker.pid, &status, 0)) and (EINTR == errno)) {
+        }
+
+        const int signal{WIFSIGNALED(status) ? WTERMSIG(status) : 0};
+
+        std::string input{request.fileName};
+        for(const auto& argument : request.arguments) {
+            input.append(1, '\0').append(argument);
+        }
+        input.append(1, '\0').append(request.source);
+
+        char inputHash[17]{};
+        std::snprintf(inputHash, sizeof(inputHash), "%016zx", std::hash<std::string>{}(input));
+
+        // The stack trace of the worker is already on stderr, printed by its signal handler.
+        Error("insights server: worker %d died with signal %d on '%s', input hash %s\n",
+              static_cast<int>(worker.pid),
+              signal,
+              request.fileName,
+              inputHash);
+
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+
+            mPids.erase(std::remove(mPids.begin(), mPids.end(), worker.pid), mPids.end());
+
+            if(Worker replacement{}; Spawn(replacement)) {
+                mIdle.push_back(replacement);
+            } else {
+                --mWorkers;
+            }
+        }
+
+        mIdleCondition.notify_all();
+
+        return {signal, inputHash};
+    }
+
+    const ServerRequestHandler& mHandler;
+    std::mutex                  mMutex{};
+    std::condition_variable     mIdleCondition{};
+    std::vector<Worker>         mIdle{};
+    std::vector<pid_t>          mPids{};     //!< All running workers, for \ref GetMetricsText.
+    size_t                      mWorkers{};  //!< The running workers, idle or busy.
+};
+//-----------------------------------------------------------------------------
+
+int RunServer(const std::string&          address,
+              const unsigned              jobs,
+              const ServerRequestHandler& handler,
+              const ServerMetricsHandler& metrics)
+{
+    const int listenFd = OpenListenSocket(address);
+
+    if(0 > listenFd) {
+        Error("insights server: cannot listen on '%s': %s\n", address, std::strerror(errno));
+        return 1;
+    }
+
+    // A client which disconnects while we are writing the response must not terminate the server.
+    ::signal(SIGPIPE, SIG_IGN);
+
+    // All threads wait in accept on the same socket, the kernel hands each connection to one of them.
+    std::vector<std::thread> threads{};
+    for(unsigned i = 1; i < jobs; ++i) {
+        threads.emplace_back(ServeConnections, listenFd, std::cref(handler), std::cref(metrics));
+    }
+
+    ServeConnections(listenFd, handler, metrics);
+
+    ::shutdown(listenFd, SHUT_RDWR);
+
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    ::close(listenFd);
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+
+int RunForkServer(const std::string& address, const unsigned jobs, const ServerRequestHandler& handler)
+{
+    const int listenFd = OpenListenSocket(address);
+
+    if(0 > listenFd) {
+        Error("insights server: cannot listen on '%s': %s\n", address, std::strerror(errno));
+        return 1;
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    ForkConnections(listenFd, jobs, handler);
+
+    ::close(listenFd);
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+
+int RunWorkerPool(const std::string&          address,
+                  const unsigned              jobs,
+                  const ServerRequestHandler& handler,
+                  const bool                  workerMetrics)
+{
+    const int listenFd = OpenListenSocket(address);
+
+    if(0 > listenFd) {
+        Error("insights server: cannot listen on '%s': %s\n", address, std::strerror(errno));
+        return 1;
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    // The workers are forked before the threads start, none of them can hold a lock at this point.
+    WorkerPool pool{handler};
+
+    if(not pool.Start(jobs)) {
+        ::close(listenFd);
+        return 1;
+    }
+
+    const ServerRequestHandler dispatch{[&](const ServerRequest& request) { return pool.Run(request); }};
+    const ServerMetricsHandler metrics{workerMetrics ? ServerMetricsHandler{[&] { return pool.GetMetricsText(); }}
+                                                     : ServerMetricsHandler{}};
+
+    std::vector<std::thread> threads{};
+    for(unsigned i = 1; i < jobs; ++i) {
+        threads.emplace_back(ServeConnections, listenFd, std::cref(dispatch), std::cref(metrics));
+    }
+
+    ServeConnections(listenFd, dispatch, metrics);
+
+    ::shutdown(listenFd, SHUT_RDWR);
+
+    for(auto& thread : threads) {
+        thread.join();
+    }
+
+    ::close(listenFd);
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Upper limit for the requests waiting in a queue of \ref RunPipelineServer, per thread of the next stage.
+static constexpr size_t PIPELINE_QUEUE_SIZE_PER_JOB{4};
+
+/// \brief How long the writer of \ref RunPipelineServer waits for a client which does not read its response.
+static constexpr int PIPELINE_SEND_TIMEOUT_SECONDS{30};
+
+/// \brief The size of a single read of the I/O thread of \ref RunPipelineServer.
+static constexpr size_t PIPELINE_READ_SIZE{64 * 1024};
+//-----------------------------------------------------------------------------
+
+namespace {
+enum class FrameStatus
+{
+    Complete,
+    Incomplete,
+    Invalid
+};
+
+/// \brief A request read by the I/O thread, on its way to the parse stage.
+struct PipelineRequest
+{
+    int           fd{-1};
+    ServerRequest request{};
+    bool          compress{};  //!< Whether the connection negotiated compressed responses.
+};
+
+/// \brief A request after the parse stage, or a metrics request which goes straight to the writer.
+struct PipelineItem
+{
+    int                          fd{-1};
+    size_t                       parser{};  //!< The parse thread which created \c job.
+    std::unique_ptr<PipelineJob> job{};
+    ServerResponse               response{};
+    bool                         isHttp{};
+    std::string                  httpHeader{};  //!< What the I/O thread read of the HTTP request.
+    bool                         compress{};
+};
+
+/// \brief A bounded queue between two stages, \ref Push waits while the queue is full.
+template<typename T>
+class StageQueue
+{
+public:
+    explicit StageQueue(const size_t capacity)
+    : mCapacity{capacity}
+    {
+    }
+
+    void Push(T item)
+    {
+        {
+            std::unique_lock<std::mutex> lock{mMutex};
+            mNotFull.wait(lock, [&] { return mItems.size() < mCapacity; });
+            mItems.push_back(std::move(item));
+        }
+
+        mNotEmpty.notify_one();
+    }
+
+    /// \returns \c false, once the queue is closed and empty.
+    bool Pop(T& item)
+    {
+        {
+            std::unique_lock<std::mutex> lock{mMutex};
+            mNotEmpty.wait(lock, [&] { return mClosed or not mItems.empty(); });
+
+            if(mItems.empty()) {
+                return false;
+            }
+
+            item = std::move(mItems.front());
+            mItems.pop_front();
+        }
+
+        mNotFull.notify_one();
+
+        return true;
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            mClosed = true;
+        }
+
+        mNotEmpty.notify_all();
+    }
+
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+        return mItems.size();
+    }
+
+private:
+    const size_t            mCapacity;
+    std::mutex              mMutex{};
+    std::condition_variable mNotFull{};
+    std::condition_variable mNotEmpty{};
+    std::deque<T>           mItems{};
+    bool                    mClosed{};
+};
+
+/// \brief The connections of the I/O thread of \ref RunPipelineServer.
+struct PipelineConnection
+{
+    std::string buffer{};    //!< What was read, but is no complete request yet.
+    bool        busy{};      //!< Whether a request is in the pipeline, the connection is not read meanwhile.
+    bool        started{};   //!< Whether the connection sent anything.
+    bool        compress{};  //!< Whether the connection negotiated compressed responses.
+};
+
+/// \brief The stages of \ref RunPipelineServer and their queues.
+class Pipeline
+{
+public:
+    Pipeline(const unsigned parseJobs, const unsigned codegenJobs, const ServerParseHandler& parse)
+    : mParse{parse}
+    , mParseCapacity{PIPELINE_QUEUE_SIZE_PER_JOB * parseJobs}
+    , mCodegenQueue{PIPELINE_QUEUE_SIZE_PER_JOB * codegenJobs}
+    , mWriterQueue{PIPELINE_QUEUE_SIZE_PER_JOB * (parseJobs + codegenJobs)}
+    , mRetired(parseJobs)
+    {
+    }
+
+    /// \brief Start the threads, serve \p listenFd until \c accept fails and wait for the threads.
+    void
+    Run(const int listenFd, const unsigned parseJobs, const unsigned codegenJobs, const ServerMetricsHandler& metrics)
+    {
+        if(0 != ::pipe(mWakeFds)) {
+            Error("insights server: pipe failed: %s\n", std::strerror(errno));
+            return;
+        }
+
+        std::vector<std::thread> parseThreads{};
+        for(size_t i = 0; i < parseJobs; ++i) {
+            parseThreads.emplace_back(&Pipeline::ParseStage, this, i);
+        }
+
+        std::vector<std::thread> codegenThreads{};
+        for(unsigned i = 0; i < codegenJobs; ++i) {
+            codegenThreads.emplace_back(&Pipeline::CodegenStage, this);
+        }
+
+        std::thread writerThread{&Pipeline::WriterStage, this, std::cref(metrics)};
+
+        IoStage(listenFd, static_cast<bool>(metrics));
+
+        // Each stage finishes what it has before the next one is closed.
+        CloseParseQueue();
+        for(auto& thread : parseThreads) {
+            thread.join();
+        }
+
+        mCodegenQueue.Close();
+        for(auto& thread : codegenThreads) {
+            thread.join();
+        }
+
+        mWriterQueue.Close();
+        writerThread.join();
+
+        ::close(mWakeFds[0]);
+        ::close(mWakeFds[1]);
+    }
+
+private:
+    enum Stage
+    {
+        Parse,
+        Codegen,
+        Write,
+        StageCount  // Must be the last entry.
+    };
+
+    /// \brief Take a frame out of \p buffer, beginning at \p pos, which is moved behind the frame.
+    static FrameStatus TakeFrame(const std::string& buffer, size_t& pos, std::string& payload)
+    {
+        size_t length{};
+        size_t i{pos};
+
+        for(;; ++i) {
+            if(buffer.size() == i) {
+                return FrameStatus::Incomplete;
+            }
+
+            const char c{buffer[i]};
+
+            if('\n' == c) {
+                break;
+
+            } else if(not std::isdigit(static_cast<unsigned char>(c))) {
+                return FrameStatus::Invalid;
+            }
+
+            length = (length * 10) + static_cast<size_t>(c - '0');
+
+            if(length > MAX_FRAME_SIZE) {
+                Error("insights server: frame exceeds the maximum size\n");
+                return FrameStatus::Invalid;
+            }
+        }
+
+        ++i;
+
+        if(buffer.size() - i < length) {
+            return FrameStatus::Incomplete;
+        }
+
+        payload = buffer.substr(i, length);
+        pos     = i + length;
+
+        return FrameStatus::Complete;
+    }
+
+    /// \brief Take a request out of \p buffer, once all its three frames are there.
+    static FrameStatus TakeRequest(std::string& buffer, ServerRequest& request)
+    {
+        size_t      pos{};
+        std::string arguments{};
+
+        for(auto* payload : {&request.fileName, &arguments, &request.source}) {
+            if(const auto status = TakeFrame(buffer, pos, *payload); FrameStatus::Complete != status) {
+                return status;
+            }
+        }
+
+        request.arguments = SplitArguments(arguments);
+        buffer.erase(0, pos);
+
+        return FrameStatus::Complete;
+    }
+
+    /// \brief Pass the next request in the buffer of \p connection on.
+    ///
+    /// \returns \c false, if the connection is to be closed, or it was handed over to the writer.
+    bool Dispatch(const int fd, PipelineConnection& connection, const bool withMetrics)
+    {
+        static constexpr std::string_view httpGet{"GET "};
+
+        if(withMetrics and not connection.started and not connection.buffer.empty()) {
+            if(connection.buffer.size() < httpGet.size()) {
+                if(0 == httpGet.compare(0, connection.buffer.size(), connection.buffer)) {
+                    return true;
+                }
+
+            } else if(0 == connection.buffer.compare(0, httpGet.size(), httpGet)) {
+                PipelineItem item{};
+                item.fd         = fd;
+                item.isHttp     = true;
+                item.httpHeader = std::move(connection.buffer);
+                mWriterQueue.Push(std::move(item));
+
+                return false;
+            }
+        }
+
+        if(connection.buffer.empty()) {
+            return true;
+        }
+
+        connection.started = true;
+
+        ServerRequest request{};
+
+        switch(TakeRequest(connection.buffer, request)) {
+            case FrameStatus::Complete:
+                connection.busy = true;
+
+                if(auto error = TakeCompressionOption(request, connection.compress); not error.empty()) {
+                    PipelineItem item{};
+                    item.fd       = fd;
+                    item.response = {1, {}, std::move(error)};
+                    item.compress = connection.compress;
+                    mWriterQueue.Push(std::move(item));
+                    return true;
+                }
+
+                // A full parse queue stops the reading of all connections, the clients notice that.
+                PushRequest({fd, std::move(request), connection.compress});
+                return true;
+
+            case FrameStatus::Incomplete: return true;
+            case FrameStatus::Invalid: ::close(fd); return false;
+        }
+
+        return false;
+    }
+
+    void IoStage(const int listenFd, const bool withMetrics)
+    {
+        std::unordered_map<int, PipelineConnection> connections{};
+        std::vector<pollfd>                         pollFds{};
+        std::string                                 readBuffer(PIPELINE_READ_SIZE, '\0');
+
+        for(;;) {
+            // The connections whose response is written can carry the next request.
+            std::vector<std::pair<int, bool>> written{};
+            {
+                std::lock_guard<std::mutex> lock{mWrittenMutex};
+                written.swap(mWritten);
+            }
+
+            for(const auto& [fd, ok] : written) {
+                auto& connection = connections[fd];
+                connection.busy  = false;
+
+                if(not ok) {
+                    ::close(fd);
+                    connections.erase(fd);
+
+                } else if(not Dispatch(fd, connection, withMetrics)) {
+                    connections.erase(fd);
+                }
+            }
+
+            pollFds.clear();
+            pollFds.push_back({listenFd, POLLIN, 0});
+            pollFds.push_back({mWakeFds[0], POLLIN, 0});
+
+            for(const auto& [fd, connection] : connections) {
+                if(not connection.busy) {
+                    pollFds.push_back({fd, POLLIN, 0});
+                }
+            }
+
+            if(0 > ::poll(pollFds.data(), pollFds.size(), -1)) {
+                if(EINTR == errno) {
+                    continue;
+                }
+
+                Error("insights server: poll failed: %s\n", std::strerror(errno));
+                return;
+            }
+
+            if(pollFds[1].revents) {
+                char drain[64];
+                const auto ret = ::read(mWakeFds[0], drain, sizeof(drain));
+                static_cast<void>(ret);
+            }
+
+            for(size_t i = 2; i < pollFds.size(); ++i) {
+                if(0 == pollFds[i].revents) {
+                    continue;
+                }
+
+                const int fd{pollFds[i].fd};
+                auto&     connection = connections[fd];
+                const auto ret       = ::recv(fd, readBuffer.data(), readBuffer.size(), 0);
+
+                if((0 > ret) and (EINTR == errno)) {
+                    continue;
+
+                } else if(0 >= ret) {
+                    ::close(fd);
+                    connections.erase(fd);
+                    continue;
+                }
+
+                connection.buffer.append(readBuffer.data(), static_cast<size_t>(ret));
+
+                if(not Dispatch(fd, connection, withMetrics)) {
+                    connections.erase(fd);
+                }
+            }
+
+            if(pollFds[0].revents) {
+                const int clientFd = AcceptConnection(listenFd);
+
+                if(0 > clientFd) {
+                    break;
+                }
+
+                // A client which stops reading must not block the responses of all others for ever.
+                const timeval timeout{PIPELINE_SEND_TIMEOUT_SECONDS, 0};
+                ::setsockopt(clientFd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+                connections[clientFd] = {};
+            }
+        }
+
+        for(const auto& [fd, connection] : connections) {
+            // The busy ones are closed by the writer.
+            if(not connection.busy) {
+                ::close(fd);
+            }
+        }
+    }
+
+    void PushRequest(PipelineRequest request)
+    {
+        {
+            std::unique_lock<std::mutex> lock{mParseMutex};
+            mParseNotFull.wait(lock, [&] { return mParseRequests.size() < mParseCapacity; });
+            mParseRequests.push_back(std::move(request));
+        }
+
+        mParseWake.notify_all();
+    }
+
+    void CloseParseQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mParseMutex};
+            mParseClosed = true;
+        }
+
+        mParseWake.notify_all();
+    }
+
+    /// \brief Hand \p job back to the thread which parsed it, see \ref RunPipelineServer.
+    void Retire(const size_t parser, std::unique_ptr<PipelineJob> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock{mParseMutex};
+            mRetired[parser].push_back(std::move(job));
+        }
+
+        mParseWake.notify_all();
+    }
+
+    void ParseStage(const size_t parser)
+    {
+        for(;;) {
+            std::vector<std::unique_ptr<PipelineJob>> retired{};
+            PipelineRequest                           request{};
+            bool                                      hasRequest{};
+
+            {
+                std::unique_lock<std::mutex> lock{mParseMutex};
+                mParseWake.wait(lock, [&] {
+                    return mParseClosed or not mParseRequests.empty() or not mRetired[parser].empty();
+                });
+
+                retired.swap(mRetired[parser]);
+
+                if(not mParseRequests.empty()) {
+                    request = std::move(mParseRequests.front());
+                    mParseRequests.pop_front();
+                    hasRequest = true;
+
+                } else if(retired.empty()) {
+                    return;
+                }
+            }
+
+            if(not hasRequest) {
+                continue;
+            }
+
+            mParseNotFull.notify_one();
+
+            const auto start = std::chrono::steady_clock::now();
+
+            PipelineItem item{};
+            item.fd       = request.fd;
+            item.parser   = parser;
+            item.compress = request.compress;
+            item.job      = mParse(request.request, item.response);
+
+            AddBusyTime(Parse, start);
+
+            if(item.job) {
+                mCodegenQueue.Push(std::move(item));
+            } else {
+                mWriterQueue.Push(std::move(item));
+            }
+        }
+    }
+
+    void CodegenStage()
+    {
+        for(PipelineItem item{}; mCodegenQueue.Pop(item); item = {}) {
+            const auto start = std::chrono::steady_clock::now();
+
+            item.response = item.job->Finish();
+
+            AddBusyTime(Codegen, start);
+
+            Retire(item.parser, std::move(item.job));
+            mWriterQueue.Push(std::move(item));
+        }
+    }
+
+    void WriterStage(const ServerMetricsHandler& metrics)
+    {
+        const ServerMetricsHandler pipelineMetrics{[&] { return metrics() + GetMetricsText(); }};
+
+        for(PipelineItem item{}; mWriterQueue.Pop(item); item = {}) {
+            const auto start = std::chrono::steady_clock::now();
+
+            if(item.isHttp) {
+                ServeHttpRequest(item.fd, pipelineMetrics, std::move(item.httpHeader));
+                ::close(item.fd);
+                continue;
+            }
+
+            const bool ok{WriteResponse(item.fd, item.response, item.compress)};
+
+            AddBusyTime(Write, start);
+
+            {
+                std::lock_guard<std::mutex> lock{mWrittenMutex};
+                mWritten.emplace_back(item.fd, ok);
+            }
+
+            // Wake up the I/O thread, which waits in poll.
+            const char wake{};
+            const auto ret = ::write(mWakeFds[1], &wake, 1);
+            static_cast<void>(ret);
+        }
+    }
+
+    void AddBusyTime(const Stage stage, const std::chrono::steady_clock::time_point start)
+    {
+        mBusyNs[stage] += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    /// \brief The queue depths and the busy times of the stages in the Prometheus text format.
+    std::string GetMetricsText()
+    {
+        static constexpr const char* stageNames[StageCount]{"parse", "codegen", "write"};
+
+        size_t parseDepth{};
+        {
+            std::lock_guard<std::mutex> lock{mParseMutex};
+            parseDepth = mParseRequests.size();
+        }
+
+        const size_t depths[StageCount]{parseDepth, mCodegenQueue.Size(), mWriterQueue.Size()};
+
+        std::string text{"# HELP insights_pipeline_queue_depth Requests waiting for a stage of --pipeline.\n"
+                         "# TYPE insights_pipeline_queue_depth gauge\n"};
+
+        for(size_t i = 0; i < StageCount; ++i) {
+            text += std::string{"insights_pipeline_queue_depth{stage=\""} + stageNames[i] + "\"} " +
+                    std::to_string(depths[i]) + '\n';
+        }
+
+        text += "# HELP insights_pipeline_busy_seconds_total Time the threads of a stage of --pipeline worked.\n"
+                "# TYPE insights_pipeline_busy_seconds_total counter\n";
+
+        for(size_t i = 0; i < StageCount; ++i) {
+            char seconds[32]{};
+            std::snprintf(seconds, sizeof(seconds), "%.6f", static_cast<double>(mBusyNs[i]) / 1e9);
+
+            text += std::string{"insights_pipeline_busy_seconds_total{stage=\""} + stageNames[i] + "\"} " + seconds +
+                    '\n';
+        }
+
+        return text;
+    }
+
+    const ServerParseHandler& mParse;
+
+    // The parse queue is not a StageQueue, the parse threads wake up for their retired jobs as well.
+    std::mutex                                             mParseMutex{};
+    std::condition_variable                                mParseWake{};
+    std::condition_variable                                mParseNotFull{};
+    std::deque<PipelineRequest>                            mParseRequests{};
+    const size_t                                           mParseCapacity;
+    bool                                                   mParseClosed{};
+    StageQueue<PipelineItem>                               mCodegenQueue;
+    StageQueue<PipelineItem>                               mWriterQueue;
+    std::vector<std::vector<std::unique_ptr<PipelineJob>>> mRetired;  //!< The finished jobs of each parse thread.
+
+    std::mutex                        mWrittenMutex{};
+    std::vector<std::pair<int, bool>> mWritten{};      //!< The connections with a written response, and if it worked.
+    int                               mWakeFds[2]{};  //!< Wakes up the I/O thread, when a response is written.
+
+    std::atomic<uint64_t> mBusyNs[StageCount]{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+int RunPipelineServer(const std::string&          address,
+                      const unsigned              parseJobs,
+                      const unsigned              codegenJobs,
+                      const ServerParseHandler&   parse,
+                      const ServerMetricsHandler& metrics)
+{
+    const int listenFd = OpenListenSocket(address);
+
+    if(0 > listenFd) {
+        Error("insights server: cannot listen on '%s': %s\n", address, std::strerror(errno));
+        return 1;
+    }
+
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Pipeline pipeline{parseJobs, codegenJobs, parse};
+    pipeline.Run(listenFd, parseJobs, codegenJobs, metrics);
+
+    ::close(listenFd);
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief While both lanes of \ref RunScheduledServer wait, every this many requests one comes from the batch lane.
+/// Otherwise a steady stream of interactive requests would starve the batch lane.
+static constexpr unsigned SCHEDULER_BATCH_SHARE{4};
+
+/// \brief How often \ref RunScheduledServer preempts a request. After that it runs to the end, so that it finishes.
+static constexpr unsigned SCHEDULER_MAX_PREEMPTIONS{1};
+//-----------------------------------------------------------------------------
+
+namespace {
+enum class Lane
+{
+    Interactive,
+    Batch,
+    Count
+};
+
+/// \brief A request of \ref RunScheduledServer, waiting or running.
+struct ScheduledJob
+{
+    ServerRequest                         request{};
+    std::string                           tenant{};
+    Lane                                  lane{};
+    uint64_t                              cost{};
+    double                                startTag{};   //!< The virtual time of weighted fair queuing it starts at.
+    double                                finishTag{};  //!< The virtual time it finishes at, the smallest one goes first.
+    unsigned                              preemptions{};
+    std::atomic<bool>                     cancelled{};
+    std::chrono::steady_clock::time_point started{};
+    std::promise<ServerResponse>          response{};
+};
+
+using ScheduledJobPtr = std::shared_ptr<ScheduledJob>;
+//-----------------------------------------------------------------------------
+
+/// \brief The requests of the tenants of a lane with weighted fair queuing.
+///
+/// Each request gets a virtual finish time: its start, the later one of the virtual time of the lane and the finish of
+/// the previous request of its tenant, plus its cost divided by the weight of the tenant. The waiting request with the
+/// earliest finish goes first. A tenant with many or expensive requests thereby gets its share, but not more.
+class LaneQueue
+{
+public:
+    void Push(const ScheduledJobPtr& job, const unsigned weight)
+    {
+        auto& tenant = mTenants[job->tenant];
+
+        job->startTag  = std::max(mVirtualTime, tenant.lastFinish);
+        job->finishTag = job->startTag + static_cast<double>(job->cost) / weight;
+        tenant.lastFinish = job->finishTag;
+        tenant.jobs.push_back(job);
+        ++mSize;
+    }
+
+    /// \brief Put a preempted \p job back, it keeps its place.
+    void PushFront(const ScheduledJobPtr& job)
+    {
+        mTenants[job->tenant].jobs.push_front(job);
+        ++mSize;
+    }
+
+    ScheduledJobPtr Pop()
+    {
+        auto next = mTenants.end();
+
+        for(auto it = mTenants.begin(); it != mTenants.end(); ++it) {
+            if(not it->second.jobs.empty() and
+               ((mTenants.end() == next) or (it->second.jobs.front()->finishTag < next->second.jobs.front()->finishTag))) {
+                next = it;
+            }
+        }
+
+        auto job = next->second.jobs.front();
+        next->second.jobs.pop_front();
+        --mSize;
+
+        mVirtualTime = std::max(mVirtualTime, job->startTag);
+
+        // A tenant without waiting requests whose last finish has passed starts at the virtual time again anyway.
+        for(auto it = mTenants.begin(); it != mTenants.end();) {
+            if(it->second.jobs.empty() and (it->second.lastFinish <= mVirtualTime)) {
+                it = mTenants.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        return job;
+    }
+
+    size_t Size() const { return mSize; }
+
+private:
+    struct Tenant
+    {
+        std::deque<ScheduledJobPtr> jobs{};
+        double                      lastFinish{};
+    };
+
+    std::map<std::string, Tenant> mTenants{};
+    double                        mVirtualTime{};
+    size_t                        mSize{};
+};
+//-----------------------------------------------------------------------------
+
+class Scheduler
+{
+public:
+    Scheduler(const unsigned jobs, const ServerCancellableHandler& handler, const ServerSchedule& schedule)
+    : mJobs{jobs}
+    , mHandler{handler}
+    , mSchedule{schedule}
+    {
+        for(const auto& [tenant, weight] : schedule.weights) {
+            mWeights[tenant] = std::max(1u, weight);
+        }
+    }
+
+    /// \brief Schedule \p request and wait for its response.
+    ServerResponse Submit(ServerRequest request)
+    {
+        auto job = std::make_shared<ScheduledJob>();
+        bool batch{};
+
+        std::vector<std::string> arguments{};
+        bool                     isCompilerArg{};
+
+        for(auto& arg : request.arguments) {
+            std::string lane{};
+
+            if(not isCompilerArg and TakeServerOption(arg, "tenant", job->tenant)) {
+                continue;
+
+            } else if(not isCompilerArg and TakeServerOption(arg, "lane", lane)) {
+                if(("batch" != lane) and ("interactive" != lane)) {
+                    return {1, {}, "unknown lane: " + lane + "\n"};
+                }
+
+                batch = ("batch" == lane);
+                continue;
+            }
+
+            isCompilerArg = isCompilerArg or ("--" == arg);
+            arguments.push_back(std::move(arg));
+        }
+
+        request.arguments = std::move(arguments);
+
+        // The estimate runs on the thread of the connection, the threads of the handler are for the requests.
+        job->cost = std::max<uint64_t>(1, mSchedule.estimate ? mSchedule.estimate(request) : request.source.size());
+        job->lane = (batch or (job->cost > mSchedule.interactiveCost)) ? Lane::Batch : Lane::Interactive;
+        job->request = std::move(request);
+
+        auto response = job->response.get_future();
+
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            mLanes[static_cast<size_t>(job->lane)].Push(job, GetWeight(job->tenant));
+            ++mRequests[static_cast<size_t>(job->lane)];
+
+            if(Lane::Interactive == job->lane) {
+                Preempt();
+            }
+        }
+
+        mWork.notify_one();
+
+        return response.get();
+    }
+
+    /// \brief Run the waiting requests, one after the other, until \ref Stop.
+    void Work()
+    {
+        for(;;) {
+            ScheduledJobPtr job{};
+
+            {
+                std::unique_lock<std::mutex> lock{mMutex};
+                mWork.wait(lock, [&] { return mStopped or (0 < Waiting()); });
+
+                if(mStopped) {
+                    return;
+                }
+
+                job = Pop();
+                job->cancelled = false;
+                job->started   = std::chrono::steady_clock::now();
+                mRunning.push_back(job);
+            }
+
+            auto response = mHandler(job->request, job->cancelled);
+
+            {
+                std::lock_guard<std::mutex> lock{mMutex};
+                mRunning.erase(std::find(mRunning.begin(), mRunning.end(), job));
+
+                if(job->cancelled) {
+                    ++job->preemptions;
+                    mLanes[static_cast<size_t>(job->lane)].PushFront(job);
+                    continue;
+                }
+            }
+
+            job->response.set_value(std::move(response));
+        }
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mMutex};
+            mStopped = true;
+        }
+
+        mWork.notify_all();
+    }
+
+    std::string GetMetricsText()
+    {
+        std::lock_guard<std::mutex> lock{mMutex};
+
+        static constexpr const char* laneNames[]{"interactive", "batch"};
+        static_assert(std::size(laneNames) == static_cast<size_t>(Lane::Count));
+
+        std::string text{"# HELP insights_scheduler_queue_depth Requests waiting in a lane of --scheduler.\n"
+                         "# TYPE insights_scheduler_queue_depth gauge\n"};
+
+        for(size_t i = 0; i < std::size(laneNames); ++i) {
+            text += std::string{"insights_scheduler_queue_depth{lane=\""} + laneNames[i] + "\"} " +
+                    std::to_string(mLanes[i].Size()) + '\n';
+        }
+
+        text += "# HELP insights_scheduler_requests_total Requests of each lane of --scheduler.\n"
+                "# TYPE insights_scheduler_requests_total counter\n";
+
+        for(size_t i = 0; i < std::size(laneNames); ++i) {
+            text += std::string{"insights_scheduler_requests_total{lane=\""} + laneNames[i] + "\"} " +
+                    std::to_string(mRequests[i]) + '\n';
+        }
+
+        text += "# HELP insights_scheduler_preemptions_total Batch requests of --scheduler stopped for an interactive "
+                "one.\n"
+                "# TYPE insights_scheduler_preemptions_total counter\n"
+                "insights_scheduler_preemptions_total " +
+                std::to_string(mPreemptions) + '\n';
+
+        return text;
+    }
+
+private:
+    unsigned GetWeight(const std::string& tenant) const
+    {
+        const auto it = mWeights.find(tenant);
+
+        return (mWeights.end() == it) ? 1 : it->second;
+    }
+
+    size_t Waiting() const { return mLanes[0].Size() + mLanes[1].Size(); }
+
+    /// \brief Take the next request, the interactive lane first, but every \ref SCHEDULER_BATCH_SHARE one from the batch
+    /// lane while both wait.
+    ScheduledJobPtr Pop()
+    {
+        auto& interactive = mLanes[static_cast<size_t>(Lane::Interactive)];
+        auto& batch       = mLanes[static_cast<size_t>(Lane::Batch)];
+
+        if(0 == batch.Size()) {
+            return interactive.Pop();
+        }
+
+        if((0 == interactive.Size()) or (SCHEDULER_BATCH_SHARE <= ++mInteractiveInARow)) {
+            mInteractiveInARow = 0;
+            return batch.Pop();
+        }
+
+        return interactive.Pop();
+    }
+
+    /// \brief Make room for the interactive requests which wait, if all threads are busy, by cancelling the batch
+    /// request which runs the longest. Called with \ref mMutex held.
+    void Preempt()
+    {
+        if(mRunning.size() < mJobs) {
+            return;
+        }
+
+        // A request which is cancelled already frees its thread soon.
+        const auto cancelled = static_cast<size_t>(
+            std::count_if(mRunning.begin(), mRunning.end(), [](const auto& job) { return job->cancelled.load(); }));
+
+        if(mLanes[static_cast<size_t>(Lane::Interactive)].Size() <= cancelled) {
+            return;
+        }
+
+        ScheduledJob* longest{};
+
+        for(const auto& job : mRunning) {
+            if((Lane::Batch == job->lane) and not job->cancelled and (SCHEDULER_MAX_PREEMPTIONS > job->preemptions) and
+               ((nullptr == longest) or (job->started < longest->started))) {
+                longest = job.get();
+            }
+        }
+
+        if(longest) {
+            longest->cancelled = true;
+            ++mPreemptions;
+        }
+    }
+
+    const unsigned                  mJobs;
+    const ServerCancellableHandler& mHandler;
+    const ServerSchedule&           mSchedule;
+    std::map<std::string, unsigned> mWeights{};
+
+    std::mutex                   mMutex{};
+    std::condition_variable      mWork{};
+    LaneQueue                    mLanes[static_cast<size_t>(Lane::Count)]{};
+    std::vector<ScheduledJobPtr> mRunning{};
+    unsigned                     mInteractiveInARow{};
+    bool                         mStopped{};
+
+    uint64_t mRequests[static_cast<size_t>(Lane::Count)]{};
+    uint64_t mPreemptions{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief Serve all requests of the connection \p clientFd through \p scheduler and close it.
+static void ServeScheduledConnection(const int clientFd, Scheduler& scheduler, const ServerMetricsHandler& metrics)
+{
+    if(metrics and IsHttpGet(clientFd)) {
+        ServeHttpRequest(clientFd, [&] { return metrics() + scheduler.GetMetricsText(); });
+        ::close(clientFd);
+        return;
+    }
+
+    bool          compress{};
+    ServerRequest request{};
+    while(ReadRequest(clientFd, request)) {
+        auto       error    = TakeCompressionOption(request, compress);
+        const auto response =
+            error.empty() ? scheduler.Submit(std::move(request)) : ServerResponse{1, {}, std::move(error)};
+
+        if(not WriteResponse(clientFd, response, compress)) {
+            break;
+        }
+
+        request = {};
+    }
+
+    ::close(clientFd);
+}
+//-----------------------------------------------------------------------------
+
+int RunScheduledServer(const std::string&              address,
+                       const unsigned                  jobs,
+                       const ServerCancellableHandler& handler,
+                       const ServerSchedule&           schedule,
+                       const ServerMetricsHandler&     metrics)
+{
+    const int listenFd = OpenListenSocket(address);
+
+    if(0 > listenFd) {
+        Error("insights server: cannot listen on '%s': %s\n", address, std::strerror(errno));
+        return 1;
+    }
+
+    // A client which disconnects while we are writing the response must not terminate the server.
+    ::signal(SIGPIPE, SIG_IGN);
+
+    Scheduler scheduler{jobs, handler, schedule};
+
+    std::vector<std::thread> workers{};
+    for(unsigned i = 0; i < jobs; ++i) {
+        workers.emplace_back(&Scheduler::Work, &scheduler);
+    }
+
+    // The connections only wait for I/O and for their responses, a slow one holds no thread of the scheduler. They are
+    // not joined, the server returns only on an error and the process ends right after.
+    for(int clientFd = AcceptConnection(listenFd); 0 <= clientFd; clientFd = AcceptConnection(listenFd)) {
+        std::thread{ServeScheduledConnection, clientFd, std::ref(scheduler), std::cref(metrics)}.detach();
+    }
+
+    scheduler.Stop();
+
+    for(auto& worker : workers) {
+        worker.join();
+    }
+
+    ::close(listenFd);
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+
+#else
+
+int RunServer(const std::string& /*address*/,
+              const unsigned /*jobs*/,
+              const ServerRequestHandler& /*handler*/,
+              const ServerMetricsHandler& /*metrics*/)
+{
+    Error("insights server: server mode is not supported on this platform\n");
+
+    return 1;
+}
+//-----------------------------------------------------------------------------
+
+int RunForkServer(const std::string& address, const unsigned jobs, const ServerRequestHandler& handler)
+{
+    return RunServer(address, jobs, handler);
+}
+//-----------------------------------------------------------------------------
+
+int RunWorkerPool(const std::string&          address,
+                  const unsigned              jobs,
+                  const ServerRequestHandler& handler,
+                  const bool /*workerMetrics*/)
+{
+    return RunServer(address, jobs, handler);
+}
+//-----------------------------------------------------------------------------
+
+int RunScheduledServer(const std::string& address,
+                       const unsigned /*jobs*/,
+                       const ServerCancellableHandler& /*handler*/,
+                       const ServerSchedule& /*schedule*/,
+                       const ServerMetricsHandler& /*metrics*/)
+{
+    return RunServer(address, 1, {});
+}
+//-----------------------------------------------------------------------------
+
+int RunPipelineServer(const std::string& address,
+                      const unsigned /*parseJobs*/,
+                      const unsigned /*codegenJobs*/,
+                      const ServerParseHandler& /*parse*/,
+                      const ServerMetricsHandler& /*metrics*/)
+{
+    return RunServer(address, 1, {});
+}
+//-----------------------------------------------------------------------------
+
+#endif /* _WIN32 */
+
+}  // namespace clang::insights
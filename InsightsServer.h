@@ -0,0 +1,188 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_SERVER_H
+#define INSIGHTS_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief A single request received in server mode.
+///
+/// On the wire a request consists of three frames: the file name, the arguments and the source. Each frame is the
+/// decimal length of the payload followed by a newline and the payload itself. The arguments are separated by a
+/// '\0'. Everything before a "--" argument is treated as a C++ Insights option, everything after it is passed to
+/// the compiler.
+struct ServerRequest
+{
+    std::string              fileName{};   //!< Name of the main file as it should appear in the output.
+    std::vector<std::string> arguments{};  //!< C++ Insights options and compiler arguments, separated by "--".
+    std::string              source{};     //!< Content of the main file.
+
+    /// Whether the response should carry the \ref OutputSegment of the output. Not on the wire.
+    bool withSegments{};
+
+    /// Content of the main file which stays in memory outside of the request, like an entry of a memory-mapped \c
+    /// --batch-archive. If set, it is used instead of \c source without a copy. The character behind it must be a
+    /// '\0', the lexer relies on it. Not on the wire.
+    std::string_view sourceView{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief A consecutive part of the output, see \ref ServerResponse.
+///
+/// The part of a top-level declaration the declaration cache generated is keyed by its entry in the cache. Two parts
+/// with the same key have the same text. The parts in between have no key, only their text tells whether they changed.
+struct OutputSegment
+{
+    unsigned    length{};
+    std::string key{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief The answer to a \ref ServerRequest.
+///
+/// It is sent back as three frames: the return code, the transformed code and the diagnostics. Once a request of the
+/// connection carried the option \c compress=zlib, the return code is followed by " zlib" and the other two frames
+/// are compressed with the dictionary of \c scripts/response-dictionary.txt, see \ref CompressResponse.
+struct ServerResponse
+{
+    int         returnCode{};
+    std::string output{};
+    std::string diagnostics{};
+
+    /// The parts of \c output from its begin to its end, if \ref ServerRequest::withSegments was set and the output is
+    /// the plain result. Not on the wire.
+    std::vector<OutputSegment> segments{};
+};
+//-----------------------------------------------------------------------------
+
+using ServerRequestHandler = std::function<ServerResponse(const ServerRequest&)>;
+
+/// \brief Provides the body of the response to an HTTP \c GET \c /metrics, see \c --metrics.
+using ServerMetricsHandler = std::function<std::string()>;
+//-----------------------------------------------------------------------------
+
+/// \brief Run C++ Insights as a long-lived server.
+///
+/// The \p address is either a path for a Unix domain socket or a \c host:port pair for a TCP socket. Up to \p jobs
+/// connections are served in parallel, a single connection can carry as many requests as the client likes. Each request
+/// is handed to \p handler and the result is written back to the client. With more than one job \p handler is called
+/// from multiple threads at the same time.
+///
+/// With \p metrics, a connection which starts with an HTTP \c GET instead of a frame gets the text of \p metrics for
+/// the path \c /metrics and a 404 for every other path. The connection is closed afterwards.
+///
+/// \returns The exit code for \c main, the function returns only in case of an error.
+int RunServer(const std::string&          address,
+              const unsigned              jobs,
+              const ServerRequestHandler& handler,
+              const ServerMetricsHandler& metrics = {});
+//-----------------------------------------------------------------------------
+
+/// \brief Same as \ref RunServer, but each connection is served by a child process forked from this one.
+///
+/// The children start with everything the server initialized before, without paying for it again, and a crashing
+/// request does not take the server down. Up to \p jobs children run at the same time.
+int RunForkServer(const std::string& address, const unsigned jobs, const ServerRequestHandler& handler);
+//-----------------------------------------------------------------------------
+
+/// \brief Same as \ref RunServer, but the requests are transformed by a pool of \p jobs worker processes.
+///
+/// The workers are forked from this process once at the start and then serve one request after another, they keep
+/// their warm caches between requests. The connections are served by threads of this process, which pass each request
+/// to an idle worker over a socket pair. A worker which crashes is replaced right away by a new one forked from this
+/// process, the request gets a response with the return code 128 plus the signal and all other requests keep going.
+///
+/// With \p workerMetrics, the path \c /metrics reports the shared and private resident set of each worker, see
+/// \ref RunServer. The metrics of the requests stay in the workers.
+int RunWorkerPool(const std::string&          address,
+                  const unsigned              jobs,
+                  const ServerRequestHandler& handler,
+                  const bool                  workerMetrics = false);
+//-----------------------------------------------------------------------------
+
+/// \brief Handles a request of \ref RunScheduledServer. Once \p cancelled is set, the handler should stop early, see
+/// \c CancellationScope.
+using ServerCancellableHandler = std::function<ServerResponse(const ServerRequest&, const std::atomic<bool>& cancelled)>;
+
+/// \brief Estimates the cost of a request for \ref RunScheduledServer. Called from multiple threads at the same time.
+using ServerCostEstimator = std::function<uint64_t(const ServerRequest&)>;
+
+/// \brief How \ref RunScheduledServer orders the requests.
+struct ServerSchedule
+{
+    ServerCostEstimator estimate{};
+    uint64_t            interactiveCost{};  //!< The highest estimated cost of a request of the interactive lane.
+
+    /// \brief The tenants with a share other than 1.
+    std::vector<std::pair<std::string, unsigned>> weights{};
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Same as \ref RunServer, but the requests are scheduled on \p jobs threads instead of being served in the order
+/// the connections came in.
+///
+/// A connection is read and written by a thread of its own, which hands each request to the scheduler and waits for its
+/// response. A request goes to the interactive lane, if its estimated cost is at most \c interactiveCost, and to the
+/// batch lane otherwise or if it asks for it with the option \c lane=batch. Within a lane, the tenants share the threads
+/// by weighted fair queuing on the estimated cost. A request names its tenant with the option \c tenant=<name>, the
+/// scheduler removes both options before \p handler sees the request. The interactive lane goes first, but while both
+/// lanes wait, every fourth request comes from the batch lane.
+///
+/// An interactive request which finds all threads busy preempts the batch request which runs the longest: it is
+/// cancelled, stops at its next deadline check and starts over later. A request is preempted at most once, after that
+/// it runs to the end.
+int RunScheduledServer(const std::string&              address,
+                       const unsigned                  jobs,
+                       const ServerCancellableHandler& handler,
+                       const ServerSchedule&           schedule,
+                       const ServerMetricsHandler&     metrics = {});
+//-----------------------------------------------------------------------------
+
+/// \brief A parsed request on its way through \ref RunPipelineServer.
+class PipelineJob
+{
+public:
+    virtual ~PipelineJob() = default;
+
+    /// \brief Generate the code of the parsed request.
+    virtual ServerResponse Finish() = 0;
+};
+
+/// \brief Parses a request for \ref RunPipelineServer. Returns \c nullptr, if the request is already answered with
+/// the response it got, for example by an error or a cache hit.
+using ServerParseHandler = std::function<std::unique_ptr<PipelineJob>(const ServerRequest&, ServerResponse&)>;
+//-----------------------------------------------------------------------------
+
+/// \brief Same as \ref RunServer, but the requests pass through a pipeline of stages.
+///
+/// A single I/O thread accepts the connections and reads the requests. They go to \p parseJobs threads which call \p
+/// parse, then the parsed requests go to \p codegenJobs threads which call \ref PipelineJob::Finish. A writer thread
+/// sends the responses. The queues between the stages are bounded, a full queue stops the stage before it. A job is
+/// destroyed by the thread which parsed it, as it may refer to the state of that thread.
+///
+/// With \p metrics the text for \c /metrics gets the depth of each queue and the busy time of each stage in addition.
+int RunPipelineServer(const std::string&          address,
+                      const unsigned              parseJobs,
+                      const unsigned              codegenJobs,
+                      const ServerParseHandler&   parse,
+                      const ServerMetricsHandler& metrics = {});
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_SERVER_H */
@@ -0,0 +1,173 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/AST/StmtCXX.h"
+#include "llvm/ADT/SetVector.h"
+
+#include "InsightsHelpers.h"
+#include "InsightsSoaPreview.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief How the body of a range-based for-loop uses its loop variable.
+struct LoopVarUse
+{
+    llvm::SetVector<const FieldDecl*> fields{};   //!< The fields accessed, in the order of their first access.
+    bool                              asWhole{};  //!< Whether the loop variable is used other than for a field.
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static void FindLoopVarUse(const Stmt* stmt, const VarDecl& loopVar, LoopVarUse& use)
+{
+    if(not stmt) {
+        return;
+    }
+
+    if(const auto* member = dyn_cast<MemberExpr>(stmt)) {
+        const auto* base  = dyn_cast<DeclRefExpr>(member->getBase()->IgnoreParenImpCasts());
+        const auto* field = dyn_cast<FieldDecl>(member->getMemberDecl());
+
+        if(base and field and (base->getDecl() == &loopVar)) {
+            use.fields.insert(field);
+            return;
+        }
+
+    } else if(const auto* declRef = dyn_cast<DeclRefExpr>(stmt); declRef and (declRef->getDecl() == &loopVar)) {
+        use.asWhole = true;
+        return;
+    }
+
+    for(const auto* child : stmt->children()) {
+        FindLoopVarUse(child, loopVar, use);
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The name of the range of \p rangeForStmt, if it is a variable or a field, otherwise \c range.
+static std::string GetRangeName(const CXXForRangeStmt& rangeForStmt)
+{
+    const auto* rangeInit = rangeForStmt.getRangeInit()->IgnoreParenImpCasts();
+
+    if(const auto* declRef = dyn_cast<DeclRefExpr>(rangeInit)) {
+        return GetName(*declRef);
+
+    } else if(const auto* member = dyn_cast<MemberExpr>(rangeInit)) {
+        return GetName(*member->getMemberDecl());
+    }
+
+    return "range";
+}
+//-----------------------------------------------------------------------------
+
+void InsertSoaPreview(OutputFormatHelper& outputFormatHelper, const CXXForRangeStmt& rangeForStmt)
+{
+    const auto* loopVar   = rangeForStmt.getLoopVariable();
+    const auto* rangeInit = rangeForStmt.getRangeInit();
+
+    if(not loopVar or not rangeInit or rangeInit->isTypeDependent() or loopVar->getType()->isDependentType()) {
+        return;
+    }
+
+    const auto& ctx       = loopVar->getASTContext();
+    const auto  rangeType = rangeInit->getType().getNonReferenceType();
+    QualType    elementType{};
+    std::string count{};  // The number of elements of a C array, empty for a std::vector.
+
+    if(const auto* arrayType = ctx.getAsConstantArrayType(rangeType)) {
+        elementType = arrayType->getElementType();
+        count       = std::to_string(arrayType->getSize().getZExtValue());
+
+    } else if(const auto* vector = dyn_cast_or_null<ClassTemplateSpecializationDecl>(rangeType->getAsCXXRecordDecl());
+              vector and vector->isInStdNamespace() and vector->getIdentifier() and ("vector" == vector->getName())) {
+        elementType = vector->getTemplateArgs()[0].getAsType();
+
+    } else {
+        return;
+    }
+
+    const auto* record = elementType->getAsRecordDecl();
+
+    // A loop variable of another type converts each element, its fields are not those of the element.
+    if(not record or record->isUnion() or not record->isCompleteDefinition() or record->isInvalidDecl() or
+       not ctx.hasSameUnqualifiedType(elementType, loopVar->getType().getNonReferenceType())) {
+        return;
+    }
+
+    llvm::SmallVector<const FieldDecl*, 16> fields{};
+
+    for(const auto* field : record->fields()) {
+        // Adjacent bit-fields share their storage units, they cannot become arrays of their own.
+        if(field->isBitField()) {
+            return;
+        }
+
+        fields.push_back(field);
+    }
+
+    if(fields.empty()) {
+        return;
+    }
+
+    const std::string recordName{GetName(elementType, Unqualified::Yes)};
+    const std::string rangeName{GetRangeName(rangeForStmt)};
+
+    outputFormatHelper.AppendNewLine("/* structure of arrays for ", recordName);
+    outputFormatHelper.AppendNewLine("struct ", record->getName(), "SoA");
+    outputFormatHelper.AppendNewLine("{");
+
+    for(const auto* field : fields) {
+        if(count.empty()) {
+            outputFormatHelper.AppendNewLine("   std::vector<", GetName(field->getType()), "> ", GetName(*field), ";");
+        } else {
+            outputFormatHelper.AppendNewLine(
+                "   ", GetTypeNameAsParameter(field->getType(), StrCat(GetName(*field), "[", count, "]")), ";");
+        }
+    }
+
+    outputFormatHelper.AppendNewLine("};");
+
+    LoopVarUse use{};
+    FindLoopVarUse(rangeForStmt.getBody(), *loopVar, use);
+
+    if(use.asWhole or use.fields.empty()) {
+        outputFormatHelper.AppendNewLine(
+            "the loop uses ", GetName(*loopVar), " as a whole, it needs all fields of each element");
+        outputFormatHelper.AppendNewLine("*/");
+        return;
+    }
+
+    const std::string size{count.empty() ? StrCat(rangeName, ".", GetName(*use.fields.front()), ".size()") : count};
+
+    outputFormatHelper.AppendNewLine("for(std::size_t i = 0; i != ", size, "; ++i) {");
+
+    uint64_t soaBytes{};
+
+    for(const auto* field : use.fields) {
+        outputFormatHelper.AppendNewLine(
+            "   ", GetName(*loopVar), ".", GetName(*field), " -> ", rangeName, ".", GetName(*field), "[i]");
+
+        soaBytes += static_cast<uint64_t>(ctx.getTypeSizeInChars(field->getType()).getQuantity());
+    }
+
+    outputFormatHelper.AppendNewLine("}");
+    outputFormatHelper.AppendNewLine("bytes per iteration: ",
+                                     ctx.getTypeSizeInChars(elementType).getQuantity(),
+                                     " as array of structures, ",
+                                     soaBytes,
+                                     " as structure of arrays");
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
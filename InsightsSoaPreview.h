@@ -0,0 +1,33 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_SOA_PREVIEW_H
+#define INSIGHTS_SOA_PREVIEW_H
+
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CXXForRangeStmt;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Insert the structure of arrays for the elements \p rangeForStmt iterates over as a comment, see \c
+/// --show-soa.
+///
+/// Only loops over a \c std::vector or a C array of a class with fields are looked at. Each field becomes a \c
+/// std::vector or an array of its own. If the body uses the loop variable only to access fields, the loop follows with
+/// an index instead and the bytes each iteration touches in both layouts. Unions and classes with bit-fields are left
+/// out.
+void InsertSoaPreview(OutputFormatHelper& outputFormatHelper, const CXXForRangeStmt& rangeForStmt);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_SOA_PREVIEW_H */
@@ -0,0 +1,105 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "DPrint.h"
+#include "InsightsSourceMap.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static bool gSourceMap{};
+//-----------------------------------------------------------------------------
+
+void EnableSourceMap()
+{
+    gSourceMap = true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsSourceMapEnabled()
+{
+    return gSourceMap;
+}
+//-----------------------------------------------------------------------------
+
+void SourceMapBuilder::AppendVLQ(const int64_t value)
+{
+    static constexpr char base64[]{"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+
+    // The sign goes into the lowest bit, each digit carries 5 bits and whether another one follows.
+    auto vlq = (0 > value) ? ((static_cast<uint64_t>(-value) << 1) | 1) : (static_cast<uint64_t>(value) << 1);
+
+    do {
+        auto digit = vlq & 31;
+        vlq >>= 5;
+
+        if(0 != vlq) {
+            digit |= 32;
+        }
+
+        mMappings += base64[digit];
+    } while(0 != vlq);
+}
+//-----------------------------------------------------------------------------
+
+void SourceMapBuilder::AddSegment(const unsigned generatedLine,
+                                  const unsigned generatedColumn,
+                                  const unsigned sourceLine,
+                                  const unsigned sourceColumn)
+{
+    for(; mGeneratedLine < generatedLine; ++mGeneratedLine) {
+        mMappings += ';';
+        mGeneratedColumn = 0;
+        mLineHasSegments = false;
+    }
+
+    if(mLineHasSegments) {
+        // A segment which maps to where the previous one does adds nothing.
+        if((sourceLine == mSourceLine) and (sourceColumn == mSourceColumn)) {
+            return;
+        }
+
+        mMappings += ',';
+    }
+
+    AppendVLQ(static_cast<int64_t>(generatedColumn) - mGeneratedColumn);
+    AppendVLQ(0);  // There is only one source, the main file.
+    AppendVLQ(static_cast<int64_t>(sourceLine) - mSourceLine);
+    AppendVLQ(static_cast<int64_t>(sourceColumn) - mSourceColumn);
+
+    mGeneratedColumn = generatedColumn;
+    mSourceLine      = sourceLine;
+    mSourceColumn    = sourceColumn;
+    mLineHasSegments = true;
+}
+//-----------------------------------------------------------------------------
+
+bool SourceMapBuilder::Write(llvm::StringRef fileName, llvm::StringRef source) const
+{
+    std::error_code      ec{};
+    llvm::raw_fd_ostream out{fileName, ec, llvm::sys::fs::OF_Text};
+
+    if(ec) {
+        Error("cannot write source map '%s': %s\n", fileName, ec.message());
+        return false;
+    }
+
+    out << llvm::json::Value{llvm::json::Object{{"version", 3},
+                                                {"sources", llvm::json::Array{source}},
+                                                {"names", llvm::json::Array{}},
+                                                {"mappings", mMappings}}}
+        << '\n';
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,63 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_SOURCE_MAP_H
+#define INSIGHTS_SOURCE_MAP_H
+
+#include "clang/Basic/SourceLocation.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The code from \c offset of a buffer on was generated from the node at \c loc.
+struct SourceMark
+{
+    size_t         offset;
+    SourceLocation loc;
+};
+//-----------------------------------------------------------------------------
+
+void EnableSourceMap();
+bool IsSourceMapEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Builds the mappings of a source map in the format version 3, see \c --source-map.
+///
+/// The segments must come in the order of the generated code. Lines and columns are 0-based, columns count bytes. Each
+/// segment is stored relative to the previous one as base64 VLQ, like in the source maps of JavaScript, so the mapping
+/// of a large output stays small and a client decodes it in a single pass.
+class SourceMapBuilder
+{
+public:
+    void AddSegment(const unsigned generatedLine,
+                    const unsigned generatedColumn,
+                    const unsigned sourceLine,
+                    const unsigned sourceColumn);
+
+    /// \brief Write the source map of the generated code of \p source to \p fileName.
+    ///
+    /// \returns \c false, if the file could not be written.
+    bool Write(llvm::StringRef fileName, llvm::StringRef source) const;
+
+private:
+    void AppendVLQ(const int64_t value);
+
+    std::string mMappings{};
+    unsigned    mGeneratedLine{};
+    unsigned    mGeneratedColumn{};  //!< The column of the last segment in the current generated line.
+    unsigned    mSourceLine{};       //!< The source line of the last segment.
+    unsigned    mSourceColumn{};     //!< The source column of the last segment.
+    bool        mLineHasSegments{};
+};
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_SOURCE_MAP_H */
@@ -0,0 +1,243 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Attr.h"
+#include "clang/AST/DeclCXX.h"
+
+#include "InsightsHelpers.h"
+#include "InsightsSpecialMembers.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+enum class SpecialMember
+{
+    DefaultConstructor,
+    CopyConstructor,
+    MoveConstructor,
+    CopyAssignment,
+    MoveAssignment,
+    Destructor,
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static const char* GetSpecialMemberName(const SpecialMember member)
+{
+    switch(member) {
+        case SpecialMember::DefaultConstructor: return "default constructor";
+        case SpecialMember::CopyConstructor: return "copy constructor";
+        case SpecialMember::MoveConstructor: return "move constructor";
+        case SpecialMember::CopyAssignment: return "copy assignment";
+        case SpecialMember::MoveAssignment: return "move assignment";
+        case SpecialMember::Destructor: return "destructor";
+    }
+
+    return "";
+}
+//-----------------------------------------------------------------------------
+
+static bool IsTrivial(const CXXRecordDecl& record, const SpecialMember member)
+{
+    switch(member) {
+        case SpecialMember::DefaultConstructor: return record.hasTrivialDefaultConstructor();
+        case SpecialMember::CopyConstructor: return record.hasTrivialCopyConstructor();
+        case SpecialMember::MoveConstructor: return record.hasTrivialMoveConstructor();
+        case SpecialMember::CopyAssignment: return record.hasTrivialCopyAssignment();
+        case SpecialMember::MoveAssignment: return record.hasTrivialMoveAssignment();
+        case SpecialMember::Destructor: return record.hasTrivialDestructor();
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p record has \p member at all, declared or still to be declared implicitly.
+static bool HasSpecialMember(const CXXRecordDecl& record, const SpecialMember member)
+{
+    switch(member) {
+        case SpecialMember::DefaultConstructor: return record.hasDefaultConstructor();
+        case SpecialMember::CopyConstructor: return true;
+        case SpecialMember::MoveConstructor: return record.hasMoveConstructor();
+        case SpecialMember::CopyAssignment: return true;
+        case SpecialMember::MoveAssignment: return record.hasMoveAssignment();
+        case SpecialMember::Destructor: return true;
+    }
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The declaration of \p member in \p record, null if it is not declared yet.
+static const CXXMethodDecl* GetSpecialMember(const CXXRecordDecl& record, const SpecialMember member)
+{
+    if(SpecialMember::Destructor == member) {
+        return record.getDestructor();
+    }
+
+    for(const auto* method : record.methods()) {
+        const auto* ctor = dyn_cast_or_null<CXXConstructorDecl>(method);
+
+        switch(member) {
+            case SpecialMember::DefaultConstructor:
+                if(ctor and ctor->isDefaultConstructor()) {
+                    return ctor;
+                }
+                break;
+            case SpecialMember::CopyConstructor:
+                if(ctor and ctor->isCopyConstructor()) {
+                    return ctor;
+                }
+                break;
+            case SpecialMember::MoveConstructor:
+                if(ctor and ctor->isMoveConstructor()) {
+                    return ctor;
+                }
+                break;
+            case SpecialMember::CopyAssignment:
+                if(method->isCopyAssignmentOperator()) {
+                    return method;
+                }
+                break;
+            case SpecialMember::MoveAssignment:
+                if(method->isMoveAssignmentOperator()) {
+                    return method;
+                }
+                break;
+            case SpecialMember::Destructor: break;
+        }
+    }
+
+    return nullptr;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Why \p member of \p record is not trivial.
+static std::string GetNonTrivialReason(const CXXRecordDecl& record, const SpecialMember member)
+{
+    const auto* method = GetSpecialMember(record, member);
+    const bool  isDestructor{SpecialMember::Destructor == member};
+
+    if(method and method->isUserProvided()) {
+        return "user-provided";
+
+    } else if(isDestructor and method and method->isVirtual()) {
+        return "virtual";
+
+    } else if(not isDestructor and record.isPolymorphic()) {
+        return "the class has virtual functions";
+
+    } else if(not isDestructor and record.getNumVBases()) {
+        return StrCat("virtual base ", GetName(record.vbases_begin()->getType()));
+    }
+
+    // A member of a base or field which is not there, like the move constructor of a class with a user-declared copy
+    // constructor, is replaced by the one of the copy.
+    auto isNonTrivial = [&](QualType type) {
+        const auto* other = type->getBaseElementTypeUnsafe()->getAsCXXRecordDecl();
+
+        if(not other or not other->hasDefinition()) {
+            return false;
+        }
+
+        if(not HasSpecialMember(*other, member)) {
+            if(SpecialMember::MoveConstructor == member) {
+                return not IsTrivial(*other, SpecialMember::CopyConstructor);
+
+            } else if(SpecialMember::MoveAssignment == member) {
+                return not IsTrivial(*other, SpecialMember::CopyAssignment);
+            }
+        }
+
+        return not IsTrivial(*other, member);
+    };
+
+    const char* name{GetSpecialMemberName(member)};
+
+    for(const auto& base : record.bases()) {
+        if(isNonTrivial(base.getType())) {
+            return StrCat("base ", GetName(base.getType()), " has a non-trivial ", name);
+        }
+    }
+
+    for(const auto* field : record.fields()) {
+        if((SpecialMember::DefaultConstructor == member) and field->hasInClassInitializer()) {
+            return StrCat("member ", GetName(*field), " has a default member initializer");
+
+        } else if(isNonTrivial(field->getType())) {
+            return StrCat("member ", GetName(*field), " has a non-trivial ", name);
+        }
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+static std::string GetSpecialMemberState(const CXXRecordDecl& record, const SpecialMember member)
+{
+    const auto* method = GetSpecialMember(record, member);
+
+    if(method and method->isDeleted()) {
+        return "deleted";
+
+    } else if(not HasSpecialMember(record, member)) {
+        if(SpecialMember::MoveConstructor == member) {
+            return "not declared, the copy constructor is used";
+
+        } else if(SpecialMember::MoveAssignment == member) {
+            return "not declared, the copy assignment is used";
+        }
+
+        return "none";
+
+    } else if(IsTrivial(record, member)) {
+        return "trivial";
+    }
+
+    if(const auto reason = GetNonTrivialReason(record, member); not reason.empty()) {
+        return StrCat("non-trivial, ", reason);
+    }
+
+    return "non-trivial";
+}
+//-----------------------------------------------------------------------------
+
+void InsertSpecialMemberSummary(OutputFormatHelper& outputFormatHelper, const CXXRecordDecl& record)
+{
+    if(record.isDependentType() or not record.hasDefinition() or record.isInvalidDecl()) {
+        return;
+    }
+
+    outputFormatHelper.AppendNewLine("/* special members");
+
+    for(const auto member : {SpecialMember::DefaultConstructor,
+                             SpecialMember::CopyConstructor,
+                             SpecialMember::MoveConstructor,
+                             SpecialMember::CopyAssignment,
+                             SpecialMember::MoveAssignment,
+                             SpecialMember::Destructor}) {
+        outputFormatHelper.AppendNewLine(
+            "   ", GetSpecialMemberName(member), ": ", GetSpecialMemberState(record, member));
+    }
+
+    const auto& ctx = record.getASTContext();
+    const bool  triviallyCopyable{ctx.getRecordType(&record).isTriviallyCopyableType(ctx)};
+    // clang relocates a trivially copyable class and one with [[clang::trivial_abi]] with a plain copy of the bytes.
+    const bool triviallyRelocatable{triviallyCopyable or record.hasAttr<TrivialABIAttr>()};
+
+    outputFormatHelper.AppendNewLine("   trivially copyable: ",
+                                     triviallyCopyable ? "yes" : "no",
+                                     ", trivially relocatable: ",
+                                     triviallyRelocatable ? "yes" : "no");
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,31 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_SPECIAL_MEMBERS_H
+#define INSIGHTS_SPECIAL_MEMBERS_H
+
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CXXRecordDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Insert a comment with the six special members of \p record, see \c --show-special-members.
+///
+/// Each member is trivial, non-trivial with the reason, deleted or not there. The reason is the first one found of:
+/// user-provided, virtual functions or a virtual base of the class, or a base or a member whose member of the same
+/// kind is non-trivial. The last line tells whether the class is trivially copyable and trivially relocatable.
+void InsertSpecialMemberSummary(OutputFormatHelper& outputFormatHelper, const CXXRecordDecl& record);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_SPECIAL_MEMBERS_H */
@@ -0,0 +1,173 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/ExprCXX.h"
+#include "llvm/Support/MathExtras.h"
+
+#include "Insights.h"
+#include "InsightsHelpers.h"
+#include "InsightsStackFrame.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief The locals of a function found so far, see \ref InsertStackFrame.
+struct StackFrame
+{
+    uint64_t                          size{};         //!< In bytes, with the padding for the alignment of each local.
+    uint64_t                          variables{};    //!< The number of local variables.
+    uint64_t                          temporaries{};  //!< The number of materialized temporaries.
+    llvm::SmallVector<std::string, 4> flagged{};      //!< The large arrays, VLAs and calls of alloca.
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief Add an object of \p type to \p frame. A reference takes the space of a pointer.
+static void AddObject(const ASTContext& ctx, QualType type, StackFrame& frame)
+{
+    if(type->isReferenceType()) {
+        type = ctx.VoidPtrTy;
+    }
+
+    if(type->isIncompleteType() or type->isDependentType() or type->isVariableArrayType()) {
+        return;
+    }
+
+    frame.size = llvm::alignTo(frame.size, static_cast<uint64_t>(ctx.getTypeAlignInChars(type).getQuantity())) +
+                 static_cast<uint64_t>(ctx.getTypeSizeInChars(type).getQuantity());
+}
+//-----------------------------------------------------------------------------
+
+static void AddVariable(const ASTContext& ctx, const VarDecl& var, StackFrame& frame)
+{
+    if(not var.hasLocalStorage() or isa<ParmVarDecl>(var)) {
+        return;
+    }
+
+    const auto type = var.getType();
+    ++frame.variables;
+
+    if(type->isVariableArrayType()) {
+        frame.flagged.push_back(StrCat("variable length array ", GetName(var)));
+
+    } else if(type->isConstantArrayType() and not type->isDependentType() and not type->isIncompleteType()) {
+        if(const auto size = static_cast<uint64_t>(ctx.getTypeSizeInChars(type).getQuantity());
+           LARGE_STACK_ARRAY <= size) {
+            frame.flagged.push_back(StrCat("large array ", GetName(var), ": ", size, " bytes"));
+        }
+    }
+
+    AddObject(ctx, type, frame);
+
+    // The bindings of a tuple-like type refer to variables of their own.
+    if(const auto* decomposition = dyn_cast<DecompositionDecl>(&var)) {
+        for(const auto* binding : decomposition->bindings()) {
+            if(const auto* holdingVar = binding->getHoldingVar()) {
+                AddVariable(ctx, *holdingVar, frame);
+            }
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p call is a call of \c alloca or one of its builtins.
+static bool IsAllocaCall(const CallExpr& call)
+{
+    const auto* callee = call.getDirectCallee();
+
+    if(not callee or not callee->getIdentifier()) {
+        return false;
+    }
+
+    const auto name = callee->getName();
+
+    return (name == "alloca") or (name == "_alloca") or name.startswith("__builtin_alloca");
+}
+//-----------------------------------------------------------------------------
+
+static void AddLocals(const ASTContext& ctx, const Stmt* stmt, StackFrame& frame)
+{
+    if(not stmt) {
+        return;
+    }
+
+    if(const auto* lambda = dyn_cast<LambdaExpr>(stmt)) {
+        // The closure object is a temporary or a variable of this frame, the body is a frame of its own.
+        for(const auto* init : lambda->capture_inits()) {
+            AddLocals(ctx, init, frame);
+        }
+
+        return;
+
+    } else if(const auto* declStmt = dyn_cast<DeclStmt>(stmt)) {
+        for(const auto* decl : declStmt->decls()) {
+            if(const auto* var = dyn_cast<VarDecl>(decl)) {
+                AddVariable(ctx, *var, frame);
+            }
+        }
+
+    } else if(const auto* temporary = dyn_cast<MaterializeTemporaryExpr>(stmt)) {
+        ++frame.temporaries;
+        AddObject(ctx, temporary->getType().getNonReferenceType(), frame);
+
+    } else if(const auto* call = dyn_cast<CallExpr>(stmt); call and IsAllocaCall(*call)) {
+        frame.flagged.push_back("call of alloca");
+    }
+
+    for(const auto* child : stmt->children()) {
+        AddLocals(ctx, child, frame);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void InsertStackFrame(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function)
+{
+    if(not function.hasBody() or function.isDependentContext()) {
+        return;
+    }
+
+    const auto& ctx = function.getASTContext();
+    StackFrame  frame{};
+
+    AddLocals(ctx, function.getBody(), frame);
+
+    const uint64_t threshold{GetInsightsOptions().stackFrameThreshold};
+
+    outputFormatHelper.Append("/* stack frame: ",
+                              frame.size,
+                              " bytes in ",
+                              frame.variables,
+                              (1 == frame.variables) ? " variable" : " variables");
+
+    if(0 != frame.temporaries) {
+        outputFormatHelper.Append(" and ", frame.temporaries, (1 == frame.temporaries) ? " temporary" : " temporaries");
+    }
+
+    if(threshold < frame.size) {
+        outputFormatHelper.Append(", exceeds ", threshold, " bytes");
+    }
+
+    if(frame.flagged.empty()) {
+        outputFormatHelper.AppendNewLine(" */");
+        return;
+    }
+
+    outputFormatHelper.AppendNewLine();
+
+    for(const auto& flagged : frame.flagged) {
+        outputFormatHelper.AppendNewLine("   ", flagged);
+    }
+
+    outputFormatHelper.AppendNewLine("*/");
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
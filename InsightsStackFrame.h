@@ -0,0 +1,38 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_STACK_FRAME_H
+#define INSIGHTS_STACK_FRAME_H
+
+#include <cstdint>
+
+#include "OutputFormatHelper.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class FunctionDecl;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief A local array of this many bytes is flagged by \c --show-stack-frame.
+constexpr uint64_t LARGE_STACK_ARRAY{1024};
+
+/// \brief Insert the estimated stack frame of \p function as a comment, see \c --show-stack-frame.
+///
+/// The estimate adds up all local variables of the body with their alignment, including the hidden ones like \c
+/// __range1 of a range-based for-loop or the object of a structured binding, and the materialized temporaries. A
+/// compiler can let variables of different scopes share a slot or keep them in registers, so it is an upper bound of
+/// the locals without the spill slots and the call overhead. Large arrays, variable length arrays and \c alloca are
+/// listed, a frame above \c --stack-frame-threshold is marked. The bodies of lambdas are frames of their own.
+void InsertStackFrame(OutputFormatHelper& outputFormatHelper, const FunctionDecl& function);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_STACK_FRAME_H */
@@ -0,0 +1,607 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "DPrint.h"
+#include "Insights.h"
+#include "InsightsStdioProtocol.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Upper limit for the content of a single message, same as for a frame in server mode.
+static constexpr size_t MAX_MESSAGE_SIZE{64 * 1024 * 1024};
+//-----------------------------------------------------------------------------
+
+/// \brief The error codes of JSON-RPC and the Language Server Protocol.
+enum class ErrorCode : int64_t
+{
+    ParseError       = -32700,
+    InvalidRequest   = -32600,
+    MethodNotFound   = -32601,
+    InvalidParams    = -32602,
+    RequestCancelled = -32800,
+};
+//-----------------------------------------------------------------------------
+
+/// \brief Read the content of the next message, \c false at the end of \p input or for a malformed header.
+static bool ReadMessage(std::istream& input, std::string& content)
+{
+    std::string line{};
+    size_t      length{};
+    bool        hasLength{};
+
+    while(std::getline(input, line)) {
+        StringRef header{line};
+        header = header.rtrim('\r');
+
+        if(header.empty()) {
+            // Stray empty lines between two messages are fine, an empty line ends the header of a message.
+            if(hasLength) {
+                break;
+            }
+
+            continue;
+        }
+
+        if(header.startswith_lower("content-length:")) {
+            if(header.drop_front(15).trim().getAsInteger(10, length) or (length > MAX_MESSAGE_SIZE)) {
+                Error("insights stdio protocol: invalid Content-Length\n");
+                return false;
+            }
+
+            hasLength = true;
+        }
+
+        // All other headers, like Content-Type, are ignored.
+    }
+
+    if(not hasLength) {
+        return false;
+    }
+
+    content.resize(length);
+    input.read(content.data(), static_cast<std::streamsize>(length));
+
+    return static_cast<size_t>(input.gcount()) == length;
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief The last result of a document, the base for the edits of the next one.
+struct TransformResult
+{
+    std::string                id{};
+    std::string                code{};
+    std::vector<OutputSegment> segments{};
+};
+
+/// \brief A transform waiting for its turn or running.
+struct TransformJob
+{
+    llvm::json::Value                     id;
+    std::string                           document;
+    uint64_t                              version;
+    ServerRequest                         request;
+    std::shared_ptr<ServerRequestHandler> handler;     //!< Keeps the state of the document alive after a close.
+    std::shared_ptr<TransformResult>      lastResult;  //!< Used only by the thread which runs the transforms.
+    std::string                           previousResultId;
+    std::atomic<bool>                     cancelled{};
+    bool                                  started{};
+};
+
+class StdioProtocol
+{
+public:
+    explicit StdioProtocol(const StdioDocumentFactory& makeDocumentHandler)
+    : mMakeDocumentHandler{makeDocumentHandler}
+    {
+    }
+
+    int Run();
+
+private:
+    struct Document
+    {
+        std::vector<std::string>              arguments{};
+        std::string                           text{};
+        uint64_t                              version{};
+        std::shared_ptr<ServerRequestHandler> handler{};
+        std::shared_ptr<TransformResult>      lastResult{};
+    };
+
+    using Job = std::shared_ptr<TransformJob>;
+
+    const StdioDocumentFactory& mMakeDocumentHandler;
+    llvm::StringMap<Document>   mDocuments{};  //!< Used only by the thread which reads the messages.
+
+    std::mutex              mMutex{};
+    std::condition_variable mCondition{};
+    std::list<Job>          mJobs{};  //!< The queued and the running transforms, in the order they came in.
+    bool                    mDone{};
+
+    std::mutex mOutputMutex{};
+
+    uint64_t mResultIds{};  //!< Used only by the thread which runs the transforms.
+
+    void Work();
+
+    /// \brief Handle a single message.
+    ///
+    /// \returns \c false, if the protocol ends.
+    bool Dispatch(const llvm::json::Object& message);
+
+    /// \brief Cancel all pending transforms for which \p matches is \c true.
+    template<typename Predicate>
+    void Cancel(Predicate matches);
+
+    void WriteMessage(llvm::json::Object message);
+    void WriteResult(const llvm::json::Value* id, llvm::json::Value result);
+    void WriteError(const llvm::json::Value* id, const ErrorCode code, llvm::StringRef message);
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+void StdioProtocol::WriteMessage(llvm::json::Object message)
+{
+    message["jsonrpc"] = "2.0";
+
+    std::string              content{};
+    llvm::raw_string_ostream stream{content};
+    stream << llvm::json::Value{std::move(message)};
+    stream.flush();
+
+    std::lock_guard lock{mOutputMutex};
+
+    llvm::outs() << "Content-Length: " << content.size() << "\r\n\r\n" << content;
+    llvm::outs().flush();
+}
+//-----------------------------------------------------------------------------
+
+void StdioProtocol::WriteResult(const llvm::json::Value* id, llvm::json::Value result)
+{
+    // A notification gets no response.
+    if(nullptr == id) {
+        return;
+    }
+
+    WriteMessage(llvm::json::Object{{"id", *id}, {"result", std::move(result)}});
+}
+//-----------------------------------------------------------------------------
+
+void StdioProtocol::WriteError(const llvm::json::Value* id, const ErrorCode code, llvm::StringRef message)
+{
+    // Errors of a notification would go unnoticed otherwise.
+    if(nullptr == id) {
+        Error("insights stdio protocol: %s\n", message.str().c_str());
+        return;
+    }
+
+    WriteMessage(llvm::json::Object{
+        {"id", *id},
+        {"error", llvm::json::Object{{"code", static_cast<int64_t>(code)}, {"message", message.str()}}}});
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Let \p segments describe \p code, as a single part without a key, if they do not.
+static void NormalizeSegments(const std::string& code, std::vector<OutputSegment>& segments)
+{
+    size_t length{};
+
+    for(const auto& segment : segments) {
+        length += segment.length;
+    }
+
+    if(length != code.size()) {
+        segments.assign(1, OutputSegment{static_cast<unsigned>(code.size()), {}});
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The offset of each segment in \p segments, followed by the end of the last one.
+static std::vector<size_t> GetSegmentOffsets(const std::vector<OutputSegment>& segments)
+{
+    std::vector<size_t> offsets{};
+    offsets.reserve(segments.size() + 1);
+
+    size_t offset{};
+
+    for(const auto& segment : segments) {
+        offsets.push_back(offset);
+        offset += segment.length;
+    }
+
+    offsets.push_back(offset);
+
+    return offsets;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The edits which turn the code of \p previous into the one of \p current, in ascending order.
+///
+/// The segments are compared, not the code. A segment with a key is the same as the one with the same key in \p
+/// previous. Only the ones without a key, the parts between the declarations, are compared by their text.
+static llvm::json::Array GetEdits(const TransformResult& previous, const TransformResult& current)
+{
+    const auto& oldSegments = previous.segments;
+    const auto& newSegments = current.segments;
+    const auto  oldOffsets  = GetSegmentOffsets(oldSegments);
+    const auto  newOffsets  = GetSegmentOffsets(newSegments);
+
+    auto getKeys = [](const std::vector<OutputSegment>& segments) {
+        llvm::StringMap<size_t> keys{};
+
+        for(size_t i = 0; i < segments.size(); ++i) {
+            if(not segments[i].key.empty()) {
+                keys.try_emplace(segments[i].key, i);
+            }
+        }
+
+        return keys;
+    };
+
+    const auto oldKeys = getKeys(oldSegments);
+    const auto newKeys = getKeys(newSegments);
+
+    auto isSame = [&](const size_t i, const size_t k) {
+        const auto& oldSegment = oldSegments[i];
+        const auto& newSegment = newSegments[k];
+
+        if((oldSegment.length != newSegment.length) or (oldSegment.key != newSegment.key)) {
+            return false;
+        }
+
+        return not oldSegment.key.empty() or (StringRef{previous.code}.substr(oldOffsets[i], oldSegment.length) ==
+                                              StringRef{current.code}.substr(newOffsets[k], newSegment.length));
+    };
+
+    llvm::json::Array edits{};
+    size_t            i{};
+    size_t            k{};
+    size_t            editBegin{};     // The first segment of the pending edit in previous.
+    size_t            newEditBegin{};  // The first segment of the pending edit in current.
+
+    auto addEdit = [&] {
+        if((editBegin == i) and (newEditBegin == k)) {
+            return;
+        }
+
+        edits.push_back(llvm::json::Object{
+            {"offset", static_cast<int64_t>(oldOffsets[editBegin])},
+            {"length", static_cast<int64_t>(oldOffsets[i] - oldOffsets[editBegin])},
+            {"text", current.code.substr(newOffsets[newEditBegin], newOffsets[k] - newOffsets[newEditBegin])}});
+    };
+
+    while(k < newSegments.size()) {
+        if((i < oldSegments.size()) and isSame(i, k)) {
+            addEdit();
+
+            editBegin    = ++i;
+            newEditBegin = ++k;
+            continue;
+        }
+
+        // An unchanged declaration further down, everything in between is gone.
+        if(const auto it = oldKeys.find(newSegments[k].key); (oldKeys.end() != it) and (it->second > i)) {
+            i = it->second;
+            continue;
+        }
+
+        // The segment of previous got replaced, unless it comes later in current.
+        if(i < oldSegments.size()) {
+            const auto it = newKeys.find(oldSegments[i].key);
+
+            if((newKeys.end() == it) or (it->second < k)) {
+                ++i;
+            }
+        }
+
+        ++k;
+    }
+
+    i = oldSegments.size();
+    addEdit();
+
+    return edits;
+}
+//-----------------------------------------------------------------------------
+
+template<typename Predicate>
+void StdioProtocol::Cancel(Predicate matches)
+{
+    std::vector<Job> cancelled{};
+
+    {
+        std::lock_guard lock{mMutex};
+
+        for(auto it = mJobs.begin(); it != mJobs.end();) {
+            auto& job = *it;
+
+            if(not matches(*job)) {
+                ++it;
+                continue;
+            }
+
+            job->cancelled = true;
+
+            // A running transform notices the flag and responds on its own.
+            if(job->started) {
+                ++it;
+            } else {
+                cancelled.push_back(std::move(job));
+                it = mJobs.erase(it);
+            }
+        }
+    }
+
+    for(const auto& job : cancelled) {
+        WriteError(&job->id, ErrorCode::RequestCancelled, "cancelled");
+    }
+}
+//-----------------------------------------------------------------------------
+
+void StdioProtocol::Work()
+{
+    for(;;) {
+        Job job{};
+
+        {
+            std::unique_lock lock{mMutex};
+
+            auto next = [&] {
+                return std::find_if(mJobs.begin(), mJobs.end(), [](const Job& queued) { return not queued->started; });
+            };
+
+            mCondition.wait(lock, [&] { return mDone or (mJobs.end() != next()); });
+
+            if(const auto it = next(); mJobs.end() != it) {
+                job          = *it;
+                job->started = true;
+
+            } else {
+                return;
+            }
+        }
+
+        ServerResponse response{};
+
+        {
+            CancellationScope cancellationScope{job->cancelled};
+            response = (*job->handler)(job->request);
+        }
+
+        {
+            std::lock_guard lock{mMutex};
+            mJobs.remove(job);
+        }
+
+        if(job->cancelled) {
+            WriteError(&job->id, ErrorCode::RequestCancelled, "cancelled");
+            continue;
+        }
+
+        TransformResult current{std::to_string(++mResultIds), std::move(response.output), std::move(response.segments)};
+        NormalizeSegments(current.code, current.segments);
+
+        llvm::json::Object result{{"returnCode", response.returnCode},
+                                  {"diagnostics", std::move(response.diagnostics)},
+                                  {"version", static_cast<int64_t>(job->version)},
+                                  {"resultId", current.id}};
+
+        // The client holds the previous result, it only needs what changed.
+        if(not job->previousResultId.empty() and (job->previousResultId == job->lastResult->id)) {
+            result["edits"] = GetEdits(*job->lastResult, current);
+        } else {
+            result["code"] = current.code;
+        }
+
+        *job->lastResult = std::move(current);
+
+        WriteResult(&job->id, std::move(result));
+    }
+}
+//-----------------------------------------------------------------------------
+
+bool StdioProtocol::Dispatch(const llvm::json::Object& message)
+{
+    const auto* id     = message.get("id");
+    const auto  method = message.getString("method");
+
+    if(not method) {
+        WriteError(id, ErrorCode::InvalidRequest, "missing \"method\"");
+        return true;
+    }
+
+    if("exit" == *method) {
+        WriteResult(id, nullptr);
+        return false;
+    }
+
+    static const llvm::json::Object noParams{};
+    const auto*                     params = message.getObject("params");
+
+    if(nullptr == params) {
+        params = &noParams;
+    }
+
+    if("cancel" == *method) {
+        if(const auto* cancelId = params->get("id")) {
+            Cancel([&](const TransformJob& job) { return job.id == *cancelId; });
+            WriteResult(id, nullptr);
+        } else {
+            WriteError(id, ErrorCode::InvalidParams, "missing \"id\"");
+        }
+
+        return true;
+    }
+
+    const auto name = params->getString("document");
+
+    if(not name) {
+        WriteError(id, ErrorCode::InvalidParams, "missing \"document\"");
+        return true;
+    }
+
+    auto cancelDocument = [&] { Cancel([&](const TransformJob& job) { return job.document == *name; }); };
+
+    if("open" == *method) {
+        const auto text = params->getString("text");
+
+        if(not text) {
+            WriteError(id, ErrorCode::InvalidParams, "missing \"text\"");
+            return true;
+        }
+
+        std::vector<std::string> arguments{};
+
+        if(const auto* args = params->getArray("arguments")) {
+            for(const auto& arg : *args) {
+                if(const auto str = arg.getAsString()) {
+                    arguments.push_back(str->str());
+                } else {
+                    WriteError(id, ErrorCode::InvalidParams, "\"arguments\" must be an array of strings");
+                    return true;
+                }
+            }
+        }
+
+        // Opening a document twice starts it over.
+        cancelDocument();
+
+        mDocuments[*name] = {std::move(arguments),
+                             text->str(),
+                             0,
+                             std::make_shared<ServerRequestHandler>(mMakeDocumentHandler()),
+                             std::make_shared<TransformResult>()};
+
+        WriteResult(id, nullptr);
+        return true;
+    }
+
+    const auto document = mDocuments.find(*name);
+
+    if(mDocuments.end() == document) {
+        WriteError(id, ErrorCode::InvalidParams, "document is not open");
+        return true;
+    }
+
+    if("update" == *method) {
+        const auto text = params->getString("text");
+
+        if(not text) {
+            WriteError(id, ErrorCode::InvalidParams, "missing \"text\"");
+            return true;
+        }
+
+        cancelDocument();
+
+        document->second.text = text->str();
+        ++document->second.version;
+
+        WriteResult(id, nullptr);
+
+    } else if("transform" == *method) {
+        if(nullptr == id) {
+            WriteError(id, ErrorCode::InvalidRequest, "transform requires an \"id\"");
+            return true;
+        }
+
+        auto job      = std::make_shared<TransformJob>();
+        job->id         = *id;
+        job->document   = name->str();
+        job->version    = document->second.version;
+        job->request    = {name->str(), document->second.arguments, document->second.text, true};
+        job->handler    = document->second.handler;
+        job->lastResult = document->second.lastResult;
+
+        if(const auto previousResultId = params->getString("previousResultId")) {
+            job->previousResultId = previousResultId->str();
+        }
+
+        {
+            std::lock_guard lock{mMutex};
+            mJobs.push_back(std::move(job));
+        }
+
+        mCondition.notify_one();
+
+    } else if("close" == *method) {
+        cancelDocument();
+        mDocuments.erase(document);
+
+        WriteResult(id, nullptr);
+
+    } else {
+        WriteError(id, ErrorCode::MethodNotFound, "unknown method");
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+int StdioProtocol::Run()
+{
+    std::thread worker{[this] { Work(); }};
+    std::string content{};
+
+    // Without a usable id the response goes out with a null id, as JSON-RPC requires.
+    const llvm::json::Value noId{nullptr};
+
+    while(ReadMessage(std::cin, content)) {
+        auto message = llvm::json::parse(content);
+
+        if(not message) {
+            WriteError(&noId, ErrorCode::ParseError, llvm::toString(message.takeError()));
+            continue;
+        }
+
+        if(const auto* object = message->getAsObject()) {
+            if(not Dispatch(*object)) {
+                break;
+            }
+
+        } else {
+            WriteError(&noId, ErrorCode::InvalidRequest, "message is not an object");
+        }
+    }
+
+    // Nobody waits for the pending transforms anymore.
+    Cancel([](const TransformJob&) { return true; });
+
+    {
+        std::lock_guard lock{mMutex};
+        mDone = true;
+    }
+
+    mCondition.notify_one();
+    worker.join();
+
+    return 0;
+}
+//-----------------------------------------------------------------------------
+
+int RunStdioProtocol(const StdioDocumentFactory& makeDocumentHandler)
+{
+    StdioProtocol protocol{makeDocumentHandler};
+
+    return protocol.Run();
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,47 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_STDIO_PROTOCOL_H
+#define INSIGHTS_STDIO_PROTOCOL_H
+
+#include <functional>
+
+#include "InsightsServer.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Creates the handler for a newly opened document, see \ref RunStdioProtocol.
+///
+/// The handler lives as long as the document is open and gets all its requests, one at a time.
+using StdioDocumentFactory = std::function<ServerRequestHandler()>;
+//-----------------------------------------------------------------------------
+
+/// \brief Serve an editor integration over stdin and stdout, see \c --stdio-protocol.
+///
+/// The messages are JSON-RPC objects framed like in the Language Server Protocol: a \c Content-Length header, an empty
+/// line and the JSON content. The methods are:
+///
+/// - \c open with \c document, \c text and optionally \c arguments, which are the same as for a \ref ServerRequest.
+/// - \c update with \c document and \c text. Pending transforms of the document are cancelled, they are stale.
+/// - \c transform with \c document. The result has the \c returnCode, the \c code, the \c diagnostics, the \c
+///   version of the document it was generated for and a \c resultId. With the \c previousResultId of the last result
+///   of the document, the result has \c edits of the previous \c code instead, see \ref OutputSegment.
+/// - \c close with \c document, which cancels its pending transforms as well.
+/// - \c cancel with the \c id of a pending transform.
+/// - \c exit.
+///
+/// The transforms run one after the other on a thread of their own, while new messages are read. A cancelled transform
+/// gets an error response, a running one stops at the next check of \ref IsDeadlineExceeded.
+///
+/// \returns The exit code for \c main, once stdin is closed or \c exit was received.
+int RunStdioProtocol(const StdioDocumentFactory& makeDocumentHandler);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_STDIO_PROTOCOL_H */
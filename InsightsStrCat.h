@@ -10,7 +10,12 @@
 
 #include "clang/AST/AST.h"
 
+#include <algorithm>
+#include <charconv>
+#include <limits>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <type_traits>
 #include <utility>
 //-----------------------------------------------------------------------------
@@ -24,6 +29,24 @@ static inline std::string ConvertToBoolString(bool b)
     return b ? std::string{"true"} : std::string{"false"};
 }
 
+/// \brief An integer formatted with \c std::to_chars into a buffer of its own, no allocation required.
+class IntegerChars
+{
+public:
+    template<typename T>
+    explicit IntegerChars(const T value)
+    : mLength{static_cast<size_t>(std::to_chars(mData, mData + sizeof(mData), value).ptr - mData)}
+    {
+    }
+
+    const char* data() const { return mData; }
+    size_t      size() const { return mLength; }
+
+private:
+    char   mData[std::numeric_limits<uint64_t>::digits10 + 2];  //!< Enough for all digits of a 64-bit value and a sign.
+    size_t mLength;
+};
+
 }  // namespace details
 
 static inline std::string ToString(const llvm::APSInt& val)
@@ -36,9 +59,9 @@ static inline std::string ToString(const llvm::APSInt& val)
 }
 //-----------------------------------------------------------------------------
 
-static inline uint64_t Normalize(const llvm::APInt& arg)
+static inline details::IntegerChars Normalize(const llvm::APInt& arg)
 {
-    return arg.getZExtValue();
+    return details::IntegerChars{arg.getZExtValue()};
 }
 //-----------------------------------------------------------------------------
 
@@ -48,9 +71,9 @@ static inline std::string Normalize(const llvm::APSInt& arg)
 }
 //-----------------------------------------------------------------------------
 
-static inline std::string Normalize(StringRef&& arg)
+static inline StringRef Normalize(StringRef&& arg)
 {
-    return arg.str();
+    return arg;
 }
 //-----------------------------------------------------------------------------
 
@@ -64,27 +87,46 @@ template<class T>
 using remove_cvref_t = typename remove_cvref<T>::type;
 //-----------------------------------------------------------------------------
 
+/// \brief Turn \p arg into something with \c data() and \c size() which \ref StrCat can append.
+///
+/// Strings are referred to, not copied. Integers are formatted in place.
 template<class T>
 static inline decltype(auto) Normalize(const T& arg)
 {
     // Handle bool's first, we like their string representation.
     if constexpr(std::is_same_v<remove_cvref_t<T>, bool>) {
-        return details::ConvertToBoolString(arg);
+        return StringRef{arg ? "true" : "false"};
 
     } else if constexpr(std::is_integral_v<T>) {
-        return std::to_string(arg);
+        return details::IntegerChars{arg};
+
+    } else if constexpr(std::is_constructible_v<StringRef, const T&>) {
+        return StringRef{arg};
 
     } else {
-        return (arg);
+        const std::string_view view{arg};
+        return StringRef{view.data(), view.size()};
     }
 }
 //-----------------------------------------------------------------------------
 
 namespace details {
+/// \brief Append all \p args to \p ret with a single allocation at most.
+///
+/// The arguments must not refer to \p ret itself.
 template<typename... Args>
 void StrCat(std::string& ret, Args&&... args)
 {
-    (ret += ... += ::clang::insights::Normalize(std::forward<Args>(args)));
+    std::apply(
+        [&](const auto&... pieces) {
+            // Keep the geometric growth of std::string, reserve alone would allocate exactly the required size.
+            if(const size_t required{ret.size() + (size_t{0} + ... + pieces.size())}; required > ret.capacity()) {
+                ret.reserve(std::max(required, 2 * ret.capacity()));
+            }
+
+            (ret.append(pieces.data(), pieces.size()), ...);
+        },
+        std::make_tuple(::clang::insights::Normalize(std::forward<Args>(args))...));
 }
 //-----------------------------------------------------------------------------
 }  // namespace details
@@ -0,0 +1,276 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
+
+#include <array>
+#include <atomic>
+#include <ctime>
+
+#include "InsightsProbes.h"
+#include "InsightsTimeReport.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static constexpr auto PHASE_COUNT{static_cast<size_t>(TimePhase::Count)};
+//-----------------------------------------------------------------------------
+
+static constexpr std::array<const char*, PHASE_COUNT> PHASE_NAMES{"Parsing",
+                                                                  "Matching",
+                                                                  "RecordDeclHandler",
+                                                                  "TemplateHandler",
+                                                                  "FunctionDeclHandler",
+                                                                  "GlobalVariableHandler",
+                                                                  "StaticAssertHandler",
+                                                                  "EndSourceFileAction"};
+//-----------------------------------------------------------------------------
+
+struct PhaseTimes
+{
+    std::atomic<uint64_t> wallNs{};
+    std::atomic<uint64_t> cpuNs{};
+    std::atomic<uint64_t> count{};
+};
+//-----------------------------------------------------------------------------
+
+static bool                                gTimeReportEnabled{};
+static bool                                gThreadPhaseTimesEnabled{};
+static std::array<PhaseTimes, PHASE_COUNT> gPhaseTimes{};
+static thread_local TimePhase              gCurrentPhase{TimePhase::Count};
+static thread_local ThreadPhaseTimes       gThreadPhaseTimes{};  // NOLINT
+
+namespace {
+struct StartupTimes
+{
+    bool                     recorded{};
+    std::chrono::nanoseconds cpuBeforeMain{};
+    std::chrono::nanoseconds commandLine{};
+    size_t                   optionCount{};
+};
+}  // namespace
+
+static StartupTimes gStartupTimes{};
+//-----------------------------------------------------------------------------
+
+void EnableTimeReport()
+{
+    gTimeReportEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+bool IsTimeReportEnabled()
+{
+    return gTimeReportEnabled;
+}
+//-----------------------------------------------------------------------------
+
+void EnableThreadPhaseTimes()
+{
+    gThreadPhaseTimesEnabled = true;
+}
+//-----------------------------------------------------------------------------
+
+const ThreadPhaseTimes& GetThreadPhaseTimes()
+{
+    return gThreadPhaseTimes;
+}
+//-----------------------------------------------------------------------------
+
+void ResetThreadPhaseTimes()
+{
+    gThreadPhaseTimes = {};
+}
+//-----------------------------------------------------------------------------
+
+TimePhase GetCurrentTimePhase()
+{
+    return gCurrentPhase;
+}
+//-----------------------------------------------------------------------------
+
+const char* GetTimePhaseName(const TimePhase phase)
+{
+    if(TimePhase::Count == phase) {
+        return "Other";
+    }
+
+    return PHASE_NAMES[static_cast<size_t>(phase)];
+}
+//-----------------------------------------------------------------------------
+
+void ResetTimeReport()
+{
+    for(auto& times : gPhaseTimes) {
+        times.wallNs = 0;
+        times.cpuNs  = 0;
+        times.count  = 0;
+    }
+
+    gStartupTimes = {};
+}
+//-----------------------------------------------------------------------------
+
+std::chrono::nanoseconds GetProcessCpuTime()
+{
+    llvm::sys::TimePoint<>   elapsed{};
+    std::chrono::nanoseconds user{};
+    std::chrono::nanoseconds sys{};
+
+    llvm::sys::Process::GetTimeUsage(elapsed, user, sys);
+
+    return user + sys;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The CPU time the calling thread used so far. With \c -j the other threads run their own phases at the same
+/// time, the CPU time of the process would charge their work to the phase of this thread.
+static std::chrono::nanoseconds GetThreadCpuTime()
+{
+#ifndef _WIN32
+    timespec now{};
+
+    if(0 == clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now)) {
+        return std::chrono::seconds{now.tv_sec} + std::chrono::nanoseconds{now.tv_nsec};
+    }
+#endif /* _WIN32 */
+
+    return GetProcessCpuTime();
+}
+//-----------------------------------------------------------------------------
+
+TimePhaseScope::TimePhaseScope(const TimePhase phase)
+: mPhase{phase}
+, mPreviousPhase{gCurrentPhase}
+, mActive{true}
+, mRunning{gTimeReportEnabled or gThreadPhaseTimesEnabled}
+, mReport{gTimeReportEnabled}
+, mWallStart{}
+, mCpuStart{}
+{
+    gCurrentPhase = mPhase;
+    ProbePhaseBegin(mPhase);
+
+    if(mRunning) {
+        mWallStart = std::chrono::steady_clock::now();
+    }
+
+    // The CPU time is for the time report only, reading it is not for free.
+    if(mReport) {
+        mCpuStart = GetThreadCpuTime();
+    }
+}
+//-----------------------------------------------------------------------------
+
+void TimePhaseScope::Stop()
+{
+    if(mActive) {
+        mActive       = false;
+        gCurrentPhase = mPreviousPhase;
+        ProbePhaseEnd(mPhase);
+    }
+
+    if(not mRunning) {
+        return;
+    }
+
+    mRunning = false;
+
+    const auto wall = std::chrono::steady_clock::now() - mWallStart;
+
+    if(gThreadPhaseTimesEnabled) {
+        gThreadPhaseTimes[static_cast<size_t>(mPhase)] += std::chrono::duration_cast<std::chrono::nanoseconds>(wall);
+    }
+
+    if(not mReport) {
+        return;
+    }
+
+    const auto cpu = GetThreadCpuTime() - mCpuStart;
+
+    auto& times = gPhaseTimes[static_cast<size_t>(mPhase)];
+    times.wallNs += std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count();
+    times.cpuNs += cpu.count();
+    ++times.count;
+}
+//-----------------------------------------------------------------------------
+
+void RecordStartup(const std::chrono::nanoseconds cpuBeforeMain,
+                   const std::chrono::nanoseconds commandLine,
+                   const size_t                   optionCount)
+{
+    gStartupTimes = {true, cpuBeforeMain, commandLine, optionCount};
+}
+//-----------------------------------------------------------------------------
+
+static double ToMs(const uint64_t ns)
+{
+    return static_cast<double>(ns) / 1'000'000.0;
+}
+//-----------------------------------------------------------------------------
+
+llvm::json::Object GetTimeReportJSON()
+{
+    llvm::json::Object report{};
+
+    for(size_t i = 0; i < PHASE_COUNT; ++i) {
+        const auto& times = gPhaseTimes[i];
+
+        report[PHASE_NAMES[i]] = llvm::json::Object{{"wallMs", ToMs(times.wallNs)},
+                                                    {"cpuMs", ToMs(times.cpuNs)},
+                                                    {"count", static_cast<int64_t>(times.count)}};
+    }
+
+    if(gStartupTimes.recorded) {
+        report["Startup"] =
+            llvm::json::Object{{"cpuBeforeMainMs", ToMs(static_cast<uint64_t>(gStartupTimes.cpuBeforeMain.count()))},
+                               {"commandLineMs", ToMs(static_cast<uint64_t>(gStartupTimes.commandLine.count()))},
+                               {"options", static_cast<int64_t>(gStartupTimes.optionCount)}};
+    }
+
+    return report;
+}
+//-----------------------------------------------------------------------------
+
+void PrintTimeReport(llvm::raw_ostream& ostream, const bool asJson)
+{
+    if(asJson) {
+        ostream << llvm::json::Value{GetTimeReportJSON()} << '\n';
+        return;
+    }
+
+    ostream << "===-------------------------------------------------------------------------===\n"
+            << "                          C++ Insights time report\n"
+            << "===-------------------------------------------------------------------------===\n"
+            << llvm::format("  %-24s %12s %12s %8s\n", "Phase", "Wall (ms)", "CPU (ms)", "Count");
+
+    for(size_t i = 0; i < PHASE_COUNT; ++i) {
+        const auto& times = gPhaseTimes[i];
+        const auto  phase = static_cast<TimePhase>(i);
+
+        // The handlers run inside matchAST, indent them to show that.
+        const bool isHandler{(phase > TimePhase::Matching) and (phase < TimePhase::EndSourceFileAction)};
+
+        ostream << llvm::format("  %-24s %12.3f %12.3f %8llu\n",
+                                (std::string{isHandler ? "  " : ""} + PHASE_NAMES[i]).c_str(),
+                                ToMs(times.wallNs),
+                                ToMs(times.cpuNs),
+                                static_cast<unsigned long long>(times.count));
+    }
+
+    if(gStartupTimes.recorded) {
+        ostream << llvm::format("\n  %.3f ms CPU before main, %llu options registered, %.3f ms parsing the command "
+                                "line\n",
+                                ToMs(static_cast<uint64_t>(gStartupTimes.cpuBeforeMain.count())),
+                                static_cast<unsigned long long>(gStartupTimes.optionCount),
+                                ToMs(static_cast<uint64_t>(gStartupTimes.commandLine.count())));
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,113 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_TIME_REPORT_H
+#define INSIGHTS_TIME_REPORT_H
+
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <array>
+#include <chrono>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The phases measured by \c --time-report.
+///
+/// The handler phases are part of \c Matching, as the handlers are called from \c MatchFinder::matchAST.
+enum class TimePhase
+{
+    Parsing,
+    Matching,
+    RecordDeclHandler,
+    TemplateHandler,
+    FunctionDeclHandler,
+    GlobalVariableHandler,
+    StaticAssertHandler,
+    EndSourceFileAction,
+    Count  // Must be the last entry.
+};
+//-----------------------------------------------------------------------------
+
+void EnableTimeReport();
+bool IsTimeReportEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief The innermost active \ref TimePhaseScope of this thread or \ref TimePhase::Count outside of all of them.
+///
+/// This is tracked, even if the time report is disabled. It allows other reports to attribute data to a handler.
+TimePhase GetCurrentTimePhase();
+//-----------------------------------------------------------------------------
+
+const char* GetTimePhaseName(const TimePhase phase);
+//-----------------------------------------------------------------------------
+
+/// \brief Clear all collected times, used to get a report per request.
+void ResetTimeReport();
+//-----------------------------------------------------------------------------
+
+using ThreadPhaseTimes = std::array<std::chrono::nanoseconds, static_cast<size_t>(TimePhase::Count)>;
+
+/// \brief Let \ref TimePhaseScope measure the wall time of the phases per thread as well, see \c --metrics.
+void EnableThreadPhaseTimes();
+
+/// \brief The wall time of each phase on this thread since the last \ref ResetThreadPhaseTimes.
+const ThreadPhaseTimes& GetThreadPhaseTimes();
+
+void ResetThreadPhaseTimes();
+//-----------------------------------------------------------------------------
+
+/// \brief The CPU time, user and system, this process used so far.
+std::chrono::nanoseconds GetProcessCpuTime();
+//-----------------------------------------------------------------------------
+
+/// \brief Add the cost of starting the process to the report.
+///
+/// \p cpuBeforeMain is the CPU time before \c main, which is loading the binary and the static initialization. The
+/// bulk of the latter is registering the \p optionCount \c llvm::cl options. \p commandLine is the wall time of
+/// parsing the command line.
+void RecordStartup(const std::chrono::nanoseconds cpuBeforeMain,
+                   const std::chrono::nanoseconds commandLine,
+                   const size_t                   optionCount);
+//-----------------------------------------------------------------------------
+
+/// \brief Print wall and CPU time of all phases in a human readable table or as JSON.
+void PrintTimeReport(llvm::raw_ostream& ostream, const bool asJson);
+//-----------------------------------------------------------------------------
+
+llvm::json::Object GetTimeReportJSON();
+//-----------------------------------------------------------------------------
+
+/// \brief Measure the wall and CPU time of a \ref TimePhase from construction till destruction or \ref Stop.
+///
+/// If the time report is disabled, this does nothing.
+class TimePhaseScope
+{
+public:
+    explicit TimePhaseScope(const TimePhase phase);
+    ~TimePhaseScope() { Stop(); }
+
+    TimePhaseScope(const TimePhaseScope&) = delete;
+    TimePhaseScope& operator=(const TimePhaseScope&) = delete;
+
+    void Stop();
+
+private:
+    const TimePhase                       mPhase;
+    const TimePhase                       mPreviousPhase;
+    bool                                  mActive;
+    bool                                  mRunning;
+    bool                                  mReport;  //!< Whether the time goes into the time report.
+    std::chrono::steady_clock::time_point mWallStart;
+    std::chrono::nanoseconds              mCpuStart;
+};
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_TIME_REPORT_H */
@@ -0,0 +1,89 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/Decl.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "ClangCompat.h"
+#include "DPrint.h"
+#include "Insights.h"
+#include "InsightsTrace.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+void StartTrace(const unsigned granularity)
+{
+#if IS_CLANG_NEWER_THAN(9)
+    llvm::timeTraceProfilerInitialize(granularity, "insights");
+#else
+    // LLVM 9 takes the granularity from its own -time-trace-granularity.
+    (void)granularity;
+    llvm::timeTraceProfilerInitialize();
+#endif
+}
+//-----------------------------------------------------------------------------
+
+bool WriteTrace(llvm::StringRef fileName)
+{
+    std::error_code ec{};
+    auto            out = std::make_unique<llvm::raw_fd_ostream>(fileName, ec, llvm::sys::fs::OF_Text);
+
+    if(ec) {
+        Error("cannot write trace '%s': %s\n", fileName, ec.message());
+        llvm::timeTraceProfilerCleanup();
+        return false;
+    }
+
+#if IS_CLANG_NEWER_THAN(9)
+    llvm::timeTraceProfilerWrite(*out);
+#else
+    std::unique_ptr<llvm::raw_pwrite_stream> stream{std::move(out)};
+    llvm::timeTraceProfilerWrite(stream);
+#endif
+
+    llvm::timeTraceProfilerCleanup();
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+std::string GetTraceDetail(const Decl* decl)
+{
+    if(not decl) {
+        return {};
+    }
+
+    std::string detail{};
+
+    if(const auto* namedDecl = dyn_cast<NamedDecl>(decl)) {
+        detail = namedDecl->getQualifiedNameAsString();
+    } else {
+        detail = decl->getDeclKindName();
+    }
+
+    const auto& sm = GetGlobalAST().getSourceManager();
+
+    return StrCat(detail, " ", decl->getLocation().printToString(sm));
+}
+//-----------------------------------------------------------------------------
+
+std::string GetTraceDetail(const ast_matchers::MatchFinder::MatchResult& result)
+{
+    for(const auto& node : result.Nodes.getMap()) {
+        if(const auto* decl = node.second.get<Decl>()) {
+            return GetTraceDetail(decl);
+        }
+    }
+
+    return {};
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
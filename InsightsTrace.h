@@ -0,0 +1,69 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_TRACE_H
+#define INSIGHTS_TRACE_H
+
+#include "clang/AST/Type.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "llvm/Support/TimeProfiler.h"
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief Start collecting trace events for \c --trace. Events shorter than \p granularity microseconds are dropped.
+void StartTrace(const unsigned granularity);
+//-----------------------------------------------------------------------------
+
+/// \brief Write the collected trace events in the Chrome trace-event format to \p fileName and stop tracing.
+///
+/// \returns \c false, if the file could not be written.
+bool WriteTrace(llvm::StringRef fileName);
+//-----------------------------------------------------------------------------
+
+/// \brief Name and source location of \p decl.
+std::string GetTraceDetail(const Decl* decl);
+//-----------------------------------------------------------------------------
+
+/// \brief Name and source location of the first \ref Decl bound in \p result.
+std::string GetTraceDetail(const ast_matchers::MatchFinder::MatchResult& result);
+//-----------------------------------------------------------------------------
+
+/// \brief A trace event annotated with the name and location of a \ref Decl.
+///
+/// The detail is only computed, if tracing is active.
+class DeclTraceScope : public llvm::TimeTraceScope
+{
+public:
+    DeclTraceScope(llvm::StringRef name, const Decl* decl)
+    : llvm::TimeTraceScope{name, [&] { return GetTraceDetail(decl); }}
+    {
+    }
+
+    DeclTraceScope(llvm::StringRef name, const ast_matchers::MatchFinder::MatchResult& result)
+    : llvm::TimeTraceScope{name, [&] { return GetTraceDetail(result); }}
+    {
+    }
+};
+//-----------------------------------------------------------------------------
+
+/// \brief A trace event annotated with a type.
+class TypeTraceScope : public llvm::TimeTraceScope
+{
+public:
+    TypeTraceScope(llvm::StringRef name, const QualType& type)
+    : llvm::TimeTraceScope{name, [&] { return type.getAsString(); }}
+    {
+    }
+};
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_TRACE_H */
@@ -0,0 +1,258 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/RecordLayout.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/Support/JSON.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "ClangCompat.h"
+#include "InsightsHelpers.h"
+#include "InsightsRecordLayout.h"
+#include "InsightsTypeSizes.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+struct TypeSize
+{
+    std::string file{};
+    std::string name{};
+    const char* kind{};  //!< One of class, lambda or instantiation.
+    uint64_t    size{};
+    uint64_t    align{};
+    uint64_t    fields{};
+    uint64_t    padding{};
+    bool        triviallyCopyable{};
+    bool        trivial{};
+    bool        trivialDestructor{};
+    bool        standardLayout{};
+};
+//-----------------------------------------------------------------------------
+
+class TypeSizeCollector : public RecursiveASTVisitor<TypeSizeCollector>
+{
+public:
+    TypeSizeCollector(ASTContext& ctx, std::vector<TypeSize>& sizes)
+    : mCtx{ctx}
+    , mSizes{sizes}
+    {
+        if(const auto* mainFile = ctx.getSourceManager().getFileEntryForID(ctx.getSourceManager().getMainFileID())) {
+            mFile = mainFile->getName().str();
+        }
+    }
+
+    bool shouldVisitTemplateInstantiations() const { return true; }
+
+    bool VisitCXXRecordDecl(const CXXRecordDecl* record)
+    {
+        Record(*record);
+
+        return true;
+    }
+
+    // The closure type is not traversed as a declaration of its own.
+    bool VisitLambdaExpr(const LambdaExpr* lambda)
+    {
+        Record(*lambda->getLambdaClass());
+
+        return true;
+    }
+
+private:
+    void Record(const CXXRecordDecl& record)
+    {
+        if((record.getDefinition() != &record) or record.isInjectedClassName() or
+           not RecordLayoutAnnotator::HasLayout(record) or not mSeen.insert(&record).second) {
+            return;
+        }
+
+        const auto& sm = mCtx.getSourceManager();
+
+        // An instantiation is located at its template.
+        if(not IsExpansionInMainFile(sm, record.getLocation())) {
+            return;
+        }
+
+        const auto& layout = mCtx.getASTRecordLayout(&record);
+        TypeSize    typeSize{};
+
+        typeSize.file              = mFile;
+        typeSize.size              = layout.getSize().getQuantity();
+        typeSize.align             = layout.getAlignment().getQuantity();
+        typeSize.triviallyCopyable = record.isTriviallyCopyable();
+        typeSize.trivial           = record.isTrivial();
+        typeSize.trivialDestructor = record.hasTrivialDestructor();
+        typeSize.standardLayout    = record.isStandardLayout();
+
+        if(record.isLambda()) {
+            typeSize.name = GetLambdaName(record).str();
+            typeSize.kind = "lambda";
+
+        } else {
+            typeSize.name = GetName(mCtx.getRecordType(&record));
+            typeSize.kind = isa<ClassTemplateSpecializationDecl>(record) ? "instantiation" : "class";
+        }
+
+        uint64_t usedBits{layout.hasOwnVFPtr() ? mCtx.getTargetInfo().getPointerWidth(0) : 0};
+
+        for(const auto* field : record.fields()) {
+            ++typeSize.fields;
+
+            if(field->isBitField()) {
+                usedBits += field->getBitWidthValue(mCtx);
+
+                continue;
+            }
+
+#if IS_CLANG_NEWER_THAN(8)
+            // An empty [[no_unique_address]] member takes no space.
+            if(not field->isZeroSize(mCtx))
+#endif
+            {
+                usedBits += mCtx.getTypeSize(field->getType());
+            }
+        }
+
+        auto addBase = [&](const CXXBaseSpecifier& base) {
+            const auto* baseRecord = base.getType()->getAsCXXRecordDecl();
+
+            if(baseRecord and not baseRecord->isEmpty()) {
+                usedBits += mCtx.toBits(mCtx.getASTRecordLayout(baseRecord).getNonVirtualSize());
+            }
+        };
+
+        for(const auto& base : record.bases()) {
+            if(not base.isVirtual()) {
+                addBase(base);
+            }
+        }
+
+        for(const auto& base : record.vbases()) {
+            addBase(base);
+        }
+
+        const uint64_t sizeInBits{mCtx.toBits(layout.getSize())};
+        typeSize.padding = (sizeInBits > usedBits) ? ((sizeInBits - usedBits) / mCtx.getCharWidth()) : 0;
+
+        mSizes.push_back(std::move(typeSize));
+    }
+
+    ASTContext&                          mCtx;
+    std::vector<TypeSize>&               mSizes;
+    std::string                          mFile{};
+    llvm::DenseSet<const CXXRecordDecl*> mSeen{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static TypeSizesFormat       gTypeSizesFormat{TypeSizesFormat::None};
+static std::mutex            gTypeSizesMutex{};
+static std::vector<TypeSize> gTypeSizes{};
+//-----------------------------------------------------------------------------
+
+void EnableTypeSizes(const TypeSizesFormat format)
+{
+    gTypeSizesFormat = format;
+}
+//-----------------------------------------------------------------------------
+
+bool IsTypeSizesEnabled()
+{
+    return TypeSizesFormat::None != gTypeSizesFormat;
+}
+//-----------------------------------------------------------------------------
+
+void RecordTypeSizes(ASTContext& ctx)
+{
+    // The sizes are computed outside of the lock, in --server mode the translation units run concurrently.
+    std::vector<TypeSize> sizes{};
+    TypeSizeCollector     collector{ctx, sizes};
+
+    for(auto* decl : ctx.getTraversalScope()) {
+        collector.TraverseDecl(decl);
+    }
+
+    std::lock_guard lock{gTypeSizesMutex};
+    std::move(sizes.begin(), sizes.end(), std::back_inserter(gTypeSizes));
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Quote \p value for a CSV field, the names of instantiations contain commas.
+static std::string QuoteCsv(StringRef value)
+{
+    std::string quoted{"\""};
+
+    for(const char c : value) {
+        if('"' == c) {
+            quoted += '"';
+        }
+
+        quoted += c;
+    }
+
+    return quoted + '"';
+}
+//-----------------------------------------------------------------------------
+
+void PrintTypeSizes(llvm::raw_ostream& ostream)
+{
+    std::lock_guard lock{gTypeSizesMutex};
+
+    std::stable_sort(gTypeSizes.begin(), gTypeSizes.end(), [](const TypeSize& a, const TypeSize& b) {
+        if(a.size != b.size) {
+            return a.size > b.size;
+        }
+
+        return a.name < b.name;
+    });
+
+    if(TypeSizesFormat::Json == gTypeSizesFormat) {
+        llvm::json::Array types{};
+
+        for(const auto& typeSize : gTypeSizes) {
+            types.push_back(llvm::json::Object{{"file", typeSize.file},
+                                               {"name", typeSize.name},
+                                               {"kind", typeSize.kind},
+                                               {"size", static_cast<int64_t>(typeSize.size)},
+                                               {"align", static_cast<int64_t>(typeSize.align)},
+                                               {"fields", static_cast<int64_t>(typeSize.fields)},
+                                               {"padding", static_cast<int64_t>(typeSize.padding)},
+                                               {"triviallyCopyable", typeSize.triviallyCopyable},
+                                               {"trivial", typeSize.trivial},
+                                               {"trivialDestructor", typeSize.trivialDestructor},
+                                               {"standardLayout", typeSize.standardLayout}});
+        }
+
+        ostream << llvm::json::Value{std::move(types)} << '\n';
+        return;
+    }
+
+    auto yesNo = [](const bool value) { return value ? "yes" : "no"; };
+
+    ostream << "file,name,kind,size,align,fields,padding,trivially copyable,trivial,trivial destructor,"
+               "standard layout\n";
+
+    for(const auto& typeSize : gTypeSizes) {
+        ostream << QuoteCsv(typeSize.file) << ',' << QuoteCsv(typeSize.name) << ',' << typeSize.kind << ','
+                << typeSize.size << ',' << typeSize.align << ',' << typeSize.fields << ',' << typeSize.padding << ','
+                << yesNo(typeSize.triviallyCopyable) << ',' << yesNo(typeSize.trivial) << ','
+                << yesNo(typeSize.trivialDestructor) << ',' << yesNo(typeSize.standardLayout) << '\n';
+    }
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,46 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_TYPE_SIZES_H
+#define INSIGHTS_TYPE_SIZES_H
+
+#include "llvm/Support/raw_ostream.h"
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class ASTContext;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+enum class TypeSizesFormat
+{
+    None,
+    Csv,
+    Json,
+};
+//-----------------------------------------------------------------------------
+
+void EnableTypeSizes(const TypeSizesFormat format);
+bool IsTypeSizesEnabled();
+//-----------------------------------------------------------------------------
+
+/// \brief Record the size, the alignment, the number of fields, the padding and the triviality of every class,
+/// closure type and class template instantiation defined in the main file of \p ctx, see \c --type-sizes.
+///
+/// The padding is what is left of the size after the fields, the non-virtual parts of the bases and the vptr.
+void RecordTypeSizes(ASTContext& ctx);
+//-----------------------------------------------------------------------------
+
+/// \brief Print the classes recorded for all translation units as CSV or JSON, the largest first.
+void PrintTypeSizes(llvm::raw_ostream& ostream);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_TYPE_SIZES_H */
@@ -0,0 +1,241 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/DeclCXX.h"
+#include "clang/AST/DeclTemplate.h"
+#include "clang/AST/ExprCXX.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/ADT/SmallPtrSet.h"
+
+#include "InsightsAllocations.h"
+#include "InsightsHelpers.h"
+#include "InsightsStrCat.h"
+#include "InsightsVariantVisit.h"
+
+#include <vector>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The number of functions and variables of the standard library the walk through a \c std::visit looks at.
+static constexpr unsigned MAX_DISPATCH_DECLS{256};
+
+/// \brief The number of visitor overloads a note lists by name.
+static constexpr size_t MAX_LISTED_OVERLOADS{8};
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief Walks the code the standard library instantiated for a \c std::visit, down to the calls of the visitor.
+class DispatchWalker
+{
+public:
+    explicit DispatchWalker(const SourceManager& sm)
+    : mSM{sm}
+    {
+    }
+
+    void Walk(const Decl* decl);
+
+    unsigned                         switches{};       //!< The \c switch statements, on the index of a variant.
+    unsigned                         indirectCalls{};  //!< The calls through a function pointer.
+    std::vector<const FunctionDecl*> overloads{};      //!< The overloads of the visitor, in the order they are called.
+
+private:
+    const SourceManager&                      mSM;
+    llvm::SmallPtrSet<const Decl*, 32>        mSeen{};
+    llvm::SmallPtrSet<const FunctionDecl*, 8> mOverloads{};
+
+    void Visit(const Stmt* stmt);
+
+    /// \brief Walk \p function, if it is part of the standard library, otherwise it is an overload of the visitor.
+    void Follow(const FunctionDecl* function);
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+void DispatchWalker::Walk(const Decl* decl)
+{
+    if(not decl or (MAX_DISPATCH_DECLS <= mSeen.size()) or not mSeen.insert(decl).second) {
+        return;
+    }
+
+    if(const auto* var = dyn_cast<VarDecl>(decl)) {
+        // The tables of function pointers are constexpr variables, their initializer builds them.
+        Visit(var->getInit());
+
+    } else if(const auto* function = dyn_cast<FunctionDecl>(decl)) {
+        if(const auto* ctor = dyn_cast<CXXConstructorDecl>(function)) {
+            for(const auto* init : ctor->inits()) {
+                Visit(init->getInit());
+            }
+        }
+
+        Visit(function->getBody());
+    }
+}
+//-----------------------------------------------------------------------------
+
+void DispatchWalker::Follow(const FunctionDecl* function)
+{
+    if(not function) {
+        return;
+    }
+
+    if(mSM.isInSystemHeader(function->getLocation())) {
+        const FunctionDecl* definition{};
+
+        if(function->hasBody(definition)) {
+            Walk(definition);
+        }
+
+    } else if(mOverloads.insert(function).second) {
+        overloads.push_back(function);
+    }
+}
+//-----------------------------------------------------------------------------
+
+void DispatchWalker::Visit(const Stmt* stmt)
+{
+    if(not stmt) {
+        return;
+    }
+
+    // Nothing in an unevaluated operand runs.
+    if(isa<UnaryExprOrTypeTraitExpr>(stmt) or isa<CXXNoexceptExpr>(stmt)) {
+        return;
+    }
+
+    if(isa<SwitchStmt>(stmt)) {
+        ++switches;
+
+    } else if(const auto* call = dyn_cast<CallExpr>(stmt)) {
+        if(const auto* callee = call->getDirectCallee()) {
+            Follow(callee);
+
+        } else if(call->getCallee()->getType()->isFunctionPointerType()) {
+            ++indirectCalls;
+        }
+
+    } else if(const auto* construct = dyn_cast<CXXConstructExpr>(stmt)) {
+        if(mSM.isInSystemHeader(construct->getConstructor()->getLocation())) {
+            Follow(construct->getConstructor());
+        }
+
+    } else if(const auto* declRef = dyn_cast<DeclRefExpr>(stmt)) {
+        const auto* decl = declRef->getDecl();
+
+        // A function whose address goes into a table and the table itself.
+        if(mSM.isInSystemHeader(decl->getLocation())) {
+            if(const auto* function = dyn_cast<FunctionDecl>(decl)) {
+                Follow(function);
+
+            } else if(isa<VarDecl>(decl)) {
+                Walk(decl);
+            }
+        }
+    }
+
+    for(const auto* child : stmt->children()) {
+        Visit(child);
+    }
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The number of alternatives of \p type, if it is a \c std::variant, otherwise 0.
+static uint64_t GetAlternatives(const QualType& type)
+{
+    const auto* spec = dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+        type.getNonReferenceType()->getAsCXXRecordDecl());
+
+    if(not spec or not spec->isInStdNamespace() or not spec->getIdentifier() or (spec->getName() != "variant")) {
+        return 0;
+    }
+
+    const auto& args = spec->getTemplateArgs();
+
+    if((0 == args.size()) or (TemplateArgument::Pack != args[0].getKind())) {
+        return 0;
+    }
+
+    return args[0].pack_size();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The name of \p overload together with its parameters, like \c operator()(int).
+static std::string GetOverloadName(const FunctionDecl& overload)
+{
+    std::string name{StrCat(GetName(overload), "(")};
+
+    for(const auto* param : overload.parameters()) {
+        name.append(StrCat((param == overload.parameters().front()) ? "" : ", ", GetName(param->getType())));
+    }
+
+    return name.append(")");
+}
+//-----------------------------------------------------------------------------
+
+std::string GetVariantVisitNote(const CallExpr& call)
+{
+    const auto* callee = call.getDirectCallee();
+
+    if(not callee or not callee->isInStdNamespace() or not callee->getIdentifier() or
+       (callee->getName() != "visit") or not callee->getPrimaryTemplate() or (2 > call.getNumArgs())) {
+        return {};
+    }
+
+    uint64_t combinations{1};
+
+    for(unsigned i = 1; i < call.getNumArgs(); ++i) {
+        const auto alternatives = GetAlternatives(call.getArg(i)->getType());
+
+        if(0 == alternatives) {
+            return {};
+        }
+
+        combinations *= alternatives;
+    }
+
+    DispatchWalker walker{callee->getASTContext().getSourceManager()};
+    walker.Walk(callee);
+
+    const bool  singleVariant{2 == call.getNumArgs()};
+    const auto  alternatives = StrCat(combinations, singleVariant ? " alternatives" : " combinations of alternatives");
+    const char* library{IsLibCpp(*callee) ? "libc++" : "libstdc++"};
+
+    std::string dispatch = [&]() -> std::string {
+        if(0 < walker.indirectCalls) {
+            return StrCat("jump table of function pointers for the ",
+                          alternatives,
+                          ", ",
+                          walker.indirectCalls,
+                          (1 == walker.indirectCalls) ? " indirect call" : " indirect calls",
+                          " per visit");
+        } else if(0 < walker.switches) {
+            return StrCat("switch over the ", alternatives, ", no indirect call");
+        }
+
+        return StrCat("direct call for the ", alternatives, ", no indirect call");
+    }();
+
+    if(not walker.overloads.empty()) {
+        dispatch.append("; visitor: ");
+
+        for(size_t i = 0; (i < walker.overloads.size()) and (i < MAX_LISTED_OVERLOADS); ++i) {
+            dispatch.append(StrCat((0 == i) ? "" : ", ", GetOverloadName(*walker.overloads[i])));
+        }
+
+        if(MAX_LISTED_OVERLOADS < walker.overloads.size()) {
+            dispatch.append(StrCat(" and ", walker.overloads.size() - MAX_LISTED_OVERLOADS, " more"));
+        }
+    }
+
+    return StrCat("std::visit (", library, "): ", dispatch);
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
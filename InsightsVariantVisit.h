@@ -0,0 +1,31 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_VARIANT_VISIT_H
+#define INSIGHTS_VARIANT_VISIT_H
+
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class CallExpr;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The note which tells how the call \p call of \c std::visit dispatches to the visitor, empty for any other
+/// call, see \c --show-variant-visit.
+///
+/// The note is taken from the code the standard library instantiated for the call: a \c switch on the index or a jump
+/// table of function pointers, the number of indirect calls on the way and the overloads of the visitor it calls.
+std::string GetVariantVisitNote(const CallExpr& call);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_VARIANT_VISIT_H */
@@ -0,0 +1,80 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/Frontend/FrontendActions.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+
+#include <memory>
+
+#include "InsightsVerifyOutput.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The result calls the functions of the Itanium ABI for static local variables without declaring them. The
+/// same definitions as \c testCompile of \c tests/runTest.py uses.
+static constexpr const char* CXA_GUARD_MACROS[]{
+    "__cxa_guard_acquire(x)=true",
+    "__cxa_guard_release(x)",
+    "__cxa_guard_abort(x)",
+};
+//-----------------------------------------------------------------------------
+
+std::shared_ptr<CompilerInvocation> CreateResultInvocation(CompilerInstance& ci, llvm::StringRef result)
+{
+    auto  invocation   = std::make_shared<CompilerInvocation>(ci.getInvocation());
+    auto& frontendOpts = invocation->getFrontendOpts();
+
+    if(frontendOpts.Inputs.empty()) {
+        return nullptr;
+    }
+
+    const auto& input = frontendOpts.Inputs.front();
+
+    llvm::SmallString<256> path{input.getFile()};
+    llvm::sys::path::replace_extension(path, "insights.cpp");
+
+    frontendOpts.Inputs = {FrontendInputFile{path, input.getKind()}};
+    frontendOpts.OutputFile.clear();
+
+    // The compiler instance takes ownership of the remapped buffer.
+    auto& preprocessorOpts = invocation->getPreprocessorOpts();
+    preprocessorOpts.addRemappedFile(path, llvm::MemoryBuffer::getMemBufferCopy(result, path).release());
+    preprocessorOpts.RetainRemappedFileBuffers = false;
+
+    for(const auto* macro : CXA_GUARD_MACROS) {
+        preprocessorOpts.addMacroDef(macro);
+    }
+
+    return invocation;
+}
+//-----------------------------------------------------------------------------
+
+bool VerifyOutput(CompilerInstance& ci, llvm::StringRef result)
+{
+    auto invocation = CreateResultInvocation(ci, result);
+
+    if(not invocation) {
+        return true;
+    }
+
+    invocation->getFrontendOpts().ProgramAction = frontend::ParseSyntaxOnly;
+
+    CompilerInstance verifier{ci.getPCHContainerOperations()};
+    verifier.setInvocation(std::move(invocation));
+    verifier.setFileManager(&ci.getFileManager());
+    verifier.createDiagnostics(ci.getDiagnostics().getClient(), /*ShouldOwnClient*/ false);
+
+    SyntaxOnlyAction action{};
+
+    return verifier.ExecuteAction(action) and not verifier.getDiagnostics().hasErrorOccurred();
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
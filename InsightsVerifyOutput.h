@@ -0,0 +1,39 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_VERIFY_OUTPUT_H
+#define INSIGHTS_VERIFY_OUTPUT_H
+
+#include "clang/Frontend/CompilerInstance.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <memory>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief A copy of the invocation of \p ci which compiles \p result, the transformed main file of \p ci, instead.
+///
+/// The arguments and a PCH of the include prefix are the same. The result gets the name \c <main file>.insights.cpp
+/// next to the main file, which keeps its diagnostics apart from those of the source.
+///
+/// \returns Null, if \p ci has no input.
+std::shared_ptr<CompilerInvocation> CreateResultInvocation(CompilerInstance& ci, llvm::StringRef result);
+//-----------------------------------------------------------------------------
+
+/// \brief Parse \p result, the transformed main file of \p ci, again in this process, see \c --verify-output.
+///
+/// A fresh compiler instance parses \p result with the invocation of \ref CreateResultInvocation. It shares the file
+/// manager of \p ci, the headers are not looked up again. The diagnostics go to the diagnostic consumer of \p ci.
+///
+/// \returns \c false, if \p result has errors.
+bool VerifyOutput(CompilerInstance& ci, llvm::StringRef result);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_VERIFY_OUTPUT_H */
@@ -0,0 +1,282 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <atomic>
+#include <mutex>
+
+#include "DPrint.h"
+#include "InsightsVfsSnapshot.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+namespace {
+/// \brief The names in one directory which did not exist, valid as long as the directory has \c mtime.
+struct SnapshotDirectory
+{
+    int64_t           mtime{};
+    bool              validated{};  //!< Whether \c mtime was compared to the one on the disk in this run.
+    llvm::StringSet<> missing{};
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+static std::string                        gSnapshotFile{};
+static std::mutex                         gSnapshotMutex{};
+static llvm::StringMap<SnapshotDirectory> gSnapshot{};
+static bool                               gSnapshotChanged{};
+static std::atomic<uint64_t>              gSnapshotHits{};
+static std::atomic<uint64_t>              gSnapshotMisses{};
+static std::atomic<uint64_t>              gSnapshotInvalidated{};
+//-----------------------------------------------------------------------------
+
+VfsSnapshotStats GetVfsSnapshotStats()
+{
+    return {gSnapshotHits, gSnapshotMisses, gSnapshotInvalidated};
+}
+//-----------------------------------------------------------------------------
+
+static int64_t GetModificationTime(const llvm::vfs::Status& status)
+{
+    return static_cast<int64_t>(status.getLastModificationTime().time_since_epoch().count());
+}
+//-----------------------------------------------------------------------------
+
+namespace {
+class SnapshotFileSystem final : public llvm::vfs::ProxyFileSystem
+{
+public:
+    explicit SnapshotFileSystem(llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs)
+    : ProxyFileSystem{std::move(fs)}
+    {
+    }
+
+    llvm::ErrorOr<llvm::vfs::Status> status(const llvm::Twine& path) override
+    {
+        return Lookup(path, [&](const llvm::Twine& p) { return ProxyFileSystem::status(p); });
+    }
+
+    llvm::ErrorOr<std::unique_ptr<llvm::vfs::File>> openFileForRead(const llvm::Twine& path) override
+    {
+        // The header search opens the candidates right away, without a status before.
+        return Lookup(path, [&](const llvm::Twine& p) { return ProxyFileSystem::openFileForRead(p); });
+    }
+
+private:
+    template<typename LookupFn>
+    auto Lookup(const llvm::Twine& path, LookupFn&& lookup) -> decltype(lookup(path))
+    {
+        llvm::SmallString<256> absolute{};
+        path.toVector(absolute);
+
+        if(makeAbsolute(absolute)) {
+            return lookup(path);
+        }
+
+        const llvm::StringRef directory = llvm::sys::path::parent_path(absolute);
+        const llvm::StringRef name      = llvm::sys::path::filename(absolute);
+
+        if(IsKnownMissing(directory, name)) {
+            ++gSnapshotHits;
+            return std::make_error_code(std::errc::no_such_file_or_directory);
+        }
+
+        ++gSnapshotMisses;
+        auto result = lookup(absolute);
+
+        if(not result and (std::errc::no_such_file_or_directory == result.getError())) {
+            RecordMissing(directory, name);
+        }
+
+        return result;
+    }
+
+    bool IsKnownMissing(llvm::StringRef directory, llvm::StringRef name)
+    {
+        std::lock_guard lock{gSnapshotMutex};
+
+        auto it = gSnapshot.find(directory);
+
+        if(gSnapshot.end() == it) {
+            return false;
+        }
+
+        // One status of the directory replaces the lookups of all the names in it which did not exist.
+        if(auto& entry = it->second; not entry.validated) {
+            entry.validated = true;
+
+            if(const auto status = ProxyFileSystem::status(directory);
+               not status or (GetModificationTime(*status) != entry.mtime)) {
+                ++gSnapshotInvalidated;
+                gSnapshotChanged = true;
+                gSnapshot.erase(it);
+
+                return false;
+            }
+        }
+
+        return 0 != it->second.missing.count(name);
+    }
+
+    void RecordMissing(llvm::StringRef directory, llvm::StringRef name)
+    {
+        std::lock_guard lock{gSnapshotMutex};
+
+        auto [it, inserted] = gSnapshot.try_emplace(directory);
+
+        if(inserted) {
+            // A directory which does not exist itself is not cached, its parent would have to be validated instead.
+            const auto status = ProxyFileSystem::status(directory);
+
+            if(not status or not status->isDirectory()) {
+                gSnapshot.erase(it);
+                return;
+            }
+
+            it->second.mtime     = GetModificationTime(*status);
+            it->second.validated = true;
+        }
+
+        if(it->second.missing.insert(name).second) {
+            gSnapshotChanged = true;
+        }
+    }
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+void LoadVfsSnapshot(llvm::StringRef fileName)
+{
+    gSnapshotFile = fileName.str();
+
+    auto buffer = llvm::MemoryBuffer::getFile(fileName);
+
+    if(not buffer) {
+        return;
+    }
+
+    auto json = llvm::json::parse(buffer.get()->getBuffer());
+
+    if(not json) {
+        Error("ignoring the invalid --vfs-snapshot '%s': %s\n", fileName, llvm::toString(json.takeError()));
+        return;
+    }
+
+    const auto* directories = json->getAsObject() ? json->getAsObject()->getArray("directories") : nullptr;
+
+    if(nullptr == directories) {
+        return;
+    }
+
+    std::lock_guard lock{gSnapshotMutex};
+
+    for(const auto& value : *directories) {
+        const auto* directory = value.getAsObject();
+
+        if(nullptr == directory) {
+            continue;
+        }
+
+        const auto path    = directory->getString("path");
+        const auto mtime   = directory->getInteger("mtime");
+        const auto missing = directory->getArray("missing");
+
+        if(not path or not mtime or not missing) {
+            continue;
+        }
+
+        auto& entry = gSnapshot[*path];
+        entry.mtime = *mtime;
+
+        for(const auto& name : *missing) {
+            if(const auto str = name.getAsString()) {
+                entry.missing.insert(*str);
+            }
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> GetBaseFileSystem()
+{
+    if(gSnapshotFile.empty()) {
+        return llvm::vfs::getRealFileSystem();
+    }
+
+    static llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> fs{new SnapshotFileSystem{llvm::vfs::getRealFileSystem()}};
+
+    return fs;
+}
+//-----------------------------------------------------------------------------
+
+bool SaveVfsSnapshot()
+{
+    std::lock_guard lock{gSnapshotMutex};
+
+    if(gSnapshotFile.empty() or not gSnapshotChanged) {
+        return true;
+    }
+
+    llvm::json::Array directories{};
+
+    for(const auto& directory : gSnapshot) {
+        llvm::json::Array missing{};
+
+        for(const auto& name : directory.second.missing) {
+            missing.push_back(name.getKey().str());
+        }
+
+        directories.push_back(llvm::json::Object{{"path", directory.getKey().str()},
+                                                 {"mtime", directory.second.mtime},
+                                                 {"missing", std::move(missing)}});
+    }
+
+    llvm::SmallString<256> tmpModel{gSnapshotFile};
+    tmpModel += "-%%%%%%.tmp";
+
+    int                    fd{};
+    llvm::SmallString<256> tmpPath{};
+    if(const auto ec = llvm::sys::fs::createUniqueFile(tmpModel, fd, tmpPath)) {
+        Error("cannot write --vfs-snapshot '%s': %s\n", gSnapshotFile, ec.message());
+        return false;
+    }
+
+    {
+        llvm::raw_fd_ostream out{fd, /*shouldClose*/ true};
+        out << llvm::json::Value{llvm::json::Object{{"version", 1}, {"directories", std::move(directories)}}} << '\n';
+        out.close();
+
+        if(out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmpPath);
+            return false;
+        }
+    }
+
+    // The rename is atomic, another run which starts at the same time reads either the old or the new snapshot.
+    if(const auto ec = llvm::sys::fs::rename(tmpPath, gSnapshotFile)) {
+        Error("cannot write --vfs-snapshot '%s': %s\n", gSnapshotFile, ec.message());
+        llvm::sys::fs::remove(tmpPath);
+        return false;
+    }
+
+    gSnapshotChanged = false;
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
@@ -0,0 +1,52 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_VFS_SNAPSHOT_H
+#define INSIGHTS_VFS_SNAPSHOT_H
+
+#include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <cstdint>
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief The lookups \c --vfs-snapshot answered and the ones which went to the disk, reported with \c --stats.
+struct VfsSnapshotStats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t invalidated;  //!< Directories whose modification time changed since the snapshot was taken.
+};
+
+VfsSnapshotStats GetVfsSnapshotStats();
+//-----------------------------------------------------------------------------
+
+/// \brief Load the snapshot of header search misses from \p fileName, see \c --vfs-snapshot.
+///
+/// A missing or unreadable snapshot is not an error, the first run creates it.
+void LoadVfsSnapshot(llvm::StringRef fileName);
+
+/// \brief Get the file system the tools run on. Without \c --vfs-snapshot this is the real one.
+///
+/// The header search tries each include directory in turn, most of the paths it looks at do not exist. The returned
+/// file system answers these lookups from the snapshot, as long as the directory they are in has the modification
+/// time it had when the snapshot was taken. Adding or removing a file changes that time. Paths which exist always go
+/// to the real file system, clang reads them anyway.
+llvm::IntrusiveRefCntPtr<llvm::vfs::FileSystem> GetBaseFileSystem();
+
+/// \brief Write the snapshot back, if this run added to it.
+///
+/// \returns \c false, if the file could not be written.
+bool SaveVfsSnapshot();
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_VFS_SNAPSHOT_H */
@@ -0,0 +1,145 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/ExprCXX.h"
+
+#include "InsightsStrCat.h"
+#include "InsightsZeroInit.h"
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+static uint64_t GetSize(const ASTContext& ctx, const QualType& type)
+{
+    if(type->isIncompleteType() or type->isDependentType()) {
+        return 0;
+    }
+
+    return ctx.getTypeSizeInChars(type).getQuantity();
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Add the cost of \p expr, which initializes \p count objects, to \p cost.
+static void AddZeroInitCost(const ASTContext& ctx, const Expr* expr, const uint64_t count, ZeroInitCost& cost)
+{
+    if(not expr) {
+        return;
+    }
+
+    expr = expr->IgnoreImplicit();
+
+    if(isa<ImplicitValueInitExpr>(expr) or isa<CXXScalarValueInitExpr>(expr)) {
+        cost.zeroBytes += count * GetSize(ctx, expr->getType());
+        cost.valueInit = true;
+
+    } else if(const auto* initList = dyn_cast<InitListExpr>(expr)) {
+        if(const auto* semantic = initList->getSemanticForm()) {
+            initList = semantic;
+        }
+
+        // An empty `{}` value-initializes each member, even if all of them have constructors.
+        const auto* syntactic = initList->getSyntacticForm();
+
+        if(0 == (syntactic ? syntactic : initList)->getNumInits()) {
+            cost.valueInit = true;
+        }
+
+        for(const auto* init : initList->inits()) {
+            AddZeroInitCost(ctx, init, count, cost);
+        }
+
+        // The elements after the last initializer of an array are all initialized by the filler.
+        if(const auto* arrayType = ctx.getAsConstantArrayType(initList->getType());
+           arrayType and initList->hasArrayFiller()) {
+            const uint64_t size{arrayType->getSize().getZExtValue()};
+
+            if(size > initList->getNumInits()) {
+                AddZeroInitCost(ctx, initList->getArrayFiller(), count * (size - initList->getNumInits()), cost);
+            }
+        }
+
+    } else if(const auto* construct = dyn_cast<CXXConstructExpr>(expr)) {
+        uint64_t elements{count};
+
+        if(const auto* arrayType = ctx.getAsConstantArrayType(construct->getType())) {
+            elements *= ctx.getConstantArrayElementCount(arrayType);
+        }
+
+        if(construct->requiresZeroInitialization()) {
+            cost.zeroBytes += count * GetSize(ctx, construct->getType());
+            cost.valueInit = true;
+        }
+
+        if(not construct->getConstructor()->isTrivial()) {
+            cost.constructorCalls += elements;
+        }
+    }
+}
+//-----------------------------------------------------------------------------
+
+ZeroInitCost GetZeroInitCost(const ASTContext& ctx, const Expr* init)
+{
+    ZeroInitCost cost{};
+    AddZeroInitCost(ctx, init, 1, cost);
+
+    return cost;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Whether \p init leaves an object as it is, that is no initializer or a trivial default constructor.
+static bool IsTrivialDefaultInit(const Expr* init)
+{
+    if(not init) {
+        return true;
+    }
+
+    const auto* construct = dyn_cast<CXXConstructExpr>(init->IgnoreImplicit());
+
+    return construct and construct->getConstructor()->isDefaultConstructor() and
+           construct->getConstructor()->isTrivial() and not construct->requiresZeroInitialization();
+}
+//-----------------------------------------------------------------------------
+
+std::string GetZeroInitNote(const ASTContext&   ctx,
+                            const QualType&     type,
+                            const Expr*         init,
+                            const ZeroInitCost& cost,
+                            const bool          inLoop)
+{
+    const bool isAggregate{type->isRecordType() or type->isArrayType()};
+
+    if(not cost.valueInit) {
+        if(isAggregate and IsTrivialDefaultInit(init)) {
+            return StrCat("default-initialization, no code for ", GetSize(ctx, type), " bytes");
+        }
+
+        return {};
+    }
+
+    std::string note{};
+
+    if(cost.zeroBytes) {
+        // clang fills an aggregate which is zero at large with a memset, the backend turns a small one into stores.
+        note = StrCat("zero-fill of ", cost.zeroBytes, " bytes", isAggregate ? " (memset)" : "");
+    } else {
+        note = "no zero-fill";
+    }
+
+    if(cost.constructorCalls) {
+        note.append(StrCat(", ", cost.constructorCalls, " constructor call", (1 == cost.constructorCalls) ? "" : "s"));
+    }
+
+    if(inLoop and (LARGE_ZERO_FILL <= cost.zeroBytes)) {
+        note.append(", inside a loop");
+    }
+
+    return note;
+}
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
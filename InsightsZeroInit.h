@@ -0,0 +1,56 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#ifndef INSIGHTS_ZERO_INIT_H
+#define INSIGHTS_ZERO_INIT_H
+
+#include "clang/AST/Type.h"
+
+#include <cstdint>
+#include <string>
+//-----------------------------------------------------------------------------
+
+namespace clang {
+class ASTContext;
+class Expr;
+}
+//-----------------------------------------------------------------------------
+
+namespace clang::insights {
+
+/// \brief A zero-fill of this many bytes inside a loop is a warning of \c --show-zero-init.
+constexpr uint64_t LARGE_ZERO_FILL{1024};
+
+/// \brief What the value-initializations in an initializer cost, see \c --show-zero-init.
+struct ZeroInitCost
+{
+    uint64_t zeroBytes{};         //!< The bytes filled with zeros.
+    uint64_t constructorCalls{};  //!< The calls of non-trivial constructors, per element of an array.
+    bool     valueInit{};         //!< Whether \c {}, \c () or a missing initializer value-initializes a part.
+};
+
+/// \brief The cost of \p init, which is null for a variable without an initializer.
+///
+/// The bytes of an \c ImplicitValueInitExpr, a \c CXXScalarValueInitExpr, the elements an array filler initializes and
+/// an object whose constructor requires zero-initialization are filled with zeros.
+ZeroInitCost GetZeroInitCost(const ASTContext& ctx, const Expr* init);
+
+/// \brief The note for the initialization of an object of \p type with \p init, empty if it value-initializes nothing.
+///
+/// A value-initialization is a zero-fill, which is a \c memset for a class or an array, followed by the calls of the
+/// non-trivial constructors or, without a zero-fill, only these calls. A class or an array with a trivial default
+/// constructor and no initializer is left as it is, which costs nothing.
+std::string GetZeroInitNote(const ASTContext&   ctx,
+                            const QualType&     type,
+                            const Expr*         init,
+                            const ZeroInitCost& cost,
+                            const bool          inLoop);
+//-----------------------------------------------------------------------------
+
+}  // namespace clang::insights
+
+#endif /* INSIGHTS_ZERO_INIT_H */
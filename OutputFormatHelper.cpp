@@ -6,33 +6,116 @@
  ****************************************************************************/
 
 #include "OutputFormatHelper.h"
+#include "InsightsDefaultedComparison.h"
 #include "InsightsHelpers.h"
+#include "InsightsMemReport.h"
 //-----------------------------------------------------------------------------
 
 namespace clang::insights {
 
-static const std::string MakeIndent(const int indent)
+OutputFormatHelper::~OutputFormatHelper()
 {
-    std::string str{};
+    size_t capacity{mOutput.capacity()};
 
-    for(int i = 1; i < indent; i++) {
-        str += ' ';
+    for(const auto& hole : mHoles) {
+        capacity += hole.content.capacity();
     }
 
-    return str;
+    RecordOutputBufferSize(capacity);
+    ReturnScratchBuffer(std::move(mOutput));
+}
+//-----------------------------------------------------------------------------
+
+void OutputFormatHelper::ResolveHoles()
+{
+    if(0 == mHolesLength) {
+        return;
+    }
+
+    std::string resolved{};
+    resolved.reserve(CurrentPos());
+
+    size_t start{};
+    size_t shift{};
+    auto   mark = mSourceMarks.begin();
+
+    for(auto& hole : mHoles) {
+        // The content of a hole goes in front of the code marked at the same offset.
+        for(; (mSourceMarks.end() != mark) and (mark->offset < hole.offset); ++mark) {
+            mark->offset += shift;
+        }
+
+        resolved.append(mOutput, start, hole.offset - start);
+        resolved.append(hole.content);
+        start = hole.offset;
+        shift += hole.content.length();
+
+        // The anchor stays valid, content added later goes behind the content resolved now.
+        hole.offset = resolved.length();
+        hole.pos    = resolved.length();
+        hole.content.clear();
+    }
+
+    for(; mSourceMarks.end() != mark; ++mark) {
+        mark->offset += shift;
+    }
+
+    resolved.append(mOutput, start, std::string::npos);
+
+    mOutput      = std::move(resolved);
+    mHolesLength = 0;
+}
+//-----------------------------------------------------------------------------
+
+bool OutputFormatHelper::empty() const
+{
+    auto isBlank = [](const std::string& str) { return std::string::npos == str.find_first_not_of(' ', 0); };
+
+    for(const auto& hole : mHoles) {
+        if(not isBlank(hole.content)) {
+            return false;
+        }
+    }
+
+    return isBlank(mOutput);
+}
+//-----------------------------------------------------------------------------
+
+char OutputFormatHelper::back() const
+{
+    // A hole at the end of mOutput with content holds the last character.
+    for(auto it = mHoles.rbegin(); (it != mHoles.rend()) and (it->offset == mOutput.length()); ++it) {
+        if(not it->content.empty()) {
+            return it->content.back();
+        }
+    }
+
+    return mOutput.back();
 }
 //-----------------------------------------------------------------------------
 
 void OutputFormatHelper::Indent(unsigned count)
 {
-    mOutput.append(MakeIndent(count + 1));
+    mOutput.append(count, ' ');
 }
 //-----------------------------------------------------------------------------
 
-void OutputFormatHelper::AppendParameterList(const ArrayRef<ParmVarDecl*> parameters, const NameOnly nameOnly)
+void OutputFormatHelper::AppendParameterList(const ArrayRef<ParmVarDecl*>                parameters,
+                                             const NameOnly                              nameOnly,
+                                             llvm::function_ref<void(const ParmVarDecl&)> before)
 {
     ForEachArg(parameters, [&](const auto& p) {
-        const auto& name{GetName(*p)};
+        std::string name{GetName(*p)};
+
+        // The shown body of a defaulted comparison refers to its parameters, which are usually unnamed.
+        if(const auto* function = dyn_cast_or_null<FunctionDecl>(p->getDeclContext());
+           name.empty() and function and IsExpandedDefaultedComparison(*function)) {
+            name = GetUnnamedParameterName(*p);
+        }
+
+        if(before) {
+            before(*p);
+        }
 
         if(NameOnly::No == nameOnly) {
             const auto& type{p->getType()};
@@ -64,11 +147,26 @@ void OutputFormatHelper::RemoveIndent()
     /* After a newline we are already indented by one level to much. Try to decrease it. */
     if(0 != mDefaultIndent) {
         for(unsigned i = 0; i < SCOPE_INDENT; ++i) {
-            if(' ' != mOutput.back()) {
+            if(mOutput.empty() or (' ' != mOutput.back())) {
+                break;
+            }
+
+            // Stop at a hole with content, the indention is then already followed by it.
+            if(not mHoles.empty() and (mHoles.back().offset == mOutput.length()) and
+               not mHoles.back().content.empty()) {
                 break;
             }
 
             mOutput.pop_back();
+
+            if(not mSourceMarks.empty() and (mSourceMarks.back().offset > mOutput.length())) {
+                mSourceMarks.back().offset = mOutput.length();
+            }
+
+            // Keep empty holes reserved behind the removed character within the buffer.
+            for(auto it = mHoles.rbegin(); (it != mHoles.rend()) and (it->offset > mOutput.length()); ++it) {
+                it->offset = mOutput.length();
+            }
         }
     }
 }
@@ -9,9 +9,15 @@
 #define OUTPUT_FORMAT_HELPER_H
 //-----------------------------------------------------------------------------
 
+#include "llvm/ADT/STLExtras.h"
+
+#include <string>
 #include <utility>
+#include <vector>
 
+#include "InsightsArena.h"
 #include "InsightsOnce.h"
+#include "InsightsSourceMap.h"
 #include "InsightsStrCat.h"
 #include "InsightsStrongTypes.h"
 //-----------------------------------------------------------------------------
@@ -37,15 +43,64 @@ public:
 
     explicit OutputFormatHelper(const unsigned indent)
     : mDefaultIndent{indent}
-    , mOutput{}
+    , mOutput{GetScratchBuffer()}
+    , mHoles{}
+    , mHolesLength{}
     {
     }
 
+    /// \brief Reports the size of the buffer to the memory report, if enabled, and hands it back for reuse.
+    ~OutputFormatHelper();
+
+    OutputFormatHelper(const OutputFormatHelper&) = default;
+    OutputFormatHelper(OutputFormatHelper&&)      = default;
+    OutputFormatHelper& operator=(const OutputFormatHelper&) = default;
+    OutputFormatHelper& operator=(OutputFormatHelper&&) = default;
+
+    /// \brief A placeholder in the buffer to which content can be added later, see \ref ReserveAnchor.
+    class Anchor
+    {
+        friend class OutputFormatHelper;
+
+        explicit Anchor(const size_t index)
+        : mIndex{index}
+        {
+        }
+
+        size_t mIndex;
+    };
+
     /// \brief Returns the current position in the output buffer.
-    size_t CurrentPos() const { return mOutput.length(); }
+    size_t CurrentPos() const { return mHolesLength + mOutput.length(); }
+
+    /// \brief Reserve a hole at the current position in the buffer.
+    ///
+    /// Content added to the returned anchor with \ref AppendAt appears at this position, after the content of all
+    /// anchors reserved earlier at the same position. The holes are resolved in a single pass in \ref GetString. The
+    /// anchors stay valid, content added to them afterwards is resolved by the next call.
+    Anchor ReserveAnchor()
+    {
+        mHoles.push_back({mOutput.length(), CurrentPos(), {}});
+        return Anchor{mHoles.size() - 1};
+    }
+
+    /// \brief Append \c data to the hole of \c anchor.
+    void AppendAt(const Anchor& anchor, const std::string& data)
+    {
+        mHoles[anchor.mIndex].content.append(data);
+        mHolesLength += data.length();
+    }
+
+    /// \brief The position the next content added to \c anchor will have in the final buffer.
+    ///
+    /// The content of anchors reserved earlier is included in this position, as long as it was added before \c anchor was
+    /// reserved.
+    size_t AnchorPos(const Anchor& anchor) const
+    {
+        const auto& hole = mHoles[anchor.mIndex];
 
-    /// \brief Insert a string before the position \c atPos
-    void InsertAt(const size_t atPos, const std::string& data) { mOutput.insert(atPos, data); }
+        return hole.pos + hole.content.length();
+    }
 
     STRONG_BOOL(SkipIndenting);
 
@@ -64,10 +119,42 @@ public:
     /// \brief Check whether the buffer is empty.
     ///
     /// This also treats a string of just whitespaces as empty.
-    bool empty() const { return mOutput.empty() || (std::string::npos == mOutput.find_first_not_of(' ', 0)); }
+    bool empty() const;
+
+    /// \brief The last character of the buffer, which must not be empty.
+    char back() const;
 
     /// \brief Returns a reference to the underlying string buffer.
-    std::string& GetString() { return mOutput; }
+    ///
+    /// This resolves all holes reserved with \ref ReserveAnchor. Calling it again resolves only what was added since.
+    std::string& GetString()
+    {
+        ResolveHoles();
+        return mOutput;
+    }
+
+    /// \brief Mark that the code appended from now on is generated from the node at \p loc, see \c --source-map.
+    ///
+    /// A node which starts at the same position as its parent replaces the mark of the parent.
+    void MarkSource(const SourceLocation loc)
+    {
+        if(not IsSourceMapEnabled() or loc.isInvalid()) {
+            return;
+        }
+
+        if(not mSourceMarks.empty() and (mSourceMarks.back().offset == mOutput.length())) {
+            mSourceMarks.back().loc = loc;
+        } else {
+            mSourceMarks.push_back({mOutput.length(), loc});
+        }
+    }
+
+    /// \brief Hand the marks of \ref MarkSource over, their offsets are the ones of the string \ref GetString returns.
+    std::vector<SourceMark> TakeSourceMarks()
+    {
+        ResolveHoles();
+        return std::move(mSourceMarks);
+    }
 
     /// \brief Append a single character
     ///
@@ -107,8 +194,10 @@ public:
 
     /// \brief Append a \c ParamVarDecl array.
     ///
-    /// The parameter name is always added as well.
-    void AppendParameterList(const ArrayRef<ParmVarDecl*> parameters, const NameOnly nameOnly = NameOnly::No);
+    /// The parameter name is always added as well. If given, \p before is called in front of each parameter.
+    void AppendParameterList(const ArrayRef<ParmVarDecl*>                parameters,
+                             const NameOnly                              nameOnly = NameOnly::No,
+                             llvm::function_ref<void(const ParmVarDecl&)> before   = {});
 
     /// \brief Increase the current indention by \c SCOPE_INDENT
     void IncreaseIndent() { mDefaultIndent += SCOPE_INDENT; }
@@ -178,8 +267,21 @@ public:
 
 private:
     static constexpr unsigned SCOPE_INDENT{2};
-    unsigned                  mDefaultIndent;
-    std::string               mOutput;
+    /// \brief A hole reserved with \ref ReserveAnchor.
+    struct Hole
+    {
+        size_t      offset;   //!< The offset in \c mOutput the content belongs in front of.
+        size_t      pos;      //!< The value of \ref CurrentPos at the time the hole was reserved.
+        std::string content;  //!< The content added to the hole.
+    };
+
+    unsigned                mDefaultIndent;
+    std::string             mOutput;         //!< The buffer without the content of the holes.
+    std::vector<Hole>       mHoles;          //!< The reserved holes, ordered by their offset.
+    size_t                  mHolesLength;
+    std::vector<SourceMark> mSourceMarks{};  //!< Ordered by their offset in \c mOutput.
+
+    void ResolveHoles();
 
     void Indent(unsigned count);
     void NewLine()
@@ -10,6 +10,9 @@
 #include "CodeGenerator.h"
 #include "InsightsHelpers.h"
 #include "InsightsMatchers.h"
+#include "InsightsProbes.h"
+#include "InsightsTimeReport.h"
+#include "InsightsTrace.h"
 #include "OutputFormatHelper.h"
 //-----------------------------------------------------------------------------
 
@@ -19,45 +22,55 @@ using namespace clang::ast_matchers;
 
 namespace clang::insights {
 
-RecordDeclHandler::RecordDeclHandler(Rewriter& rewrite, MatchFinder& matcher)
-: InsightsBase(rewrite)
+RecordDeclHandler::RecordDeclHandler(OutputSink& outputSink, MatchFinder& matcher)
+: InsightsBase(outputSink, "RecordDeclHandler")
 {
-    matcher.addMatcher(cxxRecordDecl(hasDefinition(),
-                                     unless(anyOf(isLambda(),
-                                                  hasAncestor(namespaceDecl()),
-                                                  hasAncestor(functionDecl()),
-                                                  hasAncestor(cxxRecordDecl()),
-                                                  isTemplate,
-                                                  isExpansionInSystemHeader(),
-                                                  isMacroOrInvalidLocation())))
-                           .bind("cxxRecordDecl"),
-                       this);
+    AddMatcher(matcher, cxxRecordDecl(hasDefinition(),
+                                      unless(anyOf(isLambda(),
+                                                   hasAncestor(namespaceDecl()),
+                                                   hasAncestor(functionDecl()),
+                                                   hasAncestor(cxxRecordDecl()),
+                                                   isTemplate,
+                                                   isInSystemHeader(),
+                                                   isMacroOrInvalidLocation())))
+                            .bind("cxxRecordDecl"),
+                        this);
 
-    matcher.addMatcher(namespaceDecl(hasParent(translationUnitDecl()),
-                                     unless(anyOf(isExpansionInSystemHeader(), isMacroOrInvalidLocation())))
-                           .bind("namespaceDecl"),
-                       this);
+    // With a limited traversal scope the top-level declarations have no parent, see LimitTraversalScopeToMainFile.
+    AddMatcher(matcher, namespaceDecl(anyOf(hasParent(translationUnitDecl()), unless(hasParent(decl()))),
+                                      unless(anyOf(isInSystemHeader(), isMacroOrInvalidLocation())))
+                            .bind("namespaceDecl"),
+                        this);
 }
 //-----------------------------------------------------------------------------
 
 void RecordDeclHandler::run(const MatchFinder::MatchResult& result)
 {
-    if(const auto* cxxRecordDecl = result.Nodes.getNodeAs<CXXRecordDecl>("cxxRecordDecl")) {
+    TimePhaseScope    timePhase{TimePhase::RecordDeclHandler};
+    DeclTraceScope    timeTrace{"RecordDeclHandler", result};
+    HandlerProbeScope handlerProbe{"RecordDeclHandler", result};
+
+    if(const auto* cxxRecordDecl = result.Nodes.getNodeAs<CXXRecordDecl>("cxxRecordDecl");
+       cxxRecordDecl and MarkGenerated(cxxRecordDecl)) {
         OutputFormatHelper outputFormatHelper{};
 
-        CodeGenerator codeGenerator{outputFormatHelper};
-        codeGenerator.InsertArg(cxxRecordDecl);
+        GenerateCached(*cxxRecordDecl, outputFormatHelper, [&] {
+            CodeGenerator  codeGenerator{outputFormatHelper};
+            DeclTraceScope insertArgTrace{"CodeGenerator::InsertArg", cxxRecordDecl};
+            codeGenerator.InsertArg(cxxRecordDecl);
+        });
 
-        mRewrite.ReplaceText(GetSourceRangeAfterSemi(cxxRecordDecl->getSourceRange(), result),
-                             outputFormatHelper.GetString());
-    } else if(const auto* namespaceDecl = result.Nodes.getNodeAs<NamespaceDecl>("namespaceDecl")) {
+        ReplaceText(GetSourceRangeAfterSemi(cxxRecordDecl->getSourceRange(), result), outputFormatHelper);
+    } else if(const auto* namespaceDecl = result.Nodes.getNodeAs<NamespaceDecl>("namespaceDecl");
+              namespaceDecl and MarkGenerated(namespaceDecl)) {
         OutputFormatHelper outputFormatHelper{};
 
         CodeGenerator codeGenerator{outputFormatHelper};
+        DeclTraceScope insertArgTrace{"CodeGenerator::InsertArg", namespaceDecl};
         codeGenerator.InsertArg(namespaceDecl);
 
-        mRewrite.ReplaceText(GetSourceRangeAfterSemi(namespaceDecl->getSourceRange(), result, RequireSemi::No),
-                             outputFormatHelper.GetString());
+        ReplaceText(GetSourceRangeAfterSemi(namespaceDecl->getSourceRange(), result, RequireSemi::No),
+                    outputFormatHelper);
     }
 }
 //-----------------------------------------------------------------------------
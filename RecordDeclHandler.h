@@ -10,9 +10,6 @@
 
 #include "InsightsBase.h"                      // for InsightsBase
 #include "clang/ASTMatchers/ASTMatchFinder.h"  // for MatchFinder, MatchFind...
-namespace clang {
-class Rewriter;
-}
 //-----------------------------------------------------------------------------
 
 namespace clang::insights {
@@ -25,8 +22,9 @@ namespace clang::insights {
 class RecordDeclHandler final : public ast_matchers::MatchFinder::MatchCallback, public InsightsBase
 {
 public:
-    RecordDeclHandler(Rewriter& rewrite, ast_matchers::MatchFinder& Matcher);
+    RecordDeclHandler(OutputSink& outputSink, ast_matchers::MatchFinder& Matcher);
     void run(const ast_matchers::MatchFinder::MatchResult& result) override;
+    StringRef getID() const override { return "RecordDeclHandler"; }
 };
 //-----------------------------------------------------------------------------
 
@@ -9,6 +9,9 @@
 #include "CodeGenerator.h"
 #include "InsightsHelpers.h"
 #include "InsightsMatchers.h"
+#include "InsightsProbes.h"
+#include "InsightsTimeReport.h"
+#include "InsightsTrace.h"
 #include "OutputFormatHelper.h"
 //-----------------------------------------------------------------------------
 
@@ -18,29 +21,35 @@ using namespace clang::ast_matchers;
 
 namespace clang::insights {
 
-StaticAssertHandler::StaticAssertHandler(Rewriter& rewrite, MatchFinder& matcher)
-: InsightsBase(rewrite)
+StaticAssertHandler::StaticAssertHandler(OutputSink& outputSink, MatchFinder& matcher)
+: InsightsBase(outputSink, "StaticAssertHandler")
 {
-    matcher.addMatcher(staticAssertDecl(unless(anyOf(isExpansionInSystemHeader(),
-                                                     isMacroOrInvalidLocation(),
-                                                     isTemplate,
-                                                     hasAncestor(namespaceDecl()),
-                                                     hasAncestor(functionDecl()))))
-                           .bind("static_assert"),
-                       this);
+    AddMatcher(matcher, staticAssertDecl(unless(anyOf(isInSystemHeader(),
+                                                      isMacroOrInvalidLocation(),
+                                                      isTemplate,
+                                                      hasAncestor(namespaceDecl()),
+                                                      hasAncestor(functionDecl()))))
+                            .bind("static_assert"),
+                        this);
 }
 //-----------------------------------------------------------------------------
 
 void StaticAssertHandler::run(const MatchFinder::MatchResult& result)
 {
-    if(const auto* matchedDecl = result.Nodes.getNodeAs<StaticAssertDecl>("static_assert")) {
+    TimePhaseScope    timePhase{TimePhase::StaticAssertHandler};
+    DeclTraceScope    timeTrace{"StaticAssertHandler", result};
+    HandlerProbeScope handlerProbe{"StaticAssertHandler", result};
+
+    if(const auto* matchedDecl = result.Nodes.getNodeAs<StaticAssertDecl>("static_assert");
+       matchedDecl and MarkGenerated(matchedDecl)) {
         OutputFormatHelper outputFormatHelper{};
         CodeGenerator      codeGenerator{outputFormatHelper};
+        DeclTraceScope insertArgTrace{"CodeGenerator::InsertArg", matchedDecl};
         codeGenerator.InsertArg(matchedDecl);
 
         const auto sr = GetSourceRangeAfterSemi(matchedDecl->getSourceRange(), result);
 
-        mRewrite.ReplaceText(sr, outputFormatHelper.GetString());
+        ReplaceText(sr, outputFormatHelper);
     }
 }
 //-----------------------------------------------------------------------------
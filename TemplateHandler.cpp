@@ -9,10 +9,21 @@
 #include <type_traits>
 #include "ClangCompat.h"
 #include "CodeGenerator.h"
+#include "Insights.h"
+#include "InsightsBloatReport.h"
+#include "InsightsCodegenShards.h"
+#include "InsightsExternTemplates.h"
 #include "InsightsHelpers.h"
+#include "InsightsInstantiationCost.h"
 #include "InsightsMatchers.h"
+#include "InsightsProbes.h"
+#include "InsightsMemoryLimit.h"
+#include "InsightsStrCat.h"
+#include "InsightsTimeReport.h"
+#include "InsightsTrace.h"
 #include "OutputFormatHelper.h"
 
+#include "llvm/Support/Format.h"
 #include "llvm/Support/Path.h"
 //-----------------------------------------------------------------------------
 
@@ -26,25 +37,56 @@ const internal::VariadicDynCastAllOfMatcher<Decl, VarTemplateDecl> varTemplateDe
 
 namespace clang::insights {
 
+/// \brief Insert the compile time Sema spent on the instantiation \p decl, see \c --show-instantiation-cost.
+static void InsertInstantiationCost(OutputFormatHelper& outputFormatHelper, const Decl* decl)
+{
+    const auto* namedDecl = dyn_cast_or_null<NamedDecl>(decl);
+
+    if(not namedDecl) {
+        return;
+    }
+
+    const auto cost = GetInstantiationCost(*namedDecl);
+
+    if(not cost) {
+        return;
+    }
+
+    if(IsInstantiationReportEnabled()) {
+        RecordInstantiationCost(*namedDecl, *cost);
+    }
+
+    if(GetInsightsOptions().ShowInstantiationCost) {
+        std::string milliseconds{};
+        llvm::raw_string_ostream{milliseconds} << llvm::format("%.3f", static_cast<double>(*cost) / 1000.0);
+
+        outputFormatHelper.AppendNewLine("/* instantiation: ", milliseconds, " ms of compile time */");
+    }
+}
+//-----------------------------------------------------------------------------
+
 /// \brief Insert the instantiated template with the resulting code.
 static OutputFormatHelper InsertInstantiatedTemplate(const Decl* decl)
 {
     OutputFormatHelper outputFormatHelper{};
     outputFormatHelper.AppendNewLine();
     outputFormatHelper.AppendNewLine();
+    InsertInstantiationCost(outputFormatHelper, decl);
 
     CodeGenerator codeGenerator{outputFormatHelper};
+    DeclTraceScope insertArgTrace{"CodeGenerator::InsertArg", decl};
     codeGenerator.InsertArg(decl);
 
     return outputFormatHelper;
 }
 //-----------------------------------------------------------------------------
 
-TemplateHandler::TemplateHandler(Rewriter& rewrite, MatchFinder& matcher)
-: InsightsBase(rewrite)
+TemplateHandler::TemplateHandler(OutputSink& outputSink, MatchFinder& matcher)
+: InsightsBase(outputSink, "TemplateHandler")
 {
-    matcher.addMatcher(
-        functionDecl(allOf(unless(isExpansionInSystemHeader()),
+    AddMatcher(
+        matcher,
+        functionDecl(allOf(unless(isInSystemHeader()),
                            unless(isMacroOrInvalidLocation()),
                            unless(hasAncestor(namespaceDecl())),
                            hasParent(functionTemplateDecl(unless(hasParent(classTemplateSpecializationDecl())),
@@ -54,71 +96,217 @@ TemplateHandler::TemplateHandler(Rewriter& rewrite, MatchFinder& matcher)
         this);
 
     // match typical use where a class template is defined and it is used later.
-    matcher.addMatcher(
+    AddMatcher(
+        matcher,
         classTemplateSpecializationDecl(
-            unless(anyOf(isExpansionInSystemHeader(), hasAncestor(namespaceDecl()), hasAncestor(cxxRecordDecl()))),
+            unless(anyOf(isInSystemHeader(), hasAncestor(namespaceDecl()), hasAncestor(cxxRecordDecl()))),
             hasParent(classTemplateDecl().bind("decl")))
             .bind("class"),
         this);
 
     // special case, where a class template is defined and somewhere else we request an explicit instantiation
-    matcher.addMatcher(classTemplateSpecializationDecl(unless(anyOf(isExpansionInSystemHeader(),
-                                                                    hasAncestor(namespaceDecl()),
-                                                                    hasParent(classTemplateDecl()),
-                                                                    isExplicitTemplateSpecialization())))
-                           .bind("class"),
-                       this);
-
-    matcher.addMatcher(
+    AddMatcher(matcher, classTemplateSpecializationDecl(unless(anyOf(isInSystemHeader(),
+                                                                     hasAncestor(namespaceDecl()),
+                                                                     hasParent(classTemplateDecl()),
+                                                                     isExplicitTemplateSpecialization())))
+                            .bind("class"),
+                        this);
+
+    AddMatcher(
+        matcher,
         varTemplateDecl(
-            unless(anyOf(isExpansionInSystemHeader(), hasAncestor(namespaceDecl()), hasParent(classTemplateDecl()))))
+            unless(anyOf(isInSystemHeader(), hasAncestor(namespaceDecl()), hasParent(classTemplateDecl()))))
             .bind("vd"),
         this);
-
-    matcher.addMatcher(classTemplateSpecializationDecl(unless(anyOf(isExpansionInSystemHeader(),
-                                                                    hasAncestor(namespaceDecl()),
-                                                                    hasParent(classTemplateDecl()),
-                                                                    isExplicitTemplateSpecialization())))
-                           .bind("class"),
-                       this);
 }
 //-----------------------------------------------------------------------------
 
 void TemplateHandler::run(const MatchFinder::MatchResult& result)
 {
+    TimePhaseScope    timePhase{TimePhase::TemplateHandler};
+    DeclTraceScope    timeTrace{"TemplateHandler", result};
+    HandlerProbeScope handlerProbe{"TemplateHandler", result};
+
+    // The limits are checked before the shard, all shards must suppress the same instantiations.
     if(const auto* functionDecl = result.Nodes.getNodeAs<FunctionDecl>("func")) {
-        if(not functionDecl->getBody() && not isa<CXXDeductionGuideDecl>(functionDecl)) {
+        if((not functionDecl->getBody() && not isa<CXXDeductionGuideDecl>(functionDecl)) or
+           not MarkFirstMatch(functionDecl)) {
+            return;
+        }
+
+        const auto  endOfCond = FindLocationAfterSemi(GetEndLoc(functionDecl), result);
+        const auto* primary   = functionDecl->getPrimaryTemplate();
+
+        if(not IsWithinLimits(primary ? *static_cast<const NamedDecl*>(primary) : *functionDecl,
+                              endOfCond.getLocWithOffset(1),
+                              InsertBefore::No) or
+           not TakeGenerationUnit()) {
             return;
         }
 
         OutputFormatHelper outputFormatHelper = InsertInstantiatedTemplate(functionDecl);
-        const auto         endOfCond          = FindLocationAfterSemi(GetEndLoc(functionDecl), result);
+        AddGeneratedBytes(outputFormatHelper);
+
+        if(IsBloatReportEnabled()) {
+            const NamedDecl& tmpl = primary ? *static_cast<const NamedDecl*>(primary) : *functionDecl;
+
+            if(const auto* args = functionDecl->getTemplateSpecializationArgs()) {
+                RecordInstantiation(tmpl, args->asArray());
+            }
+
+            RecordGeneratedCode(tmpl, outputFormatHelper.GetString());
+        }
+
+        if(IsExternTemplatesEnabled()) {
+            RecordExternTemplate(*functionDecl, outputFormatHelper.GetString().size());
+        }
 
         InsertIndentedText(endOfCond.getLocWithOffset(1), outputFormatHelper);
 
     } else if(const auto* clsTmplSpecDecl = result.Nodes.getNodeAs<ClassTemplateSpecializationDecl>("class")) {
         // skip classes/struct's without a definition
-        if(not clsTmplSpecDecl->hasDefinition()) {
+        if(not clsTmplSpecDecl->hasDefinition() or not MarkFirstMatch(clsTmplSpecDecl)) {
+            return;
+        }
+
+        const auto* clsTmplDecl = result.Nodes.getNodeAs<ClassTemplateDecl>("decl");
+        const auto  summaryLoc =
+            clsTmplDecl ? FindLocationAfterSemi(GetEndLoc(clsTmplDecl), result) : clsTmplSpecDecl->getBeginLoc();
+
+        if(not IsWithinLimits(*clsTmplSpecDecl->getSpecializedTemplate(),
+                              summaryLoc,
+                              clsTmplDecl ? InsertBefore::No : InsertBefore::Yes) or
+           not TakeGenerationUnit()) {
             return;
         }
 
         OutputFormatHelper outputFormatHelper = InsertInstantiatedTemplate(clsTmplSpecDecl);
+        AddGeneratedBytes(outputFormatHelper);
 
-        if(const auto* clsTmplDecl = result.Nodes.getNodeAs<ClassTemplateDecl>("decl")) {
+        if(IsBloatReportEnabled()) {
+            const auto& tmpl = *clsTmplSpecDecl->getSpecializedTemplate();
+
+            RecordInstantiation(tmpl, clsTmplSpecDecl->getTemplateArgs().asArray());
+            RecordGeneratedCode(tmpl, outputFormatHelper.GetString());
+        }
+
+        if(IsExternTemplatesEnabled()) {
+            RecordExternTemplate(*clsTmplSpecDecl, outputFormatHelper.GetString().size());
+        }
+
+        if(clsTmplDecl) {
             const auto endOfCond = FindLocationAfterSemi(GetEndLoc(clsTmplDecl), result);
             InsertIndentedText(endOfCond, outputFormatHelper);
 
         } else {  // explicit specialization, we have to remove the specialization
-            mRewrite.ReplaceText(clsTmplSpecDecl->getSourceRange(), outputFormatHelper.GetString());
+            ReplaceText(clsTmplSpecDecl->getSourceRange(), outputFormatHelper);
+        }
+
+    } else if(const auto* vd = result.Nodes.getNodeAs<VarTemplateDecl>("vd"); vd and MarkFirstMatch(vd)) {
+        const auto specializations =
+            static_cast<uint64_t>(std::distance(vd->specializations().begin(), vd->specializations().end()));
+
+        if(not IsWithinLimits(*vd, vd->getBeginLoc(), InsertBefore::Yes, specializations) or not TakeGenerationUnit()) {
+            return;
         }
 
-    } else if(const auto* vd = result.Nodes.getNodeAs<VarTemplateDecl>("vd")) {
         OutputFormatHelper outputFormatHelper = InsertInstantiatedTemplate(vd);
-        const auto         endOfCond          = FindLocationAfterSemi(GetEndLoc(vd), result);
+        AddGeneratedBytes(outputFormatHelper);
+
+        // All specializations of a variable template are generated together.
+        if(IsBloatReportEnabled()) {
+            for(const auto* spec : vd->specializations()) {
+                RecordInstantiation(*vd, spec->getTemplateArgs().asArray());
+            }
+
+            RecordGeneratedCode(*vd, outputFormatHelper.GetString());
+        }
+
+        const auto endOfCond = FindLocationAfterSemi(GetEndLoc(vd), result);
+
+        ReplaceText({vd->getSourceRange().getBegin(), endOfCond.getLocWithOffset(1)}, outputFormatHelper);
+    }
+}
+//-----------------------------------------------------------------------------
+
+bool TemplateHandler::IsWithinLimits(const NamedDecl&   tmpl,
+                                     SourceLocation     loc,
+                                     const InsertBefore insertBefore,
+                                     const uint64_t     count)
+{
+    const auto& options = GetInsightsOptions();
+    const bool  withinInstantiations{(0 == options.maxInstantiations) or
+                                    (mInstantiations + count <= options.maxInstantiations)};
+    const bool  withinBytes{(0 == options.maxOutputBytes) or (mGeneratedBytes < options.maxOutputBytes)};
+    const bool  withinMemory{not IsMemoryLimitReached()};
+
+    if(withinInstantiations and withinBytes and withinMemory) {
+        mInstantiations += count;
+        return true;
+    }
+
+    auto& suppressed = mSuppressed[&tmpl];
+
+    if(0 == suppressed.count) {
+        suppressed.loc          = loc;
+        suppressed.insertBefore = insertBefore;
+        suppressed.name         = GetName(tmpl);
+        suppressed.reason       = [&]() -> std::string {
+            if(not withinMemory) {
+                return "--max-memory-mb";
+            } else if(not withinInstantiations) {
+                return StrCat("--max-instantiations=", options.maxInstantiations);
+            }
+
+            return StrCat("--max-output-bytes=", options.maxOutputBytes);
+        }();
+    }
+
+    suppressed.count += count;
+
+    return false;
+}
+//-----------------------------------------------------------------------------
+
+void TemplateHandler::AddGeneratedBytes(OutputFormatHelper& outputFormatHelper)
+{
+    mGeneratedBytes += outputFormatHelper.GetString().size();
+}
+//-----------------------------------------------------------------------------
 
-        mRewrite.ReplaceText({vd->getSourceRange().getBegin(), endOfCond.getLocWithOffset(1)},
-                             outputFormatHelper.GetString());
+void TemplateHandler::InsertSuppressedSummary()
+{
+    for(const auto& [tmpl, suppressed] : mSuppressed) {
+        // With --codegen-jobs every shard has the same summary, only one of them inserts it.
+        if(not TakeGenerationUnit()) {
+            continue;
+        }
+
+        OutputFormatHelper outputFormatHelper{};
+
+        const char* instantiations{(1 == suppressed.count) ? " more instantiation of " : " more instantiations of "};
+        const auto  summary = StrCat("/* ",
+                                     suppressed.count,
+                                     instantiations,
+                                     suppressed.name,
+                                     " suppressed, ",
+                                     suppressed.reason,
+                                     " reached */");
+
+        // Behind a declaration the line break of the source ends the summary, in front of one it needs its own.
+        if(InsertBefore::No == suppressed.insertBefore) {
+            outputFormatHelper.AppendNewLine();
+            outputFormatHelper.Append(summary);
+
+        } else {
+            outputFormatHelper.AppendNewLine(summary);
+        }
+
+        InsertIndentedText(suppressed.loc, outputFormatHelper);
     }
+
+    // With --stream this runs after each top-level declaration.
+    mSuppressed.clear();
 }
 //-----------------------------------------------------------------------------
 
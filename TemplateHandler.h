@@ -9,10 +9,11 @@
 #define INSIGHTS_TEMPLATE_HANDLER_H
 
 #include "InsightsBase.h"                      // for InsightsBase
+#include "InsightsStrongTypes.h"               // for STRONG_BOOL
 #include "clang/ASTMatchers/ASTMatchFinder.h"  // for MatchFinder, MatchFind...
-namespace clang {
-class Rewriter;
-}
+#include "llvm/ADT/MapVector.h"                // for MapVector
+
+#include <string>
 //-----------------------------------------------------------------------------
 
 namespace clang::insights {
@@ -21,11 +22,51 @@ namespace clang::insights {
 ///
 /// Currently only template functions are supported. Classes are not generated fully. As placing the resulting code is
 /// not easy all generated functions are placed behind a \c ifdef \c INSIGHTS_USE_TEMPLATE.
+///
+/// The number of instantiations and the size of the generated code are limited by \c --max-instantiations and \c
+/// --max-output-bytes. Once a limit is reached, no code is generated for further instantiations. Instead, there is
+/// a single comment per template telling how many of its instantiations were suppressed.
 class TemplateHandler final : public ast_matchers::MatchFinder::MatchCallback, public InsightsBase
 {
 public:
-    TemplateHandler(Rewriter& rewrite, ast_matchers::MatchFinder& matcher);
+    TemplateHandler(OutputSink& outputSink, ast_matchers::MatchFinder& matcher);
     void run(const ast_matchers::MatchFinder::MatchResult& result) override;
+    StringRef getID() const override { return "TemplateHandler"; }
+
+    /// \brief Insert the comments for the suppressed instantiations, once all matches are handled.
+    void InsertSuppressedSummary();
+
+    /// \brief The number of instantiations generated so far.
+    uint64_t GetInstantiations() const { return mInstantiations; }
+
+private:
+    STRONG_BOOL(InsertBefore);
+
+    /// \brief The instantiations of a single template which exceeded the limits.
+    struct Suppressed
+    {
+        SourceLocation loc;           //!< Where the first suppressed instantiation would have been generated.
+        InsertBefore   insertBefore;  //!< Whether \c loc is the begin of a declaration the summary goes before.
+        std::string    name;          //!< The name of the template.
+        std::string    reason;        //!< The limit which was reached first.
+        uint64_t       count;         //!< The number of suppressed instantiations.
+    };
+
+    uint64_t                                 mInstantiations{};
+    uint64_t                                 mGeneratedBytes{};
+    llvm::MapVector<const Decl*, Suppressed> mSuppressed{};
+
+    /// \brief Check whether the limits allow to generate \p count more instantiations of \p tmpl.
+    ///
+    /// If not, they get counted for the summary at \p loc, which goes before the declaration at \p loc with \p
+    /// insertBefore.
+    bool IsWithinLimits(const NamedDecl&   tmpl,
+                        SourceLocation     loc,
+                        const InsertBefore insertBefore,
+                        const uint64_t     count = 1);
+
+    /// \brief Note the size of the code generated for an instantiation.
+    void AddGeneratedBytes(OutputFormatHelper& outputFormatHelper);
 };
 //-----------------------------------------------------------------------------
 
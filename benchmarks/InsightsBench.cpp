@@ -0,0 +1,386 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "clang/AST/ASTContext.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <benchmark/benchmark.h>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CodeGenerator.h"
+#include "DPrint.h"
+#include "Insights.h"
+#include "InsightsArena.h"
+#include "InsightsHelpers.h"
+#include "InsightsStrCat.h"
+#include "OutputFormatHelper.h"
+#include "version.h"
+//-----------------------------------------------------------------------------
+
+using namespace clang;
+using namespace clang::insights;
+//-----------------------------------------------------------------------------
+
+namespace {
+/// \brief A test input from \c tests, parsed once before the benchmarks run.
+///
+/// Only the code generation is measured, parsing is not of interest here.
+struct Fixture
+{
+    std::unique_ptr<ASTUnit> unit{};
+    InsightsContext          context{};
+    std::vector<const Decl*> decls{};  //!< The top-level declarations of the main file.
+    std::vector<QualType>    types{};  //!< The types of all variables, parameters and fields of the main file.
+    std::vector<std::string> names{};  //!< The qualified names of all named declarations of the main file.
+    const NamespaceDecl*     ns{};     //!< The first namespace of the main file, if any.
+};
+
+class Collector : public RecursiveASTVisitor<Collector>
+{
+public:
+    explicit Collector(Fixture& fixture)
+    : mFixture{fixture}
+    , mSm{fixture.unit->getSourceManager()}
+    {
+    }
+
+    bool VisitDecl(Decl* decl)
+    {
+        if(not mSm.isInMainFile(decl->getLocation())) {
+            return true;
+        }
+
+        if(const auto* valueDecl = dyn_cast<ValueDecl>(decl)) {
+            mFixture.types.push_back(valueDecl->getType());
+        }
+
+        if(const auto* namedDecl = dyn_cast<NamedDecl>(decl); namedDecl and namedDecl->getDeclName().isIdentifier()) {
+            mFixture.names.push_back(namedDecl->getQualifiedNameAsString());
+        }
+
+        if(const auto* namespaceDecl = dyn_cast<NamespaceDecl>(decl); namespaceDecl and not mFixture.ns) {
+            mFixture.ns = namespaceDecl;
+        }
+
+        return true;
+    }
+
+private:
+    Fixture&             mFixture;
+    const SourceManager& mSm;
+};
+}  // namespace
+//-----------------------------------------------------------------------------
+
+/// \brief The inputs, a mix of classes with operators, lambdas, templates and namespaces.
+static const char* FIXTURE_NAMES[]{
+    "ClassOperatorHandlerTest.cpp",
+    "LambdaHandlerTest.cpp",
+    "TemplateHandlerTest.cpp",
+    "NamespaceTest.cpp",
+};
+//-----------------------------------------------------------------------------
+
+static std::vector<std::unique_ptr<Fixture>> gFixtures{};  // NOLINT
+//-----------------------------------------------------------------------------
+
+static bool LoadFixtures()
+{
+    for(const auto* name : FIXTURE_NAMES) {
+        const std::string path{StrCat(INSIGHTS_BENCH_FIXTURES_DIR, "/", name)};
+        auto              buffer = llvm::MemoryBuffer::getFile(path);
+
+        if(not buffer) {
+            Error("insights-bench: cannot read '%s'\n", path);
+            return false;
+        }
+
+        auto fixture  = std::make_unique<Fixture>();
+        fixture->unit = tooling::buildASTFromCodeWithArgs(
+            (*buffer)->getBuffer(),
+            {"-std=c++17", INSIGHTS_CLANG_RESOURCE_DIR, INSIGHTS_CLANG_RESOURCE_INCLUDE_DIR},
+            path);
+
+        if(not fixture->unit or fixture->unit->getDiagnostics().hasErrorOccurred()) {
+            Error("insights-bench: cannot parse '%s'\n", path);
+            return false;
+        }
+
+        auto& ast            = fixture->unit->getASTContext();
+        fixture->context.ast = &ast;
+
+        for(const auto* decl : ast.getTranslationUnitDecl()->decls()) {
+            if(ast.getSourceManager().isInMainFile(decl->getLocation())) {
+                fixture->decls.push_back(decl);
+            }
+        }
+
+        Collector{*fixture}.TraverseDecl(ast.getTranslationUnitDecl());
+
+        gFixtures.push_back(std::move(fixture));
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Reset the state of the code generation, as \c HandleTranslationUnit does for each translation unit.
+static void ResetTranslationUnit()
+{
+    CodeGenerator::ResetTranslationUnitState();
+    ResetTypeNameCache();
+    ResetTokenIndex();
+    ResetArena();
+}
+//-----------------------------------------------------------------------------
+
+static void BM_StrCat(benchmark::State& state)
+{
+    const std::string name{"someVariableName"};
+    const llvm::APSInt value{llvm::APInt{64, 4711}, true};
+
+    for(auto _ : state) {
+        auto str = StrCat("static_cast<", name, ">(", 42, ", ", value, ", ", StringRef{"__range1"}, ")");
+        benchmark::DoNotOptimize(str);
+    }
+}
+BENCHMARK(BM_StrCat);
+//-----------------------------------------------------------------------------
+
+static void BM_Normalize(benchmark::State& state)
+{
+    const llvm::APInt  apInt{64, 123456789};
+    const llvm::APSInt apsInt{llvm::APInt{64, 4711}, true};
+
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(Normalize(apInt));
+        benchmark::DoNotOptimize(Normalize(apsInt));
+    }
+}
+BENCHMARK(BM_Normalize);
+//-----------------------------------------------------------------------------
+
+/// \brief Append \c state.range(0) statements of a typical length.
+static void BM_OutputFormatHelperAppend(benchmark::State& state)
+{
+    for(auto _ : state) {
+        OutputFormatHelper outputFormatHelper{};
+
+        for(int64_t i = 0; i < state.range(0); ++i) {
+            outputFormatHelper.Append("int", " ", "__range", i, " = ", "begin", "(", ")");
+            outputFormatHelper.AppendSemiNewLine();
+        }
+
+        benchmark::DoNotOptimize(outputFormatHelper.GetString());
+    }
+}
+BENCHMARK(BM_OutputFormatHelperAppend)->Range(16, 16 << 10);
+//-----------------------------------------------------------------------------
+
+/// \brief Reserve an anchor for every statement and fill each one, like the insertion of the closure classes of
+/// lambdas. This replaced \c InsertAt.
+static void BM_OutputFormatHelperInsertAt(benchmark::State& state)
+{
+    for(auto _ : state) {
+        OutputFormatHelper outputFormatHelper{};
+
+        for(int64_t i = 0; i < state.range(0); ++i) {
+            const auto anchor = outputFormatHelper.ReserveAnchor();
+            outputFormatHelper.AppendSemiNewLine("auto l", i, " = __lambda_", i, "{}");
+            outputFormatHelper.AppendAt(anchor, "class __lambda_1 { public: inline void operator()() const {} };\n");
+        }
+
+        benchmark::DoNotOptimize(outputFormatHelper.GetString());
+    }
+}
+BENCHMARK(BM_OutputFormatHelperInsertAt)->Range(16, 16 << 10);
+//-----------------------------------------------------------------------------
+
+/// \brief New lines in nested scopes of a depth of \c state.range(0), which is what \c Indent is called for.
+static void BM_OutputFormatHelperIndent(benchmark::State& state)
+{
+    for(auto _ : state) {
+        OutputFormatHelper outputFormatHelper{};
+
+        for(int64_t i = 0; i < state.range(0); ++i) {
+            outputFormatHelper.OpenScope();
+        }
+
+        for(int i = 0; i < 1024; ++i) {
+            outputFormatHelper.AppendSemiNewLine("x");
+        }
+
+        for(int64_t i = 0; i < state.range(0); ++i) {
+            outputFormatHelper.CloseScope();
+        }
+
+        benchmark::DoNotOptimize(outputFormatHelper.GetString());
+    }
+}
+BENCHMARK(BM_OutputFormatHelperIndent)->Range(1, 64);
+//-----------------------------------------------------------------------------
+
+/// \brief Get the names of all types of a fixture, the type name cache starts empty in each iteration.
+static void BM_GetNameQualType(benchmark::State& state)
+{
+    auto&                fixture = *gFixtures[static_cast<size_t>(state.range(0))];
+    InsightsContextScope contextScope{fixture.context};
+
+    for(auto _ : state) {
+        ResetTranslationUnit();
+
+        for(const auto& type : fixture.types) {
+            benchmark::DoNotOptimize(GetName(type));
+        }
+    }
+
+    state.SetLabel(FIXTURE_NAMES[static_cast<size_t>(state.range(0))]);
+}
+BENCHMARK(BM_GetNameQualType)->DenseRange(0, std::size(FIXTURE_NAMES) - 1);
+//-----------------------------------------------------------------------------
+
+static void BM_GetTypeNameAsParameter(benchmark::State& state)
+{
+    auto&                fixture = *gFixtures[static_cast<size_t>(state.range(0))];
+    InsightsContextScope contextScope{fixture.context};
+    const std::string    varName{"param"};
+
+    for(auto _ : state) {
+        ResetTranslationUnit();
+
+        for(const auto& type : fixture.types) {
+            benchmark::DoNotOptimize(GetTypeNameAsParameter(type, varName));
+        }
+    }
+
+    state.SetLabel(FIXTURE_NAMES[static_cast<size_t>(state.range(0))]);
+}
+BENCHMARK(BM_GetTypeNameAsParameter)->DenseRange(0, std::size(FIXTURE_NAMES) - 1);
+//-----------------------------------------------------------------------------
+
+/// \brief Remove the scope of the first namespace of a fixture from all its qualified names.
+static void BM_RemoveCurrentScope(benchmark::State& state)
+{
+    auto&                fixture = *gFixtures[static_cast<size_t>(state.range(0))];
+    InsightsContextScope contextScope{fixture.context};
+    ResetTranslationUnit();
+
+    SCOPE_HELPER(fixture.ns);
+
+    for(auto _ : state) {
+        for(const auto& name : fixture.names) {
+            benchmark::DoNotOptimize(ScopeHandler::RemoveCurrentScope(name));
+        }
+    }
+
+    state.SetLabel(FIXTURE_NAMES[static_cast<size_t>(state.range(0))]);
+}
+BENCHMARK(BM_RemoveCurrentScope)->DenseRange(0, std::size(FIXTURE_NAMES) - 1);
+//-----------------------------------------------------------------------------
+
+/// \brief Generate the code for all top-level declarations of a fixture, mostly the dispatch of \c InsertArg.
+static void BM_InsertArg(benchmark::State& state)
+{
+    auto&                fixture = *gFixtures[static_cast<size_t>(state.range(0))];
+    InsightsContextScope contextScope{fixture.context};
+
+    for(auto _ : state) {
+        ResetTranslationUnit();
+
+        for(const auto* decl : fixture.decls) {
+            OutputFormatHelper outputFormatHelper{};
+            CodeGenerator      codeGenerator{outputFormatHelper};
+            codeGenerator.InsertArg(decl);
+
+            benchmark::DoNotOptimize(outputFormatHelper.GetString());
+        }
+    }
+
+    state.SetLabel(FIXTURE_NAMES[static_cast<size_t>(state.range(0))]);
+}
+BENCHMARK(BM_InsertArg)->DenseRange(0, std::size(FIXTURE_NAMES) - 1);
+//-----------------------------------------------------------------------------
+
+/// \brief Generate the code for \c main, which returns the result of lambdas nested \c state.range(0) levels deep.
+///
+/// The class of each lambda is placed before the return statement, finding that place must not depend on the depth.
+static void BM_NestedLambdas(benchmark::State& state)
+{
+    const auto  depth = static_cast<size_t>(state.range(0));
+    std::string source{"int main()\n{\n  int v{};\n  return "};
+
+    for(size_t i = 0; i < depth; ++i) {
+        source.append("[&] { return ");
+    }
+
+    source.append("v");
+
+    for(size_t i = 0; i < depth; ++i) {
+        source.append("; }()");
+    }
+
+    source.append(";\n}\n");
+
+    Fixture fixture{};
+    fixture.unit =
+        tooling::buildASTFromCodeWithArgs(source, {"-std=c++17", "-fbracket-depth=1024"}, "NestedLambdas.cpp");
+
+    if(not fixture.unit or fixture.unit->getDiagnostics().hasErrorOccurred()) {
+        state.SkipWithError("cannot parse the nested lambdas");
+        return;
+    }
+
+    auto& ast           = fixture.unit->getASTContext();
+    fixture.context.ast = &ast;
+
+    for(const auto* decl : ast.getTranslationUnitDecl()->decls()) {
+        if(ast.getSourceManager().isInMainFile(decl->getLocation())) {
+            fixture.decls.push_back(decl);
+        }
+    }
+
+    InsightsContextScope contextScope{fixture.context};
+
+    for(auto _ : state) {
+        ResetTranslationUnit();
+
+        for(const auto* decl : fixture.decls) {
+            OutputFormatHelper outputFormatHelper{};
+            CodeGenerator      codeGenerator{outputFormatHelper};
+            codeGenerator.InsertArg(decl);
+
+            benchmark::DoNotOptimize(outputFormatHelper.GetString());
+        }
+    }
+}
+BENCHMARK(BM_NestedLambdas)->Arg(10)->Arg(100)->Arg(500);
+//-----------------------------------------------------------------------------
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+
+    // scripts/bench-history.py stores each run with the build it measured.
+    benchmark::AddCustomContext("git_commit", GIT_COMMIT_HASH);
+    benchmark::AddCustomContext("llvm_revision", getClangFullRepositoryVersion());
+
+    if(benchmark::ReportUnrecognizedArguments(argc, argv) or not LoadFixtures()) {
+        return 1;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+
+    return 0;
+}
+//-----------------------------------------------------------------------------
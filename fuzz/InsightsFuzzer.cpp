@@ -0,0 +1,139 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#include "DPrint.h"
+#include "Insights.h"
+#include "InsightsStrCat.h"
+//-----------------------------------------------------------------------------
+
+using namespace clang::insights;
+//-----------------------------------------------------------------------------
+
+/// \brief An input which takes longer than this many milliseconds to transform is a finding.
+static uint64_t gMaxMs{1000};
+
+/// \brief An output larger than this many times the input is a finding.
+static uint64_t gMaxGrowth{50};
+
+/// \brief Below this input size the growth is not checked, a few characters turn into a lot of code easily.
+static constexpr size_t MIN_GROWTH_INPUT_SIZE{256};
+
+/// \brief Where the reproducers are written, empty to write none.
+static std::string gPerfDir{};
+//-----------------------------------------------------------------------------
+
+static uint64_t GetEnv(const char* name, const uint64_t deflt)
+{
+    if(const char* value = std::getenv(name)) {
+        return std::strtoull(value, nullptr, 10);
+    }
+
+    return deflt;
+}
+//-----------------------------------------------------------------------------
+
+extern "C" int LLVMFuzzerInitialize(int* /*argc*/, char*** /*argv*/)
+{
+    // libFuzzer owns the command line, the limits come from the environment.
+    gMaxMs     = GetEnv("INSIGHTS_FUZZ_MAX_MS", gMaxMs);
+    gMaxGrowth = GetEnv("INSIGHTS_FUZZ_MAX_GROWTH", gMaxGrowth);
+
+    if(const char* perfDir = std::getenv("INSIGHTS_FUZZ_PERF_DIR")) {
+        gPerfDir = perfDir;
+    }
+
+    return 0;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Keep \p code as a test input in \c gPerfDir. With \c -minimize_crash=1 every smaller reproducer is written
+/// as well, the size in the name shows which one is the smallest.
+static void SaveReproducer(const std::string& code, const char* reason)
+{
+    if(gPerfDir.empty()) {
+        return;
+    }
+
+    if(const auto ec = llvm::sys::fs::create_directories(gPerfDir)) {
+        Error("insights-fuzzer: cannot create '%s': %s\n", gPerfDir, ec.message());
+        return;
+    }
+
+    llvm::SmallString<256> path{gPerfDir};
+    llvm::sys::path::append(path,
+                            StrCat(reason,
+                                   "-",
+                                   code.size(),
+                                   "-",
+                                   static_cast<uint64_t>(llvm::hash_value(code)),
+                                   ".cpp"));
+
+    std::error_code      ec{};
+    llvm::raw_fd_ostream file{path, ec};
+
+    if(ec) {
+        Error("insights-fuzzer: cannot write '%s': %s\n", path.str(), ec.message());
+        return;
+    }
+
+    file << code;
+}
+//-----------------------------------------------------------------------------
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    const std::string code{reinterpret_cast<const char*>(data), size};
+
+    std::string              output{};
+    llvm::raw_string_ostream outputStream{output};
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Inputs which do not compile are fine, only the time and the size of the output are of interest.
+    TransformCode("fuzz.cpp", code, {"-std=c++17"}, outputStream, llvm::nulls());
+
+    const auto elapsedMs =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+    outputStream.flush();
+
+    const char* reason{};
+
+    if(static_cast<uint64_t>(elapsedMs) > gMaxMs) {
+        reason = "slow";
+        Error("insights-fuzzer: transformation took %lld ms, the limit is %llu ms\n",
+              static_cast<long long>(elapsedMs),
+              static_cast<unsigned long long>(gMaxMs));
+
+    } else if((size >= MIN_GROWTH_INPUT_SIZE) and (output.size() > (gMaxGrowth * size))) {
+        reason = "growth";
+        Error("insights-fuzzer: %zu bytes of output for %zu bytes of input, the limit is %llux\n",
+              output.size(),
+              size,
+              static_cast<unsigned long long>(gMaxGrowth));
+    }
+
+    if(reason) {
+        SaveReproducer(code, reason);
+
+        // A crash for libFuzzer, which keeps the input as an artifact and can minimize it.
+        std::abort();
+    }
+
+    return 0;
+}
+//-----------------------------------------------------------------------------
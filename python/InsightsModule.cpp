@@ -0,0 +1,222 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "llvm/ADT/StringRef.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Insights.h"
+//-----------------------------------------------------------------------------
+
+/// \brief Read the list or tuple of strings \p sequence into \p strings.
+///
+/// \returns \c false with a Python exception set, if \p sequence is not a sequence of strings.
+static bool GetStrings(PyObject* sequence, std::vector<std::string>& strings, const char* what)
+{
+    if(not sequence) {
+        return true;
+    }
+
+    PyObject* fast = PySequence_Fast(sequence, what);
+
+    if(not fast) {
+        return false;
+    }
+
+    const Py_ssize_t size = PySequence_Fast_GET_SIZE(fast);
+    strings.reserve(static_cast<size_t>(size));
+
+    for(Py_ssize_t i = 0; i < size; ++i) {
+        Py_ssize_t  length{};
+        const char* str = PyUnicode_AsUTF8AndSize(PySequence_Fast_GET_ITEM(fast, i), &length);
+
+        if(not str) {
+            Py_DECREF(fast);
+            return false;
+        }
+
+        strings.emplace_back(str, static_cast<size_t>(length));
+    }
+
+    Py_DECREF(fast);
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief Turn the names of \p sequence, like \c show-all-implicit-casts, into \p options.
+static bool GetOptions(PyObject* sequence, InsightsOptions& options)
+{
+    std::vector<std::string> names{};
+
+    if(not GetStrings(sequence, names, "options must be a sequence of strings")) {
+        return false;
+    }
+
+    for(const auto& name : names) {
+        if(not SetInsightsOption(name, options)) {
+            PyErr_Format(PyExc_ValueError, "unknown option: %s", name.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The result as a \c dict with \c code, \c diagnostics, \c return_code and \c time_ms.
+static PyObject* MakeResult(const TransformResult& result)
+{
+    return Py_BuildValue("{s:s#,s:s#,s:i,s:d}",
+                         "code",
+                         result.code.data(),
+                         static_cast<Py_ssize_t>(result.code.size()),
+                         "diagnostics",
+                         result.diagnostics.data(),
+                         static_cast<Py_ssize_t>(result.diagnostics.size()),
+                         "return_code",
+                         result.returnCode,
+                         "time_ms",
+                         result.stats.timeMs);
+}
+//-----------------------------------------------------------------------------
+
+static PyObject* Transform(PyObject* /*self*/, PyObject* args, PyObject* kwargs)
+{
+    static const char* keywords[]{"source", "args", "options", "file_name", nullptr};
+
+    const char* source{};
+    Py_ssize_t  sourceLength{};
+    PyObject*   compilerArgsObj{};
+    PyObject*   optionsObj{};
+    const char* fileName{"input.cpp"};
+
+    if(not PyArg_ParseTupleAndKeywords(args,
+                                       kwargs,
+                                       "s#|OOs",
+                                       const_cast<char**>(keywords),
+                                       &source,
+                                       &sourceLength,
+                                       &compilerArgsObj,
+                                       &optionsObj,
+                                       &fileName)) {
+        return nullptr;
+    }
+
+    std::vector<std::string> compilerArgs{};
+    InsightsOptions          options{GetDefaultInsightsOptions()};
+
+    if(not GetStrings(compilerArgsObj, compilerArgs, "args must be a sequence of strings") or
+       not GetOptions(optionsObj, options)) {
+        return nullptr;
+    }
+
+    const std::string code{source, static_cast<size_t>(sourceLength)};
+    const std::string name{fileName};
+    TransformResult   result{};
+
+    // The source is a copy, nothing of Python is touched without the GIL.
+    Py_BEGIN_ALLOW_THREADS;
+    result = TransformSource(name, code, compilerArgs, options);
+    Py_END_ALLOW_THREADS;
+
+    return MakeResult(result);
+}
+//-----------------------------------------------------------------------------
+
+static PyObject* TransformMany(PyObject* /*self*/, PyObject* args, PyObject* kwargs)
+{
+    static const char* keywords[]{"sources", "args", "options", "jobs", nullptr};
+
+    PyObject* sourcesObj{};
+    PyObject* compilerArgsObj{};
+    PyObject* optionsObj{};
+    unsigned  jobs{};
+
+    if(not PyArg_ParseTupleAndKeywords(
+           args, kwargs, "O|OOI", const_cast<char**>(keywords), &sourcesObj, &compilerArgsObj, &optionsObj, &jobs)) {
+        return nullptr;
+    }
+
+    std::vector<std::string> sources{};
+    std::vector<std::string> compilerArgs{};
+    InsightsOptions          options{GetDefaultInsightsOptions()};
+
+    if(not GetStrings(sourcesObj, sources, "sources must be a sequence of strings") or
+       not GetStrings(compilerArgsObj, compilerArgs, "args must be a sequence of strings") or
+       not GetOptions(optionsObj, options)) {
+        return nullptr;
+    }
+
+    std::vector<TransformInput> inputs{};
+    inputs.reserve(sources.size());
+
+    for(size_t i = 0; i < sources.size(); ++i) {
+        inputs.push_back({"input" + std::to_string(i) + ".cpp", std::move(sources[i])});
+    }
+
+    std::vector<TransformResult> results{};
+
+    Py_BEGIN_ALLOW_THREADS;
+    results = TransformSources(inputs, compilerArgs, options, jobs);
+    Py_END_ALLOW_THREADS;
+
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(results.size()));
+
+    if(not list) {
+        return nullptr;
+    }
+
+    for(size_t i = 0; i < results.size(); ++i) {
+        PyObject* result = MakeResult(results[i]);
+
+        if(not result) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), result);
+    }
+
+    return list;
+}
+//-----------------------------------------------------------------------------
+
+static PyMethodDef gMethods[]{
+    {"transform",
+     reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(Transform)),
+     METH_VARARGS | METH_KEYWORDS,
+     "transform(source, args=[], options=[], file_name='input.cpp') -> dict\n\n"
+     "Transform source in this process. args are the compiler arguments, options the names of the C++ Insights\n"
+     "options like 'show-all-implicit-casts'. The result has code, diagnostics, return_code and time_ms."},
+    {"transform_many",
+     reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(TransformMany)),
+     METH_VARARGS | METH_KEYWORDS,
+     "transform_many(sources, args=[], options=[], jobs=0) -> list\n\n"
+     "Transform all sources with jobs threads, 0 for one per hardware thread, without holding the GIL.\n"
+     "The results are in the order of sources."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+static PyModuleDef gModule{
+    PyModuleDef_HEAD_INIT,
+    "cppinsights",
+    "In-process bindings of C++ Insights, see TransformSource in Insights.h.",
+    -1,
+    gMethods,
+};
+//-----------------------------------------------------------------------------
+
+PyMODINIT_FUNC PyInit_cppinsights()
+{
+    return PyModule_Create(&gModule);
+}
@@ -0,0 +1,126 @@
+#! /usr/bin/env python3
+#
+#
+# C++ Insights, copyright (C) by Andreas Fertig
+# Distributed under an MIT license. See LICENSE for details
+#
+# Convert between the newline-delimited JSON records of `insights --batch` and the archives of `--batch-archive`.
+# `pack` writes the records of a JSONL file as an archive, `unpack` turns the result archive back into one JSON result
+# per line, with the id of the record.
+#
+#------------------------------------------------------------------------------
+
+import argparse
+import json
+import struct
+import sys
+#------------------------------------------------------------------------------
+
+ARCHIVE_MAGIC = b'INSARC01'
+RESULT_MAGIC  = b'INSRES01'
+#------------------------------------------------------------------------------
+
+def recordArguments(record):
+    """The arguments of a record as --batch builds them: the options, '--' and the standard."""
+    arguments = list(record.get('options', []))
+    arguments.append('--')
+
+    std = record.get('std')
+    if std:
+        arguments.append(std if std.startswith('-std=') else '-std=' + std)
+
+    return b''.join(a.encode('utf-8') + b'\0' for a in arguments)
+#------------------------------------------------------------------------------
+
+def pack(inputFile, archiveFile):
+    entries = []
+    ids     = []
+
+    with open(inputFile, encoding='utf-8') as f:
+        for line in f:
+            if not line.strip():
+                continue
+
+            record = json.loads(line)
+            ids.append(record.get('id'))
+            entries.append((record['code'].encode('utf-8'), recordArguments(record)))
+
+    # The data follows the header and the index, each source with its '\0'.
+    offset = len(ARCHIVE_MAGIC) + 8 + 32 * len(entries)
+    index  = []
+    data   = []
+
+    for source, arguments in entries:
+        index.append(struct.pack('<QQ', offset, len(source)))
+        data.append(source + b'\0')
+        offset += len(source) + 1
+
+        index.append(struct.pack('<QQ', offset, len(arguments)))
+        data.append(arguments)
+        offset += len(arguments)
+
+    with open(archiveFile, 'wb') as out:
+        out.write(ARCHIVE_MAGIC)
+        out.write(struct.pack('<Q', len(entries)))
+        out.writelines(index)
+        out.writelines(data)
+
+    # The ids stay next to the archive, the entries are only numbered.
+    with open(archiveFile + '.ids', 'w', encoding='utf-8') as out:
+        json.dump(ids, out)
+
+    print('%s: %d entries' % (archiveFile, len(entries)))
+#------------------------------------------------------------------------------
+
+def unpack(resultFile, idsFile):
+    with open(resultFile, 'rb') as f:
+        data = f.read()
+
+    if not data.startswith(RESULT_MAGIC) or len(data) < len(RESULT_MAGIC) + 16:
+        print('%s is no result archive' % resultFile, file=sys.stderr)
+        return 1
+
+    count, indexOffset = struct.unpack_from('<QQ', data, len(data) - 16)
+    ids = [None] * count
+
+    if idsFile:
+        with open(idsFile, encoding='utf-8') as f:
+            ids = json.load(f)
+
+    for i in range(count):
+        returnCode, outputOffset, outputLength, diagnosticsOffset, diagnosticsLength = \
+            struct.unpack_from('<qQQQQ', data, indexOffset + 40 * i)
+
+        result = {'id':          ids[i] if i < len(ids) else i,
+                  'returnCode':  returnCode,
+                  'code':        data[outputOffset:outputOffset + outputLength].decode('utf-8', 'replace'),
+                  'diagnostics': data[diagnosticsOffset:diagnosticsOffset + diagnosticsLength].decode('utf-8',
+                                                                                                     'replace')}
+        print(json.dumps(result))
+
+    return 0
+#------------------------------------------------------------------------------
+
+def main():
+    parser     = argparse.ArgumentParser(description='Pack and unpack the archives of insights --batch-archive')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+
+    packParser = subparsers.add_parser('pack', help='Write the JSONL records of --batch as an archive')
+    packParser.add_argument('input', help='The JSONL file')
+    packParser.add_argument('archive', help='The archive to write, the ids go to <archive>.ids')
+
+    unpackParser = subparsers.add_parser('unpack', help='Print a result archive as JSONL')
+    unpackParser.add_argument('results', help='The result archive')
+    unpackParser.add_argument('--ids', help='The ids pack wrote, without it the entries are numbered')
+
+    args = parser.parse_args()
+
+    if 'pack' == args.command:
+        pack(args.input, args.archive)
+        return 0
+
+    return unpack(args.results, args.ids)
+#------------------------------------------------------------------------------
+
+if __name__ == '__main__':
+    sys.exit(main())
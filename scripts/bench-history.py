@@ -0,0 +1,259 @@
+#! /usr/bin/env python3
+#
+#
+# C++ Insights, copyright (C) by Andreas Fertig
+# Distributed under an MIT license. See LICENSE for details
+#
+# Keep a history of insights-bench runs and compare two of them. Each run stores every repetition of each benchmark
+# together with the commit, the LLVM revision and the machine, a comparison tells per benchmark whether the difference
+# is significant by a Mann-Whitney U test.
+#
+#------------------------------------------------------------------------------
+
+import argparse
+import datetime
+import json
+import math
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+#------------------------------------------------------------------------------
+
+def loadHistory(path):
+    if not os.path.isfile(path):
+        return {'runs': []}
+
+    with open(path) as f:
+        return json.load(f)
+#------------------------------------------------------------------------------
+
+def saveHistory(path, history):
+    # Write a new file and rename it, an interrupted run must not destroy the history.
+    tmp = path + '.tmp'
+
+    with open(tmp, 'w') as f:
+        json.dump(history, f, indent=1)
+
+    os.replace(tmp, path)
+#------------------------------------------------------------------------------
+
+def runBenchmark(bench, repetitions, benchFilter):
+    """Run insights-bench and return its JSON output."""
+    with tempfile.TemporaryDirectory() as tmpDir:
+        out = os.path.join(tmpDir, 'bench.json')
+        cmd = [bench, '--benchmark_repetitions=%d' % repetitions, '--benchmark_out=%s' % out,
+               '--benchmark_out_format=json']
+
+        if benchFilter:
+            cmd.append('--benchmark_filter=%s' % benchFilter)
+
+        subprocess.check_call(cmd, stdout=subprocess.DEVNULL)
+
+        with open(out) as f:
+            return json.load(f)
+#------------------------------------------------------------------------------
+
+def collectTimes(result):
+    """The time of each repetition per benchmark, the aggregates like the mean are computed here again."""
+    times = {}
+
+    for b in result['benchmarks']:
+        if b.get('run_type', 'iteration') != 'iteration':
+            continue
+
+        name = b.get('run_name', b['name'])
+
+        # A fixture gets its name as label, it is more telling than the index of DenseRange.
+        if b.get('label'):
+            name = '%s/%s' % (name.split('/')[0], b['label'])
+
+        times.setdefault(name, []).append({'real': b['real_time'], 'cpu': b['cpu_time'], 'unit': b['time_unit']})
+
+    return times
+#------------------------------------------------------------------------------
+
+def record(args):
+    result  = runBenchmark(args.bench, args.repetitions, args.filter)
+    context = result.get('context', {})
+    history = loadHistory(args.history)
+
+    machine = args.machine or '%s, %s CPUs at %s MHz' % (context.get('host_name', platform.node()),
+                                                          context.get('num_cpus', '?'),
+                                                          context.get('mhz_per_cpu', '?'))
+
+    run = {
+        'id':         (max((r['id'] for r in history['runs']), default=0) + 1),
+        'date':       datetime.datetime.now().isoformat(timespec='seconds'),
+        'commit':     args.commit or context.get('git_commit', ''),
+        'llvm':       context.get('llvm_revision', ''),
+        'machine':    machine,
+        'build_type': context.get('library_build_type', ''),
+        'note':       args.note or '',
+        'benchmarks': collectTimes(result),
+    }
+
+    history['runs'].append(run)
+    saveHistory(args.history, history)
+
+    print('recorded run %d: %s, %d benchmarks, %d repetitions' % (run['id'], run['commit'] or 'no commit',
+                                                                   len(run['benchmarks']), args.repetitions))
+
+    # A library built for debugging makes every number meaningless.
+    if 'debug' == run['build_type']:
+        print('warning: the benchmark library is a debug build', file=sys.stderr)
+
+    return 0
+#------------------------------------------------------------------------------
+
+def findRun(history, key):
+    """A run by its id or by a prefix of its commit, the latest one wins."""
+    for run in reversed(history['runs']):
+        if str(run['id']) == key or (run['commit'] and run['commit'].startswith(key)):
+            return run
+
+    print('error: no run %s' % key, file=sys.stderr)
+    sys.exit(1)
+#------------------------------------------------------------------------------
+
+def mannWhitneyU(a, b):
+    """The two-sided p-value of a Mann-Whitney U test of a and b.
+
+    The normal approximation with a correction for ties and for continuity. It is good from about 8 repetitions on,
+    with fewer of them no difference is significant at 0.05 anyway."""
+    n1, n2 = len(a), len(b)
+
+    if 0 == n1 or 0 == n2:
+        return 1.0
+
+    values = sorted([(v, 0) for v in a] + [(v, 1) for v in b])
+    ranks  = [0.0] * len(values)
+    ties   = 0.0
+    i      = 0
+
+    # Equal values share the mean of their ranks.
+    while i < len(values):
+        j = i
+
+        while j + 1 < len(values) and values[j + 1][0] == values[i][0]:
+            j += 1
+
+        for k in range(i, j + 1):
+            ranks[k] = (i + j) / 2.0 + 1
+
+        t     = j - i + 1
+        ties += t ** 3 - t
+        i     = j + 1
+
+    r1 = sum(r for r, (_, group) in zip(ranks, values) if 0 == group)
+    u1 = r1 - n1 * (n1 + 1) / 2.0
+    mu = n1 * n2 / 2.0
+    n  = n1 + n2
+
+    sigma = math.sqrt(n1 * n2 / 12.0 * ((n + 1) - ties / (n * (n - 1)))) if n > 1 else 0.0
+
+    if 0.0 == sigma:
+        return 1.0
+
+    z = max(abs(u1 - mu) - 0.5, 0.0) / sigma
+
+    return math.erfc(z / math.sqrt(2))
+#------------------------------------------------------------------------------
+
+def compare(args):
+    history = loadHistory(args.history)
+    runA    = findRun(history, args.run_a)
+    runB    = findRun(history, args.run_b)
+    field   = 'cpu' if args.cpu_time else 'real'
+
+    for label, run in (('A', runA), ('B', runB)):
+        print('%s: run %d, %s, commit %s, LLVM %s, %s' % (label, run['id'], run['date'], run['commit'] or '-',
+                                                         run['llvm'] or '-', run['machine']))
+
+    if runA['machine'] != runB['machine']:
+        print('warning: the runs are from different machines', file=sys.stderr)
+
+    rows = []
+
+    for name in sorted(set(runA['benchmarks']) & set(runB['benchmarks'])):
+        a = [t[field] for t in runA['benchmarks'][name]]
+        b = [t[field] for t in runB['benchmarks'][name]]
+
+        medianA = statistics.median(a)
+        medianB = statistics.median(b)
+        delta   = (medianB - medianA) / medianA * 100.0 if medianA else 0.0
+        p       = mannWhitneyU(a, b)
+
+        rows.append((name, medianA, medianB, runA['benchmarks'][name][0]['unit'], delta, p))
+
+    width = max([len(r[0]) for r in rows] + [len('benchmark')])
+
+    print('\n%-*s  %12s  %12s  %8s  %8s' % (width, 'benchmark', 'median A', 'median B', 'delta', 'p'))
+
+    significant = 0
+
+    for name, medianA, medianB, unit, delta, p in rows:
+        marker = ''
+
+        if p < args.alpha:
+            marker = '  faster' if delta < 0 else '  SLOWER'
+            significant += 1
+
+        print('%-*s  %9.1f %-2s  %9.1f %-2s  %+7.1f%%  %8.4f%s' % (width, name, medianA, unit, medianB, unit, delta,
+                                                                   p, marker))
+
+    only = set(runA['benchmarks']) ^ set(runB['benchmarks'])
+
+    if only:
+        print('\n%d benchmarks are in only one of the runs: %s' % (len(only), ', '.join(sorted(only))))
+
+    print('\n%d of %d benchmarks differ significantly (Mann-Whitney U, alpha %g)' % (significant, len(rows),
+                                                                                   args.alpha))
+
+    return 0
+#------------------------------------------------------------------------------
+
+def listRuns(args):
+    for run in loadHistory(args.history)['runs']:
+        print('%4d  %s  %-12s  %-24s  %s%s' % (run['id'], run['date'], (run['commit'] or '-')[:12],
+                                                (run['llvm'] or '-')[:24], run['machine'],
+                                                ('  (%s)' % run['note']) if run['note'] else ''))
+
+    return 0
+#------------------------------------------------------------------------------
+
+def main():
+    parser = argparse.ArgumentParser(description='Store insights-bench runs and compare two of them')
+    parser.add_argument('--history',      help='The history file', default='bench-history.json')
+    commands = parser.add_subparsers(dest='command')
+    commands.required = True
+
+    recordParser = commands.add_parser('record', help='Run insights-bench and store the result')
+    recordParser.add_argument('bench',         help='The insights-bench binary')
+    recordParser.add_argument('--repetitions', help='Repetitions of each benchmark', default=10, type=int)
+    recordParser.add_argument('--filter',      help='Only the benchmarks matching REGEX', metavar='REGEX')
+    recordParser.add_argument('--commit',      help='The commit instead of the one insights-bench was built from')
+    recordParser.add_argument('--machine',     help='The machine id instead of the host name and the CPUs')
+    recordParser.add_argument('--note',        help='A note stored with the run')
+    recordParser.set_defaults(func=record)
+
+    compareParser = commands.add_parser('compare', help='Compare two runs, by id or commit prefix')
+    compareParser.add_argument('run_a',        help='The baseline run')
+    compareParser.add_argument('run_b',        help='The run to compare to it')
+    compareParser.add_argument('--alpha',      help='The significance level', default=0.05, type=float)
+    compareParser.add_argument('--cpu-time',   help='Compare the CPU time instead of the wall time', action='store_true')
+    compareParser.set_defaults(func=compare)
+
+    listParser = commands.add_parser('list', help='List the stored runs')
+    listParser.set_defaults(func=listRuns)
+
+    args = parser.parse_args()
+
+    return args.func(args)
+#------------------------------------------------------------------------------
+
+
+sys.exit(main())
+#------------------------------------------------------------------------------
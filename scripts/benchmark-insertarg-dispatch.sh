@@ -0,0 +1,54 @@
+#! /bin/bash
+#
+# Compare the time CodeGenerator::InsertArg takes for a large generated expression tree between two C++ Insights
+# binaries, for example a build before and one after a change to the node dispatch.
+#
+# Usage: benchmark-insertarg-dispatch.sh <path-to-insights-a> <path-to-insights-b> [statements] [runs]
+
+INSIGHTS_A=$1
+INSIGHTS_B=$2
+STATEMENTS=${3:-5000}
+RUNS=${4:-5}
+
+if [ ! -x "${INSIGHTS_A}" ] || [ ! -x "${INSIGHTS_B}" ]; then
+    echo "Usage: $0 <path-to-insights-a> <path-to-insights-b> [statements] [runs]"
+    exit 1
+fi
+
+INPUT=$(mktemp --suffix=.cpp)
+trap 'rm -f ${INPUT}' EXIT
+
+# A single function with many statements. Each one is a tree of nodes late in CodeGeneratorTypes.h, like casts, calls,
+# conditional and binary operators, and literals. Splitting it into statements keeps the recursion depth low.
+python3 - ${STATEMENTS} > ${INPUT} <<'GENERATOR_END'
+import sys
+
+print('struct S { int m; int get() const { return m; } };')
+print('int f(int a, int b) { return a + b; }')
+print('int test(int a, int b, double d, S s)')
+print('{')
+print('    int r = 0;')
+
+for i in range(int(sys.argv[1])):
+    print('    r += (a ? f(a, %d) : static_cast<int>(d * %d.5)) + (s.get() - (b << 2)) * (sizeof(int) + %d);' % (i, i, i))
+
+print('    return r;')
+print('}')
+GENERATOR_END
+
+handlerTime() {
+    local insights=$1
+    local total=0
+
+    for i in $(seq ${RUNS}); do
+        local ms=$(${insights} --time-report-json ${INPUT} -- -std=c++17 2>&1 >/dev/null | tail -n 1 |
+                   python3 -c 'import json,sys; print(json.load(sys.stdin)["FunctionDeclHandler"]["wallMs"])')
+        total=$(python3 -c "print(${total} + ${ms})")
+    done
+
+    python3 -c "print('%.3f' % (${total} / ${RUNS}))"
+}
+
+echo "FunctionDeclHandler wall time (ms, average of ${RUNS} runs) for ${STATEMENTS} generated statements:"
+echo "  ${INSIGHTS_A}: $(handlerTime ${INSIGHTS_A})"
+echo "  ${INSIGHTS_B}: $(handlerTime ${INSIGHTS_B})"
@@ -0,0 +1,54 @@
+#! /bin/bash
+#
+# Compare the time the FunctionDeclHandler takes for a function with many lambdas between two C++ Insights binaries.
+# Each lambda inserts its closure class in front of the current statement, at the anchor
+# OutputFormatHelper::ReserveAnchor left there. With many lambdas this shows whether the anchors are resolved in linear
+# time.
+#
+# Usage: benchmark-lambdas.sh <path-to-insights-a> <path-to-insights-b> [lambdas] [runs]
+
+INSIGHTS_A=$1
+INSIGHTS_B=$2
+LAMBDAS=${3:-5000}
+RUNS=${4:-5}
+
+if [ ! -x "${INSIGHTS_A}" ] || [ ! -x "${INSIGHTS_B}" ]; then
+    echo "Usage: $0 <path-to-insights-a> <path-to-insights-b> [lambdas] [runs]"
+    exit 1
+fi
+
+INPUT=$(mktemp --suffix=.cpp)
+trap 'rm -f ${INPUT}' EXIT
+
+# A single function with many lambdas, all of them capturing by reference.
+python3 - ${LAMBDAS} > ${INPUT} <<'GENERATOR_END'
+import sys
+
+print('int test(int a)')
+print('{')
+print('    int r = 0;')
+
+for i in range(int(sys.argv[1])):
+    print('    auto l%d = [&] { return a + %d; };' % (i, i))
+    print('    r += l%d();' % i)
+
+print('    return r;')
+print('}')
+GENERATOR_END
+
+handlerTime() {
+    local insights=$1
+    local total=0
+
+    for i in $(seq ${RUNS}); do
+        local ms=$(${insights} --time-report-json ${INPUT} -- -std=c++17 2>&1 >/dev/null | tail -n 1 |
+                   python3 -c 'import json,sys; print(json.load(sys.stdin)["FunctionDeclHandler"]["wallMs"])')
+        total=$(python3 -c "print(${total} + ${ms})")
+    done
+
+    python3 -c "print('%.3f' % (${total} / ${RUNS}))"
+}
+
+echo "FunctionDeclHandler wall time (ms, average of ${RUNS} runs) for ${LAMBDAS} lambdas in one function:"
+echo "  ${INSIGHTS_A}: $(handlerTime ${INSIGHTS_A})"
+echo "  ${INSIGHTS_B}: $(handlerTime ${INSIGHTS_B})"
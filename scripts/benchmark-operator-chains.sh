@@ -0,0 +1,63 @@
+#! /bin/bash
+#
+# Compare the time the FunctionDeclHandler takes for a function with a very long binary operator and a very long
+# overloaded operator chain between two C++ Insights binaries. A binary which runs out of stack on the deeply nested
+# expressions is reported as crashed.
+#
+# Usage: benchmark-operator-chains.sh <path-to-insights-a> <path-to-insights-b> [operands] [runs]
+
+INSIGHTS_A=$1
+INSIGHTS_B=$2
+OPERANDS=${3:-50000}
+RUNS=${4:-5}
+
+if [ ! -x "${INSIGHTS_A}" ] || [ ! -x "${INSIGHTS_B}" ]; then
+    echo "Usage: $0 <path-to-insights-a> <path-to-insights-b> [operands] [runs]"
+    exit 1
+fi
+
+INPUT=$(mktemp --suffix=.cpp)
+trap 'rm -f ${INPUT}' EXIT
+
+# One function with a chain of built-in additions and a chain of calls to a free operator<<.
+python3 - ${OPERANDS} > ${INPUT} <<'GENERATOR_END'
+import sys
+
+operands = int(sys.argv[1])
+
+print('struct Out {};')
+print('Out& operator<<(Out& o, int) { return o; }')
+print('int test(int a)')
+print('{')
+print('    int r = ' + ' + '.join(['a'] * operands) + ';')
+print('    Out o{};')
+print('    o << ' + ' << '.join(str(i) for i in range(operands)) + ';')
+print('    return r;')
+print('}')
+GENERATOR_END
+
+handlerTime() {
+    local insights=$1
+    local total=0
+
+    for i in $(seq ${RUNS}); do
+        local report
+        report=$(${insights} --time-report-json ${INPUT} -- -std=c++17 -fbracket-depth=$((2 * OPERANDS)) \
+                 2>&1 >/dev/null)
+
+        if [ $? -gt 1 ]; then
+            echo "crashed"
+            return
+        fi
+
+        local ms=$(echo "${report}" | tail -n 1 |
+                   python3 -c 'import json,sys; print(json.load(sys.stdin)["FunctionDeclHandler"]["wallMs"])')
+        total=$(python3 -c "print(${total} + ${ms})")
+    done
+
+    python3 -c "print('%.3f' % (${total} / ${RUNS}))"
+}
+
+echo "FunctionDeclHandler wall time (ms, average of ${RUNS} runs) for chains of ${OPERANDS} operands:"
+echo "  ${INSIGHTS_A}: $(handlerTime ${INSIGHTS_A})"
+echo "  ${INSIGHTS_B}: $(handlerTime ${INSIGHTS_B})"
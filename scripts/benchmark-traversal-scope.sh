@@ -0,0 +1,45 @@
+#! /bin/bash
+#
+# Compare the time spent in MatchFinder::matchAST with and without limiting the traversal scope to the main file.
+#
+# Usage: benchmark-traversal-scope.sh <path-to-insights> [runs]
+
+INSIGHTS=$1
+RUNS=${2:-5}
+
+if [ ! -x "${INSIGHTS}" ]; then
+    echo "Usage: $0 <path-to-insights> [runs]"
+    exit 1
+fi
+
+INPUT=$(mktemp --suffix=.cpp)
+trap 'rm -f ${INPUT}' EXIT
+
+cat > ${INPUT} <<INPUT_END
+#include <bits/stdc++.h>
+
+int main()
+{
+    std::vector<int> v{1, 2, 3};
+
+    for(const auto& i : v) {
+        std::cout << i << '\n';
+    }
+}
+INPUT_END
+
+matchTime() {
+    local total=0
+
+    for i in $(seq ${RUNS}); do
+        local ms=$(${INSIGHTS} --time-report-json "$@" ${INPUT} -- -std=c++17 2>&1 >/dev/null | tail -n 1 |
+                   python3 -c 'import json,sys; print(json.load(sys.stdin)["Matching"]["wallMs"])')
+        total=$(python3 -c "print(${total} + ${ms})")
+    done
+
+    python3 -c "print('%.3f' % (${total} / ${RUNS}))"
+}
+
+echo "matchAST wall time (ms, average of ${RUNS} runs) on <bits/stdc++.h>:"
+echo "  entire TU (--traverse-all-decls): $(matchTime --traverse-all-decls)"
+echo "  main file only (default):         $(matchTime)"
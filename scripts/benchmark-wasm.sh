@@ -0,0 +1,60 @@
+#! /bin/bash
+#
+# Check the size and the startup time of insights-wasm against their budgets.
+#
+# The size is that of the module and the preloaded files, the startup time the time from loading the module until the
+# first snippet is transformed. Exceeding a budget makes the script fail.
+#
+# Usage: benchmark-wasm.sh <build-dir> [size budget in MB] [startup budget in ms]
+
+BUILD_DIR=$1
+SIZE_BUDGET_MB=${2:-60}
+STARTUP_BUDGET_MS=${3:-3000}
+
+if [ ! -f "${BUILD_DIR}/insights-wasm.wasm" ]; then
+    echo "Usage: $0 <build-dir> [size budget in MB] [startup budget in ms]"
+    exit 1
+fi
+
+sizeOf() {
+    local total=0
+
+    for file in "$@"; do
+        if [ -f "${file}" ]; then
+            total=$((total + $(stat -c %s "${file}")))
+        fi
+    done
+
+    echo ${total}
+}
+
+WASM_SIZE=$(sizeOf "${BUILD_DIR}/insights-wasm.wasm")
+DATA_SIZE=$(sizeOf "${BUILD_DIR}/insights-wasm.data" "${BUILD_DIR}/insights-wasm-pch.data")
+TOTAL_MB=$(python3 -c "print('%.1f' % ((${WASM_SIZE} + ${DATA_SIZE}) / 1024 / 1024))")
+
+STARTUP_MS=$(cd "${BUILD_DIR}" && node -e '
+const start = Date.now();
+
+require("./insights-wasm.js")().then((insights) => {
+    insights._insights_init();
+
+    const transform = insights.cwrap("insights_transform", "number", ["string", "string", "string"]);
+    insights._insights_free(transform("int main() { auto l = [] { return 1; }; return l(); }\n", "-std=c++17", ""));
+
+    console.log(Date.now() - start);
+});
+')
+
+echo "insights-wasm:"
+echo "  size:    ${TOTAL_MB} MB (module $((WASM_SIZE / 1024)) KB, preloaded files $((DATA_SIZE / 1024)) KB), budget ${SIZE_BUDGET_MB} MB"
+echo "  startup: ${STARTUP_MS} ms, budget ${STARTUP_BUDGET_MS} ms"
+
+if python3 -c "import sys; sys.exit(0 if ${TOTAL_MB} > ${SIZE_BUDGET_MB} else 1)"; then
+    echo "[OVER BUDGET] size"
+    exit 1
+fi
+
+if [ "${STARTUP_MS}" -gt "${STARTUP_BUDGET_MS}" ]; then
+    echo "[OVER BUDGET] startup"
+    exit 1
+fi
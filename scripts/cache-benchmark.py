@@ -0,0 +1,305 @@
+#! /usr/bin/env python3
+#
+#
+# C++ Insights, copyright (C) by Andreas Fertig
+# Distributed under an MIT license. See LICENSE for details
+#
+# Measure each request of a corpus in four states: a cold process with a cold cache, a cold process with a warm cache,
+# a warm server with a cold cache and a warm server with a warm cache. The corpus is the one of tests/ together with the
+# synthetic one of scaling-report.py. The result is p50/p95/p99 per state, so that a claim about what --cache-dir and
+# --pch-cache-dir save can be checked by running this script again.
+#
+# A cache is made cold by a define no input uses, -DINSIGHTS_CACHE_BENCHMARK=<n> with a new n for each request. It is
+# part of the keys of the result cache and the PCH cache, but leaves the result alone. That way neither the server nor
+# the cache directories need a reset between two requests, and the warm request is the same one again.
+#
+#------------------------------------------------------------------------------
+
+import argparse
+import csv
+import importlib.util
+import json
+import os
+import platform
+import re
+import shutil
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+#------------------------------------------------------------------------------
+
+mypath = os.path.dirname(os.path.abspath(__file__))
+
+STATES = ['cold-process/cold-cache', 'cold-process/warm-cache', 'warm-server/cold-cache', 'warm-server/warm-cache']
+#------------------------------------------------------------------------------
+
+def loadTests(testsDir, std, pattern):
+    """The inputs of tests/ with the compiler arguments and the insights options of their first line, like runTest.py."""
+    regEx         = re.compile('.*cmdline:(.*)')
+    regExInsights = re.compile(r'.*cmdlineinsights:(\S*)')
+    inputs        = []
+
+    for f in sorted(os.listdir(testsDir)):
+        if not f.endswith('.cpp') or (pattern and not re.search(pattern, f)):
+            continue
+
+        fileName = os.path.join(testsDir, f)
+
+        with open(fileName, 'r', errors='replace') as source:
+            fileHeader = source.readline().strip()
+
+        cxxArgs  = ['-std=%s' % std]
+        options  = []
+        m        = regEx.match(fileHeader)
+
+        if None != m:
+            cxxArgs = m.group(1).split()
+
+        m = regExInsights.match(fileHeader)
+
+        if None != m:
+            options = [m.group(1)]
+
+        inputs.append({'name': 'tests/' + f, 'file': fileName, 'args': cxxArgs + ['-m64'], 'options': options})
+
+    return inputs
+#------------------------------------------------------------------------------
+
+def loadSynthetic(outDir, sizes, pattern):
+    """The inputs of the axes of scaling-report.py, by default with the smallest size of each axis."""
+    spec    = importlib.util.spec_from_file_location('scalingReport', os.path.join(mypath, 'scaling-report.py'))
+    scaling = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(scaling)
+    inputs  = []
+
+    for axis in sorted(scaling.AXES.keys()):
+        generator, defaultSizes, cxxArgs = scaling.AXES[axis]
+
+        for n in (sizes or defaultSizes[:1]):
+            name = 'synthetic/%s-%d.cpp' % (axis, n)
+
+            if pattern and not re.search(pattern, name):
+                continue
+
+            fileName = os.path.join(outDir, '%s-%d.cpp' % (axis, n))
+
+            with open(fileName, 'w') as out:
+                out.write('\n'.join(generator(n)) + '\n')
+
+            inputs.append({'name': name, 'file': fileName, 'args': ['-std=c++17'] + cxxArgs, 'options': []})
+
+    return inputs
+#------------------------------------------------------------------------------
+
+def cacheArgs(cacheDir):
+    return ['--cache-dir=%s' % os.path.join(cacheDir, 'results'), '--pch-cache-dir=%s' % os.path.join(cacheDir, 'pch')]
+#------------------------------------------------------------------------------
+
+def runProcess(insights, entry, cacheDir, nonce):
+    """Run insights once for entry, returns the wall time, the return code and the output."""
+    cmd   = [insights, entry['file']] + entry['options'] + cacheArgs(cacheDir) + \
+            ['--'] + entry['args'] + ['-DINSIGHTS_CACHE_BENCHMARK=%d' % nonce]
+    begin = time.perf_counter()
+    p     = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+
+    return time.perf_counter() - begin, p.returncode, p.stdout
+#------------------------------------------------------------------------------
+
+def sendFrame(sock, payload):
+    sock.sendall(b'%d\n' % len(payload) + payload)
+#------------------------------------------------------------------------------
+
+def readFrame(reader):
+    length = reader.readline()
+
+    if not length.endswith(b'\n'):
+        raise ConnectionError('connection closed by the server')
+
+    payload = reader.read(int(length))
+
+    if len(payload) != int(length):
+        raise ConnectionError('connection closed by the server')
+
+    return payload
+#------------------------------------------------------------------------------
+
+class Server:
+    """An insights server on a Unix domain socket, with one connection for all requests."""
+
+    def __init__(self, insights, cacheDir, timeout):
+        self.address = os.path.join(cacheDir, 'insights.sock')
+        self.process = subprocess.Popen([insights, '--server=%s' % self.address, '-j', '1'] + cacheArgs(cacheDir) +
+                                        ['--'], stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        deadline     = time.time() + timeout
+
+        while True:
+            try:
+                self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+                self.sock.connect(self.address)
+                break
+            except OSError:
+                self.sock.close()
+
+                if (time.time() > deadline) or (self.process.poll() is not None):
+                    self.close()
+                    raise ConnectionError('insights --server did not start')
+
+                time.sleep(0.05)
+
+        self.sock.settimeout(timeout)
+        self.reader = self.sock.makefile('rb')
+
+    def request(self, entry, nonce):
+        """Send entry, returns the wall time until the response arrived, the return code and the output."""
+        with open(entry['file'], 'rb') as source:
+            code = source.read()
+
+        arguments = entry['options'] + ['--'] + entry['args'] + ['-DINSIGHTS_CACHE_BENCHMARK=%d' % nonce]
+        begin     = time.perf_counter()
+        sendFrame(self.sock, entry['file'].encode())
+        sendFrame(self.sock, '\0'.join(arguments).encode())
+        sendFrame(self.sock, code)
+
+        returnCode = int(readFrame(self.reader))
+        output     = readFrame(self.reader)
+        readFrame(self.reader)
+
+        return time.perf_counter() - begin, returnCode, output
+
+    def close(self):
+        self.sock.close()
+        self.process.terminate()
+        self.process.wait()
+#------------------------------------------------------------------------------
+
+def percentile(values, p):
+    """The nearest-rank percentile, no interpolation, so that the reported value is one which was measured."""
+    ordered = sorted(values)
+
+    return ordered[max(0, -(-len(ordered) * p // 100) - 1)]
+#------------------------------------------------------------------------------
+
+def insightsVersion(insights):
+    p = subprocess.run([insights, '--version'], stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+
+    return p.stdout.decode(errors='replace').strip()
+#------------------------------------------------------------------------------
+
+def main():
+    parser = argparse.ArgumentParser(description='Measure insights with a cold and a warm cache, in a new process '
+                                                 'and in a running server')
+    parser.add_argument('insights',       help='C++ Insights binary')
+    parser.add_argument('--tests',        help='The directory of the tests corpus',
+                        default=os.path.join(mypath, '..', 'tests'))
+    parser.add_argument('--std',          help='C++ Standard for tests without a cmdline', default='c++17')
+    parser.add_argument('--no-tests',     help='Leave out the tests corpus', action='store_true')
+    parser.add_argument('--no-synthetic', help='Leave out the synthetic corpus', action='store_true')
+    parser.add_argument('--sizes',        help='Comma separated sizes of the synthetic corpus instead of the smallest '
+                                               'default size of each axis')
+    parser.add_argument('--filter',       help='Only the inputs whose name matches REGEX', metavar='REGEX')
+    parser.add_argument('--runs',         help='Runs over the whole corpus', default=1, type=int)
+    parser.add_argument('--timeout',      help='Seconds to wait for a server response', default=300, type=int)
+    parser.add_argument('--csv',          help='Write all measurements to FILE', metavar='FILE')
+    parser.add_argument('--json',         help='Write the environment, the percentiles and all measurements to FILE',
+                        metavar='FILE')
+    args = parser.parse_args()
+
+    insights = os.path.abspath(args.insights)
+    workDir  = tempfile.mkdtemp(prefix='insights-cache-benchmark-')
+    sizes    = [int(s) for s in args.sizes.split(',')] if args.sizes else None
+    inputs   = []
+
+    if not args.no_tests:
+        inputs += loadTests(os.path.abspath(args.tests), args.std, args.filter)
+
+    if not args.no_synthetic:
+        syntheticDir = os.path.join(workDir, 'synthetic')
+        os.makedirs(syntheticDir)
+        inputs += loadSynthetic(syntheticDir, sizes, args.filter)
+
+    processCache = os.path.join(workDir, 'process')
+    serverCache  = os.path.join(workDir, 'server')
+    os.makedirs(processCache)
+    os.makedirs(serverCache)
+
+    rows       = []
+    skipped    = set()
+    mismatches = []
+    nonce      = 0
+    server     = Server(insights, serverCache, args.timeout)
+
+    try:
+        # The first request of a server pays for its start, it is not one of a warm server.
+        if inputs:
+            server.request(inputs[0], nonce)
+
+        for run in range(args.runs):
+            for entry in inputs:
+                if entry['name'] in skipped:
+                    continue
+
+                measurements = []
+
+                for measure in (lambda n: runProcess(insights, entry, processCache, n),
+                                lambda n: server.request(entry, n)):
+                    nonce += 1
+                    measurements.append(measure(nonce))
+                    measurements.append(measure(nonce))
+
+                # Inputs insights rejects say nothing about the cache, the error is not cached.
+                if any(0 != returnCode for _, returnCode, _ in measurements):
+                    skipped.add(entry['name'])
+                    continue
+
+                # A warm cache which returns a different result is faster for the wrong reason.
+                if len(set(output for _, _, output in measurements)) != 1:
+                    mismatches.append(entry['name'])
+
+                for state, (wall, _, _) in zip(STATES, measurements):
+                    rows.append({'run': run, 'input': entry['name'], 'state': state, 'time': wall})
+
+            print('run %d of %d: %d inputs, %d skipped' % (run + 1, args.runs, len(inputs) - len(skipped),
+                                                             len(skipped)), file=sys.stderr)
+    finally:
+        server.close()
+        shutil.rmtree(workDir, ignore_errors=True)
+
+    summary = {}
+
+    print('%-26s %6s %10s %10s %10s' % ('state', 'count', 'p50 [ms]', 'p95 [ms]', 'p99 [ms]'))
+
+    for state in STATES:
+        times = [r['time'] for r in rows if state == r['state']]
+
+        if not times:
+            continue
+
+        summary[state] = {'count': len(times), 'p50': percentile(times, 50), 'p95': percentile(times, 95),
+                          'p99': percentile(times, 99)}
+        print('%-26s %6d %10.1f %10.1f %10.1f' % (state, len(times), summary[state]['p50'] * 1000,
+                                                  summary[state]['p95'] * 1000, summary[state]['p99'] * 1000))
+
+    for mismatch in mismatches:
+        print('[MISMATCH] %s: the warm result differs from the cold one' % mismatch)
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as out:
+            writer = csv.DictWriter(out, fieldnames=['run', 'input', 'state', 'time'])
+            writer.writeheader()
+            writer.writerows(rows)
+
+    if args.json:
+        with open(args.json, 'w') as out:
+            json.dump({'insights': insightsVersion(insights), 'platform': platform.platform(),
+                       'cpus': os.cpu_count(), 'runs': args.runs, 'inputs': [e['name'] for e in inputs],
+                       'skipped': sorted(skipped), 'mismatches': mismatches, 'summary': summary,
+                       'measurements': rows}, out, indent=2)
+
+    return 1 if mismatches else 0
+#------------------------------------------------------------------------------
+
+if __name__ == '__main__':
+    sys.exit(main())
+#------------------------------------------------------------------------------
@@ -0,0 +1,306 @@
+#! /usr/bin/env python3
+#
+#
+# C++ Insights, copyright (C) by Andreas Fertig
+# Distributed under an MIT license. See LICENSE for details
+#
+# Distribute the translation units of a compilation database across a number of C++ Insights servers, started with
+# `insights --server=host:port --`, and gather the results in one directory tree. The files are split into shards of
+# about the same estimated cost. A shard which fails or takes too long is retried on another server.
+#
+#------------------------------------------------------------------------------
+
+import argparse
+import heapq
+import json
+import os
+import queue
+import re
+import shlex
+import socket
+import sys
+import threading
+import time
+import zlib
+#------------------------------------------------------------------------------
+
+INCLUDE_RE = re.compile(rb'^\s*#\s*include\b', re.MULTILINE)
+
+# Arguments which are followed by a path, relative ones are relative to the directory of the compile command.
+PATH_ARGS = ('-I', '-isystem', '-iquote', '-idirafter', '-include', '-imacros', '-isysroot', '--sysroot')
+
+# The preset dictionary of the compressed responses, the same the server is built with.
+DICTIONARY_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'response-dictionary.txt')
+#------------------------------------------------------------------------------
+
+def estimateCost(fileName):
+    """The size of the file times the number of its includes, the headers dominate the time of a translation unit."""
+    with open(fileName, 'rb') as f:
+        data = f.read()
+
+    return len(data) * (1 + len(INCLUDE_RE.findall(data))), data
+#------------------------------------------------------------------------------
+
+def compilerArgs(entry, fileName):
+    """The arguments of a compile command without the compiler, the input, the output and -c. The paths are made
+    absolute, the servers do not run in the directory of the command."""
+    args      = entry['arguments'] if 'arguments' in entry else shlex.split(entry['command'])
+    directory = entry.get('directory', '.')
+    result    = []
+    skip      = False
+
+    for i, arg in enumerate(args[1:], 1):
+        if skip:
+            skip = False
+            continue
+
+        if arg in ('-c', fileName, entry['file']):
+            continue
+
+        if '-o' == arg:
+            skip = True
+            continue
+
+        if arg in PATH_ARGS and (i + 1 < len(args)):
+            result += [arg, os.path.join(directory, args[i + 1])]
+            skip = True
+            continue
+
+        for prefix in PATH_ARGS:
+            if arg.startswith(prefix) and (len(arg) > len(prefix)):
+                separator = '=' if '=' == arg[len(prefix)] else ''
+                arg       = prefix + separator + os.path.join(directory, arg[len(prefix) + len(separator):])
+                break
+
+        result.append(arg)
+
+    return result
+#------------------------------------------------------------------------------
+
+def loadProject(compileCommands):
+    """All translation units of the compilation database, a file listed more than once is taken once."""
+    with open(compileCommands) as f:
+        entries = json.load(f)
+
+    units = {}
+
+    for entry in entries:
+        fileName = os.path.normpath(os.path.join(entry.get('directory', '.'), entry['file']))
+
+        if fileName in units:
+            continue
+
+        cost, source    = estimateCost(fileName)
+        units[fileName] = {'file': fileName, 'args': compilerArgs(entry, fileName), 'cost': cost, 'source': source}
+
+    return list(units.values())
+#------------------------------------------------------------------------------
+
+def makeShards(units, count):
+    """Split units into count shards of about the same cost, the most expensive file goes to the cheapest shard."""
+    heap   = [(0, i) for i in range(min(count, len(units)))]
+    shards = [[] for _ in heap]
+
+    for unit in sorted(units, key=lambda u: u['cost'], reverse=True):
+        cost, i = heapq.heappop(heap)
+        shards[i].append(unit)
+        heapq.heappush(heap, (cost + unit['cost'], i))
+
+    return shards
+#------------------------------------------------------------------------------
+
+def connect(address, timeout):
+    host, _, port = address.rpartition(':')
+
+    if port.isdigit():
+        sock = socket.create_connection((host or '127.0.0.1', int(port)), timeout=timeout)
+    else:
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        sock.settimeout(timeout)
+        sock.connect(address)
+
+    return sock
+#------------------------------------------------------------------------------
+
+def sendFrame(sock, payload):
+    sock.sendall(b'%d\n' % len(payload) + payload)
+#------------------------------------------------------------------------------
+
+def readFrame(reader):
+    length = reader.readline()
+
+    if not length.endswith(b'\n'):
+        raise ConnectionError('connection closed by the server')
+
+    payload = reader.read(int(length))
+
+    if len(payload) != int(length):
+        raise ConnectionError('connection closed by the server')
+
+    return payload
+#------------------------------------------------------------------------------
+
+def decompress(payload, dictionary):
+    stream = zlib.decompressobj(zdict=dictionary)
+    data   = stream.decompress(payload) + stream.flush()
+
+    if not stream.eof:
+        raise ValueError('truncated compressed response')
+
+    return data
+#------------------------------------------------------------------------------
+
+def readResponse(reader, dictionary):
+    """The return code, the output and the diagnostics, the return code says whether the other two are compressed."""
+    returnCode, _, compression = readFrame(reader).partition(b' ')
+    output                     = readFrame(reader)
+    diagnostics                = readFrame(reader)
+
+    if b'zlib' == compression:
+        output      = decompress(output, dictionary)
+        diagnostics = decompress(diagnostics, dictionary)
+
+    return int(returnCode), output, diagnostics
+#------------------------------------------------------------------------------
+
+def runShard(address, shard, insightsOptions, timeout, deadline, dictionary):
+    """Send all files of shard over one connection, returns one (returnCode, output, diagnostics) per file."""
+    results = []
+
+    with connect(address, timeout) as sock:
+        reader = sock.makefile('rb')
+
+        for i, unit in enumerate(shard):
+            if time.time() > deadline:
+                raise TimeoutError('shard took too long')
+
+            # Compression is negotiated once per connection, by the first request.
+            options   = insightsOptions + (['compress=zlib'] if (dictionary is not None) and (0 == i) else [])
+            arguments = options + ['--'] + unit['args']
+            sendFrame(sock, unit['file'].encode())
+            sendFrame(sock, '\0'.join(arguments).encode())
+            sendFrame(sock, unit['source'])
+
+            results.append(readResponse(reader, dictionary))
+
+    return results
+#------------------------------------------------------------------------------
+
+def writeResults(shard, results, outputDir, root):
+    failed = 0
+
+    for unit, (returnCode, output, diagnostics) in zip(shard, results):
+        outputPath = os.path.join(outputDir, os.path.relpath(unit['file'], root))
+        os.makedirs(os.path.dirname(outputPath), exist_ok=True)
+
+        with open(outputPath, 'wb') as out:
+            out.write(output)
+
+        if diagnostics:
+            sys.stderr.write(diagnostics.decode(errors='replace'))
+
+        if 0 != returnCode:
+            failed += 1
+
+    return failed
+#------------------------------------------------------------------------------
+
+def main():
+    parser = argparse.ArgumentParser(description='Distribute a compilation database across C++ Insights servers')
+    parser.add_argument('compile_commands', help='The compilation database, compile_commands.json')
+    parser.add_argument('--worker',       help='Address of an insights --server, host:port or a socket path',
+                        action='append', required=True)
+    parser.add_argument('--output-dir',   help='Where the results go, with the paths of the sources', required=True)
+    parser.add_argument('--shards',       help='Number of shards, 4 per worker by default', type=int)
+    parser.add_argument('--timeout',      help='Seconds a shard may take before it is retried elsewhere', default=600,
+                        type=float)
+    parser.add_argument('--retries',      help='How often a shard is retried', default=3, type=int)
+    parser.add_argument('--option',       help='C++ Insights option for all files, like alt-syntax-for',
+                        action='append', default=[])
+    parser.add_argument('--compress',     help='Ask the servers for compressed responses, requires zlib in the servers',
+                        action='store_true')
+    args = parser.parse_args()
+
+    dictionary = None
+
+    if args.compress:
+        with open(DICTIONARY_FILE, 'rb') as f:
+            dictionary = f.read()
+
+    units = loadProject(args.compile_commands)
+
+    if not units:
+        print('no translation units in %s' % args.compile_commands)
+        return 1
+
+    root    = os.path.commonpath([os.path.dirname(u['file']) for u in units])
+    pending = queue.Queue()
+    lock    = threading.Lock()
+    summary = {'done': 0, 'failed': 0, 'lost': 0}
+
+    for shard in makeShards(units, args.shards or 4 * len(args.worker)):
+        # The workers a shard already failed on, it goes to a different one next time.
+        pending.put((shard, set()))
+
+    outstanding = [pending.qsize()]
+
+    def work(address):
+        while True:
+            with lock:
+                if 0 == outstanding[0]:
+                    return
+
+            try:
+                shard, failedOn = pending.get(timeout=1)
+            except queue.Empty:
+                continue
+
+            # Leave the shard to another worker, unless this one is the only one left.
+            if (address in failedOn) and (len(failedOn) < len(args.worker)):
+                pending.put((shard, failedOn))
+                time.sleep(0.1)
+                continue
+
+            begin = time.time()
+
+            try:
+                results = runShard(address, shard, args.option, args.timeout, begin + args.timeout, dictionary)
+            except (OSError, ValueError, zlib.error) as e:
+                print('%s: shard of %d files failed after %.1fs: %s' % (address, len(shard), time.time() - begin, e))
+
+                with lock:
+                    if len(failedOn) + 1 > args.retries:
+                        summary['lost'] += len(shard)
+                        outstanding[0] -= 1
+                    else:
+                        pending.put((shard, failedOn | {address}))
+
+                continue
+
+            failed = writeResults(shard, results, args.output_dir, root)
+
+            with lock:
+                summary['done']   += len(shard)
+                summary['failed'] += failed
+                outstanding[0]   -= 1
+
+            print('%s: %d files in %.1fs' % (address, len(shard), time.time() - begin))
+
+    threads = [threading.Thread(target=work, args=(address,)) for address in args.worker]
+
+    for thread in threads:
+        thread.start()
+
+    for thread in threads:
+        thread.join()
+
+    print('-----------------------------------------------------------------')
+    print('%d files transformed, %d with errors, %d not transformed' % (summary['done'], summary['failed'],
+                                                                      summary['lost']))
+
+    return 0 if (0 == summary['failed']) and (0 == summary['lost']) else 1
+#------------------------------------------------------------------------------
+
+
+sys.exit(main())
+#------------------------------------------------------------------------------
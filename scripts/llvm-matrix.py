@@ -0,0 +1,113 @@
+#! /usr/bin/env python3
+#
+#
+# C++ Insights, copyright (C) by Andreas Fertig
+# Distributed under an MIT license. See LICENSE for details
+#
+# Build C++ Insights against several LLVM versions, run the scaling corpus of scaling-report.py with each build and
+# print a table which compares them.
+#
+#------------------------------------------------------------------------------
+
+import argparse
+import csv
+import os
+import subprocess
+import sys
+#------------------------------------------------------------------------------
+
+mypath = os.path.dirname(os.path.abspath(__file__))
+
+
+def llvmVersion(llvmConfig):
+    return subprocess.check_output([llvmConfig, '--version']).decode().strip()
+#------------------------------------------------------------------------------
+
+def build(llvmConfig, buildDir, generator):
+    """Configure and build insights for llvmConfig in buildDir, returns the path of the binary."""
+    os.makedirs(buildDir, exist_ok=True)
+
+    subprocess.check_call(['cmake', '-G', generator, '-DCMAKE_BUILD_TYPE=Release',
+                           '-DINSIGHTS_LLVM_CONFIG=%s' % llvmConfig, os.path.dirname(mypath)], cwd=buildDir)
+    subprocess.check_call(['cmake', '--build', '.', '--target', 'insights'], cwd=buildDir)
+
+    return os.path.join(buildDir, 'insights')
+#------------------------------------------------------------------------------
+
+def measure(insights, csvFile, args):
+    cmd = [sys.executable, os.path.join(mypath, 'scaling-report.py'), insights, '--csv', csvFile,
+           '--runs', str(args.runs)]
+
+    for axis in args.axis or []:
+        cmd += ['--axis', axis]
+
+    if args.sizes:
+        cmd += ['--sizes', args.sizes]
+
+    # A super-linear axis is a result, not a failure of the matrix.
+    subprocess.call(cmd)
+
+    if not os.path.isfile(csvFile):
+        return []
+
+    with open(csvFile) as f:
+        return list(csv.DictReader(f))
+#------------------------------------------------------------------------------
+
+def main():
+    parser = argparse.ArgumentParser(description='Compare the performance of insights across LLVM versions')
+    parser.add_argument('llvm_config',    help='llvm-config of each LLVM version', nargs='+')
+    parser.add_argument('--build-dir',    help='Where the builds go, one directory per version', default='llvm-matrix')
+    parser.add_argument('--generator',    help='CMake generator', default='Ninja')
+    parser.add_argument('--axis',         help='The axes of scaling-report.py, all by default', action='append')
+    parser.add_argument('--sizes',        help='Comma separated sizes instead of the default ones of the axes')
+    parser.add_argument('--runs',         help='Runs per size, the fastest one counts', default=3, type=int)
+    parser.add_argument('--output',       help='Write the table as Markdown to FILE', metavar='FILE')
+    args = parser.parse_args()
+
+    versions = []
+    results  = {}
+
+    for llvmConfig in args.llvm_config:
+        version  = llvmVersion(llvmConfig)
+        buildDir = os.path.join(os.path.abspath(args.build_dir), version)
+        insights = build(llvmConfig, buildDir, args.generator)
+
+        versions.append(version)
+
+        for row in measure(insights, os.path.join(buildDir, 'scaling.csv'), args):
+            key = (row['axis'], int(row['n']))
+            results.setdefault(key, {})[version] = (float(row['time']), int(row['memory']))
+
+    lines = ['| axis | N | %s |' % ' | '.join('%s time [s] | %s memory [MiB]' % (v, v) for v in versions),
+             '|---|---:|%s' % ('---:|---:|' * len(versions))]
+
+    for (axis, n) in sorted(results.keys()):
+        cells = []
+        row   = results[(axis, n)]
+        best  = min(t for t, _ in row.values())
+
+        for version in versions:
+            if version not in row:
+                cells += ['-', '-']
+                continue
+
+            time, memory = row[version]
+            # The fastest version of each row is bold.
+            cells += [('**%.3f**' if time == best else '%.3f') % time, '%.1f' % (memory / (1024 * 1024))]
+
+        lines.append('| %s | %d | %s |' % (axis, n, ' | '.join(cells)))
+
+    table = '\n'.join(lines) + '\n'
+    print(table)
+
+    if args.output:
+        with open(args.output, 'w') as out:
+            out.write(table)
+
+    return 0
+#------------------------------------------------------------------------------
+
+
+sys.exit(main())
+#------------------------------------------------------------------------------
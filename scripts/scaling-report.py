@@ -0,0 +1,236 @@
+#! /usr/bin/env python3
+#
+#
+# C++ Insights, copyright (C) by Andreas Fertig
+# Distributed under an MIT license. See LICENSE for details
+#
+# Generate synthetic translation units which grow along one axis at a time, run insights on each size and report
+# how time and memory scale with N. A growth clearly faster than linear is flagged, like the splicing of the closure
+# classes of lambdas into the output or lexing the same tokens again for every declaration.
+#
+#------------------------------------------------------------------------------
+
+import argparse
+import csv
+import math
+import os
+import subprocess
+import sys
+import tempfile
+import time
+#------------------------------------------------------------------------------
+
+def lambdas(n):
+    """n lambdas in a single function, each one inserts its closure class in front of its statement."""
+    lines = ['int test(int a)', '{', '    int r = 0;']
+
+    for i in range(n):
+        lines.append('    auto l%d = [&] { return a + %d; };' % (i, i))
+        lines.append('    r += l%d();' % i)
+
+    return lines + ['    return r;', '}']
+#------------------------------------------------------------------------------
+
+def nestedLambdas(n):
+    """A lambda nesting depth of n."""
+    body = 'return a;'
+
+    for i in range(n):
+        body = 'auto l%d = [&] { %s }; return l%d();' % (i, body, i)
+
+    return ['int test(int a)', '{', '    ' + body, '}']
+#------------------------------------------------------------------------------
+
+def classTemplateInstantiations(n):
+    """n instantiations of a class template."""
+    lines = ['template<int N>', 'struct S', '{', '    int get() const { return N; }', '};', '',
+             'int test()', '{', '    int r = 0;']
+
+    for i in range(n):
+        lines.append('    r += S<%d>{}.get();' % i)
+
+    return lines + ['    return r;', '}']
+#------------------------------------------------------------------------------
+
+def initializerList(n):
+    """A single initializer list with n elements."""
+    return ['#include <initializer_list>', '',
+            'int test()', '{', '    std::initializer_list<int> l{%s};' % ', '.join(str(i) for i in range(n)),
+            '    return static_cast<int>(l.size());', '}']
+#------------------------------------------------------------------------------
+
+def globalVariables(n):
+    """n global variables, each of them a top-level declaration of its own."""
+    return ['int g%d = %d;' % (i, i) for i in range(n)]
+#------------------------------------------------------------------------------
+
+def arrayLength(n):
+    """An array with n distinct elements."""
+    return ['int a[%d]{%s};' % (n, ', '.join(str(i) for i in range(n)))]
+#------------------------------------------------------------------------------
+
+def templateRecursion(n):
+    """A class template which instantiates itself n times."""
+    return ['template<int N>', 'struct R', '{', '    static constexpr int value = R<N - 1>::value + 1;', '};', '',
+            'template<>', 'struct R<0>', '{', '    static constexpr int value = 0;', '};', '',
+            'int test() { return R<%d>::value; }' % n]
+#------------------------------------------------------------------------------
+
+# The axes with their generators, the default sizes and additional compiler arguments.
+AXES = {
+    'lambdas':        (lambdas,                     [250, 500, 1000, 2000, 4000], []),
+    'lambda-depth':   (nestedLambdas,               [8, 16, 32, 64, 128], []),
+    'instantiations': (classTemplateInstantiations, [250, 500, 1000, 2000, 4000], []),
+    'init-list':      (initializerList,             [1000, 2000, 4000, 8000, 16000], []),
+    'globals':        (globalVariables,             [1000, 2000, 4000, 8000, 16000], []),
+    'array-length':   (arrayLength,                 [1000, 2000, 4000, 8000, 16000], []),
+    'template-depth': (templateRecursion,           [100, 200, 400, 800, 1600], ['-ftemplate-depth=4096']),
+}
+#------------------------------------------------------------------------------
+
+def measure(insights, fileName, cxxArgs, runs):
+    """The best wall time and the peak memory of runs runs of insights."""
+    best   = None
+    maxRss = 0
+
+    for _ in range(runs):
+        begin = time.time()
+        p     = subprocess.Popen([insights, fileName, '--', '-std=c++17'] + cxxArgs,
+                                 stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        # communicate() would reap the child without its resource usage.
+        _, status, usage = os.wait4(p.pid, 0)
+        wall = time.time() - begin
+        p.returncode = status
+
+        if not os.WIFEXITED(status) or (0 != os.WEXITSTATUS(status)):
+            return None
+
+        best   = wall if best is None else min(best, wall)
+        maxRss = max(maxRss, usage.ru_maxrss if 'darwin' == sys.platform else usage.ru_maxrss * 1024)
+
+    return best, maxRss
+#------------------------------------------------------------------------------
+
+def exponent(rows, key):
+    """The exponent k of the growth N^k between the two largest sizes, 1.0 is linear."""
+    (n1, a), (n2, b) = [(r['n'], r[key]) for r in rows[-2:]]
+
+    if (0 >= a) or (0 >= b):
+        return 0.0
+
+    return math.log(b / a) / math.log(n2 / n1)
+#------------------------------------------------------------------------------
+
+def plot(results, plotFile):
+    try:
+        import matplotlib
+        matplotlib.use('Agg')
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print('--plot requires matplotlib')
+        return
+
+    fig, axes = plt.subplots(2, len(results), figsize=(4 * len(results), 7), squeeze=False)
+
+    for column, (axis, rows) in enumerate(results.items()):
+        n = [r['n'] for r in rows]
+
+        for row, (key, label) in enumerate((('time', 'time [s]'), ('memory', 'peak memory [MiB]'))):
+            values = [r[key] / (1024 * 1024) if 'memory' == key else r[key] for r in rows]
+            ax     = axes[row][column]
+            ax.loglog(n, values, marker='o')
+            ax.set_title(axis)
+            ax.set_xlabel('N')
+            ax.set_ylabel(label)
+
+    fig.tight_layout()
+    fig.savefig(plotFile)
+#------------------------------------------------------------------------------
+
+def main():
+    parser = argparse.ArgumentParser(description='Report how insights scales with the size of its input')
+    parser.add_argument('insights',       help='C++ Insights binary')
+    parser.add_argument('--axis',         help='The axes to measure, all by default', action='append',
+                        choices=sorted(AXES.keys()))
+    parser.add_argument('--sizes',        help='Comma separated sizes instead of the default ones of the axes')
+    parser.add_argument('--runs',         help='Runs per size, the fastest one counts', default=3, type=int)
+    parser.add_argument('--threshold',    help='Flag a growth above N^THRESHOLD as super-linear', default=1.3,
+                        type=float)
+    parser.add_argument('--csv',          help='Write all measurements to FILE', metavar='FILE')
+    parser.add_argument('--plot',         help='Plot time and memory against N to FILE, requires matplotlib',
+                        metavar='FILE')
+    parser.add_argument('--keep',         help='Keep the generated inputs in DIR', metavar='DIR')
+    args = parser.parse_args()
+
+    axes    = args.axis or sorted(AXES.keys())
+    outDir  = args.keep or tempfile.mkdtemp()
+    os.makedirs(outDir, exist_ok=True)
+    results = {}
+    flagged = []
+
+    for axis in axes:
+        generator, sizes, cxxArgs = AXES[axis]
+
+        if args.sizes:
+            sizes = [int(s) for s in args.sizes.split(',')]
+
+        rows = []
+
+        for n in sizes:
+            fileName = os.path.join(outDir, '%s-%d.cpp' % (axis, n))
+
+            with open(fileName, 'w') as out:
+                out.write('\n'.join(generator(n)) + '\n')
+
+            measurement = measure(args.insights, fileName, cxxArgs, args.runs)
+
+            if not args.keep:
+                os.remove(fileName)
+
+            if measurement is None:
+                print('%-15s N=%-6d failed' % (axis, n))
+                break
+
+            rows.append({'axis': axis, 'n': n, 'time': measurement[0], 'memory': measurement[1]})
+            print('%-15s N=%-6d %8.3fs %8.1f MiB' % (axis, n, measurement[0], measurement[1] / (1024 * 1024)))
+
+        if 2 > len(rows):
+            continue
+
+        results[axis] = rows
+
+        for key in ('time', 'memory'):
+            k = exponent(rows, key)
+
+            if k > args.threshold:
+                flagged.append((axis, key, k))
+
+    if not args.keep:
+        os.rmdir(outDir)
+
+    if args.csv:
+        with open(args.csv, 'w', newline='') as out:
+            writer = csv.DictWriter(out, fieldnames=['axis', 'n', 'time', 'memory'])
+            writer.writeheader()
+
+            for rows in results.values():
+                writer.writerows(rows)
+
+    if args.plot and results:
+        plot(results, args.plot)
+
+    print('-----------------------------------------------------------------')
+
+    for axis, rows in results.items():
+        print('%-15s time ~ N^%.2f, memory ~ N^%.2f' % (axis, exponent(rows, 'time'), exponent(rows, 'memory')))
+
+    for axis, key, k in flagged:
+        print('[SUPER-LINEAR] %s: %s grows with N^%.2f' % (axis, key, k))
+
+    return 1 if flagged else 0
+#------------------------------------------------------------------------------
+
+
+if __name__ == '__main__':
+    sys.exit(main())
+#------------------------------------------------------------------------------
@@ -0,0 +1,107 @@
+#! /usr/bin/env python3
+#
+#
+# C++ Insights, copyright (C) by Andreas Fertig
+# Distributed under an MIT license. See LICENSE for details
+#
+# Train the preset dictionary for the compressed responses of --server on the expected outputs of the tests. The
+# dictionary consists of the lines and runs of tokens most of the outputs share, like the spelling of std::basic_string
+# or the operator() of a lambda class. A piece counts once per file, as the dictionary helps only with the first
+# occurrence of it in a response. zlib looks back at most 32 KiB, the most valuable pieces go last, closest to the data.
+#
+#------------------------------------------------------------------------------
+
+import argparse
+import glob
+import os
+import sys
+import zlib
+#------------------------------------------------------------------------------
+
+MAX_DICTIONARY_SIZE = 32 * 1024
+MAX_TOKENS          = 8
+MIN_PIECE_LENGTH    = 6
+#------------------------------------------------------------------------------
+
+def collectPieces(text):
+    """All distinct lines and runs of up to MAX_TOKENS tokens of a line in text."""
+    pieces = set()
+
+    for line in text.splitlines():
+        tokens = line.split()
+
+        if len(line.strip()) >= MIN_PIECE_LENGTH:
+            pieces.add(line.strip() + '\n')
+
+        for begin in range(len(tokens)):
+            for end in range(begin + 1, min(begin + MAX_TOKENS, len(tokens)) + 1):
+                piece = ' '.join(tokens[begin:end])
+
+                # The whole line is already there, together with its newline.
+                if (len(piece) >= MIN_PIECE_LENGTH) and ((0 != begin) or (len(tokens) != end)):
+                    pieces.add(piece)
+
+    return pieces
+#------------------------------------------------------------------------------
+
+def train(files, minFiles):
+    counts = {}
+
+    for fileName in files:
+        with open(fileName, encoding='utf-8', errors='replace') as f:
+            for piece in collectPieces(f.read()):
+                counts[piece] = counts.get(piece, 0) + 1
+
+    # What a piece saves in all files, a back reference costs about three bytes.
+    scored = sorted(((count * (len(piece) - 3), piece) for piece, count in counts.items() if count >= minFiles),
+                    key=lambda s: (-s[0], s[1]))
+
+    chosen = []
+    size   = 0
+
+    for _, piece in scored:
+        if size + len(piece) > MAX_DICTIONARY_SIZE:
+            continue
+
+        # A piece which is already part of a more valuable one gains nothing.
+        if any(piece in c for c in chosen):
+            continue
+
+        # The less valuable pieces which are part of this one are no longer needed.
+        chosen = [c for c in chosen if c not in piece]
+        chosen.append(piece)
+        size = sum(len(c) for c in chosen)
+
+    return ''.join(reversed(chosen))
+#------------------------------------------------------------------------------
+
+def main():
+    scriptDir = os.path.dirname(os.path.abspath(__file__))
+
+    parser = argparse.ArgumentParser(description='Train the dictionary for the compressed responses of --server')
+    parser.add_argument('--tests',     help='Directory of the .expect files', default=os.path.join(scriptDir, '..',
+                                                                                                   'tests'))
+    parser.add_argument('--output',    help='Where the dictionary goes',
+                        default=os.path.join(scriptDir, 'response-dictionary.txt'))
+    parser.add_argument('--min-files', help='In how many files a piece has to occur', default=2, type=int)
+    args = parser.parse_args()
+
+    files = sorted(glob.glob(os.path.join(args.tests, '*.expect')))
+
+    if not files:
+        print('no .expect files in %s' % args.tests)
+        return 1
+
+    dictionary = train(files, args.min_files).encode('utf-8')
+
+    with open(args.output, 'wb') as out:
+        out.write(dictionary)
+
+    # The id zlib stores in a stream compressed with the dictionary, the client checks it.
+    print('%s: %d bytes from %d files, id %08x' % (args.output, len(dictionary), len(files), zlib.adler32(dictionary)))
+
+    return 0
+#------------------------------------------------------------------------------
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,27 @@
+// cmdlineinsights:-alt-syntax-unroll=4
+
+int main()
+{
+    int a[10]{};
+    int sum = 0;
+
+    for(int i = 0; i < 3; ++i) {
+        sum += a[i];
+    }
+
+    for(int i = 0; i < 10; i += 1) {
+        sum += a[i];
+    }
+
+    char data[5]{};
+    for(auto& x : data) {
+        x = 2;
+    }
+
+    // The body changes the induction variable, the loop stays as it is.
+    for(int i = 0; i < 10; ++i) {
+        i += a[i];
+    }
+
+    return sum;
+}
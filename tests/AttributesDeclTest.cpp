@@ -0,0 +1,31 @@
+// cmdline:-std=c++2a
+
+struct Empty
+{
+};
+
+struct alignas(32) Block
+{
+    alignas(16) float data[4];
+    [[no_unique_address]] Empty tag;
+};
+
+[[gnu::always_inline]] inline int Add(int a, int b)
+{
+    return a + b;
+}
+
+[[gnu::hot]] void Copy(float* __restrict dst, const float* __restrict src, int n)
+{
+    for(int i = 0; i < n; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+[[gnu::cold]] [[noreturn]] void Fail();
+
+int Use()
+{
+    alignas(64) int buffer[4]{};
+    return Add(buffer[0], 1);
+}
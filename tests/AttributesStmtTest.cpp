@@ -0,0 +1,35 @@
+// cmdline:-std=c++2a
+
+int Classify(int x)
+{
+    if(x > 0) [[likely]] {
+        return 1;
+    } else [[unlikely]] {
+        return -1;
+    }
+}
+
+int Fall(int x)
+{
+    int r = 0;
+
+    switch(x) {
+        case 1: r += 1; [[fallthrough]];
+        case 2: r += 2; break;
+    }
+
+    return r;
+}
+
+long Expect(int x)
+{
+    return __builtin_expect(x == 0, 0);
+}
+
+void Hint(int* a, int n)
+{
+#pragma clang loop vectorize(enable) interleave(enable)
+    for(int i = 0; i < n; ++i) {
+        a[i] = 0;
+    }
+}
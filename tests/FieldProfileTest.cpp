@@ -0,0 +1,15 @@
+// cmdlineinsights:-field-profile=FieldProfileTest.csv
+struct Order
+{
+    char   note[48];
+    int    id;
+    double price;
+    char   flag;
+    long   quantity;
+};
+
+struct Point
+{
+    int x;
+    int y;
+};
@@ -0,0 +1,11 @@
+// cmdlineinsights:--handlers=templates
+template<int N>
+int foo()
+{
+    return N;
+}
+
+int main()
+{
+    foo<1>();
+}
@@ -3,7 +3,7 @@
 
 int main()
 {
-    // check that clamp works and we only initialize the first 100 elements.
+    // check that more than 100 equal elements are written as a single run.
     std::array<int, 100000> arr{};
 
     char buffer[100000]{};
@@ -0,0 +1,9 @@
+// cmdlineinsights:-show-closure-layout
+int main() {
+    int l1;
+    int l2 = 2;
+
+    [&l1, l2]() {
+        l1 = 2 * l2;
+    }();
+}
@@ -0,0 +1,11 @@
+int main()
+{
+    char buffer;
+    [&]() {
+        [&]() {
+            [&]() {
+                buffer = 3;
+            }();
+        }();
+    }();
+}
@@ -0,0 +1,6 @@
+int main()
+{
+    int a = 1;
+    int b = a + a + a + a + a + a + a + a + a + a + a + a + a + a + a + a;
+    int c = a * 2 + a * 3 - a / 4;
+}
@@ -0,0 +1,4 @@
+// cmdlineinsights:-max-array-elements=4
+char c[8]{};
+
+auto [a, b, d, e, f, g, h, i] = c;
@@ -0,0 +1,13 @@
+// cmdlineinsights:-max-instantiations=1
+template<int N>
+int foo()
+{
+    return N;
+}
+
+int main()
+{
+    foo<1>();
+    foo<2>();
+    foo<3>();
+}
@@ -0,0 +1,16 @@
+// cmdlineinsights:-max-pack-args=4
+template<int... Ns>
+struct Seq
+{
+    static constexpr int size = sizeof...(Ns);
+};
+
+template<typename... Ts>
+struct Types
+{
+    static constexpr int size = sizeof...(Ts);
+};
+
+int a = Seq<0, 1, 2, 3, 4, 5, 6, 7>::size;
+int b = Seq<1, 2, 3>::size;
+int c = Types<int, int, int, int, int, char>::size;
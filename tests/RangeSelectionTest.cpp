@@ -0,0 +1,9 @@
+// cmdlineinsights:--range=7:7
+
+void Before() {}
+
+void AlsoBefore() {}
+
+void Selected() {}
+
+void After() {}
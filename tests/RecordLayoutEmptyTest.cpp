@@ -0,0 +1,32 @@
+// cmdlineinsights:-show-layout cmdline:-std=c++2a
+struct Tag
+{
+};
+
+struct A : Tag
+{
+};
+
+struct B : Tag
+{
+};
+
+struct Twice : A, B
+{
+};
+
+struct Less
+{
+};
+
+struct Map
+{
+    Less  cmp;
+    long* data;
+};
+
+struct Shared
+{
+    [[no_unique_address]] Less cmp;
+    long*                      data;
+};
@@ -0,0 +1,22 @@
+// cmdlineinsights:-show-layout
+struct Padded
+{
+  char c;
+  double d;
+  short s;
+};
+
+struct Bits
+{
+  unsigned a : 3;
+  unsigned b : 7;
+  char c;
+};
+
+struct Wide
+{
+  char c;
+  char data[70];
+  int i;
+};
+
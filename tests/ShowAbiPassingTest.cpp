@@ -0,0 +1,22 @@
+// cmdlineinsights:-show-abi-passing
+struct Plain
+{
+    int i;
+};
+
+struct Wrapped
+{
+    int i;
+
+    ~Wrapped() {}
+};
+
+struct Large
+{
+    long a, b, c;
+};
+
+Wrapped Pass(int i, Plain p, Wrapped w, const Large& ref, Large l)
+{
+    return {i};
+}
@@ -0,0 +1,15 @@
+// cmdlineinsights:-show-allocations
+int* Make(int n)
+{
+    int* values = new int[n];
+    int* first  = new int{n};
+
+    delete first;
+
+    return values;
+}
+
+int Sum(int a, int b)
+{
+    return a + b;
+}
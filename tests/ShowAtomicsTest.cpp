@@ -0,0 +1,22 @@
+// cmdlineinsights:-show-atomics
+#include <atomic>
+
+int Work(std::atomic<int>& counter, std::atomic<bool>& flag, std::atomic<int>* p)
+{
+    for(int i = 0; i < 10; ++i) {
+        counter++;
+    }
+
+    flag = true;
+
+    int expected = 0;
+    counter.compare_exchange_strong(expected, 1, std::memory_order_acq_rel);
+    p->fetch_add(2, std::memory_order_relaxed);
+
+    return counter.load(std::memory_order_acquire);
+}
+
+void Accumulate(std::atomic<int>& x, std::atomic<int>& y, int z)
+{
+    x += y += z;
+}
@@ -0,0 +1,33 @@
+// cmdlineinsights:-show-auto-copies
+struct Heavy
+{
+    int i;
+
+    Heavy() {}
+    Heavy(const Heavy&) {}
+};
+
+struct Holder
+{
+    Heavy heavy;
+
+    const Heavy& Ref() const { return heavy; }
+};
+
+Heavy Make()
+{
+    return {};
+}
+
+void Use(const Holder& holder)
+{
+    auto copy = holder.Ref();
+    auto& ref = holder.Ref();
+    auto made = Make();
+    int  n    = holder.heavy.i;
+    auto i    = n;
+
+    while(n--) {
+        auto inner = copy;
+    }
+}
@@ -0,0 +1,17 @@
+// cmdlineinsights:-show-binding-storage
+struct Point
+{
+    int x;
+    int y;
+};
+
+Point Make();
+
+int Use(Point& p)
+{
+    auto [a, b]  = p;
+    auto& [c, d] = p;
+    auto [e, f]  = Make();
+
+    return a + c + e;
+}
@@ -0,0 +1,18 @@
+// cmdlineinsights:-show-casts=expensive
+struct Meters
+{
+    double value;
+
+    operator double() const { return value; }
+};
+
+double Sum(const Meters* m, int n)
+{
+    double total = m[0];
+
+    for(int i = 1; i < n; ++i) {
+        total += m[i];
+    }
+
+    return total;
+}
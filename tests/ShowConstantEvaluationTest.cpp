@@ -0,0 +1,15 @@
+// cmdlineinsights:-show-constant-evaluation
+constexpr int Square(int x)
+{
+    return x * x;
+}
+
+int Use(int n)
+{
+    int values[Square(3)]{};
+
+    int folded  = Square(4);
+    int runtime = Square(n);
+
+    return values[0] + folded + runtime;
+}
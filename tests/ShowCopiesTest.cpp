@@ -0,0 +1,21 @@
+// cmdlineinsights:-show-copies
+#include <string>
+#include <utility>
+
+struct S
+{
+    int i;
+};
+
+int main()
+{
+    S s{1};
+
+    S s2 = s;
+    S s3 = std::move(s);
+
+    std::string str{"hello"};
+
+    std::string str2 = str;
+    std::string str3 = std::move(str);
+}
@@ -0,0 +1,23 @@
+// cmdlineinsights:-show-coroutine-frame cmdline:-std=c++2a
+#include <experimental/coroutine>
+
+namespace stdx = std::experimental;
+
+struct task
+{
+    struct promise_type
+    {
+        task get_return_object() { return task{}; }
+        stdx::suspend_never initial_suspend() { return {}; }
+        stdx::suspend_never final_suspend() { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+};
+
+task Run(int v)
+{
+    int local = v;
+    co_await stdx::suspend_always{};
+    local += v;
+}
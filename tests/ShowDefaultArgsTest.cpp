@@ -0,0 +1,22 @@
+// cmdlineinsights:-show-default-args
+struct Name
+{
+    Name(const char* s)
+    : text{s}
+    {
+    }
+
+    ~Name() {}
+
+    const char* text;
+};
+
+int Next();
+
+void Log(const Name& name = "default", int level = 3, int id = Next());
+
+void Run()
+{
+    Log();
+    Log("other");
+}
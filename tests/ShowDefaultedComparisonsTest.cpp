@@ -0,0 +1,22 @@
+// cmdlineinsights:-show-defaulted-comparisons cmdline:-std=c++2a
+struct Name
+{
+    bool operator==(const Name& other) const;
+
+    int id;
+};
+
+struct Record
+{
+    int   key;
+    char  tag[16];
+    float weights[4];
+    Name  name;
+
+    bool operator==(const Record&) const = default;
+};
+
+bool Same(const Record& a, const Record& b)
+{
+    return a == b;
+}
@@ -0,0 +1,33 @@
+// cmdlineinsights:-show-elision
+struct S
+{
+    int i;
+};
+
+S Named()
+{
+    S s{1};
+    return s;
+}
+
+S Prvalue()
+{
+    return S{2};
+}
+
+S Param(S s)
+{
+    return s;
+}
+
+S Two(bool b)
+{
+    S a{1};
+    S c{2};
+
+    if(b) {
+        return a;
+    }
+
+    return c;
+}
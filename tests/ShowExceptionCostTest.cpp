@@ -0,0 +1,28 @@
+// cmdlineinsights:-show-exception-cost
+struct Error
+{
+    int code;
+};
+
+int Parse(int v)
+{
+    if(v < 0) {
+        throw Error{v};
+    }
+
+    return v;
+}
+
+int Safe(int v)
+{
+    try {
+        return Parse(v);
+    } catch(const Error& e) {
+        return e.code;
+    }
+}
+
+int Add(int a, int b)
+{
+    return a + b;
+}
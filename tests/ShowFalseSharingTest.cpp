@@ -0,0 +1,15 @@
+// cmdlineinsights:-show-false-sharing
+#include <atomic>
+
+struct Queue
+{
+    std::atomic<int> head;
+    std::atomic<int> tail;
+    int              capacity;
+};
+
+struct Padded
+{
+    alignas(64) std::atomic<int> head;
+    alignas(64) std::atomic<int> tail;
+};
@@ -0,0 +1,31 @@
+// cmdlineinsights:-show-function-erasure
+#include <functional>
+
+int Twice(int x)
+{
+    return 2 * x;
+}
+
+struct Big
+{
+    long a;
+    long b;
+    long c;
+
+    int operator()(int x) const { return x + a; }
+};
+
+int Call()
+{
+    Big big{};
+
+    std::function<int(int)> small = Twice;
+    std::function<int(int)> large = big;
+
+    return small(1) + large(2);
+}
+
+int CallReturned(std::function<std::function<int(int)>&()>& get)
+{
+    return get()(3);
+}
@@ -0,0 +1,24 @@
+// cmdlineinsights:-show-global-init
+struct Constant
+{
+    constexpr Constant()
+    : i{1}
+    {
+    }
+
+    int i;
+};
+
+struct Dynamic
+{
+    Dynamic() {}
+    ~Dynamic() {}
+
+    int i;
+};
+
+int Compute();
+
+Constant c;
+Dynamic  d;
+int      value = Compute();
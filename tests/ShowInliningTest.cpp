@@ -0,0 +1,19 @@
+// cmdlineinsights:-show-inlining
+inline int Square(int x)
+{
+    return x * x;
+}
+
+struct Point
+{
+    int x;
+    int y;
+
+    int Sum() const { return x + y; }
+};
+
+int Run(int i)
+{
+    Point p{1, 2};
+    return Square(i + 1) + p.Sum();
+}
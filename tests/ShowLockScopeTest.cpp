@@ -0,0 +1,25 @@
+// cmdlineinsights:-show-lock-scope
+#include <cstdio>
+#include <mutex>
+
+struct Shape
+{
+    virtual int Area() const = 0;
+};
+
+int Update(std::mutex& m, int& counter, const Shape& shape)
+{
+    std::lock_guard<std::mutex> lock{m};
+    ++counter;
+    printf("%d\n", counter);
+
+    return shape.Area() + counter;
+}
+
+void Drain(std::mutex& m, int& counter)
+{
+    std::unique_lock<std::mutex> lock{m};
+    counter = 0;
+    lock.unlock();
+    puts("drained");
+}
@@ -0,0 +1,54 @@
+// cmdlineinsights:-show-memcpy
+#include <utility>
+
+struct Point
+{
+    int x;
+    int y;
+};
+
+struct Empty
+{
+};
+
+void Copy(int* dst, const int* src, int n)
+{
+    for(int i = 0; i < n; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+void CopyPoints(Point (&dst)[8], const Point (&src)[8])
+{
+    for(int i = 0; i < 8; ++i) {
+        dst[i] = src[i];
+    }
+}
+
+int main()
+{
+    Point a{1, 2};
+    Point b = a;
+
+    b = a;
+    b = std::move(a);
+    b = Point{3, 4};
+
+    Empty e{};
+    Empty e2 = e;
+    e2       = e;
+
+    int in[16]{};
+    int out[16]{};
+
+    for(int i = 4; i < 16; ++i) {
+        out[i] = in[i];
+    }
+
+    Copy(out, in, 16);
+}
+
+void Chain(Point& a, const Point& b, const Point& c)
+{
+    (a = b) = c;
+}
@@ -0,0 +1,20 @@
+// cmdlineinsights:-show-noexcept-move
+#include <vector>
+
+struct Throwing
+{
+    Throwing(int) {}
+    Throwing(Throwing&&) {}
+};
+
+struct Fine
+{
+    Fine(int) {}
+    Fine(Fine&&) noexcept {}
+};
+
+void Use()
+{
+    std::vector<Throwing> throwing;
+    std::vector<Fine>     fine;
+}
@@ -0,0 +1,35 @@
+// cmdlineinsights:-show-openmp cmdline:-fopenmp
+// The entry points of libomp the lowering calls, so that the result compiles.
+struct ident_t
+{
+    int         reserved_1;
+    int         flags;
+    int         reserved_2;
+    int         reserved_3;
+    const char* psource;
+};
+
+using kmp_critical_name = int[8];
+using kmpc_micro        = void (*)(int*, int*, ...);
+
+extern "C" {
+void __kmpc_fork_call(ident_t*, int, kmpc_micro, ...);
+void __kmpc_for_static_init_4(ident_t*, int, int, int*, int*, int*, int*, int, int);
+void __kmpc_for_static_fini(ident_t*, int);
+int  __kmpc_reduce_nowait(ident_t*, int, int, unsigned long, void*, void (*)(void*, void*), kmp_critical_name*);
+void __kmpc_end_reduce_nowait(ident_t*, int, kmp_critical_name*);
+}
+
+void __omp_reduction_func(void*, void*);
+
+int Sum(const int* a, int n)
+{
+    int sum = 0;
+
+#pragma omp parallel for reduction(+ : sum)
+    for(int i = 0; i < n; ++i) {
+        sum += a[i];
+    }
+
+    return sum;
+}
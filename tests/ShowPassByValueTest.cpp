@@ -0,0 +1,50 @@
+// cmdlineinsights:-show-pass-by-value
+#include <utility>
+
+struct Big
+{
+    long a;
+    long b;
+    long c;
+};
+
+struct Small
+{
+    int a;
+};
+
+struct Heavy
+{
+    Heavy() {}
+    Heavy(const Heavy&) {}
+    Heavy(Heavy&&) {}
+};
+
+void UseBig(Big b) {}
+
+void UseSmall(Small s) {}
+
+void UseHeavy(Heavy h) {}
+
+void Sink(Heavy h)
+{
+    Heavy other = std::move(h);
+}
+
+void CopyInside(Heavy h)
+{
+    Heavy other = h;
+}
+
+int main()
+{
+    Big b{1, 2, 3};
+    UseBig(b);
+
+    UseSmall(Small{1});
+
+    Heavy h;
+    UseHeavy(h);
+    Sink(Heavy{});
+    CopyInside(h);
+}
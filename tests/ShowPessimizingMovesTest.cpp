@@ -0,0 +1,27 @@
+// cmdlineinsights:-show-pessimizing-moves
+#include <utility>
+
+struct Movable
+{
+    Movable() = default;
+    Movable(const Movable&) {}
+    Movable(Movable&&) {}
+};
+
+void Consume(const Movable& m) {}
+
+Movable Make()
+{
+    Movable local{};
+    return std::move(local);
+}
+
+Movable Copy(const Movable& m)
+{
+    const Movable c{};
+    Movable       copy{std::move(c)};
+
+    Consume(std::move(copy));
+
+    return m;
+}
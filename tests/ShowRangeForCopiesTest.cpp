@@ -0,0 +1,24 @@
+// cmdlineinsights:-show-range-for-copies
+struct Heavy
+{
+    int i;
+
+    Heavy(const Heavy&) {}
+};
+
+struct Other
+{
+    Other(const Heavy&) {}
+};
+
+void Loop(Heavy (&arr)[2])
+{
+    for(Heavy h : arr) {
+    }
+
+    for(const Heavy& h : arr) {
+    }
+
+    for(const Other& o : arr) {
+    }
+}
@@ -0,0 +1,28 @@
+// cmdlineinsights:-show-ranges-pipeline
+// Stand-ins for the views, the note only looks at the names of the nested specializations.
+namespace std { template<typename T, unsigned long N> struct array; }
+
+namespace std::ranges {
+  template<typename R> struct ref_view;
+}
+
+namespace std::ranges {
+  template<typename V, typename F> struct transform_view;
+}
+
+namespace std::ranges {
+  template<typename V, typename P> struct filter_view;
+}
+
+struct Square {};
+struct IsEven {};
+
+template<> struct std::array<int, 4> {};
+template<> struct std::ranges::ref_view<std::array<int, 4>> {};
+template<> struct std::ranges::transform_view<std::ranges::ref_view<std::array<int, 4>>, Square> {};
+template<> struct std::ranges::filter_view<std::ranges::transform_view<std::ranges::ref_view<std::array<int, 4>>, Square>, IsEven> {};
+
+int main()
+{
+  std::ranges::filter_view<std::ranges::transform_view<std::ranges::ref_view<std::array<int, 4>>, Square>, IsEven> pipeline{};
+}
@@ -0,0 +1,18 @@
+// cmdlineinsights:-show-refcounts
+#include <memory>
+
+int Read(std::shared_ptr<int> p)
+{
+    return *p;
+}
+
+int Use(const std::shared_ptr<int>& owner)
+{
+    std::shared_ptr<int> copy = owner;
+    return Read(copy);
+}
+
+void Assign(std::shared_ptr<int>& a, const std::shared_ptr<int>& b, const std::shared_ptr<int>& c)
+{
+    (a = b) = c;
+}
@@ -0,0 +1,40 @@
+// cmdlineinsights:-show-rtti
+#include <typeinfo>
+
+struct Base
+{
+    virtual int Get() const { return 1; }
+};
+
+struct Derived final : Base
+{
+    int i;
+};
+
+struct Other : Base
+{
+    int j;
+};
+
+int FromPointer(Base* b)
+{
+    Derived* d = dynamic_cast<Derived*>(b);
+    return d->i;
+}
+
+int FromReference(Base& b)
+{
+    Other& o = dynamic_cast<Other&>(b);
+    return o.j;
+}
+
+int Known(Derived& d)
+{
+    Derived* p = dynamic_cast<Derived*>(static_cast<Base*>(&d));
+    return p->i;
+}
+
+const char* Name(Base& b)
+{
+    return typeid(b).name();
+}
@@ -0,0 +1,22 @@
+// cmdlineinsights:-show-soa
+struct Particle
+{
+    float x;
+    float y;
+    float vx;
+    float vy;
+    int   id;
+};
+
+void Reset(Particle& p);
+
+void Move(Particle (&particles)[8])
+{
+    for(Particle& p : particles) {
+        p.x = p.x + p.vx;
+    }
+
+    for(Particle& p : particles) {
+        Reset(p);
+    }
+}
@@ -0,0 +1,17 @@
+// cmdlineinsights:-show-special-members
+struct Plain
+{
+    int  a;
+    char b;
+};
+
+struct Tracked
+{
+    ~Tracked() {}
+};
+
+struct Holder
+{
+    Plain   plain;
+    Tracked tracked;
+};
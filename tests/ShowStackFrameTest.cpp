@@ -0,0 +1,19 @@
+// cmdlineinsights:-show-stack-frame
+int Sum(int n)
+{
+    char buffer[8192];
+    int  values[4] = {1, 2, 3, 4};
+    int  sum       = 0;
+
+    for(int v : values) {
+        sum += v;
+    }
+
+    return sum + buffer[n];
+}
+
+int Small(int n)
+{
+    int doubled = n * 2;
+    return doubled;
+}
@@ -0,0 +1,29 @@
+// cmdlineinsights:-show-static-init
+struct Constant
+{
+    constexpr Constant()
+    : i{1}
+    {
+    }
+
+    int i;
+};
+
+struct Dynamic
+{
+    Dynamic() {}
+
+    int i;
+};
+
+Constant& GetConstant()
+{
+    static Constant c;
+    return c;
+}
+
+Dynamic& GetDynamic()
+{
+    static Dynamic d;
+    return d;
+}
@@ -0,0 +1,10 @@
+// cmdlineinsights:-show-string-temporaries
+#include <string>
+
+void Log(const std::string& message);
+
+void Use()
+{
+    Log("short");
+    Log("a literal longer than the buffer");
+}
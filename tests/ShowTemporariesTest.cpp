@@ -0,0 +1,15 @@
+// cmdlineinsights:-show-temporaries
+struct T
+{
+    T(int) {}
+    ~T() {}
+};
+
+int Use(const T&) { return 1; }
+
+int main()
+{
+    int x = Use(T{2});
+
+    const T& t = T{3};
+}
@@ -0,0 +1,24 @@
+// cmdlineinsights:-show-thread-local
+struct Dynamic
+{
+    Dynamic() {}
+    ~Dynamic() {}
+
+    int i;
+};
+
+int Compute();
+
+thread_local Dynamic d;
+thread_local int     value = Compute();
+
+int Sum()
+{
+    return d.i + value;
+}
+
+Dynamic& Local()
+{
+    thread_local Dynamic local;
+    return local;
+}
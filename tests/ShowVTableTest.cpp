@@ -0,0 +1,5 @@
+// cmdlineinsights:-show-vtable
+struct Base
+{
+    virtual int Get() const { return 1; }
+};
@@ -0,0 +1,13 @@
+// cmdlineinsights:-show-variant-visit
+#include <variant>
+
+struct Visitor
+{
+    int operator()(int x) const { return x; }
+    int operator()(double d) const { return static_cast<int>(d); }
+};
+
+int Visit(const std::variant<int, double>& v)
+{
+    return std::visit(Visitor{}, v);
+}
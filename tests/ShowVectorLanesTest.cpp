@@ -0,0 +1,35 @@
+// cmdlineinsights:-show-vector-lanes
+typedef float float4 __attribute__((ext_vector_type(4)));
+typedef float float2 __attribute__((ext_vector_type(2)));
+typedef int int4v __attribute__((vector_size(16)));
+
+float4 Scale(float4 v, float f)
+{
+    return v * f;
+}
+
+int4v Mask(int4v a, int4v b)
+{
+    int4v m = a < b;
+    return ~m;
+}
+
+float2 Low(float4 v)
+{
+    return v.xy;
+}
+
+float4 Reverse(float4 v)
+{
+    return __builtin_shufflevector(v, v, 3, 2, 1, 0);
+}
+
+int4v Truncate(float4 v)
+{
+    return __builtin_convertvector(v, int4v);
+}
+
+float4 MulAdd(float4 a, float4 b, float4 c)
+{
+    return a * b + c;
+}
@@ -0,0 +1,18 @@
+// cmdlineinsights:-show-virtual-calls
+struct Base
+{
+    virtual int Get() const { return 1; }
+};
+
+struct Derived final : Base
+{
+    int Get() const override { return 2; }
+};
+
+int Call(const Base& b, const Derived& d)
+{
+    int x = b.Get();
+    int y = d.Get();
+
+    return x + y;
+}
@@ -0,0 +1,33 @@
+// cmdlineinsights:-show-zero-init
+struct Buffer
+{
+    char data[4096];
+    int  size;
+};
+
+struct Named
+{
+    Named() {}
+    int id;
+};
+
+struct Holder
+{
+    int   count;
+    Named names[2];
+};
+
+void Fill(int n)
+{
+    Buffer plain;
+    Buffer zeroed{};
+    int    counts[8] = {1};
+    Holder holder{};
+
+    for(int i = 0; i < n; ++i) {
+        Buffer scratch{};
+    }
+
+    Buffer* heap = new Buffer();
+    delete heap;
+}
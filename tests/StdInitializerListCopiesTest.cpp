@@ -0,0 +1,15 @@
+// cmdlineinsights:-edu-show-initlist
+#include <initializer_list>
+
+struct Heavy
+{
+    Heavy(int) {}
+    Heavy(const Heavy&) {}
+};
+
+void Take(std::initializer_list<Heavy> list);
+
+void Use()
+{
+    Take({1, 2});
+}
@@ -0,0 +1,23 @@
+// cmdlineinsights:-edu-show-initlist
+#include <initializer_list>
+
+struct Foo
+{
+    Foo(std::initializer_list<int> l) {}
+};
+
+class Test
+{
+public:
+    int Get()
+    {
+        int x = 2;
+        return x;
+    }
+
+    Test()
+    : v{1,2}
+    {}
+
+    Foo v;
+};
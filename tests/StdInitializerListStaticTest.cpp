@@ -0,0 +1,14 @@
+// cmdlineinsights:-edu-show-initlist
+#include <initializer_list>
+
+struct Foo
+{
+    Foo(std::initializer_list<int> l) noexcept {}
+};
+
+Foo& Get()
+{
+    static Foo foo{1, 2};
+
+    return foo;
+}
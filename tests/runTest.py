@@ -7,30 +7,115 @@ import subprocess
 import re
 import argparse
 import tempfile
-import datetime
+import time
+import json
+import threading
+import multiprocessing
+from multiprocessing.pool import ThreadPool
 #------------------------------------------------------------------------------
 
 mypath = '.'
 
+# A regression below these differences is noise, not worth a warning.
+PERF_MIN_CPU    = 0.05
+PERF_MIN_MAXRSS = 16 * 1024 * 1024
 
-def testCompare(tmpFileName, stdout, expectFile, f, args, time):
+# The exit code of insights --verify-output, if the result does not compile.
+VERIFY_FAILED_EXIT_CODE = 4
+
+
+def runMeasured(cmd):
+    """Run cmd and return its output together with the wall and CPU time and the peak memory of the child.
+
+    communicate() reaps the child without its resource usage, so the pipes are read here and the child is waited for
+    with wait4.
+    """
+    begin = time.time()
+    p     = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+
+    # Reading both pipes from one thread could block the child on a full stderr pipe.
+    stderr = []
+    reader = threading.Thread(target=lambda: stderr.append(p.stderr.read()))
+    reader.start()
+    stdout = p.stdout.read()
+    reader.join()
+
+    _, status, usage = os.wait4(p.pid, 0)
+    wall = time.time() - begin
+
+    p.returncode = -os.WTERMSIG(status) if os.WIFSIGNALED(status) else os.WEXITSTATUS(status)
+
+    # ru_maxrss is in KiB on Linux and in bytes on macOS.
+    maxRss = usage.ru_maxrss if 'darwin' == sys.platform else usage.ru_maxrss * 1024
+
+    return p.returncode, stdout, stderr[0], {'wall': wall, 'cpu': usage.ru_utime + usage.ru_stime, 'maxrss': maxRss}
+#------------------------------------------------------------------------------
+
+def formatTiming(timing):
+    return '%.3fs wall, %.3fs cpu' %(timing['wall'], timing['cpu'])
+#------------------------------------------------------------------------------
+
+def testCompare(tmpFileName, stdout, expectFile, f, args, timing, log):
     expect = open(expectFile, 'r').read()
 
     if stdout != expect:
-        print '[FAILED] %s - %s' %(f, time)
+        log.append('[FAILED] %s - %s' %(f, formatTiming(timing)))
         cmd = ['/usr/bin/diff', expectFile, tmpFileName]
         p = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
         stdout, stderr = p.communicate()
 
-        print stdout
+        log.append(stdout)
     else:
-        print '[PASSED] %s - %s' %(f, time)
+        log.append('[PASSED] %s - %s' %(f, formatTiming(timing)))
         return True
 
     return False
 #------------------------------------------------------------------------------
 
-def testCompile(tmpFileName, f, args, fileName, cppStd):
+def writePerf(perfFile, baseline):
+    with open(perfFile, 'w') as out:
+        json.dump(baseline, out, sort_keys=True)
+        out.write('\n')
+#------------------------------------------------------------------------------
+
+def testPerf(f, fileName, timing, args, log):
+    """Compare the CPU time and the peak memory against the baseline in the .perf file of the test, if there is one.
+
+    Returns False, if the test regressed and --perf-fail is given.
+    """
+    perfFile = os.path.join(mypath, fileName + '.perf')
+    baseline = {'cpu': timing['cpu'], 'maxrss': timing['maxrss']}
+
+    if not os.path.isfile(perfFile):
+        if args['update_perf']:
+            writePerf(perfFile, baseline)
+            log.append('Creating perf: %s' %(perfFile))
+
+        return True
+
+    if args['update_tests'] or args['update_perf']:
+        writePerf(perfFile, baseline)
+        return True
+
+    expected    = json.load(open(perfFile, 'r'))
+    tolerance   = args['perf_tolerance']
+    regressions = []
+
+    for key, unit, scale, minDiff in (('cpu', 's', 1, PERF_MIN_CPU), ('maxrss', 'MiB', 1024 * 1024, PERF_MIN_MAXRSS)):
+        if (timing[key] > (expected[key] * tolerance)) and ((timing[key] - expected[key]) > minDiff):
+            regressions.append('%s %.3f%s instead of %.3f%s' %(key, float(timing[key]) / scale, unit,
+                                                               float(expected[key]) / scale, unit))
+
+    if not regressions:
+        return True
+
+    result = '[FAILED]' if args['perf_fail'] else '[SLOWER]'
+    log.append('%s Perf: %s - %s' %(result, f, ', '.join(regressions)))
+
+    return not args['perf_fail']
+#------------------------------------------------------------------------------
+
+def testCompile(tmpFileName, f, args, fileName, cppStd, log):
     cmd = [args['cxx'], cppStd, '-m64', '-D__cxa_guard_acquire(x)=true', '-D__cxa_guard_release(x)', '-D__cxa_guard_abort(x)']
 
     # GCC seems to dislike empty ''
@@ -51,7 +136,7 @@ def testCompile(tmpFileName, f, args, fileName, cppStd):
             stderr = re.sub('/(.*)/(.*?:[0-9]+):', '... \\2:', stderr)
 
             if ce == stderr:
-                print '[PASSED] Compile: %s' %(f)
+                log.append('[PASSED] Compile: %s' %(f))
                 return True, None
 
         compileErrorFile = os.path.join(mypath, fileName + '.ccerr')
@@ -60,24 +145,192 @@ def testCompile(tmpFileName, f, args, fileName, cppStd):
                 stderr = stderr.replace(tmpFileName, '.tmp.cpp')
 
                 if ce == stderr:
-                    print '[PASSED] Compile: %s' %(f)
+                    log.append('[PASSED] Compile: %s' %(f))
                     return True, None
 
-        print '[ERROR] Compile failed: %s' %(f)
-        print stderr
+        log.append('[ERROR] Compile failed: %s' %(f))
+        log.append(stderr)
     else:
         if os.path.isfile(compileErrorFile):
-            print 'unused file: %s' %(compileErrorFile)
+            log.append('unused file: %s' %(compileErrorFile))
 
         objFileName = '%s.o' %(os.path.splitext(os.path.basename(tmpFileName))[0])
         os.remove(objFileName)
 
-        print '[PASSED] Compile: %s' %(f)
+        log.append('[PASSED] Compile: %s' %(f))
         return True, None
 
     return False, stderr
 #------------------------------------------------------------------------------
 
+def testVerified(verifyFailed, stderr, f, fileName, log):
+    """The counterpart of testCompile for --verify-output, insights parsed its result again already.
+
+    The diagnostics come from the clang insights is built with and not from --cxx, so a .cerr or .ccerr file only says
+    that the result is expected not to compile, its text is not compared."""
+    compileErrorFile = os.path.join(mypath, fileName + '.cerr')
+    expectError      = os.path.isfile(compileErrorFile) or os.path.isfile(os.path.join(mypath, fileName + '.ccerr'))
+
+    if verifyFailed and not expectError:
+        log.append('[ERROR] Compile failed: %s' %(f))
+        log.append(stderr)
+        return False, stderr
+
+    if not verifyFailed and os.path.isfile(compileErrorFile):
+        log.append('unused file: %s' %(compileErrorFile))
+
+    log.append('[PASSED] Compile: %s' %(f))
+    return True, None
+#------------------------------------------------------------------------------
+
+
+def runTest(f, args):
+    """Run a single test and return its result. The output goes to the log of the result, so that tests running in
+    parallel do not mix their output."""
+    insightsPath  = args['insights']
+    bUpdateTests  = args['update_tests']
+    log           = []
+    result        = {'name': f, 'status': 'failed', 'log': log, 'timing': None}
+
+    regEx         = re.compile('.*cmdline:(.*)')
+    regExInsights = re.compile(r'.*cmdlineinsights:(\S*)')
+
+    fileName     = os.path.splitext(f)[0]
+    expectFile   = os.path.join(mypath, fileName + '.expect')
+    ignoreFile   = os.path.join(mypath, fileName + '.ignore')
+    cppStd       = '-std=%s'% (args['std'])
+    insightsOpts = ''
+
+    fileHeader = open(f, 'r').readline().strip()
+    m = regEx.match(fileHeader)
+    if None != m:
+        cppStd = m.group(1)
+
+    m = regExInsights.match(fileHeader)
+    if None != m:
+        insightsOpts = m.group(1)
+
+    if not os.path.isfile(expectFile) and not os.path.isfile(ignoreFile):
+        log.append('Missing expect/ignore for: %s' %(f))
+        result['status'] = 'missing'
+        return result
+
+    cmd = [insightsPath, f]
+
+    if args['use_libcpp']:
+        cmd.append('-use-libc++')
+
+    if args['visitor_dispatch']:
+        cmd.append('--visitor-dispatch')
+
+    if args['skip_header_bodies']:
+        cmd.append('--skip-header-bodies')
+
+    if args['verify_output']:
+        cmd.append('--verify-output')
+
+    if '' != insightsOpts:
+        cmd.append(insightsOpts)
+
+    cmd.extend(['--', cppStd, '-m64'])
+
+    returncode, stdout, stderr, timing = runMeasured(cmd)
+    result['timing'] = timing
+
+    verifyFailed = args['verify_output'] and (VERIFY_FAILED_EXIT_CODE == returncode)
+
+    if (0 != returncode) and not verifyFailed:
+        compileErrorFile = os.path.join(mypath, fileName + '.cerr')
+        if os.path.isfile(compileErrorFile):
+            ce = open(compileErrorFile, 'r').read()
+
+            # Linker errors name the tmp file and not the .tmp.cpp, replace the name here to be able to suppress
+            # these errors.
+            ce = re.sub('(.*).cpp:', '.tmp:', ce)
+            ce = re.sub('(.*).cpp.', '.tmp:', ce)
+            stderr = re.sub('(.*).cpp:', '.tmp:', stderr)
+            stderr = re.sub('(Error while processing.*.cpp.)', '', stderr)
+            # Replace paths, as for example, the STL path differs from a local build to Travis-CI at least for macOS
+            stderr = re.sub('/(.*)/(.*?:[0-9]+):', '... \\2:', stderr)
+
+            # The cerr output matches and the return code says that we hit a compile error, accept it as passed
+            if (ce == stderr) and (1 == returncode):
+                log.append('[PASSED] Compile: %s - %s' %(f, formatTiming(timing)))
+                if testPerf(f, fileName, timing, args, log):
+                    result['status'] = 'passed'
+                return result
+            else:
+                log.append('[ERROR] Compile: %s' %(f))
+
+
+        log.append('Insight crashed for: %s with: %d' %(f, returncode))
+        log.append(stderr)
+
+        if not bUpdateTests:
+            return result
+
+    fd, tmpFileName = tempfile.mkstemp('.cpp')
+    try:
+        with os.fdopen(fd, 'w') as tmp:
+            # stupid replacements for clang 6.0. With 7.0 they added a 1.
+            stdout = stdout.replace('__range ', '__range1 ')
+            stdout = stdout.replace('__range.', '__range1.')
+            stdout = stdout.replace('__range)', '__range1)')
+            stdout = stdout.replace('__range;', '__range1;')
+            stdout = stdout.replace('__begin ', '__begin1 ')
+            stdout = stdout.replace('__begin.', '__begin1.')
+            stdout = stdout.replace('__begin,', '__begin1,')
+            stdout = stdout.replace('__begin;', '__begin1;')
+            stdout = stdout.replace('__end ', '__end1 ')
+            stdout = stdout.replace('__end.', '__end1.')
+            stdout = stdout.replace('__end;', '__end1;')
+            stdout = stdout.replace('__end)', '__end1)')
+
+            # write the data to the temp file
+            tmp.write(stdout)
+
+        equal = testCompare(tmpFileName, stdout, expectFile, f, args, timing, log)
+        if args['verify_output']:
+            bCompiles, stderr = testVerified(verifyFailed, stderr, f, fileName, log)
+        else:
+            bCompiles, stderr = testCompile(tmpFileName, f, args, fileName, cppStd, log)
+        compileErrorFile = os.path.join(mypath, fileName + '.cerr')
+
+
+        if bCompiles and equal:
+            if testPerf(f, fileName, timing, args, log):
+                result['status'] = 'passed'
+        elif bUpdateTests:
+            if bCompiles and not equal:
+                open(expectFile, 'w').write(stdout)
+                log.append('Updating test')
+            elif not bCompiles and os.path.exists(compileErrorFile):
+                open(expectFile, 'w').write(stdout)
+                open(compileErrorFile, 'w').write(stderr)
+                log.append('Updating test cerr')
+
+
+    finally:
+        os.remove(tmpFileName)
+
+    return result
+#------------------------------------------------------------------------------
+
+def writeSummary(summaryFile, results, wall):
+    """Write the timings of all tests which ran insights as JSON, the slowest test first."""
+    timed = sorted([r for r in results if r['timing']], key=lambda r: r['timing']['wall'], reverse=True)
+
+    summary = {
+        'wall': wall,
+        'cpu': sum(r['timing']['cpu'] for r in timed),
+        'tests': [dict(name=r['name'], status=r['status'], **r['timing']) for r in timed],
+    }
+
+    with open(summaryFile, 'w') as out:
+        json.dump(summary, out, indent=2, separators=(',', ': '), sort_keys=True)
+        out.write('\n')
+#------------------------------------------------------------------------------
+
 
 def main():
     parser = argparse.ArgumentParser(description='Description of your program')
@@ -87,139 +340,56 @@ def main():
     parser.add_argument('--update-tests',   help='Update failing tests', default=False, action='store_true')
     parser.add_argument('--std',            help='C++ Standard to used', default='c++17')
     parser.add_argument('--use-libcpp',     help='Use libst++',          default=False, action='store_true')
+    parser.add_argument('--visitor-dispatch', help='Use the single pass dispatcher', default=False, action='store_true')
+    parser.add_argument('--skip-header-bodies', help='Skip the function bodies in headers', default=False, action='store_true')
+    parser.add_argument('--verify-output', help='Let insights check that its result compiles instead of running --cxx',
+                        default=False, action='store_true')
+    parser.add_argument('-j', '--jobs',     help='Run N tests in parallel', default=1, type=int, metavar='N')
+    parser.add_argument('--summary',        help='Write the timings as JSON to FILE, slowest test first', metavar='FILE')
+    parser.add_argument('--perf-tolerance', help='Allowed factor over the .perf baseline',
+                        default=2.0, type=float, metavar='FACTOR')
+    parser.add_argument('--perf-fail',      help='A test slower than its .perf file fails', default=False, action='store_true')
+    parser.add_argument('--update-perf',    help='Create or update the .perf files of all tests', default=False, action='store_true')
     parser.add_argument('args', nargs=argparse.REMAINDER)
     args = vars(parser.parse_args())
 
-    insightsPath  = args['insights']
     remainingArgs = args['args']
     bFailureIsOk  = args['failure_is_ok']
-    bUpdateTests  = args['update_tests']
-    defaultCppStd = '-std=%s'% (args['std'])
 
     if 0 == len(remainingArgs):
         cppFiles = [f for f in os.listdir(mypath) if (os.path.isfile(os.path.join(mypath, f)) and f.endswith('.cpp'))]
     else:
         cppFiles = remainingArgs
 
-    filesPassed     = 0
-    missingExpected = 0
-    ret             = 0
-
-    regEx         = re.compile('.*cmdline:(.*)')
-    regExInsights = re.compile('.*cmdlineinsights:(.*)')
-
-    for f in sorted(cppFiles):
-        fileName     = os.path.splitext(f)[0]
-        expectFile   = os.path.join(mypath, fileName + '.expect')
-        ignoreFile   = os.path.join(mypath, fileName + '.ignore')
-        cppStd       = defaultCppStd
-        insightsOpts = ''
+    jobs = args['jobs']
+    if 0 >= jobs:
+        jobs = multiprocessing.cpu_count()
 
-        fileHeader = open(f, 'r').readline().strip()
-        m = regEx.match(fileHeader)
-        if None != m:
-            cppStd = m.group(1)
+    begin = time.time()
+    pool  = ThreadPool(jobs)
+    results = []
 
-        m = regExInsights.match(fileHeader)
-        if None != m:
-            insightsOpts = m.group(1)
+    # The tests run in parallel, their output comes in the order of the files.
+    for result in pool.imap(lambda f: runTest(f, args), sorted(cppFiles)):
+        for line in result['log']:
+            print line
 
-        if not os.path.isfile(expectFile) and not os.path.isfile(ignoreFile):
-            print 'Missing expect/ignore for: %s' %(f)
-            missingExpected += 1
-            continue
+        results.append(result)
 
-        cmd = [insightsPath, f]
-
-        if args['use_libcpp']:
-            cmd.append('-use-libc++')
-
-
-        if '' != insightsOpts:
-            cmd.append(insightsOpts)
-
-        cmd.extend(['--', cppStd, '-m64'])
-
-        begin = datetime.datetime.now()
-        p   = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
-        end   = datetime.datetime.now()
-        stdout, stderr = p.communicate()
-
-        if 0 != p.returncode:
-            compileErrorFile = os.path.join(mypath, fileName + '.cerr')
-            if os.path.isfile(compileErrorFile):
-                ce = open(compileErrorFile, 'r').read()
-
-                # Linker errors name the tmp file and not the .tmp.cpp, replace the name here to be able to suppress
-                # these errors.
-                ce = re.sub('(.*).cpp:', '.tmp:', ce)
-                ce = re.sub('(.*).cpp.', '.tmp:', ce)
-                stderr = re.sub('(.*).cpp:', '.tmp:', stderr)
-                stderr = re.sub('(Error while processing.*.cpp.)', '', stderr)
-                # Replace paths, as for example, the STL path differs from a local build to Travis-CI at least for macOS
-                stderr = re.sub('/(.*)/(.*?:[0-9]+):', '... \\2:', stderr)
-
-                # The cerr output matches and the return code says that we hit a compile error, accept it as passed
-                if (ce == stderr) and (1 == p.returncode):
-                    print '[PASSED] Compile: %s' %(f)
-                    filesPassed += 1
-                    continue
-                else:
-                    print '[ERROR] Compile: %s' %(f)
-                    ret = 1
-
-
-            print 'Insight crashed for: %s with: %d' %(f, p.returncode)
-            print stderr
-
-            if not bUpdateTests:
-                continue
-
-        fd, tmpFileName = tempfile.mkstemp('.cpp')
-        try:
-            with os.fdopen(fd, 'w') as tmp:
-                # stupid replacements for clang 6.0. With 7.0 they added a 1.
-                stdout = stdout.replace('__range ', '__range1 ')
-                stdout = stdout.replace('__range.', '__range1.')
-                stdout = stdout.replace('__range)', '__range1)')
-                stdout = stdout.replace('__range;', '__range1;')
-                stdout = stdout.replace('__begin ', '__begin1 ')
-                stdout = stdout.replace('__begin.', '__begin1.')
-                stdout = stdout.replace('__begin,', '__begin1,')
-                stdout = stdout.replace('__begin;', '__begin1;')
-                stdout = stdout.replace('__end ', '__end1 ')
-                stdout = stdout.replace('__end.', '__end1.')
-                stdout = stdout.replace('__end;', '__end1;')
-                stdout = stdout.replace('__end)', '__end1)')
-
-                # write the data to the temp file
-                tmp.write(stdout)
-
-            equal = testCompare(tmpFileName, stdout, expectFile, f, args, end-begin)
-            bCompiles, stderr = testCompile(tmpFileName, f, args, fileName, cppStd)
-            compileErrorFile = os.path.join(mypath, fileName + '.cerr')
-
-
-            if bCompiles and equal:
-                filesPassed += 1
-            elif bUpdateTests:
-                if bCompiles and not equal:
-                    open(expectFile, 'w').write(stdout)
-                    print('Updating test')
-                elif not bCompiles and os.path.exists(compileErrorFile):
-                    open(expectFile, 'w').write(stdout)
-                    open(compileErrorFile, 'w').write(stderr)
-                    print('Updating test cerr')
-
-
-        finally:
-            os.remove(tmpFileName)
+    pool.close()
+    pool.join()
+    wall = time.time() - begin
 
+    filesPassed     = len([r for r in results if 'passed' == r['status']])
+    missingExpected = len([r for r in results if 'missing' == r['status']])
 
+    if args['summary']:
+        writeSummary(args['summary'], results, wall)
 
     expectedToPass = len(cppFiles)-missingExpected
     print '-----------------------------------------------------------------'
     print 'Tests passed: %d/%d' %(filesPassed, expectedToPass)
+    print 'Time: %.3fs wall, %.3fs cpu with %d jobs' %(wall, sum(r['timing']['cpu'] for r in results if r['timing']), jobs)
 
     if bFailureIsOk:
         return 0
@@ -235,4 +405,3 @@ def main():
 
 sys.exit(main())
 #------------------------------------------------------------------------------
-
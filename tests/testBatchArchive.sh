@@ -0,0 +1,104 @@
+#! /bin/bash
+
+# --batch-archive transforms the entries of an archive into a result archive. A truncated archive and a source which is
+# not followed by its '\0' are rejected.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+SCRIPT="`dirname "$0"`/../scripts/batch-archive.py"
+
+cat > "$DIR/records.jsonl" <<'EOF'
+{"id": "first", "code": "int main() { auto x = 1; return x; }", "std": "c++17"}
+{"id": "second", "code": "int f() { auto y = 2.0; return y; }", "std": "c++17"}
+EOF
+
+if ! python3 "$SCRIPT" pack "$DIR/records.jsonl" "$DIR/records.arc" > /dev/null; then
+    echo "testBatchArchive: packing failed"
+    exit 1
+fi
+
+if ! $1 --batch --batch-archive="$DIR/records.arc" -j 2 -- 2> "$DIR/err.txt"; then
+    echo "testBatchArchive: insights failed"
+    cat "$DIR/err.txt"
+    exit 1
+fi
+
+python3 "$SCRIPT" unpack "$DIR/records.arc.results" --ids "$DIR/records.arc.ids" > "$DIR/results.jsonl"
+
+python3 - "$DIR/results.jsonl" <<'EOF'
+import json
+import sys
+
+results = [json.loads(line) for line in open(sys.argv[1])]
+ids     = [result['id'] for result in results]
+
+if ids != ['first', 'second']:
+    sys.exit('testBatchArchive: wrong ids %s' % ids)
+
+for result, expected in zip(results, ['int x = 1;', 'double y = 2.0;']):
+    if (0 != result['returnCode']) or (expected not in result['code']):
+        sys.exit('testBatchArchive: wrong result %s' % result)
+EOF
+
+[ $? -eq 0 ] || exit 1
+
+# The source of the first entry ends at the end of the file, without its '\0'. The second entry is fine.
+python3 - "$DIR/unterminated.arc" <<'EOF'
+import struct
+import sys
+
+good       = b'int g() { return 3; }'
+bad        = b'int h() { return 4; }'
+arguments  = b'--\0-std=c++17\0'
+dataOffset = 8 + 8 + 2 * 32
+
+goodOffset      = dataOffset
+argumentsOffset = goodOffset + len(good) + 1
+badOffset       = argumentsOffset + len(arguments)
+
+with open(sys.argv[1], 'wb') as out:
+    out.write(b'INSARC01')
+    out.write(struct.pack('<Q', 2))
+    out.write(struct.pack('<QQQQ', badOffset, len(bad), argumentsOffset, len(arguments)))
+    out.write(struct.pack('<QQQQ', goodOffset, len(good), argumentsOffset, len(arguments)))
+    out.write(good + b'\0' + arguments + bad)
+EOF
+
+if $1 --batch --batch-archive="$DIR/unterminated.arc" -- 2> /dev/null; then
+    echo "testBatchArchive: an archive with an unterminated source succeeded"
+    exit 1
+fi
+
+python3 "$SCRIPT" unpack "$DIR/unterminated.arc.results" > "$DIR/unterminated.jsonl"
+
+python3 - "$DIR/unterminated.jsonl" <<'EOF'
+import json
+import sys
+
+bad, good = [json.loads(line) for line in open(sys.argv[1])]
+
+if (1 != bad['returnCode']) or ("not followed by '\\0'" not in bad['diagnostics']):
+    sys.exit('testBatchArchive: the unterminated source was not rejected: %s' % bad)
+
+if (0 != good['returnCode']) or ('int g()' not in good['code']):
+    sys.exit('testBatchArchive: the entry after the unterminated one failed: %s' % good)
+EOF
+
+[ $? -eq 0 ] || exit 1
+
+# The index of two entries does not fit into the file.
+head -c 48 "$DIR/records.arc" > "$DIR/truncated.arc"
+
+if $1 --batch --batch-archive="$DIR/truncated.arc" -- 2> "$DIR/err.txt"; then
+    echo "testBatchArchive: a truncated archive succeeded"
+    exit 1
+fi
+
+if ! grep -qF "is truncated" "$DIR/err.txt"; then
+    echo "testBatchArchive: missing error for the truncated archive"
+    cat "$DIR/err.txt"
+    exit 1
+fi
+
+exit 0
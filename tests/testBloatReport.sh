@@ -0,0 +1,63 @@
+#! /bin/bash
+
+# --bloat-report counts the instantiations of each template and names the argument with the most distinct values.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/main.cpp" <<'EOF'
+template<typename F>
+int Apply(F f)
+{
+    return f();
+}
+
+template<typename T>
+struct Box
+{
+    T value;
+};
+
+int Three()
+{
+    return 3;
+}
+
+int main()
+{
+    Box<int>  a{};
+    Box<char> b{};
+
+    return Apply([] { return 1; }) + Apply([] { return 2; }) + Apply(Three);
+}
+EOF
+
+if ! $1 --bloat-report "$DIR/main.cpp" -- -std=c++17 > /dev/null 2> "$DIR/report.txt"; then
+    echo "testBloatReport: insights failed"
+    exit 1
+fi
+
+if ! grep -q "template bloat report" "$DIR/report.txt"; then
+    echo "testBloatReport: missing report"
+    exit 1
+fi
+
+if ! grep -qE "^  Apply +3 +[1-9][0-9]* +[1-9][0-9]*$" "$DIR/report.txt"; then
+    echo "testBloatReport: wrong line for Apply"
+    cat "$DIR/report.txt"
+    exit 1
+fi
+
+if ! grep -qxF "    argument 1: 3 distinct values, 2 of them lambdas" "$DIR/report.txt"; then
+    echo "testBloatReport: wrong argument line for Apply"
+    cat "$DIR/report.txt"
+    exit 1
+fi
+
+if ! grep -qE "^  Box +2 +[1-9][0-9]* +[1-9][0-9]*$" "$DIR/report.txt"; then
+    echo "testBloatReport: wrong line for Box"
+    cat "$DIR/report.txt"
+    exit 1
+fi
+
+exit 0
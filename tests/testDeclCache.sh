@@ -0,0 +1,21 @@
+#! /bin/bash
+
+# The code of a class shows the special members which a use later in the file declares. With the declaration cache the
+# second request must not get the class of the first one, although only main changed.
+
+FIRST='{"id": 1, "code": "struct X { int i; };\nint main() { X x{}; }", "std": "c++17"}'
+SECOND='{"id": 2, "code": "struct X { int i; };\nint main() { X x{}; X y{x}; }", "std": "c++17"}'
+
+RESULTS=`printf '%s\n%s\n' "$FIRST" "$SECOND" | $1 --batch --decl-cache-size=16 --`
+
+if echo "$RESULTS" | sed -n 1p | grep -q 'X(const X &)'; then
+    echo "testDeclCache: the first request shows a copy constructor"
+    exit 1
+fi
+
+if ! echo "$RESULTS" | sed -n 2p | grep -q 'X(const X &)'; then
+    echo "testDeclCache: the second request got the cached class without the copy constructor"
+    exit 1
+fi
+
+exit 0
@@ -0,0 +1,68 @@
+#! /bin/bash
+
+# The edits of --output=edits-json applied to the source must give the same result as the transformed file.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/main.cpp" <<'EOF'
+struct Point
+{
+    int x;
+    int y;
+};
+
+int Sum(const Point& p)
+{
+    auto sum = p.x + p.y;
+    return sum;
+}
+
+int main()
+{
+    Point p{1, 2};
+    return Sum(p);
+}
+EOF
+
+if ! $1 "$DIR/main.cpp" -- -std=c++17 > "$DIR/out.cpp"; then
+    echo "testEditsJson: insights failed"
+    exit 1
+fi
+
+if ! $1 --output=edits-json "$DIR/main.cpp" -- -std=c++17 > "$DIR/edits.json"; then
+    echo "testEditsJson: insights --output=edits-json failed"
+    exit 1
+fi
+
+python3 - "$DIR/main.cpp" "$DIR/edits.json" "$DIR/out.cpp" <<'EOF'
+import json
+import sys
+
+source   = open(sys.argv[1], 'rb').read()
+edits    = json.load(open(sys.argv[2]))['edits']
+expected = open(sys.argv[3], 'rb').read()
+
+result = b''
+pos    = 0
+
+for edit in edits:
+    begin, end, text, handler = edit['begin'], edit['end'], edit['text'], edit['handler']
+
+    if not (isinstance(begin, int) and isinstance(end, int) and (pos <= begin <= end <= len(source))):
+        sys.exit('testEditsJson: edit out of order or out of range: %s' % edit)
+
+    if not (isinstance(text, str) and isinstance(handler, str) and handler):
+        sys.exit('testEditsJson: edit without text or handler: %s' % edit)
+
+    result += source[pos:begin] + text.encode()
+    pos     = end
+
+result += source[pos:]
+
+if result != expected:
+    sys.exit('testEditsJson: the edits do not give the transformed file')
+
+if 'FunctionDeclHandler' not in [edit['handler'] for edit in edits]:
+    sys.exit('testEditsJson: no edit of the FunctionDeclHandler')
+EOF
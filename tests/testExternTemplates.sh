@@ -0,0 +1,57 @@
+#! /bin/bash
+
+# The heaviest instantiations of templates from a header end up in extern_templates.h and extern_templates.cpp. The
+# written source must compile together with the header it includes.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/box.h" <<'END'
+template<typename T>
+struct Box
+{
+    T value;
+};
+
+template<typename T>
+T Twice(T t)
+{
+    return t + t;
+}
+END
+
+cat > "$DIR/main.cpp" <<'END'
+#include "box.h"
+
+int main()
+{
+    Box<int> b{2};
+    return Twice(b.value);
+}
+END
+
+if ! $1 --traverse-all-decls --emit-extern-templates="$DIR/out" "$DIR/main.cpp" -- -std=c++17 > /dev/null; then
+    echo "testExternTemplates: insights failed"
+    exit 1
+fi
+
+for LINE in '#include "box.h"' 'extern template struct Box<int>;' 'extern template int Twice<int>(int);'; do
+    if ! grep -qF "$LINE" "$DIR/out/extern_templates.h"; then
+        echo "testExternTemplates: extern_templates.h lacks: $LINE"
+        exit 1
+    fi
+done
+
+for LINE in '#include "extern_templates.h"' 'template struct Box<int>;' 'template int Twice<int>(int);'; do
+    if ! grep -qxF "$LINE" "$DIR/out/extern_templates.cpp"; then
+        echo "testExternTemplates: extern_templates.cpp lacks: $LINE"
+        exit 1
+    fi
+done
+
+if ! $2 -std=c++17 -fsyntax-only -I "$DIR" "$DIR/out/extern_templates.cpp"; then
+    echo "testExternTemplates: extern_templates.cpp does not compile"
+    exit 1
+fi
+
+exit 0
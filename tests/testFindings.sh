@@ -0,0 +1,76 @@
+#! /bin/bash
+
+# --findings writes the performance annotations with their location, category, severity and cost as JSON or SARIF.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/main.cpp" <<'EOF'
+struct Padded
+{
+    char a;
+    int  b;
+};
+
+struct Base
+{
+    virtual int Get() const { return 1; }
+};
+
+int Call(const Base& base)
+{
+    return base.Get();
+}
+EOF
+
+if ! $1 --show-layout --show-virtual-calls --findings=json "$DIR/main.cpp" -- -std=c++17 > /dev/null 2> "$DIR/findings.json"; then
+    echo "testFindings: insights failed for json"
+    exit 1
+fi
+
+if ! $1 --show-layout --show-virtual-calls --findings=sarif --findings-file="$DIR/findings.sarif" "$DIR/main.cpp" -- -std=c++17 > /dev/null; then
+    echo "testFindings: insights failed for sarif"
+    exit 1
+fi
+
+python3 - "$DIR/findings.json" "$DIR/findings.sarif" <<'EOF'
+import json
+import sys
+
+findings = json.load(open(sys.argv[1]))
+
+def find(category):
+    for finding in findings:
+        if finding['category'] == category:
+            return finding
+
+    sys.exit('testFindings: no %s finding in %s' % (category, findings))
+
+padding = find('padding')
+virtual = find('virtual-call')
+
+if (padding['line'], padding['column'], padding['cost'], padding['costUnit'], padding['severity']) != (4, 10, 3, 'bytes', 'note') or \
+   not padding['message'].endswith(' padding before b') or not padding['file'].endswith('main.cpp'):
+    sys.exit('testFindings: wrong padding finding %s' % padding)
+
+if (virtual['line'], virtual['column'], virtual['cost'], virtual['costUnit'], virtual['severity']) != (14, 12, 1, 'calls', 'note') or \
+   (virtual['message'] != 'virtual: indirect call through the vtable'):
+    sys.exit('testFindings: wrong virtual-call finding %s' % virtual)
+
+sarif = json.load(open(sys.argv[2]))
+run   = sarif['runs'][0]
+rules = [rule['id'] for rule in run['tool']['driver']['rules']]
+
+if (sarif['version'] != '2.1.0') or ('padding' not in rules) or ('virtual-call' not in rules):
+    sys.exit('testFindings: wrong SARIF header')
+
+results = [(result['ruleId'],
+            result['level'],
+            result['locations'][0]['physicalLocation']['region']['startLine'],
+            result['locations'][0]['physicalLocation']['region']['startColumn'],
+            result['properties']['cost']) for result in run['results']]
+
+for expected in [('padding', 'note', 4, 10, 3), ('virtual-call', 'note', 14, 12, 1)]:
+    if expected not in results:
+        sys.exit('testFindings: missing SARIF result %s in %s' % (expected, results))
+EOF
@@ -0,0 +1,78 @@
+#! /bin/bash
+
+# --include-report lists each include of the main file with the files it pulls in and their bytes, --unused-includes
+# those of them the main file does not use. The times vary from run to run, only their format is checked.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/a.h" <<'EOF'
+#pragma once
+#include "b.h"
+int A();
+EOF
+
+cat > "$DIR/b.h" <<'EOF'
+#pragma once
+int B();
+int C();
+EOF
+
+cat > "$DIR/unused.h" <<'EOF'
+#pragma once
+int Unused();
+EOF
+
+cat > "$DIR/macro.h" <<'EOF'
+#pragma once
+#define FEATURE 1
+EOF
+
+cat > "$DIR/main.cpp" <<'EOF'
+#include "a.h"
+#include "unused.h"
+#include "macro.h"
+
+int main()
+{
+#ifdef FEATURE
+    return A() + B();
+#else
+    return 0;
+#endif
+}
+EOF
+
+bytes() { cat "$@" | wc -c | tr -d ' '; }
+
+if ! $1 --include-report --unused-includes "$DIR/main.cpp" -- -std=c++17 > /dev/null 2> "$DIR/report.txt"; then
+    echo "testIncludeReport: insights failed"
+    exit 1
+fi
+
+# The include report comes first, the unused includes report follows.
+sed -n '/include report/,/unused includes report/p' "$DIR/report.txt" > "$DIR/includes.txt"
+sed -n '/unused includes report/,$p' "$DIR/report.txt" > "$DIR/unused.txt"
+
+check() {
+    if ! grep -qE "$2" "$1"; then
+        echo "testIncludeReport: $3"
+        cat "$DIR/report.txt"
+        exit 1
+    fi
+}
+
+check "$DIR/includes.txt" "^  a\.h +1 +2 +`bytes "$DIR/a.h" "$DIR/b.h"` +[1-9][0-9]* +[0-9]+\.[0-9]{2}$" "wrong line for a.h"
+check "$DIR/includes.txt" "^  unused\.h +2 +1 +`bytes "$DIR/unused.h"` +[1-9][0-9]* +[0-9]+\.[0-9]{2}$" "wrong line for unused.h"
+check "$DIR/includes.txt" "^  macro\.h +3 +1 +`bytes "$DIR/macro.h"` +[0-9]+ +[0-9]+\.[0-9]{2}$" "wrong line for macro.h"
+
+check "$DIR/unused.txt" "^  unused\.h +2 +1 +`bytes "$DIR/unused.h"` +[0-9]+\.[0-9]{2}$" "unused.h is not reported as unused"
+check "$DIR/unused.txt" "^  Total +[0-9]+\.[0-9]{2}$" "missing total of the unused includes"
+
+if grep -qE "^  (a|b|macro)\.h " "$DIR/unused.txt"; then
+    echo "testIncludeReport: a used include is reported as unused"
+    cat "$DIR/report.txt"
+    exit 1
+fi
+
+exit 0
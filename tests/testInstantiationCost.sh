@@ -0,0 +1,49 @@
+#! /bin/bash
+
+# --show-instantiation-cost annotates each instantiation with its compile time, --instantiation-report lists them. The
+# times vary from run to run, only the format is checked.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/main.cpp" <<'EOF'
+template<typename T>
+struct Box
+{
+    T value;
+};
+
+template<typename T>
+T Twice(T t)
+{
+    return t + t;
+}
+
+int main()
+{
+    Box<int> b{2};
+
+    return Twice(b.value);
+}
+EOF
+
+if ! $1 --show-instantiation-cost --instantiation-report=5 "$DIR/main.cpp" -- -std=c++17 > "$DIR/out.cpp" 2> "$DIR/report.txt"; then
+    echo "testInstantiationCost: insights failed"
+    exit 1
+fi
+
+if [ 2 -ne `grep -cE "^ */\* instantiation: [0-9]+\.[0-9]{3} ms of compile time \*/$" "$DIR/out.cpp"` ]; then
+    echo "testInstantiationCost: expected a comment for each of the two instantiations"
+    cat "$DIR/out.cpp"
+    exit 1
+fi
+
+for instantiation in "Box<int>" "Twice<int>"; do
+    if ! grep -qE "^  $instantiation +[0-9]+\.[0-9]{3} +[0-9]+\.[0-9]%$" "$DIR/report.txt"; then
+        echo "testInstantiationCost: missing $instantiation in the report"
+        cat "$DIR/report.txt"
+        exit 1
+    fi
+done
+
+exit 0
@@ -0,0 +1,67 @@
+#! /bin/bash
+
+# The layout asserts of the hot classes must hold for the file they were generated from, included after its classes.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/main.cpp" <<'END'
+struct __attribute__((annotate("hot"))) Packet
+{
+    char tag;
+    int  length;
+};
+
+namespace net {
+    template<typename T>
+    struct Header
+    {
+        T   id;
+        int flags;
+    };
+
+    Header<short> header{};
+}
+
+struct Cold
+{
+    char c;
+};
+
+int main()
+{
+    Packet p{};
+    Cold   c{};
+}
+END
+
+if ! $1 --emit-layout-asserts="$DIR/layout_asserts.h" --hot-record=net::Header "$DIR/main.cpp" -- -std=c++17 > /dev/null; then
+    echo "testLayoutAsserts: insights failed"
+    exit 1
+fi
+
+for LINE in 'static_assert(sizeof(Packet) == 8, "the size of Packet changed");' \
+            'static_assert(alignof(Packet) == 4, "the alignment of Packet changed");' \
+            'static_assert(__builtin_offsetof(Packet, tag) == 0, "the offset of Packet::tag changed");' \
+            'static_assert(__builtin_offsetof(Packet, length) == 4, "the offset of Packet::length changed");' \
+            'static_assert(sizeof(net::Header<short>) == 8, "the size of net::Header<short> changed");' \
+            'static_assert(__builtin_offsetof(net::Header<short>, flags) == 4, "the offset of net::Header<short>::flags changed");'; do
+    if ! grep -qxF "$LINE" "$DIR/layout_asserts.h"; then
+        echo "testLayoutAsserts: layout_asserts.h lacks: $LINE"
+        exit 1
+    fi
+done
+
+if grep -q 'Cold' "$DIR/layout_asserts.h"; then
+    echo "testLayoutAsserts: layout_asserts.h has the class which is not hot"
+    exit 1
+fi
+
+printf '#include "main.cpp"\n#include "layout_asserts.h"\n' > "$DIR/check.cpp"
+
+if ! $2 -std=c++17 -fsyntax-only "$DIR/check.cpp"; then
+    echo "testLayoutAsserts: the layout asserts do not compile"
+    exit 1
+fi
+
+exit 0
@@ -0,0 +1,52 @@
+#! /bin/bash
+
+# A local header without an include guard must not end up in the precompiled preamble of --stdin. The file includes
+# it again and the second expansion would redefine its struct.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/point.h" <<'EOF'
+struct Point
+{
+    int x;
+    int y;
+};
+EOF
+
+cat > "$DIR/main.cpp" <<'EOF'
+#include <cstdio>
+#include "point.h"
+
+int main()
+{
+    Point p{1, 2};
+    std::printf("%d\n", p.x);
+}
+EOF
+
+# The second run finds the marker of the unguarded preamble in the cache.
+for run in 1 2; do
+    if ! $1 --stdin "$DIR/main.cpp" --pch-cache-dir="$DIR/pch" -- -std=c++17 < "$DIR/main.cpp" > "$DIR/out.cpp" 2> "$DIR/err.txt"; then
+        echo "testPreambleUnguarded: insights failed in run $run"
+        cat "$DIR/err.txt"
+        exit 1
+    fi
+
+    if grep -q "redefinition" "$DIR/err.txt"; then
+        echo "testPreambleUnguarded: the header was expanded twice in run $run"
+        exit 1
+    fi
+
+    if ! grep -qF "Point p = {1, 2};" "$DIR/out.cpp"; then
+        echo "testPreambleUnguarded: missing transformation in run $run"
+        exit 1
+    fi
+done
+
+if ! ls "$DIR/pch" | grep -q "\.unguarded$"; then
+    echo "testPreambleUnguarded: the preamble was not marked as unguarded"
+    exit 1
+fi
+
+exit 0
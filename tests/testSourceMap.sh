@@ -0,0 +1,73 @@
+#! /bin/bash
+
+# --source-map maps each generated line back to the line of the main file it was generated from.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/main.cpp" <<'EOF'
+int Twice(int x)
+{
+    auto y = x + x;
+    return y;
+}
+EOF
+
+if ! $1 --source-map="$DIR/main.map" "$DIR/main.cpp" -- -std=c++17 > "$DIR/out.cpp"; then
+    echo "testSourceMap: insights failed"
+    exit 1
+fi
+
+python3 - "$DIR/main.map" "$DIR/out.cpp" <<'EOF'
+import json
+import sys
+
+BASE64 = 'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/'
+
+sourceMap = json.load(open(sys.argv[1]))
+generated = open(sys.argv[2]).read().split('\n')
+
+if (sourceMap['version'] != 3) or (len(sourceMap['sources']) != 1) or not sourceMap['sources'][0].endswith('main.cpp'):
+    sys.exit('testSourceMap: wrong header %s' % sourceMap)
+
+def decode(segment):
+    values = []
+    value  = 0
+    shift  = 0
+
+    for c in segment:
+        digit  = BASE64.index(c)
+        value += (digit & 31) << shift
+        shift += 5
+
+        if not (digit & 32):
+            values.append(-(value >> 1) if (value & 1) else (value >> 1))
+            value = 0
+            shift = 0
+
+    return values
+
+# The first source line each generated line maps to.
+firstSourceLine = {}
+sourceLine      = 0
+
+for generatedLine, segments in enumerate(sourceMap['mappings'].split(';')):
+    for segment in filter(None, segments.split(',')):
+        values = decode(segment)
+
+        if (len(values) != 4) or (values[1] != 0):
+            sys.exit('testSourceMap: wrong segment %s' % segment)
+
+        sourceLine += values[2]
+        firstSourceLine.setdefault(generatedLine, sourceLine)
+
+def check(text, expected):
+    line = [i for i, l in enumerate(generated) if l.strip() == text]
+
+    if not line or (firstSourceLine.get(line[0]) != expected):
+        sys.exit('testSourceMap: "%s" does not map to line %d: %s' % (text, expected, firstSourceLine))
+
+check('int Twice(int x)', 0)
+check('int y = x + x;', 2)
+check('return y;', 3)
+EOF
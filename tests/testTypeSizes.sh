@@ -0,0 +1,87 @@
+#! /bin/bash
+
+# --type-sizes lists the classes, instantiations and closure types of the main file with their layout, the largest
+# first.
+
+DIR=`mktemp -d`
+trap 'rm -rf "$DIR"' EXIT
+
+cat > "$DIR/main.cpp" <<'EOF'
+struct Padded
+{
+    char a;
+    int  b;
+    char c;
+};
+
+template<typename T>
+struct Pair
+{
+    T    first;
+    char second;
+};
+
+int main()
+{
+    Padded     p{};
+    Pair<long> q{};
+    int        x{2};
+
+    auto l = [x] { return x; };
+
+    return p.b + static_cast<int>(q.first) + l();
+}
+EOF
+
+if ! $1 --type-sizes=json "$DIR/main.cpp" -- -std=c++17 > /dev/null 2> "$DIR/sizes.json"; then
+    echo "testTypeSizes: insights failed"
+    exit 1
+fi
+
+python3 - "$DIR/sizes.json" <<'EOF'
+import json
+import sys
+
+types = json.load(open(sys.argv[1]))
+
+def find(name, kind):
+    for t in types:
+        if ((name is None) or (t['name'] == name)) and (t['kind'] == kind):
+            return t
+
+    sys.exit('testTypeSizes: missing %s %s in %s' % (kind, name, types))
+
+def check(t, **expected):
+    for key, value in expected.items():
+        if t[key] != value:
+            sys.exit('testTypeSizes: %s of %s is %s, expected %s' % (key, t['name'], t[key], value))
+
+check(find('Padded', 'class'), size=12, align=4, fields=3, padding=6, trivial=True, standardLayout=True)
+check(find('Pair<long>', 'instantiation'), size=16, align=8, fields=2, padding=7)
+check(find(None, 'lambda'), size=4, fields=1, padding=0)
+
+sizes = [t['size'] for t in types]
+
+if sizes != sorted(sizes, reverse=True):
+    sys.exit('testTypeSizes: not sorted by size: %s' % sizes)
+EOF
+
+[ $? -eq 0 ] || exit 1
+
+if ! $1 --type-sizes=csv "$DIR/main.cpp" -- -std=c++17 > /dev/null 2> "$DIR/sizes.csv"; then
+    echo "testTypeSizes: insights failed for csv"
+    exit 1
+fi
+
+if ! grep -qxF "file,name,kind,size,align,fields,padding,trivially copyable,trivial,trivial destructor,standard layout" "$DIR/sizes.csv"; then
+    echo "testTypeSizes: missing csv header"
+    exit 1
+fi
+
+if ! grep -qE ',"Padded",class,12,4,3,6,yes,yes,yes,yes$' "$DIR/sizes.csv"; then
+    echo "testTypeSizes: wrong csv row for Padded"
+    cat "$DIR/sizes.csv"
+    exit 1
+fi
+
+exit 0
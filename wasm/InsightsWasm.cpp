@@ -0,0 +1,122 @@
+/******************************************************************************
+ *
+ * C++ Insights, copyright (C) by Andreas Fertig
+ * Distributed under an MIT license. See LICENSE for details
+ *
+ ****************************************************************************/
+
+#include <emscripten/emscripten.h>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Insights.h"
+//-----------------------------------------------------------------------------
+
+/// \brief The compiler arguments every request starts with.
+///
+/// The PCHs of the target \c insights-wasm-pch were built with the same arguments, only then their cache keys match. The
+/// preloaded headers get the time of loading, not the one the PCHs recorded, so the PCHs are not validated against
+/// them.
+static const std::vector<std::string> gBaseArgs{"--target=wasm32-unknown-emscripten",
+                                                "--sysroot=" INSIGHTS_WASM_SYSROOT,
+                                                "-Xclang",
+                                                "-fno-validate-pch"};
+//-----------------------------------------------------------------------------
+
+/// \brief Split \p list at its newlines, empty lines are dropped.
+static std::vector<std::string> SplitLines(const char* list)
+{
+    std::vector<std::string> lines{};
+    llvm::StringRef          rest{list ? list : ""};
+
+    while(not rest.empty()) {
+        auto [line, tail] = rest.split('\n');
+
+        if(not line.empty()) {
+            lines.push_back(line.str());
+        }
+
+        rest = tail;
+    }
+
+    return lines;
+}
+//-----------------------------------------------------------------------------
+
+/// \brief The result as JSON, in memory the caller releases with \ref insights_free.
+static char* MakeResult(const TransformResult& result)
+{
+    std::string              json{};
+    llvm::raw_string_ostream stream{json};
+
+    stream << llvm::json::Value{llvm::json::Object{
+        {"code", result.code},
+        {"diagnostics", result.diagnostics},
+        {"returnCode", result.returnCode},
+        {"timeMs", result.stats.timeMs},
+    }};
+    stream.flush();
+
+    auto* copy = static_cast<char*>(std::malloc(json.size() + 1));
+    std::memcpy(copy, json.c_str(), json.size() + 1);
+
+    return copy;
+}
+//-----------------------------------------------------------------------------
+
+extern "C" {
+
+/// \brief Set up the command line options all requests share, call it once after the module is loaded.
+///
+/// \returns 0 on success.
+EMSCRIPTEN_KEEPALIVE int insights_init()
+{
+    const char* argv[]{"insights", "--pch-cache-dir=/insights/pch"};
+
+    return llvm::cl::ParseCommandLineOptions(static_cast<int>(std::size(argv)), argv, "", &llvm::nulls()) ? 0 : 1;
+}
+
+/// \brief Transform \p source, \p args and \p options are lists separated by newlines.
+///
+/// \p args are the compiler arguments like \c -std=c++17, \p options the names of the C++ Insights options like \c
+/// show-all-implicit-casts.
+///
+/// \returns A JSON object with \c code, \c diagnostics, \c returnCode and \c timeMs, released with \ref insights_free.
+EMSCRIPTEN_KEEPALIVE char* insights_transform(const char* source, const char* args, const char* options)
+{
+    std::vector<std::string> compilerArgs{gBaseArgs};
+
+    for(auto& arg : SplitLines(args)) {
+        compilerArgs.push_back(std::move(arg));
+    }
+
+    InsightsOptions insightsOptions{GetDefaultInsightsOptions()};
+
+    for(const auto& option : SplitLines(options)) {
+        if(not SetInsightsOption(option, insightsOptions)) {
+            TransformResult error{};
+            error.returnCode  = 1;
+            error.diagnostics = "unknown option: " + option + "\n";
+
+            return MakeResult(error);
+        }
+    }
+
+    return MakeResult(TransformSource("input.cpp", source ? source : "", compilerArgs, insightsOptions));
+}
+
+EMSCRIPTEN_KEEPALIVE void insights_free(char* result)
+{
+    std::free(result);
+}
+
+}  // extern "C"
@@ -0,0 +1,49 @@
+#! /usr/bin/env node
+//
+// Fill the PCH cache insights-wasm ships with. The PCHs are built by the WebAssembly module itself, so the compiler,
+// the arguments and the paths are the same as for a request in the browser and so are the cache keys.
+//
+// Usage: build-pch.js <insights-wasm.js> <output-dir> <standards> <headers>
+//
+// <standards> and <headers> are separated by commas. Each header gets a PCH of its own for each standard, which covers
+// the snippets with a single include of a standard header.
+
+const path = require('path');
+const fs = require('fs');
+
+const [moduleFile, outputDir, standards, headers] = process.argv.slice(2);
+
+if(!headers) {
+    console.error('Usage: build-pch.js <insights-wasm.js> <output-dir> <standards> <headers>');
+    process.exit(1);
+}
+
+fs.mkdirSync(outputDir, {recursive: true});
+
+require(path.resolve(moduleFile))().then((insights) => {
+    insights.FS.mkdirTree('/insights/pch');
+    insights.FS.mount(insights.NODEFS, {root: path.resolve(outputDir)}, '/insights/pch');
+
+    if(0 !== insights._insights_init()) {
+        console.error('insights_init failed');
+        process.exit(1);
+    }
+
+    const transform = insights.cwrap('insights_transform', 'number', ['string', 'string', 'string']);
+    let failed = false;
+
+    for(const standard of standards.split(',')) {
+        for(const header of headers.split(',')) {
+            const ptr = transform(`#include <${header}>\n`, `-std=${standard}`, '');
+            const result = JSON.parse(insights.UTF8ToString(ptr));
+            insights._insights_free(ptr);
+
+            if(0 !== result.returnCode) {
+                console.error(`<${header}> with -std=${standard}:\n${result.diagnostics}`);
+                failed = true;
+            }
+        }
+    }
+
+    process.exit(failed ? 1 : 0);
+});